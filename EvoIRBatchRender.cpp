@@ -0,0 +1,970 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRBatchRender.cpp
+ * @brief Work-stealing batch renderer, radiation correction and PNG encoder
+ *
+ * Each thread owns a shard [begin; end) of frame indices, packed into one
+ * 64 bit atomic. The owner advances begin by a chunk, a thief lowers end of
+ * the largest shard to its middle and installs the upper half as its own
+ * shard. Both are a single compare and swap on the shard, so threads never
+ * block each other. Stolen work is in the hands of the thief until it has
+ * been installed, therefore a thread finding all shards empty may finish:
+ * nothing is left that another thread would not complete.
+ *
+ * All threads read frames from the same memory mapped recording, see
+ * evo_irimager_recording_map_read_frame. PNG rows are filtered with the type
+ * of the smallest absolute differences, then compressed with a greedy match
+ * search on short hash chains and Huffman codes built per image. The smooth
+ * gradients of palette images leave mostly small differences, so this gets
+ * close to a general purpose deflater at a fraction of its search effort.
+ */
+
+#include "EvoIRBatchRender.h"
+#include "EvoIRPalette.h"
+#include "EvoIRRecordingMap.h"
+#include "EvoIRRecordingFormat.h"
+#include "EvoIRHandleTable.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace evo
+{
+
+namespace
+{
+
+const unsigned int MAX_THREADS = 256;
+const double KELVIN            = 273.15;
+
+inline unsigned long long packShard(unsigned int begin, unsigned int end)
+{
+  return ((unsigned long long)begin << 32) | end;
+}
+
+inline unsigned int shardBegin(unsigned long long shard) { return (unsigned int)(shard >> 32); }
+inline unsigned int shardEnd(unsigned long long shard)   { return (unsigned int)shard; }
+
+//------------------------------------------------------------------------------
+// Radiation correction
+
+inline double radiation(double celsius)
+{
+  const double t = celsius + KELVIN;
+  return t > 0.0 ? t * t * t * t : 0.0;
+}
+
+/**
+ * @brief Builds a raw value mapping from the recorded to the new radiation parameters
+ * @return false if the parameters are unchanged and no mapping is needed
+ */
+bool radiationTable(const EvoIRRenderParams& p, std::vector<unsigned short>& table)
+{
+  if(p.emissivity == p.recordedEmissivity && p.transmissivity == p.recordedTransmissivity && p.tAmbient == p.recordedTAmbient)
+    return false;
+
+  const double scale     = std::pow(10.0, p.decimalPlaces);
+  const double recAmb    = radiation(p.recordedTAmbient);
+  const double amb       = radiation(p.tAmbient);
+  const double recEps    = p.recordedEmissivity;
+  const double recTau    = p.recordedTransmissivity;
+  const double eps       = p.emissivity;
+  const double tau       = p.transmissivity;
+  table.resize(65536);
+  for(unsigned int raw = 0; raw < 65536; raw++)
+  {
+    // detected radiation: object, reflected ambient and path
+    const double detected = recTau * (recEps * radiation(raw / scale - 100.0) + (1.0 - recEps) * recAmb) + (1.0 - recTau) * recAmb;
+    const double object   = (detected - (1.0 - tau) * amb - tau * (1.0 - eps) * amb) / (tau * eps);
+    const double celsius  = (object > 0.0 ? std::sqrt(std::sqrt(object)) : 0.0) - KELVIN;
+    const double value    = std::floor((celsius + 100.0) * scale + 0.5);
+    table[raw] = (unsigned short)std::min(65535.0, std::max(0.0, value));
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// PNG encoder
+
+struct DeflateCode
+{
+  unsigned short code; // bit reversed, ready to be written LSB first
+  unsigned short bits;
+};
+
+// Literal byte if distance is 0, otherwise a match of length value with its length and distance symbols
+struct DeflateToken
+{
+  unsigned short value;
+  unsigned short distance;
+  unsigned char lengthSymbol;
+  unsigned char distanceSymbol;
+};
+
+const unsigned short LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+const unsigned char LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+const unsigned short DIST_BASE[30]   = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+                                         4097, 6145, 8193, 12289, 16385, 24577 };
+const unsigned char DIST_EXTRA[30]   = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+const unsigned char CODE_LENGTH_ORDER[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+const unsigned int MIN_MATCH         = 3;
+const unsigned int MAX_MATCH         = 258;
+const unsigned int MAX_DISTANCE      = 32768;
+const int LITERALS                   = 286;
+const int DISTANCES                  = 30;
+const int CODE_LENGTHS               = 19;
+
+// match search: a chain of earlier positions per hash of 3 bytes, cut after MAX_CHAIN candidates or a match of NICE_MATCH bytes
+const int HASH_BITS          = 15;
+const unsigned int MAX_CHAIN = 8;
+const unsigned int NICE_MATCH = 128;
+
+unsigned short reverseBits(unsigned int code, unsigned int bits)
+{
+  unsigned int r = 0;
+  for(unsigned int i = 0; i < bits; i++)
+    r |= ((code >> i) & 1) << (bits - 1 - i);
+  return (unsigned short)r;
+}
+
+// Fixed Huffman code lengths of literal/length symbols and match lengths, see RFC 1951, 3.2.6
+struct DeflateTables
+{
+  unsigned char fixedLengths[288];
+  unsigned short lengthSymbol[MAX_MATCH + 1];
+
+  DeflateTables()
+  {
+    for(unsigned int s = 0; s < 288; s++)
+      fixedLengths[s] = s < 144 ? 8 : s < 256 ? 9 : s < 280 ? 7 : 8;
+    for(unsigned int len = MIN_MATCH; len <= MAX_MATCH; len++)
+    {
+      unsigned int i = 28;
+      while(LENGTH_BASE[i] > len) i--;
+      lengthSymbol[len] = (unsigned short)i;
+    }
+  }
+};
+
+const DeflateTables& deflateTables()
+{
+  static const DeflateTables tables;
+  return tables;
+}
+
+inline unsigned int distanceSymbol(unsigned int distance)
+{
+  return (unsigned int)(std::upper_bound(DIST_BASE, DIST_BASE + DISTANCES, distance) - DIST_BASE) - 1;
+}
+
+class BitWriter
+{
+public:
+  explicit BitWriter(std::vector<unsigned char>& out) : _out(out), _buffer(0), _count(0) { }
+
+  void put(unsigned int value, unsigned int bits)
+  {
+    _buffer |= (unsigned long long)value << _count;
+    _count  += bits;
+    while(_count >= 8)
+    {
+      _out.push_back((unsigned char)_buffer);
+      _buffer >>= 8;
+      _count   -= 8;
+    }
+  }
+
+  void put(const DeflateCode& code)
+  {
+    put(code.code, code.bits);
+  }
+
+  void flush()
+  {
+    if(_count) _out.push_back((unsigned char)_buffer);
+    _buffer = 0;
+    _count  = 0;
+  }
+
+private:
+  std::vector<unsigned char>& _out;
+  unsigned long long _buffer;
+  unsigned int _count;
+};
+
+/**
+ * @brief Code lengths of a Huffman code of at most maxBits bits
+ *
+ * Frequencies are halved until the code fits, which costs little compression
+ * for the rare images exceeding the limit. At least two symbols get a code,
+ * a single code of one bit would be incomplete.
+ */
+void huffmanLengths(const unsigned int* frequencies, int n, int maxBits, unsigned char* lengths)
+{
+  std::vector<unsigned int> f(frequencies, frequencies + n);
+  int used = 0;
+  for(int i = 0; i < n; i++)
+    if(f[i]) used++;
+  for(int i = 0; i < n && used < 2; i++)
+  {
+    if(!f[i])
+    {
+      f[i] = 1;
+      used++;
+    }
+  }
+
+  std::vector<unsigned long long> weight(2 * n);
+  std::vector<int> parent(2 * n, -1);
+  std::vector<std::pair<unsigned long long, int> > heap;
+  while(true)
+  {
+    heap.clear();
+    for(int i = 0; i < n; i++)
+    {
+      if(!f[i]) continue;
+      weight[i] = f[i];
+      heap.push_back(std::make_pair(f[i], i));
+    }
+    std::greater<std::pair<unsigned long long, int> > later;
+    std::make_heap(heap.begin(), heap.end(), later);
+    int nodes = n;
+    while(heap.size() > 1)
+    {
+      std::pop_heap(heap.begin(), heap.end(), later);
+      const std::pair<unsigned long long, int> a = heap.back();
+      heap.pop_back();
+      std::pop_heap(heap.begin(), heap.end(), later);
+      const std::pair<unsigned long long, int> b = heap.back();
+      heap.pop_back();
+      weight[nodes]  = a.first + b.first;
+      parent[a.second] = nodes;
+      parent[b.second] = nodes;
+      heap.push_back(std::make_pair(weight[nodes], nodes));
+      std::push_heap(heap.begin(), heap.end(), later);
+      nodes++;
+    }
+    parent[nodes - 1] = -1;
+
+    // parents are created after their children, so depths follow from the root downwards
+    std::vector<int> depth(nodes, 0);
+    for(int i = nodes - 2; i >= n; i--)
+      depth[i] = depth[parent[i]] + 1;
+    int longest = 0;
+    for(int i = 0; i < n; i++)
+    {
+      lengths[i] = f[i] ? (unsigned char)(depth[parent[i]] + 1) : 0;
+      longest = std::max(longest, (int)lengths[i]);
+    }
+    if(longest <= maxBits) return;
+    for(int i = 0; i < n; i++)
+      if(f[i]) f[i] = (f[i] + 1) / 2;
+  }
+}
+
+// Canonical codes of code lengths, see RFC 1951, 3.2.2
+void canonicalCodes(const unsigned char* lengths, int n, DeflateCode* codes)
+{
+  unsigned int count[16] = { 0 }, next[16];
+  for(int i = 0; i < n; i++)
+    count[lengths[i]]++;
+  count[0] = 0;
+  unsigned int code = 0;
+  for(int bits = 1; bits < 16; bits++)
+  {
+    code       = (code + count[bits - 1]) << 1;
+    next[bits] = code;
+  }
+  for(int i = 0; i < n; i++)
+  {
+    codes[i].bits = lengths[i];
+    codes[i].code = lengths[i] ? reverseBits(next[lengths[i]]++, lengths[i]) : 0;
+  }
+}
+
+inline unsigned int hash3(const unsigned char* p)
+{
+  return (((unsigned int)p[0] | (unsigned int)p[1] << 8 | (unsigned int)p[2] << 16) * 2654435761u) >> (32 - HASH_BITS);
+}
+
+/**
+ * @brief Scratch buffers of one thread, reused for every image
+ */
+struct PngScratch
+{
+  std::vector<unsigned char> rows;
+  std::vector<unsigned char> candidates;
+  std::vector<int> head;
+  std::vector<int> prev;
+  std::vector<DeflateToken> tokens;
+  std::vector<unsigned char> idat;
+  std::vector<unsigned char> png;
+};
+
+// Greedy LZ77 with hash chains over a window of MAX_DISTANCE bytes
+void findMatches(const unsigned char* data, size_t size, PngScratch& s)
+{
+  const size_t mask = MAX_DISTANCE - 1;
+  s.head.assign((size_t)1 << HASH_BITS, -1);
+  s.prev.resize(MAX_DISTANCE);
+  s.tokens.clear();
+
+  size_t pos = 0;
+  while(pos < size)
+  {
+    unsigned int best = 0;
+    size_t distance   = 0;
+    if(pos + MIN_MATCH <= size)
+    {
+      const unsigned int h  = hash3(data + pos);
+      const size_t limit    = std::min((size_t)MAX_MATCH, size - pos);
+      int candidate         = s.head[h];
+      for(unsigned int chain = 0; candidate >= 0 && chain < MAX_CHAIN; chain++)
+      {
+        const size_t d = pos - candidate;
+        if(d > MAX_DISTANCE) break;
+        // a longer match has to agree at the end of the best one first
+        if(best == 0 || (best < limit && data[candidate + best] == data[pos + best]))
+        {
+          const unsigned char* a = data + pos;
+          const unsigned char* b = data + candidate;
+          unsigned int len = 0;
+          while(len < limit && a[len] == b[len]) len++;
+          if(len > best)
+          {
+            best     = len;
+            distance = d;
+            if(len >= NICE_MATCH || len == limit) break;
+          }
+        }
+        // entries older than the window may have been overwritten by newer positions
+        const int next = s.prev[candidate & mask];
+        if(next >= candidate) break;
+        candidate = next;
+      }
+      s.prev[pos & mask] = s.head[h];
+      s.head[h]          = (int)pos;
+    }
+
+    if(best < MIN_MATCH)
+    {
+      DeflateToken t = { data[pos], 0, 0, 0 };
+      s.tokens.push_back(t);
+      pos++;
+      continue;
+    }
+    DeflateToken t = { (unsigned short)best, (unsigned short)distance, (unsigned char)deflateTables().lengthSymbol[best],
+                       (unsigned char)distanceSymbol((unsigned int)distance) };
+    s.tokens.push_back(t);
+    const size_t end = pos + best;
+    for(pos++; pos < end; pos++)
+    {
+      if(pos + MIN_MATCH > size) continue;
+      const unsigned int h = hash3(data + pos);
+      s.prev[pos & mask]   = s.head[h];
+      s.head[h]            = (int)pos;
+    }
+  }
+}
+
+/**
+ * @brief zlib stream of one deflate block
+ *
+ * Uses dynamic Huffman codes built from the symbol frequencies of the image,
+ * or the fixed codes if they come out shorter.
+ */
+void deflate(const unsigned char* data, size_t size, PngScratch& s)
+{
+  const DeflateTables& t = deflateTables();
+  findMatches(data, size, s);
+
+  unsigned int litFreq[LITERALS] = { 0 }, distFreq[DISTANCES] = { 0 };
+  unsigned long long extraBits = 0;
+  for(size_t i = 0; i < s.tokens.size(); i++)
+  {
+    const DeflateToken& token = s.tokens[i];
+    if(!token.distance)
+    {
+      litFreq[token.value]++;
+      continue;
+    }
+    const unsigned int ls = token.lengthSymbol;
+    const unsigned int ds = token.distanceSymbol;
+    litFreq[257 + ls]++;
+    distFreq[ds]++;
+    extraBits += LENGTH_EXTRA[ls] + DIST_EXTRA[ds];
+  }
+  litFreq[256] = 1;
+
+  unsigned char lengths[LITERALS + DISTANCES];
+  huffmanLengths(litFreq, LITERALS, 15, lengths);
+  huffmanLengths(distFreq, DISTANCES, 15, lengths + LITERALS);
+  int hlit = LITERALS, hdist = DISTANCES;
+  while(hlit > 257 && !lengths[hlit - 1]) hlit--;
+  while(hdist > 1 && !lengths[LITERALS + hdist - 1]) hdist--;
+
+  // code lengths of both codes as one sequence, run length encoded with the symbols 16, 17 and 18
+  unsigned char sequence[LITERALS + DISTANCES];
+  std::memcpy(sequence, lengths, hlit);
+  std::memcpy(sequence + hlit, lengths + LITERALS, hdist);
+  const int count = hlit + hdist;
+  std::vector<std::pair<unsigned char, unsigned char> > runs; // symbol, repeat count minus its base
+  unsigned int clFreq[CODE_LENGTHS] = { 0 };
+  for(int i = 0; i < count; )
+  {
+    const unsigned char len = sequence[i];
+    int run = 1;
+    while(i + run < count && sequence[i + run] == len) run++;
+    i += run;
+    if(len == 0)
+    {
+      for(; run >= 11; run -= std::min(run, 138))
+        runs.push_back(std::make_pair((unsigned char)18, (unsigned char)(std::min(run, 138) - 11)));
+      if(run >= 3)
+      {
+        runs.push_back(std::make_pair((unsigned char)17, (unsigned char)(run - 3)));
+        run = 0;
+      }
+    }
+    else
+    {
+      runs.push_back(std::make_pair(len, (unsigned char)0));
+      for(run--; run >= 3; run -= std::min(run, 6))
+        runs.push_back(std::make_pair((unsigned char)16, (unsigned char)(std::min(run, 6) - 3)));
+    }
+    for(; run > 0; run--)
+      runs.push_back(std::make_pair(len, (unsigned char)0));
+  }
+  for(size_t i = 0; i < runs.size(); i++)
+    clFreq[runs[i].first]++;
+  unsigned char clLengths[CODE_LENGTHS];
+  huffmanLengths(clFreq, CODE_LENGTHS, 7, clLengths);
+  int hclen = CODE_LENGTHS;
+  while(hclen > 4 && !clLengths[CODE_LENGTH_ORDER[hclen - 1]]) hclen--;
+
+  // sizes of the block with both codes, the symbols of extra bits cost the same
+  unsigned long long dynamicBits = 17 + 3 * (unsigned long long)hclen, fixedBits = 3;
+  for(int i = 0; i < LITERALS; i++)
+  {
+    dynamicBits += (unsigned long long)litFreq[i] * lengths[i];
+    fixedBits   += (unsigned long long)litFreq[i] * t.fixedLengths[i];
+  }
+  for(int i = 0; i < DISTANCES; i++)
+  {
+    dynamicBits += (unsigned long long)distFreq[i] * lengths[LITERALS + i];
+    fixedBits   += (unsigned long long)distFreq[i] * 5;
+  }
+  for(size_t i = 0; i < runs.size(); i++)
+  {
+    const unsigned char symbol = runs[i].first;
+    dynamicBits += clLengths[symbol] + (symbol == 16 ? 2 : symbol == 17 ? 3 : symbol == 18 ? 7 : 0);
+  }
+  const bool dynamic = dynamicBits + extraBits < fixedBits + extraBits;
+
+  DeflateCode litCodes[288], distCodes[DISTANCES];
+  if(dynamic)
+  {
+    canonicalCodes(lengths, LITERALS, litCodes);
+    canonicalCodes(lengths + LITERALS, DISTANCES, distCodes);
+  }
+  else
+  {
+    const unsigned char fixedDistances[DISTANCES] = { 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5 };
+    canonicalCodes(t.fixedLengths, 288, litCodes);
+    canonicalCodes(fixedDistances, DISTANCES, distCodes);
+  }
+
+  s.idat.clear();
+  s.idat.reserve((size_t)((std::min(dynamicBits, fixedBits) + extraBits) / 8) + 64);
+  s.idat.push_back(0x78);
+  s.idat.push_back(0x01);
+  BitWriter bits(s.idat);
+  bits.put(1, 1); // last block
+  if(dynamic)
+  {
+    bits.put(2, 2);
+    bits.put(hlit - 257, 5);
+    bits.put(hdist - 1, 5);
+    bits.put(hclen - 4, 4);
+    for(int i = 0; i < hclen; i++)
+      bits.put(clLengths[CODE_LENGTH_ORDER[i]], 3);
+    DeflateCode clCodes[CODE_LENGTHS];
+    canonicalCodes(clLengths, CODE_LENGTHS, clCodes);
+    for(size_t i = 0; i < runs.size(); i++)
+    {
+      const unsigned char symbol = runs[i].first;
+      bits.put(clCodes[symbol]);
+      if(symbol == 16)      bits.put(runs[i].second, 2);
+      else if(symbol == 17) bits.put(runs[i].second, 3);
+      else if(symbol == 18) bits.put(runs[i].second, 7);
+    }
+  }
+  else
+  {
+    bits.put(1, 2);
+  }
+
+  for(size_t i = 0; i < s.tokens.size(); i++)
+  {
+    const DeflateToken& token = s.tokens[i];
+    if(!token.distance)
+    {
+      bits.put(litCodes[token.value]);
+      continue;
+    }
+    const unsigned int ls = token.lengthSymbol;
+    const unsigned int ds = token.distanceSymbol;
+    bits.put(litCodes[257 + ls]);
+    bits.put(token.value - LENGTH_BASE[ls], LENGTH_EXTRA[ls]);
+    bits.put(distCodes[ds]);
+    bits.put(token.distance - DIST_BASE[ds], DIST_EXTRA[ds]);
+  }
+  bits.put(litCodes[256]);
+  bits.flush();
+
+  // Adler-32, sums reduced before they can overflow
+  unsigned int a = 1, b = 0;
+  for(size_t i = 0; i < size; )
+  {
+    const size_t end = std::min(size, i + 5552);
+    for(; i < end; i++)
+    {
+      a += data[i];
+      b += a;
+    }
+    a %= 65521;
+    b %= 65521;
+  }
+  const unsigned int adler = (b << 16) | a;
+  for(int sh = 24; sh >= 0; sh -= 8) s.idat.push_back((unsigned char)(adler >> sh));
+}
+
+inline unsigned char paeth(int a, int b, int c)
+{
+  const int p  = a + b - c;
+  const int pa = std::abs(p - a);
+  const int pb = std::abs(p - b);
+  const int pc = std::abs(p - c);
+  return (unsigned char)(pa <= pb && pa <= pc ? a : pb <= pc ? b : c);
+}
+
+/**
+ * @brief Filters every row with the type giving the smallest sum of absolute differences, see PNG 12.8
+ */
+void filterRows(const unsigned char* rgb, int w, int h, PngScratch& s)
+{
+  const size_t line   = (size_t)w * 3;
+  const size_t stride = 1 + line;
+  s.rows.resize(stride * h);
+  s.candidates.resize(5 * line);
+  const std::vector<unsigned char> zeros(line + 3, 0);
+
+  for(int y = 0; y < h; y++)
+  {
+    const unsigned char* row = rgb + y * line;
+    const unsigned char* up  = y ? row - line : &zeros[0];
+    unsigned char* f = &s.candidates[0];
+    unsigned int sums[5] = { 0 };
+    for(size_t i = 0; i < line; i++)
+    {
+      const int left   = i >= 3 ? row[i - 3] : 0;
+      const int upLeft = i >= 3 ? up[i - 3] : 0;
+      const signed char d[5] = { (signed char)row[i], (signed char)(row[i] - left), (signed char)(row[i] - up[i]),
+                                 (signed char)(row[i] - ((left + up[i]) >> 1)), (signed char)(row[i] - paeth(left, up[i], upLeft)) };
+      for(int type = 0; type < 5; type++)
+      {
+        f[type * line + i] = (unsigned char)d[type];
+        sums[type]        += (unsigned int)std::abs((int)d[type]);
+      }
+    }
+    const int best = (int)(std::min_element(sums, sums + 5) - sums);
+    s.rows[y * stride] = (unsigned char)best;
+    std::memcpy(&s.rows[y * stride + 1], f + best * line, line);
+  }
+}
+
+void putBigEndian(std::vector<unsigned char>& out, unsigned int value)
+{
+  for(int s = 24; s >= 0; s -= 8) out.push_back((unsigned char)(value >> s));
+}
+
+void putChunk(std::vector<unsigned char>& out, const char* type, const unsigned char* data, size_t size)
+{
+  putBigEndian(out, (unsigned int)size);
+  out.insert(out.end(), type, type + 4);
+  if(size) out.insert(out.end(), data, data + size);
+  putBigEndian(out, recordingCrc32(data, size, recordingCrc32(type, 4)));
+}
+
+/**
+ * @brief Encodes an interleaved RGB image as PNG into s.png
+ * @param[in] rgb image (size of 3 * w * h)
+ * @param[in,out] s scratch buffers, s.png receives the file content
+ */
+void encodePng(const unsigned char* rgb, int w, int h, PngScratch& s)
+{
+  filterRows(rgb, w, h, s);
+  deflate(&s.rows[0], s.rows.size(), s);
+
+  static const unsigned char SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+  s.png.assign(SIGNATURE, SIGNATURE + 8);
+  std::vector<unsigned char> header;
+  putBigEndian(header, (unsigned int)w);
+  putBigEndian(header, (unsigned int)h);
+  const unsigned char format[5] = { 8, 2, 0, 0, 0 }; // 8 bit RGB, deflate, no interlacing
+  header.insert(header.end(), format, format + 5);
+  putChunk(s.png, "IHDR", &header[0], header.size());
+  putChunk(s.png, "IDAT", &s.idat[0], s.idat.size());
+  putChunk(s.png, "IEND", nullptr, 0);
+}
+
+} // namespace
+
+//------------------------------------------------------------------------------
+
+class EvoIRBatchRender
+{
+public:
+  EvoIRBatchRender(const EvoIRRenderParams& params, const char* outPath) :
+    _params(params),
+    _outPath(outPath),
+    _mapId(0),
+    _mapped(false),
+    _width(0),
+    _height(0),
+    _frames(0),
+    _threadCount(0),
+    _radiation(false),
+    _rendered(0),
+    _failed(0),
+    _steals(0),
+    _running(0),
+    _cancel(false),
+    _seconds(0.0)
+  { }
+
+  ~EvoIRBatchRender()
+  {
+    cancel();
+    join();
+    if(_mapped) evo_irimager_recording_map_close(_mapId);
+  }
+
+  bool start(const char* recordingPath)
+  {
+    if(evo_irimager_recording_map_open(&_mapId, recordingPath, 1) != 0) return false;
+    _mapped = true;
+    EvoIRRecordingInfo info;
+    evo_irimager_recording_map_get_info(_mapId, &info);
+    _width  = info.width;
+    _height = info.height;
+    if(_params.first >= info.frames) return false;
+    const unsigned long long available = info.frames - _params.first;
+    if(_params.count > available) return false;
+    _frames = _params.count ? _params.count : (unsigned int)available;
+
+    // the raw file is created here, the threads write their frames at fixed positions
+    if(_params.output == EVO_RENDER_RAW_RGB)
+    {
+      FILE* f = fopen(_outPath.c_str(), "wb");
+      if(!f) return false;
+      fclose(f);
+    }
+    _radiation = radiationTable(_params, _table);
+
+    unsigned int threads = _params.threads ? _params.threads : std::thread::hardware_concurrency();
+    threads = std::max(1u, std::min(std::min(threads, MAX_THREADS), _frames));
+    _threadCount = threads;
+    _shards.reset(new std::atomic<unsigned long long>[threads]);
+    for(unsigned int i = 0; i < threads; i++)
+    {
+      const unsigned int begin = _params.first + (unsigned int)((unsigned long long)_frames * i / threads);
+      const unsigned int end   = _params.first + (unsigned int)((unsigned long long)_frames * (i + 1) / threads);
+      _shards[i].store(packShard(begin, end));
+    }
+
+    _t0 = std::chrono::steady_clock::now();
+    _running.store(threads);
+    for(unsigned int i = 0; i < threads; i++)
+      _threads.push_back(std::thread(&EvoIRBatchRender::work, this, i));
+    return true;
+  }
+
+  void progress(EvoIRRenderProgress* progress)
+  {
+    progress->frames   = _frames;
+    progress->rendered = _rendered.load();
+    progress->failed   = _failed.load();
+    progress->threads  = _threadCount;
+    progress->steals   = _steals.load();
+    std::lock_guard<std::mutex> lock(_doneMutex);
+    progress->done     = _running.load() == 0 ? 1 : 0;
+    progress->seconds  = progress->done ? _seconds
+                                        : std::chrono::duration<double>(std::chrono::steady_clock::now() - _t0).count();
+  }
+
+  /**
+   * Makes the threads stop after their current frame, so that waiting callers return
+   */
+  void cancel()
+  {
+    _cancel.store(true);
+  }
+
+  bool wait(EvoIRRenderProgress* result)
+  {
+    {
+      std::unique_lock<std::mutex> lock(_doneMutex);
+      _doneCondition.wait(lock, [this]() { return _running.load() == 0; });
+    }
+    join();
+    EvoIRRenderProgress p;
+    progress(&p);
+    if(result) *result = p;
+    return p.failed == 0 && p.rendered == p.frames;
+  }
+
+private:
+  EvoIRBatchRender(const EvoIRBatchRender&);
+  EvoIRBatchRender& operator=(const EvoIRBatchRender&);
+
+  void join()
+  {
+    std::lock_guard<std::mutex> lock(_controlMutex);
+    for(size_t i = 0; i < _threads.size(); i++)
+      if(_threads[i].joinable()) _threads[i].join();
+  }
+
+  // Takes the next chunk from the front of the own shard
+  bool take(unsigned int self, unsigned int* begin, unsigned int* end)
+  {
+    unsigned long long shard = _shards[self].load();
+    for(;;)
+    {
+      const unsigned int b = shardBegin(shard);
+      const unsigned int e = shardEnd(shard);
+      if(b >= e) return false;
+      const unsigned int n = std::min(std::max(_params.chunk, 1u), e - b);
+      if(_shards[self].compare_exchange_weak(shard, packShard(b + n, e)))
+      {
+        *begin = b;
+        *end   = b + n;
+        return true;
+      }
+    }
+  }
+
+  // Moves the back half of the largest shard into the own one
+  bool steal(unsigned int self)
+  {
+    for(;;)
+    {
+      unsigned int victim = self;
+      unsigned int most   = 0;
+      unsigned long long shard = 0;
+      for(unsigned int i = 0; i < _threadCount; i++)
+      {
+        const unsigned long long s = _shards[i].load();
+        const unsigned int remaining = shardEnd(s) > shardBegin(s) ? shardEnd(s) - shardBegin(s) : 0;
+        if(i != self && remaining > most)
+        {
+          most   = remaining;
+          victim = i;
+          shard  = s;
+        }
+      }
+      if(most == 0) return false;
+      const unsigned int mid = shardEnd(shard) - (most + 1) / 2;
+      if(_shards[victim].compare_exchange_strong(shard, packShard(shardBegin(shard), mid)))
+      {
+        _shards[self].store(packShard(mid, shardEnd(shard)));
+        _steals.fetch_add(1);
+        return true;
+      }
+    }
+  }
+
+  void work(unsigned int self)
+  {
+    const size_t pixels = (size_t)_width * _height;
+    std::vector<unsigned short> data(pixels);
+    std::vector<unsigned char> rgb(3 * pixels);
+    PngScratch png;
+    FILE* raw = nullptr;
+    if(_params.output == EVO_RENDER_RAW_RGB) raw = fopen(_outPath.c_str(), "r+b");
+
+    unsigned int begin, end;
+    while(!_cancel.load(std::memory_order_relaxed))
+    {
+      if(!take(self, &begin, &end))
+      {
+        if(!steal(self)) break;
+        continue;
+      }
+      for(unsigned int i = begin; i < end && !_cancel.load(std::memory_order_relaxed); i++)
+      {
+        if(render(i, &data[0], &rgb[0]) && write(i, &rgb[0], raw, png))
+          _rendered.fetch_add(1, std::memory_order_relaxed);
+        else
+          _failed.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+    if(raw) fclose(raw);
+
+    std::lock_guard<std::mutex> lock(_doneMutex);
+    if(_running.fetch_sub(1) == 1)
+    {
+      _seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _t0).count();
+      _doneCondition.notify_all();
+    }
+  }
+
+  bool render(unsigned int index, unsigned short* data, unsigned char* rgb)
+  {
+    EvoIRFrameMetadata metadata;
+    if(evo_irimager_recording_map_read_frame(_mapId, index, data, &metadata) != 0) return false;
+    if(_radiation)
+    {
+      const size_t n = (size_t)_width * _height;
+      for(size_t k = 0; k < n; k++) data[k] = _table[data[k]];
+    }
+    return evo_irimager_palette_render(data, _width, _height, _params.paletteId, _params.scale, _params.tMin, _params.tMax,
+                                       _params.decimalPlaces, EVO_PALETTE_INTERLEAVED, rgb) == 0;
+  }
+
+  bool write(unsigned int index, const unsigned char* rgb, FILE* raw, PngScratch& png)
+  {
+    const size_t size = (size_t)_width * _height * 3;
+    if(_params.output == EVO_RENDER_RAW_RGB)
+      return raw && recordingSeek(raw, (unsigned long long)(index - _params.first) * size) == 0 && fwrite(rgb, 1, size, raw) == size;
+
+    encodePng(rgb, _width, _height, png);
+    char name[32];
+    std::snprintf(name, sizeof(name), "%06u.png", index);
+    FILE* f = fopen((_outPath + name).c_str(), "wb");
+    if(!f) return false;
+    const bool ok = fwrite(&png.png[0], 1, png.png.size(), f) == png.png.size();
+    return (fclose(f) == 0) && ok;
+  }
+
+  EvoIRRenderParams _params;
+  std::string _outPath;
+  unsigned int _mapId;
+  bool _mapped;
+  int _width;
+  int _height;
+  unsigned int _frames;
+  unsigned int _threadCount;
+  bool _radiation;
+  std::vector<unsigned short> _table;
+  std::unique_ptr<std::atomic<unsigned long long>[]> _shards;
+
+  std::atomic<unsigned int> _rendered;
+  std::atomic<unsigned int> _failed;
+  std::atomic<unsigned int> _steals;
+  std::atomic<unsigned int> _running;
+  std::atomic<bool> _cancel;
+
+  std::mutex _controlMutex;
+  std::vector<std::thread> _threads;
+  std::chrono::steady_clock::time_point _t0;
+  std::mutex _doneMutex;
+  std::condition_variable _doneCondition;
+  double _seconds;
+};
+
+static EvoIRHandleTable<EvoIRBatchRender> g_renders;
+typedef EvoIRHandleTable<EvoIRBatchRender>::Ref RenderRef;
+
+} // namespace evo
+
+using namespace evo;
+
+void evo_irimager_render_default_params(EvoIRRenderParams* params)
+{
+  if(!params) return;
+  params->paletteId              = 6;
+  params->scale                  = 2;
+  params->tMin                   = 20.f;
+  params->tMax                   = 40.f;
+  params->decimalPlaces          = 1;
+  params->emissivity             = 1.f;
+  params->transmissivity         = 1.f;
+  params->tAmbient               = 20.f;
+  params->recordedEmissivity     = 1.f;
+  params->recordedTransmissivity = 1.f;
+  params->recordedTAmbient       = 20.f;
+  params->output                 = EVO_RENDER_PNG;
+  params->first                  = 0;
+  params->count                  = 0;
+  params->threads                = 0;
+  params->chunk                  = 4;
+}
+
+int evo_irimager_render_start(unsigned int* outRenderId, const char* recordingPath, const char* outPath, const EvoIRRenderParams* params)
+{
+  if(!outRenderId || !recordingPath || !outPath || !params) return -1;
+  if(params->paletteId < 1 || params->paletteId > 11 || params->scale < 1 || params->scale > 4) return -1;
+  if(params->scale == 1 && !(params->tMin < params->tMax)) return -1;
+  if(params->decimalPlaces < 1 || params->decimalPlaces > 4 || params->chunk == 0) return -1;
+  if(params->output != EVO_RENDER_PNG && params->output != EVO_RENDER_RAW_RGB) return -1;
+  if(!(params->emissivity > 0.f && params->emissivity <= 1.f) || !(params->transmissivity > 0.f && params->transmissivity <= 1.f)) return -1;
+  if(!(params->recordedEmissivity > 0.f && params->recordedEmissivity <= 1.f)
+     || !(params->recordedTransmissivity > 0.f && params->recordedTransmissivity <= 1.f))
+    return -1;
+
+  EvoIRBatchRender* render = new EvoIRBatchRender(*params, outPath);
+  if(!render->start(recordingPath) || !g_renders.insert(render, outRenderId))
+  {
+    delete render;
+    return -1;
+  }
+  return 0;
+}
+
+int evo_irimager_render_get_progress(const unsigned int renderId, EvoIRRenderProgress* progress)
+{
+  RenderRef render = g_renders.acquire(renderId);
+  if(!render || !progress) return -1;
+  render->progress(progress);
+  return 0;
+}
+
+int evo_irimager_render_wait(const unsigned int renderId, EvoIRRenderProgress* progress)
+{
+  RenderRef render = g_renders.acquire(renderId);
+  if(!render) return -1;
+  return render->wait(progress) ? 0 : -1;
+}
+
+int evo_irimager_render_destroy(const unsigned int renderId)
+{
+  {
+    // callers waiting for the job hold references, cancel it before remove waits for the references
+    RenderRef render = g_renders.acquire(renderId);
+    if(!render) return -1;
+    render->cancel();
+  }
+  EvoIRBatchRender* render = g_renders.remove(renderId);
+  if(!render) return -1;
+  delete render;
+  return 0;
+}
@@ -0,0 +1,141 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRBatchRender.h
+ * @brief Provides parallel offline rendering of recordings to false color images for Easy API C-Library Interface
+ *
+ * Re-renders a recording (see EvoIRRecording.h) with the settings known from
+ * evo_irimager_set_palette, evo_irimager_set_palette_scale,
+ * evo_irimager_set_palette_manual_temp_range and
+ * evo_irimager_set_radiation_parameters, on all processor cores and
+ * independent of a camera:
+ *
+ * - EVO_RENDER_PNG writes one RGB PNG per frame, <prefix><frame index, 6 digits>.png
+ * - EVO_RENDER_RAW_RGB writes all frames to a single file of interleaved
+ *   r,g,b images without header, e.g. for
+ *   ffmpeg -f rawvideo -pix_fmt rgb24 -s <w>x<h> -r <framerate> -i <file> video.mp4
+ *
+ * The frame range is split into one contiguous shard per thread. Threads take
+ * small chunks from the front of their shard and, once it is exhausted, steal
+ * the back half of the largest remaining shard. Each frame is rendered
+ * completely by one thread, so the statistics of the scaling methods and
+ * therefore the output do not depend on the number of threads.
+ *
+ * Changed radiation parameters are applied to the raw values before scaling.
+ * The recording holds object temperatures calculated by the camera with the
+ * parameters recorded*, which are converted back to the detected radiation and
+ * then into object temperatures with the new parameters. Radiation is modeled
+ * proportional to T^4 (T in Kelvin), an approximation of the spectral
+ * response of the camera that is sufficient for moderate corrections.
+ *
+ * @code
+ * EvoIRRenderParams params;
+ * evo_irimager_render_default_params(&params);
+ * params.paletteId  = 6;
+ * params.emissivity = 0.95f;
+ * evo_irimager_render_start(&renderId, "C:/rec/oven.evoir", "C:/rec/oven_", &params);
+ * EvoIRRenderProgress progress;
+ * evo_irimager_render_wait(renderId, &progress);
+ * evo_irimager_render_destroy(renderId);
+ * @endcode
+ */
+
+#ifndef EVOIRBATCHRENDER_H_
+#define EVOIRBATCHRENDER_H_
+
+#include "irdirectsdk_defs.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Output formats of the batch renderer
+ */
+typedef enum
+{
+  EVO_RENDER_PNG     = 0, /*!< One PNG file per frame */
+  EVO_RENDER_RAW_RGB = 1  /*!< All frames in one file, 3 * w * h bytes each */
+} EvoIRRenderOutput;
+
+typedef struct __IRDIRECTSDK_API__ EvoIRRenderParams
+{
+  int paletteId;                /*!< Palette id, see evo_irimager_set_palette */
+  int scale;                    /*!< Scaling method id, see evo_irimager_set_palette_scale */
+  float tMin;                   /*!< Minimum temperature for eManual */
+  float tMax;                   /*!< Maximum temperature for eManual */
+  short decimalPlaces;          /*!< Decimal places of raw values in the recording [1; 4] */
+  float emissivity;             /*!< Emissivity of the object to render with (0; 1] */
+  float transmissivity;         /*!< Transmissivity to render with (0; 1] */
+  float tAmbient;               /*!< Ambient temperature in degree Celsius to render with */
+  float recordedEmissivity;     /*!< Emissivity the camera used when recording */
+  float recordedTransmissivity; /*!< Transmissivity the camera used when recording */
+  float recordedTAmbient;       /*!< Ambient temperature the camera used when recording */
+  int output;                   /*!< see EvoIRRenderOutput */
+  unsigned int first;           /*!< Index of first frame to render */
+  unsigned int count;           /*!< Number of frames to render, 0 for all frames from first on */
+  unsigned int threads;         /*!< Number of threads, 0 for one per processor core */
+  unsigned int chunk;           /*!< Frames a thread takes from its shard at once */
+} EvoIRRenderParams;
+
+typedef struct __IRDIRECTSDK_API__ EvoIRRenderProgress
+{
+  unsigned int frames;   /*!< Frames to render */
+  unsigned int rendered; /*!< Frames rendered and written */
+  unsigned int failed;   /*!< Frames that could not be read or written */
+  unsigned int threads;  /*!< Threads working on the recording */
+  unsigned int steals;   /*!< Chunks taken from the shard of another thread */
+  int done;              /*!< 1 if all threads have finished */
+  double seconds;        /*!< Time since start, until completion if done */
+} EvoIRRenderProgress;
+
+/**
+ * @brief Fills parameter structure with defaults (palette Iron, eMinMax scaling, one decimal place,
+ * radiation parameters unchanged, PNG output, all frames, one thread per core, chunks of 4 frames)
+ * @param[out] params parameter structure
+ */
+__IRDIRECTSDK_API__ void evo_irimager_render_default_params(EvoIRRenderParams* params);
+
+/**
+ * @brief Starts rendering a recording in the background
+ * @param[out] outRenderId render job instance id for reference
+ * @param[in] recordingPath path of recording
+ * @param[in] outPath path and beginning of the file names for EVO_RENDER_PNG, path of the file for EVO_RENDER_RAW_RGB
+ * @param[in] params render parameters
+ * @return 0 on success, -1 on error (invalid parameters, recording not readable, frame range outside of recording, output not writable)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_render_start(unsigned int* outRenderId, const char* recordingPath, const char* outPath, const EvoIRRenderParams* params);
+
+/**
+ * @brief Accessor to the progress of a render job
+ * @param[in] renderId render job instance id from start to apply this function
+ * @param[out] progress pointer to EvoIRRenderProgress allocate by the user
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_render_get_progress(const unsigned int renderId, EvoIRRenderProgress* progress);
+
+/**
+ * @brief Waits for a render job to finish
+ * @param[in] renderId render job instance id from start to apply this function
+ * @param[out] progress pointer to EvoIRRenderProgress allocate by the user, may be NULL
+ * @return 0 if all frames were rendered, -1 on error or if frames failed
+ */
+__IRDIRECTSDK_API__ int evo_irimager_render_wait(const unsigned int renderId, EvoIRRenderProgress* progress);
+
+/**
+ * @brief Cancels a render job if still running and releases it
+ * @param[in] renderId render job instance id from start to apply this function
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_render_destroy(const unsigned int renderId);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* EVOIRBATCHRENDER_H_ */
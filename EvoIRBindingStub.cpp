@@ -0,0 +1,646 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRBindingStub.cpp
+ * @brief Stand-in for direct_binding.h serving synthetic or recorded frames
+ *
+ * Implements all functions of direct_binding.h, single and multi camera, so
+ * that code written against the Easy API, e.g. the MEX gateway, the tools or
+ * the replay benchmark, can be built and checked on machines without
+ * libirimager or a camera. Link this file instead of the library. Cameras
+ * serve the frames described by the replay parameters (EvoIRReplay.h), by
+ * default synthetic frames in real time at 80 Hz with the resolution of a
+ * PI 400 (382 x 288).
+ *
+ * Every camera owns its source (synthetic source or recording playback) and a
+ * scratch image for palette-only calls, both created on init. The single
+ * camera functions forward to the multi camera functions with the camera
+ * created by evo_irimager_usb_init.
+ */
+
+#include "EvoIRReplay.h"
+#include "direct_binding.h"
+#include "EvoIRFormatPlan.h"
+#include "EvoIRHandleTable.h"
+#include "EvoIRPalette.h"
+#include "EvoIRRecording.h"
+#include "EvoIRSyntheticSource.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace evo
+{
+
+namespace
+{
+
+const short DECIMAL_PLACES = 1;
+const char* const DEFAULT_FORMATS_DEF = "Formats.def";
+
+void toPlatformOrder(unsigned char* data, size_t pixels)
+{
+#if _WIN32
+  // the library delivers b,g,r on Windows
+  for(size_t i = 0; i < pixels; i++)
+  {
+    const unsigned char r = data[3 * i];
+    data[3 * i]     = data[3 * i + 2];
+    data[3 * i + 2] = r;
+  }
+#else
+  (void)data; (void)pixels;
+#endif
+}
+
+/**
+ * Size and frame rate of channel 0 of a format of Formats.def
+ */
+bool formatSize(const char* formats_def, int index, int* w, int* h, float* framerate)
+{
+  unsigned int formatsId;
+  if(evo_irimager_formats_load(&formatsId, (formats_def && *formats_def) ? formats_def : DEFAULT_FORMATS_DEF) != 0) return false;
+  EvoIRFormatChannel channel;
+  const bool ok = evo_irimager_formats_get_channel(formatsId, (unsigned int)index, 0, &channel) == 0;
+  evo_irimager_formats_release(formatsId);
+  if(!ok) return false;
+  *w         = channel.width;
+  *h         = channel.height;
+  *framerate = channel.framerate;
+  return true;
+}
+
+} // namespace
+
+class ReplayCamera
+{
+public:
+  ReplayCamera() : _synthetic(false), _srcId(0), _recId(0), _width(0), _height(0), _serial(0), _loop(false), _realtime(false),
+                   _frameLimit(-1), _delivered(0), _next(0), _frames(0), _timestampFirst(0), _timestampSpan(0), _counterSpan(0), _counterOffset(0),
+                   _timestampOffset(0), _paletteId(6), _scale(2), _tMin(20.f), _tMax(100.f), _focus(50.f) { }
+
+  ~ReplayCamera()
+  {
+    if(_width == 0) return;
+    if(_synthetic) evo_irimager_synthetic_terminate(_srcId);
+    else           evo_irimager_recording_close(_recId);
+  }
+
+  bool init(const EvoIRReplayParams& params, const char* formats_def)
+  {
+    static std::atomic<unsigned long> instances(0);
+    _serial     = params.serial ? params.serial : ++instances;
+    _realtime   = params.realtime != 0;
+    _loop       = params.loop != 0;
+    _frameLimit = params.frameLimit;
+    if(params.source == EVO_REPLAY_SYNTHETIC)
+    {
+      int w = params.width, h = params.height;
+      float framerate = params.framerate;
+      if(params.formatIndex >= 0 && !formatSize(formats_def, params.formatIndex, &w, &h, &framerate)) return false;
+      EvoIRSyntheticParams synthetic;
+      evo_irimager_synthetic_default_params(&synthetic, w, h, framerate);
+      synthetic.realtime = params.realtime;
+      synthetic.seed     = params.seed;
+      if(evo_irimager_synthetic_init(&_srcId, &synthetic) != 0) return false;
+      _synthetic = true;
+      _width     = w;
+      _height    = h;
+    }
+    else
+    {
+      EvoIRRecordingInfo info;
+      if(evo_irimager_recording_open(&_recId, params.recording) != 0) return false;
+      if(evo_irimager_recording_get_info(_recId, &info) != 0 || info.frames == 0)
+      {
+        evo_irimager_recording_close(_recId);
+        return false;
+      }
+      _width  = info.width;
+      _height = info.height;
+      _frames = info.frames;
+
+      // a loop continues counters and timestamps one frame after the last
+      _thermal.resize((size_t)_width * _height);
+      EvoIRFrameMetadata first, last;
+      int w = _width, h = _height;
+      if(evo_irimager_recording_read_frame(_recId, 0, &w, &h, &_thermal[0], &first) != 0 ||
+         evo_irimager_recording_read_frame(_recId, _frames - 1, &w, &h, &_thermal[0], &last) != 0)
+        return false;
+      const long long period = info.framerate > 0.f ? (long long)(1e7 / info.framerate) : 0;
+      _timestampFirst = first.timestamp;
+      _timestampSpan  = last.timestamp - first.timestamp + period;
+      _counterSpan    = last.counter - first.counter + 1;
+    }
+    _thermal.resize((size_t)_width * _height);
+    _start = std::chrono::steady_clock::now();
+    return true;
+  }
+
+  int width() const  { return _width; }
+  int height() const { return _height; }
+  unsigned long serial() const { return _serial; }
+
+  /**
+   * Grabs the next frame into thermal and/or palette, either may be NULL
+   */
+  int grab(unsigned short* thermal, unsigned char* palette, EvoIRFrameMetadata* metadata)
+  {
+    // recorded frames are due at their recorded time, waited for without the lock so that terminate and setters are not held up
+    std::chrono::steady_clock::time_point due;
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      EvoIRFrameMetadata local;
+      if(!thermal) thermal = &_thermal[0];
+      if(!metadata) metadata = &local;
+      if(_frameLimit >= 0 && _delivered == (unsigned long long)_frameLimit) return -1;
+      int w = _width, h = _height;
+      if(_synthetic)
+      {
+        if(evo_irimager_synthetic_get_thermal_image_metadata(_srcId, &w, &h, thermal, metadata) != 0) return -1;
+      }
+      else if(readRecorded(thermal, metadata, &due) != 0)
+      {
+        return -1;
+      }
+      if(palette)
+      {
+        if(evo_irimager_palette_render(thermal, w, h, _paletteId, _scale, _tMin, _tMax, DECIMAL_PLACES, EVO_PALETTE_INTERLEAVED, palette) != 0)
+          return -1;
+        toPlatformOrder(palette, (size_t)w * h);
+      }
+      _delivered++;
+    }
+    if(due > std::chrono::steady_clock::now()) std::this_thread::sleep_until(due);
+    return 0;
+  }
+
+  int setPalette(int paletteId)
+  {
+    if(paletteId < 1 || paletteId > 11) return -1;
+    std::lock_guard<std::mutex> lock(_mutex);
+    _paletteId = paletteId;
+    return 0;
+  }
+
+  int setPaletteScale(int scale)
+  {
+    if(scale < 1 || scale > 4) return -1;
+    std::lock_guard<std::mutex> lock(_mutex);
+    _scale = scale;
+    return 0;
+  }
+
+  int setPaletteRange(float min, float max)
+  {
+    if(!(min < max)) return -1;
+    std::lock_guard<std::mutex> lock(_mutex);
+    _tMin = min;
+    _tMax = max;
+    return 0;
+  }
+
+  int setFocus(float pos)
+  {
+    if(!(pos >= 0.f && pos <= 100.f)) return -1;
+    std::lock_guard<std::mutex> lock(_mutex);
+    _focus = pos;
+    return 0;
+  }
+
+  float focus()
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _focus;
+  }
+
+private:
+  /**
+   * Next recorded frame and the time it is due at in real time, left unchanged otherwise. Caller holds the mutex.
+   */
+  int readRecorded(unsigned short* thermal, EvoIRFrameMetadata* metadata, std::chrono::steady_clock::time_point* due)
+  {
+    if(_next == _frames)
+    {
+      if(!_loop) return -1;
+      _next = 0;
+      _counterOffset   += _counterSpan;
+      _timestampOffset += _timestampSpan;
+    }
+    int w = _width, h = _height;
+    if(evo_irimager_recording_read_frame(_recId, _next++, &w, &h, thermal, metadata) != 0) return -1;
+    metadata->counter        += _counterOffset;
+    metadata->counterHW      += _counterOffset;
+    metadata->timestamp      += _timestampOffset;
+    metadata->timestampMedia += _timestampOffset;
+    if(_realtime)
+    {
+      // timestamps are given in UNITS of 100 ns
+      const long long elapsed = metadata->timestamp - _timestampFirst;
+      *due = _start + std::chrono::microseconds(elapsed / 10);
+    }
+    return 0;
+  }
+
+  ReplayCamera(const ReplayCamera&);
+  ReplayCamera& operator=(const ReplayCamera&);
+
+  std::mutex _mutex;
+  bool _synthetic;
+  unsigned int _srcId;
+  unsigned int _recId;
+  int _width;
+  int _height;
+  unsigned long _serial;
+  bool _loop;
+  bool _realtime;
+  long long _frameLimit;
+  unsigned long long _delivered;
+  unsigned long long _next;
+  unsigned long long _frames;
+  long long _timestampFirst;
+  long long _timestampSpan;
+  unsigned int _counterSpan;
+  unsigned int _counterOffset;
+  long long _timestampOffset;
+  std::chrono::steady_clock::time_point _start;
+  std::vector<unsigned short> _thermal;
+  int _paletteId;
+  int _scale;
+  float _tMin;
+  float _tMax;
+  float _focus;
+};
+
+static EvoIRHandleTable<ReplayCamera> g_cameras;
+typedef EvoIRHandleTable<ReplayCamera>::Ref CameraRef;
+static std::mutex g_paramsMutex;
+static EvoIRReplayParams g_params;
+static bool g_paramsSet = false;
+static std::mutex g_singleMutex;
+static bool g_singleConnected = false;
+static unsigned int g_single = 0;
+
+namespace
+{
+
+bool checkSize(const CameraRef& cam, int w, int h)
+{
+  return cam && w == cam->width() && h == cam->height();
+}
+
+unsigned int singleId()
+{
+  std::lock_guard<std::mutex> lock(g_singleMutex);
+  // an id the table never hands out, if not connected
+  return g_singleConnected ? g_single : ~0u;
+}
+
+} // namespace
+
+} // namespace evo
+
+using namespace evo;
+
+void evo_irimager_replay_default_params(EvoIRReplayParams* params)
+{
+  if(!params) return;
+  std::memset(params, 0, sizeof(*params));
+  params->source      = EVO_REPLAY_SYNTHETIC;
+  params->formatIndex = -1;
+  params->width       = 382;
+  params->height      = 288;
+  params->framerate   = 80.f;
+  params->seed        = 1;
+  params->realtime    = 1;
+  params->frameLimit  = -1;
+}
+
+int evo_irimager_replay_set_params(const EvoIRReplayParams* params)
+{
+  if(!params) return -1;
+  if(params->source == EVO_REPLAY_SYNTHETIC)
+  {
+    if(params->formatIndex < 0 && (params->width <= 0 || params->height <= 0 || !(params->framerate > 0.f))) return -1;
+  }
+  else if(params->source != EVO_REPLAY_RECORDING || !std::memchr(params->recording, 0, EVO_REPLAY_MAX_PATH) || !params->recording[0])
+  {
+    return -1;
+  }
+  std::lock_guard<std::mutex> lock(g_paramsMutex);
+  g_params    = *params;
+  g_paramsSet = true;
+  return 0;
+}
+
+void evo_irimager_replay_get_params(EvoIRReplayParams* params)
+{
+  if(!params) return;
+  std::lock_guard<std::mutex> lock(g_paramsMutex);
+  if(g_paramsSet) *params = g_params;
+  else            evo_irimager_replay_default_params(params);
+}
+
+int evo_irimager_multi_usb_init(unsigned int* outCamId, const char* xml_config, const char* formats_def, const char* log_file)
+{
+  (void)xml_config; (void)log_file;
+  if(!outCamId) return -1;
+  EvoIRReplayParams params;
+  evo_irimager_replay_get_params(&params);
+  ReplayCamera* cam = new ReplayCamera();
+  if(!cam->init(params, formats_def) || !g_cameras.insert(cam, outCamId))
+  {
+    delete cam;
+    return -1;
+  }
+  return 0;
+}
+
+int evo_irimager_multi_tcp_init(unsigned int* outCamId, const char* ip, int port)
+{
+  (void)ip; (void)port;
+  return evo_irimager_multi_usb_init(outCamId, 0, 0, 0);
+}
+
+int evo_irimager_multi_terminate(const unsigned int camId)
+{
+  ReplayCamera* cam = g_cameras.remove(camId);
+  if(!cam) return -1;
+  delete cam;
+  return 0;
+}
+
+int evo_irimager_multi_get_serial(const unsigned int camId, unsigned long* serial)
+{
+  CameraRef cam = g_cameras.acquire(camId);
+  if(!cam || !serial) return -1;
+  *serial = cam->serial();
+  return 0;
+}
+
+int evo_irimager_multi_get_thermal_image_size(const unsigned int camId, int* w, int* h)
+{
+  CameraRef cam = g_cameras.acquire(camId);
+  if(!cam || !w || !h) return -1;
+  *w = cam->width();
+  *h = cam->height();
+  return 0;
+}
+
+int evo_irimager_multi_get_palette_image_size(const unsigned int camId, int* w, int* h)
+{
+  return evo_irimager_multi_get_thermal_image_size(camId, w, h);
+}
+
+int evo_irimager_multi_get_thermal_image(const unsigned int camId, int* w, int* h, unsigned short* data)
+{
+  return evo_irimager_multi_get_thermal_image_metadata(camId, w, h, data, 0);
+}
+
+int evo_irimager_multi_get_thermal_image_metadata(const unsigned int camId, int* w, int* h, unsigned short* data, EvoIRFrameMetadata* metadata)
+{
+  CameraRef cam = g_cameras.acquire(camId);
+  if(!w || !h || !checkSize(cam, *w, *h) || !data) return -1;
+  return cam->grab(data, 0, metadata);
+}
+
+int evo_irimager_multi_get_palette_image(const unsigned int camId, int* w, int* h, unsigned char* data)
+{
+  return evo_irimager_multi_get_palette_image_metadata(camId, w, h, data, 0);
+}
+
+int evo_irimager_multi_get_palette_image_metadata(const unsigned int camId, int* w, int* h, unsigned char* data, EvoIRFrameMetadata* metadata)
+{
+  CameraRef cam = g_cameras.acquire(camId);
+  if(!w || !h || !checkSize(cam, *w, *h) || !data) return -1;
+  return cam->grab(0, data, metadata);
+}
+
+int evo_irimager_multi_get_thermal_palette_image(const unsigned int camId, int w_t, int h_t, unsigned short* data_t, int w_p, int h_p, unsigned char* data_p)
+{
+  return evo_irimager_multi_get_thermal_palette_image_metadata(camId, w_t, h_t, data_t, w_p, h_p, data_p, 0);
+}
+
+int evo_irimager_multi_get_thermal_palette_image_metadata(const unsigned int camId, int w_t, int h_t, unsigned short* data_t, int w_p, int h_p, unsigned char* data_p, EvoIRFrameMetadata* metadata)
+{
+  CameraRef cam = g_cameras.acquire(camId);
+  if(!checkSize(cam, w_t, h_t) || !checkSize(cam, w_p, h_p) || !data_t || !data_p) return -1;
+  return cam->grab(data_t, data_p, metadata);
+}
+
+int evo_irimager_multi_set_palette(const unsigned int camId, int paletteId)
+{
+  CameraRef cam = g_cameras.acquire(camId);
+  return cam ? cam->setPalette(paletteId) : -1;
+}
+
+int evo_irimager_multi_set_palette_scale(const unsigned int camId, int scale)
+{
+  CameraRef cam = g_cameras.acquire(camId);
+  return cam ? cam->setPaletteScale(scale) : -1;
+}
+
+int evo_irimager_multi_set_palette_manual_temp_range(const unsigned int camId, float min, float max)
+{
+  CameraRef cam = g_cameras.acquire(camId);
+  return cam ? cam->setPaletteRange(min, max) : -1;
+}
+
+int evo_irimager_multi_set_shutter_mode(const unsigned int camId, int mode)
+{
+  return (g_cameras.acquire(camId) && (mode == 0 || mode == 1)) ? 0 : -1;
+}
+
+int evo_irimager_multi_trigger_shutter_flag(const unsigned int camId)
+{
+  return g_cameras.acquire(camId) ? 0 : -1;
+}
+
+int evo_irimager_multi_set_temperature_range(const unsigned int camId, int t_min, int t_max)
+{
+  return (g_cameras.acquire(camId) && t_min < t_max) ? 0 : -1;
+}
+
+int evo_irimager_multi_set_radiation_parameters(const unsigned int camId, float emissivity, float transmissivity, float tAmbient)
+{
+  (void)tAmbient;
+  return (g_cameras.acquire(camId) && emissivity >= 0.f && emissivity <= 1.f && transmissivity >= 0.f && transmissivity <= 1.f) ? 0 : -1;
+}
+
+int evo_irimager_multi_set_focusmotor_pos(const unsigned int camId, float pos)
+{
+  CameraRef cam = g_cameras.acquire(camId);
+  return cam ? cam->setFocus(pos) : -1;
+}
+
+int evo_irimager_multi_get_focusmotor_pos(const unsigned int camId, float* posOut)
+{
+  CameraRef cam = g_cameras.acquire(camId);
+  if(!cam || !posOut) return -1;
+  *posOut = cam->focus();
+  return 0;
+}
+
+int evo_irimager_multi_set_pif_framesync_output(const unsigned int camId, const unsigned int aoChannelId, unsigned int analogOutputMode, float analogValue)
+{
+  (void)aoChannelId; (void)analogValue;
+  return (g_cameras.acquire(camId) && analogOutputMode <= 2) ? 0 : -1;
+}
+
+int evo_irimager_usb_init(const char* xml_config, const char* formats_def, const char* log_file)
+{
+  std::lock_guard<std::mutex> lock(g_singleMutex);
+  if(g_singleConnected) return -1;
+  if(evo_irimager_multi_usb_init(&g_single, xml_config, formats_def, log_file) != 0) return -1;
+  g_singleConnected = true;
+  return 0;
+}
+
+int evo_irimager_tcp_init(const char* ip, int port)
+{
+  (void)ip; (void)port;
+  return evo_irimager_usb_init(0, 0, 0);
+}
+
+int evo_irimager_terminate()
+{
+  std::lock_guard<std::mutex> lock(g_singleMutex);
+  if(!g_singleConnected) return -1;
+  g_singleConnected = false;
+  return evo_irimager_multi_terminate(g_single);
+}
+
+int evo_irimager_get_serial(unsigned long* serial)
+{
+  return evo_irimager_multi_get_serial(singleId(), serial);
+}
+
+int evo_irimager_get_thermal_image_size(int* w, int* h)
+{
+  return evo_irimager_multi_get_thermal_image_size(singleId(), w, h);
+}
+
+int evo_irimager_get_palette_image_size(int* w, int* h)
+{
+  return evo_irimager_multi_get_palette_image_size(singleId(), w, h);
+}
+
+int evo_irimager_get_thermal_image(int* w, int* h, unsigned short* data)
+{
+  return evo_irimager_multi_get_thermal_image(singleId(), w, h, data);
+}
+
+int evo_irimager_get_thermal_image_metadata(int* w, int* h, unsigned short* data, EvoIRFrameMetadata* metadata)
+{
+  return evo_irimager_multi_get_thermal_image_metadata(singleId(), w, h, data, metadata);
+}
+
+int evo_irimager_get_palette_image(int* w, int* h, unsigned char* data)
+{
+  return evo_irimager_multi_get_palette_image(singleId(), w, h, data);
+}
+
+int evo_irimager_get_palette_image_metadata(int* w, int* h, unsigned char* data, EvoIRFrameMetadata* metadata)
+{
+  return evo_irimager_multi_get_palette_image_metadata(singleId(), w, h, data, metadata);
+}
+
+int evo_irimager_get_thermal_palette_image(int w_t, int h_t, unsigned short* data_t, int w_p, int h_p, unsigned char* data_p)
+{
+  return evo_irimager_multi_get_thermal_palette_image(singleId(), w_t, h_t, data_t, w_p, h_p, data_p);
+}
+
+int evo_irimager_get_thermal_palette_image_metadata(int w_t, int h_t, unsigned short* data_t, int w_p, int h_p, unsigned char* data_p, EvoIRFrameMetadata* metadata)
+{
+  return evo_irimager_multi_get_thermal_palette_image_metadata(singleId(), w_t, h_t, data_t, w_p, h_p, data_p, metadata);
+}
+
+int evo_irimager_set_palette(int paletteId)
+{
+  return evo_irimager_multi_set_palette(singleId(), paletteId);
+}
+
+int evo_irimager_set_palette_scale(int scale)
+{
+  return evo_irimager_multi_set_palette_scale(singleId(), scale);
+}
+
+int evo_irimager_set_palette_manual_temp_range(float min, float max)
+{
+  return evo_irimager_multi_set_palette_manual_temp_range(singleId(), min, max);
+}
+
+int evo_irimager_set_shutter_mode(int mode)
+{
+  return evo_irimager_multi_set_shutter_mode(singleId(), mode);
+}
+
+int evo_irimager_trigger_shutter_flag()
+{
+  return evo_irimager_multi_trigger_shutter_flag(singleId());
+}
+
+int evo_irimager_set_temperature_range(int t_min, int t_max)
+{
+  return evo_irimager_multi_set_temperature_range(singleId(), t_min, t_max);
+}
+
+int evo_irimager_set_radiation_parameters(float emissivity, float transmissivity, float tAmbient)
+{
+  return evo_irimager_multi_set_radiation_parameters(singleId(), emissivity, transmissivity, tAmbient);
+}
+
+#ifdef _WIN32
+int evo_irimager_to_palette_save_png(unsigned short* thermal_data, int w, int h, const char* path, int palette, int palette_scale)
+{
+  // no PNG encoder without the library
+  (void)thermal_data; (void)w; (void)h; (void)path; (void)palette; (void)palette_scale;
+  return -1;
+}
+
+int evo_irimager_to_palette_save_png_high_precision(unsigned short* thermal_data, int w, int h, const char* path, int palette, int palette_scale, short decimalPlaces)
+{
+  (void)decimalPlaces;
+  return evo_irimager_to_palette_save_png(thermal_data, w, h, path, palette, palette_scale);
+}
+#endif
+
+int evo_irimager_set_focusmotor_pos(float pos)
+{
+  return evo_irimager_multi_set_focusmotor_pos(singleId(), pos);
+}
+
+int evo_irimager_get_focusmotor_pos(float* posOut)
+{
+  return evo_irimager_multi_get_focusmotor_pos(singleId(), posOut);
+}
+
+int evo_irimager_set_pif_framesync_output(const unsigned int aoChannelId, unsigned int analogOutputMode, float analogValue)
+{
+  return evo_irimager_multi_set_pif_framesync_output(singleId(), aoChannelId, analogOutputMode, analogValue);
+}
+
+int evo_irimager_daemon_launch()
+{
+  // there is no daemon to replay
+  return -1;
+}
+
+int evo_irimager_daemon_is_running()
+{
+  return -1;
+}
+
+int evo_irimager_daemon_kill()
+{
+  return -1;
+}
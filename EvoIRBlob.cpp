@@ -0,0 +1,626 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRBlob.cpp
+ * @brief Run-length connected component labeling and greedy nearest neighbour tracking
+ *
+ * Every row is turned into a bit mask of hot pixels, 16 (SSE4.1) or 32
+ * (AVX2) pixels per step, and the mask into runs by bit scanning, which
+ * skips 64 cold pixels per word. A run overlapping runs of the previous row
+ * (extended by one pixel for 8 neighbours) takes the label of the first of
+ * them and unites the labels of the others; a run without any starts a new
+ * label. Moments of a run are added in closed form, only peak and sum read
+ * its pixels. After the last row the statistics of all labels are folded
+ * into the roots of their sets.
+ *
+ * All buffers grow to the largest frame seen and are reused, so processing
+ * does not allocate once the scene is known.
+ */
+
+#include "EvoIRBlob.h"
+#include "EvoIRHandleTable.h"
+#include "EvoIRSimd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+namespace evo
+{
+
+namespace
+{
+
+struct Run
+{
+  int start;
+  int end;            // exclusive
+  unsigned int label;
+};
+
+struct Stats
+{
+  unsigned int n;
+  long long sx, sy, sxx, syy, sxy;
+  unsigned long long sum;
+  unsigned short peak;
+  short xPeak, yPeak;
+  short x0, y0, x1, y1;
+
+  void add(const Stats& o)
+  {
+    n   += o.n;
+    sx  += o.sx;
+    sy  += o.sy;
+    sxx += o.sxx;
+    syy += o.syy;
+    sxy += o.sxy;
+    sum += o.sum;
+    // first hottest pixel in scan order
+    if(o.peak > peak || (o.peak == peak && (o.yPeak < yPeak || (o.yPeak == yPeak && o.xPeak < xPeak))))
+    {
+      peak  = o.peak;
+      xPeak = o.xPeak;
+      yPeak = o.yPeak;
+    }
+    x0 = std::min(x0, o.x0);
+    y0 = std::min(y0, o.y0);
+    x1 = std::max(x1, o.x1);
+    y1 = std::max(y1, o.y1);
+  }
+};
+
+// detections a velocity is measured over, centroids of rasterized objects jitter by a fraction of a pixel
+const unsigned int VELOCITY_FRAMES = 8;
+
+struct Track
+{
+  unsigned int id;
+  unsigned int age;
+  unsigned int missed;
+  double cx, cy;
+  double vx, vy;
+  long long timestamp;
+  // last VELOCITY_FRAMES detections, detection k in slot k % VELOCITY_FRAMES
+  double hx[VELOCITY_FRAMES], hy[VELOCITY_FRAMES];
+  long long ht[VELOCITY_FRAMES];
+};
+
+struct Candidate
+{
+  double d2;
+  unsigned int track;
+  unsigned int blob;
+
+  bool operator<(const Candidate& o) const
+  {
+    if(d2 != o.d2) return d2 < o.d2;
+    if(track != o.track) return track < o.track;
+    return blob < o.blob;
+  }
+};
+
+// sum of k^2 for k in [0; n]
+long long squares(long long n)
+{
+  return n * (n + 1) * (2 * n + 1) / 6;
+}
+
+int lowestBit(unsigned long long v)
+{
+#if defined(__GNUC__)
+  return __builtin_ctzll(v);
+#else
+  int i = 0;
+  while(!(v & 1ULL)) { v >>= 1; i++; }
+  return i;
+#endif
+}
+
+// first position >= from whose bit equals set, words * 64 if there is none
+size_t scan(const unsigned long long* mask, size_t words, size_t from, bool set)
+{
+  size_t i = from >> 6;
+  if(i >= words) return words << 6;
+  unsigned long long bits = (set ? mask[i] : ~mask[i]) & (~0ULL << (from & 63));
+  while(!bits)
+  {
+    if(++i >= words) return words << 6;
+    bits = set ? mask[i] : ~mask[i];
+  }
+  return (i << 6) + lowestBit(bits);
+}
+
+//------------------------------------------------------------------------------
+// plain C++
+//------------------------------------------------------------------------------
+
+void thresholdScalar(const unsigned short* row, size_t x0, size_t w, unsigned short threshold, unsigned long long* mask)
+{
+  for(size_t x = x0; x < w; x++)
+    if(row[x] >= threshold) mask[x >> 6] |= 1ULL << (x & 63);
+}
+
+#if EVO_SIMD_X86
+
+//------------------------------------------------------------------------------
+// SSE4.1
+//------------------------------------------------------------------------------
+
+EVO_TARGET_SSE41 void thresholdSse41(const unsigned short* row, size_t w, unsigned short threshold, unsigned long long* mask)
+{
+  const __m128i t = _mm_set1_epi16((short)threshold);
+  size_t x = 0;
+  for(; x + 16 <= w; x += 16)
+  {
+    const __m128i v0 = _mm_loadu_si128((const __m128i*)(row + x));
+    const __m128i v1 = _mm_loadu_si128((const __m128i*)(row + x + 8));
+    // unsigned v >= t if max(v, t) == v
+    const __m128i m0 = _mm_cmpeq_epi16(_mm_max_epu16(v0, t), v0);
+    const __m128i m1 = _mm_cmpeq_epi16(_mm_max_epu16(v1, t), v1);
+    const unsigned short bits = (unsigned short)_mm_movemask_epi8(_mm_packs_epi16(m0, m1));
+    std::memcpy((unsigned char*)mask + (x >> 3), &bits, sizeof(bits));
+  }
+  thresholdScalar(row, x, w, threshold, mask);
+}
+
+//------------------------------------------------------------------------------
+// AVX2
+//------------------------------------------------------------------------------
+
+EVO_TARGET_AVX2 void thresholdAvx2(const unsigned short* row, size_t w, unsigned short threshold, unsigned long long* mask)
+{
+  const __m256i t = _mm256_set1_epi16((short)threshold);
+  size_t x = 0;
+  for(; x + 32 <= w; x += 32)
+  {
+    const __m256i v0 = _mm256_loadu_si256((const __m256i*)(row + x));
+    const __m256i v1 = _mm256_loadu_si256((const __m256i*)(row + x + 16));
+    const __m256i m0 = _mm256_cmpeq_epi16(_mm256_max_epu16(v0, t), v0);
+    const __m256i m1 = _mm256_cmpeq_epi16(_mm256_max_epu16(v1, t), v1);
+    // packing works per 128 bit lane, restore pixel order before taking the sign bits
+    const __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(m0, m1), 0xD8);
+    const unsigned int bits = (unsigned int)_mm256_movemask_epi8(packed);
+    std::memcpy((unsigned char*)mask + (x >> 3), &bits, sizeof(bits));
+  }
+  // remaining pixels of the row
+  thresholdScalar(row, x, w, threshold, mask);
+}
+
+#endif // EVO_SIMD_X86
+
+/**
+ * Bit mask of the pixels of a row at or above threshold, bits beyond w are 0
+ */
+void threshold(const unsigned short* row, size_t w, unsigned short t, unsigned long long* mask)
+{
+  std::memset(mask, 0, ((w + 63) >> 6) * sizeof(unsigned long long));
+#if EVO_SIMD_X86
+  const int level = simdLevel();
+  if(level >= SIMD_AVX2)  { thresholdAvx2(row, w, t, mask); return; }
+  if(level >= SIMD_SSE41) { thresholdSse41(row, w, t, mask); return; }
+#endif
+  thresholdScalar(row, 0, w, t, mask);
+}
+
+} // namespace
+
+class EvoIRBlobTracker
+{
+public:
+  explicit EvoIRBlobTracker(const EvoIRBlobParams& params) :
+    _params(params),
+    _scale(std::pow(10.0, -params.decimalPlaces)),
+    _words(((size_t)params.width + 63) >> 6),
+    _mask(_words),
+    _rowStart(params.height + 1),
+    _nextId(1)
+  {
+    setThreshold(params.tThreshold);
+  }
+
+  void setThreshold(float t)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _params.tThreshold = t;
+    // pixels >= threshold, raw values are (t + 100) * 10^decimalPlaces
+    const double raw = std::ceil((t + 100.0) / _scale - 1e-6);
+    _none      = raw > 65535.0;
+    _threshold = (unsigned short)(raw < 0.0 ? 0.0 : (raw > 65535.0 ? 65535.0 : raw));
+  }
+
+  void reset()
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _tracks.clear();
+  }
+
+  void process(const unsigned short* data, long long timestamp, EvoIRBlob* blobs, unsigned int capacity, unsigned int* count, unsigned int* labels)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    label(data);
+    collect();
+    associate(timestamp);
+
+    const unsigned int n = std::min(capacity, (unsigned int)_blobs.size());
+    for(unsigned int i = 0; i < n; i++)
+      blobs[i] = _blobs[i];
+    *count = n;
+
+    if(labels)
+    {
+      std::memset(labels, 0, (size_t)_params.width * _params.height * sizeof(unsigned int));
+      for(int y = 0; y < _params.height; y++)
+      {
+        unsigned int* row = labels + (size_t)y * _params.width;
+        for(size_t r = _rowStart[y]; r < _rowStart[y + 1]; r++)
+        {
+          const unsigned int id = _labelTrack[find(_runs[r].label)];
+          if(id) std::fill(row + _runs[r].start, row + _runs[r].end, id);
+        }
+      }
+    }
+  }
+
+private:
+  EvoIRBlobTracker(const EvoIRBlobTracker&);
+  EvoIRBlobTracker& operator=(const EvoIRBlobTracker&);
+
+  unsigned int find(unsigned int l)
+  {
+    while(_parent[l] != l)
+    {
+      _parent[l] = _parent[_parent[l]];
+      l = _parent[l];
+    }
+    return l;
+  }
+
+  unsigned int newLabel()
+  {
+    const unsigned int l = (unsigned int)_parent.size();
+    _parent.push_back(l);
+    Stats s;
+    std::memset(&s, 0, sizeof(s));
+    s.x0 = s.y0 = 32767;
+    s.x1 = s.y1 = -1;
+    _stats.push_back(s);
+    return l;
+  }
+
+  /**
+   * Runs of all rows with their labels and the statistics of every label
+   */
+  void label(const unsigned short* data)
+  {
+    const int w = _params.width;
+    const int reach = _params.connectivity == 8 ? 1 : 0;
+    _runs.clear();
+    _parent.clear();
+    _stats.clear();
+    _rowStart[0] = 0;
+    for(int y = 0; y < _params.height; y++)
+    {
+      const unsigned short* row = data + (size_t)y * w;
+      const size_t prevBegin = y > 0 ? _rowStart[y - 1] : 0;
+      const size_t prevEnd   = _rowStart[y];
+      size_t p = prevBegin;
+      if(!_none) threshold(row, w, _threshold, &_mask[0]);
+      for(size_t x = _none ? (size_t)w : scan(&_mask[0], _words, 0, true); x < (size_t)w; x = scan(&_mask[0], _words, x, true))
+      {
+        const int start = (int)x;
+        const int end   = (int)std::min(scan(&_mask[0], _words, x, false), (size_t)w);
+        x = end;
+
+        // previous runs ending left of this one cannot touch later runs either
+        while(p < prevEnd && _runs[p].end + reach <= start) p++;
+        unsigned int l = 0;
+        bool labeled = false;
+        for(size_t q = p; q < prevEnd && _runs[q].start < end + reach; q++)
+        {
+          const unsigned int root = find(_runs[q].label);
+          if(!labeled)
+          {
+            l = root;
+            labeled = true;
+          }
+          else if(root != l)
+          {
+            // the smaller label stays root, so roots follow the scan order
+            if(root < l)
+            {
+              _parent[l] = root;
+              l = root;
+            }
+            else _parent[root] = l;
+          }
+        }
+        if(!labeled) l = newLabel();
+        Run run = { start, end, l };
+        _runs.push_back(run);
+
+        Stats& s = _stats[l];
+        const long long len = end - start;
+        const long long sx  = (long long)(start + end - 1) * len / 2;
+        s.n   += (unsigned int)len;
+        s.sx  += sx;
+        s.sy  += (long long)y * len;
+        s.sxx += squares(end - 1) - squares(start - 1);
+        s.syy += (long long)y * y * len;
+        s.sxy += (long long)y * sx;
+        unsigned long long sum = 0;
+        unsigned short peak = 0;
+        int xPeak = start;
+        for(int i = start; i < end; i++)
+        {
+          sum += row[i];
+          if(row[i] > peak)
+          {
+            peak  = row[i];
+            xPeak = i;
+          }
+        }
+        s.sum += sum;
+        if(peak > s.peak || s.n == (unsigned int)len)
+        {
+          s.peak  = peak;
+          s.xPeak = (short)xPeak;
+          s.yPeak = (short)y;
+        }
+        s.x0 = std::min(s.x0, (short)start);
+        s.x1 = std::max(s.x1, (short)(end - 1));
+        s.y0 = std::min(s.y0, (short)y);
+        s.y1 = (short)y;
+      }
+      _rowStart[y + 1] = _runs.size();
+    }
+
+    for(unsigned int l = 0; l < _parent.size(); l++)
+    {
+      const unsigned int root = find(l);
+      if(root != l) _stats[root].add(_stats[l]);
+    }
+  }
+
+  /**
+   * Blobs of the frame from the roots, largest first
+   */
+  void collect()
+  {
+    _roots.clear();
+    for(unsigned int l = 0; l < _parent.size(); l++)
+      if(_parent[l] == l && _stats[l].n >= (unsigned int)_params.minPixels) _roots.push_back(l);
+    const std::vector<Stats>& stats = _stats;
+    auto larger = [&stats](unsigned int a, unsigned int b) { return stats[a].n != stats[b].n ? stats[a].n > stats[b].n : a < b; };
+    if(_roots.size() > (size_t)_params.maxBlobs)
+    {
+      std::nth_element(_roots.begin(), _roots.begin() + _params.maxBlobs, _roots.end(), larger);
+      _roots.resize(_params.maxBlobs);
+    }
+    std::sort(_roots.begin(), _roots.end(), larger);
+
+    _blobs.resize(_roots.size());
+    for(size_t i = 0; i < _roots.size(); i++)
+    {
+      const Stats& s = _stats[_roots[i]];
+      const double n  = s.n;
+      const double cx = s.sx / n;
+      const double cy = s.sy / n;
+      EvoIRBlob& b = _blobs[i];
+      b.trackId     = 0;
+      b.age         = 0;
+      b.pixels      = s.n;
+      b.cx          = (float)cx;
+      b.cy          = (float)cy;
+      b.mu20        = (float)(s.sxx / n - cx * cx);
+      b.mu02        = (float)(s.syy / n - cy * cy);
+      b.mu11        = (float)(s.sxy / n - cx * cy);
+      b.orientation = (float)(0.5 * std::atan2(2.0 * b.mu11, (double)b.mu20 - b.mu02));
+      b.xMin        = s.x0;
+      b.yMin        = s.y0;
+      b.xMax        = s.x1;
+      b.yMax        = s.y1;
+      b.tMax        = (float)(s.peak * _scale - 100.0);
+      b.xPeak       = s.xPeak;
+      b.yPeak       = s.yPeak;
+      b.tMean       = (float)((double)s.sum / n * _scale - 100.0);
+      b.vx          = 0.f;
+      b.vy          = 0.f;
+    }
+  }
+
+  /**
+   * Closest pairs of predicted track position and blob first, then new tracks for the blobs left
+   */
+  void associate(long long timestamp)
+  {
+    const double maxD2 = (double)_params.maxDistance * _params.maxDistance;
+    _candidates.clear();
+    for(unsigned int t = 0; t < _tracks.size(); t++)
+    {
+      const Track& track = _tracks[t];
+      const double dt = std::max(0.0, (timestamp - track.timestamp) * 1e-7);
+      const double px = track.cx + track.vx * dt;
+      const double py = track.cy + track.vy * dt;
+      for(unsigned int b = 0; b < _blobs.size(); b++)
+      {
+        const double dx = _blobs[b].cx - px;
+        const double dy = _blobs[b].cy - py;
+        const double d2 = dx * dx + dy * dy;
+        if(d2 <= maxD2)
+        {
+          Candidate c = { d2, t, b };
+          _candidates.push_back(c);
+        }
+      }
+    }
+    std::sort(_candidates.begin(), _candidates.end());
+
+    _trackMatched.assign(_tracks.size(), 0);
+    _blobMatched.assign(_blobs.size(), 0);
+    for(size_t i = 0; i < _candidates.size(); i++)
+    {
+      const Candidate& c = _candidates[i];
+      if(_trackMatched[c.track] || _blobMatched[c.blob]) continue;
+      _trackMatched[c.track] = 1;
+      _blobMatched[c.blob]   = 1;
+      Track& track = _tracks[c.track];
+      EvoIRBlob& blob = _blobs[c.blob];
+      // displacement since the oldest detection kept, its slot is taken by this one
+      const unsigned int slot = track.age % VELOCITY_FRAMES;
+      const unsigned int base = track.age >= VELOCITY_FRAMES ? slot : 0;
+      const double dt = (timestamp - track.ht[base]) * 1e-7;
+      if(dt > 0.0)
+      {
+        track.vx = (blob.cx - track.hx[base]) / dt;
+        track.vy = (blob.cy - track.hy[base]) / dt;
+      }
+      track.hx[slot]  = blob.cx;
+      track.hy[slot]  = blob.cy;
+      track.ht[slot]  = timestamp;
+      track.cx        = blob.cx;
+      track.cy        = blob.cy;
+      track.timestamp = timestamp;
+      track.missed    = 0;
+      track.age++;
+      blob.trackId = track.id;
+      blob.age     = track.age;
+      blob.vx      = (float)track.vx;
+      blob.vy      = (float)track.vy;
+    }
+
+    // tracks not seen for too long are dropped, the order of the others is kept
+    size_t kept = 0;
+    for(size_t t = 0; t < _tracks.size(); t++)
+    {
+      if(!_trackMatched[t] && ++_tracks[t].missed > (unsigned int)_params.maxMissed) continue;
+      _tracks[kept++] = _tracks[t];
+    }
+    _tracks.resize(kept);
+
+    for(size_t b = 0; b < _blobs.size(); b++)
+    {
+      if(_blobMatched[b]) continue;
+      Track track;
+      track.id        = _nextId++;
+      track.age       = 1;
+      track.missed    = 0;
+      track.cx        = _blobs[b].cx;
+      track.cy        = _blobs[b].cy;
+      track.vx        = 0.0;
+      track.vy        = 0.0;
+      track.timestamp = timestamp;
+      track.hx[0]     = track.cx;
+      track.hy[0]     = track.cy;
+      track.ht[0]     = timestamp;
+      if(_nextId == 0) _nextId = 1;
+      _tracks.push_back(track);
+      _blobs[b].trackId = track.id;
+      _blobs[b].age     = 1;
+    }
+
+    _labelTrack.assign(_parent.size(), 0);
+    for(size_t i = 0; i < _roots.size(); i++)
+      _labelTrack[_roots[i]] = _blobs[i].trackId;
+  }
+
+  EvoIRBlobParams _params;
+  const double _scale;
+  const size_t _words;
+  unsigned short _threshold;
+  bool _none;                          // threshold above the raw range
+
+  std::vector<unsigned long long> _mask;
+  std::vector<size_t> _rowStart;       // first run of every row, runs of row y are [_rowStart[y]; _rowStart[y + 1])
+  std::vector<Run> _runs;
+  std::vector<unsigned int> _parent;   // union-find of labels
+  std::vector<Stats> _stats;
+  std::vector<unsigned int> _roots;    // labels of the blobs
+  std::vector<unsigned int> _labelTrack;
+  std::vector<EvoIRBlob> _blobs;
+
+  std::vector<Track> _tracks;
+  std::vector<Candidate> _candidates;
+  std::vector<char> _trackMatched;
+  std::vector<char> _blobMatched;
+  unsigned int _nextId;
+
+  std::mutex _mutex;
+};
+
+static EvoIRHandleTable<EvoIRBlobTracker> g_trackers;
+typedef EvoIRHandleTable<EvoIRBlobTracker>::Ref TrackerRef;
+
+} // namespace evo
+
+using namespace evo;
+
+void evo_irimager_blob_default_params(EvoIRBlobParams* params, int w, int h)
+{
+  if(!params) return;
+  std::memset(params, 0, sizeof(*params));
+  params->width         = w;
+  params->height        = h;
+  params->decimalPlaces = 1;
+  params->tThreshold    = 50.f;
+  params->connectivity  = 8;
+  params->minPixels     = 4;
+  params->maxBlobs      = 64;
+  params->maxDistance   = 32.f;
+  params->maxMissed     = 5;
+}
+
+int evo_irimager_blob_tracker_create(unsigned int* outTrackerId, const EvoIRBlobParams* params)
+{
+  if(!outTrackerId || !params || params->width <= 0 || params->height <= 0 || params->width > 32767 || params->height > 32767
+     || params->decimalPlaces < 1 || params->decimalPlaces > 4 || (params->connectivity != 4 && params->connectivity != 8)
+     || params->minPixels < 1 || params->maxBlobs < 1 || !(params->maxDistance >= 0.f) || params->maxMissed < 0)
+    return -1;
+  EvoIRBlobTracker* tracker = new EvoIRBlobTracker(*params);
+  if(!g_trackers.insert(tracker, outTrackerId))
+  {
+    delete tracker;
+    return -1;
+  }
+  return 0;
+}
+
+int evo_irimager_blob_tracker_destroy(const unsigned int trackerId)
+{
+  EvoIRBlobTracker* tracker = g_trackers.remove(trackerId);
+  if(!tracker) return -1;
+  delete tracker;
+  return 0;
+}
+
+int evo_irimager_blob_set_threshold(const unsigned int trackerId, float tThreshold)
+{
+  TrackerRef tracker = g_trackers.acquire(trackerId);
+  if(!tracker) return -1;
+  tracker->setThreshold(tThreshold);
+  return 0;
+}
+
+int evo_irimager_blob_reset(const unsigned int trackerId)
+{
+  TrackerRef tracker = g_trackers.acquire(trackerId);
+  if(!tracker) return -1;
+  tracker->reset();
+  return 0;
+}
+
+int evo_irimager_blob_process(const unsigned int trackerId, const unsigned short* data, const EvoIRFrameMetadata* metadata,
+                              EvoIRBlob* blobs, unsigned int capacity, unsigned int* count, unsigned int* labels)
+{
+  TrackerRef tracker = g_trackers.acquire(trackerId);
+  if(!tracker || !data || !metadata || (!blobs && capacity > 0) || !count) return -1;
+  tracker->process(data, metadata->timestamp, blobs, capacity, count, labels);
+  return 0;
+}
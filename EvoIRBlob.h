@@ -0,0 +1,135 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRBlob.h
+ * @brief Provides detection and tracking of hot objects for Easy API C-Library Interface
+ *
+ * A blob tracker finds connected regions of pixels at or above a temperature
+ * threshold in raw thermal images as delivered by
+ * evo_irimager_get_thermal_image_metadata and follows them from frame to
+ * frame. Each frame is processed in a single pass: rows are thresholded with
+ * SSE4.1/AVX2 (see evo_irimager_set_simd_level) into bit masks, the masks are
+ * split into runs, and runs touching runs of the previous row are joined with
+ * a union-find of run labels while their moments, peak and sum are
+ * accumulated. The image is not revisited, so the cost is that of
+ * thresholding plus a small amount per hot pixel.
+ *
+ * Blobs are associated with the tracks of the previous frames by nearest
+ * distance of the centroid to the position predicted by the track velocity,
+ * closest pairs first. Velocities are the displacement over the last 8
+ * detections divided by the time between them (EvoIRFrameMetadata::timestamp),
+ * so dropped frames do not distort them. Tracks keep their id until they were
+ * not seen for more than maxMissed frames.
+ *
+ * @code
+ * EvoIRBlobParams params;
+ * evo_irimager_blob_default_params(&params, 640, 480);
+ * params.tThreshold = 60.f;
+ * evo_irimager_blob_tracker_create(&trackerId, &params);
+ * EvoIRBlob blobs[16];
+ * unsigned int count;
+ * evo_irimager_blob_process(trackerId, thermal, &metadata, blobs, 16, &count, NULL);
+ * @endcode
+ */
+
+#ifndef EVOIRBLOB_H_
+#define EVOIRBLOB_H_
+
+#include "irdirectsdk_defs.h"
+#include "EvoIRFrameMetadata.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+typedef struct __IRDIRECTSDK_API__ EvoIRBlobParams
+{
+  int width;             /*!< Image width */
+  int height;            /*!< Image height */
+  short decimalPlaces;   /*!< Decimal places of raw values [1; 4], see evo_irimager_thermal_to_celsius */
+  float tThreshold;      /*!< Pixels at or above this temperature in degree Celsius belong to blobs */
+  int connectivity;      /*!< 4 or 8 neighbours */
+  int minPixels;         /*!< Smaller regions are ignored */
+  int maxBlobs;          /*!< Largest number of blobs tracked per frame, the largest regions are kept */
+  float maxDistance;     /*!< Largest distance in pixels of a centroid to the predicted position of a track */
+  int maxMissed;         /*!< Frames a track is kept without a blob */
+} EvoIRBlobParams;
+
+typedef struct __IRDIRECTSDK_API__ EvoIRBlob
+{
+  unsigned int trackId;  /*!< Track id, stable as long as the object is followed, ids are not reused */
+  unsigned int age;      /*!< Frames the object was detected in, 1 for a new track */
+  unsigned int pixels;   /*!< Area in pixels */
+  float cx, cy;          /*!< Centroid, pixel centers at integer positions */
+  float mu20, mu02, mu11;/*!< Central second order moments divided by the area */
+  float orientation;     /*!< Angle of the major axis against the x axis in radians (-pi/2; pi/2] */
+  short xMin, yMin;      /*!< Upper left corner of bounding box */
+  short xMax, yMax;      /*!< Lower right corner of bounding box, inclusive */
+  float tMax;            /*!< Peak temperature in degree Celsius */
+  short xPeak, yPeak;    /*!< Location of the (first) hottest pixel */
+  float tMean;           /*!< Mean temperature in degree Celsius */
+  float vx, vy;          /*!< Velocity of the centroid in pixels per second over the last 8 detections, 0 for a new track */
+} EvoIRBlob;
+
+/**
+ * @brief Fills parameter structure with defaults (threshold 50 degree Celsius, 8 neighbours, at least 4 pixels, 64 blobs, 32 pixels distance, 5 frames missed, one decimal place)
+ * @param[out] params pointer to EvoIRBlobParams allocate by the user
+ * @param[in] w image width
+ * @param[in] h image height
+ */
+__IRDIRECTSDK_API__ void evo_irimager_blob_default_params(EvoIRBlobParams* params, int w, int h);
+
+/**
+ * @brief Creates a blob tracker
+ * @param[out] outTrackerId tracker instance id for reference
+ * @param[in] params parameters
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_blob_tracker_create(unsigned int* outTrackerId, const EvoIRBlobParams* params);
+
+/**
+ * @brief Releases a blob tracker
+ * @param[in] trackerId tracker instance id from create to apply this function
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_blob_tracker_destroy(const unsigned int trackerId);
+
+/**
+ * @brief Changes the temperature threshold of subsequent frames, tracks are kept
+ * @param[in] trackerId tracker instance id from create to apply this function
+ * @param[in] tThreshold threshold in degree Celsius
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_blob_set_threshold(const unsigned int trackerId, float tThreshold);
+
+/**
+ * @brief Drops all tracks, the next frame starts new ones
+ * @param[in] trackerId tracker instance id from create to apply this function
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_blob_reset(const unsigned int trackerId);
+
+/**
+ * @brief Detects the blobs of a frame and associates them with the tracks
+ * @param[in] trackerId tracker instance id from create to apply this function
+ * @param[in] data thermal image (size of width * height)
+ * @param[in] metadata metadata of the frame, timestamps must increase
+ * @param[out] blobs pointer to EvoIRBlob array allocate by the user, ordered by decreasing area
+ * @param[in] capacity number of elements of blobs, further blobs are tracked but not written
+ * @param[out] count number of blobs written
+ * @param[out] labels pointer to unsigned int array allocate by the user (size of width * height) receiving the track id of every pixel, 0 for background and ignored regions, may be NULL
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_blob_process(const unsigned int trackerId, const unsigned short* data, const EvoIRFrameMetadata* metadata,
+                                                  EvoIRBlob* blobs, unsigned int capacity, unsigned int* count, unsigned int* labels);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* EVOIRBLOB_H_ */
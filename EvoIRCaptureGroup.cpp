@@ -0,0 +1,574 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRCaptureGroup.cpp
+ * @brief Multi-camera capture scheduler with frame alignment
+ *
+ * The group runs its own capture threads and feeds the rings through the
+ * producer interface of EvoIRFrameRing, so it can bind threads to cores and
+ * note the arrival time of every frame. Since a group thread is the only
+ * producer of its ring, the n-th committed frame carries ring sequence n,
+ * which keys the arrival times.
+ */
+
+#include "EvoIRCaptureGroup.h"
+#include "EvoIRFrameRing.h"
+#include "EvoIRSyntheticSource.h"
+#include "direct_binding.h"
+#include "EvoIRHandleTable.h"
+#include "EvoIRLogHistogram.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#   ifndef NOMINMAX
+#       define NOMINMAX
+#   endif
+#   include <windows.h>
+#elif defined(__linux__)
+#   include <pthread.h>
+#   include <sched.h>
+#endif
+
+namespace evo
+{
+
+namespace
+{
+
+/**
+ * Binds the calling thread to a core, false for cores beyond the affinity mask. On Windows the
+ * mask covers the processor group of the thread only, i.e. at most 64 cores.
+ */
+bool pinCurrentThread(int core)
+{
+#ifdef _WIN32
+  if(core < 0 || core >= (int)(8 * sizeof(DWORD_PTR))) return false;
+  return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << core) != 0;
+#elif defined(__linux__)
+  if(core < 0 || core >= CPU_SETSIZE) return false;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(core, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+  (void)core;
+  return false;
+#endif
+}
+
+} // namespace
+
+class EvoIRCaptureGroup
+{
+public:
+  typedef std::function<int(unsigned short*, EvoIRFrameMetadata*)> GrabFunction;
+
+  explicit EvoIRCaptureGroup(const EvoIRGroupParams& params) :
+    _params(params),
+    _running(false),
+    _closed(false)
+  {
+    _cameras.reserve(EVO_GROUP_MAX_CAMERAS);
+  }
+
+  ~EvoIRCaptureGroup()
+  {
+    shutdown();
+    for(size_t i = 0; i < _cameras.size(); i++)
+      delete _cameras[i];
+  }
+
+  /**
+   * Stops capturing and destroys the rings, which wakes callers waiting for a set; later calls fail
+   */
+  void shutdown()
+  {
+    stop();
+    std::lock_guard<std::mutex> lock(_controlMutex);
+    if(_closed.exchange(true)) return;
+    for(size_t i = 0; i < _cameras.size(); i++)
+      evo_irimager_ring_destroy(_cameras[i]->ringId);
+  }
+
+  bool add(int w, int h, int core, const GrabFunction& grab, unsigned int* index)
+  {
+    std::lock_guard<std::mutex> lock(_controlMutex);
+    std::lock_guard<std::mutex> matchLock(_matchMutex);
+    if(_closed.load() || _running.load() || _cameras.size() >= EVO_GROUP_MAX_CAMERAS) return false;
+    unsigned int ringId;
+    if(evo_irimager_ring_create(&ringId, w, h, _params.slots) != 0) return false;
+    Camera* cam = new Camera(ringId, core, grab, (size_t)w * h, _params.slots * 4);
+    *index = (unsigned int)_cameras.size();
+    _cameras.push_back(cam);
+    return true;
+  }
+
+  bool ring(unsigned int index, unsigned int* ringId)
+  {
+    std::lock_guard<std::mutex> lock(_controlMutex);
+    if(_closed.load() || index >= _cameras.size()) return false;
+    *ringId = _cameras[index]->ringId;
+    return true;
+  }
+
+  bool start()
+  {
+    std::lock_guard<std::mutex> lock(_controlMutex);
+    if(_closed.load() || _running.load() || _cameras.empty() || _params.reference >= (int)_cameras.size()) return false;
+    _running.store(true);
+    for(size_t i = 0; i < _cameras.size(); i++)
+      _cameras[i]->thread = std::thread(&EvoIRCaptureGroup::captureLoop, this, _cameras[i]);
+    return true;
+  }
+
+  bool stop()
+  {
+    std::lock_guard<std::mutex> lock(_controlMutex);
+    if(!_running.load()) return false;
+    _running.store(false);
+    for(size_t i = 0; i < _cameras.size(); i++)
+      _cameras[i]->thread.join();
+    return true;
+  }
+
+  int acquireSet(int timeoutMs, EvoIRFrameSet* set)
+  {
+    std::lock_guard<std::mutex> lock(_matchMutex);
+    if(_closed.load() || _cameras.empty() || _params.reference >= (int)_cameras.size()) return -1;
+    const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs > 0 ? timeoutMs : 0);
+    const unsigned int n = (unsigned int)_cameras.size();
+
+    for(;;)
+    {
+      Camera& ref = *_cameras[_params.reference];
+      if(ref.pending.empty() && !fetch(ref, remaining(timeoutMs, deadline))) return _closed.load() ? -1 : -3;
+      Held frames[EVO_GROUP_MAX_CAMERAS];
+      bool found[EVO_GROUP_MAX_CAMERAS] = { false };
+      frames[_params.reference] = ref.pending.front();
+      found[_params.reference]  = true;
+      ref.pending.pop_front();
+
+      const long long r = key(frames[_params.reference]);
+      long long kMin = r, kMax = r;
+      unsigned int matched = 1;
+      for(unsigned int i = 0; i < n; i++)
+      {
+        if((int)i == _params.reference) continue;
+        if(!match(*_cameras[i], r, timeoutMs, deadline, &frames[i])) continue;
+        found[i] = true;
+        matched++;
+        const long long k = key(frames[i]);
+        if(k < kMin) kMin = k;
+        if(k > kMax) kMax = k;
+      }
+
+      if(_params.complete && matched < n)
+      {
+        for(unsigned int i = 0; i < n; i++)
+          if(found[i]) discard(*_cameras[i], frames[i]);
+        if(timeoutMs >= 0 && std::chrono::steady_clock::now() >= deadline) return -3;
+        continue;
+      }
+
+      const long long now = hostTime();
+      std::memset(set, 0, sizeof(EvoIRFrameSet));
+      set->cameras = n;
+      set->matched = matched;
+      set->skew    = kMax - kMin;
+      for(unsigned int i = 0; i < n; i++)
+      {
+        if(!found[i]) continue;
+        Camera& cam      = *_cameras[i];
+        set->data[i]     = frames[i].data;
+        set->metadata[i] = frames[i].metadata;
+        set->slot[i]     = frames[i].slot;
+        cam.framesMatched.fetch_add(1, std::memory_order_relaxed);
+        if(frames[i].arrival >= 0) cam.latency.record(now - frames[i].arrival);
+      }
+      return 0;
+    }
+  }
+
+  bool releaseSet(const EvoIRFrameSet* set)
+  {
+    if(_closed.load() || set->cameras != _cameras.size()) return false;
+    for(unsigned int i = 0; i < set->cameras; i++)
+      if(set->data[i]) evo_irimager_ring_release(_cameras[i]->ringId, set->slot[i]);
+    return true;
+  }
+
+  bool stats(unsigned int index, EvoIRCameraStats* stats)
+  {
+    if(_closed.load() || index >= _cameras.size()) return false;
+    Camera& cam = *_cameras[index];
+    EvoIRRingStats ring;
+    if(evo_irimager_ring_get_stats(cam.ringId, &ring) != 0) return false;
+    stats->framesProduced  = ring.framesProduced;
+    stats->framesDropped   = ring.framesDropped;
+    stats->framesMatched   = cam.framesMatched.load(std::memory_order_relaxed);
+    stats->framesUnmatched = cam.framesUnmatched.load(std::memory_order_relaxed);
+    cam.latency.snapshot(&stats->latency);
+    cam.jitter.snapshot(&stats->jitter);
+    return true;
+  }
+
+  void resetStats()
+  {
+    for(size_t i = 0; i < _cameras.size(); i++)
+    {
+      _cameras[i]->latency.reset();
+      _cameras[i]->jitter.reset();
+    }
+  }
+
+  unsigned int cameraCount() const
+  {
+    return (unsigned int)_cameras.size();
+  }
+
+private:
+  struct Held
+  {
+    unsigned short* data;
+    EvoIRFrameMetadata* metadata;
+    unsigned int slot;
+    long long arrival;
+  };
+
+  struct Arrival
+  {
+    std::atomic<unsigned long long> seq;
+    std::atomic<long long> time;
+  };
+
+  struct Camera
+  {
+    Camera(unsigned int ring, int cpu, const GrabFunction& grabFunction, size_t pixels, unsigned int arrivals) :
+      ringId(ring),
+      core(cpu),
+      grab(grabFunction),
+      scratch(pixels),
+      arrival(new Arrival[arrivals]),
+      arrivalCount(arrivals),
+      cursor(0),
+      framesMatched(0),
+      framesUnmatched(0)
+    {
+      for(unsigned int i = 0; i < arrivals; i++)
+      {
+        arrival[i].seq.store(0);
+        arrival[i].time.store(0);
+      }
+    }
+
+    ~Camera()
+    {
+      delete[] arrival;
+    }
+
+    const unsigned int ringId;
+    const int core;
+    GrabFunction grab;
+    std::vector<unsigned short> scratch;
+    std::thread thread;
+
+    // arrival times written by the capture thread, indexed by ring sequence
+    Arrival* arrival;
+    const unsigned int arrivalCount;
+
+    // matcher state, guarded by _matchMutex
+    unsigned long long cursor;
+    std::deque<Held> pending;
+
+    std::atomic<unsigned long long> framesMatched;
+    std::atomic<unsigned long long> framesUnmatched;
+    LogHistogram latency;
+    LogHistogram jitter;
+  };
+
+  void captureLoop(Camera* cam)
+  {
+    if(cam->core >= 0) pinCurrentThread(cam->core);
+
+    EvoIRRingStats ring;
+    evo_irimager_ring_get_stats(cam->ringId, &ring);
+    unsigned long long seq = ring.lastSequence;
+
+    // reference point for the frame period derived from device timestamps
+    bool haveFirst = false, havePrev = false;
+    unsigned int counterFirst = 0, counterPrev = 0;
+    long long timestampFirst = 0, arrivalPrev = 0;
+
+    while(_running.load(std::memory_order_relaxed))
+    {
+      unsigned short* data;
+      EvoIRFrameMetadata* metadata;
+      if(evo_irimager_ring_begin_write(cam->ringId, &data, &metadata) != 0)
+      {
+        // All slots are held, keep the device queue flowing
+        EvoIRFrameMetadata scratchMetadata;
+        if(cam->grab(&cam->scratch[0], &scratchMetadata) != 0)
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        continue;
+      }
+      if(cam->grab(data, metadata) != 0)
+      {
+        evo_irimager_ring_end_write(cam->ringId, 0);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        continue;
+      }
+
+      const long long now              = hostTime();
+      const unsigned int counter       = metadata->counter;
+      const long long timestamp        = metadata->timestamp;
+      Arrival& a = cam->arrival[++seq % cam->arrivalCount];
+      a.seq.store(0);
+      a.time.store(now);
+      a.seq.store(seq);
+      evo_irimager_ring_end_write(cam->ringId, 1);
+
+      if(haveFirst && counter <= counterPrev)
+        haveFirst = havePrev = false; // counter restarted, e.g. after reconnect
+      if(!haveFirst)
+      {
+        haveFirst      = true;
+        counterFirst   = counter;
+        timestampFirst = timestamp;
+      }
+      else if(havePrev && counter > counterFirst)
+      {
+        const double period   = (double)(timestamp - timestampFirst) / (counter - counterFirst);
+        const double expected = period * (counter - counterPrev);
+        const double actual   = (double)(now - arrivalPrev);
+        cam->jitter.record((long long)(actual > expected ? actual - expected : expected - actual));
+      }
+      havePrev    = true;
+      counterPrev = counter;
+      arrivalPrev = now;
+    }
+  }
+
+  static int remaining(int timeoutMs, const std::chrono::steady_clock::time_point& deadline)
+  {
+    if(timeoutMs < 0) return -1;
+    const long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+    return ms > 0 ? (int)ms : 0;
+  }
+
+  long long key(const Held& h) const
+  {
+    return (_params.match == EVO_GROUP_MATCH_COUNTER_HW) ? (long long)h.metadata->counterHW : h.metadata->timestamp;
+  }
+
+  // Appends the next frame of the camera to its pending frames
+  bool fetch(Camera& cam, int timeoutMs)
+  {
+    Held h;
+    if(evo_irimager_ring_acquire(cam.ringId, EVO_RING_NEXT, timeoutMs, &cam.cursor, &h.data, &h.metadata, &h.slot) != 0)
+      return false;
+    // the entry is overwritten after arrivalCount further frames, possible if other consumers hold this one that long
+    const Arrival& a = cam.arrival[cam.cursor % cam.arrivalCount];
+    const unsigned long long seq = a.seq.load();
+    const long long time = a.time.load();
+    h.arrival = (seq == cam.cursor && a.seq.load() == seq) ? time : -1;
+    cam.pending.push_back(h);
+    return true;
+  }
+
+  void discard(Camera& cam, const Held& h)
+  {
+    evo_irimager_ring_release(cam.ringId, h.slot);
+    cam.framesUnmatched.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Chooses the pending frame of cam closest to the reference key r within the window
+  bool match(Camera& cam, long long r, int timeoutMs, const std::chrono::steady_clock::time_point& deadline, Held* out)
+  {
+    const long long window = _params.window;
+    while(!cam.pending.empty() && key(cam.pending.front()) < r - window)
+    {
+      discard(cam, cam.pending.front());
+      cam.pending.pop_front();
+    }
+
+    // Later frames are only further away once a frame at or beyond r is known
+    while(cam.pending.empty() || key(cam.pending.back()) < r)
+    {
+      if(!fetch(cam, remaining(timeoutMs, deadline))) break;
+      if(key(cam.pending.back()) < r - window)
+      {
+        discard(cam, cam.pending.back());
+        cam.pending.pop_back();
+      }
+    }
+
+    int best = -1;
+    long long bestDistance = 0;
+    for(size_t i = 0; i < cam.pending.size(); i++)
+    {
+      const long long d = key(cam.pending[i]) - r;
+      const long long distance = d < 0 ? -d : d;
+      if(distance <= window && (best < 0 || distance < bestDistance))
+      {
+        best         = (int)i;
+        bestDistance = distance;
+      }
+    }
+    if(best < 0) return false;
+
+    // Frames before the chosen one are older than every future set
+    for(int i = 0; i < best; i++)
+    {
+      discard(cam, cam.pending.front());
+      cam.pending.pop_front();
+    }
+    *out = cam.pending.front();
+    cam.pending.pop_front();
+    return true;
+  }
+
+  EvoIRCaptureGroup(const EvoIRCaptureGroup&);
+  EvoIRCaptureGroup& operator=(const EvoIRCaptureGroup&);
+
+  const EvoIRGroupParams _params;
+  std::vector<Camera*> _cameras;
+  std::mutex _controlMutex;
+  std::mutex _matchMutex;
+  std::atomic<bool> _running;
+  std::atomic<bool> _closed;           // rings destroyed by shutdown
+};
+
+static EvoIRHandleTable<EvoIRCaptureGroup> g_groups;
+typedef EvoIRHandleTable<EvoIRCaptureGroup>::Ref GroupRef;
+
+} // namespace evo
+
+using namespace evo;
+
+void evo_irimager_group_default_params(EvoIRGroupParams* params)
+{
+  if(!params) return;
+  params->match     = EVO_GROUP_MATCH_TIMESTAMP;
+  params->window    = 50000;
+  params->reference = 0;
+  params->complete  = 0;
+  params->slots     = 8;
+}
+
+int evo_irimager_group_create(unsigned int* outGroupId, const EvoIRGroupParams* params)
+{
+  if(!outGroupId || !params || params->window < 0 || params->reference < 0 || params->slots < 4) return -1;
+  if(params->match != EVO_GROUP_MATCH_TIMESTAMP && params->match != EVO_GROUP_MATCH_COUNTER_HW) return -1;
+  EvoIRCaptureGroup* group = new EvoIRCaptureGroup(*params);
+  if(!g_groups.insert(group, outGroupId))
+  {
+    delete group;
+    return -1;
+  }
+  return 0;
+}
+
+int evo_irimager_group_destroy(const unsigned int groupId)
+{
+  {
+    // callers waiting for a set hold references, wake them before remove waits for the references
+    GroupRef group = g_groups.acquire(groupId);
+    if(!group) return -1;
+    group->shutdown();
+  }
+  EvoIRCaptureGroup* group = g_groups.remove(groupId);
+  if(!group) return -1;
+  delete group;
+  return 0;
+}
+
+int evo_irimager_group_add_camera(const unsigned int groupId, const unsigned int camId, int core, unsigned int* index)
+{
+  GroupRef group = g_groups.acquire(groupId);
+  if(!group || !index || core < -1) return -1;
+  int w, h;
+  if(evo_irimager_multi_get_thermal_image_size(camId, &w, &h) != 0) return -1;
+  return group->add(w, h, core, [camId, w, h](unsigned short* data, EvoIRFrameMetadata* metadata) {
+    int tw = w, th = h;
+    return evo_irimager_multi_get_thermal_image_metadata(camId, &tw, &th, data, metadata);
+  }, index) ? 0 : -1;
+}
+
+int evo_irimager_group_add_synthetic(const unsigned int groupId, const unsigned int srcId, int core, unsigned int* index)
+{
+  GroupRef group = g_groups.acquire(groupId);
+  if(!group || !index || core < -1) return -1;
+  int w, h;
+  if(evo_irimager_synthetic_get_thermal_image_size(srcId, &w, &h) != 0) return -1;
+  return group->add(w, h, core, [srcId, w, h](unsigned short* data, EvoIRFrameMetadata* metadata) {
+    int tw = w, th = h;
+    return evo_irimager_synthetic_get_thermal_image_metadata(srcId, &tw, &th, data, metadata);
+  }, index) ? 0 : -1;
+}
+
+int evo_irimager_group_get_ring(const unsigned int groupId, const unsigned int index, unsigned int* ringId)
+{
+  GroupRef group = g_groups.acquire(groupId);
+  if(!group || !ringId) return -1;
+  return group->ring(index, ringId) ? 0 : -1;
+}
+
+int evo_irimager_group_start(const unsigned int groupId)
+{
+  GroupRef group = g_groups.acquire(groupId);
+  if(!group) return -1;
+  return group->start() ? 0 : -1;
+}
+
+int evo_irimager_group_stop(const unsigned int groupId)
+{
+  GroupRef group = g_groups.acquire(groupId);
+  if(!group) return -1;
+  return group->stop() ? 0 : -1;
+}
+
+int evo_irimager_group_acquire_set(const unsigned int groupId, int timeoutMs, EvoIRFrameSet* set)
+{
+  GroupRef group = g_groups.acquire(groupId);
+  if(!group || !set) return -1;
+  return group->acquireSet(timeoutMs, set);
+}
+
+int evo_irimager_group_release_set(const unsigned int groupId, EvoIRFrameSet* set)
+{
+  GroupRef group = g_groups.acquire(groupId);
+  if(!group || !set) return -1;
+  if(!group->releaseSet(set)) return -1;
+  std::memset(set->data, 0, sizeof(set->data));
+  std::memset(set->metadata, 0, sizeof(set->metadata));
+  set->matched = 0;
+  return 0;
+}
+
+int evo_irimager_group_get_camera_stats(const unsigned int groupId, const unsigned int index, EvoIRCameraStats* stats)
+{
+  GroupRef group = g_groups.acquire(groupId);
+  if(!group || !stats) return -1;
+  return group->stats(index, stats) ? 0 : -1;
+}
+
+int evo_irimager_group_reset_stats(const unsigned int groupId)
+{
+  GroupRef group = g_groups.acquire(groupId);
+  if(!group) return -1;
+  group->resetStats();
+  return 0;
+}
@@ -0,0 +1,196 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRCaptureGroup.h
+ * @brief Provides synchronized capturing of several cameras for Easy API C-Library Interface
+ *
+ * A capture group drives cameras initialized by evo_irimager_multi_usb_init /
+ * evo_irimager_multi_tcp_init (or synthetic sources) with one capture thread
+ * per camera, optionally pinned to a processor core. Every camera feeds its
+ * own frame ring (see EvoIRFrameRing.h). evo_irimager_group_acquire_set
+ * combines the frames of all cameras into sets: for each frame of the
+ * reference camera, the frame of every other camera closest in time is chosen
+ * if it lies within the skew window.
+ *
+ * Cameras running at different frame rates are supported. Choose the camera
+ * with the lowest frame rate as reference, so every set can be completed.
+ *
+ * @code
+ * EvoIRGroupParams params;
+ * evo_irimager_group_default_params(&params);
+ * unsigned int groupId, idx;
+ * evo_irimager_group_create(&groupId, &params);
+ * evo_irimager_group_add_camera(groupId, camId27Hz, 0, &idx); // reference
+ * evo_irimager_group_add_camera(groupId, camId80Hz, 1, &idx);
+ * evo_irimager_group_start(groupId);
+ * EvoIRFrameSet set;
+ * while(evo_irimager_group_acquire_set(groupId, 200, &set) == 0)
+ * {
+ *   // ... set.data[0], set.data[1] ...
+ *   evo_irimager_group_release_set(groupId, &set);
+ * }
+ * @endcode
+ */
+
+#ifndef EVOIRCAPTUREGROUP_H_
+#define EVOIRCAPTUREGROUP_H_
+
+#include "irdirectsdk_defs.h"
+#include "EvoIRFrameMetadata.h"
+#include "EvoIRHistogram.h"
+
+#define EVO_GROUP_MAX_CAMERAS 8
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Frame property used to align frames of different cameras
+ */
+typedef enum
+{
+  EVO_GROUP_MATCH_TIMESTAMP = 0, /*!< EvoIRFrameMetadata::timestamp, window in UNITS (10000000 per second) */
+  EVO_GROUP_MATCH_COUNTER_HW = 1 /*!< EvoIRFrameMetadata::counterHW of hardware triggered cameras, window in frames */
+} EvoIRGroupMatchMode;
+
+typedef struct __IRDIRECTSDK_API__ EvoIRGroupParams
+{
+  int match;             /*!< Alignment criterion, see EvoIRGroupMatchMode */
+  long long window;      /*!< Maximum distance of a frame to the reference frame */
+  int reference;         /*!< Index of the reference camera (order of adding) */
+  int complete;          /*!< 1: only sets containing a frame of every camera are delivered, 0: missing frames are NULL */
+  unsigned int slots;    /*!< Number of ring slots per camera */
+} EvoIRGroupParams;
+
+/**
+ * @brief Frame set delivered by evo_irimager_group_acquire_set. Frames are read in place and stay valid until release.
+ */
+typedef struct __IRDIRECTSDK_API__ EvoIRFrameSet
+{
+  unsigned int cameras;                               /*!< Number of cameras in the group */
+  unsigned int matched;                               /*!< Number of cameras contributing a frame */
+  long long skew;                                     /*!< Distance between earliest and latest frame of the set */
+  unsigned short* data[EVO_GROUP_MAX_CAMERAS];        /*!< Thermal image per camera, NULL if no frame was in the window */
+  EvoIRFrameMetadata* metadata[EVO_GROUP_MAX_CAMERAS];/*!< Frame metadata per camera, NULL if no frame was in the window */
+  unsigned int slot[EVO_GROUP_MAX_CAMERAS];           /*!< Internal slot reference */
+} EvoIRFrameSet;
+
+typedef struct __IRDIRECTSDK_API__ EvoIRCameraStats
+{
+  unsigned long long framesProduced;  /*!< Frames written to the ring of the camera */
+  unsigned long long framesDropped;   /*!< Frames lost, detected from gaps in EvoIRFrameMetadata::counter */
+  unsigned long long framesMatched;   /*!< Frames delivered in a set */
+  unsigned long long framesUnmatched; /*!< Frames discarded without being part of a set */
+  EvoIRHistogram latency;             /*!< Time from the return of the grab call until delivery in a set */
+  EvoIRHistogram jitter;              /*!< Deviation of the frame arrival interval from the interval expected from device timestamps */
+} EvoIRCameraStats;
+
+/**
+ * @brief Fills parameter structure with defaults (timestamp alignment, window of 5 ms, reference camera 0, incomplete sets allowed, 8 slots)
+ * @param[out] params parameter structure
+ */
+__IRDIRECTSDK_API__ void evo_irimager_group_default_params(EvoIRGroupParams* params);
+
+/**
+ * @brief Creates an empty capture group
+ * @param[out] outGroupId group instance id for reference
+ * @param[in] params group parameters
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_group_create(unsigned int* outGroupId, const EvoIRGroupParams* params);
+
+/**
+ * @brief Stops capturing and releases the group, waiting acquire_set calls return -1. Cameras are not terminated.
+ * @param[in] groupId group instance id from create to apply this function
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_group_destroy(const unsigned int groupId);
+
+/**
+ * @brief Adds a camera initialized by evo_irimager_multi_usb_init or evo_irimager_multi_tcp_init. Only possible while stopped.
+ * @param[in] groupId group instance id from create to apply this function
+ * @param[in] camId camera instance id from init
+ * @param[in] core processor core the capture thread is bound to, -1 for no binding. On Windows cores of the processor group of the process only (below 64), other cores are not bound.
+ * @param[out] index position of the camera in frame sets
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_group_add_camera(const unsigned int groupId, const unsigned int camId, int core, unsigned int* index);
+
+/**
+ * @brief Adds a synthetic source (see EvoIRSyntheticSource.h). Only possible while stopped.
+ * @param[in] groupId group instance id from create to apply this function
+ * @param[in] srcId source instance id from evo_irimager_synthetic_init
+ * @param[in] core processor core the capture thread is bound to, -1 for no binding. On Windows cores of the processor group of the process only (below 64), other cores are not bound.
+ * @param[out] index position of the source in frame sets
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_group_add_synthetic(const unsigned int groupId, const unsigned int srcId, int core, unsigned int* index);
+
+/**
+ * @brief Accessor to the frame ring of a camera, e.g. to attach further consumers
+ * @param[in] groupId group instance id from create to apply this function
+ * @param[in] index camera position
+ * @param[out] ringId ring instance id, valid until the group is destroyed
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_group_get_ring(const unsigned int groupId, const unsigned int index, unsigned int* ringId);
+
+/**
+ * @brief Starts the capture threads
+ * @param[in] groupId group instance id from create to apply this function
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_group_start(const unsigned int groupId);
+
+/**
+ * @brief Stops the capture threads. Blocks until the pending grab calls have returned.
+ * @param[in] groupId group instance id from create to apply this function
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_group_stop(const unsigned int groupId);
+
+/**
+ * @brief Waits for the next frame of the reference camera and combines it with the closest frames of all other cameras.
+ * Sets are handed out in order, only one thread should acquire sets of a group.
+ * @param[in] groupId group instance id from create to apply this function
+ * @param[in] timeoutMs time to wait for frames in milliseconds, negative values wait infinitely
+ * @param[out] set pointer to EvoIRFrameSet allocate by the user
+ * @return 0 on success, -1 on error, -3 if no set could be completed within timeout
+ */
+__IRDIRECTSDK_API__ int evo_irimager_group_acquire_set(const unsigned int groupId, int timeoutMs, EvoIRFrameSet* set);
+
+/**
+ * @brief Releases all frames of a set
+ * @param[in] groupId group instance id from create to apply this function
+ * @param[in] set set from acquire
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_group_release_set(const unsigned int groupId, EvoIRFrameSet* set);
+
+/**
+ * @brief Accessor to statistics of a camera
+ * @param[in] groupId group instance id from create to apply this function
+ * @param[in] index camera position
+ * @param[out] stats pointer to EvoIRCameraStats allocate by the user
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_group_get_camera_stats(const unsigned int groupId, const unsigned int index, EvoIRCameraStats* stats);
+
+/**
+ * @brief Clears latency and jitter histograms of all cameras
+ * @param[in] groupId group instance id from create to apply this function
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_group_reset_stats(const unsigned int groupId);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* EVOIRCAPTUREGROUP_H_ */
@@ -0,0 +1,450 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRClockModel.cpp
+ * @brief Lower envelope fit of host timestamps over the extended hardware counter
+ *
+ * Frames are grouped into buckets of equal counter range. Of each bucket only
+ * the frame with the lowest timestamp relative to the current fit is kept,
+ * which is the frame of lowest latency. The buckets of the window are fitted
+ * by least squares with a line, or with a parabola once the window holds
+ * twice minBuckets, so that a drift changing with temperature does not bias
+ * the newest timestamps. Buckets whose residual deviates from the median residual
+ * by more than outlierSigma times the scaled median absolute deviation are
+ * rejected and the fit is repeated until the set of inliers is stable. The
+ * model is refitted whenever a bucket completes, i.e. twice per second by
+ * default, so the per frame cost is a few comparisons.
+ *
+ * Counter and host time are kept relative to the first frame after a
+ * (re)start, which keeps the fit well conditioned in double precision.
+ */
+
+#include "EvoIRClockModel.h"
+#include "EvoIRHandleTable.h"
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace evo
+{
+
+namespace
+{
+
+const double UNITS          = 1e7;
+const double MIN_SIGMA      = 1e-7;   // robust deviation assumed at least, timestamps are quantized to 100 ns
+const double ERROR_SIGMA    = 3.0;
+const unsigned int MAX_FITS = 4;
+
+struct Bucket
+{
+  double x;        // counter steps since origin
+  double y;        // host seconds since origin
+  long long index; // bucket number
+};
+
+double median(std::vector<double>& values)
+{
+  const size_t mid = values.size() / 2;
+  std::nth_element(values.begin(), values.begin() + mid, values.end());
+  return values[mid];
+}
+
+} // namespace
+
+class EvoIRClockModel
+{
+public:
+  explicit EvoIRClockModel(const EvoIRClockParams& params) :
+    _params(params),
+    _nominal(1.0 / params.framerate),
+    _frames(0),
+    _resets(0),
+    _wraps(0)
+  {
+    restart();
+  }
+
+  int update(const EvoIRFrameMetadata& metadata, long long* timestamp, double* error)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _frames++;
+    if(!_started)
+    {
+      origin(metadata);
+    }
+    else
+    {
+      // modular difference handles wraparound, steps of 2^31 and more are the counter running backwards
+      const unsigned int delta = metadata.counterHW - _lastHW;
+      const double elapsed     = (metadata.timestamp - _lastHost) / UNITS;
+      const double deviation   = delta * period() - elapsed;
+      if(delta >= 0x80000000u || std::fabs(deviation) > _params.reconnectGap)
+      {
+        _resets++;
+        restart();
+        origin(metadata);
+      }
+      else
+      {
+        if(metadata.counterHW < _lastHW) _wraps++;
+        _ticks += delta;
+      }
+    }
+    _lastHW   = metadata.counterHW;
+    _lastHost = metadata.timestamp;
+
+    const double x = (double)_ticks;
+    const double y = (metadata.timestamp - _host0) / UNITS;
+    add(x, y);
+
+    if(!_valid)
+    {
+      *timestamp = metadata.timestamp;
+      _error     = 0.0;
+      if(error) *error = 0.0;
+      return 1;
+    }
+    *timestamp = corrected(x);
+    _error     = bound(x);
+    if(error) *error = _error;
+    return 0;
+  }
+
+  bool predict(unsigned int counterHW, long long* timestamp, double* error)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(!_valid) return false;
+    const double x = (double)_ticks + (double)(int)(counterHW - _lastHW);
+    *timestamp = corrected(x);
+    if(error) *error = bound(x);
+    return true;
+  }
+
+  void stats(EvoIRClockStats* stats)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    stats->frames   = _frames;
+    stats->buckets  = (unsigned int)_buckets.size();
+    stats->outliers = _outliers;
+    stats->resets   = _resets;
+    stats->wraps    = _wraps;
+    stats->valid    = _valid ? 1 : 0;
+    stats->period   = period();
+    stats->drift    = (period() / _nominal - 1.0) * 1e6;
+    stats->sigma    = _sigma;
+    stats->error    = _error;
+  }
+
+  void reset()
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _resets++;
+    restart();
+  }
+
+private:
+  EvoIRClockModel(const EvoIRClockModel&);
+  EvoIRClockModel& operator=(const EvoIRClockModel&);
+
+  void restart()
+  {
+    _started  = false;
+    _lastHW   = 0;
+    _lastHost = 0;
+    _ticks    = 0;
+    _host0    = 0;
+    _valid    = false;
+    _buckets.clear();
+    _current.index = -1;
+    _terms    = 2;
+    for(int i = 0; i < 3; i++)
+    {
+      _coefficients[i] = 0.0;
+      for(int j = 0; j < 3; j++) _inverse[i][j] = 0.0;
+    }
+    _xMean    = 0.0;
+    _xScale   = 1.0;
+    _period   = _nominal;
+    _outliers = 0;
+    _sigma    = 0.0;
+    _error    = 0.0;
+  }
+
+  void origin(const EvoIRFrameMetadata& metadata)
+  {
+    _started  = true;
+    _ticks    = 0;
+    _host0    = metadata.timestamp;
+    _lastHW   = metadata.counterHW;
+    _lastHost = metadata.timestamp;
+  }
+
+  double period() const { return _period; }
+
+  long long corrected(double x) const
+  {
+    const double u = (x - _xMean) / _xScale;
+    const double y = _coefficients[0] + u * (_coefficients[1] + u * _coefficients[2]);
+    return _host0 + (long long)std::floor(y * UNITS + 0.5);
+  }
+
+  // ERROR_SIGMA standard deviations of the fitted curve at x
+  double bound(double x) const
+  {
+    const double u    = (x - _xMean) / _xScale;
+    const double v[3] = { 1.0, u, u * u };
+    double variance = 0.0;
+    for(unsigned int i = 0; i < _terms; i++)
+      for(unsigned int j = 0; j < _terms; j++)
+        variance += v[i] * _inverse[i][j] * v[j];
+    return ERROR_SIGMA * _sigma * std::sqrt(std::max(variance, 0.0));
+  }
+
+  void add(double x, double y)
+  {
+    const long long index = (long long)std::floor(x * _nominal / _params.bucket);
+    if(index != _current.index)
+    {
+      if(_current.index >= 0)
+      {
+        _buckets.push_back(_current);
+        const double first = x - _params.window / _nominal;
+        while(!_buckets.empty() && _buckets.front().x < first) _buckets.pop_front();
+        fit();
+      }
+      _current.index = index;
+      _current.x     = x;
+      _current.y     = y;
+      return;
+    }
+    // the frame of lowest latency lies lowest relative to the current slope
+    if(y - _period * x < _current.y - _period * _current.x)
+    {
+      _current.x = x;
+      _current.y = y;
+    }
+  }
+
+  /**
+   * @brief Least squares fit of a polynomial in u = (x - xMean) / xScale to the inlier buckets
+   * @param[out] c coefficients
+   * @param[out] inverse inverse of the normal equations
+   * @return false if the normal equations are singular
+   */
+  bool solve(const std::vector<char>& inlier, unsigned int terms, double xMean, double xScale, double c[3], double inverse[3][3]) const
+  {
+    double m[3][6] = { { 0.0 } };
+    double rhs[3]  = { 0.0, 0.0, 0.0 };
+    for(size_t k = 0; k < _buckets.size(); k++)
+    {
+      if(!inlier[k]) continue;
+      const double u    = (_buckets[k].x - xMean) / xScale;
+      const double v[3] = { 1.0, u, u * u };
+      for(unsigned int i = 0; i < terms; i++)
+      {
+        rhs[i] += v[i] * _buckets[k].y;
+        for(unsigned int j = 0; j < terms; j++) m[i][j] += v[i] * v[j];
+      }
+    }
+    // Gauss-Jordan elimination of [M | I] with partial pivoting
+    for(unsigned int i = 0; i < terms; i++) m[i][terms + i] = 1.0;
+    for(unsigned int col = 0; col < terms; col++)
+    {
+      unsigned int pivot = col;
+      for(unsigned int r = col + 1; r < terms; r++)
+        if(std::fabs(m[r][col]) > std::fabs(m[pivot][col])) pivot = r;
+      if(std::fabs(m[pivot][col]) < 1e-12) return false;
+      for(unsigned int j = 0; j < 2 * terms; j++) std::swap(m[col][j], m[pivot][j]);
+      const double f = 1.0 / m[col][col];
+      for(unsigned int j = 0; j < 2 * terms; j++) m[col][j] *= f;
+      for(unsigned int r = 0; r < terms; r++)
+      {
+        if(r == col || m[r][col] == 0.0) continue;
+        const double g = m[r][col];
+        for(unsigned int j = 0; j < 2 * terms; j++) m[r][j] -= g * m[col][j];
+      }
+    }
+    for(unsigned int i = 0; i < 3; i++)
+    {
+      c[i] = 0.0;
+      for(unsigned int j = 0; j < 3; j++)
+      {
+        inverse[i][j] = (i < terms && j < terms) ? m[i][terms + j] : 0.0;
+        if(i < terms && j < terms) c[i] += inverse[i][j] * rhs[j];
+      }
+    }
+    return true;
+  }
+
+  void fit()
+  {
+    const size_t n = _buckets.size();
+    if(n < _params.minBuckets) return;
+
+    // the change of the drift is only fitted once the window is long enough to tell it from latency
+    const unsigned int terms = n >= 2 * _params.minBuckets ? 3 : 2;
+    double xMean = 0.0;
+    for(size_t i = 0; i < n; i++) xMean += _buckets[i].x;
+    xMean /= n;
+    const double xScale = 0.5 * (_buckets.back().x - _buckets.front().x);
+    if(xScale <= 0.0) return;
+
+    std::vector<char> inlier(n, 1);
+    std::vector<double> residuals(n), deviations(n);
+    double c[3], inverse[3][3];
+    for(unsigned int iteration = 0; iteration < MAX_FITS; iteration++)
+    {
+      if(!solve(inlier, terms, xMean, xScale, c, inverse)) return;
+
+      for(size_t i = 0; i < n; i++)
+      {
+        const double u = (_buckets[i].x - xMean) / xScale;
+        residuals[i] = _buckets[i].y - (c[0] + u * (c[1] + u * c[2]));
+      }
+      deviations = residuals;
+      const double center = median(deviations);
+      for(size_t i = 0; i < n; i++) deviations[i] = std::fabs(residuals[i] - center);
+      const double robust = std::max(1.4826 * median(deviations), MIN_SIGMA);
+
+      // a majority of buckets has to agree, otherwise the window is too disturbed to reject anything
+      std::vector<char> next(n);
+      size_t accepted = 0;
+      for(size_t i = 0; i < n; i++)
+      {
+        next[i]   = std::fabs(residuals[i] - center) <= _params.outlierSigma * robust ? 1 : 0;
+        accepted += next[i];
+      }
+      if(accepted < 2 * terms || accepted * 2 < n || next == inlier || iteration + 1 == MAX_FITS) break;
+      inlier.swap(next);
+    }
+
+    double sum = 0.0;
+    size_t count = 0;
+    for(size_t i = 0; i < n; i++)
+    {
+      if(!inlier[i]) continue;
+      sum += residuals[i] * residuals[i];
+      count++;
+    }
+    _terms  = terms;
+    _xMean  = xMean;
+    _xScale = xScale;
+    for(int i = 0; i < 3; i++)
+    {
+      _coefficients[i] = c[i];
+      for(int j = 0; j < 3; j++) _inverse[i][j] = inverse[i][j];
+    }
+    const double u = (_buckets.back().x - xMean) / xScale;
+    _period   = (c[1] + 2.0 * c[2] * u) / xScale;
+    _outliers = (unsigned int)(n - count);
+    _sigma    = std::max(count > terms ? std::sqrt(sum / (count - terms)) : 0.0, MIN_SIGMA);
+    _valid    = true;
+  }
+
+  std::mutex _mutex;
+  EvoIRClockParams _params;
+  double _nominal;
+
+  bool _started;
+  unsigned int _lastHW;
+  long long _lastHost;
+  long long _ticks;   // extended counter since origin
+  long long _host0;   // host timestamp at origin
+
+  std::deque<Bucket> _buckets;
+  Bucket _current;
+
+  bool _valid;
+  unsigned int _terms;       // 2: offset and period, 3: also the change of the period
+  double _coefficients[3];   // host seconds over u = (x - _xMean) / _xScale
+  double _inverse[3][3];     // inverse of the normal equations, covariance of the coefficients / sigma^2
+  double _xMean;
+  double _xScale;
+  double _period;            // host seconds per counter step at the newest bucket
+  unsigned int _outliers;
+  double _sigma;
+  double _error;
+
+  unsigned long long _frames;
+  unsigned int _resets;
+  unsigned int _wraps;
+};
+
+static EvoIRHandleTable<EvoIRClockModel> g_clocks;
+typedef EvoIRHandleTable<EvoIRClockModel>::Ref ClockRef;
+
+} // namespace evo
+
+using namespace evo;
+
+void evo_irimager_clock_default_params(EvoIRClockParams* params, float framerate)
+{
+  if(!params) return;
+  params->framerate    = framerate;
+  params->window       = 60.f;
+  params->bucket       = 0.5f;
+  params->minBuckets   = 8;
+  params->outlierSigma = 3.f;
+  params->reconnectGap = 1.f;
+}
+
+int evo_irimager_clock_create(unsigned int* outClockId, const EvoIRClockParams* params)
+{
+  if(!outClockId || !params || !(params->framerate > 0.f) || !(params->bucket > 0.f) || !(params->outlierSigma > 0.f)) return -1;
+  if(!(params->reconnectGap > 0.f) || params->bucket * params->framerate < 1.f) return -1;
+  if(params->minBuckets < 3 || params->minBuckets > params->window / params->bucket) return -1;
+  EvoIRClockModel* clock = new EvoIRClockModel(*params);
+  if(!g_clocks.insert(clock, outClockId))
+  {
+    delete clock;
+    return -1;
+  }
+  return 0;
+}
+
+int evo_irimager_clock_destroy(const unsigned int clockId)
+{
+  EvoIRClockModel* clock = g_clocks.remove(clockId);
+  if(!clock) return -1;
+  delete clock;
+  return 0;
+}
+
+int evo_irimager_clock_update(const unsigned int clockId, const EvoIRFrameMetadata* metadata, long long* timestamp, double* error)
+{
+  ClockRef clock = g_clocks.acquire(clockId);
+  if(!clock || !metadata || !timestamp) return -1;
+  return clock->update(*metadata, timestamp, error);
+}
+
+int evo_irimager_clock_predict(const unsigned int clockId, unsigned int counterHW, long long* timestamp, double* error)
+{
+  ClockRef clock = g_clocks.acquire(clockId);
+  if(!clock || !timestamp) return -1;
+  return clock->predict(counterHW, timestamp, error) ? 0 : -1;
+}
+
+int evo_irimager_clock_get_stats(const unsigned int clockId, EvoIRClockStats* stats)
+{
+  ClockRef clock = g_clocks.acquire(clockId);
+  if(!clock || !stats) return -1;
+  clock->stats(stats);
+  return 0;
+}
+
+int evo_irimager_clock_reset(const unsigned int clockId)
+{
+  ClockRef clock = g_clocks.acquire(clockId);
+  if(!clock) return -1;
+  clock->reset();
+  return 0;
+}
@@ -0,0 +1,140 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRClockModel.h
+ * @brief Provides a clock model mapping the hardware frame counter to host time for Easy API C-Library Interface
+ *
+ * EvoIRFrameMetadata::timestamp is taken by the host when a frame arrives and
+ * carries the latency of USB transfer and thread scheduling, which varies from
+ * frame to frame. EvoIRFrameMetadata::counterHW counts frames with the clock of
+ * the camera, which runs steadily but drifts against the host clock by some
+ * parts per million. The clock model fits
+ *
+ * timestamp = offset + period * counterHW + latency
+ *
+ * online over a sliding window, including a slow change of period with the
+ * temperature of the camera, and returns offset + period * counterHW as the
+ * corrected timestamp of every frame, i.e. host time without the varying part
+ * of the latency. Since latency only ever delays a timestamp, the fit uses the
+ * frame with the smallest latency in each interval of bucket seconds and
+ * rejects intervals that contain no frame of low latency, e.g. during a stall
+ * of the USB transfer. The constant part of the latency, the minimum, cannot be
+ * observed from the host and remains in the corrected timestamps.
+ *
+ * The counter is extended to 64 bits across wraparounds. A counter jumping
+ * against the elapsed host time, as after a reconnect of the camera, restarts
+ * the model.
+ *
+ * @code
+ * EvoIRClockParams params;
+ * evo_irimager_clock_default_params(&params, 80.f);
+ * evo_irimager_clock_create(&clockId, &params);
+ * // for every frame
+ * long long t;
+ * double error;
+ * if(evo_irimager_clock_update(clockId, &metadata, &t, &error) == 0)
+ *   ...  // t is the corrected timestamp, +/- error seconds
+ * @endcode
+ */
+
+#ifndef EVOIRCLOCKMODEL_H_
+#define EVOIRCLOCKMODEL_H_
+
+#include "irdirectsdk_defs.h"
+#include "EvoIRFrameMetadata.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+typedef struct __IRDIRECTSDK_API__ EvoIRClockParams
+{
+  float framerate;         /*!< Nominal rate of counterHW in Hz, 1 / IRImager::getAvgTimePerFrame() */
+  float window;            /*!< Seconds of history the model is fitted to */
+  float bucket;            /*!< Seconds per interval contributing its frame of lowest latency */
+  unsigned int minBuckets; /*!< Intervals needed before corrected timestamps are returned [3; window / bucket] */
+  float outlierSigma;      /*!< Intervals deviating more than this many robust standard deviations from the fit are rejected */
+  float reconnectGap;      /*!< Seconds counterHW may deviate from the elapsed host time before the model is restarted */
+} EvoIRClockParams;
+
+typedef struct __IRDIRECTSDK_API__ EvoIRClockStats
+{
+  unsigned long long frames; /*!< Frames passed to update */
+  unsigned int buckets;      /*!< Intervals in the window */
+  unsigned int outliers;     /*!< Intervals of the window rejected by the last fit */
+  unsigned int resets;       /*!< Restarts of the model, e.g. after reconnects */
+  unsigned int wraps;        /*!< Wraparounds of counterHW */
+  int valid;                 /*!< 1 if corrected timestamps are returned */
+  double period;             /*!< Fitted seconds of host time per counterHW step */
+  double drift;              /*!< Deviation of the camera clock from the nominal framerate in parts per million */
+  double sigma;              /*!< Standard deviation of the lowest latency frames around the fit in seconds */
+  double error;              /*!< Error bound of the last corrected timestamp in seconds */
+} EvoIRClockStats;
+
+/**
+ * @brief Fills parameter structure with defaults (60 s window, 0.5 s buckets, 8 buckets to start, rejection beyond 3 sigma, restart beyond 1 s)
+ * @param[out] params parameter structure
+ * @param[in] framerate nominal rate of counterHW in Hz
+ */
+__IRDIRECTSDK_API__ void evo_irimager_clock_default_params(EvoIRClockParams* params, float framerate);
+
+/**
+ * @brief Creates a clock model
+ * @param[out] outClockId clock model instance id for reference
+ * @param[in] params model parameters
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_clock_create(unsigned int* outClockId, const EvoIRClockParams* params);
+
+/**
+ * @brief Releases a clock model
+ * @param[in] clockId clock model instance id from create to apply this function
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_clock_destroy(const unsigned int clockId);
+
+/**
+ * @brief Adds a frame to the model and determines its corrected timestamp. Frames are to be passed in the order of arrival.
+ * @param[in] clockId clock model instance id from create to apply this function
+ * @param[in] metadata frame metadata, uses counterHW and timestamp
+ * @param[out] timestamp corrected timestamp in UNITS (10000000 per second), the uncorrected one while the model is not valid
+ * @param[out] error error bound (3 standard deviations of the fitted line) in seconds, 0 while the model is not valid, may be NULL
+ * @return 0 on success, 1 while the model has not seen enough frames after create or a restart, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_clock_update(const unsigned int clockId, const EvoIRFrameMetadata* metadata, long long* timestamp, double* error);
+
+/**
+ * @brief Maps a counterHW value close to the last updated one, e.g. of a frame processed later, to corrected host time
+ * @param[in] clockId clock model instance id from create to apply this function
+ * @param[in] counterHW hardware counter, at most 2^31 steps away from the last updated frame
+ * @param[out] timestamp corrected timestamp in UNITS
+ * @param[out] error error bound in seconds, may be NULL
+ * @return 0 on success, -1 on error or if the model is not valid
+ */
+__IRDIRECTSDK_API__ int evo_irimager_clock_predict(const unsigned int clockId, unsigned int counterHW, long long* timestamp, double* error);
+
+/**
+ * @brief Accessor to model state
+ * @param[in] clockId clock model instance id from create to apply this function
+ * @param[out] stats pointer to EvoIRClockStats allocate by the user
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_clock_get_stats(const unsigned int clockId, EvoIRClockStats* stats);
+
+/**
+ * @brief Restarts the model, e.g. when a camera has been reinitialized
+ * @param[in] clockId clock model instance id from create to apply this function
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_clock_reset(const unsigned int clockId);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* EVOIRCLOCKMODEL_H_ */
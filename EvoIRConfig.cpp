@@ -0,0 +1,532 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRConfig.cpp
+ * @brief Configuration manager applying generic.xml changes at runtime
+ */
+
+#include "EvoIRConfig.h"
+#include "direct_binding.h"
+#include "EvoIRHandleTable.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace evo
+{
+
+namespace
+{
+
+const int RESTART_TIMEOUT_MS = 5000; // init is retried until the camera is available again
+const int RESTART_RETRY_MS   = 50;
+
+enum FieldType
+{
+  FIELD_INT,
+  FIELD_ULONG,
+  FIELD_FLOAT,
+  FIELD_STRING
+};
+
+struct Field
+{
+  const char* key; ///< element path below <imager>
+  FieldType type;
+  size_t offset;
+  size_t size;     ///< capacity of strings
+};
+
+#define EVO_CONFIG_FIELD(key, type, member) { key, type, offsetof(EvoIRConfig, member), sizeof(((EvoIRConfig*)0)->member) }
+
+// file contents in the order of generic.xml
+const Field FIELDS[] = {
+  EVO_CONFIG_FIELD("serial", FIELD_ULONG, serial),
+  EVO_CONFIG_FIELD("videoformatindex", FIELD_INT, videoFormatIndex),
+  EVO_CONFIG_FIELD("formatspath", FIELD_STRING, formatsPath),
+  EVO_CONFIG_FIELD("calipath", FIELD_STRING, caliPath),
+  EVO_CONFIG_FIELD("fov", FIELD_INT, fov),
+  EVO_CONFIG_FIELD("temperature/min", FIELD_INT, tMin),
+  EVO_CONFIG_FIELD("temperature/max", FIELD_INT, tMax),
+  EVO_CONFIG_FIELD("optics_text", FIELD_STRING, opticsText),
+  EVO_CONFIG_FIELD("framerate", FIELD_FLOAT, framerate),
+  EVO_CONFIG_FIELD("bispectral", FIELD_INT, bispectral),
+  EVO_CONFIG_FIELD("autoflag/enable", FIELD_INT, autoflagEnable),
+  EVO_CONFIG_FIELD("autoflag/mininterval", FIELD_FLOAT, autoflagMinInterval),
+  EVO_CONFIG_FIELD("autoflag/maxinterval", FIELD_FLOAT, autoflagMaxInterval),
+  EVO_CONFIG_FIELD("tchipmode", FIELD_INT, tchipMode),
+  EVO_CONFIG_FIELD("tchipfixedvalue", FIELD_FLOAT, tchipFixedValue),
+  EVO_CONFIG_FIELD("focus", FIELD_FLOAT, focus),
+  EVO_CONFIG_FIELD("enable_extended_temp_range", FIELD_INT, extendedTempRange),
+  EVO_CONFIG_FIELD("buffer_queue_size", FIELD_INT, bufferQueueSize),
+  EVO_CONFIG_FIELD("enable_high_precision", FIELD_INT, highPrecision),
+  EVO_CONFIG_FIELD("radial_distortion_correction", FIELD_INT, radialDistortionCorrection),
+  EVO_CONFIG_FIELD("use_external_probe", FIELD_INT, useExternalProbe)
+};
+
+#undef EVO_CONFIG_FIELD
+
+const size_t FIELD_COUNT = sizeof(FIELDS) / sizeof(FIELDS[0]);
+
+std::string trim(const std::string& s)
+{
+  const char* space = " \t\r\n";
+  const size_t begin = s.find_first_not_of(space);
+  if(begin == std::string::npos) return std::string();
+  return s.substr(begin, s.find_last_not_of(space) - begin + 1);
+}
+
+/**
+ * Reads the text of all elements below the root <imager> into values, keyed by their path ("temperature/min").
+ * Sufficient for the configuration files of the library: no attributes of interest, no entities, no CDATA.
+ */
+bool parseXml(const std::string& text, std::map<std::string, std::string>& values)
+{
+  std::vector<std::string> stack;
+  std::string content;
+  size_t i = 0;
+  while(i < text.size())
+  {
+    if(text[i] != '<')
+    {
+      content += text[i++];
+      continue;
+    }
+    if(text.compare(i, 4, "<!--") == 0)
+    {
+      const size_t end = text.find("-->", i + 4);
+      if(end == std::string::npos) return false;
+      i = end + 3;
+      continue;
+    }
+    const size_t end = text.find('>', i);
+    if(end == std::string::npos) return false;
+    std::string tag = text.substr(i + 1, end - i - 1);
+    i = end + 1;
+    if(tag.empty() || tag[0] == '?' || tag[0] == '!') continue;
+
+    const bool closing     = tag[0] == '/';
+    const bool selfClosing = !closing && tag[tag.size() - 1] == '/';
+    if(closing) tag.erase(0, 1);
+    if(selfClosing) tag.erase(tag.size() - 1);
+    const std::string name = trim(tag.substr(0, tag.find_first_of(" \t\r\n")));
+    if(name.empty()) return false;
+
+    if(!closing) stack.push_back(name);
+    else if(stack.empty() || stack.back() != name) return false;
+    if(closing || selfClosing)
+    {
+      if(stack[0] != "imager") return false;
+      std::string path;
+      for(size_t k = 1; k < stack.size(); k++) path += (k > 1 ? "/" : "") + stack[k];
+      if(!path.empty()) values[path] = selfClosing ? std::string() : trim(content);
+      stack.pop_back();
+    }
+    content.clear();
+  }
+  return stack.empty();
+}
+
+bool parseField(const Field& field, const std::string& value, EvoIRConfig* config)
+{
+  char* target = (char*)config + field.offset;
+  if(field.type == FIELD_STRING)
+  {
+    if(value.size() >= field.size) return false;
+    std::memcpy(target, value.c_str(), value.size() + 1);
+    return true;
+  }
+  if(value.empty()) return false;
+  char* end = nullptr;
+  switch(field.type)
+  {
+  case FIELD_INT:   *(int*)target = (int)std::strtol(value.c_str(), &end, 10); break;
+  case FIELD_ULONG: *(unsigned long*)target = std::strtoul(value.c_str(), &end, 10); break;
+  default:          *(float*)target = std::strtof(value.c_str(), &end); break;
+  }
+  return *end == '\0';
+}
+
+std::string formatField(const Field& field, const EvoIRConfig& config)
+{
+  const char* source = (const char*)&config + field.offset;
+  char buffer[64];
+  switch(field.type)
+  {
+  case FIELD_INT:   std::snprintf(buffer, sizeof(buffer), "%d", *(const int*)source); break;
+  case FIELD_ULONG: std::snprintf(buffer, sizeof(buffer), "%lu", *(const unsigned long*)source); break;
+  case FIELD_FLOAT: std::snprintf(buffer, sizeof(buffer), "%.6g", *(const float*)source); break;
+  default:          return std::string(source);
+  }
+  return buffer;
+}
+
+bool equalPalette(const EvoIRConfig& a, const EvoIRConfig& b)
+{
+  return a.paletteId == b.paletteId && a.paletteScale == b.paletteScale
+         && (a.paletteScale != 1 || (a.paletteMin == b.paletteMin && a.paletteMax == b.paletteMax));
+}
+
+// Settings of one change type
+bool differs(int type, const EvoIRConfig& a, const EvoIRConfig& b)
+{
+  switch(type)
+  {
+  case EVO_CONFIG_TEMPERATURE_RANGE: return a.tMin != b.tMin || a.tMax != b.tMax;
+  case EVO_CONFIG_SHUTTER_MODE:      return a.autoflagEnable != b.autoflagEnable;
+  case EVO_CONFIG_FOCUS:             return a.focus != b.focus;
+  case EVO_CONFIG_PALETTE:           return b.paletteId != 0 && !equalPalette(a, b);
+  case EVO_CONFIG_FRAMERATE:         return a.framerate != b.framerate;
+  case EVO_CONFIG_AUTOFLAG_INTERVAL: return a.autoflagMinInterval != b.autoflagMinInterval || a.autoflagMaxInterval != b.autoflagMaxInterval;
+  case EVO_CONFIG_DEVICE:
+    return a.serial != b.serial || a.videoFormatIndex != b.videoFormatIndex || std::strcmp(a.formatsPath, b.formatsPath) != 0
+           || std::strcmp(a.caliPath, b.caliPath) != 0 || a.fov != b.fov || std::strcmp(a.opticsText, b.opticsText) != 0
+           || a.bispectral != b.bispectral;
+  default:
+    return a.tchipMode != b.tchipMode || a.tchipFixedValue != b.tchipFixedValue || a.extendedTempRange != b.extendedTempRange
+           || a.bufferQueueSize != b.bufferQueueSize || a.highPrecision != b.highPrecision
+           || a.radialDistortionCorrection != b.radialDistortionCorrection || a.useExternalProbe != b.useExternalProbe;
+  }
+}
+
+double seconds(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+class EvoIRConfigManager
+{
+public:
+  EvoIRConfigManager() : _width(0), _height(0) { }
+
+  bool attach(const char* xml, const char* formats, const char* log)
+  {
+    evo_irimager_config_default(&_live);
+    if(evo_irimager_config_load(xml, &_live) != 0) return false;
+    if(evo_irimager_get_thermal_image_size(&_width, &_height) != 0) return false;
+    _xml     = xml;
+    _formats = formats ? formats : "";
+    _log     = log ? log : "";
+    const size_t dot = _xml.rfind('.');
+    const size_t sep = _xml.find_last_of("/\\");
+    _applied = (dot != std::string::npos && (sep == std::string::npos || dot > sep) ? _xml.substr(0, dot) : _xml) + ".applied.xml";
+    return true;
+  }
+
+  void live(EvoIRConfig* config)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    *config = _live;
+  }
+
+  int applyFile(const char* path, EvoIRConfigReport* report)
+  {
+    EvoIRConfig config;
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      config = _live;
+    }
+    // elements missing in the file take the library defaults, as in init
+    EvoIRConfig file;
+    evo_irimager_config_default(&file);
+    if(evo_irimager_config_load(path, &file) != 0) return -1;
+    std::memcpy(&config, &file, offsetof(EvoIRConfig, paletteId));
+    return apply(config, path, report);
+  }
+
+  int apply(const EvoIRConfig& target, const char* path, EvoIRConfigReport* report)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::memset(report, 0, sizeof(*report));
+    bool changed[EVO_CONFIG_CHANGE_TYPES];
+    for(int t = 0; t < EVO_CONFIG_CHANGE_TYPES; t++)
+      changed[t] = differs(t, _live, target);
+
+    bool restart = changed[EVO_CONFIG_FRAMERATE] || changed[EVO_CONFIG_AUTOFLAG_INTERVAL] || changed[EVO_CONFIG_DEVICE] || changed[EVO_CONFIG_PROCESSING];
+    int ret = 0;
+    if(!restart && changed[EVO_CONFIG_TEMPERATURE_RANGE])
+    {
+      restart = !runtime(report->changes[EVO_CONFIG_TEMPERATURE_RANGE], [&]() { return evo_irimager_set_temperature_range(target.tMin, target.tMax); });
+      if(!restart)
+      {
+        _live.tMin = target.tMin;
+        _live.tMax = target.tMax;
+      }
+    }
+    if(!restart && changed[EVO_CONFIG_SHUTTER_MODE])
+    {
+      restart = !runtime(report->changes[EVO_CONFIG_SHUTTER_MODE], [&]() { return evo_irimager_set_shutter_mode(target.autoflagEnable ? 1 : 0); });
+      if(!restart) _live.autoflagEnable = target.autoflagEnable;
+    }
+
+    if(restart)
+    {
+      // everything of the file comes with the restart, the library applies the focus on init,
+      // a failed runtime call changed nothing and is reported with the restart that did it
+      ret = this->restart(target, path, report);
+      for(int t = 0; t < EVO_CONFIG_CHANGE_TYPES; t++)
+      {
+        if(t == EVO_CONFIG_PALETTE || !changed[t] || (report->changes[t].method == EVO_CONFIG_RUNTIME && report->changes[t].result == 0)) continue;
+        report->changes[t].method = EVO_CONFIG_RESTART;
+        report->changes[t].result = ret;
+        report->changes[t].outage = report->outage;
+      }
+    }
+    else if(changed[EVO_CONFIG_FOCUS])
+    {
+      if(target.focus < 0.f || runtime(report->changes[EVO_CONFIG_FOCUS], [&]() { return evo_irimager_set_focusmotor_pos(target.focus); }))
+        _live.focus = target.focus;
+      else
+        ret = -1;
+    }
+
+    // a restarted library starts with its default palette
+    if(target.paletteId != 0 && (changed[EVO_CONFIG_PALETTE] || report->restarted))
+    {
+      if(runtime(report->changes[EVO_CONFIG_PALETTE], [&]() { return applyPalette(target); }))
+      {
+        _live.paletteId    = target.paletteId;
+        _live.paletteScale = target.paletteScale;
+        _live.paletteMin   = target.paletteMin;
+        _live.paletteMax   = target.paletteMax;
+      }
+      else
+      {
+        ret = -1;
+      }
+    }
+
+    report->width  = _width;
+    report->height = _height;
+    for(int t = 0; t < EVO_CONFIG_CHANGE_TYPES; t++)
+      if(report->changes[t].method == EVO_CONFIG_RUNTIME) report->outage += report->changes[t].outage;
+    return ret;
+  }
+
+private:
+  EvoIRConfigManager(const EvoIRConfigManager&);
+  EvoIRConfigManager& operator=(const EvoIRConfigManager&);
+
+  template<typename F>
+  bool runtime(EvoIRConfigChange& change, F call)
+  {
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    change.method = EVO_CONFIG_RUNTIME;
+    change.result = call();
+    change.outage = seconds(start);
+    return change.result == 0;
+  }
+
+  static int applyPalette(const EvoIRConfig& config)
+  {
+    int ret = evo_irimager_set_palette(config.paletteId);
+    if(ret == 0) ret = evo_irimager_set_palette_scale(config.paletteScale);
+    if(ret == 0 && config.paletteScale == 1) ret = evo_irimager_set_palette_manual_temp_range(config.paletteMin, config.paletteMax);
+    return ret;
+  }
+
+  // Terminates and initializes with the new file, falls back to the previous one if that fails
+  int restart(const EvoIRConfig& target, const char* path, EvoIRConfigReport* report)
+  {
+    std::string xml = path ? path : _applied;
+    if(!path && evo_irimager_config_save(xml.c_str(), &target) != 0) return -1;
+
+    const int width = _width, height = _height;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    evo_irimager_terminate();
+    report->restarted = 1;
+    int ret = init(xml);
+    if(ret == 0)
+    {
+      EvoIRConfig file = target;
+      std::memcpy(&file.paletteId, &_live.paletteId, sizeof(EvoIRConfig) - offsetof(EvoIRConfig, paletteId));
+      _live = file;
+      _xml  = xml;
+    }
+    else
+    {
+      // the previous file also reverts what has been changed at runtime before the restart
+      EvoIRConfig file;
+      evo_irimager_config_default(&file);
+      if(evo_irimager_config_load(_xml.c_str(), &file) == 0) std::memcpy(&_live, &file, offsetof(EvoIRConfig, paletteId));
+      if(init(_xml) != 0) _width = _height = 0;
+    }
+    report->outage      = seconds(start);
+    report->sizeChanged = (_width != width || _height != height) ? 1 : 0;
+    return ret;
+  }
+
+  // Retries init until the camera has been released by terminate, then waits for the first frame
+  int init(const std::string& xml)
+  {
+    const int previousWidth = _width, previousHeight = _height;
+    const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(RESTART_TIMEOUT_MS);
+    int ret;
+    while((ret = evo_irimager_usb_init(xml.c_str(), _formats.c_str(), _log.c_str())) != 0 && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::sleep_for(std::chrono::milliseconds(RESTART_RETRY_MS));
+    if(ret != 0) return ret;
+    if(evo_irimager_get_thermal_image_size(&_width, &_height) != 0 || _width <= 0 || _height <= 0)
+    {
+      evo_irimager_terminate();
+      return -1;
+    }
+    // the probe buffer is only reallocated if the image size changed
+    if(_width != previousWidth || _height != previousHeight || _probe.empty()) _probe.resize((size_t)_width * _height);
+    int w = _width, h = _height;
+    ret = evo_irimager_get_thermal_image(&w, &h, &_probe[0]);
+    // a camera that does not stream is released, so that the fallback can initialize again
+    if(ret != 0) evo_irimager_terminate();
+    return ret;
+  }
+
+  std::mutex _mutex;
+  EvoIRConfig _live;
+  std::string _xml;
+  std::string _applied;
+  std::string _formats;
+  std::string _log;
+  int _width;
+  int _height;
+  std::vector<unsigned short> _probe;
+};
+
+static EvoIRHandleTable<EvoIRConfigManager> g_configs;
+typedef EvoIRHandleTable<EvoIRConfigManager>::Ref ConfigRef;
+
+} // namespace evo
+
+using namespace evo;
+
+void evo_irimager_config_default(EvoIRConfig* config)
+{
+  if(!config) return;
+  std::memset(config, 0, sizeof(*config));
+#if _WIN32
+  std::strcpy(config->formatsPath, ".\\");
+#else
+  std::strcpy(config->formatsPath, "/usr/share/libirimager");
+#endif
+  config->tMin                = -20;
+  config->tMax                = 100;
+  config->framerate           = 80.f;
+  config->autoflagEnable      = 1;
+  config->autoflagMinInterval = 15.f;
+  config->tchipFixedValue     = 40.f;
+  config->focus               = -1.f;
+  config->bufferQueueSize     = 5;
+  config->paletteScale        = 2;
+  config->paletteMin          = 20.f;
+  config->paletteMax          = 40.f;
+}
+
+int evo_irimager_config_load(const char* path, EvoIRConfig* config)
+{
+  if(!path || !config) return -1;
+  FILE* f = fopen(path, "rb");
+  if(!f) return -1;
+  std::string text;
+  char buffer[4096];
+  size_t n;
+  while((n = fread(buffer, 1, sizeof(buffer), f)) > 0) text.append(buffer, n);
+  fclose(f);
+
+  std::map<std::string, std::string> values;
+  if(!parseXml(text, values)) return -1;
+  EvoIRConfig parsed = *config;
+  for(size_t i = 0; i < FIELD_COUNT; i++)
+  {
+    std::map<std::string, std::string>::const_iterator it = values.find(FIELDS[i].key);
+    if(it != values.end() && !parseField(FIELDS[i], it->second, &parsed)) return -1;
+  }
+  *config = parsed;
+  return 0;
+}
+
+int evo_irimager_config_save(const char* path, const EvoIRConfig* config)
+{
+  if(!path || !config) return -1;
+  std::string xml = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<imager xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\" xmlns:xsd=\"http://www.w3.org/2001/XMLSchema\">\n";
+  std::string group;
+  for(size_t i = 0; i < FIELD_COUNT; i++)
+  {
+    const std::string key = FIELDS[i].key;
+    if(key == "calipath" && config->caliPath[0] == '\0') continue;
+    const size_t slash = key.find('/');
+    const std::string parent = slash == std::string::npos ? std::string() : key.substr(0, slash);
+    const std::string name   = slash == std::string::npos ? key : key.substr(slash + 1);
+    if(parent != group)
+    {
+      if(!group.empty()) xml += "  </" + group + ">\n";
+      if(!parent.empty()) xml += "  <" + parent + ">\n";
+      group = parent;
+    }
+    xml += (group.empty() ? "  <" : "    <") + name + ">" + formatField(FIELDS[i], *config) + "</" + name + ">\n";
+  }
+  if(!group.empty()) xml += "  </" + group + ">\n";
+  xml += "</imager>\n";
+
+  FILE* f = fopen(path, "wb");
+  if(!f) return -1;
+  const bool ok = fwrite(xml.c_str(), 1, xml.size(), f) == xml.size();
+  return (fclose(f) == 0 && ok) ? 0 : -1;
+}
+
+int evo_irimager_config_attach(unsigned int* outCfgId, const char* xml_config, const char* formats_def, const char* log_file)
+{
+  if(!outCfgId || !xml_config) return -1;
+  EvoIRConfigManager* manager = new EvoIRConfigManager();
+  if(!manager->attach(xml_config, formats_def, log_file) || !g_configs.insert(manager, outCfgId))
+  {
+    delete manager;
+    return -1;
+  }
+  return 0;
+}
+
+int evo_irimager_config_detach(const unsigned int cfgId)
+{
+  EvoIRConfigManager* manager = g_configs.remove(cfgId);
+  if(!manager) return -1;
+  delete manager;
+  return 0;
+}
+
+int evo_irimager_config_get(const unsigned int cfgId, EvoIRConfig* config)
+{
+  ConfigRef manager = g_configs.acquire(cfgId);
+  if(!manager || !config) return -1;
+  manager->live(config);
+  return 0;
+}
+
+int evo_irimager_config_apply_file(const unsigned int cfgId, const char* path, EvoIRConfigReport* report)
+{
+  ConfigRef manager = g_configs.acquire(cfgId);
+  if(!manager || !path) return -1;
+  EvoIRConfigReport local;
+  return manager->applyFile(path, report ? report : &local);
+}
+
+int evo_irimager_config_apply(const unsigned int cfgId, const EvoIRConfig* config, EvoIRConfigReport* report)
+{
+  ConfigRef manager = g_configs.acquire(cfgId);
+  if(!manager || !config) return -1;
+  if(config->paletteId != 0 && (config->paletteId < 1 || config->paletteId > 11 || config->paletteScale < 1 || config->paletteScale > 4)) return -1;
+  EvoIRConfigReport local;
+  return manager->apply(*config, nullptr, report ? report : &local);
+}
@@ -0,0 +1,202 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRConfig.h
+ * @brief Provides a configuration manager applying generic.xml changes to a running camera for Easy API C-Library Interface
+ *
+ * The library reads its configuration file only in evo_irimager_usb_init.
+ * Changing it the usual way, terminate and init again, interrupts the stream
+ * for seconds and may change the image size. The configuration manager parses
+ * the file itself and compares it with the configuration the camera runs
+ * with. Changes with a runtime call are applied without interruption:
+ *
+ * - temperature range: evo_irimager_set_temperature_range
+ * - autoflag enable:   evo_irimager_set_shutter_mode
+ * - focus:             evo_irimager_set_focusmotor_pos
+ * - palette:           evo_irimager_set_palette, evo_irimager_set_palette_scale,
+ *                      evo_irimager_set_palette_manual_temp_range
+ *
+ * All other changes, or a failing runtime call, restart the camera with the
+ * new file. The restart retries init until the camera is available again
+ * instead of waiting a fixed time, then waits for the first frame and applies
+ * focus and palette again. The report lists the outage per change type and
+ * whether the image size changed, so buffers are only reallocated if it did.
+ *
+ * The palette is not part of the configuration file. It is kept in
+ * EvoIRConfig next to the file contents and set by
+ * evo_irimager_config_apply; paletteId 0 leaves the palette alone.
+ *
+ * @code
+ * evo_irimager_usb_init("generic.xml", "", "");
+ * evo_irimager_config_attach(&cfgId, "generic.xml", "", "");
+ * // ... generic.xml edited
+ * EvoIRConfigReport report;
+ * evo_irimager_config_apply_file(cfgId, "generic.xml", &report);
+ * if(report.sizeChanged) ...  // reallocate image buffers
+ * @endcode
+ */
+
+#ifndef EVOIRCONFIG_H_
+#define EVOIRCONFIG_H_
+
+#include "irdirectsdk_defs.h"
+
+#define EVO_CONFIG_MAX_PATH 260
+#define EVO_CONFIG_MAX_TEXT 64
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Contents of generic.xml plus palette settings
+ */
+typedef struct __IRDIRECTSDK_API__ EvoIRConfig
+{
+  unsigned long serial;                    /*!< serial: serial number, 0 for the first camera found */
+  int videoFormatIndex;                    /*!< videoformatindex: USB endpoint */
+  char formatsPath[EVO_CONFIG_MAX_PATH];   /*!< formatspath: directory of Formats.def */
+  char caliPath[EVO_CONFIG_MAX_PATH];      /*!< calipath: directory of calibration files, empty if not given */
+  int fov;                                 /*!< fov: field of view of the optics in degree */
+  int tMin;                                /*!< temperature/min: lower bound of temperature range in degree Celsius */
+  int tMax;                                /*!< temperature/max: upper bound of temperature range in degree Celsius */
+  char opticsText[EVO_CONFIG_MAX_TEXT];    /*!< optics_text: optics variant */
+  float framerate;                         /*!< framerate: scaled down frame rate in Hz */
+  int bispectral;                          /*!< bispectral: 1 for the visible channel of PI 200/230 */
+  int autoflagEnable;                      /*!< autoflag/enable: 1 for automatic shutter flag cycles */
+  float autoflagMinInterval;               /*!< autoflag/mininterval: seconds between flag cycles at least */
+  float autoflagMaxInterval;               /*!< autoflag/maxinterval: seconds between flag cycles at most, 0 without limit */
+  int tchipMode;                           /*!< tchipmode: 0 floating, 1 auto, 2 fixed value */
+  float tchipFixedValue;                   /*!< tchipfixedvalue: chip temperature for tchipmode 2 */
+  float focus;                             /*!< focus: focus motor position in % [0; 100], negative to leave it */
+  int extendedTempRange;                   /*!< enable_extended_temp_range */
+  int bufferQueueSize;                     /*!< buffer_queue_size: internal buffer queue size */
+  int highPrecision;                       /*!< enable_high_precision */
+  int radialDistortionCorrection;          /*!< radial_distortion_correction: 0 off, 1 normal, 2 wide */
+  int useExternalProbe;                    /*!< use_external_probe */
+  int paletteId;                           /*!< palette id [1; 11] (see evo_irimager_set_palette), 0 to leave the palette */
+  int paletteScale;                        /*!< scaling method [1; 4] (see evo_irimager_set_palette_scale) */
+  float paletteMin;                        /*!< lower bound of manual scaling in degree Celsius */
+  float paletteMax;                        /*!< upper bound of manual scaling in degree Celsius */
+} EvoIRConfig;
+
+/**
+ * @brief Groups of settings, index of EvoIRConfigReport::changes
+ */
+typedef enum
+{
+  EVO_CONFIG_TEMPERATURE_RANGE = 0, /*!< tMin, tMax */
+  EVO_CONFIG_SHUTTER_MODE      = 1, /*!< autoflagEnable */
+  EVO_CONFIG_FOCUS             = 2, /*!< focus */
+  EVO_CONFIG_PALETTE           = 3, /*!< paletteId, paletteScale, paletteMin, paletteMax */
+  EVO_CONFIG_FRAMERATE         = 4, /*!< framerate */
+  EVO_CONFIG_AUTOFLAG_INTERVAL = 5, /*!< autoflagMinInterval, autoflagMaxInterval */
+  EVO_CONFIG_DEVICE            = 6, /*!< serial, videoFormatIndex, formatsPath, caliPath, fov, opticsText, bispectral */
+  EVO_CONFIG_PROCESSING        = 7, /*!< tchipMode, tchipFixedValue, extendedTempRange, bufferQueueSize, highPrecision, radialDistortionCorrection, useExternalProbe */
+  EVO_CONFIG_CHANGE_TYPES      = 8
+} EvoIRConfigChangeType;
+
+/**
+ * @brief How a change has been applied
+ */
+typedef enum
+{
+  EVO_CONFIG_UNCHANGED = 0,
+  EVO_CONFIG_RUNTIME   = 1, /*!< runtime call of the library */
+  EVO_CONFIG_RESTART   = 2  /*!< terminate and init with the new configuration file */
+} EvoIRConfigMethod;
+
+typedef struct __IRDIRECTSDK_API__ EvoIRConfigChange
+{
+  int method;      /*!< EvoIRConfigMethod */
+  int result;      /*!< return value of the runtime call or init, 0 on success */
+  double outage;   /*!< seconds no frame could be fetched because of this change: duration of the runtime call, for restarts from terminate to the first frame */
+} EvoIRConfigChange;
+
+typedef struct __IRDIRECTSDK_API__ EvoIRConfigReport
+{
+  EvoIRConfigChange changes[EVO_CONFIG_CHANGE_TYPES]; /*!< per EvoIRConfigChangeType, all changes applied by a restart share its outage */
+  int restarted;   /*!< 1 if the camera has been restarted */
+  int sizeChanged; /*!< 1 if the thermal image size differs from the one before */
+  int width;       /*!< thermal image width after applying */
+  int height;      /*!< thermal image height after applying */
+  double outage;   /*!< seconds of outage in total */
+} EvoIRConfigReport;
+
+/**
+ * @brief Fills configuration with the values of the generic.xml shipped with the library, palette left alone
+ * @param[out] config pointer to EvoIRConfig allocate by the user
+ */
+__IRDIRECTSDK_API__ void evo_irimager_config_default(EvoIRConfig* config);
+
+/**
+ * @brief Reads a configuration file. Elements missing in the file keep their value in config.
+ * @param[in] path path of configuration file
+ * @param[in,out] config pointer to EvoIRConfig allocate by the user, e.g. filled by evo_irimager_config_default
+ * @return 0 on success, -1 on error (file missing, malformed XML or value)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_config_load(const char* path, EvoIRConfig* config);
+
+/**
+ * @brief Writes the file contents of a configuration, in the layout of generic.xml without comments
+ * @param[in] path path of configuration file, existing files are overwritten
+ * @param[in] config configuration
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_config_save(const char* path, const EvoIRConfig* config);
+
+/**
+ * @brief Creates a configuration manager for the camera initialized by evo_irimager_usb_init
+ * @param[out] outCfgId configuration manager instance id for reference
+ * @param[in] xml_config configuration file the camera has been initialized with
+ * @param[in] formats_def formats_def passed to evo_irimager_usb_init, used for restarts
+ * @param[in] log_file log_file passed to evo_irimager_usb_init, used for restarts
+ * @return 0 on success, -1 on error (camera not initialized, file not readable)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_config_attach(unsigned int* outCfgId, const char* xml_config, const char* formats_def, const char* log_file);
+
+/**
+ * @brief Releases a configuration manager, the camera stays initialized
+ * @param[in] cfgId configuration manager instance id from attach to apply this function
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_config_detach(const unsigned int cfgId);
+
+/**
+ * @brief Accessor to the configuration the camera runs with
+ * @param[in] cfgId configuration manager instance id from attach to apply this function
+ * @param[out] config pointer to EvoIRConfig allocate by the user
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_config_get(const unsigned int cfgId, EvoIRConfig* config);
+
+/**
+ * @brief Applies a configuration file, the palette stays as it is
+ * @param[in] cfgId configuration manager instance id from attach to apply this function
+ * @param[in] path configuration file, used for init if a restart is needed
+ * @param[out] report pointer to EvoIRConfigReport allocate by the user, may be NULL
+ * @return 0 on success, -1 on error (file not readable, runtime call or restart failed). After a failed
+ * restart the previous configuration file is initialized again, see EvoIRConfigReport::restarted, which
+ * also reverts settings changed at runtime by this call.
+ */
+__IRDIRECTSDK_API__ int evo_irimager_config_apply_file(const unsigned int cfgId, const char* path, EvoIRConfigReport* report);
+
+/**
+ * @brief Applies a configuration. A restart writes it to xml_config of attach with the extension .applied.xml.
+ * @param[in] cfgId configuration manager instance id from attach to apply this function
+ * @param[in] config configuration
+ * @param[out] report pointer to EvoIRConfigReport allocate by the user, may be NULL
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_config_apply(const unsigned int cfgId, const EvoIRConfig* config, EvoIRConfigReport* report);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* EVOIRCONFIG_H_ */
@@ -0,0 +1,701 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIREventRecorder.cpp
+ * @brief Trigger evaluation, pre-trigger ring and background writer of the event recorder
+ *
+ * Frames are numbered in the order they enter the ring, frame f lives in
+ * slot f % slots until frame f + slots replaces it. The acquisition side
+ * (the capture thread or the caller of push_frame) is the only producer: it
+ * evaluates the conditions, publishes the number of buffered frames and
+ * appends events, i.e. frame ranges [start; end), to a small fixed queue.
+ * The end of the current event stays open until its post-trigger window has
+ * passed. The writer thread is the only consumer: it writes the frames of
+ * the oldest event and publishes its position after every frame. Before a
+ * slot is reused, the producer checks that its old frame is not part of an
+ * event the writer has not passed yet; otherwise the new frame is fetched
+ * into a scratch buffer, evaluated and counted as lost.
+ */
+
+#include "EvoIREventRecorder.h"
+#include "EvoIRRecording.h"
+#include "EvoIRSyntheticSource.h"
+#include "direct_binding.h"
+#include "EvoIRHandleTable.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace evo
+{
+
+namespace
+{
+
+const unsigned int EVENT_QUEUE     = 16;        // events waiting for the writer
+const size_t INFO_QUEUE            = 64;
+const unsigned int MANUAL_TRIGGER  = 1u << 31;
+const unsigned long long OPEN      = ~0ULL;     // end of an event still in its post-trigger window
+const int WRITER_WAIT_MS           = 50;
+
+bool flagFrame(const EvoIRFrameMetadata& metadata)
+{
+  return metadata.flagState == irFlagClosing || metadata.flagState == irFlagClose || metadata.flagState == irFlagOpening;
+}
+
+unsigned int toFrames(float seconds, float framerate)
+{
+  return (unsigned int)std::ceil((double)seconds * framerate - 1e-6);
+}
+
+// raw value of the threshold, comparisons are raw > threshold
+int thresholdRaw(double t, short decimalPlaces)
+{
+  const double raw = std::floor((t + 100.0) * std::pow(10.0, decimalPlaces));
+  if(raw < -1.0)    return -1;
+  if(raw > 65535.0) return 65535;
+  return (int)raw;
+}
+
+struct Condition
+{
+  int type;
+  int x0, x1, y0, y1;           // region, exclusive upper bounds
+  int raw;                      // threshold (EVO_EVENT_THRESHOLD, EVO_EVENT_AREA)
+  unsigned int pixels;          // pixels above threshold required (EVO_EVENT_AREA)
+  double rise;                  // rise in raw units within window (EVO_EVENT_RISE)
+  std::vector<int> maxima;      // maxima of the last window + 1 frames (EVO_EVENT_RISE)
+  unsigned int filled;
+  unsigned int pos;
+};
+
+struct Event
+{
+  unsigned long long start;
+  unsigned long long trigger;
+  std::atomic<unsigned long long> end;
+  unsigned int conditions;
+  long long timestampTrigger;
+};
+
+} // namespace
+
+class EvoIREventRecorder
+{
+public:
+  typedef std::function<int(unsigned short*, EvoIRFrameMetadata*)> GrabFunction;
+
+  EvoIREventRecorder(const EvoIREventParams& params, const char* pathPrefix) :
+    _params(params),
+    _prefix(pathPrefix),
+    _pixels((size_t)params.width * params.height),
+    _preFrames(toFrames(params.preTrigger, params.framerate)),
+    _postFrames(toFrames(params.postTrigger, params.framerate)),
+    _slotCount(_preFrames + toFrames(params.backlog, params.framerate) + 1),
+    _images(_pixels * _slotCount),
+    _metadata(_slotCount),
+    _lostBefore(_slotCount),
+    _scratch(_pixels),
+    _events(new Event[EVENT_QUEUE]),
+    _head(0),
+    _pushed(0),
+    _active(false),
+    _end(0),
+    _lastEnd(0),
+    _lostEnd(0),
+    _lost(0),
+    _headShared(0),
+    _pushedShared(0),
+    _done(0),
+    _written(0),
+    _manual(false),
+    _frames(0),
+    _triggers(0),
+    _eventsStarted(0),
+    _eventsWritten(0),
+    _eventsLost(0),
+    _framesWritten(0),
+    _framesLost(0),
+    _writeErrors(0),
+    _backlogMax(0),
+    _writerWaiting(false),
+    _closing(false),
+    _running(false)
+  {
+    for(unsigned int i = 0; i < params.conditionCount; i++)
+    {
+      const EvoIREventCondition& c = params.conditions[i];
+      Condition k;
+      k.type   = c.type;
+      k.x0     = c.w > 0 ? c.x : 0;
+      k.y0     = c.h > 0 ? c.y : 0;
+      k.x1     = c.w > 0 ? c.x + c.w : params.width;
+      k.y1     = c.h > 0 ? c.y + c.h : params.height;
+      k.raw    = thresholdRaw(c.temperature, params.decimalPlaces);
+      k.pixels = (unsigned int)std::max(1.0, std::ceil((double)c.area * (k.x1 - k.x0) * (k.y1 - k.y0) - 1e-6));
+      k.rise   = (double)c.rate * c.window * std::pow(10.0, params.decimalPlaces);
+      if(c.type == EVO_EVENT_RISE)
+        k.maxima.resize(std::max(1u, (unsigned int)std::lround((double)c.window * params.framerate)) + 1);
+      k.filled = 0;
+      k.pos    = 0;
+      _conditions.push_back(k);
+    }
+    for(unsigned int i = 0; i < EVENT_QUEUE; i++)
+      _events[i].end.store(0);
+    _writer = std::thread(&EvoIREventRecorder::writeLoop, this);
+  }
+
+  ~EvoIREventRecorder()
+  {
+    stop();
+    {
+      std::lock_guard<std::mutex> lock(_waitMutex);
+      _closing.store(true);
+      _cond.notify_all();
+    }
+    _writer.join();
+    delete[] _events;
+  }
+
+  int width() const  { return _params.width; }
+  int height() const { return _params.height; }
+
+  bool start(const GrabFunction& grab)
+  {
+    std::lock_guard<std::mutex> lock(_controlMutex);
+    if(_running.load()) return false;
+    _running.store(true);
+    _thread = std::thread(&EvoIREventRecorder::captureLoop, this, grab);
+    return true;
+  }
+
+  void stop()
+  {
+    std::lock_guard<std::mutex> lock(_controlMutex);
+    if(_thread.joinable())
+    {
+      _running.store(false);
+      _thread.join();
+    }
+    // the producer side is idle now, nothing of the current event would follow
+    closeEvent();
+    wakeWriter();
+  }
+
+  bool isCapturing() const
+  {
+    return _running.load();
+  }
+
+  int push(const unsigned short* data, const EvoIRFrameMetadata& metadata)
+  {
+    unsigned short* slot = reserve();
+    std::memcpy(slot ? slot : &_scratch[0], data, _pixels * sizeof(unsigned short));
+    commit(slot, slot ? slot : &_scratch[0], metadata);
+    return slot ? 0 : 1;
+  }
+
+  void trigger()
+  {
+    _manual.store(true);
+  }
+
+  bool poll(EvoIREventInfo* info)
+  {
+    std::lock_guard<std::mutex> lock(_infoMutex);
+    if(_infos.empty()) return false;
+    *info = _infos.front();
+    _infos.pop_front();
+    return true;
+  }
+
+  void stats(EvoIREventStats* stats) const
+  {
+    stats->frames        = _frames.load(std::memory_order_relaxed);
+    stats->triggers      = _triggers.load(std::memory_order_relaxed);
+    stats->events        = _eventsStarted.load(std::memory_order_relaxed);
+    stats->eventsWritten = _eventsWritten.load(std::memory_order_relaxed);
+    stats->eventsLost    = _eventsLost.load(std::memory_order_relaxed);
+    stats->framesWritten = _framesWritten.load(std::memory_order_relaxed);
+    stats->framesLost    = _framesLost.load(std::memory_order_relaxed);
+    stats->writeErrors   = _writeErrors.load(std::memory_order_relaxed);
+    stats->backlogMax    = _backlogMax.load(std::memory_order_relaxed);
+    stats->slots         = _slotCount;
+    stats->bytes         = (unsigned long long)_images.size() * sizeof(unsigned short) + _metadata.size() * sizeof(EvoIRFrameMetadata);
+  }
+
+private:
+  //----------------------------------------------------------------------------
+  // producer
+  //----------------------------------------------------------------------------
+
+  // slot for the next frame, NULL if its old frame still has to be written
+  unsigned short* reserve()
+  {
+    if(_head >= _slotCount && pending(_head - _slotCount)) return 0;
+    return &_images[(_head % _slotCount) * _pixels];
+  }
+
+  bool pending(unsigned long long frame) const
+  {
+    const unsigned long long done    = _done.load();
+    const unsigned long long written = _written.load();
+    if(frame < written) return false;
+    for(unsigned long long e = done; e < _pushed; e++)
+    {
+      const Event& event = _events[e % EVENT_QUEUE];
+      if(frame >= event.start && frame < event.end.load(std::memory_order_relaxed)) return true;
+    }
+    return false;
+  }
+
+  // data is the slot from reserve or the scratch buffer if there was none
+  void commit(unsigned short* slot, const unsigned short* data, const EvoIRFrameMetadata& metadata)
+  {
+    _frames.fetch_add(1, std::memory_order_relaxed);
+    unsigned int hit = evaluate(data, metadata);
+    if(_manual.load(std::memory_order_relaxed) && _manual.exchange(false)) hit |= MANUAL_TRIGGER;
+    if(hit) _triggers.fetch_add(1, std::memory_order_relaxed);
+
+    // position of the frame, or of the next buffered frame if it got lost
+    const unsigned long long pos = _head;
+    if(slot)
+    {
+      _metadata[_head % _slotCount]   = metadata;
+      _lostBefore[_head % _slotCount] = _lost;
+      _lost = 0;
+      _head++;
+    }
+    else
+    {
+      _framesLost.fetch_add(1, std::memory_order_relaxed);
+      _lost++;
+    }
+
+    if(hit) schedule(pos, hit, metadata);
+    if(_active && _head >= _end) closeEvent();
+    _headShared.store(_head);
+    if(_active || hit) wakeWriter();
+  }
+
+  void schedule(unsigned long long pos, unsigned int hit, const EvoIRFrameMetadata& metadata)
+  {
+    if(!_active)
+    {
+      if(_pushed - _done.load() >= EVENT_QUEUE)
+      {
+        // count triggers within one post-trigger window as one event
+        if(pos >= _lostEnd) _eventsLost.fetch_add(1, std::memory_order_relaxed);
+        _lostEnd = pos + 1 + _postFrames;
+        return;
+      }
+      Event& event = _events[_pushed % EVENT_QUEUE];
+      event.start   = std::max(pos > _preFrames ? pos - _preFrames : 0ULL, _lastEnd);
+      event.trigger = pos;
+      event.end.store(OPEN, std::memory_order_relaxed);
+      event.conditions       = hit;
+      event.timestampTrigger = metadata.timestamp;
+      _pushed++;
+      _pushedShared.store(_pushed);
+      _active = true;
+      _eventsStarted.fetch_add(1, std::memory_order_relaxed);
+    }
+    _end = pos + 1 + _postFrames;
+  }
+
+  void closeEvent()
+  {
+    if(!_active) return;
+    const unsigned long long end = std::min(_end, _head);
+    _events[(_pushed - 1) % EVENT_QUEUE].end.store(end);
+    _lastEnd = end;
+    _active  = false;
+  }
+
+  unsigned int evaluate(const unsigned short* data, const EvoIRFrameMetadata& metadata)
+  {
+    if(flagFrame(metadata))
+    {
+      // the flag changes the offsets, a rise across it is meaningless
+      for(size_t i = 0; i < _conditions.size(); i++)
+        _conditions[i].filled = 0;
+      return 0;
+    }
+
+    unsigned int hit = 0;
+    for(size_t i = 0; i < _conditions.size(); i++)
+    {
+      Condition& c = _conditions[i];
+      int maximum = 0;
+      unsigned int above = 0;
+      for(int y = c.y0; y < c.y1; y++)
+      {
+        const unsigned short* row = data + (size_t)y * _params.width;
+        if(c.type == EVO_EVENT_AREA)
+        {
+          for(int x = c.x0; x < c.x1; x++)
+            above += (row[x] > c.raw);
+        }
+        else
+        {
+          for(int x = c.x0; x < c.x1; x++)
+            maximum = std::max(maximum, (int)row[x]);
+        }
+      }
+
+      bool triggered = false;
+      switch(c.type)
+      {
+        case EVO_EVENT_THRESHOLD:
+          triggered = maximum > c.raw;
+          break;
+        case EVO_EVENT_AREA:
+          triggered = above >= c.pixels;
+          break;
+        case EVO_EVENT_RISE:
+        {
+          const unsigned int n = (unsigned int)c.maxima.size();
+          c.maxima[c.pos] = maximum;
+          c.pos = (c.pos + 1) % n;
+          if(c.filled < n) c.filled++;
+          // c.pos now addresses the maximum of window frames ago
+          triggered = c.filled == n && maximum - c.maxima[c.pos] > c.rise;
+          break;
+        }
+      }
+      if(triggered) hit |= 1u << i;
+    }
+    return hit;
+  }
+
+  // without taking the mutex a wakeup can get lost, the writer then catches up after WRITER_WAIT_MS
+  void wakeWriter()
+  {
+    if(_writerWaiting.load()) _cond.notify_one();
+  }
+
+  void captureLoop(GrabFunction grab)
+  {
+    EvoIRFrameMetadata metadata;
+    while(_running.load(std::memory_order_relaxed))
+    {
+      // without a free slot the frame is still fetched to keep the device queue flowing
+      unsigned short* slot = reserve();
+      unsigned short* data = slot ? slot : &_scratch[0];
+      if(grab(data, &metadata) == 0)
+        commit(slot, data, metadata);
+      else
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // writer
+  //----------------------------------------------------------------------------
+
+  void writeLoop()
+  {
+    bool open = false;
+    unsigned int recId = 0;
+    EvoIREventInfo info;
+    for(;;)
+    {
+      const unsigned long long done = _done.load();
+      if(done == _pushedShared.load())
+      {
+        if(_closing.load()) break;
+        waitForWork(done, _written.load());
+        continue;
+      }
+
+      const Event& event = _events[done % EVENT_QUEUE];
+      if(!open)
+      {
+        beginInfo(&info, done, event);
+        info.error = evo_irimager_recorder_open(&recId, info.path, _params.width, _params.height, _params.framerate, _params.compress);
+        if(info.error != 0) _writeErrors.fetch_add(1, std::memory_order_relaxed);
+        _written.store(event.start);
+        open = true;
+      }
+
+      const unsigned long long end   = event.end.load();
+      const unsigned long long head  = _headShared.load();
+      const unsigned long long limit = std::min(end, head);
+      unsigned long long pos = _written.load(std::memory_order_relaxed);
+      if(pos < limit)
+      {
+        if(head - pos > _backlogMax.load(std::memory_order_relaxed))
+          _backlogMax.store((unsigned int)(head - pos), std::memory_order_relaxed);
+        for(; pos < limit; pos++)
+        {
+          const size_t slot = (size_t)(pos % _slotCount);
+          const EvoIRFrameMetadata& metadata = _metadata[slot];
+          if(info.error == 0)
+          {
+            if(evo_irimager_recorder_write_frame(recId, &_images[slot * _pixels], &metadata) == 0)
+            {
+              _framesWritten.fetch_add(1, std::memory_order_relaxed);
+              if(info.frames == 0) info.timestampFirst = metadata.timestamp;
+              else                 info.lost += _lostBefore[slot];
+              info.timestampLast = metadata.timestamp;
+              info.frames++;
+            }
+            else
+            {
+              _writeErrors.fetch_add(1, std::memory_order_relaxed);
+              info.error = -1;
+            }
+          }
+          // the slot may be reused from now on
+          _written.store(pos + 1);
+        }
+        continue;
+      }
+
+      if(end != OPEN && pos >= end)
+      {
+        if(info.error == 0 && evo_irimager_recorder_close(recId) != 0)
+        {
+          _writeErrors.fetch_add(1, std::memory_order_relaxed);
+          info.error = -1;
+        }
+        open = false;
+        {
+          std::lock_guard<std::mutex> lock(_infoMutex);
+          if(_infos.size() >= INFO_QUEUE) _infos.pop_front();
+          _infos.push_back(info);
+        }
+        _eventsWritten.fetch_add(1);
+        _done.store(done + 1);
+        continue;
+      }
+      waitForWork(done, pos);
+    }
+  }
+
+  void beginInfo(EvoIREventInfo* info, unsigned long long index, const Event& event) const
+  {
+    std::memset(info, 0, sizeof(EvoIREventInfo));
+    info->index            = index;
+    info->preFrames        = (unsigned int)(event.trigger - event.start);
+    info->conditions       = event.conditions;
+    info->timestampTrigger = event.timestampTrigger;
+    std::snprintf(info->path, sizeof(info->path), "%s%06llu.evoir", _prefix.c_str(), index);
+  }
+
+  // sleeps until the producer published a frame or an event since the writer looked last
+  void waitForWork(unsigned long long done, unsigned long long pos)
+  {
+    std::unique_lock<std::mutex> lock(_waitMutex);
+    _writerWaiting.store(true);
+    const unsigned long long head = _headShared.load();
+    const bool idle = done == _pushedShared.load() || (head <= pos && _events[done % EVENT_QUEUE].end.load() == OPEN);
+    if(idle && !_closing.load())
+      _cond.wait_for(lock, std::chrono::milliseconds(WRITER_WAIT_MS));
+    _writerWaiting.store(false);
+  }
+
+  EvoIREventRecorder(const EvoIREventRecorder&);
+  EvoIREventRecorder& operator=(const EvoIREventRecorder&);
+
+  const EvoIREventParams _params;
+  const std::string _prefix;
+  const size_t _pixels;
+  const unsigned int _preFrames;
+  const unsigned int _postFrames;
+  const unsigned int _slotCount;
+  std::vector<unsigned short> _images;
+  std::vector<EvoIRFrameMetadata> _metadata;
+  std::vector<unsigned int> _lostBefore;     // frames lost right before the frame of the slot
+  std::vector<unsigned short> _scratch;
+  std::vector<Condition> _conditions;
+  Event* _events;
+
+  // producer state, only touched by the acquiring thread
+  unsigned long long _head;    // frames buffered
+  unsigned long long _pushed;  // events queued
+  bool _active;
+  unsigned long long _end;
+  unsigned long long _lastEnd;
+  unsigned long long _lostEnd;
+  unsigned int _lost;
+
+  // shared between producer and writer
+  std::atomic<unsigned long long> _headShared;
+  std::atomic<unsigned long long> _pushedShared;
+  std::atomic<unsigned long long> _done;     // events completely written
+  std::atomic<unsigned long long> _written;  // next frame the writer writes
+  std::atomic<bool> _manual;
+
+  std::atomic<unsigned long long> _frames;
+  std::atomic<unsigned long long> _triggers;
+  std::atomic<unsigned long long> _eventsStarted;
+  std::atomic<unsigned long long> _eventsWritten;
+  std::atomic<unsigned long long> _eventsLost;
+  std::atomic<unsigned long long> _framesWritten;
+  std::atomic<unsigned long long> _framesLost;
+  std::atomic<unsigned long long> _writeErrors;
+  std::atomic<unsigned int> _backlogMax;
+
+  std::mutex _infoMutex;
+  std::deque<EvoIREventInfo> _infos;
+
+  std::mutex _waitMutex;
+  std::condition_variable _cond;
+  std::atomic<bool> _writerWaiting;
+  std::atomic<bool> _closing;
+  std::thread _writer;
+
+  std::mutex _controlMutex;
+  std::atomic<bool> _running;
+  std::thread _thread;
+};
+
+static EvoIRHandleTable<EvoIREventRecorder> g_recorders;
+typedef EvoIRHandleTable<EvoIREventRecorder>::Ref EventRef;
+
+} // namespace evo
+
+using namespace evo;
+
+void evo_irimager_event_default_params(EvoIREventParams* params, int w, int h, float framerate)
+{
+  if(!params) return;
+  std::memset(params, 0, sizeof(EvoIREventParams));
+  params->width          = w;
+  params->height         = h;
+  params->framerate      = framerate;
+  params->preTrigger     = 2.f;
+  params->postTrigger    = 3.f;
+  params->backlog        = 2.f;
+  params->decimalPlaces  = 1;
+  params->compress       = 1;
+  params->conditionCount = 1;
+  params->conditions[0].type        = EVO_EVENT_THRESHOLD;
+  params->conditions[0].temperature = 100.f;
+  params->conditions[0].rate        = 10.f;
+  params->conditions[0].window      = 1.f;
+  params->conditions[0].area        = 0.01f;
+}
+
+int evo_irimager_event_create(unsigned int* outEventId, const EvoIREventParams* params, const char* pathPrefix)
+{
+  if(!outEventId || !params || !pathPrefix || params->width <= 0 || params->height <= 0 || params->framerate <= 0.f) return -1;
+  if(params->preTrigger < 0.f || params->postTrigger < 0.f || params->backlog < 0.f) return -1;
+  if(params->decimalPlaces < 1 || params->decimalPlaces > 4 || params->conditionCount > EVO_EVENT_MAX_CONDITIONS) return -1;
+  if(std::strlen(pathPrefix) + 32 >= EVO_EVENT_MAX_PATH) return -1;
+  for(unsigned int i = 0; i < params->conditionCount; i++)
+  {
+    const EvoIREventCondition& c = params->conditions[i];
+    if(c.type != EVO_EVENT_THRESHOLD && c.type != EVO_EVENT_RISE && c.type != EVO_EVENT_AREA) return -1;
+    if(c.w < 0 || c.h < 0 || c.x < 0 || c.y < 0) return -1;
+    if((c.w > 0 && c.x + c.w > params->width) || (c.h > 0 && c.y + c.h > params->height)) return -1;
+    if(c.type == EVO_EVENT_RISE && (c.window <= 0.f || c.rate <= 0.f)) return -1;
+    if(c.type == EVO_EVENT_AREA && (c.area <= 0.f || c.area > 1.f)) return -1;
+  }
+  EvoIREventRecorder* recorder = new EvoIREventRecorder(*params, pathPrefix);
+  if(!g_recorders.insert(recorder, outEventId))
+  {
+    delete recorder;
+    return -1;
+  }
+  return 0;
+}
+
+int evo_irimager_event_destroy(const unsigned int eventId)
+{
+  EvoIREventRecorder* recorder = g_recorders.remove(eventId);
+  if(!recorder) return -1;
+  delete recorder;
+  return 0;
+}
+
+int evo_irimager_event_start_capture(const unsigned int eventId)
+{
+  EventRef recorder = g_recorders.acquire(eventId);
+  if(!recorder) return -1;
+  int w, h;
+  if(evo_irimager_get_thermal_image_size(&w, &h) != 0 || w != recorder->width() || h != recorder->height()) return -1;
+  return recorder->start([w, h](unsigned short* data, EvoIRFrameMetadata* metadata) {
+    int tw = w, th = h;
+    return evo_irimager_get_thermal_image_metadata(&tw, &th, data, metadata);
+  }) ? 0 : -1;
+}
+
+int evo_irimager_event_start_multi_capture(const unsigned int eventId, const unsigned int camId)
+{
+  EventRef recorder = g_recorders.acquire(eventId);
+  if(!recorder) return -1;
+  int w, h;
+  if(evo_irimager_multi_get_thermal_image_size(camId, &w, &h) != 0 || w != recorder->width() || h != recorder->height()) return -1;
+  return recorder->start([camId, w, h](unsigned short* data, EvoIRFrameMetadata* metadata) {
+    int tw = w, th = h;
+    return evo_irimager_multi_get_thermal_image_metadata(camId, &tw, &th, data, metadata);
+  }) ? 0 : -1;
+}
+
+int evo_irimager_event_start_synthetic(const unsigned int eventId, const unsigned int srcId)
+{
+  EventRef recorder = g_recorders.acquire(eventId);
+  if(!recorder) return -1;
+  int w, h;
+  if(evo_irimager_synthetic_get_thermal_image_size(srcId, &w, &h) != 0 || w != recorder->width() || h != recorder->height()) return -1;
+  return recorder->start([srcId, w, h](unsigned short* data, EvoIRFrameMetadata* metadata) {
+    int tw = w, th = h;
+    return evo_irimager_synthetic_get_thermal_image_metadata(srcId, &tw, &th, data, metadata);
+  }) ? 0 : -1;
+}
+
+int evo_irimager_event_stop(const unsigned int eventId)
+{
+  EventRef recorder = g_recorders.acquire(eventId);
+  if(!recorder) return -1;
+  recorder->stop();
+  return 0;
+}
+
+int evo_irimager_event_push_frame(const unsigned int eventId, const unsigned short* data, const EvoIRFrameMetadata* metadata)
+{
+  EventRef recorder = g_recorders.acquire(eventId);
+  if(!recorder || !data || !metadata || recorder->isCapturing()) return -1;
+  return recorder->push(data, *metadata);
+}
+
+int evo_irimager_event_trigger(const unsigned int eventId)
+{
+  EventRef recorder = g_recorders.acquire(eventId);
+  if(!recorder) return -1;
+  recorder->trigger();
+  return 0;
+}
+
+int evo_irimager_event_poll(const unsigned int eventId, EvoIREventInfo* info)
+{
+  EventRef recorder = g_recorders.acquire(eventId);
+  if(!recorder || !info) return -1;
+  return recorder->poll(info) ? 0 : -3;
+}
+
+int evo_irimager_event_get_stats(const unsigned int eventId, EvoIREventStats* stats)
+{
+  EventRef recorder = g_recorders.acquire(eventId);
+  if(!recorder || !stats) return -1;
+  recorder->stats(stats);
+  return 0;
+}
@@ -0,0 +1,213 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIREventRecorder.h
+ * @brief Provides event-triggered recording of raw thermal images for Easy API C-Library Interface
+ *
+ * Instead of recording continuously, an event recorder evaluates trigger
+ * conditions on every frame and only writes events to disk: the frames of
+ * the last preTrigger seconds before the triggering frame, the triggering
+ * frame and the frames of the following postTrigger seconds. Every further
+ * trigger within this window extends the event. Each event is written to a
+ * recording of its own (see EvoIRRecording.h), named
+ * <prefix><event number, 6 digits>.evoir.
+ *
+ * All memory is allocated on create: a ring holding the pre-trigger history
+ * plus a backlog of frames waiting for the writer thread. The acquisition
+ * path takes no locks and never waits for the disk: if the writer falls
+ * behind by more than the backlog, new frames are still evaluated but not
+ * buffered and counted as lost.
+ *
+ * @code
+ * EvoIREventParams params;
+ * evo_irimager_event_default_params(&params, w, h, 80.f);
+ * params.conditions[0].temperature = 60.f;
+ * evo_irimager_event_create(&eventId, &params, "C:/events/hotspot_");
+ * evo_irimager_event_start_capture(eventId);
+ * // ...
+ * EvoIREventInfo info;
+ * while(evo_irimager_event_poll(eventId, &info) == 0)
+ *   printf("%s: %u frames\n", info.path, info.frames);
+ * @endcode
+ */
+
+#ifndef EVOIREVENTRECORDER_H_
+#define EVOIREVENTRECORDER_H_
+
+#include "irdirectsdk_defs.h"
+#include "EvoIRFrameMetadata.h"
+
+#define EVO_EVENT_MAX_CONDITIONS 8
+#define EVO_EVENT_MAX_PATH       260
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Trigger conditions, evaluated on the raw values of a region. Frames during a shutter flag cycle are not evaluated.
+ */
+typedef enum
+{
+  EVO_EVENT_THRESHOLD = 0, /*!< Maximum temperature exceeds temperature */
+  EVO_EVENT_RISE      = 1, /*!< Maximum temperature rose by more than rate * window within the last window seconds */
+  EVO_EVENT_AREA      = 2  /*!< Share of pixels above temperature exceeds area */
+} EvoIREventConditionType;
+
+typedef struct __IRDIRECTSDK_API__ EvoIREventCondition
+{
+  int type;          /*!< see EvoIREventConditionType */
+  int x;             /*!< Region left column */
+  int y;             /*!< Region top row */
+  int w;             /*!< Region width, 0 for the whole image */
+  int h;             /*!< Region height, 0 for the whole image */
+  float temperature; /*!< Threshold in degree Celsius (EVO_EVENT_THRESHOLD, EVO_EVENT_AREA) */
+  float rate;        /*!< Rate of rise in Kelvin per second (EVO_EVENT_RISE) */
+  float window;      /*!< Period the rise is measured over in seconds (EVO_EVENT_RISE) */
+  float area;        /*!< Share of region pixels (0; 1] (EVO_EVENT_AREA) */
+} EvoIREventCondition;
+
+typedef struct __IRDIRECTSDK_API__ EvoIREventParams
+{
+  int width;                     /*!< Image width */
+  int height;                    /*!< Image height */
+  float framerate;               /*!< Frame rate of the source in Hz, converts the periods below into frames */
+  float preTrigger;              /*!< Seconds of history written before the triggering frame */
+  float postTrigger;             /*!< Seconds written after the last triggering frame */
+  float backlog;                 /*!< Seconds of frames that may wait for the writer in addition to the history */
+  short decimalPlaces;           /*!< Decimal places of raw values [1; 4], see evo_irimager_thermal_to_celsius */
+  int compress;                  /*!< 1: compress frames lossless, 0: store raw frames */
+  unsigned int conditionCount;   /*!< Number of conditions, any of them triggers */
+  EvoIREventCondition conditions[EVO_EVENT_MAX_CONDITIONS];
+} EvoIREventParams;
+
+/**
+ * @brief Description of a written event, see evo_irimager_event_poll
+ */
+typedef struct __IRDIRECTSDK_API__ EvoIREventInfo
+{
+  unsigned long long index;      /*!< Event number, starting with 0 */
+  char path[EVO_EVENT_MAX_PATH]; /*!< Recording file */
+  unsigned int frames;           /*!< Frames written */
+  unsigned int preFrames;        /*!< Frames before the triggering frame, less than configured if the event started right after the previous one */
+  unsigned int lost;             /*!< Frames between the first and the last frame missing in the recording because they could not be buffered */
+  unsigned int conditions;       /*!< Bit i set if condition i triggered the event, bit 31 for evo_irimager_event_trigger */
+  long long timestampFirst;      /*!< EvoIRFrameMetadata::timestamp of first frame */
+  long long timestampTrigger;    /*!< EvoIRFrameMetadata::timestamp of triggering frame */
+  long long timestampLast;       /*!< EvoIRFrameMetadata::timestamp of last frame */
+  int error;                     /*!< 0, or -1 if the recording could not be created or written */
+} EvoIREventInfo;
+
+typedef struct __IRDIRECTSDK_API__ EvoIREventStats
+{
+  unsigned long long frames;        /*!< Frames evaluated */
+  unsigned long long triggers;      /*!< Frames fulfilling a condition */
+  unsigned long long events;        /*!< Events started */
+  unsigned long long eventsWritten; /*!< Events completely written */
+  unsigned long long eventsLost;    /*!< Events not recorded because too many were waiting for the writer */
+  unsigned long long framesWritten; /*!< Frames written to disk */
+  unsigned long long framesLost;    /*!< Frames not buffered because the writer fell behind */
+  unsigned long long writeErrors;   /*!< Failed file operations */
+  unsigned int backlogMax;          /*!< Maximum number of frames waiting for the writer */
+  unsigned int slots;               /*!< Frames the ring holds */
+  unsigned long long bytes;         /*!< Memory allocated for the ring */
+} EvoIREventStats;
+
+/**
+ * @brief Fills parameter structure with defaults (2 s before, 3 s after the trigger, 2 s backlog, compression, one decimal place,
+ * one condition: maximum of the whole image above 100 degree Celsius)
+ * @param[out] params parameter structure
+ * @param[in] w image width
+ * @param[in] h image height
+ * @param[in] framerate frame rate in Hz
+ */
+__IRDIRECTSDK_API__ void evo_irimager_event_default_params(EvoIREventParams* params, int w, int h, float framerate);
+
+/**
+ * @brief Creates an event recorder and allocates its buffers
+ * @param[out] outEventId event recorder instance id for reference
+ * @param[in] params recorder parameters
+ * @param[in] pathPrefix path and beginning of the file names of the recordings
+ * @return 0 on success, -1 on error (invalid parameters, region outside of image)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_event_create(unsigned int* outEventId, const EvoIREventParams* params, const char* pathPrefix);
+
+/**
+ * @brief Stops acquisition, completes the current event and waits for all events to be written
+ * @param[in] eventId event recorder instance id from create to apply this function
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_event_destroy(const unsigned int eventId);
+
+/**
+ * @brief Starts an acquisition thread on the camera initialized by evo_irimager_usb_init / evo_irimager_tcp_init
+ * @param[in] eventId event recorder instance id from create to apply this function
+ * @return 0 on success, -1 on error (image size mismatch, already running)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_event_start_capture(const unsigned int eventId);
+
+/**
+ * @brief Starts an acquisition thread on a camera initialized by evo_irimager_multi_usb_init / evo_irimager_multi_tcp_init
+ * @param[in] eventId event recorder instance id from create to apply this function
+ * @param[in] camId camera instance id
+ * @return 0 on success, -1 on error (image size mismatch, already running)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_event_start_multi_capture(const unsigned int eventId, const unsigned int camId);
+
+/**
+ * @brief Starts an acquisition thread on a synthetic frame source (see EvoIRSyntheticSource.h)
+ * @param[in] eventId event recorder instance id from create to apply this function
+ * @param[in] srcId synthetic source instance id
+ * @return 0 on success, -1 on error (image size mismatch, already running)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_event_start_synthetic(const unsigned int eventId, const unsigned int srcId);
+
+/**
+ * @brief Stops the acquisition thread if running and completes the current event, which is then written in the background
+ * @param[in] eventId event recorder instance id from create to apply this function
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_event_stop(const unsigned int eventId);
+
+/**
+ * @brief Passes a frame acquired by the caller. Only to be used if no acquisition thread is running.
+ * @param[in] eventId event recorder instance id from create to apply this function
+ * @param[in] data thermal image (size of width * height)
+ * @param[in] metadata frame metadata
+ * @return 0 on success, 1 if the frame was evaluated but could not be buffered, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_event_push_frame(const unsigned int eventId, const unsigned short* data, const EvoIRFrameMetadata* metadata);
+
+/**
+ * @brief Triggers an event with the next frame, e.g. on an external signal
+ * @param[in] eventId event recorder instance id from create to apply this function
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_event_trigger(const unsigned int eventId);
+
+/**
+ * @brief Takes the description of the oldest written event. The last 64 events are kept.
+ * @param[in] eventId event recorder instance id from create to apply this function
+ * @param[out] info pointer to EvoIREventInfo allocate by the user
+ * @return 0 on success, -1 on error, -3 if no event has been written since the last call
+ */
+__IRDIRECTSDK_API__ int evo_irimager_event_poll(const unsigned int eventId, EvoIREventInfo* info);
+
+/**
+ * @brief Accessor to counters
+ * @param[in] eventId event recorder instance id from create to apply this function
+ * @param[out] stats pointer to EvoIREventStats allocate by the user
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_event_get_stats(const unsigned int eventId, EvoIREventStats* stats);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* EVOIREVENTRECORDER_H_ */
@@ -0,0 +1,453 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRFormatPlan.cpp
+ * @brief Formats.def parser and copy plan compiler
+ *
+ * A Def line is executed once symbolically, which yields the list of word
+ * copies (source offset, destination offset, length) of a sub-frame. Copies
+ * continuing the previous one in source and destination are merged, then
+ * sequences of equally long copies with constant source and destination
+ * strides are folded into blocks.
+ */
+
+#include "EvoIRFormatPlan.h"
+#include "EvoIRHandleTable.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace evo
+{
+
+namespace
+{
+
+struct Copy
+{
+  unsigned int src;
+  unsigned int dst;
+  unsigned int len;
+};
+
+struct Block
+{
+  unsigned int src;
+  unsigned int dst;
+  unsigned int len;
+  unsigned int count;
+  unsigned int srcStride;
+  unsigned int dstStride;
+};
+
+struct SubFrame
+{
+  std::vector<Block> data;
+  std::vector<Block> metadata;
+  unsigned int dataWords;
+  unsigned int metadataWords;
+  unsigned int copies;
+  unsigned int ops;
+};
+
+struct Channel
+{
+  int width;
+  int height;
+  float framerate;
+  int subFrames;
+  std::vector<SubFrame> plans;
+};
+
+struct Format
+{
+  std::string guid;
+  std::string name;
+  int inWidth;
+  int inHeight;
+  float inFramerate;
+  std::vector<Channel> channels;
+};
+
+std::string trim(const std::string& s)
+{
+  size_t b = 0, e = s.size();
+  while(b < e && std::isspace((unsigned char)s[b])) b++;
+  while(e > b && std::isspace((unsigned char)s[e - 1])) e--;
+  return s.substr(b, e - b);
+}
+
+std::string normalizeGuid(const std::string& guid)
+{
+  std::string g;
+  for(size_t i = 0; i < guid.size(); i++)
+  {
+    const char c = guid[i];
+    if(c == '{' || c == '}' || std::isspace((unsigned char)c)) continue;
+    g += (char)std::tolower((unsigned char)c);
+  }
+  return g;
+}
+
+void appendCopy(std::vector<Copy>& copies, unsigned int src, unsigned int dst, unsigned int len)
+{
+  if(!copies.empty())
+  {
+    Copy& last = copies.back();
+    if(last.src + last.len == src && last.dst + last.len == dst)
+    {
+      last.len += len;
+      return;
+    }
+  }
+  Copy c = { src, dst, len };
+  copies.push_back(c);
+}
+
+std::vector<Block> foldBlocks(const std::vector<Copy>& copies)
+{
+  std::vector<Block> blocks;
+  size_t i = 0;
+  while(i < copies.size())
+  {
+    Block b = { copies[i].src, copies[i].dst, copies[i].len, 1, 0, 0 };
+    size_t j = i + 1;
+    if(j < copies.size() && copies[j].len == b.len && copies[j].src > b.src && copies[j].dst > b.dst)
+    {
+      b.srcStride = copies[j].src - b.src;
+      b.dstStride = copies[j].dst - b.dst;
+      while(j < copies.size()
+            && copies[j].len == b.len
+            && copies[j].src == copies[j - 1].src + b.srcStride
+            && copies[j].dst == copies[j - 1].dst + b.dstStride)
+      {
+        b.count++;
+        j++;
+      }
+    }
+    blocks.push_back(b);
+    i += b.count;
+  }
+  return blocks;
+}
+
+// Executes a Def line symbolically, e.g. "(0 288 d:382 s:3)(110880 1 m:385)"
+bool compileDef(const std::string& def, unsigned int inWords, unsigned int outWords, SubFrame* plan)
+{
+  std::vector<Copy> data, metadata;
+  plan->dataWords = plan->metadataWords = plan->ops = 0;
+
+  const char* p = def.c_str();
+  for(;;)
+  {
+    while(std::isspace((unsigned char)*p)) p++;
+    if(*p == 0) break;
+    if(*p++ != '(') return false;
+
+    char* end;
+    const unsigned long offset = std::strtoul(p, &end, 10);
+    if(end == p) return false;
+    p = end;
+    const unsigned long count = std::strtoul(p, &end, 10);
+    if(end == p) return false;
+    p = end;
+
+    struct Op { char type; unsigned int n; };
+    std::vector<Op> ops;
+    for(;;)
+    {
+      while(std::isspace((unsigned char)*p)) p++;
+      if(*p == ')') { p++; break; }
+      const char type = *p;
+      if((type != 'd' && type != 's' && type != 'm') || p[1] != ':') return false;
+      p += 2;
+      const unsigned long n = std::strtoul(p, &end, 10);
+      if(end == p) return false;
+      p = end;
+      Op op = { type, (unsigned int)n };
+      ops.push_back(op);
+    }
+
+    unsigned long long src = offset;
+    for(unsigned long k = 0; k < count; k++)
+    {
+      for(size_t o = 0; o < ops.size(); o++)
+      {
+        const Op& op = ops[o];
+        if(op.type != 's' && src + op.n > inWords) return false;
+        if(op.type == 'd')
+        {
+          if(plan->dataWords + op.n > outWords) return false;
+          appendCopy(data, (unsigned int)src, plan->dataWords, op.n);
+          plan->dataWords += op.n;
+        }
+        else if(op.type == 'm')
+        {
+          appendCopy(metadata, (unsigned int)src, plan->metadataWords, op.n);
+          plan->metadataWords += op.n;
+        }
+        src += op.n;
+        plan->ops++;
+      }
+    }
+  }
+
+  if(plan->dataWords != outWords) return false;
+  plan->data     = foldBlocks(data);
+  plan->metadata = foldBlocks(metadata);
+  plan->copies   = (unsigned int)(data.size() + metadata.size());
+  return true;
+}
+
+bool parseNumbers(const std::string& value, float* v, int n)
+{
+  const char* p = value.c_str();
+  for(int i = 0; i < n; i++)
+  {
+    char* end;
+    v[i] = std::strtof(p, &end);
+    if(end == p) return false;
+    p = end;
+  }
+  return true;
+}
+
+void runBlocks(const std::vector<Block>& blocks, const unsigned short* in, unsigned short* out)
+{
+  for(size_t i = 0; i < blocks.size(); i++)
+  {
+    const Block& b = blocks[i];
+    const unsigned short* s = in + b.src;
+    unsigned short* d       = out + b.dst;
+    const size_t bytes      = b.len * sizeof(unsigned short);
+    if(b.len == 1)
+    {
+      for(unsigned int k = 0; k < b.count; k++, s += b.srcStride, d += b.dstStride)
+        *d = *s;
+    }
+    else
+    {
+      for(unsigned int k = 0; k < b.count; k++, s += b.srcStride, d += b.dstStride)
+        std::memcpy(d, s, bytes);
+    }
+  }
+}
+
+} // namespace
+
+class EvoIRFormatSet
+{
+public:
+  bool load(const char* path)
+  {
+    std::ifstream file(path);
+    if(!file) return false;
+
+    Format* format = nullptr;
+    std::string line;
+    while(std::getline(file, line))
+    {
+      const size_t hash = line.find('#');
+      if(hash != std::string::npos) line.erase(hash);
+      line = trim(line);
+      if(line.empty()) continue;
+
+      if(line == "[Format]")
+      {
+        if(format && !finish(*format)) return false;
+        _formats.push_back(Format());
+        format = &_formats.back();
+        format->inWidth = format->inHeight = 0;
+        format->inFramerate = 0.f;
+        continue;
+      }
+      if(line == "[Format end]")
+      {
+        if(format && !finish(*format)) return false;
+        format = nullptr;
+        continue;
+      }
+      if(!format) continue; // file header
+
+      const size_t eq = line.find('=');
+      if(eq == std::string::npos) return false;
+      const std::string key   = trim(line.substr(0, eq));
+      std::string value       = trim(line.substr(eq + 1));
+
+      float v[3];
+      if(key == "Guid")
+      {
+        format->guid = value;
+      }
+      else if(key == "Name")
+      {
+        if(value.size() >= 2 && value[0] == '"' && value[value.size() - 1] == '"') value = value.substr(1, value.size() - 2);
+        format->name = value;
+      }
+      else if(key == "In")
+      {
+        if(!parseNumbers(value, v, 3) || v[0] <= 0 || v[1] <= 0) return false;
+        format->inWidth     = (int)v[0];
+        format->inHeight    = (int)v[1];
+        format->inFramerate = v[2];
+      }
+      else if(key == "Out")
+      {
+        if(!parseNumbers(value, v, 3) || v[0] <= 0 || v[1] <= 0) return false;
+        Channel c;
+        c.width     = (int)v[0];
+        c.height    = (int)v[1];
+        c.framerate = v[2];
+        c.subFrames = 1;
+        format->channels.push_back(c);
+      }
+      else if(key == "SFrames")
+      {
+        if(format->channels.empty() || !parseNumbers(value, v, 1) || v[0] < 1) return false;
+        format->channels.back().subFrames = (int)v[0];
+      }
+      else if(key == "Def")
+      {
+        if(format->channels.empty() || format->inWidth == 0) return false;
+        Channel& c = format->channels.back();
+        SubFrame plan;
+        if(!compileDef(value, (unsigned int)(format->inWidth * format->inHeight), (unsigned int)(c.width * c.height), &plan)) return false;
+        c.plans.push_back(plan);
+      }
+      // HWRev, FWRev, Channels, DeviceRes are not needed for unpacking
+    }
+    return !format || finish(*format);
+  }
+
+  unsigned int count() const
+  {
+    return (unsigned int)_formats.size();
+  }
+
+  const Format* format(unsigned int index) const
+  {
+    return (index < _formats.size()) ? &_formats[index] : nullptr;
+  }
+
+  bool find(const char* guid, int inWidth, int inHeight, unsigned int* index) const
+  {
+    const std::string g = normalizeGuid(guid);
+    for(size_t i = 0; i < _formats.size(); i++)
+    {
+      const Format& f = _formats[i];
+      if(normalizeGuid(f.guid) != g) continue;
+      if((inWidth > 0 && f.inWidth != inWidth) || (inHeight > 0 && f.inHeight != inHeight)) continue;
+      *index = (unsigned int)i;
+      return true;
+    }
+    return false;
+  }
+
+private:
+  static bool finish(const Format& format)
+  {
+    if(format.channels.empty()) return false;
+    for(size_t i = 0; i < format.channels.size(); i++)
+      if((int)format.channels[i].plans.size() != format.channels[i].subFrames) return false;
+    return true;
+  }
+
+  std::vector<Format> _formats;
+};
+
+static EvoIRHandleTable<EvoIRFormatSet> g_formatSets;
+typedef EvoIRHandleTable<EvoIRFormatSet>::Ref FormatSetRef;
+
+} // namespace evo
+
+using namespace evo;
+
+int evo_irimager_formats_load(unsigned int* outFormatsId, const char* formats_def)
+{
+  if(!outFormatsId || !formats_def) return -1;
+  EvoIRFormatSet* set = new EvoIRFormatSet();
+  if(!set->load(formats_def) || !g_formatSets.insert(set, outFormatsId))
+  {
+    delete set;
+    return -1;
+  }
+  return 0;
+}
+
+int evo_irimager_formats_release(const unsigned int formatsId)
+{
+  EvoIRFormatSet* set = g_formatSets.remove(formatsId);
+  if(!set) return -1;
+  delete set;
+  return 0;
+}
+
+int evo_irimager_formats_get_count(const unsigned int formatsId, unsigned int* count)
+{
+  FormatSetRef set = g_formatSets.acquire(formatsId);
+  if(!set || !count) return -1;
+  *count = set->count();
+  return 0;
+}
+
+int evo_irimager_formats_get_info(const unsigned int formatsId, const unsigned int index, EvoIRFormatInfo* info)
+{
+  FormatSetRef set = g_formatSets.acquire(formatsId);
+  const Format* f = set ? set->format(index) : nullptr;
+  if(!f || !info) return -1;
+  std::memset(info, 0, sizeof(EvoIRFormatInfo));
+  std::strncpy(info->guid, f->guid.c_str(), sizeof(info->guid) - 1);
+  std::strncpy(info->name, f->name.c_str(), sizeof(info->name) - 1);
+  info->channels    = (int)f->channels.size();
+  info->inWidth     = f->inWidth;
+  info->inHeight    = f->inHeight;
+  info->inFramerate = f->inFramerate;
+  return 0;
+}
+
+int evo_irimager_formats_find(const unsigned int formatsId, const char* guid, int inWidth, int inHeight, unsigned int* index)
+{
+  FormatSetRef set = g_formatSets.acquire(formatsId);
+  if(!set || !guid || !index) return -1;
+  return set->find(guid, inWidth, inHeight, index) ? 0 : -1;
+}
+
+int evo_irimager_formats_get_channel(const unsigned int formatsId, const unsigned int index, int channel, EvoIRFormatChannel* info)
+{
+  FormatSetRef set = g_formatSets.acquire(formatsId);
+  const Format* f = set ? set->format(index) : nullptr;
+  if(!f || !info || channel < 0 || channel >= (int)f->channels.size()) return -1;
+  const Channel& c = f->channels[channel];
+  const SubFrame& plan = c.plans[0];
+  info->width         = c.width;
+  info->height        = c.height;
+  info->framerate     = c.framerate;
+  info->subFrames     = c.subFrames;
+  info->metadataWords = (int)plan.metadataWords;
+  info->blocks        = (unsigned int)(plan.data.size() + plan.metadata.size());
+  info->copies        = plan.copies;
+  info->ops           = plan.ops;
+  return 0;
+}
+
+int evo_irimager_formats_unpack(const unsigned int formatsId, const unsigned int index, int channel, int subFrame, const unsigned short* transfer, unsigned short* frame, unsigned short* metadata)
+{
+  FormatSetRef set = g_formatSets.acquire(formatsId);
+  const Format* f = set ? set->format(index) : nullptr;
+  if(!f || !transfer || !frame || channel < 0 || channel >= (int)f->channels.size()) return -1;
+  const Channel& c = f->channels[channel];
+  if(subFrame < 0 || subFrame >= c.subFrames) return -1;
+  const SubFrame& plan = c.plans[subFrame];
+  runBlocks(plan.data, transfer, frame);
+  if(metadata) runBlocks(plan.metadata, transfer, metadata);
+  return 0;
+}
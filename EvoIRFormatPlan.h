@@ -0,0 +1,126 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRFormatPlan.h
+ * @brief Provides unpacking of raw USB transfers as described by Formats.def
+ *
+ * Every [Format] block of Formats.def describes how a raw transfer of In
+ * words is split into the Out sized frames of one or more channels. The
+ * Def = (offset count ops) groups are interpreted once when the file is
+ * loaded and compiled into copy plans: runs adjacent in transfer and frame
+ * are merged into single copies, repeating copies with constant strides are
+ * combined into blocks. Unpacking a transfer then only executes a few block
+ * copies per sub-frame.
+ *
+ * Def operations: d:n copies n data words into the frame, s:n skips n words,
+ * m:n copies n words into the metadata buffer of the sub-frame. Offsets and
+ * counts are given in 16 bit words.
+ */
+
+#ifndef EVOIRFORMATPLAN_H_
+#define EVOIRFORMATPLAN_H_
+
+#include "irdirectsdk_defs.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+typedef struct __IRDIRECTSDK_API__ EvoIRFormatInfo
+{
+  char guid[40];     /*!< Format GUID including braces, e.g. {7A9AAE14-E7AE-485f-B73A-946F94C061AB} */
+  char name[64];     /*!< Format name, e.g. PI 160x120 @ 100Hz */
+  int channels;      /*!< Number of channels, 2 for devices with visible camera */
+  int inWidth;       /*!< Transfer width in words */
+  int inHeight;      /*!< Transfer height */
+  float inFramerate; /*!< Transfers per second */
+} EvoIRFormatInfo;
+
+typedef struct __IRDIRECTSDK_API__ EvoIRFormatChannel
+{
+  int width;             /*!< Frame width */
+  int height;            /*!< Frame height */
+  float framerate;       /*!< Frames per second */
+  int subFrames;         /*!< Frames contained in one transfer */
+  int metadataWords;     /*!< Metadata words per frame */
+  unsigned int blocks;   /*!< Copy blocks of the compiled plan for one frame (data and metadata) */
+  unsigned int copies;   /*!< Copy calls of the compiled plan for one frame */
+  unsigned int ops;      /*!< Def operations executed by a plain interpreter for one frame */
+} EvoIRFormatChannel;
+
+/**
+ * @brief Parses a format definition file and compiles all formats
+ * @param[out] outFormatsId format set instance id for reference
+ * @param[in] formats_def path to Formats.def
+ * @return 0 on success, -1 on error (e.g. file not found, syntax error, Def exceeding In or Out size)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_formats_load(unsigned int* outFormatsId, const char* formats_def);
+
+/**
+ * @brief Releases a format set
+ * @param[in] formatsId format set instance id from load to apply this function
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_formats_release(const unsigned int formatsId);
+
+/**
+ * @brief Accessor to the number of formats
+ * @param[in] formatsId format set instance id from load to apply this function
+ * @param[out] count number of [Format] blocks
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_formats_get_count(const unsigned int formatsId, unsigned int* count);
+
+/**
+ * @brief Accessor to the description of a format
+ * @param[in] formatsId format set instance id from load to apply this function
+ * @param[in] index format index [0; count-1], in order of the file
+ * @param[out] info pointer to EvoIRFormatInfo allocate by the user
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_formats_get_info(const unsigned int formatsId, const unsigned int index, EvoIRFormatInfo* info);
+
+/**
+ * @brief Searches a format by GUID (case insensitive, with or without braces). Some GUIDs are shared by formats differing in transfer size.
+ * @param[in] formatsId format set instance id from load to apply this function
+ * @param[in] guid format GUID
+ * @param[in] inWidth transfer width to match, 0 for any
+ * @param[in] inHeight transfer height to match, 0 for any
+ * @param[out] index index of the first matching format
+ * @return 0 on success, -1 on error or if no format matches
+ */
+__IRDIRECTSDK_API__ int evo_irimager_formats_find(const unsigned int formatsId, const char* guid, int inWidth, int inHeight, unsigned int* index);
+
+/**
+ * @brief Accessor to the description of a channel of a format
+ * @param[in] formatsId format set instance id from load to apply this function
+ * @param[in] index format index
+ * @param[in] channel channel index [0; channels-1]
+ * @param[out] info pointer to EvoIRFormatChannel allocate by the user
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_formats_get_channel(const unsigned int formatsId, const unsigned int index, int channel, EvoIRFormatChannel* info);
+
+/**
+ * @brief Extracts a frame and its metadata words from a raw transfer
+ * @param[in] formatsId format set instance id from load to apply this function
+ * @param[in] index format index
+ * @param[in] channel channel index
+ * @param[in] subFrame sub-frame index [0; subFrames-1]
+ * @param[in] transfer raw transfer (size of inWidth * inHeight)
+ * @param[out] frame pointer to unsigned short array allocate by the user (size of width * height)
+ * @param[out] metadata pointer to unsigned short array allocate by the user (size of metadataWords), may be NULL
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_formats_unpack(const unsigned int formatsId, const unsigned int index, int channel, int subFrame, const unsigned short* transfer, unsigned short* frame, unsigned short* metadata);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* EVOIRFORMATPLAN_H_ */
@@ -0,0 +1,362 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRFrameClient.cpp
+ * @brief Frame client of the batched transport
+ *
+ * A receiver thread reads batches from the socket into a bounded queue. With
+ * shared memory the queue only holds sequence numbers and the image is copied
+ * straight from the segment of the server into the buffer of the caller.
+ */
+
+#include "EvoIRFrameTransport.h"
+#include "EvoIRTransportProtocol.h"
+#include "EvoIRSocket.h"
+#include "EvoIRHandleTable.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace evo
+{
+
+class EvoIRFrameClient
+{
+public:
+  EvoIRFrameClient(unsigned int queueFrames) :
+    _socket(INVALID_SOCKET_HANDLE),
+    _width(0),
+    _height(0),
+    _shared(nullptr),
+    _queueFrames(queueFrames),
+    _connected(false),
+    _framesReceived(0),
+    _batchesReceived(0),
+    _framesDropped(0)
+  {
+  }
+
+  ~EvoIRFrameClient()
+  {
+    disconnect();
+  }
+
+  /**
+   * @return 0 on success, -1 if the server is not reachable, -2 on protocol error
+   */
+  int connect(const char* host, int port, bool sharedMemory)
+  {
+    _socket = socketConnect(host, port);
+    if(_socket == INVALID_SOCKET_HANDLE) return -1;
+
+    TransportHello hello;
+    hello.magic    = TRANSPORT_HELLO_MAGIC;
+    hello.version  = TRANSPORT_VERSION;
+    hello.flags    = sharedMemory ? TRANSPORT_FLAG_SHARED : 0;
+    hello.reserved = 0;
+    TransportWelcome welcome;
+    if(!socketSendAll(_socket, &hello, sizeof(hello)) || !socketRecvAll(_socket, &welcome, sizeof(welcome))
+       || welcome.magic != TRANSPORT_WELCOME_MAGIC || welcome.version != TRANSPORT_VERSION || welcome.width <= 0 || welcome.height <= 0)
+      return -2;
+    _width  = welcome.width;
+    _height = welcome.height;
+
+    if(welcome.flags & TRANSPORT_FLAG_SHARED)
+    {
+      welcome.sharedName[sizeof(welcome.sharedName) - 1] = 0;
+      if(welcome.sharedSize >= sizeof(SharedHeader) && _memory.open(welcome.sharedName, (size_t)welcome.sharedSize))
+      {
+        // slots are indexed with slotSize and hold a full image each, the product is checked without overflow
+        const SharedHeader* header = (const SharedHeader*)_memory.data();
+        if(header->magic == SHARED_MAGIC && header->version == TRANSPORT_VERSION && header->width == _width && header->height == _height
+           && header->slots == welcome.sharedSlots && header->slots > 0 && header->slotSize >= sharedSlotSize(_width, _height)
+           && header->slots <= (_memory.size() - sizeof(SharedHeader)) / header->slotSize)
+          _shared = header;
+        else
+          _memory.close();
+      }
+    }
+
+    // fall back to frames inline if the segment could not be mapped
+    TransportReady ready;
+    ready.magic = TRANSPORT_READY_MAGIC;
+    ready.flags = _shared ? TRANSPORT_FLAG_SHARED : 0;
+    if(!socketSendAll(_socket, &ready, sizeof(ready))) return -2;
+
+    _connected.store(true);
+    _thread = std::thread(&EvoIRFrameClient::receiveLoop, this);
+    return 0;
+  }
+
+  /**
+   * Ends the connection, the receiver thread exits and wakes waiting callers
+   */
+  void shutdown()
+  {
+    socketShutdown(_socket);
+  }
+
+  void disconnect()
+  {
+    socketShutdown(_socket);
+    if(_thread.joinable()) _thread.join();
+    socketClose(_socket);
+    _socket = INVALID_SOCKET_HANDLE;
+    _memory.close();
+    _shared = nullptr;
+  }
+
+  int width() const { return _width; }
+  int height() const { return _height; }
+
+  int get(int timeoutMs, unsigned short* data, EvoIRFrameMetadata* metadata, EvoIRTransportFrameInfo* info)
+  {
+    const size_t pixels = (size_t)_width * _height;
+    const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs > 0 ? timeoutMs : 0);
+
+    while(true)
+    {
+      Entry entry;
+      {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while(_queue.empty())
+        {
+          if(!_connected.load()) return -2;
+          if(timeoutMs < 0)
+            _cond.wait(lock);
+          else if(_cond.wait_until(lock, deadline) == std::cv_status::timeout && _queue.empty())
+            return _connected.load() ? -3 : -2;
+        }
+        entry = std::move(_queue.front());
+        _queue.pop_front();
+      }
+
+      long long publishTime;
+      if(_shared)
+      {
+        // seqlock read, the server may overwrite the slot once it wrapped around
+        const SharedSlot* slot = sharedSlot((void*)_shared, entry.seq);
+        if(slot->seq.load(std::memory_order_acquire) != entry.seq)
+        {
+          _framesDropped.fetch_add(1, std::memory_order_relaxed);
+          continue;
+        }
+        publishTime = slot->publishTime;
+        *metadata   = slot->metadata;
+        std::memcpy(data, sharedSlotData((SharedSlot*)slot), pixels * sizeof(unsigned short));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(slot->seq.load(std::memory_order_relaxed) != entry.seq)
+        {
+          _framesDropped.fetch_add(1, std::memory_order_relaxed);
+          continue;
+        }
+      }
+      else
+      {
+        const TransportFrameHeader* header = (const TransportFrameHeader*)&entry.record[0];
+        publishTime = header->publishTime;
+        *metadata   = header->metadata;
+        std::memcpy(data, &entry.record[sizeof(TransportFrameHeader)], pixels * sizeof(unsigned short));
+        recycle(entry.record);
+      }
+
+      if(info)
+      {
+        info->sequence = entry.seq;
+        info->latency  = transportTime() - publishTime;
+      }
+      return 0;
+    }
+  }
+
+  void stats(EvoIRClientStats* stats)
+  {
+    stats->sharedMemory    = _shared ? 1 : 0;
+    stats->framesReceived  = _framesReceived.load();
+    stats->batchesReceived = _batchesReceived.load();
+    stats->framesDropped   = _framesDropped.load();
+  }
+
+private:
+  struct Entry
+  {
+    unsigned long long seq;
+    std::vector<char> record;
+  };
+
+  void receiveLoop()
+  {
+    const size_t record = sizeof(TransportFrameHeader) + (size_t)_width * _height * sizeof(unsigned short);
+    unsigned long long expected = 0;
+
+    while(true)
+    {
+      TransportBatch batch;
+      if(!socketRecvAll(_socket, &batch, sizeof(batch)) || batch.magic != TRANSPORT_BATCH_MAGIC) break;
+
+      std::vector<Entry> entries(batch.frames);
+      bool ok = true;
+      for(unsigned int i = 0; i < batch.frames && ok; i++)
+      {
+        if(_shared)
+        {
+          entries[i].seq = batch.firstSeq + i;
+        }
+        else
+        {
+          entries[i].record = spare(record);
+          ok = socketRecvAll(_socket, &entries[i].record[0], record);
+          entries[i].seq = ((const TransportFrameHeader*)&entries[i].record[0])->seq;
+        }
+      }
+      if(!ok) break;
+
+      // frames the server skipped show up as gaps in the sequence
+      if(batch.frames > 0)
+      {
+        if(expected != 0 && entries[0].seq > expected)
+          _framesDropped.fetch_add(entries[0].seq - expected, std::memory_order_relaxed);
+        expected = entries[batch.frames - 1].seq + 1;
+      }
+      _framesReceived.fetch_add(batch.frames, std::memory_order_relaxed);
+      _batchesReceived.fetch_add(1, std::memory_order_relaxed);
+
+      std::lock_guard<std::mutex> lock(_mutex);
+      for(size_t i = 0; i < entries.size(); i++)
+      {
+        if(_queue.size() >= _queueFrames)
+        {
+          // same bound as recycle, a buffer beyond it is freed with the entry
+          if(_spare.size() < _queueFrames) _spare.push_back(std::move(_queue.front().record));
+          _queue.pop_front();
+          _framesDropped.fetch_add(1, std::memory_order_relaxed);
+        }
+        _queue.push_back(std::move(entries[i]));
+      }
+      _cond.notify_all();
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _connected.store(false);
+    _cond.notify_all();
+  }
+
+  /**
+   * @brief Record buffers are recycled to avoid allocations at frame rate
+   */
+  std::vector<char> spare(size_t size)
+  {
+    std::vector<char> buffer;
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if(!_spare.empty())
+      {
+        buffer = std::move(_spare.back());
+        _spare.pop_back();
+      }
+    }
+    buffer.resize(size);
+    return buffer;
+  }
+
+  void recycle(std::vector<char>& buffer)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(_spare.size() < _queueFrames) _spare.push_back(std::move(buffer));
+  }
+
+  EvoIRFrameClient(const EvoIRFrameClient&);
+  EvoIRFrameClient& operator=(const EvoIRFrameClient&);
+
+  SocketHandle _socket;
+  int _width;
+  int _height;
+
+  EvoIRSharedMemory _memory;
+  const SharedHeader* _shared;
+
+  const size_t _queueFrames;
+  std::mutex _mutex;
+  std::condition_variable _cond;
+  std::deque<Entry> _queue;
+  std::vector<std::vector<char> > _spare;
+  std::thread _thread;
+  std::atomic<bool> _connected;
+
+  std::atomic<unsigned long long> _framesReceived;
+  std::atomic<unsigned long long> _batchesReceived;
+  std::atomic<unsigned long long> _framesDropped;
+};
+
+static EvoIRHandleTable<EvoIRFrameClient> g_clients;
+typedef EvoIRHandleTable<EvoIRFrameClient>::Ref ClientRef;
+
+} // namespace evo
+
+using namespace evo;
+
+int evo_irimager_client_connect(unsigned int* outClientId, const char* host, int port, int sharedMemory, unsigned int queueFrames)
+{
+  if(!outClientId || !host || port <= 0 || port > 65535 || queueFrames < 1) return -1;
+  EvoIRFrameClient* client = new EvoIRFrameClient(queueFrames);
+  const int ret = client->connect(host, port, sharedMemory != 0);
+  if(ret != 0)
+  {
+    delete client;
+    return ret;
+  }
+  if(!g_clients.insert(client, outClientId))
+  {
+    delete client;
+    return -1;
+  }
+  return 0;
+}
+
+int evo_irimager_client_disconnect(const unsigned int clientId)
+{
+  {
+    // callers waiting for a frame hold references, wake them before remove waits for the references
+    ClientRef client = g_clients.acquire(clientId);
+    if(!client) return -1;
+    client->shutdown();
+  }
+  EvoIRFrameClient* client = g_clients.remove(clientId);
+  if(!client) return -1;
+  delete client;
+  return 0;
+}
+
+int evo_irimager_client_get_thermal_image_size(const unsigned int clientId, int* w, int* h)
+{
+  ClientRef client = g_clients.acquire(clientId);
+  if(!client || !w || !h) return -1;
+  *w = client->width();
+  *h = client->height();
+  return 0;
+}
+
+int evo_irimager_client_get_thermal_image_metadata(const unsigned int clientId, int timeoutMs, int* w, int* h, unsigned short* data, EvoIRFrameMetadata* metadata, EvoIRTransportFrameInfo* info)
+{
+  ClientRef client = g_clients.acquire(clientId);
+  if(!client || !w || !h || !data || !metadata) return -1;
+  if(*w != client->width() || *h != client->height()) return -1;
+  return client->get(timeoutMs, data, metadata, info);
+}
+
+int evo_irimager_client_get_stats(const unsigned int clientId, EvoIRClientStats* stats)
+{
+  ClientRef client = g_clients.acquire(clientId);
+  if(!client || !stats) return -1;
+  client->stats(stats);
+  return 0;
+}
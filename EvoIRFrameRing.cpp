@@ -0,0 +1,443 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRFrameRing.cpp
+ * @brief Lock-free single-producer/multi-consumer frame ring
+ *
+ * Every slot carries a sequence number (0 while empty or being written) and a
+ * reader count. A consumer announces itself by incrementing the reader count
+ * and then validates that the sequence number is unchanged. The producer
+ * retracts a slot by clearing its sequence number and then checks the reader
+ * count, backing off to the next slot if a consumer holds it. Both sides use
+ * sequentially consistent operations, so at least one of them observes the
+ * other and a slot is never written while it is being read.
+ */
+
+#include "EvoIRFrameRing.h"
+#include "EvoIRSyntheticSource.h"
+#include "direct_binding.h"
+#include "EvoIRHandleTable.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace evo
+{
+
+class EvoIRFrameRing
+{
+public:
+  typedef std::function<int(unsigned short*, EvoIRFrameMetadata*)> GrabFunction;
+
+  EvoIRFrameRing(int w, int h, unsigned int slots) :
+    _width(w),
+    _height(h),
+    _slotCount(slots),
+    _slots(new Slot[slots]),
+    _writePos(0),
+    _writing(-1),
+    _sequence(0),
+    _lastCounter(0),
+    _haveCounter(false),
+    _framesProduced(0),
+    _framesDropped(0),
+    _framesRejected(0),
+    _waiters(0),
+    _shutdown(false),
+    _running(false)
+  {
+    // Pad every image to a multiple of 64 bytes to keep slots on separate cache lines
+    _stride = ((size_t)w * h + 31) & ~(size_t)31;
+    _memory.resize(_stride * slots + 32);
+    unsigned short* base = &_memory[0];
+    while(((size_t)base & 63) != 0) base++;
+    for(unsigned int i = 0; i < slots; i++)
+    {
+      _slots[i].seq.store(0);
+      _slots[i].readers.store(0);
+      _slots[i].data = base + i * _stride;
+      std::memset(&_slots[i].metadata, 0, sizeof(EvoIRFrameMetadata));
+    }
+    _scratch.resize((size_t)w * h);
+  }
+
+  ~EvoIRFrameRing()
+  {
+    stop();
+    delete[] _slots;
+  }
+
+  int width() const           { return _width; }
+  int height() const          { return _height; }
+  unsigned int slotCount() const { return _slotCount; }
+
+  bool start(const GrabFunction& grab)
+  {
+    std::lock_guard<std::mutex> lock(_controlMutex);
+    if(_running.load() || _writing.load() >= 0) return false;
+    _running.store(true);
+    _thread = std::thread(&EvoIRFrameRing::captureLoop, this, grab);
+    return true;
+  }
+
+  bool stop()
+  {
+    std::lock_guard<std::mutex> lock(_controlMutex);
+    if(!_thread.joinable()) return false;
+    _running.store(false);
+    _thread.join();
+    return true;
+  }
+
+  bool isCapturing() const
+  {
+    return _running.load();
+  }
+
+  /**
+   * Wakes all consumers waiting in acquire and makes them and later callers
+   * of acquire return -1, so that they drop their references to the ring.
+   */
+  void shutdown()
+  {
+    std::lock_guard<std::mutex> lock(_waitMutex);
+    _shutdown.store(true);
+    _cond.notify_all();
+  }
+
+  bool beginWrite(unsigned short** data, EvoIRFrameMetadata** metadata)
+  {
+    if(_writing.load() >= 0) return false;
+    for(unsigned int attempt = 0; attempt < _slotCount; attempt++)
+    {
+      const unsigned int idx = (unsigned int)(_writePos++ % _slotCount);
+      Slot& slot = _slots[idx];
+      const unsigned long long old = slot.seq.load();
+      slot.seq.store(0);
+      if(slot.readers.load() == 0)
+      {
+        _writing.store((int)idx);
+        *data     = slot.data;
+        *metadata = &slot.metadata;
+        return true;
+      }
+      // held by a consumer, restore and try the next one
+      slot.seq.store(old);
+    }
+    _framesRejected.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  bool endWrite(bool commit)
+  {
+    const int idx = _writing.load();
+    if(idx < 0) return false;
+    Slot& slot = _slots[idx];
+    _writing.store(-1);
+    if(!commit) return true;
+
+    countDropped(slot.metadata.counter);
+    const unsigned long long seq = _sequence.load(std::memory_order_relaxed) + 1;
+    slot.seq.store(seq);
+    _sequence.store(seq);
+    _framesProduced.fetch_add(1, std::memory_order_relaxed);
+
+    if(_waiters.load() > 0)
+    {
+      std::lock_guard<std::mutex> lock(_waitMutex);
+      _cond.notify_all();
+    }
+    return true;
+  }
+
+  int acquire(int mode, int timeoutMs, unsigned long long* sequence, unsigned short** data, EvoIRFrameMetadata** metadata, unsigned int* slotIdx)
+  {
+    if(_shutdown.load()) return -1;
+
+    const unsigned long long last = *sequence;
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs > 0 ? timeoutMs : 0);
+
+    for(;;)
+    {
+      int idx;
+      unsigned long long seq;
+      while(findSlot(mode, last, &idx, &seq))
+      {
+        Slot& slot = _slots[idx];
+        slot.readers.fetch_add(1);
+        if(slot.seq.load() == seq)
+        {
+          *sequence = seq;
+          *data     = slot.data;
+          *metadata = &slot.metadata;
+          *slotIdx  = (unsigned int)idx;
+          return 0;
+        }
+        // recycled in between, search again
+        slot.readers.fetch_sub(1);
+      }
+
+      if(timeoutMs == 0) return -3;
+
+      std::unique_lock<std::mutex> lock(_waitMutex);
+      _waiters.fetch_add(1);
+      bool timedOut = false;
+      while(_sequence.load() <= last && !_shutdown.load() && !timedOut)
+      {
+        if(timeoutMs < 0)
+          _cond.wait(lock);
+        else
+          timedOut = (_cond.wait_until(lock, deadline) == std::cv_status::timeout);
+      }
+      _waiters.fetch_sub(1);
+      if(_shutdown.load()) return -1;
+      if(timedOut && _sequence.load() <= last) return -3;
+    }
+  }
+
+  bool release(unsigned int slotIdx)
+  {
+    if(slotIdx >= _slotCount) return false;
+    Slot& slot = _slots[slotIdx];
+    unsigned int readers = slot.readers.load();
+    while(readers > 0)
+    {
+      if(slot.readers.compare_exchange_weak(readers, readers - 1)) return true;
+    }
+    return false;
+  }
+
+  void stats(EvoIRRingStats* stats) const
+  {
+    stats->framesProduced = _framesProduced.load(std::memory_order_relaxed);
+    stats->framesDropped  = _framesDropped.load(std::memory_order_relaxed);
+    stats->framesRejected = _framesRejected.load(std::memory_order_relaxed);
+    stats->lastSequence   = _sequence.load();
+  }
+
+private:
+  struct Slot
+  {
+    std::atomic<unsigned long long> seq;
+    std::atomic<unsigned int> readers;
+    unsigned short* data;
+    EvoIRFrameMetadata metadata;
+    char pad[64];
+  };
+
+  bool findSlot(int mode, unsigned long long last, int* idx, unsigned long long* seq) const
+  {
+    *idx = -1;
+    *seq = 0;
+    for(unsigned int i = 0; i < _slotCount; i++)
+    {
+      const unsigned long long s = _slots[i].seq.load(std::memory_order_acquire);
+      if(s <= last) continue;
+      if(*idx < 0 || (mode == EVO_RING_LATEST ? s > *seq : s < *seq))
+      {
+        *idx = (int)i;
+        *seq = s;
+      }
+    }
+    return *idx >= 0;
+  }
+
+  void countDropped(unsigned int counter)
+  {
+    // A counter running backwards indicates a reconnect, do not count this as loss
+    if(_haveCounter && counter > _lastCounter + 1)
+      _framesDropped.fetch_add(counter - _lastCounter - 1, std::memory_order_relaxed);
+    _lastCounter = counter;
+    _haveCounter = true;
+  }
+
+  void captureLoop(GrabFunction grab)
+  {
+    while(_running.load(std::memory_order_relaxed))
+    {
+      unsigned short* data;
+      EvoIRFrameMetadata* metadata;
+      if(beginWrite(&data, &metadata))
+      {
+        const bool ok = (grab(data, metadata) == 0);
+        endWrite(ok);
+        if(!ok) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      else
+      {
+        // All slots are held, the frame still has to be fetched to keep the device queue flowing
+        EvoIRFrameMetadata scratchMetadata;
+        if(grab(&_scratch[0], &scratchMetadata) == 0)
+          countDropped(scratchMetadata.counter);
+        else
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    }
+  }
+
+  EvoIRFrameRing(const EvoIRFrameRing&);
+  EvoIRFrameRing& operator=(const EvoIRFrameRing&);
+
+  const int _width;
+  const int _height;
+  const unsigned int _slotCount;
+  size_t _stride;
+  std::vector<unsigned short> _memory;
+  std::vector<unsigned short> _scratch;
+  Slot* _slots;
+
+  // producer state, only written by the producing thread, _writing is also read by start
+  unsigned long long _writePos;
+  std::atomic<int> _writing;
+  std::atomic<unsigned long long> _sequence;
+  unsigned int _lastCounter;
+  bool _haveCounter;
+
+  std::atomic<unsigned long long> _framesProduced;
+  std::atomic<unsigned long long> _framesDropped;
+  std::atomic<unsigned long long> _framesRejected;
+
+  std::mutex _waitMutex;
+  std::condition_variable _cond;
+  std::atomic<int> _waiters;
+  std::atomic<bool> _shutdown;
+
+  std::mutex _controlMutex;
+  std::atomic<bool> _running;
+  std::thread _thread;
+};
+
+static EvoIRHandleTable<EvoIRFrameRing> g_rings;
+typedef EvoIRHandleTable<EvoIRFrameRing>::Ref RingRef;
+
+} // namespace evo
+
+using namespace evo;
+
+int evo_irimager_ring_create(unsigned int* outRingId, int w, int h, unsigned int slots)
+{
+  if(!outRingId || w <= 0 || h <= 0 || slots < 2) return -1;
+  EvoIRFrameRing* ring = new EvoIRFrameRing(w, h, slots);
+  if(!g_rings.insert(ring, outRingId))
+  {
+    delete ring;
+    return -1;
+  }
+  return 0;
+}
+
+int evo_irimager_ring_destroy(const unsigned int ringId)
+{
+  {
+    // consumers waiting in acquire hold references, wake them before remove waits for the references
+    RingRef ring = g_rings.acquire(ringId);
+    if(!ring) return -1;
+    ring->shutdown();
+  }
+  EvoIRFrameRing* ring = g_rings.remove(ringId);
+  if(!ring) return -1;
+  delete ring;
+  return 0;
+}
+
+int evo_irimager_ring_get_size(const unsigned int ringId, int* w, int* h, unsigned int* slots)
+{
+  RingRef ring = g_rings.acquire(ringId);
+  if(!ring || !w || !h || !slots) return -1;
+  *w     = ring->width();
+  *h     = ring->height();
+  *slots = ring->slotCount();
+  return 0;
+}
+
+int evo_irimager_ring_start_capture(const unsigned int ringId)
+{
+  RingRef ring = g_rings.acquire(ringId);
+  if(!ring) return -1;
+  int w, h;
+  if(evo_irimager_get_thermal_image_size(&w, &h) != 0 || w != ring->width() || h != ring->height()) return -1;
+  return ring->start([w, h](unsigned short* data, EvoIRFrameMetadata* metadata) {
+    int tw = w, th = h;
+    return evo_irimager_get_thermal_image_metadata(&tw, &th, data, metadata);
+  }) ? 0 : -1;
+}
+
+int evo_irimager_ring_start_multi_capture(const unsigned int ringId, const unsigned int camId)
+{
+  RingRef ring = g_rings.acquire(ringId);
+  if(!ring) return -1;
+  int w, h;
+  if(evo_irimager_multi_get_thermal_image_size(camId, &w, &h) != 0 || w != ring->width() || h != ring->height()) return -1;
+  return ring->start([camId, w, h](unsigned short* data, EvoIRFrameMetadata* metadata) {
+    int tw = w, th = h;
+    return evo_irimager_multi_get_thermal_image_metadata(camId, &tw, &th, data, metadata);
+  }) ? 0 : -1;
+}
+
+int evo_irimager_ring_start_synthetic(const unsigned int ringId, const unsigned int srcId)
+{
+  RingRef ring = g_rings.acquire(ringId);
+  if(!ring) return -1;
+  int w, h;
+  if(evo_irimager_synthetic_get_thermal_image_size(srcId, &w, &h) != 0 || w != ring->width() || h != ring->height()) return -1;
+  return ring->start([srcId, w, h](unsigned short* data, EvoIRFrameMetadata* metadata) {
+    int tw = w, th = h;
+    return evo_irimager_synthetic_get_thermal_image_metadata(srcId, &tw, &th, data, metadata);
+  }) ? 0 : -1;
+}
+
+int evo_irimager_ring_stop(const unsigned int ringId)
+{
+  RingRef ring = g_rings.acquire(ringId);
+  if(!ring) return -1;
+  return ring->stop() ? 0 : -1;
+}
+
+int evo_irimager_ring_begin_write(const unsigned int ringId, unsigned short** data, EvoIRFrameMetadata** metadata)
+{
+  RingRef ring = g_rings.acquire(ringId);
+  if(!ring || !data || !metadata || ring->isCapturing()) return -1;
+  return ring->beginWrite(data, metadata) ? 0 : -1;
+}
+
+int evo_irimager_ring_end_write(const unsigned int ringId, int commit)
+{
+  RingRef ring = g_rings.acquire(ringId);
+  if(!ring || ring->isCapturing()) return -1;
+  return ring->endWrite(commit != 0) ? 0 : -1;
+}
+
+int evo_irimager_ring_acquire(const unsigned int ringId, int mode, int timeoutMs, unsigned long long* sequence, unsigned short** data, EvoIRFrameMetadata** metadata, unsigned int* slot)
+{
+  RingRef ring = g_rings.acquire(ringId);
+  if(!ring || !sequence || !data || !metadata || !slot) return -1;
+  if(mode != EVO_RING_NEXT && mode != EVO_RING_LATEST) return -1;
+  return ring->acquire(mode, timeoutMs, sequence, data, metadata, slot);
+}
+
+int evo_irimager_ring_release(const unsigned int ringId, const unsigned int slot)
+{
+  RingRef ring = g_rings.acquire(ringId);
+  if(!ring) return -1;
+  return ring->release(slot) ? 0 : -1;
+}
+
+int evo_irimager_ring_get_stats(const unsigned int ringId, EvoIRRingStats* stats)
+{
+  RingRef ring = g_rings.acquire(ringId);
+  if(!ring || !stats) return -1;
+  ring->stats(stats);
+  return 0;
+}
@@ -0,0 +1,167 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRFrameRing.h
+ * @brief Provides zero-copy frame ring buffer access for Easy API C-Library Interface
+ *
+ * A frame ring holds a preallocated set of slots, each consisting of a thermal
+ * image and its EvoIRFrameMetadata. One producer (a capture thread bound to a
+ * camera, a synthetic source or the user) fills the slots, any number of
+ * consumers acquire slots and read them in place. Acquired slots are never
+ * overwritten until they are released again, all other slots are recycled
+ * oldest first. Neither producer nor consumers take locks on the frame path.
+ *
+ * Typical consumer loop:
+ * @code
+ * unsigned long long seq = 0;
+ * unsigned short* data; EvoIRFrameMetadata* meta; unsigned int slot;
+ * while(evo_irimager_ring_acquire(ringId, EVO_RING_NEXT, 100, &seq, &data, &meta, &slot) != -1)
+ * {
+ *   // ... process data ...
+ *   evo_irimager_ring_release(ringId, slot);
+ * }
+ * @endcode
+ */
+
+#ifndef EVOIRFRAMERING_H_
+#define EVOIRFRAMERING_H_
+
+#include "irdirectsdk_defs.h"
+#include "EvoIRFrameMetadata.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Selection of the frame handed out by evo_irimager_ring_acquire
+ */
+typedef enum
+{
+  EVO_RING_NEXT   = 0, /*!< Oldest frame newer than the given sequence number, i.e. read all frames still held by the ring */
+  EVO_RING_LATEST = 1  /*!< Newest frame, intermediate frames are skipped */
+} EvoIRRingAcquireMode;
+
+typedef struct __IRDIRECTSDK_API__ EvoIRRingStats
+{
+  unsigned long long framesProduced; /*!< Frames committed to the ring */
+  unsigned long long framesDropped;  /*!< Frames lost before reaching the ring, derived from gaps of EvoIRFrameMetadata::counter */
+  unsigned long long framesRejected; /*!< Frames discarded because all slots were held by consumers */
+  unsigned long long lastSequence;   /*!< Sequence number of the newest frame, 0 if ring is empty */
+} EvoIRRingStats;
+
+/**
+ * @brief Creates a frame ring with preallocated slots
+ * @param[out] outRingId ring instance id for reference
+ * @param[in] w image width
+ * @param[in] h image height
+ * @param[in] slots number of slots, should exceed the number of frames consumers hold at the same time
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_ring_create(unsigned int* outRingId, int w, int h, unsigned int slots);
+
+/**
+ * @brief Stops a running capture thread and releases the ring. Pointers handed out before are invalidated. Waiting acquire calls return -1,
+ * other ring calls running meanwhile complete before the ring is released.
+ * @param[in] ringId ring instance id from create to apply this function
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_ring_destroy(const unsigned int ringId);
+
+/**
+ * @brief Accessor to image width, height and number of slots
+ * @param[in] ringId ring instance id from create to apply this function
+ * @param[out] w width
+ * @param[out] h height
+ * @param[out] slots number of slots
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_ring_get_size(const unsigned int ringId, int* w, int* h, unsigned int* slots);
+
+/**
+ * @brief Starts a capture thread feeding the ring from the camera initialized by evo_irimager_usb_init or evo_irimager_tcp_init
+ * @param[in] ringId ring instance id from create to apply this function
+ * @return 0 on success, -1 on error (e.g. producer already running, image size mismatch)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_ring_start_capture(const unsigned int ringId);
+
+/**
+ * @brief Starts a capture thread feeding the ring from a camera initialized by evo_irimager_multi_usb_init or evo_irimager_multi_tcp_init
+ * @param[in] ringId ring instance id from create to apply this function
+ * @param[in] camId Camera instance id from init
+ * @return 0 on success, -1 on error (e.g. producer already running, image size mismatch)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_ring_start_multi_capture(const unsigned int ringId, const unsigned int camId);
+
+/**
+ * @brief Starts a capture thread feeding the ring from a synthetic source (see EvoIRSyntheticSource.h)
+ * @param[in] ringId ring instance id from create to apply this function
+ * @param[in] srcId source instance id from evo_irimager_synthetic_init
+ * @return 0 on success, -1 on error (e.g. producer already running, image size mismatch)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_ring_start_synthetic(const unsigned int ringId, const unsigned int srcId);
+
+/**
+ * @brief Stops the capture thread. Blocks until the pending grab call has returned.
+ * @param[in] ringId ring instance id from create to apply this function
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_ring_stop(const unsigned int ringId);
+
+/**
+ * @brief Producer side: reserves the next free slot for writing. Only to be used if no capture thread is running.
+ * @param[in] ringId ring instance id from create to apply this function
+ * @param[out] data pointer to the image memory of the slot (size of w * h)
+ * @param[out] metadata pointer to the metadata of the slot
+ * @return 0 on success, -1 on error or if all slots are held by consumers (frame is counted as rejected)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_ring_begin_write(const unsigned int ringId, unsigned short** data, EvoIRFrameMetadata** metadata);
+
+/**
+ * @brief Producer side: publishes the slot reserved by evo_irimager_ring_begin_write
+ * @param[in] ringId ring instance id from create to apply this function
+ * @param[in] commit 1 to publish the frame, 0 to discard it (e.g. if the grab failed)
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_ring_end_write(const unsigned int ringId, int commit);
+
+/**
+ * @brief Consumer side: acquires a frame for reading in place. The slot must be handed back with evo_irimager_ring_release.
+ * @param[in] ringId ring instance id from create to apply this function
+ * @param[in] mode frame selection, see EvoIRRingAcquireMode
+ * @param[in] timeoutMs time to wait for a new frame in milliseconds, 0 polls, negative values wait infinitely
+ * @param[in,out] sequence sequence number of the last frame seen by this consumer (0 at start), updated to the acquired frame.
+ *                A jump of more than 1 means the consumer was too slow and frames were recycled.
+ * @param[out] data pointer to image data (size of w * h)
+ * @param[out] metadata pointer to frame metadata
+ * @param[out] slot slot index to be passed to evo_irimager_ring_release
+ * @return 0 on success, -1 on error, -3 if no new frame arrived within timeout
+ */
+__IRDIRECTSDK_API__ int evo_irimager_ring_acquire(const unsigned int ringId, int mode, int timeoutMs, unsigned long long* sequence, unsigned short** data, EvoIRFrameMetadata** metadata, unsigned int* slot);
+
+/**
+ * @brief Consumer side: releases a slot acquired by evo_irimager_ring_acquire
+ * @param[in] ringId ring instance id from create to apply this function
+ * @param[in] slot slot index from acquire
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_ring_release(const unsigned int ringId, const unsigned int slot);
+
+/**
+ * @brief Accessor to ring statistics
+ * @param[in] ringId ring instance id from create to apply this function
+ * @param[out] stats pointer to EvoIRRingStats allocate by the user
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_ring_get_stats(const unsigned int ringId, EvoIRRingStats* stats);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* EVOIRFRAMERING_H_ */
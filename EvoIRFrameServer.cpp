@@ -0,0 +1,420 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRFrameServer.cpp
+ * @brief Frame server of the batched transport
+ *
+ * publish() copies a frame into a history ring (for TCP clients) and into the
+ * shared memory segment, then wakes the sender threads. Every client has its
+ * own sender thread and cursor, so a slow client only delays itself: while it
+ * is sending, further frames accumulate and go out in the next batch. Clients
+ * falling behind the history lose the oldest frames.
+ */
+
+#include "EvoIRFrameTransport.h"
+#include "EvoIRTransportProtocol.h"
+#include "EvoIRSocket.h"
+#include "EvoIRHandleTable.h"
+
+#include <condition_variable>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#   include <unistd.h>
+#endif
+
+namespace evo
+{
+
+class EvoIRFrameServer
+{
+public:
+  EvoIRFrameServer(int w, int h, const EvoIRServerParams& params) :
+    _width(w),
+    _height(h),
+    _params(params),
+    _listen(INVALID_SOCKET_HANDLE),
+    _history(params.historyFrames),
+    _published(0),
+    _shared(nullptr),
+    _sharedClients(0),
+    _framesSent(0),
+    _batchesSent(0),
+    _framesDropped(0),
+    _running(false)
+  {
+    for(size_t i = 0; i < _history.size(); i++)
+    {
+      _history[i].seq = 0;
+      _history[i].data.resize((size_t)w * h);
+    }
+  }
+
+  ~EvoIRFrameServer()
+  {
+    stop();
+  }
+
+  bool start(unsigned int id)
+  {
+    _listen = socketListen(_params.port, _params.localOnly != 0);
+    if(_listen == INVALID_SOCKET_HANDLE) return false;
+
+    if(_params.sharedMemory)
+    {
+#ifdef _WIN32
+      _sharedName = "Local\\evoir_" + std::to_string(GetCurrentProcessId()) + "_" + std::to_string(id);
+#else
+      _sharedName = "/evoir_" + std::to_string(getpid()) + "_" + std::to_string(id);
+#endif
+      const size_t slotSize = sharedSlotSize(_width, _height);
+      if(_memory.create(_sharedName, sizeof(SharedHeader) + slotSize * _params.historyFrames))
+      {
+        _shared = (SharedHeader*)_memory.data();
+        _shared->magic    = SHARED_MAGIC;
+        _shared->version  = TRANSPORT_VERSION;
+        _shared->width    = _width;
+        _shared->height   = _height;
+        _shared->slots    = _params.historyFrames;
+        _shared->slotSize = slotSize;
+        _shared->published.store(0);
+        for(unsigned int i = 0; i < _params.historyFrames; i++)
+          sharedSlot(_shared, i)->seq.store(0);
+      }
+    }
+
+    _running.store(true);
+    _acceptThread = std::thread(&EvoIRFrameServer::acceptLoop, this);
+    return true;
+  }
+
+  void stop()
+  {
+    if(!_running.exchange(false)) return;
+    socketShutdown(_listen);
+    _acceptThread.join();
+    socketClose(_listen);
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      for(std::list<Client*>::iterator it = _clients.begin(); it != _clients.end(); ++it)
+        socketShutdown((*it)->socket);
+      _cond.notify_all();
+    }
+    for(std::list<Client*>::iterator it = _clients.begin(); it != _clients.end(); ++it)
+    {
+      (*it)->thread.join();
+      socketClose((*it)->socket);
+      delete *it;
+    }
+    _clients.clear();
+    _memory.close();
+  }
+
+  void publish(const unsigned short* data, const EvoIRFrameMetadata* metadata)
+  {
+    const unsigned long long seq = _published.load(std::memory_order_relaxed) + 1;
+    const long long now = transportTime();
+    const size_t bytes  = (size_t)_width * _height * sizeof(unsigned short);
+
+    HistorySlot& h = _history[seq % _history.size()];
+    {
+      std::lock_guard<std::mutex> lock(h.mutex);
+      h.seq         = seq;
+      h.publishTime = now;
+      h.metadata    = *metadata;
+      std::memcpy(&h.data[0], data, bytes);
+    }
+
+    if(_shared)
+    {
+      SharedSlot* slot = sharedSlot(_shared, seq);
+      slot->seq.store(SHARED_SLOT_WRITING, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      slot->publishTime = now;
+      slot->metadata    = *metadata;
+      std::memcpy(sharedSlotData(slot), data, bytes);
+      slot->seq.store(seq, std::memory_order_release);
+      _shared->published.store(seq, std::memory_order_release);
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _published.store(seq);
+    _cond.notify_all();
+  }
+
+  void stats(EvoIRServerStats* stats)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    unsigned int clients = 0;
+    for(std::list<Client*>::iterator it = _clients.begin(); it != _clients.end(); ++it)
+      if(!(*it)->finished) clients++;
+    stats->clients             = clients;
+    stats->sharedMemoryClients = _sharedClients.load();
+    stats->framesPublished     = _published.load();
+    stats->framesSent          = _framesSent.load();
+    stats->batchesSent         = _batchesSent.load();
+    stats->framesDropped       = _framesDropped.load();
+  }
+
+private:
+  struct HistorySlot
+  {
+    std::mutex mutex;
+    unsigned long long seq;
+    long long publishTime;
+    EvoIRFrameMetadata metadata;
+    std::vector<unsigned short> data;
+  };
+
+  struct Client
+  {
+    SocketHandle socket;
+    std::thread thread;
+    bool finished;
+  };
+
+  void acceptLoop()
+  {
+    while(_running.load())
+    {
+      SocketHandle s = accept(_listen, nullptr, nullptr);
+      if(s == INVALID_SOCKET_HANDLE)
+      {
+        if(!_running.load()) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        continue;
+      }
+      socketNoDelay(s);
+
+      std::lock_guard<std::mutex> lock(_mutex);
+      // reap disconnected clients
+      for(std::list<Client*>::iterator it = _clients.begin(); it != _clients.end();)
+      {
+        if((*it)->finished)
+        {
+          (*it)->thread.join();
+          socketClose((*it)->socket);
+          delete *it;
+          it = _clients.erase(it);
+        }
+        else
+        {
+          ++it;
+        }
+      }
+      Client* client   = new Client();
+      client->socket   = s;
+      client->finished = false;
+      client->thread   = std::thread(&EvoIRFrameServer::clientLoop, this, client);
+      _clients.push_back(client);
+    }
+  }
+
+  bool handshake(Client* client, bool* shared)
+  {
+    TransportHello hello;
+    if(!socketRecvAll(client->socket, &hello, sizeof(hello)) || hello.magic != TRANSPORT_HELLO_MAGIC || hello.version != TRANSPORT_VERSION)
+      return false;
+
+    TransportWelcome welcome;
+    std::memset(&welcome, 0, sizeof(welcome));
+    welcome.magic   = TRANSPORT_WELCOME_MAGIC;
+    welcome.version = TRANSPORT_VERSION;
+    welcome.width   = _width;
+    welcome.height  = _height;
+    if(_shared && (hello.flags & TRANSPORT_FLAG_SHARED) && socketPeerIsLocal(client->socket))
+    {
+      welcome.flags       = TRANSPORT_FLAG_SHARED;
+      welcome.sharedSlots = _shared->slots;
+      welcome.sharedSize  = _memory.size();
+      std::strncpy(welcome.sharedName, _sharedName.c_str(), sizeof(welcome.sharedName) - 1);
+    }
+    if(!socketSendAll(client->socket, &welcome, sizeof(welcome))) return false;
+
+    TransportReady ready;
+    if(!socketRecvAll(client->socket, &ready, sizeof(ready)) || ready.magic != TRANSPORT_READY_MAGIC) return false;
+    *shared = (ready.flags & TRANSPORT_FLAG_SHARED) && (welcome.flags & TRANSPORT_FLAG_SHARED);
+    return true;
+  }
+
+  void clientLoop(Client* client)
+  {
+    bool shared = false;
+    if(handshake(client, &shared))
+    {
+      if(shared) _sharedClients.fetch_add(1);
+      sendLoop(client, shared);
+      if(shared) _sharedClients.fetch_sub(1);
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    client->finished = true;
+  }
+
+  void sendLoop(Client* client, bool shared)
+  {
+    const size_t pixels = (size_t)_width * _height;
+    const unsigned long long window = _history.size();
+    std::vector<char> buffer;
+    unsigned long long cursor = _published.load();
+
+    while(_running.load())
+    {
+      unsigned long long published;
+      {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while(_running.load() && _published.load() == cursor)
+          _cond.wait(lock);
+        published = _published.load();
+      }
+      if(!_running.load()) break;
+
+      // keep a margin of one slot, the publisher may be overwriting the oldest one
+      if(published - cursor > window - 1)
+      {
+        const unsigned long long skip = published - (window - 1) - cursor;
+        _framesDropped.fetch_add(skip, std::memory_order_relaxed);
+        cursor += skip;
+      }
+      unsigned long long span = published - cursor;
+      if(span > _params.batchFrames) span = _params.batchFrames;
+
+      TransportBatch batch;
+      batch.magic    = TRANSPORT_BATCH_MAGIC;
+      batch.frames   = (unsigned int)span;
+      batch.firstSeq = cursor + 1;
+      cursor        += span;
+
+      bool ok;
+      unsigned int frames = batch.frames;
+      if(shared)
+      {
+        ok = socketSendAll(client->socket, &batch, sizeof(batch));
+      }
+      else
+      {
+        const size_t record = sizeof(TransportFrameHeader) + pixels * sizeof(unsigned short);
+        buffer.resize(sizeof(batch) + record * (size_t)span);
+        char* p = &buffer[0] + sizeof(batch);
+        frames  = 0;
+        for(unsigned long long seq = batch.firstSeq; seq <= cursor; seq++)
+        {
+          HistorySlot& h = _history[seq % _history.size()];
+          std::lock_guard<std::mutex> lock(h.mutex);
+          if(h.seq != seq)
+          {
+            _framesDropped.fetch_add(1, std::memory_order_relaxed);
+            continue;
+          }
+          TransportFrameHeader* header = (TransportFrameHeader*)p;
+          header->seq         = seq;
+          header->publishTime = h.publishTime;
+          header->metadata    = h.metadata;
+          std::memcpy(p + sizeof(TransportFrameHeader), &h.data[0], pixels * sizeof(unsigned short));
+          p += record;
+          frames++;
+        }
+        batch.frames = frames;
+        std::memcpy(&buffer[0], &batch, sizeof(batch));
+        ok = socketSendAll(client->socket, &buffer[0], (size_t)(p - &buffer[0]));
+      }
+      if(!ok) break;
+      _framesSent.fetch_add(frames, std::memory_order_relaxed);
+      _batchesSent.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  EvoIRFrameServer(const EvoIRFrameServer&);
+  EvoIRFrameServer& operator=(const EvoIRFrameServer&);
+
+  const int _width;
+  const int _height;
+  const EvoIRServerParams _params;
+  SocketHandle _listen;
+  std::thread _acceptThread;
+
+  std::vector<HistorySlot> _history;
+  std::atomic<unsigned long long> _published;
+
+  EvoIRSharedMemory _memory;
+  std::string _sharedName;
+  SharedHeader* _shared;
+  std::atomic<unsigned int> _sharedClients;
+
+  std::mutex _mutex;
+  std::condition_variable _cond;
+  std::list<Client*> _clients;
+
+  std::atomic<unsigned long long> _framesSent;
+  std::atomic<unsigned long long> _batchesSent;
+  std::atomic<unsigned long long> _framesDropped;
+  std::atomic<bool> _running;
+};
+
+static EvoIRHandleTable<EvoIRFrameServer> g_servers;
+typedef EvoIRHandleTable<EvoIRFrameServer>::Ref ServerRef;
+
+} // namespace evo
+
+using namespace evo;
+
+void evo_irimager_server_default_params(EvoIRServerParams* params)
+{
+  if(!params) return;
+  params->port          = 1338;
+  params->localOnly     = 1;
+  params->sharedMemory  = 1;
+  params->batchFrames   = 16;
+  params->historyFrames = 64;
+}
+
+int evo_irimager_server_create(unsigned int* outServerId, int w, int h, const EvoIRServerParams* params)
+{
+  if(!outServerId || !params || w <= 0 || h <= 0 || params->port <= 0 || params->port > 65535) return -1;
+  if(params->batchFrames < 1 || params->historyFrames < 2) return -1;
+  EvoIRFrameServer* server = new EvoIRFrameServer(w, h, *params);
+  if(!g_servers.insert(server, outServerId))
+  {
+    delete server;
+    return -1;
+  }
+  if(!server->start(*outServerId))
+  {
+    g_servers.remove(*outServerId);
+    delete server;
+    return -1;
+  }
+  return 0;
+}
+
+int evo_irimager_server_destroy(const unsigned int serverId)
+{
+  EvoIRFrameServer* server = g_servers.remove(serverId);
+  if(!server) return -1;
+  delete server;
+  return 0;
+}
+
+int evo_irimager_server_publish(const unsigned int serverId, const unsigned short* data, const EvoIRFrameMetadata* metadata)
+{
+  ServerRef server = g_servers.acquire(serverId);
+  if(!server || !data || !metadata) return -1;
+  server->publish(data, metadata);
+  return 0;
+}
+
+int evo_irimager_server_get_stats(const unsigned int serverId, EvoIRServerStats* stats)
+{
+  ServerRef server = g_servers.acquire(serverId);
+  if(!server || !stats) return -1;
+  server->stats(stats);
+  return 0;
+}
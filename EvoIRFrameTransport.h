@@ -0,0 +1,174 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRFrameTransport.h
+ * @brief Provides batched frame streaming between processes for Easy API C-Library Interface
+ *
+ * Alternative to the request/response protocol of evo_irimager_tcp_init: a
+ * frame server pushes every published frame to all connected clients. Frames
+ * queued while a client is busy are sent together in one batch, so the
+ * transport keeps up with the sensor rate even if single round trips would
+ * not. Clients on the same host read the image data from a shared memory
+ * segment of the server instead; the TCP connection then only carries batch
+ * notifications of a few bytes.
+ *
+ * Server side:
+ * @code
+ * EvoIRServerParams params;
+ * evo_irimager_server_default_params(&params);
+ * evo_irimager_server_create(&serverId, w, h, &params);
+ * while(...) evo_irimager_server_publish(serverId, data, &metadata);
+ * @endcode
+ *
+ * Client side:
+ * @code
+ * evo_irimager_client_connect(&clientId, "localhost", 1338, 1, 16);
+ * while(evo_irimager_client_get_thermal_image_metadata(clientId, 1000, &w, &h, data, &metadata, NULL) == 0) { ... }
+ * @endcode
+ *
+ * Frames are transferred in host byte order, server and client must share it.
+ * See tools/EvoIRDaemonStandIn.cpp and tools/EvoIRTransportLoad.cpp for a
+ * stand-in daemon and a load generator.
+ */
+
+#ifndef EVOIRFRAMETRANSPORT_H_
+#define EVOIRFRAMETRANSPORT_H_
+
+#include "irdirectsdk_defs.h"
+#include "EvoIRFrameMetadata.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+typedef struct __IRDIRECTSDK_API__ EvoIRServerParams
+{
+  int port;                   /*!< TCP port to listen on, default 1338 (the daemon of the library uses 1337) */
+  int localOnly;              /*!< 1: accept connections on the loopback interface only */
+  int sharedMemory;           /*!< 1: offer the shared memory path to clients on the same host */
+  unsigned int batchFrames;   /*!< Maximum number of frames per batch */
+  unsigned int historyFrames; /*!< Frames kept for clients lagging behind, older frames are dropped for them */
+} EvoIRServerParams;
+
+typedef struct __IRDIRECTSDK_API__ EvoIRServerStats
+{
+  unsigned int clients;               /*!< Connected clients */
+  unsigned int sharedMemoryClients;   /*!< Connected clients reading from shared memory */
+  unsigned long long framesPublished; /*!< Frames passed to evo_irimager_server_publish */
+  unsigned long long framesSent;      /*!< Frames sent or announced to clients, summed over all clients */
+  unsigned long long batchesSent;     /*!< Batches sent, summed over all clients */
+  unsigned long long framesDropped;   /*!< Frames skipped for lagging clients, summed over all clients */
+} EvoIRServerStats;
+
+typedef struct __IRDIRECTSDK_API__ EvoIRClientStats
+{
+  int sharedMemory;                   /*!< 1 if frames are read from shared memory */
+  unsigned long long framesReceived;  /*!< Frames delivered by the server */
+  unsigned long long batchesReceived; /*!< Batches delivered by the server */
+  unsigned long long framesDropped;   /*!< Frames lost: skipped by the server, queue overflow or overwritten in shared memory */
+} EvoIRClientStats;
+
+typedef struct __IRDIRECTSDK_API__ EvoIRTransportFrameInfo
+{
+  unsigned long long sequence; /*!< Consecutive number assigned by the server, gaps indicate lost frames */
+  long long latency;           /*!< Time from publishing until delivery to the caller in UNITS (10000000 per second), only meaningful on the same host */
+} EvoIRTransportFrameInfo;
+
+/**
+ * @brief Fills parameter structure with defaults (port 1338, loopback only, shared memory enabled, batches of up to 16 frames, 64 frames history)
+ * @param[out] params parameter structure
+ */
+__IRDIRECTSDK_API__ void evo_irimager_server_default_params(EvoIRServerParams* params);
+
+/**
+ * @brief Creates a frame server and starts listening
+ * @param[out] outServerId server instance id for reference
+ * @param[in] w image width
+ * @param[in] h image height
+ * @param[in] params server parameters
+ * @return 0 on success, -1 on error (e.g. port in use)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_server_create(unsigned int* outServerId, int w, int h, const EvoIRServerParams* params);
+
+/**
+ * @brief Disconnects all clients and releases the server
+ * @param[in] serverId server instance id from create to apply this function
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_server_destroy(const unsigned int serverId);
+
+/**
+ * @brief Publishes a frame to all clients. Does not block on clients. Only one thread may publish to a server.
+ * @param[in] serverId server instance id from create to apply this function
+ * @param[in] data thermal image (size of w * h)
+ * @param[in] metadata frame metadata
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_server_publish(const unsigned int serverId, const unsigned short* data, const EvoIRFrameMetadata* metadata);
+
+/**
+ * @brief Accessor to server statistics
+ * @param[in] serverId server instance id from create to apply this function
+ * @param[out] stats pointer to EvoIRServerStats allocate by the user
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_server_get_stats(const unsigned int serverId, EvoIRServerStats* stats);
+
+/**
+ * @brief Connects to a frame server
+ * @param[out] outClientId client instance id for reference
+ * @param[in] host IP address or host name of the server ("localhost" can be resolved)
+ * @param[in] port port of the server
+ * @param[in] sharedMemory 1: read frames from shared memory if the server is on the same host
+ * @param[in] queueFrames frames buffered on client side, the oldest frame is dropped if the caller does not keep up
+ * @return 0 on success, -1 on host not found (wrong IP, server not running), -2 on protocol error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_client_connect(unsigned int* outClientId, const char* host, int port, int sharedMemory, unsigned int queueFrames);
+
+/**
+ * @brief Disconnects from the server
+ * @param[in] clientId client instance id from connect to apply this function
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_client_disconnect(const unsigned int clientId);
+
+/**
+ * @brief Accessor to image width and height of the served frames
+ * @param[in] clientId client instance id from connect to apply this function
+ * @param[out] w width
+ * @param[out] h height
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_client_get_thermal_image_size(const unsigned int clientId, int* w, int* h);
+
+/**
+ * @brief Accessor to the next thermal image and its metadata, frames are delivered in order
+ * @param[in] clientId client instance id from connect to apply this function
+ * @param[in] timeoutMs time to wait for a frame in milliseconds, 0 polls, negative values wait infinitely
+ * @param[in,out] w width, checked against the served frames
+ * @param[in,out] h height, checked against the served frames
+ * @param[out] data pointer to unsigned short array allocate by the user (size of w * h)
+ * @param[out] metadata pointer to EvoIRFrameMetadata allocate by the user
+ * @param[out] info pointer to EvoIRTransportFrameInfo allocate by the user, may be NULL
+ * @return 0 on success, -1 on error, -2 on fatal error (connection lost and no frames left), -3 if no frame arrived within timeout
+ */
+__IRDIRECTSDK_API__ int evo_irimager_client_get_thermal_image_metadata(const unsigned int clientId, int timeoutMs, int* w, int* h, unsigned short* data, EvoIRFrameMetadata* metadata, EvoIRTransportFrameInfo* info);
+
+/**
+ * @brief Accessor to client statistics
+ * @param[in] clientId client instance id from connect to apply this function
+ * @param[out] stats pointer to EvoIRClientStats allocate by the user
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_client_get_stats(const unsigned int clientId, EvoIRClientStats* stats);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* EVOIRFRAMETRANSPORT_H_ */
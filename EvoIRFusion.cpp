@@ -0,0 +1,608 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRFusion.cpp
+ * @brief Thermal/visible pairing, homography remap table and overlay kernels
+ *
+ * Pushing only copies frames under the lock of the instance. The accessors
+ * copy the visible frame and the paired thermal frame into work buffers and
+ * process them outside of that lock, so capture threads are not blocked by a
+ * consumer; concurrent accessors are serialized by a second lock.
+ *
+ * A fused image takes: remapping the raw thermal image onto the visible grid
+ * (EvoIRRemap.h), coloring it with the range of the unregistered image
+ * (EvoIRPalette.h), converting the visible frame, then the overlay. Blending
+ * computes (thermal * alpha + visible * (256 - alpha) + 128) >> 8 per byte.
+ * Edges are the Sobel magnitude of luma, scaled and saturated to a byte,
+ * added with saturation to all three channels; the vector kernels expand
+ * the edge bytes into r,g,b triplets with byte shuffles.
+ */
+
+#include "EvoIRFusion.h"
+#include "EvoIRHandleTable.h"
+#include "EvoIRPalette.h"
+#include "EvoIRRemap.h"
+#include "EvoIRSimd.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+namespace evo
+{
+
+namespace
+{
+
+const short DECIMAL_PLACES = 1;
+
+unsigned char clampByte(int v)
+{
+  return (unsigned char)(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+/**
+ * BT.601 full range, 8 bit fixed point. Luma is written separately for the edge detection.
+ */
+void yuyvToRgb(const unsigned short* yuyv, size_t n, unsigned char* rgb, unsigned char* luma)
+{
+  for(size_t i = 0; i + 1 < n; i += 2)
+  {
+    const int y0 = yuyv[i] & 0xff;
+    const int y1 = yuyv[i + 1] & 0xff;
+    const int u  = (yuyv[i] >> 8) - 128;
+    const int v  = (yuyv[i + 1] >> 8) - 128;
+    const int r  = (359 * v + 128) >> 8;
+    const int g  = (88 * u + 183 * v + 128) >> 8;
+    const int b  = (454 * u + 128) >> 8;
+    unsigned char* o = rgb + 3 * i;
+    o[0] = clampByte(y0 + r);
+    o[1] = clampByte(y0 - g);
+    o[2] = clampByte(y0 + b);
+    o[3] = clampByte(y1 + r);
+    o[4] = clampByte(y1 - g);
+    o[5] = clampByte(y1 + b);
+    luma[i]     = (unsigned char)y0;
+    luma[i + 1] = (unsigned char)y1;
+  }
+}
+
+//------------------------------------------------------------------------------
+// plain C++
+//------------------------------------------------------------------------------
+
+void blendScalar(const unsigned char* a, const unsigned char* b, int alpha, size_t n, unsigned char* out)
+{
+  for(size_t i = 0; i < n; i++)
+    out[i] = (unsigned char)((a[i] * alpha + b[i] * (256 - alpha) + 128) >> 8);
+}
+
+unsigned char edgeAt(const unsigned char* p, size_t stride, int gain)
+{
+  const ptrdiff_t w = (ptrdiff_t)stride;
+  const int gx = (p[1 - w] + 2 * p[1] + p[1 + w]) - (p[-1 - w] + 2 * p[-1] + p[w - 1]);
+  const int gy = (p[w - 1] + 2 * p[w] + p[w + 1]) - (p[-1 - w] + 2 * p[-w] + p[1 - w]);
+  const int e  = ((std::abs(gx) + std::abs(gy)) * gain) >> 4;
+  return (unsigned char)(e > 255 ? 255 : e);
+}
+
+// columns [x0; x1) of an inner row
+void sobelRowScalar(const unsigned char* row, size_t w, int gain, size_t x0, size_t x1, unsigned char* out)
+{
+  for(size_t x = x0; x < x1; x++)
+    out[x] = edgeAt(row + x, w, gain);
+}
+
+void addEdgesScalar(const unsigned char* rgb, const unsigned char* edges, size_t n, unsigned char* out)
+{
+  for(size_t i = 0; i < n; i++)
+    for(int c = 0; c < 3; c++)
+    {
+      const int v = rgb[3 * i + c] + edges[i];
+      out[3 * i + c] = (unsigned char)(v > 255 ? 255 : v);
+    }
+}
+
+#if EVO_SIMD_X86
+
+//------------------------------------------------------------------------------
+// SSE4.1
+//------------------------------------------------------------------------------
+
+EVO_TARGET_SSE41 void blendSse41(const unsigned char* a, const unsigned char* b, int alpha, size_t n, unsigned char* out)
+{
+  const __m128i wa    = _mm_set1_epi16((short)alpha);
+  const __m128i wb    = _mm_set1_epi16((short)(256 - alpha));
+  const __m128i round = _mm_set1_epi16(128);
+  const __m128i zero  = _mm_setzero_si128();
+  size_t i = 0;
+  for(; i + 16 <= n; i += 16)
+  {
+    const __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+    const __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+    // at most 255 * 256 + 128, fits into unsigned 16 bit
+    const __m128i lo = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(va, zero), wa),
+                                                                  _mm_mullo_epi16(_mm_unpacklo_epi8(vb, zero), wb)), round), 8);
+    const __m128i hi = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(va, zero), wa),
+                                                                  _mm_mullo_epi16(_mm_unpackhi_epi8(vb, zero), wb)), round), 8);
+    _mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi16(lo, hi));
+  }
+  blendScalar(a + i, b + i, alpha, n - i, out + i);
+}
+
+EVO_TARGET_SSE41 __m128i load8x16(const unsigned char* p)
+{
+  return _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i*)p));
+}
+
+EVO_TARGET_SSE41 void sobelRowSse41(const unsigned char* row, size_t w, int gain, size_t x0, size_t x1, unsigned char* out)
+{
+  const __m128i g = _mm_set1_epi16((short)gain);
+  size_t x = x0;
+  for(; x + 8 <= x1; x += 8)
+  {
+    const unsigned char* p = row + x;
+    const __m128i tl = load8x16(p - w - 1), tm = load8x16(p - w), tr = load8x16(p - w + 1);
+    const __m128i ml = load8x16(p - 1),                           mr = load8x16(p + 1);
+    const __m128i bl = load8x16(p + w - 1), bm = load8x16(p + w), br = load8x16(p + w + 1);
+    const __m128i gx = _mm_sub_epi16(_mm_add_epi16(_mm_add_epi16(tr, br), _mm_slli_epi16(mr, 1)),
+                                     _mm_add_epi16(_mm_add_epi16(tl, bl), _mm_slli_epi16(ml, 1)));
+    const __m128i gy = _mm_sub_epi16(_mm_add_epi16(_mm_add_epi16(bl, br), _mm_slli_epi16(bm, 1)),
+                                     _mm_add_epi16(_mm_add_epi16(tl, tr), _mm_slli_epi16(tm, 1)));
+    // magnitude <= 2040, times gain <= 32 fits into unsigned 16 bit
+    const __m128i e = _mm_srli_epi16(_mm_mullo_epi16(_mm_add_epi16(_mm_abs_epi16(gx), _mm_abs_epi16(gy)), g), 4);
+    _mm_storel_epi64((__m128i*)(out + x), _mm_packus_epi16(e, e));
+  }
+  sobelRowScalar(row, w, gain, x, x1, out);
+}
+
+EVO_TARGET_SSE41 void addEdgesSse41(const unsigned char* rgb, const unsigned char* edges, size_t n, unsigned char* out)
+{
+  const __m128i s0 = _mm_setr_epi8(0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5);
+  const __m128i s1 = _mm_setr_epi8(5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10);
+  const __m128i s2 = _mm_setr_epi8(10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14, 14, 15, 15, 15);
+  size_t i = 0;
+  for(; i + 16 <= n; i += 16)
+  {
+    const __m128i e = _mm_loadu_si128((const __m128i*)(edges + i));
+    const unsigned char* in = rgb + 3 * i;
+    unsigned char* o = out + 3 * i;
+    _mm_storeu_si128((__m128i*)o,        _mm_adds_epu8(_mm_loadu_si128((const __m128i*)in),        _mm_shuffle_epi8(e, s0)));
+    _mm_storeu_si128((__m128i*)(o + 16), _mm_adds_epu8(_mm_loadu_si128((const __m128i*)(in + 16)), _mm_shuffle_epi8(e, s1)));
+    _mm_storeu_si128((__m128i*)(o + 32), _mm_adds_epu8(_mm_loadu_si128((const __m128i*)(in + 32)), _mm_shuffle_epi8(e, s2)));
+  }
+  addEdgesScalar(rgb + 3 * i, edges + i, n - i, out + 3 * i);
+}
+
+//------------------------------------------------------------------------------
+// AVX2
+//------------------------------------------------------------------------------
+
+EVO_TARGET_AVX2 void blendAvx2(const unsigned char* a, const unsigned char* b, int alpha, size_t n, unsigned char* out)
+{
+  const __m256i wa    = _mm256_set1_epi16((short)alpha);
+  const __m256i wb    = _mm256_set1_epi16((short)(256 - alpha));
+  const __m256i round = _mm256_set1_epi16(128);
+  const __m256i zero  = _mm256_setzero_si256();
+  size_t i = 0;
+  for(; i + 32 <= n; i += 32)
+  {
+    const __m256i va = _mm256_loadu_si256((const __m256i*)(a + i));
+    const __m256i vb = _mm256_loadu_si256((const __m256i*)(b + i));
+    // unpack and pack work per 128 bit lane, so the byte order is kept
+    const __m256i lo = _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(va, zero), wa),
+                                                                           _mm256_mullo_epi16(_mm256_unpacklo_epi8(vb, zero), wb)), round), 8);
+    const __m256i hi = _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(va, zero), wa),
+                                                                           _mm256_mullo_epi16(_mm256_unpackhi_epi8(vb, zero), wb)), round), 8);
+    _mm256_storeu_si256((__m256i*)(out + i), _mm256_packus_epi16(lo, hi));
+  }
+  blendScalar(a + i, b + i, alpha, n - i, out + i);
+}
+
+EVO_TARGET_AVX2 __m256i load16x16(const unsigned char* p)
+{
+  return _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)p));
+}
+
+EVO_TARGET_AVX2 void sobelRowAvx2(const unsigned char* row, size_t w, int gain, size_t x0, size_t x1, unsigned char* out)
+{
+  const __m256i g = _mm256_set1_epi16((short)gain);
+  size_t x = x0;
+  for(; x + 16 <= x1; x += 16)
+  {
+    const unsigned char* p = row + x;
+    const __m256i tl = load16x16(p - w - 1), tm = load16x16(p - w), tr = load16x16(p - w + 1);
+    const __m256i ml = load16x16(p - 1),                            mr = load16x16(p + 1);
+    const __m256i bl = load16x16(p + w - 1), bm = load16x16(p + w), br = load16x16(p + w + 1);
+    const __m256i gx = _mm256_sub_epi16(_mm256_add_epi16(_mm256_add_epi16(tr, br), _mm256_slli_epi16(mr, 1)),
+                                        _mm256_add_epi16(_mm256_add_epi16(tl, bl), _mm256_slli_epi16(ml, 1)));
+    const __m256i gy = _mm256_sub_epi16(_mm256_add_epi16(_mm256_add_epi16(bl, br), _mm256_slli_epi16(bm, 1)),
+                                        _mm256_add_epi16(_mm256_add_epi16(tl, tr), _mm256_slli_epi16(tm, 1)));
+    const __m256i e = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_add_epi16(_mm256_abs_epi16(gx), _mm256_abs_epi16(gy)), g), 4);
+    const __m128i packed = _mm_packus_epi16(_mm256_castsi256_si128(e), _mm256_extracti128_si256(e, 1));
+    _mm_storeu_si128((__m128i*)(out + x), packed);
+  }
+  // remaining pixels of the row
+  sobelRowScalar(row, w, gain, x, x1, out);
+}
+
+#endif // EVO_SIMD_X86
+
+void blend(const unsigned char* a, const unsigned char* b, int alpha, size_t n, unsigned char* out)
+{
+#if EVO_SIMD_X86
+  const int level = simdLevel();
+  if(level >= SIMD_AVX2)  { blendAvx2(a, b, alpha, n, out); return; }
+  if(level >= SIMD_SSE41) { blendSse41(a, b, alpha, n, out); return; }
+#endif
+  blendScalar(a, b, alpha, n, out);
+}
+
+/**
+ * Sobel edges of an image, 0 in the outermost rows and columns
+ */
+void sobel(const unsigned char* luma, size_t w, size_t h, int gain, unsigned char* out)
+{
+  std::memset(out, 0, w);
+  std::memset(out + (h - 1) * w, 0, w);
+#if EVO_SIMD_X86
+  const int level = simdLevel();
+#endif
+  for(size_t y = 1; y + 1 < h; y++)
+  {
+    const unsigned char* row = luma + y * w;
+    unsigned char* o = out + y * w;
+    o[0] = o[w - 1] = 0;
+#if EVO_SIMD_X86
+    if(level >= SIMD_AVX2)       sobelRowAvx2(row, w, gain, 1, w - 1, o);
+    else if(level >= SIMD_SSE41) sobelRowSse41(row, w, gain, 1, w - 1, o);
+    else
+#endif
+    sobelRowScalar(row, w, gain, 1, w - 1, o);
+  }
+}
+
+void addEdges(const unsigned char* rgb, const unsigned char* edges, size_t n, unsigned char* out)
+{
+#if EVO_SIMD_X86
+  if(simdLevel() >= SIMD_SSE41) { addEdgesSse41(rgb, edges, n, out); return; }
+#endif
+  addEdgesScalar(rgb, edges, n, out);
+}
+
+bool validOverlay(int mode, int alpha, int edgeGain, int paletteId, int scale, float tMin, float tMax)
+{
+  return (mode == EVO_FUSION_BLEND || mode == EVO_FUSION_EDGES) && alpha >= 0 && alpha <= 256 && edgeGain >= 0 && edgeGain <= 32
+         && paletteId >= 1 && paletteId <= 11 && scale >= 1 && scale <= 4 && tMin < tMax;
+}
+
+} // namespace
+
+class EvoIRFusion
+{
+public:
+  explicit EvoIRFusion(const EvoIRFusionParams& params) :
+    _params(params),
+    _thermalPixels((size_t)params.thermalWidth * params.thermalHeight),
+    _visiblePixels((size_t)params.visibleWidth * params.visibleHeight),
+    _offset(_visiblePixels),
+    _wTop(_visiblePixels),
+    _wBottom(_visiblePixels),
+    _history(_thermalPixels * EVO_FUSION_THERMAL_FRAMES),
+    _thermalCount(0),
+    _thermalNext(0),
+    _visible(_visiblePixels),
+    _hasVisible(false),
+    _workThermal(_thermalPixels),
+    _workVisible(_visiblePixels),
+    _registered(_visiblePixels),
+    _thermalRgb(3 * _visiblePixels),
+    _visibleRgb(3 * _visiblePixels),
+    _luma(_visiblePixels),
+    _edges(_visiblePixels)
+  {
+  }
+
+  /**
+   * Remap table of the homography, false if a visible pixel maps onto the line at infinity
+   */
+  bool build()
+  {
+    const double* m = _params.homography;
+    const int tw = _params.thermalWidth;
+    const int th = _params.thermalHeight;
+    size_t i = 0;
+    for(int y = 0; y < _params.visibleHeight; y++)
+    {
+      for(int x = 0; x < _params.visibleWidth; x++, i++)
+      {
+        const double w = m[6] * x + m[7] * y + m[8];
+        if(std::fabs(w) < 1e-12) return false;
+        double u = (m[0] * x + m[1] * y + m[2]) / w;
+        double v = (m[3] * x + m[4] * y + m[5]) / w;
+        // positions within the outermost thermal pixels are clamped onto their centers
+        if(u >= -0.5 && u < 0.0) u = 0.0;
+        if(v >= -0.5 && v < 0.0) v = 0.0;
+        if(u > tw - 1 && u <= tw - 0.5) u = tw - 1;
+        if(v > th - 1 && v <= th - 0.5) v = th - 1;
+        int x0, y0, ax, ay;
+        if(!remapQuantize(u, tw, &x0, &ax) || !remapQuantize(v, th, &y0, &ay))
+        {
+          _offset[i]  = 0;
+          _wTop[i]    = remapPack(REMAP_FRAC_ONE * REMAP_FRAC_ONE, 0);
+          _wBottom[i] = 0;
+          _border.push_back((unsigned int)i);
+          continue;
+        }
+        _offset[i]  = (unsigned int)(y0 * tw + x0);
+        _wTop[i]    = remapPack((REMAP_FRAC_ONE - ax) * (REMAP_FRAC_ONE - ay), ax * (REMAP_FRAC_ONE - ay));
+        _wBottom[i] = remapPack((REMAP_FRAC_ONE - ax) * ay, ax * ay);
+      }
+    }
+    return true;
+  }
+
+  void setOverlay(int mode, int alpha, int edgeGain, int paletteId, int scale, float tMin, float tMax)
+  {
+    std::lock_guard<std::mutex> lock(_workMutex);
+    _params.mode      = mode;
+    _params.alpha     = alpha;
+    _params.edgeGain  = edgeGain;
+    _params.paletteId = paletteId;
+    _params.scale     = scale;
+    _params.tMin      = tMin;
+    _params.tMax      = tMax;
+  }
+
+  void pushThermal(const unsigned short* data, const EvoIRFrameMetadata& metadata)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::memcpy(&_history[_thermalNext * _thermalPixels], data, _thermalPixels * sizeof(unsigned short));
+    _historyMetadata[_thermalNext] = metadata;
+    _thermalNext = (_thermalNext + 1) % EVO_FUSION_THERMAL_FRAMES;
+    if(_thermalCount < EVO_FUSION_THERMAL_FRAMES) _thermalCount++;
+  }
+
+  void pushVisible(const unsigned short* data, const EvoIRFrameMetadata& metadata)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::memcpy(&_visible[0], data, _visiblePixels * sizeof(unsigned short));
+    _visibleMetadata = metadata;
+    _hasVisible = true;
+  }
+
+  int visible(unsigned char* data, EvoIRFrameMetadata* metadata)
+  {
+    std::lock_guard<std::mutex> work(_workMutex);
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if(!_hasVisible) return -1;
+      std::memcpy(&_workVisible[0], &_visible[0], _visiblePixels * sizeof(unsigned short));
+      if(metadata) *metadata = _visibleMetadata;
+    }
+    yuyvToRgb(&_workVisible[0], _visiblePixels, data, &_luma[0]);
+    return 0;
+  }
+
+  int registeredThermal(unsigned short* data, EvoIRFusionInfo* info)
+  {
+    std::lock_guard<std::mutex> work(_workMutex);
+    const int ret = pair(info);
+    if(ret != 0) return ret;
+    registerThermal(data);
+    return 0;
+  }
+
+  int fused(unsigned char* data, EvoIRFusionInfo* info)
+  {
+    std::lock_guard<std::mutex> work(_workMutex);
+    const int ret = pair(info);
+    if(ret != 0) return ret;
+    registerThermal(&_registered[0]);
+
+    // scaled with the range of the thermal image, not of the part visible in the fused one
+    EvoIRThermalStats stats;
+    unsigned short rawMin, rawMax;
+    if(evo_irimager_thermal_stats(&_workThermal[0], _params.thermalWidth, _params.thermalHeight, &stats) != 0
+       || evo_irimager_palette_scale_range(&stats, _params.scale, _params.tMin, _params.tMax, DECIMAL_PLACES, &rawMin, &rawMax) != 0
+       || evo_irimager_palette_apply(&_registered[0], _params.visibleWidth, _params.visibleHeight, _params.paletteId, rawMin, rawMax,
+                                     EVO_PALETTE_INTERLEAVED, &_thermalRgb[0]) != 0)
+      return -1;
+    yuyvToRgb(&_workVisible[0], _visiblePixels, &_visibleRgb[0], &_luma[0]);
+
+    if(_params.mode == EVO_FUSION_BLEND)
+    {
+      blend(&_thermalRgb[0], &_visibleRgb[0], _params.alpha, 3 * _visiblePixels, data);
+    }
+    else
+    {
+      sobel(&_luma[0], _params.visibleWidth, _params.visibleHeight, _params.edgeGain, &_edges[0]);
+      addEdges(&_thermalRgb[0], &_edges[0], _visiblePixels, data);
+    }
+    for(size_t j = 0; j < _border.size(); j++)
+      std::memcpy(data + 3 * (size_t)_border[j], &_visibleRgb[3 * (size_t)_border[j]], 3);
+    return 0;
+  }
+
+  const EvoIRFusionParams& params() const { return _params; }
+
+private:
+  EvoIRFusion(const EvoIRFusion&);
+  EvoIRFusion& operator=(const EvoIRFusion&);
+
+  /**
+   * Copies the visible frame and the thermal frame nearest in time into the work buffers. Caller holds the work mutex.
+   */
+  int pair(EvoIRFusionInfo* info)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(!_hasVisible) return -1;
+    int best = -1;
+    long long bestSkew = 0;
+    for(unsigned int k = 0; k < _thermalCount; k++)
+    {
+      const long long skew = _historyMetadata[k].timestamp - _visibleMetadata.timestamp;
+      if(best < 0 || std::llabs(skew) < std::llabs(bestSkew))
+      {
+        best     = (int)k;
+        bestSkew = skew;
+      }
+    }
+    if(best < 0 || (_params.maxSkew > 0 && std::llabs(bestSkew) > _params.maxSkew)) return 1;
+    std::memcpy(&_workThermal[0], &_history[best * _thermalPixels], _thermalPixels * sizeof(unsigned short));
+    std::memcpy(&_workVisible[0], &_visible[0], _visiblePixels * sizeof(unsigned short));
+    if(info)
+    {
+      info->visible = _visibleMetadata;
+      info->thermal = _historyMetadata[best];
+      info->skew    = bestSkew;
+    }
+    return 0;
+  }
+
+  void registerThermal(unsigned short* out) const
+  {
+    remapThermal(&_workThermal[0], _params.thermalWidth, &_offset[0], &_wTop[0], &_wBottom[0], _visiblePixels, out);
+    for(size_t j = 0; j < _border.size(); j++)
+      out[_border[j]] = 0;
+  }
+
+  EvoIRFusionParams _params;
+  const size_t _thermalPixels;
+  const size_t _visiblePixels;
+  std::vector<unsigned int> _offset;
+  std::vector<unsigned int> _wTop;
+  std::vector<unsigned int> _wBottom;
+  std::vector<unsigned int> _border;  // ascending visible pixels without thermal source
+
+  std::mutex _mutex;                  // frames pushed
+  std::vector<unsigned short> _history;
+  EvoIRFrameMetadata _historyMetadata[EVO_FUSION_THERMAL_FRAMES];
+  unsigned int _thermalCount;
+  unsigned int _thermalNext;
+  std::vector<unsigned short> _visible;
+  EvoIRFrameMetadata _visibleMetadata;
+  bool _hasVisible;
+
+  std::mutex _workMutex;              // work buffers of the accessors
+  std::vector<unsigned short> _workThermal;
+  std::vector<unsigned short> _workVisible;
+  std::vector<unsigned short> _registered;
+  std::vector<unsigned char> _thermalRgb;
+  std::vector<unsigned char> _visibleRgb;
+  std::vector<unsigned char> _luma;
+  std::vector<unsigned char> _edges;
+};
+
+static EvoIRHandleTable<EvoIRFusion> g_fusions;
+typedef EvoIRHandleTable<EvoIRFusion>::Ref FusionRef;
+
+} // namespace evo
+
+using namespace evo;
+
+void evo_irimager_fusion_default_params(EvoIRFusionParams* params, int tw, int th, int vw, int vh)
+{
+  if(!params) return;
+  std::memset(params, 0, sizeof(*params));
+  params->thermalWidth  = tw;
+  params->thermalHeight = th;
+  params->visibleWidth  = vw;
+  params->visibleHeight = vh;
+  // pixel centers: u + 0.5 = (x + 0.5) * tw / vw
+  const double sx = vw > 0 ? (double)tw / vw : 1.0;
+  const double sy = vh > 0 ? (double)th / vh : 1.0;
+  params->homography[0] = sx;
+  params->homography[2] = 0.5 * sx - 0.5;
+  params->homography[4] = sy;
+  params->homography[5] = 0.5 * sy - 0.5;
+  params->homography[8] = 1.0;
+  params->mode      = EVO_FUSION_BLEND;
+  params->alpha     = 128;
+  params->edgeGain  = 4;
+  params->paletteId = 6;
+  params->scale     = 2;
+  params->tMin      = 20.f;
+  params->tMax      = 100.f;
+  params->maxSkew   = 0;
+}
+
+int evo_irimager_fusion_create(unsigned int* outFusionId, const EvoIRFusionParams* params)
+{
+  if(!outFusionId || !params || params->thermalWidth < 2 || params->thermalHeight < 2 || params->visibleWidth < 4 || params->visibleHeight < 3
+     || params->visibleWidth % 2 != 0 || params->maxSkew < 0)
+    return -1;
+  if(!validOverlay(params->mode, params->alpha, params->edgeGain, params->paletteId, params->scale, params->tMin, params->tMax)) return -1;
+  // offsets are 32 bit
+  if((unsigned long long)params->thermalWidth * params->thermalHeight > 0xffffffffULL
+     || (unsigned long long)params->visibleWidth * params->visibleHeight > 0xffffffffULL)
+    return -1;
+  EvoIRFusion* fusion = new EvoIRFusion(*params);
+  if(!fusion->build() || !g_fusions.insert(fusion, outFusionId))
+  {
+    delete fusion;
+    return -1;
+  }
+  return 0;
+}
+
+int evo_irimager_fusion_destroy(const unsigned int fusionId)
+{
+  EvoIRFusion* fusion = g_fusions.remove(fusionId);
+  if(!fusion) return -1;
+  delete fusion;
+  return 0;
+}
+
+int evo_irimager_fusion_set_overlay(const unsigned int fusionId, int mode, int alpha, int edgeGain, int paletteId, int scale, float tMin, float tMax)
+{
+  FusionRef fusion = g_fusions.acquire(fusionId);
+  if(!fusion || !validOverlay(mode, alpha, edgeGain, paletteId, scale, tMin, tMax)) return -1;
+  fusion->setOverlay(mode, alpha, edgeGain, paletteId, scale, tMin, tMax);
+  return 0;
+}
+
+int evo_irimager_fusion_push_thermal(const unsigned int fusionId, const unsigned short* data, const EvoIRFrameMetadata* metadata)
+{
+  FusionRef fusion = g_fusions.acquire(fusionId);
+  if(!fusion || !data || !metadata) return -1;
+  fusion->pushThermal(data, *metadata);
+  return 0;
+}
+
+int evo_irimager_fusion_push_visible(const unsigned int fusionId, const unsigned short* data, const EvoIRFrameMetadata* metadata)
+{
+  FusionRef fusion = g_fusions.acquire(fusionId);
+  if(!fusion || !data || !metadata) return -1;
+  fusion->pushVisible(data, *metadata);
+  return 0;
+}
+
+int evo_irimager_fusion_get_visible(const unsigned int fusionId, unsigned char* data, EvoIRFrameMetadata* metadata)
+{
+  FusionRef fusion = g_fusions.acquire(fusionId);
+  if(!fusion || !data) return -1;
+  return fusion->visible(data, metadata);
+}
+
+int evo_irimager_fusion_get_registered_thermal(const unsigned int fusionId, unsigned short* data, EvoIRFusionInfo* info)
+{
+  FusionRef fusion = g_fusions.acquire(fusionId);
+  if(!fusion || !data) return -1;
+  return fusion->registeredThermal(data, info);
+}
+
+int evo_irimager_fusion_get_fused(const unsigned int fusionId, unsigned char* data, EvoIRFusionInfo* info)
+{
+  FusionRef fusion = g_fusions.acquire(fusionId);
+  if(!fusion || !data) return -1;
+  return fusion->fused(data, info);
+}
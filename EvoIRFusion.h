@@ -0,0 +1,175 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRFusion.h
+ * @brief Provides registration and fusion of thermal and visible images of bispectral cameras for Easy API C-Library Interface
+ *
+ * The PI 200/230 deliver a visible channel next to the thermal one
+ * (<bispectral> in the configuration file, Formats.def: thermal 160 x 120 at
+ * 96 or 128 Hz, visible 640 x 480 or 596 x 447 at 32 Hz). The Easy API has
+ * no accessor for the visible channel; its frames are taken from raw
+ * transfers unpacked with EvoIRFormatPlan.h (channel 1) or from the SDK.
+ *
+ * Thermal frames are pushed into a small history, visible frames replace the
+ * previous one. Every visible frame is paired with the thermal frame of the
+ * history nearest in time (EvoIRFrameMetadata::timestamp) and the thermal
+ * image is registered onto the visible pixel grid: a homography maps visible
+ * pixels onto thermal pixels and is turned into a bilinear remap table once
+ * on create (see EvoIRUndistort.h). The fused image is the colored thermal
+ * image either blended with the visible image or overlaid with the edges of
+ * the visible image. Blending, edge detection and overlay use SSE4.1/AVX2
+ * (see evo_irimager_set_simd_level) with equal results on every code path.
+ *
+ * Visible frames are YUYV 4:2:2 with one 16 bit word per pixel, as unpacked
+ * from the transfer: luma in the low byte, chroma U (even columns) or V (odd
+ * columns) in the high byte. Output images are interleaved r,g,b.
+ *
+ * @code
+ * EvoIRFusionParams params;
+ * evo_irimager_fusion_default_params(&params, 160, 120, 640, 480);
+ * evo_irimager_fusion_create(&fusionId, &params);
+ * // capture thread(s)
+ * evo_irimager_fusion_push_thermal(fusionId, thermal, &thermalMetadata);   // 96 Hz
+ * evo_irimager_fusion_push_visible(fusionId, yuyv, &visibleMetadata);      // 32 Hz
+ * // consumer
+ * EvoIRFusionInfo info;
+ * if(evo_irimager_fusion_get_fused(fusionId, rgb, &info) == 0) ...
+ * @endcode
+ */
+
+#ifndef EVOIRFUSION_H_
+#define EVOIRFUSION_H_
+
+#include "irdirectsdk_defs.h"
+#include "EvoIRFrameMetadata.h"
+
+#define EVO_FUSION_THERMAL_FRAMES 8
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+typedef enum
+{
+  EVO_FUSION_BLEND = 0, /*!< colored thermal image blended with the visible image */
+  EVO_FUSION_EDGES = 1  /*!< colored thermal image with the edges of the visible image added */
+} EvoIRFusionMode;
+
+typedef struct __IRDIRECTSDK_API__ EvoIRFusionParams
+{
+  int thermalWidth;      /*!< Thermal image width */
+  int thermalHeight;     /*!< Thermal image height */
+  int visibleWidth;      /*!< Visible image width, even */
+  int visibleHeight;     /*!< Visible image height */
+  double homography[9];  /*!< Row major 3 x 3 matrix mapping visible pixel (x, y, 1) onto thermal pixel (u, v, w), pixel centers at integer positions */
+  int mode;              /*!< EvoIRFusionMode */
+  int alpha;             /*!< EVO_FUSION_BLEND: weight of the thermal image [0; 256] */
+  int edgeGain;          /*!< EVO_FUSION_EDGES: edge strength is the Sobel magnitude of luma times edgeGain / 16, [0; 32] */
+  int paletteId;         /*!< palette id [1; 11], see evo_irimager_set_palette */
+  int scale;             /*!< scaling method [1; 4] of the thermal image, see evo_irimager_set_palette_scale */
+  float tMin;            /*!< lower bound of manual scaling in degree Celsius */
+  float tMax;            /*!< upper bound of manual scaling in degree Celsius */
+  long long maxSkew;     /*!< largest time difference of a pair in UNITS (10000000 per second), 0 for any */
+} EvoIRFusionParams;
+
+typedef struct __IRDIRECTSDK_API__ EvoIRFusionInfo
+{
+  EvoIRFrameMetadata visible; /*!< Metadata of the visible frame */
+  EvoIRFrameMetadata thermal; /*!< Metadata of the thermal frame paired with it */
+  long long skew;             /*!< thermal.timestamp - visible.timestamp in UNITS */
+} EvoIRFusionInfo;
+
+/**
+ * @brief Fills parameters for cameras with aligned optical axes: the visible field of view scaled onto the thermal one, blending half and half, iron palette with min/max scaling
+ * @param[out] params pointer to EvoIRFusionParams allocate by the user
+ * @param[in] tw thermal image width
+ * @param[in] th thermal image height
+ * @param[in] vw visible image width
+ * @param[in] vh visible image height
+ */
+__IRDIRECTSDK_API__ void evo_irimager_fusion_default_params(EvoIRFusionParams* params, int tw, int th, int vw, int vh);
+
+/**
+ * @brief Builds the remap table of the homography and allocates all buffers
+ * @param[out] outFusionId fusion instance id for reference
+ * @param[in] params parameters
+ * @return 0 on success, -1 on error (invalid parameters, singular homography)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_fusion_create(unsigned int* outFusionId, const EvoIRFusionParams* params);
+
+/**
+ * @brief Releases a fusion instance
+ * @param[in] fusionId fusion instance id from create to apply this function
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_fusion_destroy(const unsigned int fusionId);
+
+/**
+ * @brief Changes overlay and coloring of subsequent fused images
+ * @param[in] fusionId fusion instance id from create to apply this function
+ * @param[in] mode EvoIRFusionMode
+ * @param[in] alpha see EvoIRFusionParams::alpha
+ * @param[in] edgeGain see EvoIRFusionParams::edgeGain
+ * @param[in] paletteId see EvoIRFusionParams::paletteId
+ * @param[in] scale see EvoIRFusionParams::scale
+ * @param[in] tMin see EvoIRFusionParams::tMin
+ * @param[in] tMax see EvoIRFusionParams::tMax
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_fusion_set_overlay(const unsigned int fusionId, int mode, int alpha, int edgeGain, int paletteId, int scale, float tMin, float tMax);
+
+/**
+ * @brief Adds a thermal frame to the history, the oldest of EVO_FUSION_THERMAL_FRAMES is dropped
+ * @param[in] fusionId fusion instance id from create to apply this function
+ * @param[in] data thermal image (size of thermalWidth * thermalHeight)
+ * @param[in] metadata metadata of the frame
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_fusion_push_thermal(const unsigned int fusionId, const unsigned short* data, const EvoIRFrameMetadata* metadata);
+
+/**
+ * @brief Replaces the visible frame
+ * @param[in] fusionId fusion instance id from create to apply this function
+ * @param[in] data YUYV visible image (size of visibleWidth * visibleHeight)
+ * @param[in] metadata metadata of the frame
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_fusion_push_visible(const unsigned int fusionId, const unsigned short* data, const EvoIRFrameMetadata* metadata);
+
+/**
+ * @brief Accessor to the visible frame converted to rgb (BT.601 full range)
+ * @param[in] fusionId fusion instance id from create to apply this function
+ * @param[out] data pointer to unsigned char array allocate by the user (size of 3 * visibleWidth * visibleHeight)
+ * @param[out] metadata pointer to EvoIRFrameMetadata allocate by the user, may be NULL
+ * @return 0 on success, -1 on error (no visible frame pushed yet)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_fusion_get_visible(const unsigned int fusionId, unsigned char* data, EvoIRFrameMetadata* metadata);
+
+/**
+ * @brief Accessor to the thermal frame paired with the visible frame, registered onto the visible pixel grid
+ * @param[in] fusionId fusion instance id from create to apply this function
+ * @param[out] data pointer to unsigned short array allocate by the user (size of visibleWidth * visibleHeight), 0 for pixels outside the thermal image
+ * @param[out] info pointer to EvoIRFusionInfo allocate by the user, may be NULL
+ * @return 0 on success, 1 if no thermal frame lies within maxSkew (data not written), -1 on error (no visible frame pushed yet)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_fusion_get_registered_thermal(const unsigned int fusionId, unsigned short* data, EvoIRFusionInfo* info);
+
+/**
+ * @brief Accessor to the fused image of the visible frame and the thermal frame paired with it. Pixels outside the thermal image show the visible image.
+ * @param[in] fusionId fusion instance id from create to apply this function
+ * @param[out] data pointer to unsigned char array allocate by the user (size of 3 * visibleWidth * visibleHeight)
+ * @param[out] info pointer to EvoIRFusionInfo allocate by the user, may be NULL
+ * @return 0 on success, 1 if no thermal frame lies within maxSkew (data not written), -1 on error (no visible frame pushed yet)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_fusion_get_fused(const unsigned int fusionId, unsigned char* data, EvoIRFusionInfo* info);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* EVOIRFUSION_H_ */
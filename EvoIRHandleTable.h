@@ -0,0 +1,163 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRHandleTable.h
+ * @brief Maps instance ids handed out by the C interfaces to C++ objects
+ *
+ * Internal header, only used by the implementation files of the Easy API
+ * extensions. Ids are plain unsigned integers like the camera instance ids
+ * of the evo_irimager_multi_* functions, so that they can be passed around
+ * from Matlab, LabView, Python etc. without pointer handling.
+ */
+
+#ifndef EVOIRHANDLETABLE_H_
+#define EVOIRHANDLETABLE_H_
+
+#include <atomic>
+#include <thread>
+
+namespace evo
+{
+
+/**
+ * @brief Fixed capacity table of object instances. Lookup is lock-free, so it
+ * can be used in per frame calls.
+ *
+ * get hands out the plain pointer, the caller has to make sure that the
+ * instance is not removed and deleted meanwhile. Instances whose functions
+ * may run concurrently with their destruction are accessed through acquire
+ * instead, remove waits until every reference taken before has been dropped.
+ */
+template<typename T, unsigned int Capacity = 64>
+class EvoIRHandleTable
+{
+public:
+  /**
+   * @brief Reference to an instance, keeps remove from returning while held
+   */
+  class Ref
+  {
+  public:
+    Ref() : _readers(nullptr), _obj(nullptr) { }
+
+    Ref(Ref&& other) : _readers(other._readers), _obj(other._obj)
+    {
+      other._readers = nullptr;
+      other._obj     = nullptr;
+    }
+
+    ~Ref()
+    {
+      if(_readers) _readers->fetch_sub(1, std::memory_order_release);
+    }
+
+    T* get() const        { return _obj; }
+    T* operator->() const { return _obj; }
+    explicit operator bool() const { return _obj != nullptr; }
+
+  private:
+    friend class EvoIRHandleTable;
+
+    Ref(std::atomic<unsigned int>* readers, T* obj) : _readers(readers), _obj(obj) { }
+
+    Ref(const Ref&);
+    Ref& operator=(const Ref&);
+
+    std::atomic<unsigned int>* _readers;
+    T* _obj;
+  };
+
+  EvoIRHandleTable()
+  {
+    for(unsigned int i = 0; i < Capacity; i++)
+    {
+      _slots[i].store(nullptr);
+      _readers[i].store(0);
+    }
+  }
+
+  ~EvoIRHandleTable()
+  {
+    for(unsigned int i = 0; i < Capacity; i++)
+      delete _slots[i].exchange(nullptr);
+  }
+
+  /**
+   * @brief Takes ownership of obj and assigns an id to it
+   * @param[in] obj instance to be registered
+   * @param[out] outId instance id for reference
+   * @return true on success, false if the table is full (obj is not deleted)
+   */
+  bool insert(T* obj, unsigned int* outId)
+  {
+    for(unsigned int i = 0; i < Capacity; i++)
+    {
+      T* expected = nullptr;
+      if(_slots[i].compare_exchange_strong(expected, obj))
+      {
+        *outId = i;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * @brief Access instance by id
+   * @return instance or nullptr for unknown ids
+   */
+  T* get(unsigned int id) const
+  {
+    return (id < Capacity) ? _slots[id].load(std::memory_order_acquire) : nullptr;
+  }
+
+  /**
+   * @brief Access instance by id, the instance is not deleted before the reference is dropped
+   * @return reference, empty for unknown ids
+   */
+  Ref acquire(unsigned int id)
+  {
+    if(id >= Capacity) return Ref();
+    // announce the reader before the lookup, remove clears the slot before it counts the readers
+    _readers[id].fetch_add(1);
+    T* obj = _slots[id].load();
+    if(!obj)
+    {
+      _readers[id].fetch_sub(1);
+      return Ref();
+    }
+    return Ref(&_readers[id], obj);
+  }
+
+  /**
+   * @brief Unregisters an instance and waits until no reference from acquire is held, ownership is passed back to the caller
+   * @return instance or nullptr for unknown ids
+   */
+  T* remove(unsigned int id)
+  {
+    if(id >= Capacity) return nullptr;
+    T* obj = _slots[id].exchange(nullptr);
+    if(obj)
+    {
+      while(_readers[id].load() > 0)
+        std::this_thread::yield();
+    }
+    return obj;
+  }
+
+private:
+  EvoIRHandleTable(const EvoIRHandleTable&);
+  EvoIRHandleTable& operator=(const EvoIRHandleTable&);
+
+  std::atomic<T*> _slots[Capacity];
+  std::atomic<unsigned int> _readers[Capacity];
+};
+
+} // namespace evo
+
+#endif /* EVOIRHANDLETABLE_H_ */
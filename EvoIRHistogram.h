@@ -0,0 +1,40 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRHistogram.h
+ * @brief Timing histogram reported by the statistics accessors of the Easy API extensions
+ */
+
+#ifndef EVOIRHISTOGRAM_H_
+#define EVOIRHISTOGRAM_H_
+
+#include "irdirectsdk_defs.h"
+
+#define EVO_HISTOGRAM_BINS    24
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Histogram with logarithmic bins: bin 0 counts values below 1 microsecond, bin i values in [2^(i-1); 2^i) microseconds.
+ * The last bin also counts all larger values.
+ */
+typedef struct __IRDIRECTSDK_API__ EvoIRHistogram
+{
+  unsigned long long bins[EVO_HISTOGRAM_BINS];
+  unsigned long long count; /*!< Number of samples */
+  double mean;              /*!< Mean in microseconds */
+  double max;               /*!< Maximum in microseconds */
+} EvoIRHistogram;
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* EVOIRHISTOGRAM_H_ */
@@ -0,0 +1,707 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRHub.cpp
+ * @brief Frame pool with reference counts, per subscriber queues and lazy conversion
+ *
+ * The hub mutex guards the pool bookkeeping and the queues only; thermal
+ * data is grabbed or copied into a slot and converted outside of it. A slot
+ * is free when it is neither queued for nor held by any subscriber. The pool
+ * holds more slots than subscribers can hold, so taking a slot never waits:
+ * if none is free, the oldest slot only queued is taken back from all queues.
+ *
+ * On delivery the crops of the receiving subscribers are merged into one
+ * rectangle per representation. The first receive converting a representation
+ * does so for that rectangle under the lock of the slot; later receives find
+ * it done. The rectangle does not change after delivery, so it is read
+ * without the hub mutex.
+ *
+ * The slot vector grows when subscribers are added, so slots are looked up
+ * under the hub mutex only; the slots themselves are not moved.
+ */
+
+#include "EvoIRHub.h"
+#include "direct_binding.h"
+#include "EvoIRHandleTable.h"
+#include "EvoIRPalette.h"
+#include "EvoIRSyntheticSource.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace evo
+{
+
+namespace
+{
+
+const unsigned int MAX_QUEUE = 16;
+
+struct Rect
+{
+  int x0, y0, x1, y1; // exclusive, empty if x0 >= x1
+
+  void clear() { x0 = y0 = x1 = y1 = 0; }
+  bool empty() const { return x0 >= x1 || y0 >= y1; }
+  void merge(const Rect& r)
+  {
+    if(empty())
+    {
+      *this = r;
+      return;
+    }
+    x0 = std::min(x0, r.x0);
+    y0 = std::min(y0, r.y0);
+    x1 = std::max(x1, r.x1);
+    y1 = std::max(y1, r.y1);
+  }
+};
+
+struct Slot
+{
+  std::vector<unsigned short> thermal;
+  std::vector<float> celsius;          // allocated on first use
+  std::vector<unsigned char> palette;  // allocated on first use
+  EvoIRFrameMetadata metadata;
+  unsigned long long sequence;
+  unsigned int queued;                 // references in subscriber queues
+  unsigned int held;                   // subscribers holding the frame
+  bool writing;                        // taken by the producer
+  Rect need[EVO_HUB_REPRESENTATIONS];
+  int paletteId, scale;
+  float tMin, tMax;
+
+  std::mutex convert;
+  bool done[EVO_HUB_REPRESENTATIONS];  // guarded by convert
+};
+
+struct Subscriber
+{
+  unsigned int id;
+  EvoIRHubSubscription sub;
+  Rect crop;
+  long long period;                    // UNITS, 0 for every frame
+  long long nextDue;
+  bool started;
+  unsigned int queue[MAX_QUEUE];       // slot indices, oldest at head
+  unsigned int head;
+  unsigned int count;
+  unsigned int held;                   // slot index or NONE
+  unsigned int active;                 // threads inside receive
+  bool removed;
+  std::condition_variable cond;
+  EvoIRHubSubscriberStats stats;
+};
+
+} // namespace
+
+class EvoIRHub
+{
+public:
+  typedef std::function<int(unsigned short*, EvoIRFrameMetadata*)> GrabFunction;
+
+  static const unsigned int NONE = ~0u;
+
+  EvoIRHub(int w, int h, short decimalPlaces) :
+    _width(w),
+    _height(h),
+    _decimalPlaces(decimalPlaces),
+    _sequence(0),
+    _published(0),
+    _failed(0),
+    _paletteId(6),
+    _scale(2),
+    _tMin(20.f),
+    _tMax(40.f),
+    _closed(false),
+    _running(false)
+  {
+    for(int r = 0; r < EVO_HUB_REPRESENTATIONS; r++)
+      _computed[r].store(0);
+    for(unsigned int i = 0; i < EVO_HUB_MAX_SUBSCRIBERS; i++)
+    {
+      _subscribers[i] = nullptr;
+      _generation[i]  = 0;
+    }
+    ensureSlots();
+  }
+
+  ~EvoIRHub()
+  {
+    shutdown();
+    for(unsigned int i = 0; i < EVO_HUB_MAX_SUBSCRIBERS; i++)
+      delete _subscribers[i];
+    for(size_t i = 0; i < _slots.size(); i++)
+      delete _slots[i];
+  }
+
+  int width() const { return _width; }
+  int height() const { return _height; }
+
+  bool subscribe(const EvoIRHubSubscription& sub, unsigned int* id)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(_closed) return false;
+    unsigned int i = 0;
+    while(i < EVO_HUB_MAX_SUBSCRIBERS && _subscribers[i]) i++;
+    if(i == EVO_HUB_MAX_SUBSCRIBERS) return false;
+    Subscriber* s = new Subscriber();
+    // the generation keeps ids of removed subscribers from addressing the next one in their place
+    s->id        = i + EVO_HUB_MAX_SUBSCRIBERS * (++_generation[i] % (~0u / EVO_HUB_MAX_SUBSCRIBERS));
+    s->sub       = sub;
+    s->crop.x0   = sub.x;
+    s->crop.y0   = sub.y;
+    s->crop.x1   = sub.width  ? sub.x + sub.width  : _width;
+    s->crop.y1   = sub.height ? sub.y + sub.height : _height;
+    s->period    = sub.rate > 0.f ? (long long)(1e7 / sub.rate + 0.5) : 0;
+    s->nextDue   = 0;
+    s->started   = false;
+    s->head      = 0;
+    s->count     = 0;
+    s->held      = NONE;
+    s->active    = 0;
+    s->removed   = false;
+    std::memset(&s->stats, 0, sizeof(s->stats));
+    _subscribers[i] = s;
+    ensureSlots();
+    *id = s->id;
+    return true;
+  }
+
+  bool unsubscribe(unsigned int id)
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    Subscriber* s = subscriber(id);
+    if(!s) return false;
+    remove(s, lock);
+    return true;
+  }
+
+  /**
+   * Stops capturing and removes all subscribers, waiting receives return -1 and later subscribes fail
+   */
+  void shutdown()
+  {
+    stop();
+    std::unique_lock<std::mutex> lock(_mutex);
+    _closed = true;
+    for(unsigned int i = 0; i < EVO_HUB_MAX_SUBSCRIBERS; i++)
+      if(_subscribers[i]) remove(_subscribers[i], lock);
+  }
+
+  void setPalette(int paletteId, int scale, float tMin, float tMax)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _paletteId = paletteId;
+    _scale     = scale;
+    _tMin      = tMin;
+    _tMax      = tMax;
+  }
+
+  bool start(const GrabFunction& grab)
+  {
+    std::lock_guard<std::mutex> control(_controlMutex);
+    if(_running.load()) return false;
+    _running.store(true);
+    _thread = std::thread(&EvoIRHub::acquireLoop, this, grab);
+    return true;
+  }
+
+  bool stop()
+  {
+    std::lock_guard<std::mutex> control(_controlMutex);
+    if(!_running.load()) return false;
+    _running.store(false);
+    _thread.join();
+    return true;
+  }
+
+  bool running() const { return _running.load(); }
+
+  void publish(const unsigned short* data, const EvoIRFrameMetadata& metadata)
+  {
+    unsigned int index;
+    Slot* slot = take(&index);
+    std::memcpy(&slot->thermal[0], data, slot->thermal.size() * sizeof(unsigned short));
+    slot->metadata = metadata;
+    deliver(index);
+  }
+
+  int receive(unsigned int id, int timeoutMs, EvoIRHubFrame* frame)
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    Subscriber* s = subscriber(id);
+    if(!s || s->held != NONE) return -1;
+    s->active++;
+    const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs > 0 ? timeoutMs : 0);
+    while(!s->removed && s->count == 0 && timeoutMs != 0)
+    {
+      if(timeoutMs < 0) s->cond.wait(lock);
+      else if(s->cond.wait_until(lock, deadline) == std::cv_status::timeout) break;
+    }
+    if(s->removed || s->count == 0)
+    {
+      const int ret = s->removed ? -1 : -3;
+      s->active--;
+      s->cond.notify_all();
+      return ret;
+    }
+    const unsigned int index = pop(s);
+    Slot* slot = _slots[index];
+    slot->queued--;
+    slot->held++;
+    s->held = index;
+    s->stats.received++;
+    const int r = s->sub.representation;
+    const Rect crop = s->crop;
+    lock.unlock();
+
+    convert(slot, r);
+    frame->sequence       = slot->sequence;
+    frame->representation = r;
+    frame->x              = crop.x0;
+    frame->y              = crop.y0;
+    frame->width          = crop.x1 - crop.x0;
+    frame->height         = crop.y1 - crop.y0;
+    frame->metadata       = slot->metadata;
+    const size_t first    = (size_t)crop.y0 * _width + crop.x0;
+    if(r == EVO_HUB_THERMAL)
+    {
+      frame->stride = _width * (int)sizeof(unsigned short);
+      frame->data   = &slot->thermal[first];
+    }
+    else if(r == EVO_HUB_CELSIUS)
+    {
+      frame->stride = _width * (int)sizeof(float);
+      frame->data   = &slot->celsius[first];
+    }
+    else
+    {
+      frame->stride = 3 * _width;
+      frame->data   = &slot->palette[3 * first];
+    }
+
+    lock.lock();
+    s->active--;
+    s->cond.notify_all();
+    return 0;
+  }
+
+  bool release(unsigned int id)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    Subscriber* s = subscriber(id);
+    if(!s || s->held == NONE) return false;
+    _slots[s->held]->held--;
+    s->held = NONE;
+    return true;
+  }
+
+  bool subscriberStats(unsigned int id, EvoIRHubSubscriberStats* stats)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    Subscriber* s = subscriber(id);
+    if(!s) return false;
+    *stats = s->stats;
+    return true;
+  }
+
+  void stats(EvoIRHubStats* stats)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    stats->published = _published;
+    stats->failed    = _failed.load();
+    for(int r = 0; r < EVO_HUB_REPRESENTATIONS; r++)
+      stats->computed[r] = _computed[r].load();
+  }
+
+private:
+  EvoIRHub(const EvoIRHub&);
+  EvoIRHub& operator=(const EvoIRHub&);
+
+  Subscriber* subscriber(unsigned int id) const
+  {
+    Subscriber* s = _subscribers[id % EVO_HUB_MAX_SUBSCRIBERS];
+    return s && s->id == id ? s : nullptr;
+  }
+
+  /**
+   * Wakes receives of a subscriber and deletes it once they have left. Caller holds the mutex.
+   */
+  void remove(Subscriber* s, std::unique_lock<std::mutex>& lock)
+  {
+    s->removed = true;
+    s->cond.notify_all();
+    // a receive converting the held frame still needs it
+    while(s->active > 0)
+      s->cond.wait(lock);
+    while(s->count > 0) _slots[pop(s)]->queued--;
+    if(s->held != NONE) _slots[s->held]->held--;
+    _subscribers[s->id % EVO_HUB_MAX_SUBSCRIBERS] = nullptr;
+    delete s;
+  }
+
+  /**
+   * Every subscriber may hold one frame and queue up to MAX_QUEUE frames, two slots more leave one for the producer. Caller holds the mutex.
+   */
+  void ensureSlots()
+  {
+    unsigned int subscribers = 0, queue = 0;
+    for(unsigned int i = 0; i < EVO_HUB_MAX_SUBSCRIBERS; i++)
+    {
+      if(!_subscribers[i]) continue;
+      subscribers++;
+      queue = std::max(queue, _subscribers[i]->sub.queueFrames);
+    }
+    const size_t needed = 2 + subscribers + 2 * queue;
+    while(_slots.size() < needed)
+    {
+      Slot* slot = new Slot();
+      slot->thermal.resize((size_t)_width * _height);
+      std::memset(&slot->metadata, 0, sizeof(slot->metadata));
+      slot->sequence = 0;
+      slot->queued   = 0;
+      slot->held     = 0;
+      slot->writing  = false;
+      _slots.push_back(slot);
+    }
+  }
+
+  unsigned int pop(Subscriber* s)
+  {
+    const unsigned int index = s->queue[s->head];
+    s->head = (s->head + 1) % MAX_QUEUE;
+    s->count--;
+    return index;
+  }
+
+  /**
+   * A free slot for the producer, the oldest slot only queued is taken back if there is none
+   */
+  Slot* take(unsigned int* index)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    unsigned int oldest = NONE;
+    for(unsigned int i = 0; i < _slots.size(); i++)
+    {
+      Slot* slot = _slots[i];
+      if(slot->writing || slot->held > 0) continue;
+      if(slot->queued == 0)
+      {
+        slot->writing = true;
+        *index = i;
+        return slot;
+      }
+      if(oldest == NONE || slot->sequence < _slots[oldest]->sequence) oldest = i;
+    }
+    // more slots than subscribers can hold, so there is always one queued
+    for(unsigned int i = 0; i < EVO_HUB_MAX_SUBSCRIBERS; i++)
+    {
+      Subscriber* s = _subscribers[i];
+      if(!s) continue;
+      unsigned int kept = 0;
+      for(unsigned int k = 0; k < s->count; k++)
+      {
+        const unsigned int index = s->queue[(s->head + k) % MAX_QUEUE];
+        if(index == oldest) s->stats.dropped++;
+        else s->queue[(s->head + kept++) % MAX_QUEUE] = index;
+      }
+      s->count = kept;
+    }
+    _slots[oldest]->queued  = 0;
+    _slots[oldest]->writing = true;
+    *index = oldest;
+    return _slots[oldest];
+  }
+
+  /**
+   * Queues a slot filled by the producer for all subscribers due
+   */
+  void deliver(unsigned int index)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    Slot* slot = _slots[index];
+    const long long timestamp = slot->metadata.timestamp;
+    slot->sequence  = ++_sequence;
+    slot->paletteId = _paletteId;
+    slot->scale     = _scale;
+    slot->tMin      = _tMin;
+    slot->tMax      = _tMax;
+    for(int r = 0; r < EVO_HUB_REPRESENTATIONS; r++)
+    {
+      slot->need[r].clear();
+      slot->done[r] = false;
+    }
+    for(unsigned int i = 0; i < EVO_HUB_MAX_SUBSCRIBERS; i++)
+    {
+      Subscriber* s = _subscribers[i];
+      if(!s || s->removed) continue;
+      if(s->period > 0)
+      {
+        if(s->started && timestamp < s->nextDue) continue;
+        // due times advance by the period, so the rate is kept on average; after a gap they start over
+        s->nextDue = s->started ? s->nextDue + s->period : timestamp + s->period;
+        if(s->nextDue <= timestamp) s->nextDue = timestamp + s->period;
+        s->started = true;
+      }
+      if(s->count == s->sub.queueFrames)
+      {
+        _slots[pop(s)]->queued--;
+        s->stats.dropped++;
+      }
+      s->queue[(s->head + s->count) % MAX_QUEUE] = index;
+      s->count++;
+      s->stats.delivered++;
+      slot->queued++;
+      slot->need[s->sub.representation].merge(s->crop);
+      s->cond.notify_all();
+    }
+    slot->writing = false;
+    _published++;
+  }
+
+  /**
+   * Computes a representation of a held slot for all crops it was delivered to, once
+   */
+  void convert(Slot* slot, int r)
+  {
+    if(r == EVO_HUB_THERMAL) return;
+    std::lock_guard<std::mutex> lock(slot->convert);
+    if(slot->done[r]) return;
+    const Rect& rect = slot->need[r];
+    const int w = rect.x1 - rect.x0;
+    // full rows are contiguous and converted at once
+    const bool rows = w == _width;
+    if(r == EVO_HUB_CELSIUS)
+    {
+      if(slot->celsius.empty()) slot->celsius.resize(slot->thermal.size());
+      if(rows)
+        evo_irimager_thermal_to_celsius(&slot->thermal[(size_t)rect.y0 * _width], _width, rect.y1 - rect.y0, _decimalPlaces, &slot->celsius[(size_t)rect.y0 * _width]);
+      else
+        for(int y = rect.y0; y < rect.y1; y++)
+          evo_irimager_thermal_to_celsius(&slot->thermal[(size_t)y * _width + rect.x0], w, 1, _decimalPlaces, &slot->celsius[(size_t)y * _width + rect.x0]);
+    }
+    else
+    {
+      if(slot->palette.empty()) slot->palette.resize(3 * slot->thermal.size());
+      // scaled with the range of the whole image, equal for all crops
+      EvoIRThermalStats stats;
+      std::memset(&stats, 0, sizeof(stats));
+      if(slot->scale != 1) evo_irimager_thermal_stats(&slot->thermal[0], _width, _height, &stats);
+      unsigned short rawMin, rawMax;
+      evo_irimager_palette_scale_range(&stats, slot->scale, slot->tMin, slot->tMax, _decimalPlaces, &rawMin, &rawMax);
+      if(rows)
+        evo_irimager_palette_apply(&slot->thermal[(size_t)rect.y0 * _width], _width, rect.y1 - rect.y0, slot->paletteId, rawMin, rawMax,
+                                   EVO_PALETTE_INTERLEAVED, &slot->palette[3 * (size_t)rect.y0 * _width]);
+      else
+        for(int y = rect.y0; y < rect.y1; y++)
+          evo_irimager_palette_apply(&slot->thermal[(size_t)y * _width + rect.x0], w, 1, slot->paletteId, rawMin, rawMax,
+                                     EVO_PALETTE_INTERLEAVED, &slot->palette[3 * ((size_t)y * _width + rect.x0)]);
+    }
+    slot->done[r] = true;
+    _computed[r].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void acquireLoop(GrabFunction grab)
+  {
+    while(_running.load(std::memory_order_relaxed))
+    {
+      unsigned int index;
+      Slot* slot = take(&index);
+      if(grab(&slot->thermal[0], &slot->metadata) != 0)
+      {
+        _failed.fetch_add(1, std::memory_order_relaxed);
+        {
+          std::lock_guard<std::mutex> lock(_mutex);
+          slot->writing = false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        continue;
+      }
+      deliver(index);
+    }
+  }
+
+  const int _width;
+  const int _height;
+  const short _decimalPlaces;
+
+  std::mutex _mutex;                   // pool bookkeeping, queues, palette settings
+  std::vector<Slot*> _slots;
+  Subscriber* _subscribers[EVO_HUB_MAX_SUBSCRIBERS];
+  unsigned int _generation[EVO_HUB_MAX_SUBSCRIBERS];
+  unsigned long long _sequence;
+  unsigned long long _published;
+  std::atomic<unsigned long long> _failed;
+  std::atomic<unsigned long long> _computed[EVO_HUB_REPRESENTATIONS];
+  int _paletteId;
+  int _scale;
+  float _tMin;
+  float _tMax;
+  bool _closed;
+
+  std::mutex _controlMutex;            // start and stop
+  std::atomic<bool> _running;
+  std::thread _thread;
+};
+
+static EvoIRHandleTable<EvoIRHub> g_hubs;
+typedef EvoIRHandleTable<EvoIRHub>::Ref HubRef;
+
+} // namespace evo
+
+using namespace evo;
+
+int evo_irimager_hub_create(unsigned int* outHubId, int w, int h, short decimalPlaces)
+{
+  if(!outHubId || w <= 0 || h <= 0 || decimalPlaces < 1 || decimalPlaces > 4) return -1;
+  EvoIRHub* hub = new EvoIRHub(w, h, decimalPlaces);
+  if(!g_hubs.insert(hub, outHubId))
+  {
+    delete hub;
+    return -1;
+  }
+  return 0;
+}
+
+int evo_irimager_hub_destroy(const unsigned int hubId)
+{
+  {
+    // subscribers waiting in receive hold references, wake them before remove waits for the references
+    HubRef hub = g_hubs.acquire(hubId);
+    if(!hub) return -1;
+    hub->shutdown();
+  }
+  EvoIRHub* hub = g_hubs.remove(hubId);
+  if(!hub) return -1;
+  delete hub;
+  return 0;
+}
+
+void evo_irimager_hub_default_subscription(EvoIRHubSubscription* sub, int representation)
+{
+  if(!sub) return;
+  std::memset(sub, 0, sizeof(*sub));
+  sub->representation = representation;
+  sub->queueFrames    = 2;
+}
+
+int evo_irimager_hub_subscribe(const unsigned int hubId, const EvoIRHubSubscription* sub, unsigned int* outSubId)
+{
+  HubRef hub = g_hubs.acquire(hubId);
+  if(!hub || !sub || !outSubId) return -1;
+  if(sub->representation < 0 || sub->representation >= EVO_HUB_REPRESENTATIONS || !(sub->rate >= 0.f)
+     || sub->queueFrames < 1 || sub->queueFrames > MAX_QUEUE)
+    return -1;
+  if(sub->x < 0 || sub->y < 0 || sub->width < 0 || sub->height < 0 || sub->x + sub->width > hub->width() || sub->y + sub->height > hub->height()
+     || (!sub->width && sub->x) || (!sub->height && sub->y))
+    return -1;
+  return hub->subscribe(*sub, outSubId) ? 0 : -1;
+}
+
+int evo_irimager_hub_unsubscribe(const unsigned int hubId, const unsigned int subId)
+{
+  HubRef hub = g_hubs.acquire(hubId);
+  if(!hub) return -1;
+  return hub->unsubscribe(subId) ? 0 : -1;
+}
+
+int evo_irimager_hub_set_palette(const unsigned int hubId, int paletteId, int scale, float tMin, float tMax)
+{
+  HubRef hub = g_hubs.acquire(hubId);
+  if(!hub || paletteId < 1 || paletteId > 11 || scale < 1 || scale > 4) return -1;
+  hub->setPalette(paletteId, scale, tMin, tMax);
+  return 0;
+}
+
+int evo_irimager_hub_start_capture(const unsigned int hubId)
+{
+  HubRef hub = g_hubs.acquire(hubId);
+  if(!hub) return -1;
+  int w, h;
+  if(evo_irimager_get_thermal_image_size(&w, &h) != 0 || w != hub->width() || h != hub->height()) return -1;
+  return hub->start([w, h](unsigned short* thermal, EvoIRFrameMetadata* metadata) {
+    int tw = w, th = h;
+    return evo_irimager_get_thermal_image_metadata(&tw, &th, thermal, metadata);
+  }) ? 0 : -1;
+}
+
+int evo_irimager_hub_start_multi_capture(const unsigned int hubId, const unsigned int camId)
+{
+  HubRef hub = g_hubs.acquire(hubId);
+  if(!hub) return -1;
+  int w, h;
+  if(evo_irimager_multi_get_thermal_image_size(camId, &w, &h) != 0 || w != hub->width() || h != hub->height()) return -1;
+  return hub->start([camId, w, h](unsigned short* thermal, EvoIRFrameMetadata* metadata) {
+    int tw = w, th = h;
+    return evo_irimager_multi_get_thermal_image_metadata(camId, &tw, &th, thermal, metadata);
+  }) ? 0 : -1;
+}
+
+int evo_irimager_hub_start_synthetic(const unsigned int hubId, const unsigned int srcId)
+{
+  HubRef hub = g_hubs.acquire(hubId);
+  if(!hub) return -1;
+  int w, h;
+  if(evo_irimager_synthetic_get_thermal_image_size(srcId, &w, &h) != 0 || w != hub->width() || h != hub->height()) return -1;
+  return hub->start([srcId, w, h](unsigned short* thermal, EvoIRFrameMetadata* metadata) {
+    int tw = w, th = h;
+    return evo_irimager_synthetic_get_thermal_image_metadata(srcId, &tw, &th, thermal, metadata);
+  }) ? 0 : -1;
+}
+
+int evo_irimager_hub_stop(const unsigned int hubId)
+{
+  HubRef hub = g_hubs.acquire(hubId);
+  if(!hub) return -1;
+  return hub->stop() ? 0 : -1;
+}
+
+int evo_irimager_hub_publish(const unsigned int hubId, const unsigned short* data, const EvoIRFrameMetadata* metadata)
+{
+  HubRef hub = g_hubs.acquire(hubId);
+  if(!hub || !data || !metadata || hub->running()) return -1;
+  hub->publish(data, *metadata);
+  return 0;
+}
+
+int evo_irimager_hub_receive(const unsigned int hubId, const unsigned int subId, int timeoutMs, EvoIRHubFrame* frame)
+{
+  HubRef hub = g_hubs.acquire(hubId);
+  if(!hub || !frame) return -1;
+  return hub->receive(subId, timeoutMs, frame);
+}
+
+int evo_irimager_hub_release(const unsigned int hubId, const unsigned int subId)
+{
+  HubRef hub = g_hubs.acquire(hubId);
+  if(!hub) return -1;
+  return hub->release(subId) ? 0 : -1;
+}
+
+int evo_irimager_hub_get_subscriber_stats(const unsigned int hubId, const unsigned int subId, EvoIRHubSubscriberStats* stats)
+{
+  HubRef hub = g_hubs.acquire(hubId);
+  if(!hub || !stats) return -1;
+  return hub->subscriberStats(subId, stats) ? 0 : -1;
+}
+
+int evo_irimager_hub_get_stats(const unsigned int hubId, EvoIRHubStats* stats)
+{
+  HubRef hub = g_hubs.acquire(hubId);
+  if(!hub || !stats) return -1;
+  hub->stats(stats);
+  return 0;
+}
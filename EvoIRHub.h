@@ -0,0 +1,236 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRHub.h
+ * @brief Provides in-process publish/subscribe of frames at individual rates for Easy API C-Library Interface
+ *
+ * The <framerate> of the configuration file scales down the stream of the
+ * device for everyone. A hub takes the full stream from one producer (an own
+ * acquisition thread bound to a camera or synthetic source, or the caller via
+ * evo_irimager_hub_publish) and hands it to any number of subscribers, each
+ * with its own
+ *
+ * - rate: frames are decimated by EvoIRFrameMetadata::timestamp to the rate on average
+ * - representation: raw thermal values, degree Celsius or palette image
+ * - crop: a rectangle of the image
+ *
+ * Frames live in a shared pool and are delivered by reference; a crop is a
+ * view into the frame (see EvoIRHubFrame::stride). Temperatures and palette
+ * images are computed lazily by the first subscriber receiving a frame, at
+ * most once per frame, and only for the rows and columns of the crops of the
+ * subscribers the frame was delivered to. The producer never waits: every
+ * subscriber has a queue of queueFrames frames and loses the oldest one if it
+ * does not keep up, counted in EvoIRHubSubscriberStats::dropped. The pool
+ * grows with the subscribers; should it still run out, the oldest frame no
+ * subscriber holds is taken back from all queues.
+ *
+ * @code
+ * evo_irimager_hub_create(&hubId, 640, 480, 1);
+ * EvoIRHubSubscription sub;
+ * evo_irimager_hub_default_subscription(&sub, EVO_HUB_PALETTE);
+ * sub.rate = 10.f;
+ * evo_irimager_hub_subscribe(hubId, &sub, &subId);
+ * evo_irimager_hub_start_capture(hubId);
+ * // consumer thread
+ * EvoIRHubFrame frame;
+ * while(evo_irimager_hub_receive(hubId, subId, 1000, &frame) != -1)
+ * {
+ *   // ... frame.data ...
+ *   evo_irimager_hub_release(hubId, subId);
+ * }
+ * @endcode
+ */
+
+#ifndef EVOIRHUB_H_
+#define EVOIRHUB_H_
+
+#include "irdirectsdk_defs.h"
+#include "EvoIRFrameMetadata.h"
+
+#define EVO_HUB_MAX_SUBSCRIBERS 64
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+typedef enum
+{
+  EVO_HUB_THERMAL         = 0, /*!< raw thermal values, unsigned short */
+  EVO_HUB_CELSIUS         = 1, /*!< temperatures in degree Celsius, float */
+  EVO_HUB_PALETTE         = 2, /*!< palette image, unsigned char r,g,b interleaved */
+  EVO_HUB_REPRESENTATIONS = 3
+} EvoIRHubRepresentation;
+
+typedef struct __IRDIRECTSDK_API__ EvoIRHubSubscription
+{
+  int representation;       /*!< EvoIRHubRepresentation */
+  float rate;               /*!< Frames per second, 0 for every frame */
+  int x, y;                 /*!< Upper left corner of crop */
+  int width, height;        /*!< Size of crop, 0 for the whole image */
+  unsigned int queueFrames; /*!< Frames queued for the subscriber before the oldest is dropped [1; 16] */
+} EvoIRHubSubscription;
+
+/**
+ * @brief Frame handed out by evo_irimager_hub_receive, valid until release
+ */
+typedef struct __IRDIRECTSDK_API__ EvoIRHubFrame
+{
+  unsigned long long sequence;  /*!< Consecutive number of frames published, gaps indicate decimated or dropped frames */
+  int representation;           /*!< EvoIRHubRepresentation */
+  int x, y;                     /*!< Upper left corner of crop */
+  int width, height;            /*!< Size of crop */
+  int stride;                   /*!< Bytes from one row of the crop to the next */
+  const void* data;             /*!< First element of crop: unsigned short, float or 3 unsigned char per pixel */
+  EvoIRFrameMetadata metadata;  /*!< Frame metadata */
+} EvoIRHubFrame;
+
+typedef struct __IRDIRECTSDK_API__ EvoIRHubSubscriberStats
+{
+  unsigned long long delivered; /*!< Frames queued for the subscriber */
+  unsigned long long received;  /*!< Frames taken by receive */
+  unsigned long long dropped;   /*!< Queued frames replaced by newer ones before being received */
+} EvoIRHubSubscriberStats;
+
+typedef struct __IRDIRECTSDK_API__ EvoIRHubStats
+{
+  unsigned long long published;                          /*!< Frames published */
+  unsigned long long failed;                             /*!< Failed grab calls of the acquisition thread */
+  unsigned long long computed[EVO_HUB_REPRESENTATIONS];  /*!< Frames a representation was computed for, never more than published */
+} EvoIRHubStats;
+
+/**
+ * @brief Creates a hub
+ * @param[out] outHubId hub instance id for reference
+ * @param[in] w thermal image width
+ * @param[in] h thermal image height
+ * @param[in] decimalPlaces decimal places of raw values [1; 4], see evo_irimager_thermal_to_celsius
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_hub_create(unsigned int* outHubId, int w, int h, short decimalPlaces);
+
+/**
+ * @brief Stops the hub and releases it, waiting receives return -1. Frames held by subscribers become invalid.
+ * @param[in] hubId hub instance id from create to apply this function
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_hub_destroy(const unsigned int hubId);
+
+/**
+ * @brief Fills a subscription with defaults: every frame of the whole image, queue of 2 frames
+ * @param[out] sub pointer to EvoIRHubSubscription allocate by the user
+ * @param[in] representation EvoIRHubRepresentation
+ */
+__IRDIRECTSDK_API__ void evo_irimager_hub_default_subscription(EvoIRHubSubscription* sub, int representation);
+
+/**
+ * @brief Adds a subscriber, frames published afterwards are delivered to it. Allocates its share of the frame pool.
+ * @param[in] hubId hub instance id from create to apply this function
+ * @param[in] sub subscription
+ * @param[out] outSubId subscriber id for reference, stays invalid after unsubscribe when a new subscriber takes its place
+ * @return 0 on success, -1 on error (invalid subscription, crop outside of image, EVO_HUB_MAX_SUBSCRIBERS reached)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_hub_subscribe(const unsigned int hubId, const EvoIRHubSubscription* sub, unsigned int* outSubId);
+
+/**
+ * @brief Removes a subscriber, a waiting receive returns -1
+ * @param[in] hubId hub instance id from create to apply this function
+ * @param[in] subId subscriber id from subscribe
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_hub_unsubscribe(const unsigned int hubId, const unsigned int subId);
+
+/**
+ * @brief Sets palette and scaling of palette images, takes effect with the next frame published
+ * @param[in] hubId hub instance id from create to apply this function
+ * @param[in] paletteId palette id, see evo_irimager_set_palette
+ * @param[in] scale scaling method id, see evo_irimager_set_palette_scale
+ * @param[in] tMin minimum temperature for eManual
+ * @param[in] tMax maximum temperature for eManual
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_hub_set_palette(const unsigned int hubId, int paletteId, int scale, float tMin, float tMax);
+
+/**
+ * @brief Starts an acquisition thread publishing the frames of the camera initialized by evo_irimager_usb_init / evo_irimager_tcp_init
+ * @param[in] hubId hub instance id from create to apply this function
+ * @return 0 on success, -1 on error (image size mismatch, already running)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_hub_start_capture(const unsigned int hubId);
+
+/**
+ * @brief Starts an acquisition thread publishing the frames of a camera initialized by evo_irimager_multi_usb_init / evo_irimager_multi_tcp_init
+ * @param[in] hubId hub instance id from create to apply this function
+ * @param[in] camId camera instance id
+ * @return 0 on success, -1 on error (image size mismatch, already running)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_hub_start_multi_capture(const unsigned int hubId, const unsigned int camId);
+
+/**
+ * @brief Starts an acquisition thread publishing the frames of a synthetic frame source (see EvoIRSyntheticSource.h)
+ * @param[in] hubId hub instance id from create to apply this function
+ * @param[in] srcId synthetic source instance id
+ * @return 0 on success, -1 on error (image size mismatch, already running)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_hub_start_synthetic(const unsigned int hubId, const unsigned int srcId);
+
+/**
+ * @brief Stops the acquisition thread
+ * @param[in] hubId hub instance id from create to apply this function
+ * @return 0 on success, -1 on error (not running)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_hub_stop(const unsigned int hubId);
+
+/**
+ * @brief Publishes a frame from the caller, e.g. an own acquisition thread. Not to be used while an acquisition thread runs.
+ * @param[in] hubId hub instance id from create to apply this function
+ * @param[in] data thermal image (size of w * h)
+ * @param[in] metadata metadata of the frame
+ * @return 0 on success, -1 on error (acquisition thread running)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_hub_publish(const unsigned int hubId, const unsigned short* data, const EvoIRFrameMetadata* metadata);
+
+/**
+ * @brief Takes the oldest frame queued for a subscriber and computes its representation if no other subscriber did. Only one frame can be held at a time.
+ * @param[in] hubId hub instance id from create to apply this function
+ * @param[in] subId subscriber id from subscribe
+ * @param[in] timeoutMs time to wait for a frame in milliseconds, 0 polls, negative values wait infinitely
+ * @param[out] frame pointer to EvoIRHubFrame allocate by the user
+ * @return 0 on success, -1 on error (unknown subscriber, frame still held, unsubscribed while waiting), -3 if no frame was delivered within timeout
+ */
+__IRDIRECTSDK_API__ int evo_irimager_hub_receive(const unsigned int hubId, const unsigned int subId, int timeoutMs, EvoIRHubFrame* frame);
+
+/**
+ * @brief Hands the frame held by a subscriber back to the hub
+ * @param[in] hubId hub instance id from create to apply this function
+ * @param[in] subId subscriber id from subscribe
+ * @return 0 on success, -1 on error (no frame held)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_hub_release(const unsigned int hubId, const unsigned int subId);
+
+/**
+ * @brief Accessor to the counters of a subscriber
+ * @param[in] hubId hub instance id from create to apply this function
+ * @param[in] subId subscriber id from subscribe
+ * @param[out] stats pointer to EvoIRHubSubscriberStats allocate by the user
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_hub_get_subscriber_stats(const unsigned int hubId, const unsigned int subId, EvoIRHubSubscriberStats* stats);
+
+/**
+ * @brief Accessor to the counters of the hub
+ * @param[in] hubId hub instance id from create to apply this function
+ * @param[out] stats pointer to EvoIRHubStats allocate by the user
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_hub_get_stats(const unsigned int hubId, EvoIRHubStats* stats);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* EVOIRHUB_H_ */
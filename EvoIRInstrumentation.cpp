@@ -0,0 +1,597 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRInstrumentation.cpp
+ * @brief Instrumented accessors and statistics export
+ *
+ * Channels are claimed lock-free on the first call for a camera and never
+ * released. Per frame state (last counter, timestamps, flag state) is owned
+ * by whichever thread holds the channel's try-lock; a concurrent call for
+ * the same camera is not recorded; it only increments the channel's
+ * skipped counter instead of waiting.
+ */
+
+#include "EvoIRInstrumentation.h"
+#include "direct_binding.h"
+#include "EvoIRLogHistogram.h"
+#include "EvoIRSimd.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if EVO_SIMD_X86 && defined(__GNUC__)
+#   include <x86intrin.h>
+#endif
+
+namespace evo
+{
+
+namespace
+{
+
+const long long SINGLE_CAMERA = -1;
+
+std::atomic<bool> g_enabled(false);
+
+long long nowNs()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/*
+ * Tick source of the hot path. On x86 the time stamp counter costs a few
+ * cycles instead of a clock call; it is calibrated against the steady clock
+ * once when recording is enabled the first time. The hot path converts ticks
+ * straight into histogram values (1/1024 us) and does all arithmetic there.
+ */
+std::atomic<double> g_valuesPerTick((double)LogHistogram::fromNanoseconds(1000000) / 1000000.0);
+
+inline unsigned long long ticks()
+{
+#if EVO_SIMD_X86
+  return __rdtsc();
+#else
+  return (unsigned long long)nowNs();
+#endif
+}
+
+void calibrate()
+{
+#if EVO_SIMD_X86
+  const long long t0       = nowNs();
+  const unsigned long long k0 = ticks();
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  const long long t1       = nowNs();
+  const unsigned long long k1 = ticks();
+  if(k1 > k0) g_valuesPerTick.store((double)LogHistogram::fromNanoseconds(t1 - t0) / (double)(k1 - k0));
+#endif
+}
+
+inline void bump(std::atomic<unsigned long long>& counter, unsigned long long n = 1)
+{
+  counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+bool flagClosed(EvoIRFlagState state)
+{
+  return state == irFlagClose || state == irFlagClosing;
+}
+
+class Channel
+{
+public:
+  Channel()
+  {
+    _lock.clear();
+    _skipped.store(0);
+    reset();
+  }
+
+  void reset()
+  {
+    while(_lock.test_and_set(std::memory_order_acquire)) std::this_thread::yield();
+    _haveFrame  = false;
+    _flagClosed = false;
+    _calls.store(0, std::memory_order_relaxed);
+    _failed.store(0, std::memory_order_relaxed);
+    _frames.store(0, std::memory_order_relaxed);
+    _dropped.store(0, std::memory_order_relaxed);
+    _gaps.store(0, std::memory_order_relaxed);
+    _flagTime.store(0, std::memory_order_relaxed);
+    _flagPeriods.store(0, std::memory_order_relaxed);
+    _skipped.store(0, std::memory_order_relaxed);
+    for(int i = 0; i < EVO_INSTR_METRICS; i++)
+      _metrics[i].reset();
+    _lock.clear(std::memory_order_release);
+  }
+
+  /**
+   * @param[in] duration call duration, histogram value
+   * @param[in] arrival host time of arrival, histogram value
+   * @param[in] metadata frame metadata, NULL for accessors not returning a frame
+   */
+  void record(long long duration, bool ok, long long arrival, const EvoIRFrameMetadata* metadata)
+  {
+    // the lock holder is the only writer, so all counters below get by without locked instructions
+    if(_lock.test_and_set(std::memory_order_acquire))
+    {
+      _skipped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    bump(_calls);
+    if(!ok) bump(_failed);
+    _metrics[EVO_INSTR_CALL].recordExclusive((unsigned long long)duration);
+    if(ok && metadata) recordFrame(arrival, *metadata);
+    _lock.clear(std::memory_order_release);
+  }
+
+  void stats(EvoIRInstrChannelStats* stats) const
+  {
+    stats->calls         = _calls.load(std::memory_order_relaxed);
+    stats->failed        = _failed.load(std::memory_order_relaxed);
+    stats->skipped       = _skipped.load(std::memory_order_relaxed);
+    stats->frames        = _frames.load(std::memory_order_relaxed);
+    stats->framesDropped = _dropped.load(std::memory_order_relaxed);
+    stats->gaps          = _gaps.load(std::memory_order_relaxed);
+    stats->flagTime      = LogHistogram::toMicroseconds((double)_flagTime.load(std::memory_order_relaxed)) * 1e-6;
+    stats->flagPeriods   = _flagPeriods.load(std::memory_order_relaxed);
+
+    std::vector<unsigned long long> counts(LogHistogram::BUCKETS);
+    for(int i = 0; i < EVO_INSTR_METRICS; i++)
+    {
+      const LogHistogram& h = _metrics[i];
+      EvoIRInstrSummary& s  = stats->metrics[i];
+      const unsigned long long total = h.snapshot(&counts[0]);
+      s.count = total;
+      s.min   = total ? LogHistogram::toMicroseconds((double)h.min()) : 0.0;
+      s.max   = LogHistogram::toMicroseconds((double)h.max());
+      s.mean  = h.count() ? LogHistogram::toMicroseconds((double)h.sum() / h.count()) : 0.0;
+      s.p50   = LogHistogram::toMicroseconds(LogHistogram::quantile(&counts[0], total, 0.5));
+      s.p90   = LogHistogram::toMicroseconds(LogHistogram::quantile(&counts[0], total, 0.9));
+      s.p99   = LogHistogram::toMicroseconds(LogHistogram::quantile(&counts[0], total, 0.99));
+      s.p999  = LogHistogram::toMicroseconds(LogHistogram::quantile(&counts[0], total, 0.999));
+      // bucket midpoints may lie outside the exact extremes
+      if(s.p50 > s.max) s.p50 = s.max;
+      if(s.p90 > s.max) s.p90 = s.max;
+      if(s.p99 > s.max) s.p99 = s.max;
+      if(s.p999 > s.max) s.p999 = s.max;
+    }
+  }
+
+  const LogHistogram& metric(int i) const { return _metrics[i]; }
+
+private:
+  void recordFrame(long long arrival, const EvoIRFrameMetadata& metadata)
+  {
+    bump(_frames);
+    const long long timestamp = (long long)LogHistogram::fromUnits(metadata.timestamp);
+    const long long offset    = arrival - timestamp;
+    const bool closed         = flagClosed(metadata.flagState);
+
+    if(_haveFrame)
+    {
+      // a counter running backwards indicates a reconnect, do not count this as loss
+      if(metadata.counter > _lastCounter + 1)
+      {
+        bump(_dropped, metadata.counter - _lastCounter - 1);
+        bump(_gaps);
+      }
+      const long long hostInterval   = arrival - _lastArrival;
+      const long long deviceInterval = timestamp - _lastTimestamp;
+      _metrics[EVO_INSTR_INTERVAL].recordExclusive(hostInterval > 0 ? (unsigned long long)hostInterval : 0);
+      _metrics[EVO_INSTR_JITTER].recordExclusive((unsigned long long)(hostInterval > deviceInterval ? hostInterval - deviceInterval : deviceInterval - hostInterval));
+
+      if(_flagClosed && deviceInterval > 0)
+        bump(_flagTime, (unsigned long long)deviceInterval);
+      if(closed && !_flagClosed)
+      {
+        _flagStart = timestamp;
+      }
+      else if(!closed && _flagClosed)
+      {
+        _metrics[EVO_INSTR_FLAG].recordExclusive(timestamp > _flagStart ? (unsigned long long)(timestamp - _flagStart) : 0);
+        bump(_flagPeriods);
+      }
+      if(offset < _minOffset) _minOffset = offset;
+    }
+    else
+    {
+      _minOffset = offset;
+      _flagStart = timestamp;
+    }
+    _metrics[EVO_INSTR_SKEW].recordExclusive((unsigned long long)(offset - _minOffset));
+
+    _haveFrame     = true;
+    _lastCounter   = metadata.counter;
+    _lastArrival   = arrival;
+    _lastTimestamp = timestamp;
+    _flagClosed    = closed;
+  }
+
+  std::atomic_flag _lock;
+  bool _haveFrame;
+  unsigned int _lastCounter;
+  long long _lastArrival;
+  long long _lastTimestamp;
+  long long _minOffset;
+  bool _flagClosed;
+  long long _flagStart;
+
+  std::atomic<unsigned long long> _calls;
+  std::atomic<unsigned long long> _failed;
+  std::atomic<unsigned long long> _skipped;
+  std::atomic<unsigned long long> _frames;
+  std::atomic<unsigned long long> _dropped;
+  std::atomic<unsigned long long> _gaps;
+  std::atomic<unsigned long long> _flagTime;
+  std::atomic<unsigned long long> _flagPeriods;
+  LogHistogram _metrics[EVO_INSTR_METRICS];
+};
+
+// channel i belongs to camera g_keys[i] - 2, 0 marks a free channel
+Channel g_channels[EVO_INSTR_MAX_CHANNELS];
+std::atomic<long long> g_keys[EVO_INSTR_MAX_CHANNELS];
+
+Channel* channel(long long camId)
+{
+  const long long key = camId + 2;
+  for(int i = 0; i < EVO_INSTR_MAX_CHANNELS; i++)
+  {
+    long long k = g_keys[i].load(std::memory_order_acquire);
+    if(k == 0 && g_keys[i].compare_exchange_strong(k, key, std::memory_order_acq_rel)) return &g_channels[i];
+    if(k == key) return &g_channels[i];
+  }
+  return nullptr;
+}
+
+unsigned int channelCount()
+{
+  unsigned int n = 0;
+  while(n < EVO_INSTR_MAX_CHANNELS && g_keys[n].load(std::memory_order_acquire) != 0) n++;
+  return n;
+}
+
+/**
+ * @param[in] metadata filled by call, NULL for accessors not returning a frame
+ */
+template<typename Call>
+int timed(long long camId, const EvoIRFrameMetadata* metadata, Call call)
+{
+  const unsigned long long t0 = ticks();
+  const int ret               = call();
+  const unsigned long long t1 = ticks();
+  Channel* c = channel(camId);
+  if(c)
+  {
+    const double valuesPerTick = g_valuesPerTick.load(std::memory_order_relaxed);
+    c->record((long long)((double)(t1 - t0) * valuesPerTick), ret == 0, (long long)((double)t1 * valuesPerTick), metadata);
+  }
+  return ret;
+}
+
+const char* const METRIC_NAMES[EVO_INSTR_METRICS] = { "call", "skew", "interval", "jitter", "flag" };
+
+void append(std::string& out, const char* format, ...)
+{
+  char line[512];
+  va_list args;
+  va_start(args, format);
+  const int n = vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+  if(n > 0) out.append(line, (size_t)n < sizeof(line) ? (size_t)n : sizeof(line) - 1);
+}
+
+std::string dump(int format)
+{
+  std::string out;
+  const unsigned int n = channelCount();
+  if(format == EVO_INSTR_JSON)
+  {
+    const long long now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    append(out, "{\"time\":%.3f,\"channels\":[", now * 1e-3);
+  }
+  for(unsigned int i = 0; i < n; i++)
+  {
+    EvoIRInstrChannelStats s;
+    s.camId = (int)(g_keys[i].load(std::memory_order_acquire) - 2);
+    g_channels[i].stats(&s);
+    if(format == EVO_INSTR_JSON)
+    {
+      append(out, "%s{\"camId\":%d,\"calls\":%llu,\"failed\":%llu,\"skipped\":%llu,\"frames\":%llu,\"framesDropped\":%llu,\"gaps\":%llu,\"flagTime\":%.6f,\"flagPeriods\":%llu",
+             i ? "," : "", s.camId, s.calls, s.failed, s.skipped, s.frames, s.framesDropped, s.gaps, s.flagTime, s.flagPeriods);
+      for(int m = 0; m < EVO_INSTR_METRICS; m++)
+      {
+        const EvoIRInstrSummary& h = s.metrics[m];
+        append(out, ",\"%s\":{\"count\":%llu,\"min\":%.3f,\"mean\":%.3f,\"p50\":%.3f,\"p90\":%.3f,\"p99\":%.3f,\"p999\":%.3f,\"max\":%.3f}",
+               METRIC_NAMES[m], h.count, h.min, h.mean, h.p50, h.p90, h.p99, h.p999, h.max);
+      }
+      out += "}";
+    }
+    else
+    {
+      append(out, "camera %d: %llu calls (%llu failed, %llu not recorded), %llu frames, %llu dropped in %llu gaps, flag closed %.3f s in %llu periods\n",
+             s.camId, s.calls, s.failed, s.skipped, s.frames, s.framesDropped, s.gaps, s.flagTime, s.flagPeriods);
+      append(out, "  %-10s %10s %10s %10s %10s %10s %10s %10s %10s\n", "[us]", "count", "min", "mean", "p50", "p90", "p99", "p99.9", "max");
+      for(int m = 0; m < EVO_INSTR_METRICS; m++)
+      {
+        const EvoIRInstrSummary& h = s.metrics[m];
+        append(out, "  %-10s %10llu %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+               METRIC_NAMES[m], h.count, h.min, h.mean, h.p50, h.p90, h.p99, h.p999, h.max);
+      }
+    }
+  }
+  if(format == EVO_INSTR_JSON) out += "]}\n";
+  return out;
+}
+
+/**
+ * Periodic dump to a file or standard output
+ */
+class Dumper
+{
+public:
+  Dumper() : _file(nullptr), _running(false) {}
+
+  bool start(const char* path, int format, float interval)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(_running) return false;
+    _file = path ? std::fopen(path, "a") : stdout;
+    if(!_file) return false;
+    _format   = format;
+    _interval = std::chrono::microseconds((long long)(interval * 1e6));
+    _running  = true;
+    _thread   = std::thread(&Dumper::loop, this);
+    return true;
+  }
+
+  bool stop()
+  {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if(!_running) return false;
+      _running = false;
+      _cond.notify_all();
+    }
+    _thread.join();
+    // the last interval would otherwise be lost
+    std::fputs(dump(_format).c_str(), _file);
+    if(_file != stdout) std::fclose(_file);
+    else std::fflush(_file);
+    _file = nullptr;
+    return true;
+  }
+
+private:
+  void loop()
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now() + _interval;
+    while(_running)
+    {
+      if(_cond.wait_until(lock, next) != std::cv_status::timeout) continue;
+      next += _interval;
+      const std::string text = dump(_format);
+      std::fputs(text.c_str(), _file);
+      std::fflush(_file);
+    }
+  }
+
+  std::mutex _mutex;
+  std::condition_variable _cond;
+  std::thread _thread;
+  std::FILE* _file;
+  int _format;
+  std::chrono::microseconds _interval;
+  bool _running;
+};
+
+Dumper g_dumper;
+
+} // namespace
+
+} // namespace evo
+
+using namespace evo;
+
+void evo_irimager_instr_enable(int enable)
+{
+  static std::once_flag calibrated;
+  if(enable) std::call_once(calibrated, calibrate);
+  g_enabled.store(enable != 0, std::memory_order_relaxed);
+}
+
+void evo_irimager_instr_reset()
+{
+  for(unsigned int i = 0; i < channelCount(); i++)
+    g_channels[i].reset();
+}
+
+int evo_irimager_instr_get_channel_count(unsigned int* count)
+{
+  if(!count) return -1;
+  *count = channelCount();
+  return 0;
+}
+
+int evo_irimager_instr_get_channel_stats(unsigned int index, EvoIRInstrChannelStats* stats)
+{
+  if(!stats || index >= channelCount()) return -1;
+  stats->camId = (int)(g_keys[index].load(std::memory_order_acquire) - 2);
+  g_channels[index].stats(stats);
+  return 0;
+}
+
+int evo_irimager_instr_get_histogram(unsigned int index, int metric, unsigned long long* counts, double* lowerBounds, unsigned int* bins)
+{
+  if(!bins || index >= channelCount() || metric < 0 || metric >= EVO_INSTR_METRICS) return -1;
+  const unsigned int capacity = *bins;
+  *bins = LogHistogram::BUCKETS;
+  if((counts || lowerBounds) && capacity < (unsigned int)LogHistogram::BUCKETS) return -1;
+  if(counts) g_channels[index].metric(metric).snapshot(counts);
+  if(lowerBounds)
+    for(int i = 0; i < LogHistogram::BUCKETS; i++)
+      lowerBounds[i] = LogHistogram::toMicroseconds((double)LogHistogram::lowerBound(i));
+  return 0;
+}
+
+int evo_irimager_instr_dump(int format, char* buffer, unsigned int* size)
+{
+  if(!size || (format != EVO_INSTR_TEXT && format != EVO_INSTR_JSON)) return -1;
+  const std::string text = dump(format);
+  const unsigned int capacity = *size;
+  *size = (unsigned int)text.size() + 1;
+  if(!buffer || capacity < *size) return -1;
+  std::memcpy(buffer, text.c_str(), *size);
+  return 0;
+}
+
+int evo_irimager_instr_start_dump(const char* path, int format, float interval)
+{
+  if((format != EVO_INSTR_TEXT && format != EVO_INSTR_JSON) || !(interval > 0.f)) return -1;
+  return g_dumper.start(path, format, interval) ? 0 : -1;
+}
+
+int evo_irimager_instr_stop_dump()
+{
+  return g_dumper.stop() ? 0 : -1;
+}
+
+int evo_irimager_instr_get_serial(unsigned long* serial)
+{
+  if(!g_enabled.load(std::memory_order_relaxed)) return evo_irimager_get_serial(serial);
+  return timed(SINGLE_CAMERA, NULL, [&]() { return evo_irimager_get_serial(serial); });
+}
+
+int evo_irimager_instr_multi_get_serial(const unsigned int camId, unsigned long* serial)
+{
+  if(!g_enabled.load(std::memory_order_relaxed)) return evo_irimager_multi_get_serial(camId, serial);
+  return timed(camId, NULL, [&]() { return evo_irimager_multi_get_serial(camId, serial); });
+}
+
+int evo_irimager_instr_get_thermal_image_size(int* w, int* h)
+{
+  if(!g_enabled.load(std::memory_order_relaxed)) return evo_irimager_get_thermal_image_size(w, h);
+  return timed(SINGLE_CAMERA, NULL, [&]() { return evo_irimager_get_thermal_image_size(w, h); });
+}
+
+int evo_irimager_instr_multi_get_thermal_image_size(const unsigned int camId, int* w, int* h)
+{
+  if(!g_enabled.load(std::memory_order_relaxed)) return evo_irimager_multi_get_thermal_image_size(camId, w, h);
+  return timed(camId, NULL, [&]() { return evo_irimager_multi_get_thermal_image_size(camId, w, h); });
+}
+
+int evo_irimager_instr_get_palette_image_size(int* w, int* h)
+{
+  if(!g_enabled.load(std::memory_order_relaxed)) return evo_irimager_get_palette_image_size(w, h);
+  return timed(SINGLE_CAMERA, NULL, [&]() { return evo_irimager_get_palette_image_size(w, h); });
+}
+
+int evo_irimager_instr_multi_get_palette_image_size(const unsigned int camId, int* w, int* h)
+{
+  if(!g_enabled.load(std::memory_order_relaxed)) return evo_irimager_multi_get_palette_image_size(camId, w, h);
+  return timed(camId, NULL, [&]() { return evo_irimager_multi_get_palette_image_size(camId, w, h); });
+}
+
+int evo_irimager_instr_get_thermal_image(int* w, int* h, unsigned short* data)
+{
+  if(!g_enabled.load(std::memory_order_relaxed)) return evo_irimager_get_thermal_image(w, h, data);
+  EvoIRFrameMetadata metadata;
+  return timed(SINGLE_CAMERA, &metadata, [&]() { return evo_irimager_get_thermal_image_metadata(w, h, data, &metadata); });
+}
+
+int evo_irimager_instr_multi_get_thermal_image(const unsigned int camId, int* w, int* h, unsigned short* data)
+{
+  if(!g_enabled.load(std::memory_order_relaxed)) return evo_irimager_multi_get_thermal_image(camId, w, h, data);
+  EvoIRFrameMetadata metadata;
+  return timed(camId, &metadata, [&]() { return evo_irimager_multi_get_thermal_image_metadata(camId, w, h, data, &metadata); });
+}
+
+int evo_irimager_instr_get_thermal_image_metadata(int* w, int* h, unsigned short* data, EvoIRFrameMetadata* metadata)
+{
+  if(!g_enabled.load(std::memory_order_relaxed) || !metadata) return evo_irimager_get_thermal_image_metadata(w, h, data, metadata);
+  return timed(SINGLE_CAMERA, metadata, [&]() { return evo_irimager_get_thermal_image_metadata(w, h, data, metadata); });
+}
+
+int evo_irimager_instr_multi_get_thermal_image_metadata(const unsigned int camId, int* w, int* h, unsigned short* data, EvoIRFrameMetadata* metadata)
+{
+  if(!g_enabled.load(std::memory_order_relaxed) || !metadata) return evo_irimager_multi_get_thermal_image_metadata(camId, w, h, data, metadata);
+  return timed(camId, metadata, [&]() { return evo_irimager_multi_get_thermal_image_metadata(camId, w, h, data, metadata); });
+}
+
+int evo_irimager_instr_get_palette_image(int* w, int* h, unsigned char* data)
+{
+  if(!g_enabled.load(std::memory_order_relaxed)) return evo_irimager_get_palette_image(w, h, data);
+  EvoIRFrameMetadata metadata;
+  return timed(SINGLE_CAMERA, &metadata, [&]() { return evo_irimager_get_palette_image_metadata(w, h, data, &metadata); });
+}
+
+int evo_irimager_instr_multi_get_palette_image(const unsigned int camId, int* w, int* h, unsigned char* data)
+{
+  if(!g_enabled.load(std::memory_order_relaxed)) return evo_irimager_multi_get_palette_image(camId, w, h, data);
+  EvoIRFrameMetadata metadata;
+  return timed(camId, &metadata, [&]() { return evo_irimager_multi_get_palette_image_metadata(camId, w, h, data, &metadata); });
+}
+
+int evo_irimager_instr_get_palette_image_metadata(int* w, int* h, unsigned char* data, EvoIRFrameMetadata* metadata)
+{
+  if(!g_enabled.load(std::memory_order_relaxed) || !metadata) return evo_irimager_get_palette_image_metadata(w, h, data, metadata);
+  return timed(SINGLE_CAMERA, metadata, [&]() { return evo_irimager_get_palette_image_metadata(w, h, data, metadata); });
+}
+
+int evo_irimager_instr_multi_get_palette_image_metadata(const unsigned int camId, int* w, int* h, unsigned char* data, EvoIRFrameMetadata* metadata)
+{
+  if(!g_enabled.load(std::memory_order_relaxed) || !metadata) return evo_irimager_multi_get_palette_image_metadata(camId, w, h, data, metadata);
+  return timed(camId, metadata, [&]() { return evo_irimager_multi_get_palette_image_metadata(camId, w, h, data, metadata); });
+}
+
+int evo_irimager_instr_get_thermal_palette_image(int w_t, int h_t, unsigned short* data_t, int w_p, int h_p, unsigned char* data_p)
+{
+  if(!g_enabled.load(std::memory_order_relaxed)) return evo_irimager_get_thermal_palette_image(w_t, h_t, data_t, w_p, h_p, data_p);
+  EvoIRFrameMetadata metadata;
+  return timed(SINGLE_CAMERA, &metadata, [&]() { return evo_irimager_get_thermal_palette_image_metadata(w_t, h_t, data_t, w_p, h_p, data_p, &metadata); });
+}
+
+int evo_irimager_instr_multi_get_thermal_palette_image(const unsigned int camId, int w_t, int h_t, unsigned short* data_t, int w_p, int h_p, unsigned char* data_p)
+{
+  if(!g_enabled.load(std::memory_order_relaxed)) return evo_irimager_multi_get_thermal_palette_image(camId, w_t, h_t, data_t, w_p, h_p, data_p);
+  EvoIRFrameMetadata metadata;
+  return timed(camId, &metadata, [&]() { return evo_irimager_multi_get_thermal_palette_image_metadata(camId, w_t, h_t, data_t, w_p, h_p, data_p, &metadata); });
+}
+
+int evo_irimager_instr_get_thermal_palette_image_metadata(int w_t, int h_t, unsigned short* data_t, int w_p, int h_p, unsigned char* data_p, EvoIRFrameMetadata* metadata)
+{
+  if(!g_enabled.load(std::memory_order_relaxed) || !metadata) return evo_irimager_get_thermal_palette_image_metadata(w_t, h_t, data_t, w_p, h_p, data_p, metadata);
+  return timed(SINGLE_CAMERA, metadata, [&]() { return evo_irimager_get_thermal_palette_image_metadata(w_t, h_t, data_t, w_p, h_p, data_p, metadata); });
+}
+
+int evo_irimager_instr_multi_get_thermal_palette_image_metadata(const unsigned int camId, int w_t, int h_t, unsigned short* data_t, int w_p, int h_p, unsigned char* data_p, EvoIRFrameMetadata* metadata)
+{
+  if(!g_enabled.load(std::memory_order_relaxed) || !metadata) return evo_irimager_multi_get_thermal_palette_image_metadata(camId, w_t, h_t, data_t, w_p, h_p, data_p, metadata);
+  return timed(camId, metadata, [&]() { return evo_irimager_multi_get_thermal_palette_image_metadata(camId, w_t, h_t, data_t, w_p, h_p, data_p, metadata); });
+}
+
+int evo_irimager_instr_get_focusmotor_pos(float* posOut)
+{
+  if(!g_enabled.load(std::memory_order_relaxed)) return evo_irimager_get_focusmotor_pos(posOut);
+  return timed(SINGLE_CAMERA, NULL, [&]() { return evo_irimager_get_focusmotor_pos(posOut); });
+}
+
+int evo_irimager_instr_multi_get_focusmotor_pos(const unsigned int camId, float* posOut)
+{
+  if(!g_enabled.load(std::memory_order_relaxed)) return evo_irimager_multi_get_focusmotor_pos(camId, posOut);
+  return timed(camId, NULL, [&]() { return evo_irimager_multi_get_focusmotor_pos(camId, posOut); });
+}
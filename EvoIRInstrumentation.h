@@ -0,0 +1,207 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRInstrumentation.h
+ * @brief Provides timing instrumentation of the accessors for Easy API C-Library Interface
+ *
+ * Every evo_irimager_*get* accessor of direct_binding.h has an instrumented
+ * twin with the same signature, named evo_irimager_instr_* instead of
+ * evo_irimager_*. Define EVO_IR_INSTRUMENT_BINDING before including this
+ * header to redirect all calls of a translation unit to the twins without
+ * touching the call sites.
+ *
+ * While enabled (evo_irimager_instr_enable), the twins record per camera:
+ * - duration of every call
+ * - skew: arrival time on the host minus EvoIRFrameMetadata::timestamp,
+ *   relative to the smallest difference seen since reset, i.e. the delay
+ *   of a frame beyond the fastest delivery
+ * - arrival interval on the host and its jitter, the deviation from the
+ *   interval of the device timestamps
+ * - counter gaps, frames lost between device and caller
+ * - time spent with the shutter flag in irFlagClose / irFlagClosing and the
+ *   duration of each of these periods
+ * Image accessors without metadata are served by their *_metadata
+ * counterpart, so they are measured the same way.
+ *
+ * Histograms are lock-free (see EvoIRLogHistogram.h) with a relative error
+ * below 1/16. Disabled twins only add one relaxed atomic load. Enabling
+ * recording the first time takes 20 ms to calibrate the time stamp counter
+ * used for timing on x86 processors.
+ */
+
+#ifndef EVOIRINSTRUMENTATION_H_
+#define EVOIRINSTRUMENTATION_H_
+
+#include "irdirectsdk_defs.h"
+#include "EvoIRFrameMetadata.h"
+
+#define EVO_INSTR_MAX_CHANNELS 16
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Measured quantities, index of EvoIRInstrChannelStats::metrics
+ */
+typedef enum
+{
+  EVO_INSTR_CALL     = 0, /*!< Duration of accessor calls */
+  EVO_INSTR_SKEW     = 1, /*!< Host arrival minus device timestamp, relative to the minimum */
+  EVO_INSTR_INTERVAL = 2, /*!< Time between two frames arriving on the host */
+  EVO_INSTR_JITTER   = 3, /*!< Absolute difference between host and device frame interval */
+  EVO_INSTR_FLAG     = 4, /*!< Duration of periods with the shutter flag closing or closed */
+  EVO_INSTR_METRICS  = 5
+} EvoIRInstrMetric;
+
+/**
+ * @brief Format of evo_irimager_instr_dump
+ */
+typedef enum
+{
+  EVO_INSTR_TEXT = 0, /*!< Table per camera */
+  EVO_INSTR_JSON = 1  /*!< One JSON object in a single line */
+} EvoIRInstrFormat;
+
+typedef struct __IRDIRECTSDK_API__ EvoIRInstrSummary
+{
+  unsigned long long count; /*!< Number of samples */
+  double min;               /*!< Minimum in microseconds */
+  double mean;              /*!< Mean in microseconds */
+  double p50;               /*!< Median in microseconds */
+  double p90;               /*!< 90th percentile in microseconds */
+  double p99;               /*!< 99th percentile in microseconds */
+  double p999;              /*!< 99.9th percentile in microseconds */
+  double max;               /*!< Maximum in microseconds */
+} EvoIRInstrSummary;
+
+typedef struct __IRDIRECTSDK_API__ EvoIRInstrChannelStats
+{
+  int camId;                                   /*!< Camera instance id, -1 for the single camera interface */
+  unsigned long long calls;                    /*!< Accessor calls */
+  unsigned long long failed;                   /*!< Accessor calls not returning 0 */
+  unsigned long long skipped;                  /*!< Calls not recorded since another thread was recording for the same camera */
+  unsigned long long frames;                   /*!< Frames received */
+  unsigned long long framesDropped;            /*!< Frames missing in EvoIRFrameMetadata::counter */
+  unsigned long long gaps;                     /*!< Number of counter gaps */
+  double flagTime;                             /*!< Seconds with the shutter flag closing or closed */
+  unsigned long long flagPeriods;              /*!< Number of periods with the shutter flag closing or closed */
+  EvoIRInstrSummary metrics[EVO_INSTR_METRICS];/*!< Histogram summaries, see EvoIRInstrMetric */
+} EvoIRInstrChannelStats;
+
+/**
+ * @brief Enables or disables recording, disabled by default
+ * @param[in] enable 1 to enable, 0 to disable
+ */
+__IRDIRECTSDK_API__ void evo_irimager_instr_enable(int enable);
+
+/**
+ * @brief Clears all counters and histograms
+ */
+__IRDIRECTSDK_API__ void evo_irimager_instr_reset();
+
+/**
+ * @brief Accessor to the number of cameras seen so far
+ * @param[out] count number of channels
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_instr_get_channel_count(unsigned int* count);
+
+/**
+ * @brief Snapshot of the counters and histogram summaries of one camera
+ * @param[in] index channel index [0; count)
+ * @param[out] stats pointer to EvoIRInstrChannelStats allocate by the user
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_instr_get_channel_stats(unsigned int index, EvoIRInstrChannelStats* stats);
+
+/**
+ * @brief Snapshot of a complete histogram
+ * @param[in] index channel index [0; count)
+ * @param[in] metric see EvoIRInstrMetric
+ * @param[out] counts pointer to unsigned long long array allocate by the user (size of *bins), may be NULL to query the size
+ * @param[out] lowerBounds pointer to double array allocate by the user (size of *bins), lower bucket bounds in microseconds, may be NULL
+ * @param[in,out] bins capacity of the arrays, set to the number of buckets
+ * @return 0 on success, -1 on error (capacity too small)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_instr_get_histogram(unsigned int index, int metric, unsigned long long* counts, double* lowerBounds, unsigned int* bins);
+
+/**
+ * @brief Formats the statistics of all cameras
+ * @param[in] format see EvoIRInstrFormat
+ * @param[out] buffer pointer to char array allocate by the user, zero terminated
+ * @param[in,out] size capacity of buffer, set to the size needed including the terminator
+ * @return 0 on success, -1 on error (capacity too small)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_instr_dump(int format, char* buffer, unsigned int* size);
+
+/**
+ * @brief Starts a thread appending a dump to a file periodically
+ * @param[in] path file to append to, NULL for standard output
+ * @param[in] format see EvoIRInstrFormat, JSON dumps are written as one line each
+ * @param[in] interval seconds between two dumps
+ * @return 0 on success, -1 on error (file not writable, already running)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_instr_start_dump(const char* path, int format, float interval);
+
+/**
+ * @brief Stops the periodic dump
+ * @return 0 on success, -1 on error (not running)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_instr_stop_dump();
+
+/* Instrumented twins of the accessors of direct_binding.h, see there */
+__IRDIRECTSDK_API__ int evo_irimager_instr_get_serial(unsigned long* serial);
+__IRDIRECTSDK_API__ int evo_irimager_instr_multi_get_serial(const unsigned int camId, unsigned long* serial);
+__IRDIRECTSDK_API__ int evo_irimager_instr_get_thermal_image_size(int* w, int* h);
+__IRDIRECTSDK_API__ int evo_irimager_instr_multi_get_thermal_image_size(const unsigned int camId, int* w, int* h);
+__IRDIRECTSDK_API__ int evo_irimager_instr_get_palette_image_size(int* w, int* h);
+__IRDIRECTSDK_API__ int evo_irimager_instr_multi_get_palette_image_size(const unsigned int camId, int* w, int* h);
+__IRDIRECTSDK_API__ int evo_irimager_instr_get_thermal_image(int* w, int* h, unsigned short* data);
+__IRDIRECTSDK_API__ int evo_irimager_instr_multi_get_thermal_image(const unsigned int camId, int* w, int* h, unsigned short* data);
+__IRDIRECTSDK_API__ int evo_irimager_instr_get_thermal_image_metadata(int* w, int* h, unsigned short* data, EvoIRFrameMetadata* metadata);
+__IRDIRECTSDK_API__ int evo_irimager_instr_multi_get_thermal_image_metadata(const unsigned int camId, int* w, int* h, unsigned short* data, EvoIRFrameMetadata* metadata);
+__IRDIRECTSDK_API__ int evo_irimager_instr_get_palette_image(int* w, int* h, unsigned char* data);
+__IRDIRECTSDK_API__ int evo_irimager_instr_multi_get_palette_image(const unsigned int camId, int* w, int* h, unsigned char* data);
+__IRDIRECTSDK_API__ int evo_irimager_instr_get_palette_image_metadata(int* w, int* h, unsigned char* data, EvoIRFrameMetadata* metadata);
+__IRDIRECTSDK_API__ int evo_irimager_instr_multi_get_palette_image_metadata(const unsigned int camId, int* w, int* h, unsigned char* data, EvoIRFrameMetadata* metadata);
+__IRDIRECTSDK_API__ int evo_irimager_instr_get_thermal_palette_image(int w_t, int h_t, unsigned short* data_t, int w_p, int h_p, unsigned char* data_p);
+__IRDIRECTSDK_API__ int evo_irimager_instr_multi_get_thermal_palette_image(const unsigned int camId, int w_t, int h_t, unsigned short* data_t, int w_p, int h_p, unsigned char* data_p);
+__IRDIRECTSDK_API__ int evo_irimager_instr_get_thermal_palette_image_metadata(int w_t, int h_t, unsigned short* data_t, int w_p, int h_p, unsigned char* data_p, EvoIRFrameMetadata* metadata);
+__IRDIRECTSDK_API__ int evo_irimager_instr_multi_get_thermal_palette_image_metadata(const unsigned int camId, int w_t, int h_t, unsigned short* data_t, int w_p, int h_p, unsigned char* data_p, EvoIRFrameMetadata* metadata);
+__IRDIRECTSDK_API__ int evo_irimager_instr_get_focusmotor_pos(float* posOut);
+__IRDIRECTSDK_API__ int evo_irimager_instr_multi_get_focusmotor_pos(const unsigned int camId, float* posOut);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#ifdef EVO_IR_INSTRUMENT_BINDING
+#   define evo_irimager_get_serial                                  evo_irimager_instr_get_serial
+#   define evo_irimager_multi_get_serial                            evo_irimager_instr_multi_get_serial
+#   define evo_irimager_get_thermal_image_size                      evo_irimager_instr_get_thermal_image_size
+#   define evo_irimager_multi_get_thermal_image_size                evo_irimager_instr_multi_get_thermal_image_size
+#   define evo_irimager_get_palette_image_size                      evo_irimager_instr_get_palette_image_size
+#   define evo_irimager_multi_get_palette_image_size                evo_irimager_instr_multi_get_palette_image_size
+#   define evo_irimager_get_thermal_image                           evo_irimager_instr_get_thermal_image
+#   define evo_irimager_multi_get_thermal_image                     evo_irimager_instr_multi_get_thermal_image
+#   define evo_irimager_get_thermal_image_metadata                  evo_irimager_instr_get_thermal_image_metadata
+#   define evo_irimager_multi_get_thermal_image_metadata            evo_irimager_instr_multi_get_thermal_image_metadata
+#   define evo_irimager_get_palette_image                           evo_irimager_instr_get_palette_image
+#   define evo_irimager_multi_get_palette_image                     evo_irimager_instr_multi_get_palette_image
+#   define evo_irimager_get_palette_image_metadata                  evo_irimager_instr_get_palette_image_metadata
+#   define evo_irimager_multi_get_palette_image_metadata            evo_irimager_instr_multi_get_palette_image_metadata
+#   define evo_irimager_get_thermal_palette_image                   evo_irimager_instr_get_thermal_palette_image
+#   define evo_irimager_multi_get_thermal_palette_image             evo_irimager_instr_multi_get_thermal_palette_image
+#   define evo_irimager_get_thermal_palette_image_metadata          evo_irimager_instr_get_thermal_palette_image_metadata
+#   define evo_irimager_multi_get_thermal_palette_image_metadata    evo_irimager_instr_multi_get_thermal_palette_image_metadata
+#   define evo_irimager_get_focusmotor_pos                          evo_irimager_instr_get_focusmotor_pos
+#   define evo_irimager_multi_get_focusmotor_pos                    evo_irimager_instr_multi_get_focusmotor_pos
+#endif
+
+#endif /* EVOIRINSTRUMENTATION_H_ */
@@ -0,0 +1,228 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRLogHistogram.h
+ * @brief Lock-free log-linear histogram behind EvoIRHistogram and the instrumentation
+ *
+ * Internal header, only used by the implementation files of the Easy API
+ * extensions.
+ */
+
+#ifndef EVOIRLOGHISTOGRAM_H_
+#define EVOIRLOGHISTOGRAM_H_
+
+#include "EvoIRHistogram.h"
+
+#include <atomic>
+#include <chrono>
+
+namespace evo
+{
+
+/**
+ * @brief Host time in UNITS (10000000 per second)
+ */
+inline long long hostTime()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+           std::chrono::steady_clock::now().time_since_epoch()).count() * 10LL;
+}
+
+/**
+ * @brief Histogram of durations with bounded relative error
+ *
+ * Values are kept in 1/1024 microseconds. Values below 32 get a bucket each.
+ * Above, every power of two is split into 16 linear buckets, so a bucket is
+ * at most 1/16 of its lower bound wide (HdrHistogram with 5 bits of
+ * sub-bucket resolution). Powers of two microseconds are bucket borders,
+ * which makes the bins of EvoIRHistogram exact sums of buckets. Snapshots can
+ * be taken while recording. record() may be called from any number of
+ * threads; recordExclusive() avoids the locked read-modify-write instructions
+ * but requires the caller to be the only writer.
+ */
+class LogHistogram
+{
+public:
+  static const int SUB_BUCKETS   = 16;
+  static const int VALUE_BITS    = 40;
+  static const int BUCKETS       = (VALUE_BITS - 3) * SUB_BUCKETS;
+  static const int FRACTION_BITS = 10;
+  static const unsigned long long MAX_VALUE = (1ULL << VALUE_BITS) - 1;
+
+  LogHistogram()
+  {
+    reset();
+  }
+
+  /**
+   * @brief Value of a duration in UNITS (100 ns)
+   */
+  static unsigned long long fromUnits(long long units)
+  {
+    return units > 0 ? (unsigned long long)units * 512 / 5 : 0;
+  }
+
+  /**
+   * @brief Value of a duration in nanoseconds
+   */
+  static unsigned long long fromNanoseconds(long long ns)
+  {
+    return ns > 0 ? (unsigned long long)ns * 128 / 125 : 0;
+  }
+
+  static double toMicroseconds(double value)
+  {
+    return value / (1 << FRACTION_BITS);
+  }
+
+  static int bucket(unsigned long long v)
+  {
+    if(v > MAX_VALUE) v = MAX_VALUE;
+    if(v < 2 * SUB_BUCKETS) return (int)v;
+    const int shift = msb(v) - 4;
+    return shift * SUB_BUCKETS + (int)(v >> shift);
+  }
+
+  static unsigned long long lowerBound(int bucket)
+  {
+    if(bucket < 2 * SUB_BUCKETS) return (unsigned long long)bucket;
+    const int shift = bucket / SUB_BUCKETS - 1;
+    return (unsigned long long)(bucket % SUB_BUCKETS + SUB_BUCKETS) << shift;
+  }
+
+  static unsigned long long upperBound(int bucket)
+  {
+    return bucket + 1 < BUCKETS ? lowerBound(bucket + 1) - 1 : MAX_VALUE;
+  }
+
+  /**
+   * @brief Records a duration in UNITS
+   */
+  void record(long long units)
+  {
+    recordValue(fromUnits(units));
+  }
+
+  void recordValue(unsigned long long v)
+  {
+    _counts[bucket(v)].fetch_add(1, std::memory_order_relaxed);
+    _count.fetch_add(1, std::memory_order_relaxed);
+    _sum.fetch_add(v, std::memory_order_relaxed);
+    unsigned long long m = _max.load(std::memory_order_relaxed);
+    while(v > m && !_max.compare_exchange_weak(m, v, std::memory_order_relaxed)) {}
+    m = _min.load(std::memory_order_relaxed);
+    while(v < m && !_min.compare_exchange_weak(m, v, std::memory_order_relaxed)) {}
+  }
+
+  void recordExclusive(unsigned long long v)
+  {
+    std::atomic<unsigned long long>& c = _counts[bucket(v)];
+    c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    _count.store(_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    _sum.store(_sum.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+    if(v > _max.load(std::memory_order_relaxed)) _max.store(v, std::memory_order_relaxed);
+    if(v < _min.load(std::memory_order_relaxed)) _min.store(v, std::memory_order_relaxed);
+  }
+
+  void reset()
+  {
+    for(int i = 0; i < BUCKETS; i++)
+      _counts[i].store(0, std::memory_order_relaxed);
+    _count.store(0, std::memory_order_relaxed);
+    _sum.store(0, std::memory_order_relaxed);
+    _min.store(~0ULL, std::memory_order_relaxed);
+    _max.store(0, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Copies the bucket counts, returns their total
+   */
+  unsigned long long snapshot(unsigned long long* counts) const
+  {
+    unsigned long long total = 0;
+    for(int i = 0; i < BUCKETS; i++)
+    {
+      counts[i] = _counts[i].load(std::memory_order_relaxed);
+      total    += counts[i];
+    }
+    return total;
+  }
+
+  /**
+   * @brief Folds the buckets into the power of two microsecond bins of EvoIRHistogram
+   */
+  void snapshot(EvoIRHistogram* h) const
+  {
+    for(int i = 0; i < EVO_HISTOGRAM_BINS; i++)
+      h->bins[i] = 0;
+    for(int i = 0; i < BUCKETS; i++)
+    {
+      const unsigned long long n = _counts[i].load(std::memory_order_relaxed);
+      if(n == 0) continue;
+      unsigned long long us = lowerBound(i) >> FRACTION_BITS;
+      int bin = 0;
+      while(us > 0 && bin < EVO_HISTOGRAM_BINS - 1)
+      {
+        us >>= 1;
+        bin++;
+      }
+      h->bins[bin] += n;
+    }
+    h->count = count();
+    h->mean  = h->count ? toMicroseconds((double)sum() / h->count) : 0.0;
+    h->max   = toMicroseconds((double)max());
+  }
+
+  unsigned long long count() const { return _count.load(std::memory_order_relaxed); }
+  unsigned long long sum() const   { return _sum.load(std::memory_order_relaxed); }
+  unsigned long long min() const   { return count() ? _min.load(std::memory_order_relaxed) : 0; }
+  unsigned long long max() const   { return _max.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief Value at quantile q [0; 1] of a snapshot, the middle of the bucket containing it
+   */
+  static double quantile(const unsigned long long* counts, unsigned long long total, double q)
+  {
+    if(total == 0) return 0.0;
+    unsigned long long rank = (unsigned long long)(q * (double)total + 0.5);
+    if(rank < 1) rank = 1;
+    if(rank > total) rank = total;
+    unsigned long long seen = 0;
+    for(int i = 0; i < BUCKETS; i++)
+    {
+      seen += counts[i];
+      if(seen >= rank) return 0.5 * ((double)lowerBound(i) + (double)upperBound(i));
+    }
+    return (double)MAX_VALUE;
+  }
+
+private:
+  static int msb(unsigned long long v)
+  {
+#if defined(__GNUC__)
+    return 63 - __builtin_clzll(v);
+#else
+    int b = 0;
+    while(v >>= 1) b++;
+    return b;
+#endif
+  }
+
+  LogHistogram(const LogHistogram&);
+  LogHistogram& operator=(const LogHistogram&);
+
+  std::atomic<unsigned long long> _counts[BUCKETS];
+  std::atomic<unsigned long long> _count;
+  std::atomic<unsigned long long> _sum;
+  std::atomic<unsigned long long> _min;
+  std::atomic<unsigned long long> _max;
+};
+
+} // namespace evo
+
+#endif /* EVOIRLOGHISTOGRAM_H_ */
@@ -0,0 +1,118 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRMappedFile.h
+ * @brief Read-only memory mapping of files for Windows and POSIX systems
+ *
+ * Internal header, only used by the implementation files of the Easy API
+ * extensions.
+ */
+
+#ifndef EVOIRMAPPEDFILE_H_
+#define EVOIRMAPPEDFILE_H_
+
+#ifdef _WIN32
+#   ifndef NOMINMAX
+#       define NOMINMAX
+#   endif
+#   include <windows.h>
+#else
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+
+namespace evo
+{
+
+class EvoIRMappedFile
+{
+public:
+  EvoIRMappedFile() : _data(nullptr), _size(0)
+  {
+#ifdef _WIN32
+    _file    = INVALID_HANDLE_VALUE;
+    _mapping = NULL;
+#else
+    _fd = -1;
+#endif
+  }
+
+  ~EvoIRMappedFile()
+  {
+    close();
+  }
+
+  /**
+   * @brief Maps a whole file read-only
+   * @return false if the file cannot be opened or is empty
+   */
+  bool open(const char* path)
+  {
+    close();
+#ifdef _WIN32
+    _file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(_file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(_file, &size) || size.QuadPart == 0) { close(); return false; }
+    _mapping = CreateFileMappingA(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if(_mapping == NULL) { close(); return false; }
+    _data = (const unsigned char*)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+    if(!_data) { close(); return false; }
+    _size = (unsigned long long)size.QuadPart;
+#else
+    _fd = ::open(path, O_RDONLY);
+    if(_fd < 0) return false;
+    struct stat st;
+    if(fstat(_fd, &st) != 0 || st.st_size == 0) { close(); return false; }
+    void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, _fd, 0);
+    if(p == MAP_FAILED) { close(); return false; }
+    _data = (const unsigned char*)p;
+    _size = (unsigned long long)st.st_size;
+#endif
+    return true;
+  }
+
+  void close()
+  {
+#ifdef _WIN32
+    if(_data) UnmapViewOfFile(_data);
+    if(_mapping != NULL) CloseHandle(_mapping);
+    if(_file != INVALID_HANDLE_VALUE) CloseHandle(_file);
+    _mapping = NULL;
+    _file    = INVALID_HANDLE_VALUE;
+#else
+    if(_data) munmap((void*)_data, (size_t)_size);
+    if(_fd >= 0) ::close(_fd);
+    _fd = -1;
+#endif
+    _data = nullptr;
+    _size = 0;
+  }
+
+  const unsigned char* data() const { return _data; }
+  unsigned long long size() const   { return _size; }
+
+private:
+  EvoIRMappedFile(const EvoIRMappedFile&);
+  EvoIRMappedFile& operator=(const EvoIRMappedFile&);
+
+  const unsigned char* _data;
+  unsigned long long _size;
+#ifdef _WIN32
+  HANDLE _file;
+  HANDLE _mapping;
+#else
+  int _fd;
+#endif
+};
+
+} // namespace evo
+
+#endif /* EVOIRMAPPEDFILE_H_ */
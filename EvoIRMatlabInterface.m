@@ -16,6 +16,10 @@
 % library, which is programmed in c. 
 % Please see the documentation of the libirimager for 
 % further information about the here applied functions. 
+% If the MEX gateway evo_irimager_mex is on the path (see
+% evo_irimager_mex_build.m), it is used instead of
+% loadlibrary/calllib. It returns images in MATLAB order
+% without copies, frame metadata and batches of frames.
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 % 负责与红外相机连接的接口文件
 
@@ -27,6 +31,7 @@ classdef EvoIRMatlabInterface
         headerPath
         configPath
 	isWindows
+        useMex
     end
     
     methods
@@ -62,6 +67,12 @@ classdef EvoIRMatlabInterface
                 disp('unsupported operating system');
             end
             
+            % prefer the compiled gateway, no header parsing needed
+            obj.useMex = exist('evo_irimager_mex', 'file') == 3;
+            if obj.useMex
+                return
+            end
+            
             % check if library is already loaded
             
             if libisloaded(obj.libName)
@@ -93,6 +104,18 @@ classdef EvoIRMatlabInterface
             disp('Connecting to device');
             disp('***************************');
             
+            if obj.useMex
+                isConnected = 0 == evo_irimager_mex('usb_init', obj.configPath);
+                if isConnected
+                    [g_evo_IR_thm_width, g_evo_IR_thm_height]         = evo_irimager_mex('get_thermal_image_size');
+                    [g_evo_IR_palette_width, g_evo_IR_palette_height] = evo_irimager_mex('get_palette_image_size');
+                    disp('Connected to device');
+                else
+                    disp('error at connecting...')
+                end
+                return
+            end
+            
             if 0 == calllib(obj.libName, 'evo_irimager_usb_init', obj.configPath, '', '')
                 % connected
                 disp('***************************');
@@ -158,12 +181,21 @@ classdef EvoIRMatlabInterface
         end
         
         %% Function to the the thm thermal data 
-        function THM =  get_thermal(obj) % evo_irimager_get_thermal_image_byref
+        function [THM, meta] =  get_thermal(obj) % evo_irimager_get_thermal_image_byref
         % set variables as global accessor
             global g_evo_IR_thm_width;
             global g_evo_IR_thm_height;
             global g_thmPtr;
             
+            meta = [];
+            if obj.useMex
+                [THM, meta, returnvalue] = evo_irimager_mex('get_thermal');
+                if returnvalue ~= 0
+                    disp('cannot get thermal image...')
+                end
+                return
+            end
+            
             % get thermal image
             returnvalue = calllib(obj.libName, ...
                 'evo_irimager_get_thermal_image', ...
@@ -186,12 +218,20 @@ classdef EvoIRMatlabInterface
         end
         
         %% Function to get the color palette image
-        function RGB =  get_palette(obj) % evo_irimager_get_palette_image_byref
+        function [RGB, meta] =  get_palette(obj) % evo_irimager_get_palette_image_byref
        % set variables as global accessor
             global g_evo_IR_palette_width;
             global g_evo_IR_palette_height;
             global g_palettePtr;
             
+            meta = [];
+            if obj.useMex
+                [RGB, meta, returnvalue] = evo_irimager_mex('get_palette');
+                if returnvalue ~= 0
+                    disp('cannot get palette image...')
+                end
+                return
+            end
             
             % get palette image (RGB)
             returnvalue = calllib(obj.libName, ...
@@ -223,8 +263,128 @@ classdef EvoIRMatlabInterface
             end
         end
         
+        %% Function to get thermal and palette image of the same frame
+        function [THM, RGB, meta] = get_thermal_palette(obj) % evo_irimager_get_thermal_palette_image
+            % set variables as global accessor
+            global g_evo_IR_thm_width;
+            global g_evo_IR_thm_height;
+            global g_evo_IR_palette_width;
+            global g_evo_IR_palette_height;
+            global g_thmPtr;
+            global g_palettePtr;
+            
+            THM  = [];
+            RGB  = [];
+            meta = [];
+            
+            if obj.useMex
+                [THM, RGB, meta, returnvalue] = evo_irimager_mex('get_thermal_palette');
+                if returnvalue ~= 0
+                    disp('cannot get thermal and palette image...')
+                end
+                return
+            end
+            
+            % one library call for both images instead of two frames
+            returnvalue = calllib(obj.libName, ...
+                'evo_irimager_get_thermal_palette_image', ...
+                g_evo_IR_thm_width,                       ...
+                g_evo_IR_thm_height,                      ...
+                g_thmPtr,                                 ...
+                g_evo_IR_palette_width,                   ...
+                g_evo_IR_palette_height,                  ...
+                g_palettePtr);
+            
+            if returnvalue ~= 0
+                disp('cannot get thermal and palette image...')
+                return
+            end
+            
+            % generate a matrix from the vector
+            THM = reshape(g_thmPtr.Value, [g_evo_IR_thm_width, ...
+                                           g_evo_IR_thm_height])';
+            
+            % interleaved vector as 3 x W x H, a single permute yields H x W x 3
+            RGB = permute(reshape(g_palettePtr.Value, [3, g_evo_IR_palette_width, ...
+                                                       g_evo_IR_palette_height]), [3 2 1]);
+            if obj.isWindows
+              RGB = RGB(:, :, [3 2 1]);
+            end
+        end
+        
+        %% Function to start acquisition on native threads (gateway only),
+        %  see EvoIRPipeline.h. Without the gateway get_frame grabs itself.
+        function isRunning = start_pipeline(obj)
+            isRunning = false;
+            if obj.useMex
+                isRunning = evo_irimager_mex('pipeline_start') == 0;
+                if ~isRunning
+                    disp('cannot start pipeline...')
+                end
+            end
+        end
+        
+        %% Function to get the most recent frame of the pipeline, frames
+        %  acquired while the caller was drawing are skipped. A pipeline
+        %  stopped by a single frame function (get_thermal, set_palette, ...)
+        %  is started again, start_pipeline has to succeed once before.
+        function [THM, RGB, meta] = get_frame(obj)
+            if ~obj.useMex
+                [THM, RGB, meta] = obj.get_thermal_palette();
+                return
+            end
+            [THM, RGB, meta, returnvalue] = evo_irimager_mex('pipeline_frame');
+            if returnvalue ~= 0
+                disp('cannot get frame of pipeline...')
+            end
+        end
+        
+        %% Function to get frame counters and mean timings per stage
+        function stats = get_pipeline_stats(obj)
+            stats = [];
+            if obj.useMex
+                stats = evo_irimager_mex('pipeline_stats');
+            end
+        end
+        
+        %% Function to stop the pipeline
+        function stop_pipeline(obj)
+            if obj.useMex
+                evo_irimager_mex('pipeline_stop');
+            end
+        end
+        
+        %% Function to grab n consecutive thermal images into a H x W x n stack
+        function [STACK, meta] = grab(obj, n)
+            if obj.useMex
+                [STACK, meta, returnvalue] = evo_irimager_mex('grab', n);
+                if returnvalue ~= 0
+                    disp('cannot get thermal image...')
+                end
+                return
+            end
+            
+            % without the gateway frame by frame, metadata is not available
+            meta  = [];
+            STACK = [];
+            for i = 1 : n
+                THM = obj.get_thermal();
+                if isempty(THM)
+                    return
+                end
+                if isempty(STACK)
+                    STACK = zeros([size(THM), n], 'uint16');
+                end
+                STACK(:, :, i) = THM;
+            end
+        end
+        
         %% function to set palette's color
         function set_palette_colormap(obj, palette_id)
+            if obj.useMex
+                evo_irimager_mex('set_palette', palette_id);
+                return
+            end
             calllib(obj.libName, ...
                     'evo_irimager_set_palette', ...
                     palette_id); 
@@ -232,6 +392,10 @@ classdef EvoIRMatlabInterface
         
         %% function to set palette's range
         function set_palette_scale(obj, scale_id)
+            if obj.useMex
+                evo_irimager_mex('set_palette_scale', scale_id);
+                return
+            end
             calllib(obj.libName, ...
                     'evo_irimager_set_palette_scale', ...
                     scale_id); 
@@ -239,14 +403,47 @@ classdef EvoIRMatlabInterface
         
         %% function to trigger shutter flag of camera
         function trigger_shutter_flag(obj)
+            if obj.useMex
+                evo_irimager_mex('trigger_shutter_flag');
+                return
+            end
             calllib(obj.libName, 'evo_irimager_trigger_shutter_flag'); 
         end
        
         %% Function to set temperature range
         function set_temperature_range(obj, min, max)
+            if obj.useMex
+                evo_irimager_mex('set_temperature_range', min, max);
+                return
+            end
             calllib(obj.libName, 'evo_irimager_set_temperature_range', min, max)
         end
         
+        %% Function to apply an edited configuration file without
+        %  terminate/connect where possible (gateway only), see EvoIRConfig.h
+        function report = apply_config(obj, xml)
+            global g_evo_IR_palette_width;
+            global g_evo_IR_palette_height;
+            global g_evo_IR_thm_width;
+            global g_evo_IR_thm_height;
+
+            report = [];
+            if ~obj.useMex
+                disp('apply_config needs evo_irimager_mex, use terminate and connect instead...')
+                return
+            end
+            [returnvalue, report] = evo_irimager_mex('apply_config', xml);
+            if returnvalue ~= 0
+                % a failed restart has already dropped the camera, sizes cannot be queried
+                disp('cannot apply configuration...')
+                return
+            end
+            if report.sizeChanged
+                [g_evo_IR_thm_width, g_evo_IR_thm_height]         = evo_irimager_mex('get_thermal_image_size');
+                [g_evo_IR_palette_width, g_evo_IR_palette_height] = evo_irimager_mex('get_palette_image_size');
+            end
+        end
+
         %% Default destructor
         function delete(obj)
             % clear memory and disconnect
@@ -258,6 +455,10 @@ classdef EvoIRMatlabInterface
         
         %% Function to terminate the connection
         function terminate(obj)
+            if obj.useMex
+                evo_irimager_mex('terminate');
+                return
+            end
             calllib(obj.libName, 'evo_irimager_terminate');
             pause(1);
         end
@@ -0,0 +1,638 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRMex.cpp
+ * @brief MEX gateway to the single camera functions of direct_binding.h
+ *
+ * Built as evo_irimager_mex by evo_irimager_mex_build.m. Replaces the
+ * loadlibrary/calllib path of EvoIRMatlabInterface: frames are written
+ * straight into freshly created mxArrays in MATLAB order, i.e. uint16 H x W
+ * thermal images and uint8 H x W x 3 RGB images, so no reshape, transpose or
+ * channel extraction is left to MATLAB. The library fills a row-major scratch
+ * buffer kept between calls, which is transposed into the result in cache
+ * sized tiles.
+ *
+ * Usage:
+ *   ret               = evo_irimager_mex('usb_init', xml [, formats_def, log_file])
+ *   ret               = evo_irimager_mex('tcp_init', ip, port)
+ *   ret               = evo_irimager_mex('terminate')
+ *   [w, h]            = evo_irimager_mex('get_thermal_image_size')
+ *   [w, h]            = evo_irimager_mex('get_palette_image_size')
+ *   [THM, meta, ret]  = evo_irimager_mex('get_thermal')
+ *   [RGB, meta, ret]  = evo_irimager_mex('get_palette')
+ *   [THM, RGB, meta, ret] = evo_irimager_mex('get_thermal_palette')
+ *   [THM, meta, ret]  = evo_irimager_mex('grab', n)
+ *   ret               = evo_irimager_mex('set_palette', id)
+ *   ret               = evo_irimager_mex('set_palette_scale', id)
+ *   ret               = evo_irimager_mex('set_palette_manual_temp_range', min, max)
+ *   ret               = evo_irimager_mex('set_temperature_range', min, max)
+ *   ret               = evo_irimager_mex('set_shutter_mode', mode)
+ *   ret               = evo_irimager_mex('trigger_shutter_flag')
+ *   [ret, report]     = evo_irimager_mex('apply_config', xml)
+ *   ret               = evo_irimager_mex('pipeline_start' [, queue_frames])
+ *   [THM, RGB, meta, ret] = evo_irimager_mex('pipeline_frame' [, timeout_ms])
+ *   stats             = evo_irimager_mex('pipeline_stats')
+ *   ret               = evo_irimager_mex('pipeline_stop')
+ *
+ * ret is the return value of the library function. On failure the image
+ * outputs are empty. meta is a struct with the fields of EvoIRFrameMetadata
+ * (timestamps as int64, temperatures as double); for 'grab' it holds 1 x n
+ * rows, one column per frame of the H x W x n image stack. A failing frame
+ * ends the batch, the stack then holds the frames grabbed before.
+ *
+ * apply_config applies an edited configuration file to the camera initialized
+ * by usb_init through the configuration manager (see EvoIRConfig.h), i.e. with
+ * runtime calls where possible. report holds restarted, sizeChanged, width,
+ * height, outage and per change type (1 x 8, order of EvoIRConfigChangeType)
+ * method and outage in seconds. The scratch buffers are only resized if the
+ * image size changed.
+ *
+ * pipeline_start moves acquisition to the threads of EvoIRPipeline.h: thermal
+ * and palette image are fetched with one call per frame while MATLAB draws.
+ * pipeline_frame returns the most recent frame (ret -3 if none arrived within
+ * timeout_ms, default 1000), frames converted in between are dropped as stale.
+ * stats holds frames, dropped, failed, wait and busy (mean in microseconds)
+ * per stage (1 x 3, order of EvoIRPipelineStage) and the mean latency.
+ * Single frame commands, the set_* commands, trigger_shutter_flag and
+ * apply_config stop a running pipeline first, the next pipeline_frame starts
+ * it again (ret -1 and empty images if that fails). Meanwhile pipeline_stats
+ * returns the statistics of the stopped run and pipeline_stop returns 0.
+ */
+
+#include "mex.h"
+#include "direct_binding.h"
+#include "EvoIRConfig.h"
+#include "EvoIRPipeline.h"
+
+#include <string>
+#include <vector>
+
+namespace evo
+{
+
+namespace
+{
+
+// edge of the tiles transposed at once, 32 x 32 x 2 bytes stay within L1 for source and destination
+const int TILE = 32;
+
+const char* const METADATA_FIELDS[] = { "counter", "counterHW", "timestamp", "timestampMedia", "flagState", "tempChip", "tempFlag", "tempBox" };
+const int METADATA_FIELD_COUNT      = sizeof(METADATA_FIELDS) / sizeof(METADATA_FIELDS[0]);
+
+const char* const REPORT_FIELDS[] = { "restarted", "sizeChanged", "width", "height", "outage", "method", "changeOutage" };
+const int REPORT_FIELD_COUNT      = sizeof(REPORT_FIELDS) / sizeof(REPORT_FIELDS[0]);
+
+const char* const STATS_FIELDS[] = { "frames", "dropped", "failed", "wait", "busy", "latency" };
+const int STATS_FIELD_COUNT      = sizeof(STATS_FIELDS) / sizeof(STATS_FIELDS[0]);
+
+struct Session
+{
+  bool connected;
+  bool configAttached;
+  unsigned int cfgId;
+  bool pipelineRunning;
+  bool pipelineSuspended;           // stopped by a single frame command, restarted by pipeline_frame
+  unsigned int pipelineQueueFrames;
+  unsigned int pipeId;
+  EvoIRPipelineStats pipelineStats; // of the pipeline before it was suspended
+  std::string xml;
+  std::string formats;
+  std::string log;
+  int thmWidth;
+  int thmHeight;
+  int paletteWidth;
+  int paletteHeight;
+  std::vector<unsigned short> thermal;
+  std::vector<unsigned char> palette;
+};
+
+Session g_session = { false, false, 0, false, false, 0, 0, EvoIRPipelineStats(), std::string(), std::string(), std::string(), 0, 0, 0, 0, std::vector<unsigned short>(), std::vector<unsigned char>() };
+
+/**
+ * Row-major w x h image to column-major h x w matrix
+ */
+template<typename T>
+void transpose(const T* src, int w, int h, T* dst)
+{
+  for(int y0 = 0; y0 < h; y0 += TILE)
+  {
+    const int y1 = y0 + TILE < h ? y0 + TILE : h;
+    for(int x0 = 0; x0 < w; x0 += TILE)
+    {
+      const int x1 = x0 + TILE < w ? x0 + TILE : w;
+      for(int x = x0; x < x1; x++)
+      {
+        T* col = dst + (size_t)x * h;
+        for(int y = y0; y < y1; y++)
+          col[y] = src[(size_t)y * w + x];
+      }
+    }
+  }
+}
+
+/**
+ * Interleaved w x h image to column-major h x w x 3 matrix in r, g, b order
+ */
+void deinterleave(const unsigned char* src, int w, int h, unsigned char* dst)
+{
+#if _WIN32
+  // the library delivers b,g,r on Windows
+  const int order[3] = { 2, 1, 0 };
+#else
+  const int order[3] = { 0, 1, 2 };
+#endif
+  const size_t plane = (size_t)w * h;
+  for(int y0 = 0; y0 < h; y0 += TILE)
+  {
+    const int y1 = y0 + TILE < h ? y0 + TILE : h;
+    for(int x0 = 0; x0 < w; x0 += TILE)
+    {
+      const int x1 = x0 + TILE < w ? x0 + TILE : w;
+      for(int x = x0; x < x1; x++)
+      {
+        unsigned char* r = dst + (size_t)x * h;
+        unsigned char* g = r + plane;
+        unsigned char* b = g + plane;
+        for(int y = y0; y < y1; y++)
+        {
+          const unsigned char* p = src + ((size_t)y * w + x) * 3;
+          r[y] = p[order[0]];
+          g[y] = p[order[1]];
+          b[y] = p[order[2]];
+        }
+      }
+    }
+  }
+}
+
+/**
+ * Struct with 1 x n rows per field for the metadata of n frames
+ */
+mxArray* metadataStruct(const std::vector<EvoIRFrameMetadata>& metadata)
+{
+  const mwSize n = (mwSize)metadata.size();
+  mxArray* s = mxCreateStructMatrix(1, 1, METADATA_FIELD_COUNT, (const char**)METADATA_FIELDS);
+  mxArray* counter        = mxCreateNumericMatrix(1, n, mxUINT32_CLASS, mxREAL);
+  mxArray* counterHW      = mxCreateNumericMatrix(1, n, mxUINT32_CLASS, mxREAL);
+  mxArray* timestamp      = mxCreateNumericMatrix(1, n, mxINT64_CLASS, mxREAL);
+  mxArray* timestampMedia = mxCreateNumericMatrix(1, n, mxINT64_CLASS, mxREAL);
+  mxArray* flagState      = mxCreateNumericMatrix(1, n, mxINT32_CLASS, mxREAL);
+  mxArray* tempChip       = mxCreateDoubleMatrix(1, n, mxREAL);
+  mxArray* tempFlag       = mxCreateDoubleMatrix(1, n, mxREAL);
+  mxArray* tempBox        = mxCreateDoubleMatrix(1, n, mxREAL);
+  for(mwSize i = 0; i < n; i++)
+  {
+    const EvoIRFrameMetadata& m = metadata[i];
+    ((unsigned int*)mxGetData(counter))[i]     = m.counter;
+    ((unsigned int*)mxGetData(counterHW))[i]   = m.counterHW;
+    ((long long*)mxGetData(timestamp))[i]      = m.timestamp;
+    ((long long*)mxGetData(timestampMedia))[i] = m.timestampMedia;
+    ((int*)mxGetData(flagState))[i]            = (int)m.flagState;
+    mxGetPr(tempChip)[i] = m.tempChip;
+    mxGetPr(tempFlag)[i] = m.tempFlag;
+    mxGetPr(tempBox)[i]  = m.tempBox;
+  }
+  mxSetField(s, 0, "counter", counter);
+  mxSetField(s, 0, "counterHW", counterHW);
+  mxSetField(s, 0, "timestamp", timestamp);
+  mxSetField(s, 0, "timestampMedia", timestampMedia);
+  mxSetField(s, 0, "flagState", flagState);
+  mxSetField(s, 0, "tempChip", tempChip);
+  mxSetField(s, 0, "tempFlag", tempFlag);
+  mxSetField(s, 0, "tempBox", tempBox);
+  return s;
+}
+
+mxArray* emptyImage(mxClassID classId)
+{
+  return mxCreateNumericMatrix(0, 0, classId, mxREAL);
+}
+
+std::string stringArg(const mxArray* a, const char* name)
+{
+  if(!mxIsChar(a)) mexErrMsgIdAndTxt("evo_irimager_mex:args", "%s must be a string", name);
+  char* s = mxArrayToString(a);
+  std::string r(s ? s : "");
+  mxFree(s);
+  return r;
+}
+
+double numberArg(int nrhs, const mxArray* prhs[], int i, const char* name)
+{
+  if(i >= nrhs || !mxIsNumeric(prhs[i]) || mxGetNumberOfElements(prhs[i]) != 1)
+    mexErrMsgIdAndTxt("evo_irimager_mex:args", "%s must be a numeric scalar", name);
+  return mxGetScalar(prhs[i]);
+}
+
+void requireConnection()
+{
+  if(!g_session.connected)
+    mexErrMsgIdAndTxt("evo_irimager_mex:state", "not connected, call usb_init or tcp_init first");
+}
+
+int stopPipeline()
+{
+  const bool suspended = g_session.pipelineSuspended;
+  g_session.pipelineSuspended = false;
+  if(!g_session.pipelineRunning) return suspended ? 0 : -1;
+  g_session.pipelineRunning = false;
+  return evo_irimager_pipeline_destroy(g_session.pipeId);
+}
+
+/**
+ * Queries image sizes and sizes the scratch buffers after a successful init
+ */
+int connect(int ret)
+{
+  if(ret != 0) return ret;
+  if(evo_irimager_get_thermal_image_size(&g_session.thmWidth, &g_session.thmHeight) != 0 ||
+     evo_irimager_get_palette_image_size(&g_session.paletteWidth, &g_session.paletteHeight) != 0 ||
+     g_session.thmWidth <= 0 || g_session.paletteWidth <= 0)
+  {
+    evo_irimager_terminate();
+    return -1;
+  }
+  g_session.thermal.resize((size_t)g_session.thmWidth * g_session.thmHeight);
+  g_session.palette.resize((size_t)g_session.paletteWidth * g_session.paletteHeight * 3);
+  g_session.connected = true;
+  return 0;
+}
+
+int disconnect()
+{
+  if(!g_session.connected) return -1;
+  stopPipeline();
+  if(g_session.configAttached) evo_irimager_config_detach(g_session.cfgId);
+  g_session.configAttached = false;
+  g_session.connected      = false;
+  return evo_irimager_terminate();
+}
+
+void atExit()
+{
+  disconnect();
+}
+
+mxArray* thermalImage(const unsigned short* data, int w, int h)
+{
+  mxArray* a = mxCreateUninitNumericMatrix(h, w, mxUINT16_CLASS, mxREAL);
+  transpose(data, w, h, (unsigned short*)mxGetData(a));
+  return a;
+}
+
+mxArray* paletteImage(const unsigned char* data, int w, int h)
+{
+  const mwSize dims[3] = { (mwSize)h, (mwSize)w, 3 };
+  mxArray* a = mxCreateUninitNumericArray(3, dims, mxUINT8_CLASS, mxREAL);
+  deinterleave(data, w, h, (unsigned char*)mxGetData(a));
+  return a;
+}
+
+mxArray* thermalImage()
+{
+  return thermalImage(&g_session.thermal[0], g_session.thmWidth, g_session.thmHeight);
+}
+
+mxArray* paletteImage()
+{
+  return paletteImage(&g_session.palette[0], g_session.paletteWidth, g_session.paletteHeight);
+}
+
+/**
+ * The pipeline threads call the library, so single frame commands must not run next to them.
+ * A running pipeline is stopped and started again by the next pipeline_frame.
+ */
+void requireCamera()
+{
+  requireConnection();
+  if(!g_session.pipelineRunning) return;
+  evo_irimager_pipeline_get_stats(g_session.pipeId, &g_session.pipelineStats);
+  stopPipeline();
+  g_session.pipelineSuspended = true;
+}
+
+int startPipeline(int queueFrames)
+{
+  requireCamera();
+  if(queueFrames < 1) mexErrMsgIdAndTxt("evo_irimager_mex:args", "queue frames must be positive");
+  EvoIRPipelineParams params;
+  evo_irimager_pipeline_default_params(&params);
+  // palette images of the library, so set_palette and the channel order stay as for get_palette
+  params.queueFrames   = (unsigned int)queueFrames;
+  params.temperatures  = 0;
+  params.renderPalette = 0;
+  if(evo_irimager_pipeline_create(&g_session.pipeId, g_session.thmWidth, g_session.thmHeight, &params) != 0) return -1;
+  if(evo_irimager_pipeline_start_capture(g_session.pipeId) != 0)
+  {
+    evo_irimager_pipeline_destroy(g_session.pipeId);
+    return -1;
+  }
+  g_session.pipelineRunning     = true;
+  g_session.pipelineSuspended   = false;
+  g_session.pipelineQueueFrames = (unsigned int)queueFrames;
+  return 0;
+}
+
+void pipelineFrame(int nlhs, mxArray* plhs[], int timeoutMs)
+{
+  if(!g_session.pipelineRunning && !g_session.pipelineSuspended)
+    mexErrMsgIdAndTxt("evo_irimager_mex:state", "pipeline not running, call pipeline_start first");
+  EvoIRPipelineFrame frame;
+  int ret = -1;
+  // a failed restart is reported like a missing frame and tried again on the next call
+  if(g_session.pipelineRunning || startPipeline((int)g_session.pipelineQueueFrames) == 0)
+    ret = evo_irimager_pipeline_acquire_frame(g_session.pipeId, timeoutMs, &frame);
+  std::vector<EvoIRFrameMetadata> metadata;
+  if(ret == 0)
+  {
+    plhs[0] = thermalImage(frame.thermal, frame.width, frame.height);
+    if(nlhs > 1) plhs[1] = paletteImage(frame.palette, frame.paletteWidth, frame.paletteHeight);
+    metadata.push_back(frame.metadata);
+    evo_irimager_pipeline_release_frame(g_session.pipeId, frame.buffer);
+  }
+  else
+  {
+    plhs[0] = emptyImage(mxUINT16_CLASS);
+    if(nlhs > 1) plhs[1] = emptyImage(mxUINT8_CLASS);
+  }
+  if(nlhs > 2) plhs[2] = metadataStruct(metadata);
+  if(nlhs > 3) plhs[3] = mxCreateDoubleScalar(ret);
+}
+
+mxArray* pipelineStats()
+{
+  if(!g_session.pipelineRunning && !g_session.pipelineSuspended)
+    mexErrMsgIdAndTxt("evo_irimager_mex:state", "pipeline not running, call pipeline_start first");
+  EvoIRPipelineStats stats = g_session.pipelineStats;
+  if(g_session.pipelineRunning) evo_irimager_pipeline_get_stats(g_session.pipeId, &stats);
+  mxArray* s       = mxCreateStructMatrix(1, 1, STATS_FIELD_COUNT, (const char**)STATS_FIELDS);
+  mxArray* frames  = mxCreateDoubleMatrix(1, EVO_PIPELINE_STAGES, mxREAL);
+  mxArray* dropped = mxCreateDoubleMatrix(1, EVO_PIPELINE_STAGES, mxREAL);
+  mxArray* failed  = mxCreateDoubleMatrix(1, EVO_PIPELINE_STAGES, mxREAL);
+  mxArray* wait    = mxCreateDoubleMatrix(1, EVO_PIPELINE_STAGES, mxREAL);
+  mxArray* busy    = mxCreateDoubleMatrix(1, EVO_PIPELINE_STAGES, mxREAL);
+  for(int i = 0; i < EVO_PIPELINE_STAGES; i++)
+  {
+    mxGetPr(frames)[i]  = (double)stats.stages[i].frames;
+    mxGetPr(dropped)[i] = (double)stats.stages[i].dropped;
+    mxGetPr(failed)[i]  = (double)stats.stages[i].failed;
+    mxGetPr(wait)[i]    = stats.stages[i].wait.mean;
+    mxGetPr(busy)[i]    = stats.stages[i].busy.mean;
+  }
+  mxSetField(s, 0, "frames", frames);
+  mxSetField(s, 0, "dropped", dropped);
+  mxSetField(s, 0, "failed", failed);
+  mxSetField(s, 0, "wait", wait);
+  mxSetField(s, 0, "busy", busy);
+  mxSetField(s, 0, "latency", mxCreateDoubleScalar(stats.latency.mean));
+  return s;
+}
+
+void getThermal(int nlhs, mxArray* plhs[])
+{
+  requireCamera();
+  std::vector<EvoIRFrameMetadata> metadata(1);
+  int w = g_session.thmWidth;
+  int h = g_session.thmHeight;
+  const int ret = evo_irimager_get_thermal_image_metadata(&w, &h, &g_session.thermal[0], &metadata[0]);
+  plhs[0] = ret == 0 ? thermalImage() : emptyImage(mxUINT16_CLASS);
+  if(nlhs > 1) plhs[1] = metadataStruct(ret == 0 ? metadata : std::vector<EvoIRFrameMetadata>());
+  if(nlhs > 2) plhs[2] = mxCreateDoubleScalar(ret);
+}
+
+void getPalette(int nlhs, mxArray* plhs[])
+{
+  requireCamera();
+  std::vector<EvoIRFrameMetadata> metadata(1);
+  int w = g_session.paletteWidth;
+  int h = g_session.paletteHeight;
+  const int ret = evo_irimager_get_palette_image_metadata(&w, &h, &g_session.palette[0], &metadata[0]);
+  plhs[0] = ret == 0 ? paletteImage() : emptyImage(mxUINT8_CLASS);
+  if(nlhs > 1) plhs[1] = metadataStruct(ret == 0 ? metadata : std::vector<EvoIRFrameMetadata>());
+  if(nlhs > 2) plhs[2] = mxCreateDoubleScalar(ret);
+}
+
+void getThermalPalette(int nlhs, mxArray* plhs[])
+{
+  requireCamera();
+  std::vector<EvoIRFrameMetadata> metadata(1);
+  const int ret = evo_irimager_get_thermal_palette_image_metadata(g_session.thmWidth, g_session.thmHeight, &g_session.thermal[0],
+                                                                 g_session.paletteWidth, g_session.paletteHeight, &g_session.palette[0],
+                                                                 &metadata[0]);
+  plhs[0] = ret == 0 ? thermalImage() : emptyImage(mxUINT16_CLASS);
+  if(nlhs > 1) plhs[1] = ret == 0 ? paletteImage() : emptyImage(mxUINT8_CLASS);
+  if(nlhs > 2) plhs[2] = metadataStruct(ret == 0 ? metadata : std::vector<EvoIRFrameMetadata>());
+  if(nlhs > 3) plhs[3] = mxCreateDoubleScalar(ret);
+}
+
+void grab(int nlhs, mxArray* plhs[], int n)
+{
+  requireCamera();
+  if(n < 1) mexErrMsgIdAndTxt("evo_irimager_mex:args", "number of frames must be positive");
+  const int w      = g_session.thmWidth;
+  const int h      = g_session.thmHeight;
+  const size_t px  = (size_t)w * h;
+  mwSize dims[3]   = { (mwSize)h, (mwSize)w, (mwSize)n };
+  mxArray* stack   = mxCreateUninitNumericArray(3, dims, mxUINT16_CLASS, mxREAL);
+  unsigned short* out = (unsigned short*)mxGetData(stack);
+
+  std::vector<EvoIRFrameMetadata> metadata(n);
+  int grabbed = 0;
+  int ret     = 0;
+  for(; grabbed < n; grabbed++)
+  {
+    int wi = w;
+    int hi = h;
+    ret = evo_irimager_get_thermal_image_metadata(&wi, &hi, &g_session.thermal[0], &metadata[grabbed]);
+    if(ret != 0) break;
+    transpose(&g_session.thermal[0], w, h, out + px * grabbed);
+  }
+  if(grabbed < n)
+  {
+    // shrinking only changes the dimensions, the surplus memory is released with the array
+    dims[2] = (mwSize)grabbed;
+    mxSetDimensions(stack, dims, 3);
+    metadata.resize(grabbed);
+  }
+  plhs[0] = stack;
+  if(nlhs > 1) plhs[1] = metadataStruct(metadata);
+  if(nlhs > 2) plhs[2] = mxCreateDoubleScalar(ret);
+}
+
+mxArray* reportStruct(const EvoIRConfigReport& report)
+{
+  mxArray* s = mxCreateStructMatrix(1, 1, REPORT_FIELD_COUNT, (const char**)REPORT_FIELDS);
+  mxArray* method = mxCreateDoubleMatrix(1, EVO_CONFIG_CHANGE_TYPES, mxREAL);
+  mxArray* outage = mxCreateDoubleMatrix(1, EVO_CONFIG_CHANGE_TYPES, mxREAL);
+  for(int t = 0; t < EVO_CONFIG_CHANGE_TYPES; t++)
+  {
+    mxGetPr(method)[t] = report.changes[t].method;
+    mxGetPr(outage)[t] = report.changes[t].outage;
+  }
+  mxSetField(s, 0, "restarted", mxCreateDoubleScalar(report.restarted));
+  mxSetField(s, 0, "sizeChanged", mxCreateDoubleScalar(report.sizeChanged));
+  mxSetField(s, 0, "width", mxCreateDoubleScalar(report.width));
+  mxSetField(s, 0, "height", mxCreateDoubleScalar(report.height));
+  mxSetField(s, 0, "outage", mxCreateDoubleScalar(report.outage));
+  mxSetField(s, 0, "method", method);
+  mxSetField(s, 0, "changeOutage", outage);
+  return s;
+}
+
+void applyConfig(int nlhs, mxArray* plhs[], const std::string& xml)
+{
+  requireCamera();
+  if(g_session.xml.empty()) mexErrMsgIdAndTxt("evo_irimager_mex:state", "apply_config needs a camera initialized by usb_init");
+  if(!g_session.configAttached)
+  {
+    if(evo_irimager_config_attach(&g_session.cfgId, g_session.xml.c_str(), g_session.formats.c_str(), g_session.log.c_str()) != 0)
+      mexErrMsgIdAndTxt("evo_irimager_mex:state", "cannot read configuration file %s", g_session.xml.c_str());
+    g_session.configAttached = true;
+  }
+  EvoIRConfigReport report = {};
+  const int ret = evo_irimager_config_apply_file(g_session.cfgId, xml.c_str(), &report);
+  // a restart re-queries the sizes, resize keeps the buffers if they did not change.
+  // A failed restart without fallback leaves no camera.
+  if(report.restarted && (report.width <= 0 || connect(0) != 0))
+  {
+    evo_irimager_config_detach(g_session.cfgId);
+    g_session.configAttached = false;
+    g_session.connected      = false;
+  }
+  plhs[0] = mxCreateDoubleScalar(ret);
+  if(nlhs > 1) plhs[1] = reportStruct(report);
+}
+
+} // namespace
+
+} // namespace evo
+
+using namespace evo;
+
+void mexFunction(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
+{
+  if(nrhs < 1) mexErrMsgIdAndTxt("evo_irimager_mex:args", "command expected, see EvoIRMex.cpp");
+  static bool registered = false;
+  if(!registered)
+  {
+    mexAtExit(atExit);
+    registered = true;
+  }
+
+  const std::string cmd = stringArg(prhs[0], "command");
+  if(cmd == "usb_init")
+  {
+    if(nrhs < 2) mexErrMsgIdAndTxt("evo_irimager_mex:args", "configuration file expected");
+    if(g_session.connected) disconnect();
+    const std::string xml     = stringArg(prhs[1], "xml_config");
+    const std::string formats = nrhs > 2 ? stringArg(prhs[2], "formats_def") : std::string();
+    const std::string log     = nrhs > 3 ? stringArg(prhs[3], "log_file") : std::string();
+    plhs[0] = mxCreateDoubleScalar(connect(evo_irimager_usb_init(xml.c_str(), formats.c_str(), log.c_str())));
+    g_session.xml     = xml;
+    g_session.formats = formats;
+    g_session.log     = log;
+  }
+  else if(cmd == "tcp_init")
+  {
+    if(nrhs < 2) mexErrMsgIdAndTxt("evo_irimager_mex:args", "ip expected");
+    if(g_session.connected) disconnect();
+    const std::string ip = stringArg(prhs[1], "ip");
+    const int port       = (int)numberArg(nrhs, prhs, 2, "port");
+    g_session.xml.clear();
+    plhs[0] = mxCreateDoubleScalar(connect(evo_irimager_tcp_init(ip.c_str(), port)));
+  }
+  else if(cmd == "terminate")
+  {
+    plhs[0] = mxCreateDoubleScalar(disconnect());
+  }
+  else if(cmd == "get_thermal_image_size")
+  {
+    requireConnection();
+    plhs[0] = mxCreateDoubleScalar(g_session.thmWidth);
+    if(nlhs > 1) plhs[1] = mxCreateDoubleScalar(g_session.thmHeight);
+  }
+  else if(cmd == "get_palette_image_size")
+  {
+    requireConnection();
+    plhs[0] = mxCreateDoubleScalar(g_session.paletteWidth);
+    if(nlhs > 1) plhs[1] = mxCreateDoubleScalar(g_session.paletteHeight);
+  }
+  else if(cmd == "get_thermal")
+  {
+    getThermal(nlhs, plhs);
+  }
+  else if(cmd == "get_palette")
+  {
+    getPalette(nlhs, plhs);
+  }
+  else if(cmd == "get_thermal_palette")
+  {
+    getThermalPalette(nlhs, plhs);
+  }
+  else if(cmd == "grab")
+  {
+    grab(nlhs, plhs, (int)numberArg(nrhs, prhs, 1, "number of frames"));
+  }
+  else if(cmd == "set_palette")
+  {
+    requireCamera();
+    plhs[0] = mxCreateDoubleScalar(evo_irimager_set_palette((int)numberArg(nrhs, prhs, 1, "palette id")));
+  }
+  else if(cmd == "set_palette_scale")
+  {
+    requireCamera();
+    plhs[0] = mxCreateDoubleScalar(evo_irimager_set_palette_scale((int)numberArg(nrhs, prhs, 1, "scale id")));
+  }
+  else if(cmd == "set_palette_manual_temp_range")
+  {
+    requireCamera();
+    plhs[0] = mxCreateDoubleScalar(evo_irimager_set_palette_manual_temp_range((float)numberArg(nrhs, prhs, 1, "min"),
+                                                                               (float)numberArg(nrhs, prhs, 2, "max")));
+  }
+  else if(cmd == "set_temperature_range")
+  {
+    requireCamera();
+    plhs[0] = mxCreateDoubleScalar(evo_irimager_set_temperature_range((int)numberArg(nrhs, prhs, 1, "min"),
+                                                                       (int)numberArg(nrhs, prhs, 2, "max")));
+  }
+  else if(cmd == "set_shutter_mode")
+  {
+    requireCamera();
+    plhs[0] = mxCreateDoubleScalar(evo_irimager_set_shutter_mode((int)numberArg(nrhs, prhs, 1, "mode")));
+  }
+  else if(cmd == "trigger_shutter_flag")
+  {
+    requireCamera();
+    plhs[0] = mxCreateDoubleScalar(evo_irimager_trigger_shutter_flag());
+  }
+  else if(cmd == "apply_config")
+  {
+    if(nrhs < 2) mexErrMsgIdAndTxt("evo_irimager_mex:args", "configuration file expected");
+    applyConfig(nlhs, plhs, stringArg(prhs[1], "xml_config"));
+  }
+  else if(cmd == "pipeline_start")
+  {
+    plhs[0] = mxCreateDoubleScalar(startPipeline(nrhs > 1 ? (int)numberArg(nrhs, prhs, 1, "queue frames") : 2));
+  }
+  else if(cmd == "pipeline_frame")
+  {
+    pipelineFrame(nlhs, plhs, nrhs > 1 ? (int)numberArg(nrhs, prhs, 1, "timeout") : 1000);
+  }
+  else if(cmd == "pipeline_stats")
+  {
+    plhs[0] = pipelineStats();
+  }
+  else if(cmd == "pipeline_stop")
+  {
+    plhs[0] = mxCreateDoubleScalar(stopPipeline());
+  }
+  else
+  {
+    mexErrMsgIdAndTxt("evo_irimager_mex:args", "unknown command '%s'", cmd.c_str());
+  }
+}
@@ -0,0 +1,554 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRPalette.cpp
+ * @brief Temperature conversion, image statistics and false color rendering
+ *
+ * Palette indices are computed with 16 bit fixed point arithmetic: the value
+ * range rawMax - rawMin is shifted left until it fills 15 bits, then a single
+ * multiply-high yields the index [0; 255]. The plain C++ path uses the same
+ * formula, so all code paths produce identical images.
+ */
+
+#include "EvoIRPalette.h"
+#include "EvoIRSimd.h"
+
+#include <cmath>
+
+namespace evo
+{
+
+namespace
+{
+
+const int PALETTE_COUNT = 11;
+const int PALETTE_SIZE  = 256;
+const int CHUNK         = 512; // pixels per palette index block
+
+enum Scale { eManual = 1, eMinMax = 2, eSigma1 = 3, eSigma3 = 4 };
+
+struct ColorPoint
+{
+  float pos;
+  unsigned char r, g, b;
+};
+
+struct PaletteTables
+{
+  unsigned char interleaved[PALETTE_COUNT][PALETTE_SIZE * 3];
+  unsigned char planar[PALETTE_COUNT][3][PALETTE_SIZE];
+
+  PaletteTables()
+  {
+    static const ColorPoint iron[] = {
+      { 0.00f,   0,   0,   0 }, { 0.15f,  32,   0, 140 }, { 0.35f, 145,   0, 160 }, { 0.55f, 225,  60,  40 },
+      { 0.75f, 250, 155,   0 }, { 0.90f, 255, 225,  40 }, { 1.00f, 255, 255, 255 } };
+    static const ColorPoint medical[] = {
+      { 0.00f,   0,   0,   0 }, { 0.20f,   0,   0, 180 }, { 0.40f,   0, 160, 160 }, { 0.55f,   0, 200,   0 },
+      { 0.70f, 230, 230,   0 }, { 0.85f, 230,   0,   0 }, { 1.00f, 255, 255, 255 } };
+    static const ColorPoint rainbow[] = {
+      { 0.00f,   0,   0, 255 }, { 0.25f,   0, 255, 255 }, { 0.50f,   0, 255,   0 }, { 0.75f, 255, 255,   0 },
+      { 1.00f, 255,   0,   0 } };
+    static const ColorPoint rainbowHi[] = {
+      { 0.00f,   0,   0,   0 }, { 0.10f, 128,   0, 255 }, { 0.25f,   0,   0, 255 }, { 0.40f,   0, 255, 255 },
+      { 0.55f,   0, 255,   0 }, { 0.70f, 255, 255,   0 }, { 0.85f, 255,   0,   0 }, { 1.00f, 255, 255, 255 } };
+    static const ColorPoint grayBW[] = { { 0.f,   0,   0,   0 }, { 1.f, 255, 255, 255 } };
+    static const ColorPoint grayWB[] = { { 0.f, 255, 255, 255 }, { 1.f,   0,   0,   0 } };
+
+    alarm(1,  0.8f, 0,   0,   255); // eAlarmBlue
+    alarm(2,  0.9f, 0,   0,   255); // eAlarmBlueHi
+    gradient(3,  grayBW,    sizeof(grayBW) / sizeof(ColorPoint),    false);
+    gradient(4,  grayWB,    sizeof(grayWB) / sizeof(ColorPoint),    false);
+    alarm(5,  0.8f, 0,   255, 0);   // eAlarmGreen
+    gradient(6,  iron,      sizeof(iron) / sizeof(ColorPoint),      false);
+    gradient(7,  iron,      sizeof(iron) / sizeof(ColorPoint),      true);
+    gradient(8,  medical,   sizeof(medical) / sizeof(ColorPoint),   false);
+    gradient(9,  rainbow,   sizeof(rainbow) / sizeof(ColorPoint),   false);
+    gradient(10, rainbowHi, sizeof(rainbowHi) / sizeof(ColorPoint), false);
+    alarm(11, 0.8f, 255, 0,   0);   // eAlarmRed
+
+    for(int p = 0; p < PALETTE_COUNT; p++)
+      for(int i = 0; i < PALETTE_SIZE; i++)
+        for(int c = 0; c < 3; c++)
+          planar[p][c][i] = interleaved[p][i * 3 + c];
+  }
+
+  // Linear interpolation between color points, contrast stretched around the center for Hi variants
+  void gradient(int id, const ColorPoint* points, size_t count, bool stretch)
+  {
+    for(int i = 0; i < PALETTE_SIZE; i++)
+    {
+      float x = i / (float)(PALETTE_SIZE - 1);
+      if(stretch) x = x * x * (3.f - 2.f * x);
+      size_t k = 1;
+      while(k < count - 1 && points[k].pos < x) k++;
+      const ColorPoint& a = points[k - 1];
+      const ColorPoint& b = points[k];
+      const float f = (x - a.pos) / (b.pos - a.pos);
+      unsigned char* rgb = &interleaved[id - 1][i * 3];
+      rgb[0] = (unsigned char)(a.r + f * (b.r - a.r) + 0.5f);
+      rgb[1] = (unsigned char)(a.g + f * (b.g - a.g) + 0.5f);
+      rgb[2] = (unsigned char)(a.b + f * (b.b - a.b) + 0.5f);
+    }
+  }
+
+  // Gray ramp with all values above the alarm level painted in the alarm color
+  void alarm(int id, float level, unsigned char r, unsigned char g, unsigned char b)
+  {
+    const int first = (int)(level * (PALETTE_SIZE - 1) + 0.5f);
+    for(int i = 0; i < PALETTE_SIZE; i++)
+    {
+      unsigned char* rgb = &interleaved[id - 1][i * 3];
+      if(i < first)
+      {
+        rgb[0] = rgb[1] = rgb[2] = (unsigned char)(i * 230 / first);
+      }
+      else
+      {
+        rgb[0] = r;
+        rgb[1] = g;
+        rgb[2] = b;
+      }
+    }
+  }
+};
+
+const PaletteTables& tables()
+{
+  static const PaletteTables t;
+  return t;
+}
+
+// Fixed point mapping of [rawMin; rawMax] onto [0; 255]: idx = ((d << shift) * factor) >> 16
+struct IndexMapping
+{
+  IndexMapping(unsigned short rawMin, unsigned short rawMax) : lo(rawMin), hi(rawMax), shift(0), factor(0)
+  {
+    unsigned int range = (unsigned int)(hi - lo);
+    if(range == 0) return;
+    while((range << 1) <= 0xFFFF)
+    {
+      range <<= 1;
+      shift++;
+    }
+    factor = (unsigned short)((255u * 65536u + range - 1) / range);
+  }
+
+  unsigned char operator()(unsigned short raw) const
+  {
+    const unsigned short v = raw < lo ? lo : (raw > hi ? hi : raw);
+    return (unsigned char)((((unsigned int)(unsigned short)((v - lo) << shift)) * factor) >> 16);
+  }
+
+  unsigned short lo;
+  unsigned short hi;
+  int shift;
+  unsigned short factor;
+};
+
+//------------------------------------------------------------------------------
+// plain C++
+//------------------------------------------------------------------------------
+
+void toCelsiusScalar(const unsigned short* data, size_t n, float scale, float* out)
+{
+  for(size_t i = 0; i < n; i++)
+    out[i] = (float)data[i] * scale - 100.f;
+}
+
+void statsScalar(const unsigned short* data, size_t n, unsigned short* mn, unsigned short* mx, unsigned long long* sum, unsigned long long* sumSq)
+{
+  unsigned short lo = 0xFFFF, hi = 0;
+  unsigned long long s = 0, q = 0;
+  for(size_t i = 0; i < n; i++)
+  {
+    const unsigned int v = data[i];
+    if(v < lo) lo = (unsigned short)v;
+    if(v > hi) hi = (unsigned short)v;
+    s += v;
+    q += (unsigned long long)(v * v);
+  }
+  *mn    = lo;
+  *mx    = hi;
+  *sum   = s;
+  *sumSq = q;
+}
+
+void indicesScalar(const unsigned short* data, size_t n, const IndexMapping& m, unsigned char* idx)
+{
+  for(size_t i = 0; i < n; i++)
+    idx[i] = m(data[i]);
+}
+
+#if EVO_SIMD_X86
+
+//------------------------------------------------------------------------------
+// SSE4.1
+//------------------------------------------------------------------------------
+
+EVO_TARGET_SSE41 void toCelsiusSse41(const unsigned short* data, size_t n, float scale, float* out)
+{
+  const __m128 s   = _mm_set1_ps(scale);
+  const __m128 off = _mm_set1_ps(100.f);
+  size_t i = 0;
+  for(; i + 8 <= n; i += 8)
+  {
+    const __m128i v  = _mm_loadu_si128((const __m128i*)(data + i));
+    const __m128i lo = _mm_cvtepu16_epi32(v);
+    const __m128i hi = _mm_cvtepu16_epi32(_mm_srli_si128(v, 8));
+    _mm_storeu_ps(out + i,     _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(lo), s), off));
+    _mm_storeu_ps(out + i + 4, _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(hi), s), off));
+  }
+  toCelsiusScalar(data + i, n - i, scale, out + i);
+}
+
+EVO_TARGET_SSE41 inline __m128i squares64Sse41(__m128i v32)
+{
+  const __m128i odd = _mm_srli_epi64(v32, 32);
+  return _mm_add_epi64(_mm_mul_epu32(v32, v32), _mm_mul_epu32(odd, odd));
+}
+
+EVO_TARGET_SSE41 void statsSse41(const unsigned short* data, size_t n, unsigned short* mn, unsigned short* mx, unsigned long long* sum, unsigned long long* sumSq)
+{
+  __m128i vmin = _mm_set1_epi16((short)0xFFFF);
+  __m128i vmax = _mm_setzero_si128();
+  __m128i vsq  = _mm_setzero_si128();
+  unsigned long long s = 0;
+  size_t i = 0;
+  while(i + 8 <= n)
+  {
+    // 32 bit lane sums are flushed before they can overflow
+    __m128i vsum = _mm_setzero_si128();
+    const size_t end = (n - i > 8 * 16384) ? i + 8 * 16384 : n - (n - i) % 8;
+    for(; i < end; i += 8)
+    {
+      const __m128i v  = _mm_loadu_si128((const __m128i*)(data + i));
+      vmin = _mm_min_epu16(vmin, v);
+      vmax = _mm_max_epu16(vmax, v);
+      const __m128i lo = _mm_cvtepu16_epi32(v);
+      const __m128i hi = _mm_cvtepu16_epi32(_mm_srli_si128(v, 8));
+      vsum = _mm_add_epi32(vsum, _mm_add_epi32(lo, hi));
+      vsq  = _mm_add_epi64(vsq, _mm_add_epi64(squares64Sse41(lo), squares64Sse41(hi)));
+    }
+    unsigned int lanes[4];
+    _mm_storeu_si128((__m128i*)lanes, vsum);
+    s += (unsigned long long)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  }
+
+  unsigned short mins[8], maxs[8];
+  unsigned long long sq[2];
+  _mm_storeu_si128((__m128i*)mins, vmin);
+  _mm_storeu_si128((__m128i*)maxs, vmax);
+  _mm_storeu_si128((__m128i*)sq, vsq);
+
+  unsigned short lo, hi;
+  unsigned long long ts, tq;
+  statsScalar(data + i, n - i, &lo, &hi, &ts, &tq);
+  for(int k = 0; k < 8; k++)
+  {
+    if(mins[k] < lo) lo = mins[k];
+    if(maxs[k] > hi) hi = maxs[k];
+  }
+  *mn    = lo;
+  *mx    = hi;
+  *sum   = s + ts;
+  *sumSq = sq[0] + sq[1] + tq;
+}
+
+EVO_TARGET_SSE41 void indicesSse41(const unsigned short* data, size_t n, const IndexMapping& m, unsigned char* idx)
+{
+  const __m128i lo     = _mm_set1_epi16((short)m.lo);
+  const __m128i hi     = _mm_set1_epi16((short)m.hi);
+  const __m128i factor = _mm_set1_epi16((short)m.factor);
+  const __m128i shift  = _mm_cvtsi32_si128(m.shift);
+  size_t i = 0;
+  for(; i + 16 <= n; i += 16)
+  {
+    __m128i a = _mm_loadu_si128((const __m128i*)(data + i));
+    __m128i b = _mm_loadu_si128((const __m128i*)(data + i + 8));
+    a = _mm_sub_epi16(_mm_min_epu16(_mm_max_epu16(a, lo), hi), lo);
+    b = _mm_sub_epi16(_mm_min_epu16(_mm_max_epu16(b, lo), hi), lo);
+    a = _mm_mulhi_epu16(_mm_sll_epi16(a, shift), factor);
+    b = _mm_mulhi_epu16(_mm_sll_epi16(b, shift), factor);
+    _mm_storeu_si128((__m128i*)(idx + i), _mm_packus_epi16(a, b));
+  }
+  indicesScalar(data + i, n - i, m, idx + i);
+}
+
+//------------------------------------------------------------------------------
+// AVX2
+//------------------------------------------------------------------------------
+
+EVO_TARGET_AVX2 void toCelsiusAvx2(const unsigned short* data, size_t n, float scale, float* out)
+{
+  const __m256 s   = _mm256_set1_ps(scale);
+  const __m256 off = _mm256_set1_ps(100.f);
+  size_t i = 0;
+  for(; i + 16 <= n; i += 16)
+  {
+    const __m256i lo = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(data + i)));
+    const __m256i hi = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(data + i + 8)));
+    _mm256_storeu_ps(out + i,     _mm256_sub_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(lo), s), off));
+    _mm256_storeu_ps(out + i + 8, _mm256_sub_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(hi), s), off));
+  }
+  toCelsiusScalar(data + i, n - i, scale, out + i);
+}
+
+EVO_TARGET_AVX2 inline __m256i squares64Avx2(__m256i v32)
+{
+  const __m256i odd = _mm256_srli_epi64(v32, 32);
+  return _mm256_add_epi64(_mm256_mul_epu32(v32, v32), _mm256_mul_epu32(odd, odd));
+}
+
+EVO_TARGET_AVX2 void statsAvx2(const unsigned short* data, size_t n, unsigned short* mn, unsigned short* mx, unsigned long long* sum, unsigned long long* sumSq)
+{
+  __m256i vmin = _mm256_set1_epi16((short)0xFFFF);
+  __m256i vmax = _mm256_setzero_si256();
+  __m256i vsq  = _mm256_setzero_si256();
+  unsigned long long s = 0;
+  size_t i = 0;
+  while(i + 16 <= n)
+  {
+    __m256i vsum = _mm256_setzero_si256();
+    const size_t end = (n - i > 16 * 16384) ? i + 16 * 16384 : n - (n - i) % 16;
+    for(; i < end; i += 16)
+    {
+      const __m256i v  = _mm256_loadu_si256((const __m256i*)(data + i));
+      vmin = _mm256_min_epu16(vmin, v);
+      vmax = _mm256_max_epu16(vmax, v);
+      const __m256i lo = _mm256_cvtepu16_epi32(_mm256_castsi256_si128(v));
+      const __m256i hi = _mm256_cvtepu16_epi32(_mm256_extracti128_si256(v, 1));
+      vsum = _mm256_add_epi32(vsum, _mm256_add_epi32(lo, hi));
+      vsq  = _mm256_add_epi64(vsq, _mm256_add_epi64(squares64Avx2(lo), squares64Avx2(hi)));
+    }
+    unsigned int lanes[8];
+    _mm256_storeu_si256((__m256i*)lanes, vsum);
+    for(int k = 0; k < 8; k++) s += lanes[k];
+  }
+
+  unsigned short mins[16], maxs[16];
+  unsigned long long sq[4];
+  _mm256_storeu_si256((__m256i*)mins, vmin);
+  _mm256_storeu_si256((__m256i*)maxs, vmax);
+  _mm256_storeu_si256((__m256i*)sq, vsq);
+
+  unsigned short lo, hi;
+  unsigned long long ts, tq;
+  statsScalar(data + i, n - i, &lo, &hi, &ts, &tq);
+  for(int k = 0; k < 16; k++)
+  {
+    if(mins[k] < lo) lo = mins[k];
+    if(maxs[k] > hi) hi = maxs[k];
+  }
+  *mn    = lo;
+  *mx    = hi;
+  *sum   = s + ts;
+  *sumSq = sq[0] + sq[1] + sq[2] + sq[3] + tq;
+}
+
+EVO_TARGET_AVX2 void indicesAvx2(const unsigned short* data, size_t n, const IndexMapping& m, unsigned char* idx)
+{
+  const __m256i lo     = _mm256_set1_epi16((short)m.lo);
+  const __m256i hi     = _mm256_set1_epi16((short)m.hi);
+  const __m256i factor = _mm256_set1_epi16((short)m.factor);
+  const __m128i shift  = _mm_cvtsi32_si128(m.shift);
+  size_t i = 0;
+  for(; i + 32 <= n; i += 32)
+  {
+    __m256i a = _mm256_loadu_si256((const __m256i*)(data + i));
+    __m256i b = _mm256_loadu_si256((const __m256i*)(data + i + 16));
+    a = _mm256_sub_epi16(_mm256_min_epu16(_mm256_max_epu16(a, lo), hi), lo);
+    b = _mm256_sub_epi16(_mm256_min_epu16(_mm256_max_epu16(b, lo), hi), lo);
+    a = _mm256_mulhi_epu16(_mm256_sll_epi16(a, shift), factor);
+    b = _mm256_mulhi_epu16(_mm256_sll_epi16(b, shift), factor);
+    // packus works per 128 bit lane, restore pixel order afterwards
+    const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+    _mm256_storeu_si256((__m256i*)(idx + i), packed);
+  }
+  indicesScalar(data + i, n - i, m, idx + i);
+}
+
+#endif // EVO_SIMD_X86
+
+void toCelsius(const unsigned short* data, size_t n, float scale, float* out)
+{
+#if EVO_SIMD_X86
+  const int level = simdLevel();
+  if(level >= SIMD_AVX2)  { toCelsiusAvx2(data, n, scale, out); return; }
+  if(level >= SIMD_SSE41) { toCelsiusSse41(data, n, scale, out); return; }
+#endif
+  toCelsiusScalar(data, n, scale, out);
+}
+
+void stats(const unsigned short* data, size_t n, EvoIRThermalStats* result)
+{
+  unsigned short mn, mx;
+  unsigned long long sum, sumSq;
+#if EVO_SIMD_X86
+  const int level = simdLevel();
+  if(level >= SIMD_AVX2)       statsAvx2(data, n, &mn, &mx, &sum, &sumSq);
+  else if(level >= SIMD_SSE41) statsSse41(data, n, &mn, &mx, &sum, &sumSq);
+  else
+#endif
+  statsScalar(data, n, &mn, &mx, &sum, &sumSq);
+
+  // Sums are exact integers, so the result does not depend on the code path
+  const double mean = (double)sum / n;
+  const double var  = (double)sumSq / n - mean * mean;
+  result->min   = mn;
+  result->max   = mx;
+  result->mean  = mean;
+  result->sigma = var > 0.0 ? std::sqrt(var) : 0.0;
+}
+
+void indices(const unsigned short* data, size_t n, const IndexMapping& m, unsigned char* idx)
+{
+#if EVO_SIMD_X86
+  const int level = simdLevel();
+  if(level >= SIMD_AVX2)  { indicesAvx2(data, n, m, idx); return; }
+  if(level >= SIMD_SSE41) { indicesSse41(data, n, m, idx); return; }
+#endif
+  indicesScalar(data, n, m, idx);
+}
+
+float decimalScale(short decimalPlaces)
+{
+  float scale = 1.f;
+  for(short i = 0; i < decimalPlaces; i++) scale *= 0.1f;
+  return scale;
+}
+
+unsigned short toRawClamped(double t, short decimalPlaces)
+{
+  double raw = (t + 100.0) * std::pow(10.0, decimalPlaces);
+  if(raw < 0.0)     raw = 0.0;
+  if(raw > 65535.0) raw = 65535.0;
+  return (unsigned short)(raw + 0.5);
+}
+
+} // namespace
+
+} // namespace evo
+
+using namespace evo;
+
+int evo_irimager_get_simd_level(int* level)
+{
+  if(!level) return -1;
+  *level = simdLevel();
+  return 0;
+}
+
+int evo_irimager_set_simd_level(int level)
+{
+  if(level < EVO_SIMD_NONE || level > EVO_SIMD_AVX2) return -1;
+  setSimdLevel(level);
+  return 0;
+}
+
+int evo_irimager_thermal_to_celsius(const unsigned short* data, int w, int h, short decimalPlaces, float* out)
+{
+  if(!data || !out || w <= 0 || h <= 0 || decimalPlaces < 1 || decimalPlaces > 4) return -1;
+  toCelsius(data, (size_t)w * h, decimalScale(decimalPlaces), out);
+  return 0;
+}
+
+int evo_irimager_thermal_stats(const unsigned short* data, int w, int h, EvoIRThermalStats* result)
+{
+  if(!data || !result || w <= 0 || h <= 0) return -1;
+  stats(data, (size_t)w * h, result);
+  return 0;
+}
+
+int evo_irimager_palette_scale_range(const EvoIRThermalStats* s, int scale, float tMin, float tMax, short decimalPlaces, unsigned short* rawMin, unsigned short* rawMax)
+{
+  if(!rawMin || !rawMax || decimalPlaces < 1 || decimalPlaces > 4) return -1;
+  if(scale != eManual && !s) return -1;
+  double lo, hi;
+  switch(scale)
+  {
+  case eManual:
+    *rawMin = toRawClamped(tMin, decimalPlaces);
+    *rawMax = toRawClamped(tMax, decimalPlaces);
+    return (*rawMin <= *rawMax) ? 0 : -1;
+  case eMinMax:
+    *rawMin = s->min;
+    *rawMax = s->max;
+    return 0;
+  case eSigma1:
+  case eSigma3:
+    lo = s->mean - (scale == eSigma1 ? 1.0 : 3.0) * s->sigma;
+    hi = s->mean + (scale == eSigma1 ? 1.0 : 3.0) * s->sigma;
+    // The range never exceeds the values present in the image
+    if(lo < s->min) lo = s->min;
+    if(hi > s->max) hi = s->max;
+    *rawMin = (unsigned short)(lo + 0.5);
+    *rawMax = (unsigned short)(hi + 0.5);
+    if(*rawMax < *rawMin) *rawMax = *rawMin;
+    return 0;
+  default:
+    return -1;
+  }
+}
+
+int evo_irimager_palette_apply(const unsigned short* data, int w, int h, int paletteId, unsigned short rawMin, unsigned short rawMax, int layout, unsigned char* out)
+{
+  if(!data || !out || w <= 0 || h <= 0 || paletteId < 1 || paletteId > PALETTE_COUNT || rawMax < rawMin) return -1;
+  if(layout != EVO_PALETTE_INTERLEAVED && layout != EVO_PALETTE_PLANAR) return -1;
+
+  const PaletteTables& t = tables();
+  const IndexMapping mapping(rawMin, rawMax);
+  const size_t n = (size_t)w * h;
+  unsigned char idx[CHUNK];
+  for(size_t i = 0; i < n; i += CHUNK)
+  {
+    const size_t count = (n - i < (size_t)CHUNK) ? n - i : CHUNK;
+    indices(data + i, count, mapping, idx);
+    if(layout == EVO_PALETTE_INTERLEAVED)
+    {
+      const unsigned char* lut = t.interleaved[paletteId - 1];
+      unsigned char* o = out + i * 3;
+      for(size_t k = 0; k < count; k++, o += 3)
+      {
+        const unsigned char* c = lut + idx[k] * 3;
+        o[0] = c[0];
+        o[1] = c[1];
+        o[2] = c[2];
+      }
+    }
+    else
+    {
+      for(int c = 0; c < 3; c++)
+      {
+        const unsigned char* lut = t.planar[paletteId - 1][c];
+        unsigned char* o = out + c * n + i;
+        for(size_t k = 0; k < count; k++)
+          o[k] = lut[idx[k]];
+      }
+    }
+  }
+  return 0;
+}
+
+int evo_irimager_palette_render(const unsigned short* data, int w, int h, int paletteId, int scale, float tMin, float tMax, short decimalPlaces, int layout, unsigned char* out)
+{
+  if(!data || w <= 0 || h <= 0) return -1;
+  EvoIRThermalStats s;
+  if(scale != eManual) stats(data, (size_t)w * h, &s);
+  unsigned short rawMin, rawMax;
+  if(evo_irimager_palette_scale_range(&s, scale, tMin, tMax, decimalPlaces, &rawMin, &rawMax) != 0) return -1;
+  return evo_irimager_palette_apply(data, w, h, paletteId, rawMin, rawMax, layout, out);
+}
+
+int evo_irimager_palette_get_colors(int paletteId, unsigned char* rgb)
+{
+  if(!rgb || paletteId < 1 || paletteId > PALETTE_COUNT) return -1;
+  const unsigned char* lut = tables().interleaved[paletteId - 1];
+  for(int i = 0; i < PALETTE_SIZE * 3; i++) rgb[i] = lut[i];
+  return 0;
+}
@@ -0,0 +1,156 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRPalette.h
+ * @brief Provides temperature conversion and false color rendering of thermal images
+ *
+ * Open counterpart of the palette rendering of the library: conversion of raw
+ * thermal images to degree Celsius, image statistics and coloring with the
+ * palettes and scaling methods known from evo_irimager_set_palette and
+ * evo_irimager_set_palette_scale. The kernels use AVX2 or SSE4.1 if the
+ * processor supports them and fall back to plain C++ otherwise.
+ *
+ * Raw values relate to temperatures as
+ * t = raw / 10^decimalPlaces - 100
+ * i.e. t = ((double)raw - 1000.0) / 10.0 for the default of one decimal place
+ * and t = ((double)raw - 10000.0) / 100.0 with high precision enabled for
+ * cameras providing two decimal places (IRImager::getTemprangeDecimal()).
+ *
+ * The color tables are modeled after the palettes of the library, they are
+ * not guaranteed to match its output value by value.
+ */
+
+#ifndef EVOIRPALETTE_H_
+#define EVOIRPALETTE_H_
+
+#include "irdirectsdk_defs.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Memory layout of rendered palette images
+ */
+typedef enum
+{
+  EVO_PALETTE_INTERLEAVED = 0, /*!< r,g,b,r,g,b,... (size of 3 * w * h), same as evo_irimager_get_palette_image */
+  EVO_PALETTE_PLANAR      = 1  /*!< w * h red values, followed by w * h green and w * h blue values */
+} EvoIRPaletteLayout;
+
+/**
+ * @brief Instruction set used by the kernels
+ */
+typedef enum
+{
+  EVO_SIMD_NONE  = 0,
+  EVO_SIMD_SSE41 = 1,
+  EVO_SIMD_AVX2  = 2
+} EvoIRSimdLevel;
+
+typedef struct __IRDIRECTSDK_API__ EvoIRThermalStats
+{
+  unsigned short min; /*!< Minimum raw value */
+  unsigned short max; /*!< Maximum raw value */
+  double mean;        /*!< Mean raw value */
+  double sigma;       /*!< Standard deviation of raw values */
+} EvoIRThermalStats;
+
+/**
+ * @brief Accessor to the instruction set used by the kernels
+ * @param[out] level see EvoIRSimdLevel
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_get_simd_level(int* level);
+
+/**
+ * @brief Restricts the instruction set used by the kernels, e.g. to compare against the plain C++ implementation.
+ * Levels not supported by the processor are reduced to the highest supported one.
+ * @param[in] level see EvoIRSimdLevel
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_set_simd_level(int level);
+
+/**
+ * @brief Converts a raw thermal image to temperatures in degree Celsius
+ * @param[in] data thermal image (size of w * h)
+ * @param[in] w image width
+ * @param[in] h image height
+ * @param[in] decimalPlaces decimal places of raw values, 1 by default, 2 for high precision [1; 4]
+ * @param[out] out pointer to float array allocate by the user (size of w * h)
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_thermal_to_celsius(const unsigned short* data, int w, int h, short decimalPlaces, float* out);
+
+/**
+ * @brief Computes minimum, maximum, mean and standard deviation of a raw thermal image in a single pass
+ * @param[in] data thermal image (size of w * h)
+ * @param[in] w image width
+ * @param[in] h image height
+ * @param[out] stats pointer to EvoIRThermalStats allocate by the user
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_thermal_stats(const unsigned short* data, int w, int h, EvoIRThermalStats* stats);
+
+/**
+ * @brief Determines the raw value range mapped onto the palette
+ * @param[in] stats statistics of the image, see evo_irimager_thermal_stats (not used for eManual)
+ * @param[in] scale scaling method id, see evo_irimager_set_palette_scale (eManual = 1, eMinMax = 2, eSigma1 = 3, eSigma3 = 4)
+ * @param[in] tMin minimum temperature for eManual
+ * @param[in] tMax maximum temperature for eManual
+ * @param[in] decimalPlaces decimal places of raw values [1; 4]
+ * @param[out] rawMin raw value mapped onto the first palette color
+ * @param[out] rawMax raw value mapped onto the last palette color
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_palette_scale_range(const EvoIRThermalStats* stats, int scale, float tMin, float tMax, short decimalPlaces, unsigned short* rawMin, unsigned short* rawMax);
+
+/**
+ * @brief Colors a raw thermal image with a palette, values outside [rawMin; rawMax] are clamped
+ * @param[in] data thermal image (size of w * h)
+ * @param[in] w image width
+ * @param[in] h image height
+ * @param[in] paletteId palette id, see evo_irimager_set_palette (eAlarmBlue = 1 ... eAlarmRed = 11)
+ * @param[in] rawMin raw value mapped onto the first palette color
+ * @param[in] rawMax raw value mapped onto the last palette color
+ * @param[in] layout memory layout of output, see EvoIRPaletteLayout
+ * @param[out] out pointer to unsigned char array allocate by the user (size of 3 * w * h)
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_palette_apply(const unsigned short* data, int w, int h, int paletteId, unsigned short rawMin, unsigned short rawMax, int layout, unsigned char* out);
+
+/**
+ * @brief Colors a raw thermal image like the library does for evo_irimager_get_palette_image,
+ * i.e. statistics, scaling and palette lookup in one call
+ * @param[in] data thermal image (size of w * h)
+ * @param[in] w image width
+ * @param[in] h image height
+ * @param[in] paletteId palette id, see evo_irimager_set_palette
+ * @param[in] scale scaling method id, see evo_irimager_set_palette_scale
+ * @param[in] tMin minimum temperature for eManual
+ * @param[in] tMax maximum temperature for eManual
+ * @param[in] decimalPlaces decimal places of raw values [1; 4]
+ * @param[in] layout memory layout of output, see EvoIRPaletteLayout
+ * @param[out] out pointer to unsigned char array allocate by the user (size of 3 * w * h)
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_palette_render(const unsigned short* data, int w, int h, int paletteId, int scale, float tMin, float tMax, short decimalPlaces, int layout, unsigned char* out);
+
+/**
+ * @brief Accessor to the color table of a palette
+ * @param[in] paletteId palette id, see evo_irimager_set_palette
+ * @param[out] rgb pointer to unsigned char array allocate by the user (size of 3 * 256), r,g,b
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_palette_get_colors(int paletteId, unsigned char* rgb);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* EVOIRPALETTE_H_ */
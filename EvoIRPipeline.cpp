@@ -0,0 +1,510 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRPipeline.cpp
+ * @brief Acquire/convert/present pipeline
+ *
+ * Frames live in a fixed pool of buffers which move between the free list,
+ * the convert queue, the present mailbox and the caller. The pool holds one
+ * buffer per queue entry plus one for each stage and the mailbox, so the
+ * acquire stage always finds a free buffer without waiting.
+ */
+
+#include "EvoIRPipeline.h"
+#include "EvoIRSyntheticSource.h"
+#include "EvoIRTemporalFilter.h"
+#include "direct_binding.h"
+#include "EvoIRHandleTable.h"
+#include "EvoIRLogHistogram.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace evo
+{
+
+class EvoIRPipeline
+{
+public:
+  typedef std::function<int(unsigned short*, unsigned char*, EvoIRFrameMetadata*)> GrabFunction;
+
+  /**
+   * @param[in] filterId temporal filter applied by the convert stage, owned by the pipeline, NONE for no filter
+   */
+  EvoIRPipeline(int w, int h, const EvoIRPipelineParams& params, unsigned int filterId) :
+    _width(w),
+    _height(h),
+    _params(params),
+    _filterId(filterId),
+    _paletteWidth(0),
+    _paletteHeight(0),
+    _render(false),
+    _running(false),
+    _mailbox(NONE),
+    _held(NONE),
+    _heldSince(0),
+    _sequence(0),
+    _paletteId(6),
+    _scale(2),
+    _tMin(20.f),
+    _tMax(40.f)
+  {
+    resetStats();
+  }
+
+  ~EvoIRPipeline()
+  {
+    stop();
+    if(_filterId != NONE) evo_irimager_temporal_destroy(_filterId);
+  }
+
+  static const unsigned int NONE = ~0u;
+
+  int width() const { return _width; }
+  int height() const { return _height; }
+
+  /**
+   * @param[in] paletteWidth width of palette images delivered by grab, 0 if grab only fetches thermal images
+   */
+  bool start(const GrabFunction& grab, int paletteWidth, int paletteHeight)
+  {
+    std::lock_guard<std::mutex> control(_controlMutex);
+    if(_running.load() || _held != NONE) return false;
+
+    // palette images of the library would not show the filtered image
+    _render        = _params.renderPalette || paletteWidth <= 0 || _filterId != NONE;
+    _paletteWidth  = _render ? _width : paletteWidth;
+    _paletteHeight = _render ? _height : paletteHeight;
+
+    const size_t pixels = (size_t)_width * _height;
+    _buffers.resize(_params.queueFrames + 4);
+    _free.clear();
+    _queue.clear();
+    for(unsigned int i = 0; i < _buffers.size(); i++)
+    {
+      Buffer& b = _buffers[i];
+      b.thermal.resize(pixels);
+      b.temperatures.resize(_params.temperatures ? pixels : 0);
+      b.palette.resize((size_t)_paletteWidth * _paletteHeight * 3);
+      _free.push_back(i);
+    }
+    _mailbox = NONE;
+    if(_filterId != NONE) evo_irimager_temporal_reset(_filterId);
+
+    _running.store(true);
+    _acquireThread = std::thread(&EvoIRPipeline::acquireLoop, this, grab);
+    _convertThread = std::thread(&EvoIRPipeline::convertLoop, this);
+    return true;
+  }
+
+  bool stop()
+  {
+    std::lock_guard<std::mutex> control(_controlMutex);
+    if(!_running.load()) return false;
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _running.store(false);
+      _convertCond.notify_all();
+      _presentCond.notify_all();
+    }
+    _acquireThread.join();
+    _convertThread.join();
+
+    // a converted frame not taken yet is discarded like the queued ones
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(_mailbox != NONE) _free.push_back(_mailbox);
+    _mailbox = NONE;
+    return true;
+  }
+
+  void setPalette(int paletteId, int scale, float tMin, float tMax)
+  {
+    std::lock_guard<std::mutex> lock(_paletteMutex);
+    _paletteId = paletteId;
+    _scale     = scale;
+    _tMin      = tMin;
+    _tMax      = tMax;
+  }
+
+  int acquireFrame(int timeoutMs, EvoIRPipelineFrame* frame)
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if(_held != NONE) return -1;
+    const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs > 0 ? timeoutMs : 0);
+    while(_mailbox == NONE)
+    {
+      if(!_running.load()) return -1;
+      if(timeoutMs < 0)
+        _presentCond.wait(lock);
+      else if(_presentCond.wait_until(lock, deadline) == std::cv_status::timeout && _mailbox == NONE)
+        return -3;
+    }
+
+    const unsigned int index = _mailbox;
+    _mailbox   = NONE;
+    _held      = index;
+    _heldSince = hostTime();
+
+    Buffer& b = _buffers[index];
+    _wait[EVO_PIPELINE_PRESENT].record(_heldSince - b.converted);
+    _latency.record(_heldSince - b.grabbed);
+
+    frame->sequence      = b.sequence;
+    frame->width         = _width;
+    frame->height        = _height;
+    frame->thermal       = &b.thermal[0];
+    frame->temperatures  = b.temperatures.empty() ? NULL : &b.temperatures[0];
+    frame->paletteWidth  = _paletteWidth;
+    frame->paletteHeight = _paletteHeight;
+    frame->palette       = &b.palette[0];
+    frame->metadata      = b.metadata;
+    frame->stats         = b.stats;
+    frame->latency       = _heldSince - b.grabbed;
+    frame->buffer        = index;
+    return 0;
+  }
+
+  bool releaseFrame(unsigned int index)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(index == NONE || index != _held) return false;
+    _busy[EVO_PIPELINE_PRESENT].record(hostTime() - _heldSince);
+    _frames[EVO_PIPELINE_PRESENT].fetch_add(1, std::memory_order_relaxed);
+    _held = NONE;
+    _free.push_back(index);
+    return true;
+  }
+
+  void stats(EvoIRPipelineStats* stats) const
+  {
+    for(int i = 0; i < EVO_PIPELINE_STAGES; i++)
+    {
+      EvoIRPipelineStageStats& s = stats->stages[i];
+      s.frames  = _frames[i].load(std::memory_order_relaxed);
+      s.dropped = _dropped[i].load(std::memory_order_relaxed);
+      s.failed  = _failed[i].load(std::memory_order_relaxed);
+      _wait[i].snapshot(&s.wait);
+      _busy[i].snapshot(&s.busy);
+    }
+    _latency.snapshot(&stats->latency);
+  }
+
+  void resetStats()
+  {
+    for(int i = 0; i < EVO_PIPELINE_STAGES; i++)
+    {
+      _frames[i].store(0);
+      _dropped[i].store(0);
+      _failed[i].store(0);
+      _wait[i].reset();
+      _busy[i].reset();
+    }
+    _latency.reset();
+  }
+
+private:
+  struct Buffer
+  {
+    std::vector<unsigned short> thermal;
+    std::vector<float> temperatures;
+    std::vector<unsigned char> palette;
+    EvoIRFrameMetadata metadata;
+    EvoIRThermalStats stats;
+    unsigned long long sequence;
+    long long grabbed;
+    long long converted;
+  };
+
+  void acquireLoop(GrabFunction grab)
+  {
+    while(_running.load(std::memory_order_relaxed))
+    {
+      unsigned int index;
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        index = _free.front();
+        _free.pop_front();
+      }
+
+      Buffer& b = _buffers[index];
+      const long long t0 = hostTime();
+      const int ret      = grab(&b.thermal[0], _render ? NULL : &b.palette[0], &b.metadata);
+      const long long t1 = hostTime();
+
+      if(ret != 0)
+      {
+        _failed[EVO_PIPELINE_ACQUIRE].fetch_add(1, std::memory_order_relaxed);
+        {
+          std::lock_guard<std::mutex> lock(_mutex);
+          _free.push_back(index);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        continue;
+      }
+      _busy[EVO_PIPELINE_ACQUIRE].record(t1 - t0);
+      _frames[EVO_PIPELINE_ACQUIRE].fetch_add(1, std::memory_order_relaxed);
+      b.grabbed = t1;
+
+      std::lock_guard<std::mutex> lock(_mutex);
+      b.sequence = ++_sequence;
+      // never wait for the convert stage, drop the oldest queued frame instead
+      if(_queue.size() >= _params.queueFrames)
+      {
+        _free.push_back(_queue.front());
+        _queue.pop_front();
+        _dropped[EVO_PIPELINE_CONVERT].fetch_add(1, std::memory_order_relaxed);
+      }
+      _queue.push_back(index);
+      _convertCond.notify_one();
+    }
+  }
+
+  void convertLoop()
+  {
+    const size_t pixels = (size_t)_width * _height;
+    while(true)
+    {
+      unsigned int index;
+      {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while(_running.load() && _queue.empty())
+          _convertCond.wait(lock);
+        if(!_running.load()) break;
+        index = _queue.front();
+        _queue.pop_front();
+      }
+
+      Buffer& b = _buffers[index];
+      const long long t0 = hostTime();
+      _wait[EVO_PIPELINE_CONVERT].record(t0 - b.grabbed);
+
+      if(_filterId != NONE)
+        evo_irimager_temporal_process(_filterId, &b.thermal[0], &b.metadata, &b.thermal[0], 0);
+      evo_irimager_thermal_stats(&b.thermal[0], _width, _height, &b.stats);
+      if(!b.temperatures.empty())
+        evo_irimager_thermal_to_celsius(&b.thermal[0], _width, _height, _params.decimalPlaces, &b.temperatures[0]);
+      if(_render)
+      {
+        int paletteId, scale;
+        float tMin, tMax;
+        {
+          std::lock_guard<std::mutex> lock(_paletteMutex);
+          paletteId = _paletteId;
+          scale     = _scale;
+          tMin      = _tMin;
+          tMax      = _tMax;
+        }
+        // reuse the statistics instead of evo_irimager_palette_render computing them again
+        unsigned short rawMin, rawMax;
+        if(evo_irimager_palette_scale_range(&b.stats, scale, tMin, tMax, _params.decimalPlaces, &rawMin, &rawMax) != 0
+           || evo_irimager_palette_apply(&b.thermal[0], _width, _height, paletteId, rawMin, rawMax, _params.layout, &b.palette[0]) != 0)
+          std::memset(&b.palette[0], 0, pixels * 3);
+      }
+
+      b.converted = hostTime();
+      _busy[EVO_PIPELINE_CONVERT].record(b.converted - t0);
+      _frames[EVO_PIPELINE_CONVERT].fetch_add(1, std::memory_order_relaxed);
+
+      std::lock_guard<std::mutex> lock(_mutex);
+      if(_mailbox != NONE)
+      {
+        _free.push_back(_mailbox);
+        _dropped[EVO_PIPELINE_PRESENT].fetch_add(1, std::memory_order_relaxed);
+      }
+      _mailbox = index;
+      _presentCond.notify_all();
+    }
+  }
+
+  EvoIRPipeline(const EvoIRPipeline&);
+  EvoIRPipeline& operator=(const EvoIRPipeline&);
+
+  const int _width;
+  const int _height;
+  const EvoIRPipelineParams _params;
+  const unsigned int _filterId;
+  int _paletteWidth;
+  int _paletteHeight;
+  bool _render;
+
+  std::mutex _controlMutex;
+  std::atomic<bool> _running;
+  std::thread _acquireThread;
+  std::thread _convertThread;
+
+  // buffer ownership, guarded by _mutex
+  std::mutex _mutex;
+  std::condition_variable _convertCond;
+  std::condition_variable _presentCond;
+  std::vector<Buffer> _buffers;
+  std::deque<unsigned int> _free;
+  std::deque<unsigned int> _queue;
+  unsigned int _mailbox;
+  unsigned int _held;
+  long long _heldSince;
+  unsigned long long _sequence;
+
+  std::mutex _paletteMutex;
+  int _paletteId;
+  int _scale;
+  float _tMin;
+  float _tMax;
+
+  std::atomic<unsigned long long> _frames[EVO_PIPELINE_STAGES];
+  std::atomic<unsigned long long> _dropped[EVO_PIPELINE_STAGES];
+  std::atomic<unsigned long long> _failed[EVO_PIPELINE_STAGES];
+  LogHistogram _wait[EVO_PIPELINE_STAGES];
+  LogHistogram _busy[EVO_PIPELINE_STAGES];
+  LogHistogram _latency;
+};
+
+static EvoIRHandleTable<EvoIRPipeline> g_pipelines;
+typedef EvoIRHandleTable<EvoIRPipeline>::Ref PipelineRef;
+
+} // namespace evo
+
+using namespace evo;
+
+void evo_irimager_pipeline_default_params(EvoIRPipelineParams* params)
+{
+  if(!params) return;
+  params->queueFrames    = 2;
+  params->temperatures   = 1;
+  params->renderPalette  = 0;
+  params->layout         = EVO_PALETTE_INTERLEAVED;
+  params->decimalPlaces  = 1;
+  params->temporalMode   = EVO_TEMPORAL_NONE;
+  params->temporalLength = 1;
+}
+
+int evo_irimager_pipeline_create(unsigned int* outPipeId, int w, int h, const EvoIRPipelineParams* params)
+{
+  if(!outPipeId || !params || w <= 0 || h <= 0 || params->queueFrames < 1) return -1;
+  if(params->decimalPlaces < 1 || params->decimalPlaces > 4) return -1;
+  if(params->layout != EVO_PALETTE_INTERLEAVED && params->layout != EVO_PALETTE_PLANAR) return -1;
+  unsigned int filterId = EvoIRPipeline::NONE;
+  if(params->temporalMode != EVO_TEMPORAL_NONE)
+  {
+    EvoIRTemporalParams filter;
+    evo_irimager_temporal_default_params(&filter, w, h, params->temporalMode, params->temporalLength);
+    if(evo_irimager_temporal_create(&filterId, &filter) != 0) return -1;
+  }
+  EvoIRPipeline* pipeline = new EvoIRPipeline(w, h, *params, filterId);
+  if(!g_pipelines.insert(pipeline, outPipeId))
+  {
+    delete pipeline;
+    return -1;
+  }
+  return 0;
+}
+
+int evo_irimager_pipeline_destroy(const unsigned int pipeId)
+{
+  {
+    // callers waiting in acquire_frame hold references, stopping wakes them before remove waits for the references
+    PipelineRef pipeline = g_pipelines.acquire(pipeId);
+    if(!pipeline) return -1;
+    pipeline->stop();
+  }
+  EvoIRPipeline* pipeline = g_pipelines.remove(pipeId);
+  if(!pipeline) return -1;
+  delete pipeline;
+  return 0;
+}
+
+int evo_irimager_pipeline_start_capture(const unsigned int pipeId)
+{
+  PipelineRef pipeline = g_pipelines.acquire(pipeId);
+  if(!pipeline) return -1;
+  int w, h, pw, ph;
+  if(evo_irimager_get_thermal_image_size(&w, &h) != 0 || w != pipeline->width() || h != pipeline->height()) return -1;
+  if(evo_irimager_get_palette_image_size(&pw, &ph) != 0 || pw <= 0 || ph <= 0) return -1;
+  return pipeline->start([w, h, pw, ph](unsigned short* thermal, unsigned char* palette, EvoIRFrameMetadata* metadata) {
+    if(palette) return evo_irimager_get_thermal_palette_image_metadata(w, h, thermal, pw, ph, palette, metadata);
+    int tw = w, th = h;
+    return evo_irimager_get_thermal_image_metadata(&tw, &th, thermal, metadata);
+  }, pw, ph) ? 0 : -1;
+}
+
+int evo_irimager_pipeline_start_multi_capture(const unsigned int pipeId, const unsigned int camId)
+{
+  PipelineRef pipeline = g_pipelines.acquire(pipeId);
+  if(!pipeline) return -1;
+  int w, h, pw, ph;
+  if(evo_irimager_multi_get_thermal_image_size(camId, &w, &h) != 0 || w != pipeline->width() || h != pipeline->height()) return -1;
+  if(evo_irimager_multi_get_palette_image_size(camId, &pw, &ph) != 0 || pw <= 0 || ph <= 0) return -1;
+  return pipeline->start([camId, w, h, pw, ph](unsigned short* thermal, unsigned char* palette, EvoIRFrameMetadata* metadata) {
+    if(palette) return evo_irimager_multi_get_thermal_palette_image_metadata(camId, w, h, thermal, pw, ph, palette, metadata);
+    int tw = w, th = h;
+    return evo_irimager_multi_get_thermal_image_metadata(camId, &tw, &th, thermal, metadata);
+  }, pw, ph) ? 0 : -1;
+}
+
+int evo_irimager_pipeline_start_synthetic(const unsigned int pipeId, const unsigned int srcId)
+{
+  PipelineRef pipeline = g_pipelines.acquire(pipeId);
+  if(!pipeline) return -1;
+  int w, h;
+  if(evo_irimager_synthetic_get_thermal_image_size(srcId, &w, &h) != 0 || w != pipeline->width() || h != pipeline->height()) return -1;
+  return pipeline->start([srcId, w, h](unsigned short* thermal, unsigned char*, EvoIRFrameMetadata* metadata) {
+    int tw = w, th = h;
+    return evo_irimager_synthetic_get_thermal_image_metadata(srcId, &tw, &th, thermal, metadata);
+  }, 0, 0) ? 0 : -1;
+}
+
+int evo_irimager_pipeline_stop(const unsigned int pipeId)
+{
+  PipelineRef pipeline = g_pipelines.acquire(pipeId);
+  if(!pipeline) return -1;
+  return pipeline->stop() ? 0 : -1;
+}
+
+int evo_irimager_pipeline_set_palette(const unsigned int pipeId, int paletteId, int scale, float tMin, float tMax)
+{
+  PipelineRef pipeline = g_pipelines.acquire(pipeId);
+  if(!pipeline || paletteId < 1 || paletteId > 11 || scale < 1 || scale > 4) return -1;
+  pipeline->setPalette(paletteId, scale, tMin, tMax);
+  return 0;
+}
+
+int evo_irimager_pipeline_acquire_frame(const unsigned int pipeId, int timeoutMs, EvoIRPipelineFrame* frame)
+{
+  PipelineRef pipeline = g_pipelines.acquire(pipeId);
+  if(!pipeline || !frame) return -1;
+  return pipeline->acquireFrame(timeoutMs, frame);
+}
+
+int evo_irimager_pipeline_release_frame(const unsigned int pipeId, const unsigned int buffer)
+{
+  PipelineRef pipeline = g_pipelines.acquire(pipeId);
+  if(!pipeline) return -1;
+  return pipeline->releaseFrame(buffer) ? 0 : -1;
+}
+
+int evo_irimager_pipeline_get_stats(const unsigned int pipeId, EvoIRPipelineStats* stats)
+{
+  PipelineRef pipeline = g_pipelines.acquire(pipeId);
+  if(!pipeline || !stats) return -1;
+  pipeline->stats(stats);
+  return 0;
+}
+
+int evo_irimager_pipeline_reset_stats(const unsigned int pipeId)
+{
+  PipelineRef pipeline = g_pipelines.acquire(pipeId);
+  if(!pipeline) return -1;
+  pipeline->resetStats();
+  return 0;
+}
@@ -0,0 +1,213 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRPipeline.h
+ * @brief Provides a staged acquire/convert/present pipeline for viewers for Easy API C-Library Interface
+ *
+ * A viewer loop calling evo_irimager_get_palette_image, then
+ * evo_irimager_get_thermal_image and then drawing adds the drawing time to the
+ * time until the next frame is fetched. The pipeline decouples this:
+ *
+ * - acquire: own thread fetching thermal and palette image of a frame with a
+ *   single evo_irimager_get_thermal_palette_image_metadata call
+ * - convert: own thread applying the optional temporal filter (see
+ *   EvoIRTemporalFilter.h), computing statistics, temperatures in degree
+ *   Celsius and, if requested, the palette image (see EvoIRPalette.h)
+ * - present: the caller, taking the most recent converted frame with
+ *   evo_irimager_pipeline_acquire_frame
+ *
+ * Stages are connected by bounded queues. No stage ever waits for a later
+ * one: if the convert queue is full, the oldest frame in it is dropped; a
+ * converted frame not taken by the caller before the next one is ready is
+ * dropped as stale. Frames are delivered in place and stay valid until
+ * release.
+ *
+ * @code
+ * EvoIRPipelineParams params;
+ * evo_irimager_pipeline_default_params(&params);
+ * evo_irimager_pipeline_create(&pipeId, w, h, &params);
+ * evo_irimager_pipeline_start_capture(pipeId);
+ * EvoIRPipelineFrame frame;
+ * while(evo_irimager_pipeline_acquire_frame(pipeId, 1000, &frame) == 0)
+ * {
+ *   // draw frame.palette ...
+ *   evo_irimager_pipeline_release_frame(pipeId, frame.buffer);
+ * }
+ * @endcode
+ */
+
+#ifndef EVOIRPIPELINE_H_
+#define EVOIRPIPELINE_H_
+
+#include "irdirectsdk_defs.h"
+#include "EvoIRFrameMetadata.h"
+#include "EvoIRHistogram.h"
+#include "EvoIRPalette.h"
+#include "EvoIRTemporalFilter.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Pipeline stages, index of EvoIRPipelineStats::stages
+ */
+typedef enum
+{
+  EVO_PIPELINE_ACQUIRE = 0,
+  EVO_PIPELINE_CONVERT = 1,
+  EVO_PIPELINE_PRESENT = 2,
+  EVO_PIPELINE_STAGES  = 3
+} EvoIRPipelineStage;
+
+typedef struct __IRDIRECTSDK_API__ EvoIRPipelineParams
+{
+  unsigned int queueFrames; /*!< Capacity of the queue between acquire and convert stage */
+  int temperatures;         /*!< 1: convert stage fills EvoIRPipelineFrame::temperatures */
+  int renderPalette;        /*!< 1: convert stage renders the palette image instead of fetching it from the library, always done for synthetic sources */
+  int layout;               /*!< Memory layout of rendered palette images, see EvoIRPaletteLayout. Images of the library are always interleaved. */
+  short decimalPlaces;      /*!< Decimal places of raw values [1; 4], see evo_irimager_thermal_to_celsius */
+  int temporalMode;         /*!< Temporal filter applied to thermal images by the convert stage, see EvoIRTemporalMode. Palette images are then always rendered. */
+  int temporalLength;       /*!< Number of frames of the temporal filter, see EvoIRTemporalMode */
+} EvoIRPipelineParams;
+
+/**
+ * @brief Frame delivered by evo_irimager_pipeline_acquire_frame. Buffers stay valid until release.
+ */
+typedef struct __IRDIRECTSDK_API__ EvoIRPipelineFrame
+{
+  unsigned long long sequence;  /*!< Consecutive number assigned by the acquire stage, gaps indicate dropped frames */
+  int width;                    /*!< Thermal image width */
+  int height;                   /*!< Thermal image height */
+  unsigned short* thermal;      /*!< Thermal image (size of width * height) */
+  float* temperatures;          /*!< Temperatures in degree Celsius (size of width * height), NULL if disabled */
+  int paletteWidth;             /*!< Palette image width */
+  int paletteHeight;            /*!< Palette image height */
+  unsigned char* palette;       /*!< Palette image (size of 3 * paletteWidth * paletteHeight) */
+  EvoIRFrameMetadata metadata;  /*!< Frame metadata */
+  EvoIRThermalStats stats;      /*!< Statistics of the thermal image */
+  long long latency;            /*!< Time from the return of the grab call until delivery in UNITS (10000000 per second) */
+  unsigned int buffer;          /*!< Internal buffer reference */
+} EvoIRPipelineFrame;
+
+typedef struct __IRDIRECTSDK_API__ EvoIRPipelineStageStats
+{
+  unsigned long long frames;  /*!< Frames completed by the stage */
+  unsigned long long dropped; /*!< Frames discarded in front of the stage: queue overflow (convert), stale frames (present) */
+  unsigned long long failed;  /*!< Failed grab calls (acquire) */
+  EvoIRHistogram wait;        /*!< Time a frame waited in front of the stage (convert, present) */
+  EvoIRHistogram busy;        /*!< Time spent in the stage: grab call, conversion, caller holding the frame */
+} EvoIRPipelineStageStats;
+
+typedef struct __IRDIRECTSDK_API__ EvoIRPipelineStats
+{
+  EvoIRPipelineStageStats stages[EVO_PIPELINE_STAGES]; /*!< Per stage counters, see EvoIRPipelineStage */
+  EvoIRHistogram latency;                              /*!< Time from the return of the grab call until delivery to the caller */
+} EvoIRPipelineStats;
+
+/**
+ * @brief Fills parameter structure with defaults (queue of 2 frames, temperatures enabled, palette image of the library, one decimal place, no temporal filter)
+ * @param[out] params parameter structure
+ */
+__IRDIRECTSDK_API__ void evo_irimager_pipeline_default_params(EvoIRPipelineParams* params);
+
+/**
+ * @brief Creates a pipeline
+ * @param[out] outPipeId pipeline instance id for reference
+ * @param[in] w thermal image width
+ * @param[in] h thermal image height
+ * @param[in] params pipeline parameters
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_pipeline_create(unsigned int* outPipeId, int w, int h, const EvoIRPipelineParams* params);
+
+/**
+ * @brief Stops the pipeline and releases it. Frames held by the caller become invalid.
+ * @param[in] pipeId pipeline instance id from create to apply this function
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_pipeline_destroy(const unsigned int pipeId);
+
+/**
+ * @brief Starts the pipeline on the camera initialized by evo_irimager_usb_init / evo_irimager_tcp_init
+ * @param[in] pipeId pipeline instance id from create to apply this function
+ * @return 0 on success, -1 on error (image size mismatch, already running)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_pipeline_start_capture(const unsigned int pipeId);
+
+/**
+ * @brief Starts the pipeline on a camera initialized by evo_irimager_multi_usb_init / evo_irimager_multi_tcp_init
+ * @param[in] pipeId pipeline instance id from create to apply this function
+ * @param[in] camId camera instance id
+ * @return 0 on success, -1 on error (image size mismatch, already running)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_pipeline_start_multi_capture(const unsigned int pipeId, const unsigned int camId);
+
+/**
+ * @brief Starts the pipeline on a synthetic frame source (see EvoIRSyntheticSource.h), palette images are rendered
+ * @param[in] pipeId pipeline instance id from create to apply this function
+ * @param[in] srcId synthetic source instance id
+ * @return 0 on success, -1 on error (image size mismatch, already running)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_pipeline_start_synthetic(const unsigned int pipeId, const unsigned int srcId);
+
+/**
+ * @brief Stops the stage threads. Queued frames are discarded.
+ * @param[in] pipeId pipeline instance id from create to apply this function
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_pipeline_stop(const unsigned int pipeId);
+
+/**
+ * @brief Sets palette and scaling of rendered palette images, takes effect with the next converted frame
+ * @param[in] pipeId pipeline instance id from create to apply this function
+ * @param[in] paletteId palette id, see evo_irimager_set_palette
+ * @param[in] scale scaling method id, see evo_irimager_set_palette_scale
+ * @param[in] tMin minimum temperature for eManual
+ * @param[in] tMax maximum temperature for eManual
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_pipeline_set_palette(const unsigned int pipeId, int paletteId, int scale, float tMin, float tMax);
+
+/**
+ * @brief Takes the most recent converted frame. Only one frame can be held at a time.
+ * @param[in] pipeId pipeline instance id from create to apply this function
+ * @param[in] timeoutMs time to wait for a new frame in milliseconds, 0 polls, negative values wait infinitely
+ * @param[out] frame pointer to EvoIRPipelineFrame allocate by the user
+ * @return 0 on success, -1 on error (not running, frame still held), -3 if no new frame was converted within timeout
+ */
+__IRDIRECTSDK_API__ int evo_irimager_pipeline_acquire_frame(const unsigned int pipeId, int timeoutMs, EvoIRPipelineFrame* frame);
+
+/**
+ * @brief Hands a frame back to the pipeline
+ * @param[in] pipeId pipeline instance id from create to apply this function
+ * @param[in] buffer EvoIRPipelineFrame::buffer of the acquired frame
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_pipeline_release_frame(const unsigned int pipeId, const unsigned int buffer);
+
+/**
+ * @brief Accessor to per stage counters and timings
+ * @param[in] pipeId pipeline instance id from create to apply this function
+ * @param[out] stats pointer to EvoIRPipelineStats allocate by the user
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_pipeline_get_stats(const unsigned int pipeId, EvoIRPipelineStats* stats);
+
+/**
+ * @brief Resets all counters and timings
+ * @param[in] pipeId pipeline instance id from create to apply this function
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_pipeline_reset_stats(const unsigned int pipeId);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* EVOIRPIPELINE_H_ */
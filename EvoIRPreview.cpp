@@ -0,0 +1,802 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRPreview.cpp
+ * @brief Min/max pyramid, tile change detection and packets of the preview
+ *
+ * Packet layout, little endian:
+ * @code
+ * PreviewPacketHeader               80 bytes
+ * PreviewTileHeader | payload       12 bytes | size bytes, one per tile
+ * ...
+ * @endcode
+ *
+ * Tiles are numbered by column and row within their level; tiles at the
+ * right and bottom border are cut to the level. The payload holds the tile
+ * pixels in row order, for levels above 0 the minimum rows followed by the
+ * maximum rows, either raw (CODEC_RAW) or compressed as one image of tile
+ * width and once or twice the tile height (CODEC_MED, see
+ * EvoIRRecordingFormat.h). Raw is used where compression does not pay off, so
+ * a tile never takes more than its raw size.
+ *
+ * The encoder keeps a copy of every level as sent (the reference) and
+ * compares the tiles in view against it, not against the previous frame, so
+ * slow drifts are sent once they add up to the threshold.
+ */
+
+#include "EvoIRPreview.h"
+#include "EvoIRHandleTable.h"
+#include "EvoIRRecordingFormat.h"
+#include "EvoIRSimd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+namespace evo
+{
+
+namespace
+{
+
+const char           PREVIEW_MAGIC[4] = { 'E', 'V', 'P', 'V' };
+const unsigned short PREVIEW_VERSION  = 1;
+
+struct PreviewPacketHeader
+{
+  char magic[4];
+  unsigned short version;
+  unsigned short levels;
+  unsigned short width;
+  unsigned short height;
+  unsigned short tileSize;
+  unsigned short level;          ///< level of the overview
+  unsigned short regionX;
+  unsigned short regionY;
+  unsigned short regionWidth;    ///< 0 without region
+  unsigned short regionHeight;
+  unsigned int tiles;
+  unsigned int pending;          ///< tiles left for later packets
+  unsigned int size;             ///< bytes of the packet including this header
+  unsigned int reserved;
+  EvoIRFrameMetadata metadata;
+};
+
+struct PreviewTileHeader
+{
+  unsigned char level;
+  unsigned char codec;           ///< RecordingCodec
+  unsigned short tx;
+  unsigned short ty;
+  unsigned short reserved;
+  unsigned int size;             ///< payload bytes
+};
+
+static_assert(sizeof(PreviewPacketHeader) == 80, "unexpected packet header size");
+static_assert(sizeof(PreviewTileHeader) == 12, "unexpected tile header size");
+
+inline int levelSize(int size, int level)
+{
+  return (size + (1 << level) - 1) >> level;
+}
+
+//------------------------------------------------------------------------------
+// plain C++
+//------------------------------------------------------------------------------
+
+/**
+ * One row of level l + 1 from two rows of level l (equal for the last row of odd heights), a last odd column is reduced with itself
+ */
+void reduceScalar(const unsigned short* min0, const unsigned short* min1, const unsigned short* max0, const unsigned short* max1,
+                  int x0, int sw, unsigned short* dMin, unsigned short* dMax)
+{
+  const int dw = (sw + 1) / 2;
+  for(int x = x0; x < dw; x++)
+  {
+    const int i0 = 2 * x;
+    const int i1 = std::min(i0 + 1, sw - 1);
+    dMin[x] = std::min(std::min(min0[i0], min0[i1]), std::min(min1[i0], min1[i1]));
+    dMax[x] = std::max(std::max(max0[i0], max0[i1]), std::max(max1[i0], max1[i1]));
+  }
+}
+
+unsigned short maxDiffScalar(const unsigned short* a, const unsigned short* b, int x0, int w)
+{
+  unsigned short d = 0;
+  for(int x = x0; x < w; x++)
+    d = std::max(d, (unsigned short)(a[x] > b[x] ? a[x] - b[x] : b[x] - a[x]));
+  return d;
+}
+
+#if EVO_SIMD_X86
+
+//------------------------------------------------------------------------------
+// SSE4.1
+//------------------------------------------------------------------------------
+
+EVO_TARGET_SSE41 void reduceSse41(const unsigned short* min0, const unsigned short* min1, const unsigned short* max0, const unsigned short* max1,
+                                  int sw, unsigned short* dMin, unsigned short* dMax)
+{
+  const __m128i low = _mm_set1_epi32(0xFFFF);
+  int x = 0;
+  for(; 2 * x + 16 <= sw; x += 8)
+  {
+    // vertical pairs, then the odd pixel of every horizontal pair is shifted onto the even one
+    __m128i a0 = _mm_min_epu16(_mm_loadu_si128((const __m128i*)(min0 + 2 * x)),     _mm_loadu_si128((const __m128i*)(min1 + 2 * x)));
+    __m128i a1 = _mm_min_epu16(_mm_loadu_si128((const __m128i*)(min0 + 2 * x + 8)), _mm_loadu_si128((const __m128i*)(min1 + 2 * x + 8)));
+    __m128i b0 = _mm_max_epu16(_mm_loadu_si128((const __m128i*)(max0 + 2 * x)),     _mm_loadu_si128((const __m128i*)(max1 + 2 * x)));
+    __m128i b1 = _mm_max_epu16(_mm_loadu_si128((const __m128i*)(max0 + 2 * x + 8)), _mm_loadu_si128((const __m128i*)(max1 + 2 * x + 8)));
+    a0 = _mm_and_si128(_mm_min_epu16(a0, _mm_srli_epi32(a0, 16)), low);
+    a1 = _mm_and_si128(_mm_min_epu16(a1, _mm_srli_epi32(a1, 16)), low);
+    b0 = _mm_and_si128(_mm_max_epu16(b0, _mm_srli_epi32(b0, 16)), low);
+    b1 = _mm_and_si128(_mm_max_epu16(b1, _mm_srli_epi32(b1, 16)), low);
+    _mm_storeu_si128((__m128i*)(dMin + x), _mm_packus_epi32(a0, a1));
+    _mm_storeu_si128((__m128i*)(dMax + x), _mm_packus_epi32(b0, b1));
+  }
+  reduceScalar(min0, min1, max0, max1, x, sw, dMin, dMax);
+}
+
+EVO_TARGET_SSE41 unsigned short maxDiffSse41(const unsigned short* a, const unsigned short* b, int w)
+{
+  __m128i acc = _mm_setzero_si128();
+  int x = 0;
+  for(; x + 8 <= w; x += 8)
+  {
+    const __m128i va = _mm_loadu_si128((const __m128i*)(a + x));
+    const __m128i vb = _mm_loadu_si128((const __m128i*)(b + x));
+    acc = _mm_max_epu16(acc, _mm_or_si128(_mm_subs_epu16(va, vb), _mm_subs_epu16(vb, va)));
+  }
+  // maximum as complement of the minimum of the complements
+  const unsigned short d = (unsigned short)~_mm_cvtsi128_si32(_mm_minpos_epu16(_mm_xor_si128(acc, _mm_set1_epi16(-1))));
+  return std::max(d, maxDiffScalar(a, b, x, w));
+}
+
+//------------------------------------------------------------------------------
+// AVX2
+//------------------------------------------------------------------------------
+
+EVO_TARGET_AVX2 void reduceAvx2(const unsigned short* min0, const unsigned short* min1, const unsigned short* max0, const unsigned short* max1,
+                                int sw, unsigned short* dMin, unsigned short* dMax)
+{
+  const __m256i low = _mm256_set1_epi32(0xFFFF);
+  int x = 0;
+  for(; 2 * x + 32 <= sw; x += 16)
+  {
+    __m256i a0 = _mm256_min_epu16(_mm256_loadu_si256((const __m256i*)(min0 + 2 * x)),      _mm256_loadu_si256((const __m256i*)(min1 + 2 * x)));
+    __m256i a1 = _mm256_min_epu16(_mm256_loadu_si256((const __m256i*)(min0 + 2 * x + 16)), _mm256_loadu_si256((const __m256i*)(min1 + 2 * x + 16)));
+    __m256i b0 = _mm256_max_epu16(_mm256_loadu_si256((const __m256i*)(max0 + 2 * x)),      _mm256_loadu_si256((const __m256i*)(max1 + 2 * x)));
+    __m256i b1 = _mm256_max_epu16(_mm256_loadu_si256((const __m256i*)(max0 + 2 * x + 16)), _mm256_loadu_si256((const __m256i*)(max1 + 2 * x + 16)));
+    a0 = _mm256_and_si256(_mm256_min_epu16(a0, _mm256_srli_epi32(a0, 16)), low);
+    a1 = _mm256_and_si256(_mm256_min_epu16(a1, _mm256_srli_epi32(a1, 16)), low);
+    b0 = _mm256_and_si256(_mm256_max_epu16(b0, _mm256_srli_epi32(b0, 16)), low);
+    b1 = _mm256_and_si256(_mm256_max_epu16(b1, _mm256_srli_epi32(b1, 16)), low);
+    // packing works per 128 bit lane, restore pixel order
+    _mm256_storeu_si256((__m256i*)(dMin + x), _mm256_permute4x64_epi64(_mm256_packus_epi32(a0, a1), 0xD8));
+    _mm256_storeu_si256((__m256i*)(dMax + x), _mm256_permute4x64_epi64(_mm256_packus_epi32(b0, b1), 0xD8));
+  }
+  // remaining pixels of the row
+  reduceScalar(min0, min1, max0, max1, x, sw, dMin, dMax);
+}
+
+EVO_TARGET_AVX2 unsigned short maxDiffAvx2(const unsigned short* a, const unsigned short* b, int w)
+{
+  __m256i acc = _mm256_setzero_si256();
+  int x = 0;
+  for(; x + 16 <= w; x += 16)
+  {
+    const __m256i va = _mm256_loadu_si256((const __m256i*)(a + x));
+    const __m256i vb = _mm256_loadu_si256((const __m256i*)(b + x));
+    acc = _mm256_max_epu16(acc, _mm256_or_si256(_mm256_subs_epu16(va, vb), _mm256_subs_epu16(vb, va)));
+  }
+  const __m128i acc128 = _mm_max_epu16(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+  const unsigned short d = (unsigned short)~_mm_cvtsi128_si32(_mm_minpos_epu16(_mm_xor_si128(acc128, _mm_set1_epi16(-1))));
+  return std::max(d, maxDiffScalar(a, b, x, w));
+}
+
+#endif // EVO_SIMD_X86
+
+void reduce(const unsigned short* min0, const unsigned short* min1, const unsigned short* max0, const unsigned short* max1,
+            int sw, unsigned short* dMin, unsigned short* dMax)
+{
+#if EVO_SIMD_X86
+  const int level = simdLevel();
+  if(level >= SIMD_AVX2)  { reduceAvx2(min0, min1, max0, max1, sw, dMin, dMax); return; }
+  if(level >= SIMD_SSE41) { reduceSse41(min0, min1, max0, max1, sw, dMin, dMax); return; }
+#endif
+  reduceScalar(min0, min1, max0, max1, 0, sw, dMin, dMax);
+}
+
+/**
+ * Largest absolute difference of a rectangle of two planes of equal stride
+ */
+unsigned short maxDiff(const unsigned short* a, const unsigned short* b, int stride, int w, int h)
+{
+  unsigned short d = 0;
+#if EVO_SIMD_X86
+  const int level = simdLevel();
+  if(level >= SIMD_AVX2)
+  {
+    for(int y = 0; y < h; y++) d = std::max(d, maxDiffAvx2(a + (size_t)y * stride, b + (size_t)y * stride, w));
+    return d;
+  }
+  if(level >= SIMD_SSE41)
+  {
+    for(int y = 0; y < h; y++) d = std::max(d, maxDiffSse41(a + (size_t)y * stride, b + (size_t)y * stride, w));
+    return d;
+  }
+#endif
+  for(int y = 0; y < h; y++) d = std::max(d, maxDiffScalar(a + (size_t)y * stride, b + (size_t)y * stride, 0, w));
+  return d;
+}
+
+/**
+ * Pyramid planes, level 0 has a single plane serving as minimum and maximum
+ */
+struct Level
+{
+  int width;
+  int height;
+  int tilesX;
+  int tilesY;
+  std::vector<unsigned short> min;
+  std::vector<unsigned short> max;
+
+  void init(int w, int h, int level, int tileSize)
+  {
+    width  = levelSize(w, level);
+    height = levelSize(h, level);
+    tilesX = (width + tileSize - 1) / tileSize;
+    tilesY = (height + tileSize - 1) / tileSize;
+    min.assign((size_t)width * height, 0);
+    if(level > 0) max.assign((size_t)width * height, 0);
+  }
+
+  int planes() const { return max.empty() ? 1 : 2; }
+  const unsigned short* minPlane() const { return &min[0]; }
+  const unsigned short* maxPlane() const { return max.empty() ? &min[0] : &max[0]; }
+  unsigned short* minPlane() { return &min[0]; }
+  unsigned short* maxPlane() { return max.empty() ? &min[0] : &max[0]; }
+};
+
+void copyLevel(const Level& level, unsigned short* levelMin, unsigned short* levelMax)
+{
+  const size_t bytes = (size_t)level.width * level.height * sizeof(unsigned short);
+  if(levelMin) std::memcpy(levelMin, level.minPlane(), bytes);
+  if(levelMax) std::memcpy(levelMax, level.maxPlane(), bytes);
+}
+
+} // namespace
+
+class EvoIRPreviewEncoder
+{
+public:
+  EvoIRPreviewEncoder(const EvoIRPreviewParams& params) :
+    _params(params),
+    _threshold((unsigned short)std::min(65535.0, std::floor(params.tThreshold * std::pow(10.0, params.decimalPlaces) + 0.5))),
+    _level(params.levels - 1),
+    _regionX(0),
+    _regionY(0),
+    _regionWidth(0),
+    _regionHeight(0)
+  {
+    for(int l = 0; l < params.levels; l++)
+    {
+      _levels[l].init(params.width, params.height, l, params.tileSize);
+      _sent[l].init(params.width, params.height, l, params.tileSize);
+      _tiles[l].assign((size_t)_levels[l].tilesX * _levels[l].tilesY, Tile());
+    }
+    const int ts = params.tileSize;
+    _tile.resize(2 * ts * ts);
+    _encoded.resize(recordingCodecMaxSize(ts, 2 * ts));
+    _scratch.resize(recordingCodecScratchSize(ts, 2 * ts));
+    std::memset(&_stats, 0, sizeof(_stats));
+  }
+
+  const EvoIRPreviewParams& params() const { return _params; }
+
+  void request(int level, int x, int y, int w, int h)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _level        = level;
+    _regionX      = x;
+    _regionY      = y;
+    _regionWidth  = w;
+    _regionHeight = h;
+  }
+
+  void reset()
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for(int l = 0; l < _params.levels; l++)
+      std::fill(_tiles[l].begin(), _tiles[l].end(), Tile());
+  }
+
+  unsigned int maxPacketSize() const
+  {
+    unsigned long long size = sizeof(PreviewPacketHeader);
+    for(int l = 0; l < _params.levels; l++)
+      size += (unsigned long long)_levels[l].tilesX * _levels[l].tilesY * sizeof(PreviewTileHeader)
+              + (unsigned long long)_levels[l].width * _levels[l].height * _levels[l].planes() * sizeof(unsigned short);
+    return (unsigned int)std::min(size, 0xFFFFFFFFULL);
+  }
+
+  bool encode(const unsigned short* data, const EvoIRFrameMetadata& metadata, unsigned char* packet, unsigned int capacity, unsigned int* size)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(capacity < sizeof(PreviewPacketHeader)) return false;
+    buildPyramid(data);
+
+    // tiles due: never sent to the client (overview first), then changed beyond the threshold
+    _due.clear();
+    collect(_level, 0);
+    const bool region = _level > 0 && _regionWidth > 0 && _regionHeight > 0;
+    if(region) collect(0, 1);
+    std::stable_sort(_due.begin(), _due.end(), [](const Due& a, const Due& b) {
+      return a.rank != b.rank ? a.rank < b.rank : a.priority > b.priority;
+    });
+
+    const unsigned int limit = _params.budget > 0 ? std::min(capacity, _params.budget) : capacity;
+    unsigned int pos = sizeof(PreviewPacketHeader);
+    unsigned int tiles = 0, pending = 0;
+    for(size_t i = 0; i < _due.size(); i++)
+    {
+      const Due& due = _due[i];
+      if(write(due.level, due.tx, due.ty, packet, limit, &pos)) tiles++;
+      else
+      {
+        // a tile not fitting does not stop smaller ones at the borders
+        _tiles[due.level][(size_t)due.ty * _levels[due.level].tilesX + due.tx].waiting++;
+        pending++;
+      }
+    }
+
+    PreviewPacketHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, PREVIEW_MAGIC, sizeof(header.magic));
+    header.version      = PREVIEW_VERSION;
+    header.levels       = (unsigned short)_params.levels;
+    header.width        = (unsigned short)_params.width;
+    header.height       = (unsigned short)_params.height;
+    header.tileSize     = (unsigned short)_params.tileSize;
+    header.level        = (unsigned short)_level;
+    header.regionX      = (unsigned short)(region ? _regionX : 0);
+    header.regionY      = (unsigned short)(region ? _regionY : 0);
+    header.regionWidth  = (unsigned short)(region ? _regionWidth : 0);
+    header.regionHeight = (unsigned short)(region ? _regionHeight : 0);
+    header.tiles        = tiles;
+    header.pending      = pending;
+    header.size         = pos;
+    header.metadata     = metadata;
+    std::memcpy(packet, &header, sizeof(header));
+    *size = pos;
+
+    _stats.frames++;
+    _stats.bytes    += pos;
+    _stats.tiles    += tiles;
+    _stats.deferred += pending;
+    return true;
+  }
+
+  bool getLevel(int level, unsigned short* levelMin, unsigned short* levelMax)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(level < 0 || level >= _params.levels) return false;
+    copyLevel(_levels[level], levelMin, levelMax);
+    return true;
+  }
+
+  void stats(EvoIRPreviewStats* stats)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    *stats = _stats;
+  }
+
+private:
+  EvoIRPreviewEncoder(const EvoIRPreviewEncoder&);
+  EvoIRPreviewEncoder& operator=(const EvoIRPreviewEncoder&);
+
+  struct Tile
+  {
+    bool valid;                  // the client got the tile
+    unsigned int waiting;        // frames the tile was due but not sent
+    Tile() : valid(false), waiting(0) { }
+  };
+
+  struct Due
+  {
+    int level;
+    int tx, ty;
+    int rank;                    // 0 overview never sent, 1 region never sent, 2 changed
+    unsigned long long priority;
+  };
+
+  void buildPyramid(const unsigned short* data)
+  {
+    std::memcpy(_levels[0].minPlane(), data, _levels[0].min.size() * sizeof(unsigned short));
+    for(int l = 1; l < _params.levels; l++)
+    {
+      const Level& src = _levels[l - 1];
+      Level& dst = _levels[l];
+      for(int y = 0; y < dst.height; y++)
+      {
+        const size_t r0 = (size_t)(2 * y) * src.width;
+        const size_t r1 = (size_t)std::min(2 * y + 1, src.height - 1) * src.width;
+        reduce(src.minPlane() + r0, src.minPlane() + r1, src.maxPlane() + r0, src.maxPlane() + r1, src.width,
+               dst.minPlane() + (size_t)y * dst.width, dst.maxPlane() + (size_t)y * dst.width);
+      }
+    }
+  }
+
+  /**
+   * Adds the due tiles of a level in view, the whole level or the tiles touching the region
+   */
+  void collect(int level, int rankNew)
+  {
+    const Level& current = _levels[level];
+    const Level& sent    = _sent[level];
+    const int ts = _params.tileSize;
+    int tx0 = 0, ty0 = 0, tx1 = current.tilesX, ty1 = current.tilesY;
+    if(rankNew == 1)
+    {
+      tx0 = _regionX / ts;
+      ty0 = _regionY / ts;
+      tx1 = (_regionX + _regionWidth + ts - 1) / ts;
+      ty1 = (_regionY + _regionHeight + ts - 1) / ts;
+    }
+    for(int ty = ty0; ty < ty1; ty++)
+      for(int tx = tx0; tx < tx1; tx++)
+      {
+        Tile& tile = _tiles[level][(size_t)ty * current.tilesX + tx];
+        Due due = { level, tx, ty, rankNew, 0 };
+        if(tile.valid)
+        {
+          const int x = tx * ts, y = ty * ts;
+          const int w = std::min(ts, current.width - x), h = std::min(ts, current.height - y);
+          const size_t first = (size_t)y * current.width + x;
+          unsigned short d = maxDiff(current.minPlane() + first, sent.minPlane() + first, current.width, w, h);
+          if(current.planes() == 2) d = std::max(d, maxDiff(current.maxPlane() + first, sent.maxPlane() + first, current.width, w, h));
+          if(d <= _threshold)
+          {
+            tile.waiting = 0;
+            _stats.unchanged++;
+            continue;
+          }
+          // tiles left for later catch up with more changed ones
+          due.rank     = 2;
+          due.priority = (unsigned long long)d * (tile.waiting + 1);
+        }
+        _due.push_back(due);
+      }
+  }
+
+  /**
+   * Appends a tile to the packet if it fits and takes it as sent
+   */
+  bool write(int level, int tx, int ty, unsigned char* packet, unsigned int limit, unsigned int* pos)
+  {
+    const Level& current = _levels[level];
+    Level& sent = _sent[level];
+    const int ts = _params.tileSize;
+    const int x = tx * ts, y = ty * ts;
+    const int w = std::min(ts, current.width - x), h = std::min(ts, current.height - y);
+    const int planes = current.planes();
+    const unsigned int rawSize = (unsigned int)(w * h * planes * sizeof(unsigned short));
+    // cheap test before compressing, compressed tiles are not larger than raw ones
+    if(*pos + sizeof(PreviewTileHeader) + (_params.compress ? 0 : rawSize) > limit) return false;
+
+    for(int p = 0; p < planes; p++)
+    {
+      const unsigned short* plane = p == 0 ? current.minPlane() : current.maxPlane();
+      for(int row = 0; row < h; row++)
+        std::memcpy(&_tile[(size_t)(p * h + row) * w], plane + (size_t)(y + row) * current.width + x, w * sizeof(unsigned short));
+    }
+    PreviewTileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.level = (unsigned char)level;
+    header.codec = CODEC_RAW;
+    header.tx    = (unsigned short)tx;
+    header.ty    = (unsigned short)ty;
+    header.size  = rawSize;
+    const unsigned char* payload = (const unsigned char*)&_tile[0];
+    if(_params.compress)
+    {
+      const unsigned int encoded = recordingCodecEncode(&_tile[0], w, h * planes, &_encoded[0], &_scratch[0]);
+      if(encoded < rawSize)
+      {
+        header.codec = CODEC_MED;
+        header.size  = encoded;
+        payload      = &_encoded[0];
+      }
+    }
+    if(*pos + sizeof(header) + header.size > limit) return false;
+    std::memcpy(packet + *pos, &header, sizeof(header));
+    std::memcpy(packet + *pos + sizeof(header), payload, header.size);
+    *pos += (unsigned int)sizeof(header) + header.size;
+
+    for(int p = 0; p < planes; p++)
+    {
+      const unsigned short* src = p == 0 ? current.minPlane() : current.maxPlane();
+      unsigned short* dst       = p == 0 ? sent.minPlane() : sent.maxPlane();
+      for(int row = 0; row < h; row++)
+        std::memcpy(dst + (size_t)(y + row) * current.width + x, src + (size_t)(y + row) * current.width + x, w * sizeof(unsigned short));
+    }
+    Tile& tile   = _tiles[level][(size_t)ty * current.tilesX + tx];
+    tile.valid   = true;
+    tile.waiting = 0;
+    return true;
+  }
+
+  const EvoIRPreviewParams _params;
+  const unsigned short _threshold;     // raw value difference
+
+  std::mutex _mutex;
+  int _level;
+  int _regionX;
+  int _regionY;
+  int _regionWidth;
+  int _regionHeight;
+
+  Level _levels[EVO_PREVIEW_MAX_LEVELS];                 // pyramid of the last frame
+  Level _sent[EVO_PREVIEW_MAX_LEVELS];                   // tiles as sent to the client
+  std::vector<Tile> _tiles[EVO_PREVIEW_MAX_LEVELS];
+  std::vector<Due> _due;
+  std::vector<unsigned short> _tile;
+  std::vector<unsigned char> _encoded;
+  std::vector<unsigned short> _scratch;
+  EvoIRPreviewStats _stats;
+};
+
+class EvoIRPreviewDecoder
+{
+public:
+  EvoIRPreviewDecoder() : _width(0), _height(0), _levelCount(0), _tileSize(0) { }
+
+  bool decode(const unsigned char* packet, unsigned int size, EvoIRPreviewPacketInfo* info)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    PreviewPacketHeader header;
+    if(size < sizeof(header)) return false;
+    std::memcpy(&header, packet, sizeof(header));
+    if(std::memcmp(header.magic, PREVIEW_MAGIC, sizeof(header.magic)) != 0 || header.version != PREVIEW_VERSION || header.size != size
+       || header.width == 0 || header.height == 0 || header.levels < 1 || header.levels > EVO_PREVIEW_MAX_LEVELS
+       || header.tileSize < 8 || header.tileSize > 256 || header.level >= header.levels)
+      return false;
+    if(header.width != _width || header.height != _height || header.levels != _levelCount || header.tileSize != _tileSize)
+    {
+      _width      = header.width;
+      _height     = header.height;
+      _levelCount = header.levels;
+      _tileSize   = header.tileSize;
+      for(int l = 0; l < _levelCount; l++) _levels[l].init(_width, _height, l, _tileSize);
+      _tile.resize(2 * _tileSize * _tileSize);
+      _scratch.resize(recordingCodecScratchSize(_tileSize, 2 * _tileSize));
+    }
+    if(info)
+    {
+      info->width        = header.width;
+      info->height       = header.height;
+      info->levels       = header.levels;
+      info->level        = header.level;
+      info->regionX      = header.regionX;
+      info->regionY      = header.regionY;
+      info->regionWidth  = header.regionWidth;
+      info->regionHeight = header.regionHeight;
+      info->tiles        = header.tiles;
+      info->pending      = header.pending;
+      info->metadata     = header.metadata;
+    }
+
+    unsigned int pos = sizeof(header);
+    for(unsigned int i = 0; i < header.tiles; i++)
+    {
+      PreviewTileHeader tile;
+      if(size - pos < sizeof(tile)) return false;
+      std::memcpy(&tile, packet + pos, sizeof(tile));
+      pos += sizeof(tile);
+      if(tile.level >= _levelCount || size - pos < tile.size) return false;
+      Level& level = _levels[tile.level];
+      if(tile.tx >= level.tilesX || tile.ty >= level.tilesY) return false;
+      const int x = tile.tx * _tileSize, y = tile.ty * _tileSize;
+      const int w = std::min(_tileSize, level.width - x), h = std::min(_tileSize, level.height - y);
+      const int planes = level.planes();
+      const unsigned int rawSize = (unsigned int)(w * h * planes * sizeof(unsigned short));
+      if(tile.codec == CODEC_RAW)
+      {
+        if(tile.size != rawSize) return false;
+        std::memcpy(&_tile[0], packet + pos, rawSize);
+      }
+      else if(tile.codec != CODEC_MED || !recordingCodecDecode(packet + pos, tile.size, w, h * planes, &_tile[0], &_scratch[0]))
+        return false;
+      pos += tile.size;
+      for(int p = 0; p < planes; p++)
+      {
+        unsigned short* plane = p == 0 ? level.minPlane() : level.maxPlane();
+        for(int row = 0; row < h; row++)
+          std::memcpy(plane + (size_t)(y + row) * level.width + x, &_tile[(size_t)(p * h + row) * w], w * sizeof(unsigned short));
+      }
+    }
+    return pos == size;
+  }
+
+  bool getLevel(int level, unsigned short* levelMin, unsigned short* levelMax)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(level < 0 || level >= _levelCount) return false;
+    copyLevel(_levels[level], levelMin, levelMax);
+    return true;
+  }
+
+  bool getRegion(int x, int y, int w, int h, unsigned short* data)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(_levelCount == 0 || x < 0 || y < 0 || w <= 0 || h <= 0 || x + w > _width || y + h > _height) return false;
+    const Level& level = _levels[0];
+    for(int row = 0; row < h; row++)
+      std::memcpy(data + (size_t)row * w, level.minPlane() + (size_t)(y + row) * _width + x, w * sizeof(unsigned short));
+    return true;
+  }
+
+private:
+  EvoIRPreviewDecoder(const EvoIRPreviewDecoder&);
+  EvoIRPreviewDecoder& operator=(const EvoIRPreviewDecoder&);
+
+  std::mutex _mutex;
+  int _width;
+  int _height;
+  int _levelCount;
+  int _tileSize;
+  Level _levels[EVO_PREVIEW_MAX_LEVELS];
+  std::vector<unsigned short> _tile;
+  std::vector<unsigned short> _scratch;
+};
+
+static EvoIRHandleTable<EvoIRPreviewEncoder> g_encoders;
+static EvoIRHandleTable<EvoIRPreviewDecoder> g_decoders;
+typedef EvoIRHandleTable<EvoIRPreviewEncoder>::Ref EncoderRef;
+typedef EvoIRHandleTable<EvoIRPreviewDecoder>::Ref DecoderRef;
+
+} // namespace evo
+
+using namespace evo;
+
+int evo_irimager_preview_level_size(int w, int h, int level, int* levelWidth, int* levelHeight)
+{
+  if(w <= 0 || h <= 0 || level < 0 || level >= EVO_PREVIEW_MAX_LEVELS || !levelWidth || !levelHeight) return -1;
+  *levelWidth  = levelSize(w, level);
+  *levelHeight = levelSize(h, level);
+  return 0;
+}
+
+void evo_irimager_preview_default_params(EvoIRPreviewParams* params, int w, int h)
+{
+  if(!params) return;
+  std::memset(params, 0, sizeof(*params));
+  params->width         = w;
+  params->height        = h;
+  params->decimalPlaces = 1;
+  params->levels        = 4;
+  params->tileSize      = 32;
+  params->tThreshold    = 1.f;
+  params->budget        = 0;
+  params->compress      = 1;
+}
+
+int evo_irimager_preview_encoder_create(unsigned int* outEncoderId, const EvoIRPreviewParams* params)
+{
+  if(!outEncoderId || !params || params->width <= 0 || params->height <= 0 || params->width > 65535 || params->height > 65535
+     || params->decimalPlaces < 1 || params->decimalPlaces > 4 || params->levels < 1 || params->levels > EVO_PREVIEW_MAX_LEVELS
+     || params->tileSize < 8 || params->tileSize > 256 || !(params->tThreshold >= 0.f))
+    return -1;
+  EvoIRPreviewEncoder* encoder = new EvoIRPreviewEncoder(*params);
+  if(!g_encoders.insert(encoder, outEncoderId))
+  {
+    delete encoder;
+    return -1;
+  }
+  return 0;
+}
+
+int evo_irimager_preview_encoder_destroy(const unsigned int encoderId)
+{
+  EvoIRPreviewEncoder* encoder = g_encoders.remove(encoderId);
+  if(!encoder) return -1;
+  delete encoder;
+  return 0;
+}
+
+int evo_irimager_preview_request(const unsigned int encoderId, int level, int x, int y, int w, int h)
+{
+  EncoderRef encoder = g_encoders.acquire(encoderId);
+  if(!encoder) return -1;
+  const EvoIRPreviewParams& params = encoder->params();
+  if(level < 0 || level >= params.levels || w < 0 || h < 0 || x < 0 || y < 0 || x + w > params.width || y + h > params.height) return -1;
+  if(w == 0 || h == 0) x = y = w = h = 0;
+  encoder->request(level, x, y, w, h);
+  return 0;
+}
+
+int evo_irimager_preview_reset(const unsigned int encoderId)
+{
+  EncoderRef encoder = g_encoders.acquire(encoderId);
+  if(!encoder) return -1;
+  encoder->reset();
+  return 0;
+}
+
+unsigned int evo_irimager_preview_max_packet_size(const unsigned int encoderId)
+{
+  EncoderRef encoder = g_encoders.acquire(encoderId);
+  if(!encoder) return 0;
+  return encoder->maxPacketSize();
+}
+
+int evo_irimager_preview_encode(const unsigned int encoderId, const unsigned short* data, const EvoIRFrameMetadata* metadata,
+                                unsigned char* packet, unsigned int capacity, unsigned int* size)
+{
+  EncoderRef encoder = g_encoders.acquire(encoderId);
+  if(!encoder || !data || !metadata || !packet || !size) return -1;
+  return encoder->encode(data, *metadata, packet, capacity, size) ? 0 : -1;
+}
+
+int evo_irimager_preview_get_level(const unsigned int encoderId, int level, unsigned short* levelMin, unsigned short* levelMax)
+{
+  EncoderRef encoder = g_encoders.acquire(encoderId);
+  if(!encoder) return -1;
+  return encoder->getLevel(level, levelMin, levelMax) ? 0 : -1;
+}
+
+int evo_irimager_preview_get_stats(const unsigned int encoderId, EvoIRPreviewStats* stats)
+{
+  EncoderRef encoder = g_encoders.acquire(encoderId);
+  if(!encoder || !stats) return -1;
+  encoder->stats(stats);
+  return 0;
+}
+
+int evo_irimager_preview_decoder_create(unsigned int* outDecoderId)
+{
+  if(!outDecoderId) return -1;
+  EvoIRPreviewDecoder* decoder = new EvoIRPreviewDecoder();
+  if(!g_decoders.insert(decoder, outDecoderId))
+  {
+    delete decoder;
+    return -1;
+  }
+  return 0;
+}
+
+int evo_irimager_preview_decoder_destroy(const unsigned int decoderId)
+{
+  EvoIRPreviewDecoder* decoder = g_decoders.remove(decoderId);
+  if(!decoder) return -1;
+  delete decoder;
+  return 0;
+}
+
+int evo_irimager_preview_decode(const unsigned int decoderId, const unsigned char* packet, unsigned int size, EvoIRPreviewPacketInfo* info)
+{
+  DecoderRef decoder = g_decoders.acquire(decoderId);
+  if(!decoder || !packet) return -1;
+  return decoder->decode(packet, size, info) ? 0 : -1;
+}
+
+int evo_irimager_preview_decoder_get_level(const unsigned int decoderId, int level, unsigned short* levelMin, unsigned short* levelMax)
+{
+  DecoderRef decoder = g_decoders.acquire(decoderId);
+  if(!decoder) return -1;
+  return decoder->getLevel(level, levelMin, levelMax) ? 0 : -1;
+}
+
+int evo_irimager_preview_decoder_get_region(const unsigned int decoderId, int x, int y, int w, int h, unsigned short* data)
+{
+  DecoderRef decoder = g_decoders.acquire(decoderId);
+  if(!decoder || !data) return -1;
+  return decoder->getRegion(x, y, w, h, data) ? 0 : -1;
+}
@@ -0,0 +1,247 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRPreview.h
+ * @brief Provides a multi-resolution preview of thermal images for thin links for Easy API C-Library Interface
+ *
+ * A preview encoder turns a stream of raw thermal images into packets that
+ * carry an overview of the whole image at a reduced resolution and,
+ * optionally, a region at full resolution. A client requests the
+ * pyramid level of the overview and the region (evo_irimager_preview_request)
+ * and reconstructs both with a preview decoder.
+ *
+ * Pyramid: level 0 is the image, level l + 1 halves the width and height of
+ * level l (rounded up). Every pixel of a level keeps the minimum and maximum
+ * of the 2 x 2 pixels below it, both computed with SSE4.1/AVX2 (see
+ * evo_irimager_set_simd_level), so a single hot or cold pixel is still found
+ * in the maximum or minimum of the coarsest level. Palette images of a level
+ * can be made of its maximum with evo_irimager_palette_apply.
+ *
+ * Tiles: levels are divided into square tiles of tileSize pixels of the level.
+ * The encoder remembers what it sent; a tile is sent again once one of its
+ * values differs from the sent one by more than tThreshold, so the decoded
+ * images never deviate more than that. Tiles are compressed with the codec of
+ * recordings. A packet carries the tiles the client never got first, the
+ * overview before the region, then the changed tiles, most changed first;
+ * tiles beyond the byte budget follow with later frames. Zooming into a new
+ * region thus fills it in over a few frames while the overview stays live,
+ * and a static scene costs only the packet header.
+ *
+ * Packets are self-contained byte buffers for any transport. A lost packet
+ * leaves the client with old tiles that are not necessarily sent again; after
+ * reconnecting or losing packets, evo_irimager_preview_reset starts over.
+ *
+ * @code
+ * EvoIRPreviewParams params;
+ * evo_irimager_preview_default_params(&params, 640, 480);
+ * evo_irimager_preview_encoder_create(&encoderId, &params);
+ * evo_irimager_preview_request(encoderId, 2, 320, 240, 160, 120);
+ * std::vector<unsigned char> packet(evo_irimager_preview_max_packet_size(encoderId));
+ * // for every frame
+ * evo_irimager_preview_encode(encoderId, thermal, &metadata, &packet[0], packet.size(), &size);
+ *
+ * // client
+ * evo_irimager_preview_decoder_create(&decoderId);
+ * evo_irimager_preview_decode(decoderId, &packet[0], size, &info);
+ * evo_irimager_preview_decoder_get_level(decoderId, info.level, levelMin, levelMax);
+ * evo_irimager_preview_decoder_get_region(decoderId, info.regionX, info.regionY, info.regionWidth, info.regionHeight, region);
+ * @endcode
+ */
+
+#ifndef EVOIRPREVIEW_H_
+#define EVOIRPREVIEW_H_
+
+#include "irdirectsdk_defs.h"
+#include "EvoIRFrameMetadata.h"
+
+#define EVO_PREVIEW_MAX_LEVELS 8
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+typedef struct __IRDIRECTSDK_API__ EvoIRPreviewParams
+{
+  int width;              /*!< Image width [1; 65535] */
+  int height;             /*!< Image height [1; 65535] */
+  short decimalPlaces;    /*!< Decimal places of raw values [1; 4], see evo_irimager_thermal_to_celsius */
+  int levels;             /*!< Pyramid levels including the image [1; EVO_PREVIEW_MAX_LEVELS] */
+  int tileSize;           /*!< Edge length of tiles in pixels of their level [8; 256] */
+  float tThreshold;       /*!< Change in degree Celsius a tile must exceed to be sent again, 0 sends every change */
+  unsigned int budget;    /*!< Largest packet in bytes, 0 for no limit besides the capacity passed to encode */
+  int compress;           /*!< 1 compresses tiles with the codec of recordings, 0 sends raw values */
+} EvoIRPreviewParams;
+
+/**
+ * @brief Description of a packet, filled by evo_irimager_preview_decode
+ */
+typedef struct __IRDIRECTSDK_API__ EvoIRPreviewPacketInfo
+{
+  int width;                    /*!< Image width */
+  int height;                   /*!< Image height */
+  int levels;                   /*!< Pyramid levels */
+  int level;                    /*!< Level of the overview */
+  int regionX, regionY;         /*!< Upper left corner of the full resolution region */
+  int regionWidth;              /*!< Width of the region, 0 without region */
+  int regionHeight;             /*!< Height of the region, 0 without region */
+  unsigned int tiles;           /*!< Tiles in the packet */
+  unsigned int pending;         /*!< Tiles left for later packets because of the budget */
+  EvoIRFrameMetadata metadata;  /*!< Metadata of the frame encoded */
+} EvoIRPreviewPacketInfo;
+
+typedef struct __IRDIRECTSDK_API__ EvoIRPreviewStats
+{
+  unsigned long long frames;    /*!< Frames encoded */
+  unsigned long long bytes;     /*!< Bytes of all packets */
+  unsigned long long tiles;     /*!< Tiles sent */
+  unsigned long long unchanged; /*!< Tiles in view skipped as they did not change beyond the threshold */
+  unsigned long long deferred;  /*!< Tiles due but left for later packets because of the budget, summed over frames */
+} EvoIRPreviewStats;
+
+/**
+ * @brief Size of a pyramid level
+ * @param[in] w image width
+ * @param[in] h image height
+ * @param[in] level pyramid level
+ * @param[out] levelWidth width of level
+ * @param[out] levelHeight height of level
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_preview_level_size(int w, int h, int level, int* levelWidth, int* levelHeight);
+
+/**
+ * @brief Fills parameter structure with defaults (4 levels, tiles of 32 pixels, threshold 1 degree Celsius, no budget, compressed, one decimal place)
+ * @param[out] params pointer to EvoIRPreviewParams allocate by the user
+ * @param[in] w image width
+ * @param[in] h image height
+ */
+__IRDIRECTSDK_API__ void evo_irimager_preview_default_params(EvoIRPreviewParams* params, int w, int h);
+
+/**
+ * @brief Creates a preview encoder, the overview is the coarsest level without region until requested otherwise
+ * @param[out] outEncoderId encoder instance id for reference
+ * @param[in] params parameters
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_preview_encoder_create(unsigned int* outEncoderId, const EvoIRPreviewParams* params);
+
+/**
+ * @brief Releases a preview encoder
+ * @param[in] encoderId encoder instance id from create to apply this function
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_preview_encoder_destroy(const unsigned int encoderId);
+
+/**
+ * @brief Selects overview level and full resolution region of the following packets. Tiles sent before are not sent again unless they change.
+ * @param[in] encoderId encoder instance id from create to apply this function
+ * @param[in] level pyramid level of the overview [0; levels - 1], 0 sends the whole image at full resolution and ignores the region
+ * @param[in] x left column of region
+ * @param[in] y top row of region
+ * @param[in] w width of region, 0 for no region
+ * @param[in] h height of region, 0 for no region
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_preview_request(const unsigned int encoderId, int level, int x, int y, int w, int h);
+
+/**
+ * @brief Forgets which tiles were sent, the following packets carry the whole view again
+ * @param[in] encoderId encoder instance id from create to apply this function
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_preview_reset(const unsigned int encoderId);
+
+/**
+ * @brief Largest packet the encoder can produce, capacity needed for packets without tiles left for later
+ * @param[in] encoderId encoder instance id from create to apply this function
+ * @return size in bytes, 0 on error
+ */
+__IRDIRECTSDK_API__ unsigned int evo_irimager_preview_max_packet_size(const unsigned int encoderId);
+
+/**
+ * @brief Builds the pyramid of a frame and writes the tiles to send
+ * @param[in] encoderId encoder instance id from create to apply this function
+ * @param[in] data thermal image (size of width * height)
+ * @param[in] metadata metadata of the frame
+ * @param[out] packet pointer to unsigned char array allocate by the user
+ * @param[in] capacity size of packet in bytes, tiles not fitting are left for later packets like those beyond the budget
+ * @param[out] size number of bytes written
+ * @return 0 on success, -1 on error (capacity smaller than the packet header)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_preview_encode(const unsigned int encoderId, const unsigned short* data, const EvoIRFrameMetadata* metadata,
+                                                    unsigned char* packet, unsigned int capacity, unsigned int* size);
+
+/**
+ * @brief Accessor to a pyramid level of the last frame encoded
+ * @param[in] encoderId encoder instance id from create to apply this function
+ * @param[in] level pyramid level
+ * @param[out] levelMin pointer to unsigned short array allocate by the user (size of evo_irimager_preview_level_size), may be NULL
+ * @param[out] levelMax pointer to unsigned short array allocate by the user (size of evo_irimager_preview_level_size), may be NULL
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_preview_get_level(const unsigned int encoderId, int level, unsigned short* levelMin, unsigned short* levelMax);
+
+/**
+ * @brief Accessor to the counters of an encoder
+ * @param[in] encoderId encoder instance id from create to apply this function
+ * @param[out] stats pointer to EvoIRPreviewStats allocate by the user
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_preview_get_stats(const unsigned int encoderId, EvoIRPreviewStats* stats);
+
+/**
+ * @brief Creates a preview decoder, image size and levels are taken from the packets
+ * @param[out] outDecoderId decoder instance id for reference
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_preview_decoder_create(unsigned int* outDecoderId);
+
+/**
+ * @brief Releases a preview decoder
+ * @param[in] decoderId decoder instance id from create to apply this function
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_preview_decoder_destroy(const unsigned int decoderId);
+
+/**
+ * @brief Applies the tiles of a packet. A packet of another image size or number of levels clears all levels.
+ * @param[in] decoderId decoder instance id from create to apply this function
+ * @param[in] packet packet written by evo_irimager_preview_encode
+ * @param[in] size size of packet in bytes
+ * @param[out] info pointer to EvoIRPreviewPacketInfo allocate by the user, may be NULL
+ * @return 0 on success, -1 on error (corrupt packet, tiles decoded before the error are kept)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_preview_decode(const unsigned int decoderId, const unsigned char* packet, unsigned int size, EvoIRPreviewPacketInfo* info);
+
+/**
+ * @brief Accessor to a decoded pyramid level, pixels of tiles not received yet are 0
+ * @param[in] decoderId decoder instance id from create to apply this function
+ * @param[in] level pyramid level
+ * @param[out] levelMin pointer to unsigned short array allocate by the user (size of evo_irimager_preview_level_size), may be NULL
+ * @param[out] levelMax pointer to unsigned short array allocate by the user (size of evo_irimager_preview_level_size), may be NULL
+ * @return 0 on success, -1 on error (no packet decoded, invalid level)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_preview_decoder_get_level(const unsigned int decoderId, int level, unsigned short* levelMin, unsigned short* levelMax);
+
+/**
+ * @brief Accessor to a region of the decoded full resolution image, pixels of tiles not received yet are 0
+ * @param[in] decoderId decoder instance id from create to apply this function
+ * @param[in] x left column of region
+ * @param[in] y top row of region
+ * @param[in] w width of region
+ * @param[in] h height of region
+ * @param[out] data pointer to unsigned short array allocate by the user (size of w * h)
+ * @return 0 on success, -1 on error (no packet decoded, region outside of image)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_preview_decoder_get_region(const unsigned int decoderId, int x, int y, int w, int h, unsigned short* data);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* EVOIRPREVIEW_H_ */
@@ -0,0 +1,654 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRRecording.cpp
+ * @brief Recording and playback of raw thermal images
+ *
+ * Codec: every pixel is predicted by the median edge detector of LOCO-I from
+ * its left, upper and upper left neighbour. The prediction error is mapped to
+ * an unsigned value (zigzag) and packed in blocks of 16 pixels with the bit
+ * width of the largest value in the block. A block is stored as one byte
+ * holding the width followed by 2 * width bytes. Sensor noise of a few digits
+ * thus costs 3-5 bits per pixel instead of 16.
+ */
+
+#include "EvoIRRecording.h"
+#include "EvoIRRecordingFormat.h"
+#include "EvoIRHandleTable.h"
+#include "EvoIRSimd.h"
+
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace evo
+{
+
+namespace
+{
+
+const int CODEC_BLOCK = 16;
+
+// The median edge detector equals the median of a, b and a + b - c. Written
+// with min/max only, so the compiler emits no data dependent branches.
+inline unsigned short medPredict(int a, int b, int c)
+{
+  const int mn = a < b ? a : b;
+  const int mx = a < b ? b : a;
+  const int g  = a + b - c;
+  const int t  = mx < g ? mx : g;
+  return (unsigned short)(mn > t ? mn : t);
+}
+
+inline unsigned short zigzag(unsigned short value, unsigned short prediction)
+{
+  const short r = (short)(unsigned short)(value - prediction);
+  return (unsigned short)(((unsigned short)r << 1) ^ (unsigned short)(r >> 15));
+}
+
+inline unsigned short unzigzag(unsigned short z, unsigned short prediction)
+{
+  const unsigned short r = (unsigned short)((z >> 1) ^ (unsigned short)-(short)(z & 1));
+  return (unsigned short)(prediction + r);
+}
+
+inline int bitWidth(unsigned int v)
+{
+#if defined(__GNUC__)
+  return v ? 32 - __builtin_clz(v) : 0;
+#else
+  int b = 0;
+  while(v)
+  {
+    b++;
+    v >>= 1;
+  }
+  return b;
+#endif
+}
+
+// Prediction residuals of a whole image, row by row to keep the inner loop free of border checks
+void medResiduals(const unsigned short* img, int w, int h, unsigned short* z)
+{
+  z[0] = zigzag(img[0], 0);
+  for(int x = 1; x < w; x++)
+    z[x] = zigzag(img[x], img[x - 1]);
+  for(int y = 1; y < h; y++)
+  {
+    const unsigned short* row = img + (size_t)y * w;
+    const unsigned short* up  = row - w;
+    unsigned short* zr = z + (size_t)y * w;
+    zr[0] = zigzag(row[0], up[0]);
+    for(int x = 1; x < w; x++)
+      zr[x] = zigzag(row[x], medPredict(row[x - 1], up[x], up[x - 1]));
+  }
+}
+
+// The first row only predicts from the left neighbour, i.e. it is the running sum of the residuals
+void firstRowScalar(const unsigned short* z, int w, unsigned short* img)
+{
+  img[0] = unzigzag(z[0], 0);
+  for(int x = 1; x < w; x++)
+    img[x] = unzigzag(z[x], img[x - 1]);
+}
+
+#if EVO_SIMD_X86
+EVO_TARGET_SSE41 void firstRowSse41(const unsigned short* z, int w, unsigned short* img)
+{
+  const __m128i one  = _mm_set1_epi16(1);
+  const __m128i last = _mm_set1_epi16(0x0F0E);
+  __m128i carry = _mm_setzero_si128();
+  int x = 0;
+  for(; x + 8 <= w; x += 8)
+  {
+    const __m128i v = _mm_loadu_si128((const __m128i*)(z + x));
+    __m128i r = _mm_xor_si128(_mm_srli_epi16(v, 1), _mm_sub_epi16(_mm_setzero_si128(), _mm_and_si128(v, one)));
+    // prefix sum of 8 lanes in 3 steps, plus the last value of the previous group
+    r = _mm_add_epi16(r, _mm_slli_si128(r, 2));
+    r = _mm_add_epi16(r, _mm_slli_si128(r, 4));
+    r = _mm_add_epi16(r, _mm_slli_si128(r, 8));
+    r = _mm_add_epi16(r, carry);
+    _mm_storeu_si128((__m128i*)(img + x), r);
+    carry = _mm_shuffle_epi8(r, last);
+  }
+  for(; x < w; x++)
+    img[x] = unzigzag(z[x], x ? img[x - 1] : 0);
+}
+#endif
+
+void medReconstruct(const unsigned short* z, int w, int h, unsigned short* img)
+{
+#if EVO_SIMD_X86
+  if(simdLevel() >= SIMD_SSE41) firstRowSse41(z, w, img);
+  else firstRowScalar(z, w, img);
+#else
+  firstRowScalar(z, w, img);
+#endif
+  for(int y = 1; y < h; y++)
+  {
+    unsigned short* row      = img + (size_t)y * w;
+    const unsigned short* up = row - w;
+    const unsigned short* zr = z + (size_t)y * w;
+    int left = row[0] = unzigzag(zr[0], up[0]);
+    for(int x = 1; x < w; x++)
+      left = row[x] = unzigzag(zr[x], medPredict(left, up[x], up[x - 1]));
+  }
+}
+
+// Unpacks 16 values of Bits bits, least significant first, from exactly 2 * Bits bytes.
+// With the width known at compile time the loop unrolls into loads and shifts.
+template<int Bits>
+void unpackBlock(const unsigned char* p, unsigned short* z)
+{
+  unsigned char buffer[2 * Bits + 8];
+  std::memcpy(buffer, p, 2 * Bits);
+  std::memset(buffer + 2 * Bits, 0, 8);
+  for(int k = 0; k < CODEC_BLOCK; k++)
+  {
+    unsigned long long word;
+    std::memcpy(&word, buffer + k * Bits / 8, 8);
+    z[k] = (unsigned short)((word >> (k * Bits % 8)) & ((1u << Bits) - 1));
+  }
+}
+
+// Same without the copy, for blocks followed by at least 8 more bytes of the chunk,
+// which the loads of the last values may touch
+template<int Bits>
+void unpackBlockDirect(const unsigned char* p, unsigned short* z)
+{
+  for(int k = 0; k < CODEC_BLOCK; k++)
+  {
+    unsigned long long word;
+    std::memcpy(&word, p + k * Bits / 8, 8);
+    z[k] = (unsigned short)((word >> (k * Bits % 8)) & ((1u << Bits) - 1));
+  }
+}
+
+void unpackZero(const unsigned char*, unsigned short* z)
+{
+  for(int k = 0; k < CODEC_BLOCK; k++) z[k] = 0;
+}
+
+typedef void (*UnpackFunction)(const unsigned char* p, unsigned short* z);
+
+const UnpackFunction UNPACK[17] = { unpackZero,      unpackBlock<1>,  unpackBlock<2>,  unpackBlock<3>,  unpackBlock<4>,  unpackBlock<5>,
+                                    unpackBlock<6>,  unpackBlock<7>,  unpackBlock<8>,  unpackBlock<9>,  unpackBlock<10>, unpackBlock<11>,
+                                    unpackBlock<12>, unpackBlock<13>, unpackBlock<14>, unpackBlock<15>, unpackBlock<16> };
+
+const UnpackFunction UNPACK_DIRECT[17] = { unpackZero,            unpackBlockDirect<1>,  unpackBlockDirect<2>,  unpackBlockDirect<3>,
+                                           unpackBlockDirect<4>,  unpackBlockDirect<5>,  unpackBlockDirect<6>,  unpackBlockDirect<7>,
+                                           unpackBlockDirect<8>,  unpackBlockDirect<9>,  unpackBlockDirect<10>, unpackBlockDirect<11>,
+                                           unpackBlockDirect<12>, unpackBlockDirect<13>, unpackBlockDirect<14>, unpackBlockDirect<15>,
+                                           unpackBlockDirect<16> };
+
+} // namespace
+
+unsigned int recordingCodecMaxSize(int w, int h)
+{
+  const unsigned int blocks = ((unsigned int)w * h + CODEC_BLOCK - 1) / CODEC_BLOCK;
+  return blocks * (1 + 2 * CODEC_BLOCK);
+}
+
+unsigned int recordingCodecEncode(const unsigned short* img, int w, int h, unsigned char* out, unsigned short* scratch)
+{
+  const int n = w * h;
+  const int padded = (n + CODEC_BLOCK - 1) / CODEC_BLOCK * CODEC_BLOCK;
+  medResiduals(img, w, h, scratch);
+  for(int i = n; i < padded; i++) scratch[i] = 0;
+
+  unsigned char* o = out;
+  for(int i = 0; i < padded; i += CODEC_BLOCK)
+  {
+    const unsigned short* z = scratch + i;
+    unsigned int any = 0;
+    for(int k = 0; k < CODEC_BLOCK; k++) any |= z[k];
+
+    const int bits = bitWidth(any);
+    *o++ = (unsigned char)bits;
+    if(bits == 0) continue;
+
+    // 16 values of equal width fill exactly 2 * bits bytes
+    unsigned long long acc = 0;
+    int fill = 0;
+    for(int k = 0; k < CODEC_BLOCK; k++)
+    {
+      acc |= (unsigned long long)z[k] << fill;
+      fill += bits;
+      if(fill >= 32)
+      {
+        const unsigned int word = (unsigned int)acc;
+        std::memcpy(o, &word, 4);
+        o    += 4;
+        acc >>= 32;
+        fill -= 32;
+      }
+    }
+    for(; fill > 0; fill -= 8)
+    {
+      *o++ = (unsigned char)acc;
+      acc >>= 8;
+    }
+  }
+  return (unsigned int)(o - out);
+}
+
+bool recordingCodecDecode(const unsigned char* in, unsigned int size, int w, int h, unsigned short* img, unsigned short* scratch)
+{
+  const int n = w * h;
+  const unsigned char* p   = in;
+  const unsigned char* end = in + size;
+  for(int i = 0; i < n; i += CODEC_BLOCK)
+  {
+    unsigned short* z = scratch + i;
+    if(p >= end) return false;
+    const int bits = *p++;
+    if(bits > 16 || p + 2 * bits > end) return false;
+    if(p + 2 * bits + 8 <= end) UNPACK_DIRECT[bits](p, z);
+    else                        UNPACK[bits](p, z);
+    p += 2 * bits;
+  }
+  if(p != end) return false;
+  medReconstruct(scratch, w, h, img);
+  return true;
+}
+
+unsigned int recordingCodecScratchSize(int w, int h)
+{
+  return ((unsigned int)w * h + CODEC_BLOCK - 1) / CODEC_BLOCK * CODEC_BLOCK;
+}
+
+class EvoIRRecorder
+{
+public:
+  EvoIRRecorder() : _file(nullptr), _width(0), _height(0), _compress(false), _failed(false), _offset(0) { }
+
+  ~EvoIRRecorder()
+  {
+    close();
+  }
+
+  bool open(const char* path, int w, int h, float framerate, bool compress)
+  {
+    _file = fopen(path, "wb");
+    if(!_file) return false;
+    _buffer.resize(1 << 20);
+    setvbuf(_file, &_buffer[0], _IOFBF, _buffer.size());
+
+    _width    = w;
+    _height   = h;
+    _compress = compress;
+    _encoded.resize(recordingCodecMaxSize(w, h));
+    _scratch.resize(recordingCodecScratchSize(w, h));
+
+    RecordingFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, RECORDING_FILE_MAGIC, sizeof(header.magic));
+    header.version   = RECORDING_VERSION;
+    header.width     = (unsigned int)w;
+    header.height    = (unsigned int)h;
+    header.framerate = framerate;
+    if(fwrite(&header, sizeof(header), 1, _file) != 1) return false;
+    _offset = sizeof(header);
+    return true;
+  }
+
+  bool writeFrame(const unsigned short* data, const EvoIRFrameMetadata* metadata)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(!_file || _failed || _index.size() >= RECORDING_MAX_FRAMES) return false;
+
+    const unsigned int rawSize = (unsigned int)_width * _height * sizeof(unsigned short);
+    const void* frame = data;
+    unsigned int frameSize = rawSize;
+    unsigned short codec = CODEC_RAW;
+    if(_compress)
+    {
+      const unsigned int size = recordingCodecEncode(data, _width, _height, &_encoded[0], &_scratch[0]);
+      if(size < rawSize)
+      {
+        frame     = &_encoded[0];
+        frameSize = size;
+        codec     = CODEC_MED;
+      }
+    }
+
+    RecordingChunkHeader chunk;
+    chunk.magic       = CHUNK_FRAME;
+    chunk.payloadSize = (unsigned int)sizeof(EvoIRFrameMetadata) + frameSize;
+    chunk.crc         = recordingCrc32(frame, frameSize, recordingCrc32(metadata, sizeof(EvoIRFrameMetadata)));
+    chunk.codec       = codec;
+    chunk.reserved    = 0;
+
+    const unsigned long long chunkSize = recordingChunkSize(chunk.payloadSize);
+    const size_t padding = (size_t)(chunkSize - sizeof(chunk) - chunk.payloadSize);
+    static const unsigned char zeros[8] = { 0 };
+    if(fwrite(&chunk, sizeof(chunk), 1, _file) != 1 ||
+       fwrite(metadata, sizeof(EvoIRFrameMetadata), 1, _file) != 1 ||
+       fwrite(frame, 1, frameSize, _file) != frameSize ||
+       fwrite(zeros, 1, padding, _file) != padding)
+    {
+      // A partially written chunk ends the recording, the index must not point behind it
+      _failed = true;
+      return false;
+    }
+
+    RecordingIndexEntry entry;
+    entry.offset    = _offset;
+    entry.timestamp = metadata->timestamp;
+    entry.counter   = metadata->counter;
+    entry.flagState = (unsigned int)metadata->flagState;
+    _index.push_back(entry);
+    _offset += chunkSize;
+    return true;
+  }
+
+  bool flush()
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _file && fflush(_file) == 0;
+  }
+
+  bool close()
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(!_file) return false;
+
+    RecordingChunkHeader chunk;
+    chunk.magic       = CHUNK_INDEX;
+    chunk.payloadSize = (unsigned int)(_index.size() * sizeof(RecordingIndexEntry));
+    chunk.crc         = _index.empty() ? recordingCrc32(nullptr, 0) : recordingCrc32(&_index[0], chunk.payloadSize);
+    chunk.codec       = CODEC_RAW;
+    chunk.reserved    = 0;
+
+    RecordingTrailer trailer;
+    trailer.indexOffset = _offset;
+    std::memcpy(trailer.magic, RECORDING_TRAILER_MAGIC, sizeof(trailer.magic));
+
+    // Place the index right behind the last complete chunk, a partially written one is overwritten and cut off
+    bool ok = true;
+    if(_failed)
+    {
+      clearerr(_file);
+      ok = fflush(_file) == 0 && recordingSeek(_file, _offset) == 0;
+    }
+    ok = ok && fwrite(&chunk, sizeof(chunk), 1, _file) == 1;
+    if(ok && !_index.empty())
+      ok = fwrite(&_index[0], sizeof(RecordingIndexEntry), _index.size(), _file) == _index.size();
+    ok = ok && fwrite(&trailer, sizeof(trailer), 1, _file) == 1;
+    if(_failed)
+      ok = ok && recordingTruncate(_file, _offset + sizeof(chunk) + chunk.payloadSize + sizeof(trailer)) == 0;
+    ok = (fclose(_file) == 0) && ok;
+    _file = nullptr;
+    return ok;
+  }
+
+private:
+  EvoIRRecorder(const EvoIRRecorder&);
+  EvoIRRecorder& operator=(const EvoIRRecorder&);
+
+  std::mutex _mutex;
+  FILE* _file;
+  std::vector<char> _buffer;
+  std::vector<unsigned char> _encoded;
+  std::vector<unsigned short> _scratch;
+  std::vector<RecordingIndexEntry> _index;
+  int _width;
+  int _height;
+  bool _compress;
+  bool _failed;
+  unsigned long long _offset;
+};
+
+class EvoIRPlayback
+{
+public:
+  EvoIRPlayback() : _file(nullptr), _size(0), _recovered(false) { }
+
+  ~EvoIRPlayback()
+  {
+    if(_file) fclose(_file);
+  }
+
+  bool open(const char* path)
+  {
+    _file = fopen(path, "rb");
+    if(!_file) return false;
+    if(fread(&_header, sizeof(_header), 1, _file) != 1 ||
+       std::memcmp(_header.magic, RECORDING_FILE_MAGIC, sizeof(_header.magic)) != 0 ||
+       _header.version != RECORDING_VERSION || !recordingGeometryValid(_header.width, _header.height))
+      return false;
+
+    const long long size = recordingFileSize(_file);
+    if(size < (long long)sizeof(_header)) return false;
+    _size = (unsigned long long)size;
+    if(!readIndex((unsigned long long)size))
+    {
+      _recovered = true;
+      scan((unsigned long long)size);
+    }
+    const size_t pixels = (size_t)_header.width * _header.height;
+    _chunk.resize(sizeof(EvoIRFrameMetadata) + recordingCodecMaxSize(_header.width, _header.height) + pixels * sizeof(unsigned short));
+    _scratch.resize(recordingCodecScratchSize(_header.width, _header.height));
+    return true;
+  }
+
+  void info(EvoIRRecordingInfo* info) const
+  {
+    info->width          = (int)_header.width;
+    info->height         = (int)_header.height;
+    info->framerate      = _header.framerate;
+    info->frames         = _index.size();
+    info->timestampFirst = _index.empty() ? 0 : _index.front().timestamp;
+    info->timestampLast  = _index.empty() ? 0 : _index.back().timestamp;
+    info->recovered      = _recovered ? 1 : 0;
+  }
+
+  int width() const  { return (int)_header.width; }
+  int height() const { return (int)_header.height; }
+
+  bool readFrame(unsigned long long index, unsigned short* data, EvoIRFrameMetadata* metadata)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(index >= _index.size()) return false;
+    RecordingChunkHeader chunk;
+    if(!readChunk(_index[(size_t)index].offset, &chunk) || chunk.magic != CHUNK_FRAME) return false;
+
+    const unsigned char* payload = &_chunk[0];
+    const unsigned char* frame   = payload + sizeof(EvoIRFrameMetadata);
+    const unsigned int frameSize = chunk.payloadSize - (unsigned int)sizeof(EvoIRFrameMetadata);
+    std::memcpy(metadata, payload, sizeof(EvoIRFrameMetadata));
+    if(chunk.codec == CODEC_RAW)
+    {
+      if(frameSize != _header.width * _header.height * sizeof(unsigned short)) return false;
+      std::memcpy(data, frame, frameSize);
+      return true;
+    }
+    return chunk.codec == CODEC_MED && recordingCodecDecode(frame, frameSize, width(), height(), data, &_scratch[0]);
+  }
+
+private:
+  EvoIRPlayback(const EvoIRPlayback&);
+  EvoIRPlayback& operator=(const EvoIRPlayback&);
+
+  // Reads chunk header and payload into _chunk, verifies size and checksum
+  bool readChunk(unsigned long long offset, RecordingChunkHeader* chunk)
+  {
+    if(recordingSeek(_file, offset) != 0 || fread(chunk, sizeof(*chunk), 1, _file) != 1) return false;
+    if(chunk->payloadSize < sizeof(EvoIRFrameMetadata) && chunk->magic == CHUNK_FRAME) return false;
+    // a corrupted size must not make us allocate beyond the file
+    if(chunk->payloadSize > _size - offset - sizeof(*chunk)) return false;
+    if(chunk->payloadSize > _chunk.size()) _chunk.resize(chunk->payloadSize);
+    if(chunk->payloadSize && fread(&_chunk[0], 1, chunk->payloadSize, _file) != chunk->payloadSize) return false;
+    return recordingCrc32(_chunk.empty() ? nullptr : &_chunk[0], chunk->payloadSize) == chunk->crc;
+  }
+
+  bool readIndex(unsigned long long size)
+  {
+    RecordingTrailer trailer;
+    if(size < sizeof(_header) + sizeof(RecordingChunkHeader) + sizeof(trailer)) return false;
+    if(recordingSeek(_file, size - sizeof(trailer)) != 0 || fread(&trailer, sizeof(trailer), 1, _file) != 1) return false;
+    if(std::memcmp(trailer.magic, RECORDING_TRAILER_MAGIC, sizeof(trailer.magic)) != 0) return false;
+    if(trailer.indexOffset < sizeof(_header) || trailer.indexOffset >= size) return false;
+
+    RecordingChunkHeader chunk;
+    if(!readChunk(trailer.indexOffset, &chunk) || chunk.magic != CHUNK_INDEX) return false;
+    const size_t count = chunk.payloadSize / sizeof(RecordingIndexEntry);
+    _index.resize(count);
+    if(count) std::memcpy(&_index[0], &_chunk[0], count * sizeof(RecordingIndexEntry));
+    return true;
+  }
+
+  // Recovery of recordings without footer: collect frame chunks up to the first broken one
+  void scan(unsigned long long size)
+  {
+    _index.clear();
+    unsigned long long offset = sizeof(_header);
+    RecordingChunkHeader chunk;
+    while(offset + sizeof(chunk) <= size)
+    {
+      if(recordingSeek(_file, offset) != 0 || fread(&chunk, sizeof(chunk), 1, _file) != 1) break;
+      if(chunk.magic != CHUNK_FRAME || offset + recordingChunkSize(chunk.payloadSize) > size) break;
+      if(!readChunk(offset, &chunk)) break;
+
+      const EvoIRFrameMetadata* metadata = (const EvoIRFrameMetadata*)&_chunk[0];
+      RecordingIndexEntry entry;
+      entry.offset    = offset;
+      entry.timestamp = metadata->timestamp;
+      entry.counter   = metadata->counter;
+      entry.flagState = (unsigned int)metadata->flagState;
+      _index.push_back(entry);
+      offset += recordingChunkSize(chunk.payloadSize);
+    }
+  }
+
+  std::mutex _mutex;
+  FILE* _file;
+  unsigned long long _size;
+  RecordingFileHeader _header;
+  std::vector<RecordingIndexEntry> _index;
+  std::vector<unsigned char> _chunk;
+  std::vector<unsigned short> _scratch;
+  bool _recovered;
+};
+
+static EvoIRHandleTable<EvoIRRecorder> g_recorders;
+static EvoIRHandleTable<EvoIRPlayback> g_playbacks;
+typedef EvoIRHandleTable<EvoIRRecorder>::Ref RecorderRef;
+typedef EvoIRHandleTable<EvoIRPlayback>::Ref PlaybackRef;
+
+} // namespace evo
+
+using namespace evo;
+
+unsigned int evo_irimager_codec_max_size(int w, int h)
+{
+  if(!recordingGeometryValid(w, h)) return 0;
+  return recordingCodecMaxSize(w, h);
+}
+
+int evo_irimager_codec_encode(const unsigned short* data, int w, int h, unsigned char* out, unsigned int* size)
+{
+  // geometry first, the size bound below is only free of overflow for valid images
+  if(!data || !out || !size || w <= 0 || h <= 0 || !recordingGeometryValid(w, h) || *size < recordingCodecMaxSize(w, h)) return -1;
+  try
+  {
+    std::vector<unsigned short> scratch(recordingCodecScratchSize(w, h));
+    *size = recordingCodecEncode(data, w, h, out, &scratch[0]);
+  }
+  catch(const std::bad_alloc&)
+  {
+    return -1;
+  }
+  return 0;
+}
+
+int evo_irimager_codec_decode(const unsigned char* in, unsigned int size, int w, int h, unsigned short* data)
+{
+  if(!in || !data || w <= 0 || h <= 0 || !recordingGeometryValid(w, h)) return -1;
+  try
+  {
+    std::vector<unsigned short> scratch(recordingCodecScratchSize(w, h));
+    return recordingCodecDecode(in, size, w, h, data, &scratch[0]) ? 0 : -1;
+  }
+  catch(const std::bad_alloc&)
+  {
+    return -1;
+  }
+}
+
+int evo_irimager_recorder_open(unsigned int* outRecId, const char* path, int w, int h, float framerate, int compress)
+{
+  if(!outRecId || !path || w <= 0 || h <= 0 || !recordingGeometryValid(w, h)) return -1;
+  EvoIRRecorder* rec = new EvoIRRecorder();
+  if(!rec->open(path, w, h, framerate, compress != 0) || !g_recorders.insert(rec, outRecId))
+  {
+    delete rec;
+    return -1;
+  }
+  return 0;
+}
+
+int evo_irimager_recorder_write_frame(const unsigned int recId, const unsigned short* data, const EvoIRFrameMetadata* metadata)
+{
+  RecorderRef rec = g_recorders.acquire(recId);
+  if(!rec || !data || !metadata) return -1;
+  return rec->writeFrame(data, metadata) ? 0 : -1;
+}
+
+int evo_irimager_recorder_flush(const unsigned int recId)
+{
+  RecorderRef rec = g_recorders.acquire(recId);
+  if(!rec) return -1;
+  return rec->flush() ? 0 : -1;
+}
+
+int evo_irimager_recorder_close(const unsigned int recId)
+{
+  EvoIRRecorder* rec = g_recorders.remove(recId);
+  if(!rec) return -1;
+  const bool ok = rec->close();
+  delete rec;
+  return ok ? 0 : -1;
+}
+
+int evo_irimager_recording_open(unsigned int* outRecId, const char* path)
+{
+  if(!outRecId || !path) return -1;
+  EvoIRPlayback* rec = new EvoIRPlayback();
+  if(!rec->open(path) || !g_playbacks.insert(rec, outRecId))
+  {
+    delete rec;
+    return -1;
+  }
+  return 0;
+}
+
+int evo_irimager_recording_get_info(const unsigned int recId, EvoIRRecordingInfo* info)
+{
+  PlaybackRef rec = g_playbacks.acquire(recId);
+  if(!rec || !info) return -1;
+  rec->info(info);
+  return 0;
+}
+
+int evo_irimager_recording_read_frame(const unsigned int recId, unsigned long long index, int* w, int* h, unsigned short* data, EvoIRFrameMetadata* metadata)
+{
+  PlaybackRef rec = g_playbacks.acquire(recId);
+  if(!rec || !w || !h || !data || !metadata) return -1;
+  if(*w != rec->width() || *h != rec->height()) return -1;
+  return rec->readFrame(index, data, metadata) ? 0 : -1;
+}
+
+int evo_irimager_recording_close(const unsigned int recId)
+{
+  EvoIRPlayback* rec = g_playbacks.remove(recId);
+  if(!rec) return -1;
+  delete rec;
+  return 0;
+}
@@ -0,0 +1,144 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRRecording.h
+ * @brief Provides recording and playback of raw thermal images for Easy API C-Library Interface
+ *
+ * Recordings store the raw unsigned short thermal images together with their
+ * EvoIRFrameMetadata in an append-only file. Frames are compressed lossless
+ * with a predictive codec, every frame forms a self-contained chunk with a
+ * checksum, and an index footer written on close allows random access.
+ * Recordings of a crashed process stay readable up to the last complete frame.
+ */
+
+#ifndef EVOIRRECORDING_H_
+#define EVOIRRECORDING_H_
+
+#include "irdirectsdk_defs.h"
+#include "EvoIRFrameMetadata.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+typedef struct __IRDIRECTSDK_API__ EvoIRRecordingInfo
+{
+  int width;                  /*!< Image width */
+  int height;                 /*!< Image height */
+  float framerate;            /*!< Nominal frame rate given when recording was created */
+  unsigned long long frames;  /*!< Number of frames */
+  long long timestampFirst;   /*!< EvoIRFrameMetadata::timestamp of first frame */
+  long long timestampLast;    /*!< EvoIRFrameMetadata::timestamp of last frame */
+  int recovered;              /*!< 1 if the index footer was missing and the recording has been scanned frame by frame */
+} EvoIRRecordingInfo;
+
+/**
+ * @brief Worst case size of a compressed thermal image
+ * @param[in] w image width
+ * @param[in] h image height
+ * @return size in bytes, 0 for images beyond the size limits of recordings
+ */
+__IRDIRECTSDK_API__ unsigned int evo_irimager_codec_max_size(int w, int h);
+
+/**
+ * @brief Compresses a thermal image lossless
+ * @param[in] data thermal image (size of w * h)
+ * @param[in] w image width
+ * @param[in] h image height
+ * @param[out] out destination buffer allocate by the user
+ * @param[in,out] size capacity of out (at least evo_irimager_codec_max_size), set to the number of bytes written
+ * @return 0 on success, -1 on error (also for images beyond the size limits of recordings)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_codec_encode(const unsigned short* data, int w, int h, unsigned char* out, unsigned int* size);
+
+/**
+ * @brief Decompresses a thermal image encoded by evo_irimager_codec_encode
+ * @param[in] in compressed data
+ * @param[in] size number of compressed bytes
+ * @param[in] w image width
+ * @param[in] h image height
+ * @param[out] data pointer to unsigned short array allocate by the user (size of w * h)
+ * @return 0 on success, -1 on error (corrupt data, image beyond the size limits of recordings)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_codec_decode(const unsigned char* in, unsigned int size, int w, int h, unsigned short* data);
+
+/**
+ * @brief Creates a new recording, an existing file is overwritten
+ * @param[out] outRecId recorder instance id for reference
+ * @param[in] path file path
+ * @param[in] w image width
+ * @param[in] h image height
+ * @param[in] framerate nominal frame rate stored in the file header
+ * @param[in] compress 1 for lossless compression, 0 to store raw frames
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_recorder_open(unsigned int* outRecId, const char* path, int w, int h, float framerate, int compress);
+
+/**
+ * @brief Appends a frame to the recording
+ * @param[in] recId recorder instance id from open to apply this function
+ * @param[in] data thermal image (size of w * h)
+ * @param[in] metadata frame metadata
+ * @return 0 on success, -1 on error (also once the recording holds 178956970 frames, the limit of its index)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_recorder_write_frame(const unsigned int recId, const unsigned short* data, const EvoIRFrameMetadata* metadata);
+
+/**
+ * @brief Hands buffered frames over to the operating system, so they survive a crash of the process
+ * @param[in] recId recorder instance id from open to apply this function
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_recorder_flush(const unsigned int recId);
+
+/**
+ * @brief Writes the index footer and closes the recording
+ * @param[in] recId recorder instance id from open to apply this function
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_recorder_close(const unsigned int recId);
+
+/**
+ * @brief Opens a recording for playback. Recordings without index footer are scanned and recovered.
+ * @param[out] outRecId playback instance id for reference
+ * @param[in] path file path
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_recording_open(unsigned int* outRecId, const char* path);
+
+/**
+ * @brief Accessor to recording properties
+ * @param[in] recId playback instance id from open to apply this function
+ * @param[out] info pointer to EvoIRRecordingInfo allocate by the user
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_recording_get_info(const unsigned int recId, EvoIRRecordingInfo* info);
+
+/**
+ * @brief Accessor to a recorded thermal image and frame metadata by reference
+ * @param[in] recId playback instance id from open to apply this function
+ * @param[in] index frame index [0; frames - 1]
+ * @param[in] w image width
+ * @param[in] h image height
+ * @param[out] data pointer to unsigned short array allocate by the user (size of w * h)
+ * @param[out] metadata pointer to EvoIRFrameMetadata allocate by the user
+ * @return 0 on success, -1 on error (index out of range, checksum mismatch)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_recording_read_frame(const unsigned int recId, unsigned long long index, int* w, int* h, unsigned short* data, EvoIRFrameMetadata* metadata);
+
+/**
+ * @brief Closes a recording opened for playback
+ * @param[in] recId playback instance id from open to apply this function
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_recording_close(const unsigned int recId);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* EVOIRRECORDING_H_ */
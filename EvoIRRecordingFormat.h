@@ -0,0 +1,231 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRRecordingFormat.h
+ * @brief On-disk layout of thermal recordings (*.evoir)
+ *
+ * Internal header shared by the readers and writers of recordings.
+ * All values are stored little endian.
+ *
+ * @code
+ * FileHeader                        32 bytes
+ * Chunk 'EFRM' (one per frame)      ChunkHeader | EvoIRFrameMetadata | frame data | padding to 8 bytes
+ * ...
+ * Chunk 'EIDX' (index footer)       ChunkHeader | IndexEntry[frames]
+ * Trailer                           offset of index chunk | "EVOIRIDX"
+ * @endcode
+ *
+ * Every chunk starts on an 8 byte boundary and carries its payload size and a
+ * CRC32 of the payload. A recording that was not closed properly (missing
+ * footer) can therefore be recovered by scanning chunk by chunk up to the
+ * first incomplete one. Frame metadata is stored in the memory layout of
+ * EvoIRFrameMetadata, so mapped recordings can be accessed in place.
+ *
+ * Search index (*.evoir.idx), written next to the recording on first access:
+ * @code
+ * IndexFileHeader                   72 bytes
+ * unsigned int[frames]              frame numbers ordered by timestamp
+ * unsigned int[frames]              frame numbers ordered by counter
+ * EvoIRFrameRun[runs]               runs of equal flagState, grouped by state
+ * @endcode
+ */
+
+#ifndef EVOIRRECORDINGFORMAT_H_
+#define EVOIRRECORDINGFORMAT_H_
+
+#include "EvoIRFrameMetadata.h"
+
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#   include <io.h>
+#else
+#   include <unistd.h>
+#endif
+
+namespace evo
+{
+
+const char         RECORDING_FILE_MAGIC[8]    = { 'E', 'V', 'O', 'I', 'R', 'R', 'E', 'C' };
+const char         RECORDING_TRAILER_MAGIC[8] = { 'E', 'V', 'O', 'I', 'R', 'I', 'D', 'X' };
+const unsigned int RECORDING_VERSION          = 1;
+const unsigned int CHUNK_FRAME                = 0x4D524645; // 'EFRM'
+const unsigned int CHUNK_INDEX                = 0x58444945; // 'EIDX'
+const char         INDEX_FILE_MAGIC[8]        = { 'E', 'V', 'O', 'I', 'R', 'S', 'I', 'X' };
+const unsigned int INDEX_FILE_VERSION         = 1;
+const unsigned int INDEX_FLAG_STATES          = 6; ///< number of EvoIRFlagState values
+const unsigned int RECORDING_MAX_SIDE         = 65535;       ///< image width and height of a recording
+const unsigned int RECORDING_MAX_PIXELS       = 1u << 26;    ///< keeps frame payloads and buffers far from 32 bit limits
+
+enum RecordingCodec
+{
+  CODEC_RAW = 0, ///< uncompressed unsigned short pixels
+  CODEC_MED = 1  ///< median edge predictor, residuals bit packed in blocks of 16 pixels
+};
+
+struct RecordingFileHeader
+{
+  char magic[8];
+  unsigned int version;
+  unsigned int width;
+  unsigned int height;
+  float framerate;
+  unsigned int reserved[2];
+};
+
+struct RecordingChunkHeader
+{
+  unsigned int magic;
+  unsigned int payloadSize; ///< bytes following the header, excluding padding
+  unsigned int crc;         ///< CRC32 of the payload
+  unsigned short codec;     ///< RecordingCodec of frame data
+  unsigned short reserved;
+};
+
+struct RecordingIndexEntry
+{
+  unsigned long long offset; ///< file offset of the frame chunk
+  long long timestamp;       ///< EvoIRFrameMetadata::timestamp
+  unsigned int counter;      ///< EvoIRFrameMetadata::counter
+  unsigned int flagState;    ///< EvoIRFrameMetadata::flagState
+};
+
+struct RecordingTrailer
+{
+  unsigned long long indexOffset;
+  char magic[8];
+};
+
+struct RecordingIndexFileHeader
+{
+  char magic[8];
+  unsigned int version;
+  unsigned int frames;
+  unsigned long long recordingSize;          ///< size of the recording the index was built for
+  long long timestampFirst;                  ///< timestamp of first frame, detects replaced recordings
+  long long timestampLast;                   ///< timestamp of last frame
+  unsigned int runOffsets[INDEX_FLAG_STATES + 1]; ///< runs of state s are [runOffsets[s]; runOffsets[s + 1])
+  unsigned int reserved;
+};
+
+static_assert(sizeof(RecordingIndexFileHeader) == 72, "unexpected index file header size");
+static_assert(sizeof(RecordingFileHeader) == 32, "unexpected file header size");
+static_assert(sizeof(RecordingChunkHeader) == 16, "unexpected chunk header size");
+static_assert(sizeof(RecordingIndexEntry) == 24, "unexpected index entry size");
+static_assert(sizeof(RecordingTrailer) == 16, "unexpected trailer size");
+static_assert(sizeof(EvoIRFrameMetadata) == 40, "unexpected EvoIRFrameMetadata size");
+
+/// frames of a recording, the index chunk of all frames has to fit the 32 bit payload size
+const unsigned int RECORDING_MAX_FRAMES = 0xFFFFFFFFu / sizeof(RecordingIndexEntry);
+
+/**
+ * @brief Checks the image size of a recording, before buffers are sized with it
+ */
+inline bool recordingGeometryValid(unsigned long long w, unsigned long long h)
+{
+  return w > 0 && h > 0 && w <= RECORDING_MAX_SIDE && h <= RECORDING_MAX_SIDE && w * h <= RECORDING_MAX_PIXELS;
+}
+
+/**
+ * @brief Size of a chunk including header and padding
+ */
+inline unsigned long long recordingChunkSize(unsigned int payloadSize)
+{
+  return (sizeof(RecordingChunkHeader) + (unsigned long long)payloadSize + 7) & ~7ULL;
+}
+
+struct RecordingCrc32Table
+{
+  unsigned int values[256];
+  RecordingCrc32Table()
+  {
+    for(unsigned int i = 0; i < 256; i++)
+    {
+      unsigned int c = i;
+      for(int k = 0; k < 8; k++)
+        c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      values[i] = c;
+    }
+  }
+};
+
+/**
+ * @brief CRC32 (IEEE 802.3), table driven
+ */
+inline unsigned int recordingCrc32(const void* data, size_t size, unsigned int crc = 0)
+{
+  static const RecordingCrc32Table table;
+  const unsigned char* p = (const unsigned char*)data;
+  crc = ~crc;
+  for(size_t i = 0; i < size; i++)
+    crc = table.values[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+  return ~crc;
+}
+
+/**
+ * @brief Worst case size of a CODEC_MED compressed image
+ */
+unsigned int recordingCodecMaxSize(int w, int h);
+
+/**
+ * @brief Number of unsigned short elements of the scratch buffer used by the codec
+ */
+unsigned int recordingCodecScratchSize(int w, int h);
+
+/**
+ * @brief Compresses an image with CODEC_MED
+ * @return number of bytes written to out (at most recordingCodecMaxSize)
+ */
+unsigned int recordingCodecEncode(const unsigned short* img, int w, int h, unsigned char* out, unsigned short* scratch);
+
+/**
+ * @brief Decompresses a CODEC_MED image
+ * @return false on corrupt data
+ */
+bool recordingCodecDecode(const unsigned char* in, unsigned int size, int w, int h, unsigned short* img, unsigned short* scratch);
+
+/**
+ * @brief 64 bit capable file positioning
+ */
+inline int recordingSeek(FILE* f, unsigned long long offset)
+{
+#ifdef _WIN32
+  return _fseeki64(f, (__int64)offset, SEEK_SET);
+#else
+  return fseeko(f, (off_t)offset, SEEK_SET);
+#endif
+}
+
+/**
+ * @brief Cuts the file off behind size bytes, buffered output is written first
+ */
+inline int recordingTruncate(FILE* f, unsigned long long size)
+{
+  if(fflush(f) != 0) return -1;
+#ifdef _WIN32
+  return _chsize_s(_fileno(f), (__int64)size) == 0 ? 0 : -1;
+#else
+  return ftruncate(fileno(f), (off_t)size);
+#endif
+}
+
+inline long long recordingFileSize(FILE* f)
+{
+#ifdef _WIN32
+  if(_fseeki64(f, 0, SEEK_END) != 0) return -1;
+  return _ftelli64(f);
+#else
+  if(fseeko(f, 0, SEEK_END) != 0) return -1;
+  return (long long)ftello(f);
+#endif
+}
+
+} // namespace evo
+
+#endif /* EVOIRRECORDINGFORMAT_H_ */
@@ -0,0 +1,527 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRRecordingMap.cpp
+ * @brief Memory mapped random access to recordings with persistent search index
+ */
+
+#include "EvoIRRecordingMap.h"
+#include "EvoIRRecordingFormat.h"
+#include "EvoIRMappedFile.h"
+#include "EvoIRHandleTable.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace evo
+{
+
+class EvoIRRecordingMap
+{
+public:
+  EvoIRRecordingMap() :
+    _header(nullptr),
+    _entries(nullptr),
+    _frames(0),
+    _recovered(false),
+    _timeOrder(nullptr),
+    _counterOrder(nullptr),
+    _runs(nullptr)
+  {
+    for(unsigned int s = 0; s <= INDEX_FLAG_STATES; s++) _runOffsets[s] = 0;
+  }
+
+  bool open(const char* path, bool persistIndex)
+  {
+    if(!_recording.open(path) || _recording.size() < sizeof(RecordingFileHeader)) return false;
+    _header = (const RecordingFileHeader*)_recording.data();
+    if(std::memcmp(_header->magic, RECORDING_FILE_MAGIC, sizeof(_header->magic)) != 0 ||
+       _header->version != RECORDING_VERSION || !recordingGeometryValid(_header->width, _header->height))
+      return false;
+
+    if(!mapFooter())
+    {
+      _recovered = true;
+      scan();
+    }
+    if(_frames > 0xFFFFFFFFULL) return false;
+
+    const std::string indexPath = std::string(path) + ".idx";
+    if(!mapIndexFile(indexPath))
+    {
+      buildIndex();
+      if(persistIndex) writeIndexFile(indexPath);
+    }
+
+    _decoded.resize((size_t)_header->width * _header->height);
+    _scratch.resize(recordingCodecScratchSize(_header->width, _header->height));
+    return true;
+  }
+
+  void info(EvoIRRecordingInfo* info) const
+  {
+    info->width          = (int)_header->width;
+    info->height         = (int)_header->height;
+    info->framerate      = _header->framerate;
+    info->frames         = _frames;
+    info->timestampFirst = _frames ? _entries[0].timestamp : 0;
+    info->timestampLast  = _frames ? _entries[_frames - 1].timestamp : 0;
+    info->recovered      = _recovered ? 1 : 0;
+  }
+
+  bool frame(unsigned int index, const unsigned short** data, const EvoIRFrameMetadata** metadata)
+  {
+    const RecordingChunkHeader* chunk = frameChunk(index);
+    if(!chunk) return false;
+    const unsigned char* payload = (const unsigned char*)(chunk + 1);
+    *metadata = (const EvoIRFrameMetadata*)payload;
+    if(chunk->codec == CODEC_RAW)
+    {
+      *data = (const unsigned short*)(payload + sizeof(EvoIRFrameMetadata));
+      return true;
+    }
+    if(!decode(chunk, &_decoded[0], &_scratch[0])) return false;
+    *data = &_decoded[0];
+    return true;
+  }
+
+  // Copies a frame, does not modify the map and may be called from several threads
+  bool readFrame(unsigned int index, unsigned short* data, EvoIRFrameMetadata* metadata, unsigned short* scratch) const
+  {
+    const RecordingChunkHeader* chunk = frameChunk(index);
+    if(!chunk) return false;
+    const unsigned char* payload = (const unsigned char*)(chunk + 1);
+    std::memcpy(metadata, payload, sizeof(EvoIRFrameMetadata));
+    if(chunk->codec == CODEC_RAW)
+    {
+      std::memcpy(data, payload + sizeof(EvoIRFrameMetadata), (size_t)_header->width * _header->height * sizeof(unsigned short));
+      return true;
+    }
+    return decode(chunk, data, scratch);
+  }
+
+  unsigned int scratchSize() const { return (unsigned int)_scratch.size(); }
+
+  bool findTime(long long timestamp, unsigned int* index) const
+  {
+    if(_frames == 0) return false;
+    const unsigned int* end = _timeOrder + _frames;
+    const unsigned int* it  = std::lower_bound(_timeOrder, end, timestamp, TimeLess(_entries));
+    if(it == end)
+      --it;
+    else if(it != _timeOrder && timestamp - _entries[*(it - 1)].timestamp < _entries[*it].timestamp - timestamp)
+      --it;
+    *index = *it;
+    return true;
+  }
+
+  void findTimeRange(long long tFirst, long long tLast, const unsigned int** frames, unsigned int* count) const
+  {
+    const unsigned int* end   = _timeOrder + _frames;
+    const unsigned int* begin = std::lower_bound(_timeOrder, end, tFirst, TimeLess(_entries));
+    const unsigned int* last  = std::upper_bound(begin, end, tLast, TimeLess(_entries));
+    *frames = begin;
+    *count  = (unsigned int)(last - begin);
+  }
+
+  bool findCounter(unsigned int counter, unsigned int* index) const
+  {
+    const unsigned int* end = _counterOrder + _frames;
+    const unsigned int* it  = std::lower_bound(_counterOrder, end, CounterKey(counter), CounterLess(_entries));
+    if(it == end || _entries[*it].counter != counter) return false;
+    *index = *it;
+    return true;
+  }
+
+  void findCounterRange(unsigned int first, unsigned int last, const unsigned int** frames, unsigned int* count) const
+  {
+    const unsigned int* end   = _counterOrder + _frames;
+    const unsigned int* begin = std::lower_bound(_counterOrder, end, CounterKey(first), CounterLess(_entries));
+    const unsigned int* stop  = std::upper_bound(begin, end, CounterKey(last), CounterLess(_entries));
+    *frames = begin;
+    *count  = (unsigned int)(stop - begin);
+  }
+
+  void flagRuns(int state, const EvoIRFrameRun** runs, unsigned int* count) const
+  {
+    *runs  = _runs + _runOffsets[state];
+    *count = _runOffsets[state + 1] - _runOffsets[state];
+  }
+
+private:
+  // Frame chunk with verified bounds, nullptr if index or chunk are invalid
+  const RecordingChunkHeader* frameChunk(unsigned int index) const
+  {
+    if(index >= _frames) return nullptr;
+    const unsigned long long offset = _entries[index].offset;
+    if(offset + sizeof(RecordingChunkHeader) + sizeof(EvoIRFrameMetadata) > _recording.size()) return nullptr;
+    const RecordingChunkHeader* chunk = (const RecordingChunkHeader*)(_recording.data() + offset);
+    if(chunk->magic != CHUNK_FRAME || chunk->payloadSize < sizeof(EvoIRFrameMetadata) ||
+       offset + sizeof(RecordingChunkHeader) + chunk->payloadSize > _recording.size())
+      return nullptr;
+    const unsigned int size = chunk->payloadSize - (unsigned int)sizeof(EvoIRFrameMetadata);
+    if(chunk->codec == CODEC_RAW && size != _header->width * _header->height * sizeof(unsigned short)) return nullptr;
+    if(chunk->codec != CODEC_RAW && chunk->codec != CODEC_MED) return nullptr;
+    return chunk;
+  }
+
+  bool decode(const RecordingChunkHeader* chunk, unsigned short* data, unsigned short* scratch) const
+  {
+    const unsigned char* pixels = (const unsigned char*)(chunk + 1) + sizeof(EvoIRFrameMetadata);
+    const unsigned int size     = chunk->payloadSize - (unsigned int)sizeof(EvoIRFrameMetadata);
+    return recordingCodecDecode(pixels, size, (int)_header->width, (int)_header->height, data, scratch);
+  }
+
+  // Comparators for searches through the order arrays, keys are read from the frame index
+  struct TimeLess
+  {
+    explicit TimeLess(const RecordingIndexEntry* e) : entries(e) { }
+    bool operator()(unsigned int a, long long t) const  { return entries[a].timestamp < t; }
+    bool operator()(long long t, unsigned int a) const  { return t < entries[a].timestamp; }
+    bool operator()(unsigned int a, unsigned int b) const
+    {
+      return entries[a].timestamp < entries[b].timestamp || (entries[a].timestamp == entries[b].timestamp && a < b);
+    }
+    const RecordingIndexEntry* entries;
+  };
+
+  // Counters and frame numbers share their type, the key is wrapped to tell them apart
+  struct CounterKey
+  {
+    explicit CounterKey(unsigned int c) : counter(c) { }
+    unsigned int counter;
+  };
+
+  struct CounterLess
+  {
+    explicit CounterLess(const RecordingIndexEntry* e) : entries(e) { }
+    bool operator()(unsigned int a, CounterKey k) const { return entries[a].counter < k.counter; }
+    bool operator()(CounterKey k, unsigned int a) const { return k.counter < entries[a].counter; }
+    const RecordingIndexEntry* entries;
+  };
+
+  struct CounterOrder
+  {
+    explicit CounterOrder(const RecordingIndexEntry* e) : entries(e) { }
+    bool operator()(unsigned int a, unsigned int b) const
+    {
+      return entries[a].counter < entries[b].counter || (entries[a].counter == entries[b].counter && a < b);
+    }
+    const RecordingIndexEntry* entries;
+  };
+
+  bool mapFooter()
+  {
+    const unsigned long long size = _recording.size();
+    if(size < sizeof(RecordingFileHeader) + sizeof(RecordingChunkHeader) + sizeof(RecordingTrailer)) return false;
+    const RecordingTrailer* trailer = (const RecordingTrailer*)(_recording.data() + size - sizeof(RecordingTrailer));
+    if(std::memcmp(trailer->magic, RECORDING_TRAILER_MAGIC, sizeof(trailer->magic)) != 0) return false;
+    if(trailer->indexOffset < sizeof(RecordingFileHeader) || (trailer->indexOffset & 7) != 0 ||
+       trailer->indexOffset + sizeof(RecordingChunkHeader) > size - sizeof(RecordingTrailer))
+      return false;
+
+    const RecordingChunkHeader* chunk = (const RecordingChunkHeader*)(_recording.data() + trailer->indexOffset);
+    if(chunk->magic != CHUNK_INDEX || chunk->payloadSize % sizeof(RecordingIndexEntry) != 0 ||
+       trailer->indexOffset + sizeof(RecordingChunkHeader) + chunk->payloadSize > size - sizeof(RecordingTrailer) ||
+       recordingCrc32(chunk + 1, chunk->payloadSize) != chunk->crc)
+      return false;
+    _entries = (const RecordingIndexEntry*)(chunk + 1);
+    _frames  = chunk->payloadSize / sizeof(RecordingIndexEntry);
+    return true;
+  }
+
+  void scan()
+  {
+    const unsigned long long size = _recording.size();
+    unsigned long long offset = sizeof(RecordingFileHeader);
+    while(offset + sizeof(RecordingChunkHeader) <= size)
+    {
+      const RecordingChunkHeader* chunk = (const RecordingChunkHeader*)(_recording.data() + offset);
+      if(chunk->magic != CHUNK_FRAME || chunk->payloadSize < sizeof(EvoIRFrameMetadata) ||
+         offset + recordingChunkSize(chunk->payloadSize) > size ||
+         recordingCrc32(chunk + 1, chunk->payloadSize) != chunk->crc)
+        break;
+
+      const EvoIRFrameMetadata* metadata = (const EvoIRFrameMetadata*)(chunk + 1);
+      RecordingIndexEntry entry;
+      entry.offset    = offset;
+      entry.timestamp = metadata->timestamp;
+      entry.counter   = metadata->counter;
+      entry.flagState = (unsigned int)metadata->flagState;
+      _scannedEntries.push_back(entry);
+      offset += recordingChunkSize(chunk->payloadSize);
+    }
+    _entries = _scannedEntries.empty() ? nullptr : &_scannedEntries[0];
+    _frames  = _scannedEntries.size();
+  }
+
+  bool mapIndexFile(const std::string& path)
+  {
+    if(!_indexFile.open(path.c_str()) || _indexFile.size() < sizeof(RecordingIndexFileHeader)) return false;
+    const RecordingIndexFileHeader* h = (const RecordingIndexFileHeader*)_indexFile.data();
+    const unsigned int runs = h->runOffsets[INDEX_FLAG_STATES];
+    if(std::memcmp(h->magic, INDEX_FILE_MAGIC, sizeof(h->magic)) != 0 || h->version != INDEX_FILE_VERSION ||
+       h->frames != _frames || h->recordingSize != _recording.size() ||
+       h->timestampFirst != (_frames ? _entries[0].timestamp : 0) ||
+       h->timestampLast != (_frames ? _entries[_frames - 1].timestamp : 0) ||
+       _indexFile.size() != sizeof(*h) + 2 * _frames * sizeof(unsigned int) + runs * sizeof(EvoIRFrameRun))
+    {
+      _indexFile.close();
+      return false;
+    }
+    for(unsigned int s = 0; s <= INDEX_FLAG_STATES; s++)
+    {
+      if(h->runOffsets[s] > runs || (s > 0 && h->runOffsets[s] < h->runOffsets[s - 1]))
+      {
+        _indexFile.close();
+        return false;
+      }
+      _runOffsets[s] = h->runOffsets[s];
+    }
+    // A damaged index file must neither make lookups read outside of the recording nor
+    // return wrong results, it is rebuilt instead
+    const unsigned int* order = (const unsigned int*)(h + 1);
+    const EvoIRFrameRun* runList = (const EvoIRFrameRun*)(order + 2 * _frames);
+    if(!ordered(order, TimeLess(_entries)) || !ordered(order + _frames, CounterOrder(_entries)) || !runsValid(runList))
+    {
+      _indexFile.close();
+      return false;
+    }
+    _timeOrder    = order;
+    _counterOrder = _timeOrder + _frames;
+    _runs         = runList;
+    return true;
+  }
+
+  // Strictly ascending under an order that breaks ties by frame number, which also
+  // makes the frame numbers distinct, i.e. a permutation of [0; frames)
+  template<class Less>
+  bool ordered(const unsigned int* order, Less less) const
+  {
+    for(unsigned long long i = 0; i < _frames; i++)
+    {
+      if(order[i] >= _frames) return false;
+      if(i > 0 && !less(order[i - 1], order[i])) return false;
+    }
+    return true;
+  }
+
+  // Runs of each state ascending, maximal and of frames in that state, together covering every frame once
+  bool runsValid(const EvoIRFrameRun* runList) const
+  {
+    unsigned long long covered = 0;
+    for(unsigned int s = 0; s < INDEX_FLAG_STATES; s++)
+    {
+      unsigned long long next = 0;
+      for(unsigned int r = _runOffsets[s]; r < _runOffsets[s + 1]; r++)
+      {
+        const EvoIRFrameRun& run = runList[r];
+        const unsigned long long end = (unsigned long long)run.first + run.count;
+        if(run.count == 0 || run.first < next || end > _frames) return false;
+        if((run.first > 0 && flagStateOf(run.first - 1) == s) || (end < _frames && flagStateOf((unsigned int)end) == s)) return false;
+        for(unsigned int i = run.first; i < end; i++)
+          if(flagStateOf(i) != s) return false;
+        covered += run.count;
+        next = end;
+      }
+    }
+    return covered == _frames;
+  }
+
+  void buildIndex()
+  {
+    const unsigned int n = (unsigned int)_frames;
+    _builtTimeOrder.resize(n);
+    _builtCounterOrder.resize(n);
+    for(unsigned int i = 0; i < n; i++)
+      _builtTimeOrder[i] = _builtCounterOrder[i] = i;
+
+    // Frames are usually recorded in order, sorting is skipped in that case
+    TimeLess timeLess(_entries);
+    if(!std::is_sorted(_builtTimeOrder.begin(), _builtTimeOrder.end(), timeLess))
+      std::sort(_builtTimeOrder.begin(), _builtTimeOrder.end(), timeLess);
+    CounterOrder counterOrder(_entries);
+    if(!std::is_sorted(_builtCounterOrder.begin(), _builtCounterOrder.end(), counterOrder))
+      std::sort(_builtCounterOrder.begin(), _builtCounterOrder.end(), counterOrder);
+
+    // Runs of equal flag state, grouped by state
+    std::vector<EvoIRFrameRun> perState[INDEX_FLAG_STATES];
+    for(unsigned int i = 0; i < n; )
+    {
+      const unsigned int state = flagStateOf(i);
+      EvoIRFrameRun run;
+      run.first = i;
+      while(i < n && flagStateOf(i) == state) i++;
+      run.count = i - run.first;
+      perState[state].push_back(run);
+    }
+    _builtRuns.clear();
+    for(unsigned int s = 0; s < INDEX_FLAG_STATES; s++)
+    {
+      _runOffsets[s] = (unsigned int)_builtRuns.size();
+      _builtRuns.insert(_builtRuns.end(), perState[s].begin(), perState[s].end());
+    }
+    _runOffsets[INDEX_FLAG_STATES] = (unsigned int)_builtRuns.size();
+
+    _timeOrder    = n ? &_builtTimeOrder[0] : nullptr;
+    _counterOrder = n ? &_builtCounterOrder[0] : nullptr;
+    _runs         = _builtRuns.empty() ? nullptr : &_builtRuns[0];
+  }
+
+  // Written to a temporary file first, so a crash never leaves a truncated index behind
+  void writeIndexFile(const std::string& path) const
+  {
+    RecordingIndexFileHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, INDEX_FILE_MAGIC, sizeof(h.magic));
+    h.version        = INDEX_FILE_VERSION;
+    h.frames         = (unsigned int)_frames;
+    h.recordingSize  = _recording.size();
+    h.timestampFirst = _frames ? _entries[0].timestamp : 0;
+    h.timestampLast  = _frames ? _entries[_frames - 1].timestamp : 0;
+    for(unsigned int s = 0; s <= INDEX_FLAG_STATES; s++) h.runOffsets[s] = _runOffsets[s];
+
+    const std::string tmp = path + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "wb");
+    if(!f) return;
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1;
+    if(ok && _frames)
+    {
+      ok = fwrite(_timeOrder, sizeof(unsigned int), (size_t)_frames, f) == _frames &&
+           fwrite(_counterOrder, sizeof(unsigned int), (size_t)_frames, f) == _frames;
+    }
+    if(ok && !_builtRuns.empty())
+      ok = fwrite(&_builtRuns[0], sizeof(EvoIRFrameRun), _builtRuns.size(), f) == _builtRuns.size();
+    ok = (fclose(f) == 0) && ok;
+    if(ok)
+    {
+      std::remove(path.c_str());
+      ok = std::rename(tmp.c_str(), path.c_str()) == 0;
+    }
+    if(!ok) std::remove(tmp.c_str());
+  }
+
+  unsigned int flagStateOf(unsigned int i) const
+  {
+    const unsigned int state = _entries[i].flagState;
+    return state < INDEX_FLAG_STATES ? state : (unsigned int)irFlagError;
+  }
+
+  EvoIRMappedFile _recording;
+  EvoIRMappedFile _indexFile;
+  const RecordingFileHeader* _header;
+  const RecordingIndexEntry* _entries;
+  unsigned long long _frames;
+  bool _recovered;
+
+  const unsigned int* _timeOrder;
+  const unsigned int* _counterOrder;
+  const EvoIRFrameRun* _runs;
+  unsigned int _runOffsets[INDEX_FLAG_STATES + 1];
+
+  // Heap storage, used if the recording has no footer or the index file could not be mapped
+  std::vector<RecordingIndexEntry> _scannedEntries;
+  std::vector<unsigned int> _builtTimeOrder;
+  std::vector<unsigned int> _builtCounterOrder;
+  std::vector<EvoIRFrameRun> _builtRuns;
+
+  std::vector<unsigned short> _decoded;
+  std::vector<unsigned short> _scratch;
+};
+
+static EvoIRHandleTable<EvoIRRecordingMap> g_maps;
+typedef EvoIRHandleTable<EvoIRRecordingMap>::Ref MapRef;
+
+} // namespace evo
+
+using namespace evo;
+
+int evo_irimager_recording_map_open(unsigned int* outMapId, const char* path, int persistIndex)
+{
+  if(!outMapId || !path) return -1;
+  EvoIRRecordingMap* map = new EvoIRRecordingMap();
+  if(!map->open(path, persistIndex != 0) || !g_maps.insert(map, outMapId))
+  {
+    delete map;
+    return -1;
+  }
+  return 0;
+}
+
+int evo_irimager_recording_map_close(const unsigned int mapId)
+{
+  EvoIRRecordingMap* map = g_maps.remove(mapId);
+  if(!map) return -1;
+  delete map;
+  return 0;
+}
+
+int evo_irimager_recording_map_get_info(const unsigned int mapId, EvoIRRecordingInfo* info)
+{
+  MapRef map = g_maps.acquire(mapId);
+  if(!map || !info) return -1;
+  map->info(info);
+  return 0;
+}
+
+int evo_irimager_recording_map_get_frame(const unsigned int mapId, unsigned int index, const unsigned short** data, const EvoIRFrameMetadata** metadata)
+{
+  MapRef map = g_maps.acquire(mapId);
+  if(!map || !data || !metadata) return -1;
+  return map->frame(index, data, metadata) ? 0 : -1;
+}
+
+int evo_irimager_recording_map_read_frame(const unsigned int mapId, unsigned int index, unsigned short* data, EvoIRFrameMetadata* metadata)
+{
+  MapRef map = g_maps.acquire(mapId);
+  if(!map || !data || !metadata) return -1;
+  // one scratch buffer per thread, sized for the largest recording read so far
+  static thread_local std::vector<unsigned short> scratch;
+  if(scratch.size() < map->scratchSize()) scratch.resize(map->scratchSize());
+  return map->readFrame(index, data, metadata, scratch.empty() ? nullptr : &scratch[0]) ? 0 : -1;
+}
+
+int evo_irimager_recording_map_find_time(const unsigned int mapId, long long timestamp, unsigned int* index)
+{
+  MapRef map = g_maps.acquire(mapId);
+  if(!map || !index) return -1;
+  return map->findTime(timestamp, index) ? 0 : -1;
+}
+
+int evo_irimager_recording_map_find_time_range(const unsigned int mapId, long long tFirst, long long tLast, const unsigned int** frames, unsigned int* count)
+{
+  MapRef map = g_maps.acquire(mapId);
+  if(!map || !frames || !count || tLast < tFirst) return -1;
+  map->findTimeRange(tFirst, tLast, frames, count);
+  return 0;
+}
+
+int evo_irimager_recording_map_find_counter(const unsigned int mapId, unsigned int counter, unsigned int* index)
+{
+  MapRef map = g_maps.acquire(mapId);
+  if(!map || !index) return -1;
+  return map->findCounter(counter, index) ? 0 : -1;
+}
+
+int evo_irimager_recording_map_find_counter_range(const unsigned int mapId, unsigned int first, unsigned int last, const unsigned int** frames, unsigned int* count)
+{
+  MapRef map = g_maps.acquire(mapId);
+  if(!map || !frames || !count || last < first) return -1;
+  map->findCounterRange(first, last, frames, count);
+  return 0;
+}
+
+int evo_irimager_recording_map_get_flag_runs(const unsigned int mapId, int flagState, const EvoIRFrameRun** runs, unsigned int* count)
+{
+  MapRef map = g_maps.acquire(mapId);
+  if(!map || !runs || !count || flagState < 0 || flagState >= (int)INDEX_FLAG_STATES) return -1;
+  map->flagRuns(flagState, runs, count);
+  return 0;
+}
@@ -0,0 +1,145 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRRecordingMap.h
+ * @brief Provides memory mapped random access to recordings for Easy API C-Library Interface
+ *
+ * The recording (see EvoIRRecording.h) is mapped into the address space of the
+ * process. A search index on timestamp, counter and shutter flag state is
+ * kept in a file next to the recording (<recording>.idx) and is built on
+ * first access. An index file that does not belong to the recording or
+ * fails its consistency checks is rebuilt. Lookups are binary searches,
+ * results are handed out as pointers into the mapped files, i.e. without
+ * copying.
+ *
+ * Pointers stay valid until the map is closed. The Matlab type of pointer
+ * arguments to pointers is voidPtrPtr, use setdatatype to read the result.
+ */
+
+#ifndef EVOIRRECORDINGMAP_H_
+#define EVOIRRECORDINGMAP_H_
+
+#include "irdirectsdk_defs.h"
+#include "EvoIRFrameMetadata.h"
+#include "EvoIRRecording.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Consecutive frames sharing the same shutter flag state
+ */
+typedef struct __IRDIRECTSDK_API__ EvoIRFrameRun
+{
+  unsigned int first; /*!< Index of first frame */
+  unsigned int count; /*!< Number of frames */
+} EvoIRFrameRun;
+
+/**
+ * @brief Maps a recording for random access
+ * @param[out] outMapId map instance id for reference
+ * @param[in] path path of recording
+ * @param[in] persistIndex 1 to store a newly built search index next to the recording, 0 to keep it in memory only
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_recording_map_open(unsigned int* outMapId, const char* path, int persistIndex);
+
+/**
+ * @brief Unmaps a recording
+ * @param[in] mapId map instance id from open to apply this function
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_recording_map_close(const unsigned int mapId);
+
+/**
+ * @brief Accessor to recording properties
+ * @param[in] mapId map instance id from open to apply this function
+ * @param[out] info pointer to EvoIRRecordingInfo allocate by the user
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_recording_map_get_info(const unsigned int mapId, EvoIRRecordingInfo* info);
+
+/**
+ * @brief Accessor to a frame by index without copying.
+ * Frames stored uncompressed point into the mapped file. Compressed frames are decoded into a buffer
+ * of the map instance, which is overwritten by the next call for a compressed frame.
+ * @param[in] mapId map instance id from open to apply this function
+ * @param[in] index frame index [0; frames - 1]
+ * @param[out] data pointer to thermal image (size of w * h)
+ * @param[out] metadata pointer to frame metadata
+ * @return 0 on success, -1 on error (index out of range, corrupt frame)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_recording_map_get_frame(const unsigned int mapId, unsigned int index, const unsigned short** data, const EvoIRFrameMetadata** metadata);
+
+/**
+ * @brief Copies a frame by index. Unlike evo_irimager_recording_map_get_frame it does not use buffers of the map instance,
+ * so several threads may read frames of the same map concurrently.
+ * @param[in] mapId map instance id from open to apply this function
+ * @param[in] index frame index [0; frames - 1]
+ * @param[out] data pointer to thermal image allocate by the user (size of w * h)
+ * @param[out] metadata pointer to EvoIRFrameMetadata allocate by the user
+ * @return 0 on success, -1 on error (index out of range, corrupt frame)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_recording_map_read_frame(const unsigned int mapId, unsigned int index, unsigned short* data, EvoIRFrameMetadata* metadata);
+
+/**
+ * @brief Finds the frame captured closest to a point in time
+ * @param[in] mapId map instance id from open to apply this function
+ * @param[in] timestamp time in UNITS (10000000 per second), see EvoIRFrameMetadata::timestamp
+ * @param[out] index frame index
+ * @return 0 on success, -1 on error (empty recording)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_recording_map_find_time(const unsigned int mapId, long long timestamp, unsigned int* index);
+
+/**
+ * @brief Finds all frames captured within a time interval
+ * @param[in] mapId map instance id from open to apply this function
+ * @param[in] tFirst begin of interval (inclusive) in UNITS
+ * @param[in] tLast end of interval (inclusive) in UNITS
+ * @param[out] frames pointer to frame indices ordered by timestamp
+ * @param[out] count number of frame indices
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_recording_map_find_time_range(const unsigned int mapId, long long tFirst, long long tLast, const unsigned int** frames, unsigned int* count);
+
+/**
+ * @brief Finds a frame by EvoIRFrameMetadata::counter
+ * @param[in] mapId map instance id from open to apply this function
+ * @param[in] counter frame counter
+ * @param[out] index frame index
+ * @return 0 on success, -1 on error or if no frame carries this counter
+ */
+__IRDIRECTSDK_API__ int evo_irimager_recording_map_find_counter(const unsigned int mapId, unsigned int counter, unsigned int* index);
+
+/**
+ * @brief Finds all frames with a counter within [first; last]
+ * @param[in] mapId map instance id from open to apply this function
+ * @param[in] first first counter (inclusive)
+ * @param[in] last last counter (inclusive)
+ * @param[out] frames pointer to frame indices ordered by counter
+ * @param[out] count number of frame indices
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_recording_map_find_counter_range(const unsigned int mapId, unsigned int first, unsigned int last, const unsigned int** frames, unsigned int* count);
+
+/**
+ * @brief Accessor to all runs of frames captured in a given shutter flag state
+ * @param[in] mapId map instance id from open to apply this function
+ * @param[in] flagState state of shutter flag, see EvoIRFlagState
+ * @param[out] runs pointer to runs ordered by frame index
+ * @param[out] count number of runs
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_recording_map_get_flag_runs(const unsigned int mapId, int flagState, const EvoIRFrameRun** runs, unsigned int* count);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* EVOIRRECORDINGMAP_H_ */
@@ -0,0 +1,52 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRRemap.h
+ * @brief Bilinear remap table kernels
+ *
+ * Internal header, only used by the implementation files of the Easy API
+ * extensions. Implemented in EvoIRUndistort.cpp, see there for the layout of
+ * the table: per output pixel the offset of the top left source pixel and the
+ * weights of the top and bottom source pair, packed with remapPack, summing up
+ * to REMAP_FRAC_ONE^2 over all four.
+ */
+
+#ifndef EVOIRREMAP_H_
+#define EVOIRREMAP_H_
+
+#include <cstddef>
+
+namespace evo
+{
+
+const int REMAP_FRAC_BITS = 7;                    // source positions in 1/128 pixel
+const int REMAP_FRAC_ONE  = 1 << REMAP_FRAC_BITS;
+
+inline unsigned int remapPack(int lo, int hi)
+{
+  return (unsigned int)lo | ((unsigned int)hi << 16);
+}
+
+/**
+ * @brief Splits a source position into the index of the left/top neighbour and the fraction of the right/bottom one, false if outside [0; size - 1]
+ */
+bool remapQuantize(double pos, int size, int* index, int* frac);
+
+/**
+ * @brief Resamples n output pixels of a thermal image with source row stride stride
+ */
+void remapThermal(const unsigned short* src, size_t stride, const unsigned int* offset, const unsigned int* wTop, const unsigned int* wBottom, size_t n, unsigned short* out);
+
+/**
+ * @brief Resamples n output pixels of an interleaved rgb image of pixels source pixels
+ */
+void remapRgb(const unsigned char* src, size_t stride, size_t pixels, const unsigned int* offset, const unsigned int* wTop, const unsigned int* wBottom, size_t n, unsigned char* out);
+
+} // namespace evo
+
+#endif /* EVOIRREMAP_H_ */
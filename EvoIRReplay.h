@@ -0,0 +1,96 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRReplay.h
+ * @brief Provides a replay backend implementing direct_binding.h without a camera
+ *
+ * EvoIRBindingStub.cpp implements all functions of direct_binding.h, single
+ * and multi camera. Link it instead of libirimager to run, benchmark or
+ * regression-test code written against the Easy API on machines without a
+ * camera. Every evo_irimager_usb_init / evo_irimager_multi_usb_init opens a
+ * camera serving the frames described by the replay parameters set last:
+ *
+ * - synthetic: frames of EvoIRSyntheticSource.h, with the size and frame rate
+ *   of a format of the Formats.def passed to init (channel 0), or given
+ *   explicitly. Equal seeds produce equal frame sequences.
+ * - recording: the frames and metadata of a recording (EvoIRRecording.h),
+ *   optionally looped.
+ *
+ * Frames are either paced with the cadence of the source, the frame rate or
+ * the recorded timestamps, or delivered as fast as possible. A paced camera
+ * delivers the frames a caller fell behind with at once, like the buffer
+ * queue of the library. Palette images are rendered with EvoIRPalette.h in
+ * the channel order of the library on the platform. No accessor allocates
+ * memory once the camera is initialized.
+ *
+ * @code
+ * EvoIRReplayParams params;
+ * evo_irimager_replay_default_params(&params);
+ * params.formatIndex = 3;   // 4th [Format] block of Formats.def
+ * params.realtime    = 0;
+ * evo_irimager_replay_set_params(&params);
+ * evo_irimager_multi_usb_init(&camId, "generic.xml", "Formats.def", 0);
+ * @endcode
+ */
+
+#ifndef EVOIRREPLAY_H_
+#define EVOIRREPLAY_H_
+
+#include "irdirectsdk_defs.h"
+
+#define EVO_REPLAY_MAX_PATH 260
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+typedef enum
+{
+  EVO_REPLAY_SYNTHETIC = 0, /*!< synthetic frames */
+  EVO_REPLAY_RECORDING = 1  /*!< frames of a recording */
+} EvoIRReplaySource;
+
+typedef struct __IRDIRECTSDK_API__ EvoIRReplayParams
+{
+  int source;                          /*!< EvoIRReplaySource */
+  char recording[EVO_REPLAY_MAX_PATH]; /*!< path of recording for EVO_REPLAY_RECORDING */
+  int loop;                            /*!< 1: a recording starts over after its last frame, counters and timestamps continue; 0: accessors fail at the end */
+  int formatIndex;                     /*!< synthetic: index of [Format] block in Formats.def, -1 to use width, height and framerate */
+  int width;                           /*!< synthetic: image width for formatIndex -1 */
+  int height;                          /*!< synthetic: image height for formatIndex -1 */
+  float framerate;                     /*!< synthetic: frame rate in Hz for formatIndex -1 */
+  unsigned int seed;                   /*!< synthetic: seed of random generator */
+  int realtime;                        /*!< 1: frames are paced with the cadence of the source, 0: delivered as fast as possible */
+  unsigned long serial;                /*!< serial number reported, 0 to number the cameras in order of init starting with 1 */
+  long long frameLimit;                /*!< frames delivered after init, the accessors fail afterwards as for an unplugged camera; -1 for no limit */
+} EvoIRReplayParams;
+
+/**
+ * @brief Fills replay parameters with default values: synthetic 382 x 288 frames at 80 Hz (PI 400) in real time
+ * @param[out] params pointer to EvoIRReplayParams allocate by the user
+ */
+__IRDIRECTSDK_API__ void evo_irimager_replay_default_params(EvoIRReplayParams* params);
+
+/**
+ * @brief Sets the parameters of cameras initialized afterwards. Cameras already initialized keep theirs.
+ * @param[in] params replay parameters
+ * @return 0 on success, -1 on error (invalid parameters)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_replay_set_params(const EvoIRReplayParams* params);
+
+/**
+ * @brief Accessor to the parameters of cameras initialized next
+ * @param[out] params pointer to EvoIRReplayParams allocate by the user
+ */
+__IRDIRECTSDK_API__ void evo_irimager_replay_get_params(EvoIRReplayParams* params);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* EVOIRREPLAY_H_ */
@@ -0,0 +1,552 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRRoi.cpp
+ * @brief Span based evaluation of regions of interest
+ *
+ * Adding or removing regions only marks the evaluation plan as outdated. The
+ * plan, i.e. the spans of all regions sorted by row, is rebuilt on the next
+ * evaluation. Each span is reduced to minimum, maximum and sum with SIMD
+ * kernels, short spans with a plain loop; the location of an extremum is only
+ * searched in spans improving on it.
+ */
+
+#include "EvoIRRoi.h"
+#include "EvoIRSimd.h"
+#include "EvoIRHandleTable.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <mutex>
+#include <vector>
+
+namespace evo
+{
+
+namespace
+{
+
+const double KELVIN = 273.15;
+
+// Shorter spans are left to the plain loop: the kernels would run their scalar
+// tail anyway and add the horizontal reduction on top
+const int SIMD_MIN_SPAN = 16;
+
+struct Span
+{
+  int y;
+  int x0;
+  int len;
+  unsigned int roi; // position in plan
+};
+
+bool spanLess(const Span& a, const Span& b)
+{
+  return (a.y != b.y) ? a.y < b.y : a.x0 < b.x0;
+}
+
+void spanStatsScalar(const unsigned short* p, int n, unsigned short* mn, unsigned short* mx, unsigned int* sum)
+{
+  unsigned short lo = 0xFFFF, hi = 0;
+  unsigned int s = 0;
+  for(int i = 0; i < n; i++)
+  {
+    const unsigned short v = p[i];
+    if(v < lo) lo = v;
+    if(v > hi) hi = v;
+    s += v;
+  }
+  *mn  = lo;
+  *mx  = hi;
+  *sum = s;
+}
+
+#if EVO_SIMD_X86
+
+EVO_TARGET_SSE41 void spanStatsSse41(const unsigned short* p, int n, unsigned short* mn, unsigned short* mx, unsigned int* sum)
+{
+  __m128i vmin = _mm_set1_epi16((short)0xFFFF);
+  __m128i vmax = _mm_setzero_si128();
+  __m128i vsum = _mm_setzero_si128();
+  const __m128i zero = _mm_setzero_si128();
+  int i = 0;
+  for(; i + 8 <= n; i += 8)
+  {
+    const __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+    vmin = _mm_min_epu16(vmin, v);
+    vmax = _mm_max_epu16(vmax, v);
+    vsum = _mm_add_epi32(vsum, _mm_add_epi32(_mm_unpacklo_epi16(v, zero), _mm_unpackhi_epi16(v, zero)));
+  }
+  unsigned short lo, hi;
+  unsigned int s;
+  spanStatsScalar(p + i, n - i, &lo, &hi, &s);
+  // minpos yields the minimum of 8 unsigned words, the maximum is the inverted minimum of inverted values
+  const unsigned short vlo = (unsigned short)_mm_extract_epi16(_mm_minpos_epu16(vmin), 0);
+  const unsigned short vhi = (unsigned short)~_mm_extract_epi16(_mm_minpos_epu16(_mm_xor_si128(vmax, _mm_set1_epi16(-1))), 0);
+  vsum = _mm_add_epi32(vsum, _mm_srli_si128(vsum, 8));
+  vsum = _mm_add_epi32(vsum, _mm_srli_si128(vsum, 4));
+  *mn  = (n >= 8 && vlo < lo) ? vlo : lo;
+  *mx  = (n >= 8 && vhi > hi) ? vhi : hi;
+  *sum = s + (unsigned int)_mm_cvtsi128_si32(vsum);
+}
+
+EVO_TARGET_AVX2 void spanStatsAvx2(const unsigned short* p, int n, unsigned short* mn, unsigned short* mx, unsigned int* sum)
+{
+  // Tails are handled here with 128 bit VEX instructions, calling the SSE kernel would mix encodings
+  __m256i vmin = _mm256_set1_epi16((short)0xFFFF);
+  __m256i vmax = _mm256_setzero_si256();
+  __m256i vsum = _mm256_setzero_si256();
+  const __m256i zero = _mm256_setzero_si256();
+  int i = 0;
+  for(; i + 16 <= n; i += 16)
+  {
+    const __m256i v = _mm256_loadu_si256((const __m256i*)(p + i));
+    vmin = _mm256_min_epu16(vmin, v);
+    vmax = _mm256_max_epu16(vmax, v);
+    vsum = _mm256_add_epi32(vsum, _mm256_add_epi32(_mm256_unpacklo_epi16(v, zero), _mm256_unpackhi_epi16(v, zero)));
+  }
+  __m128i min128 = _mm_min_epu16(_mm256_castsi256_si128(vmin), _mm256_extracti128_si256(vmin, 1));
+  __m128i max128 = _mm_max_epu16(_mm256_castsi256_si128(vmax), _mm256_extracti128_si256(vmax, 1));
+  __m128i sum128 = _mm_add_epi32(_mm256_castsi256_si128(vsum), _mm256_extracti128_si256(vsum, 1));
+  if(i + 8 <= n)
+  {
+    const __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+    min128 = _mm_min_epu16(min128, v);
+    max128 = _mm_max_epu16(max128, v);
+    sum128 = _mm_add_epi32(sum128, _mm_add_epi32(_mm_unpacklo_epi16(v, _mm256_castsi256_si128(zero)), _mm_unpackhi_epi16(v, _mm256_castsi256_si128(zero))));
+    i += 8;
+  }
+  unsigned short lo = (unsigned short)_mm_extract_epi16(_mm_minpos_epu16(min128), 0);
+  unsigned short hi = (unsigned short)~_mm_extract_epi16(_mm_minpos_epu16(_mm_xor_si128(max128, _mm_set1_epi16(-1))), 0);
+  sum128 = _mm_add_epi32(sum128, _mm_srli_si128(sum128, 8));
+  sum128 = _mm_add_epi32(sum128, _mm_srli_si128(sum128, 4));
+  unsigned int s = (unsigned int)_mm_cvtsi128_si32(sum128);
+  for(; i < n; i++)
+  {
+    const unsigned short v = p[i];
+    if(v < lo) lo = v;
+    if(v > hi) hi = v;
+    s += v;
+  }
+  *mn  = lo;
+  *mx  = hi;
+  *sum = s;
+}
+
+#endif // EVO_SIMD_X86
+
+typedef void (*SpanStatsFunction)(const unsigned short*, int, unsigned short*, unsigned short*, unsigned int*);
+
+SpanStatsFunction spanStatsFunction()
+{
+#if EVO_SIMD_X86
+  const int level = simdLevel();
+  if(level >= SIMD_AVX2)  return spanStatsAvx2;
+  if(level >= SIMD_SSE41) return spanStatsSse41;
+#endif
+  return spanStatsScalar;
+}
+
+int find(const unsigned short* p, int n, unsigned short v)
+{
+  for(int i = 0; i < n; i++)
+    if(p[i] == v) return i;
+  return 0;
+}
+
+double pow4(double k)
+{
+  const double k2 = k * k;
+  return k2 * k2;
+}
+
+} // namespace
+
+class EvoIRRoiEngine
+{
+public:
+  EvoIRRoiEngine(int w, int h, short decimalPlaces) :
+    _width(w),
+    _height(h),
+    _scale(std::pow(10.0, -decimalPlaces)),
+    _emissivity(1.0),
+    _transmissivity(1.0),
+    _tAmbient(25.0),
+    _dirty(true)
+  {
+  }
+
+  ~EvoIRRoiEngine()
+  {
+    for(size_t i = 0; i < _rois.size(); i++)
+      delete _rois[i];
+  }
+
+  bool addRect(int x, int y, int w, int h, unsigned int* id)
+  {
+    const int x0 = std::max(x, 0), x1 = std::min(x + w, _width);
+    const int y0 = std::max(y, 0), y1 = std::min(y + h, _height);
+    if(w <= 0 || h <= 0 || x0 >= x1 || y0 >= y1) return false;
+    Roi* roi = new Roi();
+    for(int r = y0; r < y1; r++)
+      roi->addSpan(r, x0, x1 - x0);
+    return insert(roi, id);
+  }
+
+  bool addPolygon(const float* xy, int points, unsigned int* id)
+  {
+    float yMin = xy[1], yMax = xy[1];
+    for(int i = 1; i < points; i++)
+    {
+      yMin = std::min(yMin, xy[2 * i + 1]);
+      yMax = std::max(yMax, xy[2 * i + 1]);
+    }
+    const int r0 = std::max((int)std::floor(yMin), 0);
+    const int r1 = std::min((int)std::ceil(yMax), _height);
+
+    Roi* roi = new Roi();
+    std::vector<double> xs;
+    for(int r = r0; r < r1; r++)
+    {
+      // intersections of the pixel center line with all edges
+      const double yc = r + 0.5;
+      xs.clear();
+      for(int i = 0, j = points - 1; i < points; j = i++)
+      {
+        const double xi = xy[2 * i], yi = xy[2 * i + 1];
+        const double xj = xy[2 * j], yj = xy[2 * j + 1];
+        if((yi <= yc) != (yj <= yc))
+          xs.push_back(xi + (yc - yi) * (xj - xi) / (yj - yi));
+      }
+      std::sort(xs.begin(), xs.end());
+      for(size_t k = 0; k + 1 < xs.size(); k += 2)
+      {
+        const int x0 = std::max((int)std::ceil(xs[k] - 0.5), 0);
+        const int x1 = std::min((int)std::ceil(xs[k + 1] - 0.5), _width);
+        if(x1 > x0) roi->addSpan(r, x0, x1 - x0);
+      }
+    }
+    if(roi->pixels == 0)
+    {
+      delete roi;
+      return false;
+    }
+    return insert(roi, id);
+  }
+
+  bool remove(unsigned int id)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(id >= _rois.size() || !_rois[id]) return false;
+    delete _rois[id];
+    _rois[id] = nullptr;
+    _dirty    = true;
+    return true;
+  }
+
+  bool setAlarm(unsigned int id, float tLow, float tHigh)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(id >= _rois.size() || !_rois[id]) return false;
+    _rois[id]->tLow  = tLow;
+    _rois[id]->tHigh = tHigh;
+    return true;
+  }
+
+  void setCameraRadiation(float emissivity, float transmissivity, float tAmbient)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _emissivity     = emissivity;
+    _transmissivity = transmissivity;
+    _tAmbient       = tAmbient;
+  }
+
+  bool setRadiation(unsigned int id, float emissivity, float transmissivity, float tAmbient)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(id >= _rois.size() || !_rois[id]) return false;
+    Roi& roi = *_rois[id];
+    roi.radiation      = emissivity > 0.f;
+    roi.emissivity     = emissivity;
+    roi.transmissivity = transmissivity;
+    roi.tAmbient       = tAmbient;
+    return true;
+  }
+
+  unsigned int count()
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    unsigned int n = 0;
+    for(size_t i = 0; i < _rois.size(); i++)
+      if(_rois[i]) n++;
+    return n;
+  }
+
+  bool evaluate(const unsigned short* data, EvoIRRoiResult* results, unsigned int capacity, unsigned int* count)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(_dirty) rebuild();
+    if(_plan.size() > capacity) return false;
+
+    for(size_t i = 0; i < _acc.size(); i++)
+    {
+      Accumulator& a = _acc[i];
+      a.min    = 0xFFFF;
+      a.max    = 0;
+      a.minPos = 0;
+      a.maxPos = 0;
+      a.sum    = 0;
+      a.first  = true;
+    }
+
+    const SpanStatsFunction spanStats = spanStatsFunction();
+    for(size_t i = 0; i < _spans.size(); i++)
+    {
+      const Span& s = _spans[i];
+      const unsigned int offset = (unsigned int)s.y * _width + s.x0;
+      const unsigned short* p   = data + offset;
+      unsigned short mn, mx;
+      unsigned int sum;
+      if(s.len < SIMD_MIN_SPAN) spanStatsScalar(p, s.len, &mn, &mx, &sum);
+      else                      spanStats(p, s.len, &mn, &mx, &sum);
+
+      Accumulator& a = _acc[s.roi];
+      a.sum += sum;
+      if(mn < a.min || a.first)
+      {
+        a.min    = mn;
+        a.minPos = offset + find(p, s.len, mn);
+      }
+      if(mx > a.max || a.first)
+      {
+        a.max    = mx;
+        a.maxPos = offset + find(p, s.len, mx);
+      }
+      a.first = false;
+    }
+
+    for(size_t i = 0; i < _plan.size(); i++)
+    {
+      const Roi& roi       = *_rois[_plan[i]];
+      const Accumulator& a = _acc[i];
+      EvoIRRoiResult& r    = results[i];
+      r.roiId  = _plan[i];
+      r.pixels = roi.pixels;
+      r.tMin   = temperature(roi, a.min);
+      r.tMax   = temperature(roi, a.max);
+      r.tMean  = temperature(roi, (double)a.sum / roi.pixels);
+      r.xMin   = (short)(a.minPos % _width);
+      r.yMin   = (short)(a.minPos / _width);
+      r.xMax   = (short)(a.maxPos % _width);
+      r.yMax   = (short)(a.maxPos / _width);
+      r.alarm  = EVO_ROI_ALARM_NONE;
+      if(r.tMin < roi.tLow)  r.alarm |= EVO_ROI_ALARM_LOW;
+      if(r.tMax > roi.tHigh) r.alarm |= EVO_ROI_ALARM_HIGH;
+    }
+    *count = (unsigned int)_plan.size();
+    return true;
+  }
+
+  int width() const  { return _width; }
+  int height() const { return _height; }
+
+private:
+  struct Roi
+  {
+    Roi() :
+      pixels(0),
+      tLow(-FLT_MAX),
+      tHigh(FLT_MAX),
+      radiation(false),
+      emissivity(1.f),
+      transmissivity(1.f),
+      tAmbient(-300.f)
+    {
+    }
+
+    void addSpan(int y, int x0, int len)
+    {
+      Span s = { y, x0, len, 0 };
+      spans.push_back(s);
+      pixels += (unsigned int)len;
+    }
+
+    std::vector<Span> spans;
+    unsigned int pixels;
+    float tLow;
+    float tHigh;
+    bool radiation;
+    float emissivity;
+    float transmissivity;
+    float tAmbient;
+  };
+
+  struct Accumulator
+  {
+    unsigned short min;
+    unsigned short max;
+    unsigned int minPos;
+    unsigned int maxPos;
+    unsigned long long sum;
+    bool first;
+  };
+
+  bool insert(Roi* roi, unsigned int* id)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    size_t i = 0;
+    while(i < _rois.size() && _rois[i]) i++;
+    if(i == _rois.size()) _rois.push_back(nullptr);
+    _rois[i] = roi;
+    *id      = (unsigned int)i;
+    _dirty   = true;
+    return true;
+  }
+
+  void rebuild()
+  {
+    _plan.clear();
+    _spans.clear();
+    for(size_t i = 0; i < _rois.size(); i++)
+    {
+      if(!_rois[i]) continue;
+      const unsigned int pos = (unsigned int)_plan.size();
+      _plan.push_back((unsigned int)i);
+      for(size_t k = 0; k < _rois[i]->spans.size(); k++)
+      {
+        Span s = _rois[i]->spans[k];
+        s.roi  = pos;
+        _spans.push_back(s);
+      }
+    }
+    std::sort(_spans.begin(), _spans.end(), spanLess);
+    _acc.resize(_plan.size());
+    _dirty = false;
+  }
+
+  float temperature(const Roi& roi, double raw) const
+  {
+    const double t = raw * _scale - 100.0;
+    if(!roi.radiation) return (float)t;
+
+    // radiance the camera received, in units of sigma, then solved for the object temperature of the region
+    const double ka0 = _tAmbient + KELVIN;
+    const double ka  = ((roi.tAmbient < -KELVIN) ? _tAmbient : roi.tAmbient) + KELVIN;
+    const double l   = _emissivity * _transmissivity * pow4(t + KELVIN)
+                     + (1.0 - _emissivity) * _transmissivity * pow4(ka0)
+                     + (1.0 - _transmissivity) * pow4(ka0);
+    const double e   = roi.emissivity, tau = roi.transmissivity;
+    const double obj = (l - (1.0 - e) * tau * pow4(ka) - (1.0 - tau) * pow4(ka)) / (e * tau);
+    return (float)((obj > 0.0 ? std::sqrt(std::sqrt(obj)) : 0.0) - KELVIN);
+  }
+
+  EvoIRRoiEngine(const EvoIRRoiEngine&);
+  EvoIRRoiEngine& operator=(const EvoIRRoiEngine&);
+
+  const int _width;
+  const int _height;
+  const double _scale;
+  double _emissivity;
+  double _transmissivity;
+  double _tAmbient;
+
+  std::mutex _mutex;
+  std::vector<Roi*> _rois;
+
+  // evaluation plan
+  bool _dirty;
+  std::vector<unsigned int> _plan;
+  std::vector<Span> _spans;
+  std::vector<Accumulator> _acc;
+};
+
+static EvoIRHandleTable<EvoIRRoiEngine> g_roiEngines;
+typedef EvoIRHandleTable<EvoIRRoiEngine>::Ref RoiEngineRef;
+
+} // namespace evo
+
+using namespace evo;
+
+int evo_irimager_roi_engine_create(unsigned int* outEngineId, int w, int h, short decimalPlaces)
+{
+  if(!outEngineId || w <= 0 || h <= 0 || w > 32767 || h > 32767 || decimalPlaces < 1 || decimalPlaces > 4) return -1;
+  EvoIRRoiEngine* engine = new EvoIRRoiEngine(w, h, decimalPlaces);
+  if(!g_roiEngines.insert(engine, outEngineId))
+  {
+    delete engine;
+    return -1;
+  }
+  return 0;
+}
+
+int evo_irimager_roi_engine_destroy(const unsigned int engineId)
+{
+  EvoIRRoiEngine* engine = g_roiEngines.remove(engineId);
+  if(!engine) return -1;
+  delete engine;
+  return 0;
+}
+
+int evo_irimager_roi_add_rect(const unsigned int engineId, int x, int y, int w, int h, unsigned int* outRoiId)
+{
+  RoiEngineRef engine = g_roiEngines.acquire(engineId);
+  if(!engine || !outRoiId) return -1;
+  return engine->addRect(x, y, w, h, outRoiId) ? 0 : -1;
+}
+
+int evo_irimager_roi_add_polygon(const unsigned int engineId, const float* xy, int points, unsigned int* outRoiId)
+{
+  RoiEngineRef engine = g_roiEngines.acquire(engineId);
+  if(!engine || !xy || points < 3 || !outRoiId) return -1;
+  return engine->addPolygon(xy, points, outRoiId) ? 0 : -1;
+}
+
+int evo_irimager_roi_remove(const unsigned int engineId, const unsigned int roiId)
+{
+  RoiEngineRef engine = g_roiEngines.acquire(engineId);
+  if(!engine) return -1;
+  return engine->remove(roiId) ? 0 : -1;
+}
+
+int evo_irimager_roi_set_alarm(const unsigned int engineId, const unsigned int roiId, float tLow, float tHigh)
+{
+  RoiEngineRef engine = g_roiEngines.acquire(engineId);
+  if(!engine) return -1;
+  return engine->setAlarm(roiId, tLow, tHigh) ? 0 : -1;
+}
+
+int evo_irimager_roi_set_camera_radiation_parameters(const unsigned int engineId, float emissivity, float transmissivity, float tAmbient)
+{
+  RoiEngineRef engine = g_roiEngines.acquire(engineId);
+  if(!engine || emissivity <= 0.f || emissivity > 1.f || transmissivity <= 0.f || transmissivity > 1.f || tAmbient < -273.15f) return -1;
+  engine->setCameraRadiation(emissivity, transmissivity, tAmbient);
+  return 0;
+}
+
+int evo_irimager_roi_set_radiation_parameters(const unsigned int engineId, const unsigned int roiId, float emissivity, float transmissivity, float tAmbient)
+{
+  RoiEngineRef engine = g_roiEngines.acquire(engineId);
+  if(!engine || emissivity > 1.f || (emissivity > 0.f && (transmissivity <= 0.f || transmissivity > 1.f))) return -1;
+  return engine->setRadiation(roiId, emissivity, transmissivity, tAmbient) ? 0 : -1;
+}
+
+int evo_irimager_roi_get_count(const unsigned int engineId, unsigned int* count)
+{
+  RoiEngineRef engine = g_roiEngines.acquire(engineId);
+  if(!engine || !count) return -1;
+  *count = engine->count();
+  return 0;
+}
+
+int evo_irimager_roi_evaluate(const unsigned int engineId, const unsigned short* data, EvoIRRoiResult* results, unsigned int capacity, unsigned int* count)
+{
+  RoiEngineRef engine = g_roiEngines.acquire(engineId);
+  if(!engine || !data || !count || (!results && capacity > 0)) return -1;
+  return engine->evaluate(data, results, capacity, count) ? 0 : -1;
+}
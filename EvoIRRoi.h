@@ -0,0 +1,158 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRRoi.h
+ * @brief Provides temperature statistics of regions of interest for Easy API C-Library Interface
+ *
+ * A ROI engine evaluates any number of rectangular and polygonal regions on
+ * raw thermal images as delivered by evo_irimager_get_thermal_image. Regions
+ * are rasterized once into row spans. Evaluation walks the image row by row
+ * and processes all spans of a row while it is in cache, so overlapping
+ * regions cost little more than the pixels they cover.
+ *
+ * Every region can carry its own radiation parameters on the model of
+ * evo_irimager_set_radiation_parameters. Temperatures of such regions are
+ * converted from the parameters the camera measured with (see
+ * evo_irimager_roi_set_camera_radiation_parameters) with a broadband
+ * Stefan-Boltzmann model. Minimum and maximum are exact, the mean is
+ * converted from the mean temperature of the region.
+ */
+
+#ifndef EVOIRROI_H_
+#define EVOIRROI_H_
+
+#include "irdirectsdk_defs.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Alarm bits of EvoIRRoiResult::alarm
+ */
+typedef enum
+{
+  EVO_ROI_ALARM_NONE = 0,
+  EVO_ROI_ALARM_LOW  = 1, /*!< Minimum below lower threshold */
+  EVO_ROI_ALARM_HIGH = 2  /*!< Maximum above upper threshold */
+} EvoIRRoiAlarm;
+
+typedef struct __IRDIRECTSDK_API__ EvoIRRoiResult
+{
+  unsigned int roiId;  /*!< ROI id from add */
+  unsigned int pixels; /*!< Number of pixels covered */
+  float tMin;          /*!< Minimum temperature in degree Celsius */
+  float tMax;          /*!< Maximum temperature in degree Celsius */
+  float tMean;         /*!< Mean temperature in degree Celsius */
+  short xMin, yMin;    /*!< Location of the (first) coldest pixel */
+  short xMax, yMax;    /*!< Location of the (first) hottest pixel */
+  int alarm;           /*!< Combination of EvoIRRoiAlarm bits */
+} EvoIRRoiResult;
+
+/**
+ * @brief Creates a ROI engine for images of the given size
+ * @param[out] outEngineId engine instance id for reference
+ * @param[in] w image width
+ * @param[in] h image height
+ * @param[in] decimalPlaces decimal places of raw values, 1 by default, 2 for high precision [1; 4]
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_roi_engine_create(unsigned int* outEngineId, int w, int h, short decimalPlaces);
+
+/**
+ * @brief Releases a ROI engine
+ * @param[in] engineId engine instance id from create to apply this function
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_roi_engine_destroy(const unsigned int engineId);
+
+/**
+ * @brief Adds a rectangular region, clipped to the image
+ * @param[in] engineId engine instance id from create to apply this function
+ * @param[in] x left column
+ * @param[in] y top row
+ * @param[in] w width
+ * @param[in] h height
+ * @param[out] outRoiId ROI id for reference
+ * @return 0 on success, -1 on error (e.g. region outside of image)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_roi_add_rect(const unsigned int engineId, int x, int y, int w, int h, unsigned int* outRoiId);
+
+/**
+ * @brief Adds a polygonal region, clipped to the image. A pixel belongs to the region if its center is inside (even-odd rule).
+ * @param[in] engineId engine instance id from create to apply this function
+ * @param[in] xy vertices x0,y0,x1,y1,... in pixel coordinates, (0,0) being the upper left corner of the first pixel
+ * @param[in] points number of vertices, at least 3
+ * @param[out] outRoiId ROI id for reference
+ * @return 0 on success, -1 on error (e.g. polygon covers no pixel)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_roi_add_polygon(const unsigned int engineId, const float* xy, int points, unsigned int* outRoiId);
+
+/**
+ * @brief Removes a region
+ * @param[in] engineId engine instance id from create to apply this function
+ * @param[in] roiId ROI id from add
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_roi_remove(const unsigned int engineId, const unsigned int roiId);
+
+/**
+ * @brief Sets alarm thresholds of a region
+ * @param[in] engineId engine instance id from create to apply this function
+ * @param[in] roiId ROI id from add
+ * @param[in] tLow alarm if the minimum temperature falls below, use a value below -273.15 to disable
+ * @param[in] tHigh alarm if the maximum temperature exceeds, use a very large value to disable
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_roi_set_alarm(const unsigned int engineId, const unsigned int roiId, float tLow, float tHigh);
+
+/**
+ * @brief Sets the radiation parameters the camera applies, see evo_irimager_set_radiation_parameters. Defaults to 1, 1, 25.
+ * @param[in] engineId engine instance id from create to apply this function
+ * @param[in] emissivity emissivity [0;1]
+ * @param[in] transmissivity transmissivity [0;1]
+ * @param[in] tAmbient ambient temperature in degree Celsius
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_roi_set_camera_radiation_parameters(const unsigned int engineId, float emissivity, float transmissivity, float tAmbient);
+
+/**
+ * @brief Overrides the radiation parameters of a region
+ * @param[in] engineId engine instance id from create to apply this function
+ * @param[in] roiId ROI id from add
+ * @param[in] emissivity emissivity of observed object (0;1], a negative value removes the override
+ * @param[in] transmissivity transmissivity (0;1]
+ * @param[in] tAmbient ambient temperature, values below -273.15 degrees take the camera setting
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_roi_set_radiation_parameters(const unsigned int engineId, const unsigned int roiId, float emissivity, float transmissivity, float tAmbient);
+
+/**
+ * @brief Accessor to the number of regions
+ * @param[in] engineId engine instance id from create to apply this function
+ * @param[out] count number of regions
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_roi_get_count(const unsigned int engineId, unsigned int* count);
+
+/**
+ * @brief Evaluates all regions on a thermal image in one pass
+ * @param[in] engineId engine instance id from create to apply this function
+ * @param[in] data thermal image (size of w * h)
+ * @param[out] results pointer to EvoIRRoiResult array allocate by the user, ordered by ROI id
+ * @param[in] capacity number of elements of results, see evo_irimager_roi_get_count
+ * @param[out] count number of results written
+ * @return 0 on success, -1 on error (e.g. capacity too small)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_roi_evaluate(const unsigned int engineId, const unsigned short* data, EvoIRRoiResult* results, unsigned int capacity, unsigned int* count);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* EVOIRROI_H_ */
@@ -0,0 +1,103 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRSimd.h
+ * @brief Runtime selection of SSE4.1/AVX2 code paths
+ *
+ * Internal header, only used by the implementation files of the Easy API
+ * extensions. Kernels are compiled for several instruction sets in the same
+ * translation unit (EVO_TARGET_* attributes) and selected at runtime with
+ * simdLevel(), so binaries still run on processors without AVX2.
+ */
+
+#ifndef EVOIRSIMD_H_
+#define EVOIRSIMD_H_
+
+#include <atomic>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#   define EVO_SIMD_X86 1
+#   include <immintrin.h>
+#   if defined(__GNUC__)
+#       define EVO_TARGET_SSE41 __attribute__((target("sse4.1")))
+#       define EVO_TARGET_AVX2  __attribute__((target("avx2")))
+#   else
+#       include <intrin.h>
+#       define EVO_TARGET_SSE41
+#       define EVO_TARGET_AVX2
+#   endif
+#else
+#   define EVO_SIMD_X86 0
+#endif
+
+namespace evo
+{
+
+enum SimdLevel
+{
+  SIMD_NONE  = 0,
+  SIMD_SSE41 = 1,
+  SIMD_AVX2  = 2
+};
+
+/**
+ * @brief Highest instruction set supported by processor and operating system
+ */
+inline int simdSupported()
+{
+#if EVO_SIMD_X86 && defined(__GNUC__)
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx2"))   return SIMD_AVX2;
+  if(__builtin_cpu_supports("sse4.1")) return SIMD_SSE41;
+  return SIMD_NONE;
+#elif EVO_SIMD_X86
+  int info[4];
+  __cpuid(info, 0);
+  const int maxLeaf = info[0];
+  __cpuid(info, 1);
+  const bool sse41   = (info[2] & (1 << 19)) != 0;
+  const bool osxsave = (info[2] & (1 << 27)) != 0;
+  const bool avx     = (info[2] & (1 << 28)) != 0;
+  bool avx2 = false;
+  if(maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 6) == 6)
+  {
+    __cpuidex(info, 7, 0);
+    avx2 = (info[1] & (1 << 5)) != 0;
+  }
+  return avx2 ? SIMD_AVX2 : (sse41 ? SIMD_SSE41 : SIMD_NONE);
+#else
+  return SIMD_NONE;
+#endif
+}
+
+inline std::atomic<int>& simdLevelSetting()
+{
+  static std::atomic<int> level(simdSupported());
+  return level;
+}
+
+/**
+ * @brief Instruction set the kernels shall use
+ */
+inline int simdLevel()
+{
+  return simdLevelSetting().load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Restricts the instruction set, reduced to the supported level
+ */
+inline void setSimdLevel(int level)
+{
+  const int supported = simdSupported();
+  simdLevelSetting().store(level < SIMD_NONE ? SIMD_NONE : (level > supported ? supported : level));
+}
+
+} // namespace evo
+
+#endif /* EVOIRSIMD_H_ */
@@ -0,0 +1,287 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRSocket.h
+ * @brief Minimal blocking TCP sockets and named shared memory for Windows and POSIX systems
+ *
+ * Internal header, only used by the implementation files of the Easy API
+ * extensions.
+ */
+
+#ifndef EVOIRSOCKET_H_
+#define EVOIRSOCKET_H_
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+#ifdef _WIN32
+#   ifndef NOMINMAX
+#       define NOMINMAX
+#   endif
+#   include <winsock2.h>
+#   include <ws2tcpip.h>
+#   include <windows.h>
+#   pragma comment(lib, "ws2_32.lib")
+#else
+#   include <arpa/inet.h>
+#   include <fcntl.h>
+#   include <netdb.h>
+#   include <netinet/in.h>
+#   include <netinet/tcp.h>
+#   include <sys/mman.h>
+#   include <sys/socket.h>
+#   include <unistd.h>
+#endif
+
+namespace evo
+{
+
+#ifdef _WIN32
+typedef SOCKET SocketHandle;
+const SocketHandle INVALID_SOCKET_HANDLE = INVALID_SOCKET;
+#else
+typedef int SocketHandle;
+const SocketHandle INVALID_SOCKET_HANDLE = -1;
+#endif
+
+inline bool socketInit()
+{
+#ifdef _WIN32
+  static const bool ok = []() { WSADATA wsa; return WSAStartup(MAKEWORD(2, 2), &wsa) == 0; }();
+  return ok;
+#else
+  return true;
+#endif
+}
+
+inline void socketClose(SocketHandle s)
+{
+  if(s == INVALID_SOCKET_HANDLE) return;
+#ifdef _WIN32
+  closesocket(s);
+#else
+  ::close(s);
+#endif
+}
+
+/**
+ * @brief Unblocks pending calls on the socket from another thread
+ */
+inline void socketShutdown(SocketHandle s)
+{
+  if(s == INVALID_SOCKET_HANDLE) return;
+#ifdef _WIN32
+  shutdown(s, SD_BOTH);
+#else
+  shutdown(s, SHUT_RDWR);
+#endif
+}
+
+inline void socketNoDelay(SocketHandle s)
+{
+  int one = 1;
+  setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&one, sizeof(one));
+}
+
+/**
+ * @brief Listening socket on all interfaces or on the loopback interface only
+ */
+inline SocketHandle socketListen(int port, bool localOnly)
+{
+  if(!socketInit()) return INVALID_SOCKET_HANDLE;
+  SocketHandle s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if(s == INVALID_SOCKET_HANDLE) return s;
+  int one = 1;
+  setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char*)&one, sizeof(one));
+  sockaddr_in addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_port        = htons((unsigned short)port);
+  addr.sin_addr.s_addr = htonl(localOnly ? INADDR_LOOPBACK : INADDR_ANY);
+  if(bind(s, (const sockaddr*)&addr, sizeof(addr)) != 0 || listen(s, 16) != 0)
+  {
+    socketClose(s);
+    return INVALID_SOCKET_HANDLE;
+  }
+  return s;
+}
+
+inline SocketHandle socketConnect(const char* host, int port)
+{
+  if(!socketInit()) return INVALID_SOCKET_HANDLE;
+  addrinfo hints;
+  std::memset(&hints, 0, sizeof(hints));
+  hints.ai_family   = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* result = nullptr;
+  const std::string service = std::to_string(port);
+  if(getaddrinfo(host, service.c_str(), &hints, &result) != 0) return INVALID_SOCKET_HANDLE;
+  SocketHandle s = INVALID_SOCKET_HANDLE;
+  for(addrinfo* a = result; a && s == INVALID_SOCKET_HANDLE; a = a->ai_next)
+  {
+    s = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+    if(s == INVALID_SOCKET_HANDLE) continue;
+    if(connect(s, a->ai_addr, (int)a->ai_addrlen) != 0)
+    {
+      socketClose(s);
+      s = INVALID_SOCKET_HANDLE;
+    }
+  }
+  freeaddrinfo(result);
+  if(s != INVALID_SOCKET_HANDLE) socketNoDelay(s);
+  return s;
+}
+
+/**
+ * @return true if the peer is on this host, i.e. shared memory can be used
+ */
+inline bool socketPeerIsLocal(SocketHandle s)
+{
+  sockaddr_in local, peer;
+  socklen_t len = sizeof(local);
+  if(getsockname(s, (sockaddr*)&local, &len) != 0) return false;
+  len = sizeof(peer);
+  if(getpeername(s, (sockaddr*)&peer, &len) != 0) return false;
+  return local.sin_addr.s_addr == peer.sin_addr.s_addr || (ntohl(peer.sin_addr.s_addr) >> 24) == 127;
+}
+
+inline bool socketSendAll(SocketHandle s, const void* data, size_t size)
+{
+  const char* p = (const char*)data;
+  while(size > 0)
+  {
+#ifdef _WIN32
+    const int n = send(s, p, (int)(size > 0x40000000 ? 0x40000000 : size), 0);
+#else
+    const ssize_t n = send(s, p, size, MSG_NOSIGNAL);
+#endif
+    if(n <= 0) return false;
+    p    += n;
+    size -= (size_t)n;
+  }
+  return true;
+}
+
+inline bool socketRecvAll(SocketHandle s, void* data, size_t size)
+{
+  char* p = (char*)data;
+  while(size > 0)
+  {
+#ifdef _WIN32
+    const int n = recv(s, p, (int)(size > 0x40000000 ? 0x40000000 : size), 0);
+#else
+    const ssize_t n = recv(s, p, size, 0);
+#endif
+    if(n <= 0) return false;
+    p    += n;
+    size -= (size_t)n;
+  }
+  return true;
+}
+
+/**
+ * @brief Named shared memory segment, created by one process and opened by others
+ */
+class EvoIRSharedMemory
+{
+public:
+  EvoIRSharedMemory() : _data(nullptr), _size(0), _owner(false)
+  {
+#ifdef _WIN32
+    _mapping = NULL;
+#endif
+  }
+
+  ~EvoIRSharedMemory()
+  {
+    close();
+  }
+
+  bool create(const std::string& name, size_t size)
+  {
+    close();
+#ifdef _WIN32
+    _mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)((unsigned long long)size >> 32), (DWORD)size, name.c_str());
+    if(_mapping == NULL) return false;
+    _data = MapViewOfFile(_mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+#else
+    shm_unlink(name.c_str());
+    const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if(fd < 0) return false;
+    if(ftruncate(fd, (off_t)size) != 0)
+    {
+      ::close(fd);
+      shm_unlink(name.c_str());
+      return false;
+    }
+    void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    _data = (p == MAP_FAILED) ? nullptr : p;
+#endif
+    _name  = name;
+    _size  = size;
+    _owner = true;
+    if(!_data) close();
+    return _data != nullptr;
+  }
+
+  bool open(const std::string& name, size_t size)
+  {
+    close();
+#ifdef _WIN32
+    _mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name.c_str());
+    if(_mapping == NULL) return false;
+    _data = MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, size);
+#else
+    const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if(fd < 0) return false;
+    void* p = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    _data = (p == MAP_FAILED) ? nullptr : p;
+#endif
+    _name = name;
+    _size = size;
+    if(!_data) close();
+    return _data != nullptr;
+  }
+
+  void close()
+  {
+#ifdef _WIN32
+    if(_data) UnmapViewOfFile(_data);
+    if(_mapping != NULL) CloseHandle(_mapping);
+    _mapping = NULL;
+#else
+    if(_data) munmap(_data, _size);
+    if(_owner) shm_unlink(_name.c_str());
+#endif
+    _data  = nullptr;
+    _size  = 0;
+    _owner = false;
+  }
+
+  void* data() const { return _data; }
+  size_t size() const { return _size; }
+
+private:
+  EvoIRSharedMemory(const EvoIRSharedMemory&);
+  EvoIRSharedMemory& operator=(const EvoIRSharedMemory&);
+
+  std::string _name;
+  void* _data;
+  size_t _size;
+  bool _owner;
+#ifdef _WIN32
+  HANDLE _mapping;
+#endif
+};
+
+} // namespace evo
+
+#endif /* EVOIRSOCKET_H_ */
@@ -0,0 +1,300 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRSyntheticSource.cpp
+ * @brief Synthetic frame source producing thermal images and frame metadata
+ */
+
+#include "EvoIRSyntheticSource.h"
+#include "EvoIRHandleTable.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace evo
+{
+
+namespace
+{
+
+// Durations of the shutter flag phases in seconds
+const double FLAG_CLOSING_TIME = 0.1;
+const double FLAG_CLOSED_TIME  = 0.25;
+const double FLAG_OPENING_TIME = 0.1;
+
+struct Hotspot
+{
+  double x, y;   // start position in pixels
+  double vx, vy; // velocity in pixels per second
+  double radius;
+};
+
+// Position of a hotspot bouncing between the image borders at time t
+double bounce(double start, double velocity, double t, double extent)
+{
+  if(extent <= 0.0) return 0.0;
+  double p = std::fmod(start + velocity * t, 2.0 * extent);
+  if(p < 0.0) p += 2.0 * extent;
+  return (p < extent) ? p : 2.0 * extent - p;
+}
+
+} // namespace
+
+class EvoIRSyntheticSource
+{
+public:
+  explicit EvoIRSyntheticSource(const EvoIRSyntheticParams& params) :
+    _params(params),
+    _rng(params.seed ? params.seed : 0x9E3779B9u),
+    _frameIndex(0),
+    _counter(0)
+  {
+    _period = 1.0 / _params.framerate;
+    _t0     = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count() * 10LL;
+    _start  = std::chrono::steady_clock::now();
+
+    for(int i = 0; i < _params.hotspots; i++)
+    {
+      Hotspot s;
+      s.x      = uniform() * _params.width;
+      s.y      = uniform() * _params.height;
+      s.vx     = (uniform() - 0.5) * _params.width;
+      s.vy     = (uniform() - 0.5) * _params.height;
+      s.radius = 2.0 + uniform() * (_params.width < _params.height ? _params.width : _params.height) / 16.0;
+      _hotspots.push_back(s);
+    }
+
+    // Static part of the scene: horizontal gradient of 2 K across the image
+    _background.resize((size_t)_params.width * _params.height);
+    for(int y = 0; y < _params.height; y++)
+      for(int x = 0; x < _params.width; x++)
+        _background[(size_t)y * _params.width + x] = toRaw(_params.tBackground + 2.0 * x / _params.width);
+  }
+
+  int grab(unsigned short* data, EvoIRFrameMetadata* metadata)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // Lost frames are numbered by the device as well, so they appear as counter gaps
+    while(_params.dropRate > 0.f && uniform() < _params.dropRate)
+    {
+      _frameIndex++;
+      _counter++;
+    }
+
+    const unsigned long long index = _frameIndex++;
+    const double t = index * _period;
+
+    if(_params.realtime)
+      std::this_thread::sleep_until(_start + std::chrono::microseconds((long long)(t * 1e6)));
+
+    const EvoIRFlagState flag = flagState(t);
+    const float tBox = _params.tBackground + 10.f;
+    if(flag == irFlagClose)
+      renderFlat(data, toRaw(tBox));
+    else
+      renderScene(data, t);
+
+    metadata->counter        = ++_counter;
+    metadata->counterHW      = (unsigned int)(index + 1);
+    metadata->timestamp      = _t0 + (long long)(t * 1e7);
+    metadata->timestampMedia = metadata->timestamp;
+    metadata->flagState      = flag;
+    metadata->tempChip       = tBox + 5.f;
+    metadata->tempFlag       = tBox;
+    metadata->tempBox        = tBox;
+    return 0;
+  }
+
+  const EvoIRSyntheticParams& params() const { return _params; }
+
+private:
+  static unsigned short toRaw(double t)
+  {
+    double raw = t * 10.0 + 1000.0;
+    if(raw < 0.0)     raw = 0.0;
+    if(raw > 65535.0) raw = 65535.0;
+    return (unsigned short)(raw + 0.5);
+  }
+
+  unsigned int next()
+  {
+    _rng ^= _rng << 13;
+    _rng ^= _rng >> 17;
+    _rng ^= _rng << 5;
+    return _rng;
+  }
+
+  double uniform()
+  {
+    return next() / 4294967296.0;
+  }
+
+  EvoIRFlagState flagState(double t) const
+  {
+    if(_params.flagInterval <= 0.f) return irFlagOpen;
+    const double phase = std::fmod(t, (double)_params.flagInterval);
+    const double begin = _params.flagInterval - (FLAG_CLOSING_TIME + FLAG_CLOSED_TIME + FLAG_OPENING_TIME);
+    if(phase < begin)                                        return irFlagOpen;
+    if(phase < begin + FLAG_CLOSING_TIME)                    return irFlagClosing;
+    if(phase < begin + FLAG_CLOSING_TIME + FLAG_CLOSED_TIME) return irFlagClose;
+    return irFlagOpening;
+  }
+
+  void renderFlat(unsigned short* data, unsigned short value)
+  {
+    const int n = noiseRaw();
+    const size_t size = (size_t)_params.width * _params.height;
+    for(size_t i = 0; i < size; i++)
+      data[i] = (unsigned short)(value + noiseSample(n));
+  }
+
+  void renderScene(unsigned short* data, double t)
+  {
+    const int n = noiseRaw();
+    const size_t size = (size_t)_params.width * _params.height;
+    for(size_t i = 0; i < size; i++)
+      data[i] = (unsigned short)(_background[i] + noiseSample(n));
+
+    for(size_t i = 0; i < _hotspots.size(); i++)
+    {
+      const Hotspot& s = _hotspots[i];
+      const double cx = bounce(s.x, s.vx, t, _params.width - 1);
+      const double cy = bounce(s.y, s.vy, t, _params.height - 1);
+      renderSpot(data, cx, cy, s.radius, _params.tHotspot);
+    }
+
+    if(_params.eventInterval > 0.f && t >= _params.eventInterval)
+    {
+      const double k     = std::floor(t / _params.eventInterval) - 1.0;
+      const double phase = (t - (k + 1.0) * _params.eventInterval) / _params.eventDuration;
+      if(phase < 1.0)
+      {
+        // position depends on the event number only, so it is reproducible independent of the frame rate
+        unsigned int h = (unsigned int)k * 0x9E3779B1u + (_params.seed ? _params.seed : 1u);
+        h ^= h >> 15; h *= 0x85EBCA77u; h ^= h >> 13;
+        const double radius = std::max(2.0, std::min(_params.width, _params.height) / 12.0);
+        const double cx = radius + (h & 0xffff) / 65536.0 * std::max(0.0, _params.width - 2.0 * radius);
+        const double cy = radius + (h >> 16) / 65536.0 * std::max(0.0, _params.height - 2.0 * radius);
+        renderSpot(data, cx, cy, radius, _params.tEvent * (1.0 - std::fabs(2.0 * phase - 1.0)));
+      }
+    }
+  }
+
+  void renderSpot(unsigned short* data, double cx, double cy, double radius, double amplitude)
+  {
+    const double r2 = 2.0 * radius * radius;
+    const int x0 = std::max(0, (int)(cx - 3.0 * radius));
+    const int x1 = std::min(_params.width - 1, (int)(cx + 3.0 * radius));
+    const int y0 = std::max(0, (int)(cy - 3.0 * radius));
+    const int y1 = std::min(_params.height - 1, (int)(cy + 3.0 * radius));
+    for(int y = y0; y <= y1; y++)
+    {
+      unsigned short* row = data + (size_t)y * _params.width;
+      for(int x = x0; x <= x1; x++)
+      {
+        const double d2 = (x - cx) * (x - cx) + (y - cy) * (y - cy);
+        const int v = row[x] + (int)(10.0 * amplitude * std::exp(-d2 / r2));
+        row[x] = (unsigned short)(v > 65535 ? 65535 : v);
+      }
+    }
+  }
+
+  int noiseRaw() const
+  {
+    return (int)(_params.noise * 10.f + 0.5f);
+  }
+
+  int noiseSample(int amplitude)
+  {
+    if(amplitude == 0) return 0;
+    return (int)(((unsigned long long)(next() >> 16) * (unsigned int)(2 * amplitude + 1)) >> 16) - amplitude;
+  }
+
+  EvoIRSyntheticParams _params;
+  std::mutex _mutex;
+  unsigned int _rng;
+  unsigned long long _frameIndex;
+  unsigned int _counter;
+  double _period;
+  long long _t0;
+  std::chrono::steady_clock::time_point _start;
+  std::vector<Hotspot> _hotspots;
+  std::vector<unsigned short> _background;
+};
+
+static EvoIRHandleTable<EvoIRSyntheticSource> g_sources;
+typedef EvoIRHandleTable<EvoIRSyntheticSource>::Ref SourceRef;
+
+} // namespace evo
+
+using namespace evo;
+
+void evo_irimager_synthetic_default_params(EvoIRSyntheticParams* params, int w, int h, float framerate)
+{
+  if(!params) return;
+  params->width         = w;
+  params->height        = h;
+  params->framerate     = framerate;
+  params->realtime      = 0;
+  params->dropRate      = 0.f;
+  params->flagInterval  = 15.f;
+  params->tBackground   = 22.f;
+  params->noise         = 0.3f;
+  params->hotspots      = 1;
+  params->tHotspot      = 40.f;
+  params->eventInterval = 0.f;
+  params->eventDuration = 1.f;
+  params->tEvent        = 60.f;
+  params->seed          = 1;
+}
+
+int evo_irimager_synthetic_init(unsigned int* outSrcId, const EvoIRSyntheticParams* params)
+{
+  if(!outSrcId || !params || params->width <= 0 || params->height <= 0 || params->framerate <= 0.f || params->hotspots < 0
+     || !(params->dropRate >= 0.f && params->dropRate < 1.f)
+     || params->eventInterval < 0.f || (params->eventInterval > 0.f && params->eventDuration <= 0.f))
+    return -1;
+  EvoIRSyntheticSource* src = new EvoIRSyntheticSource(*params);
+  if(!g_sources.insert(src, outSrcId))
+  {
+    delete src;
+    return -1;
+  }
+  return 0;
+}
+
+int evo_irimager_synthetic_terminate(const unsigned int srcId)
+{
+  EvoIRSyntheticSource* src = g_sources.remove(srcId);
+  if(!src) return -1;
+  delete src;
+  return 0;
+}
+
+int evo_irimager_synthetic_get_thermal_image_size(const unsigned int srcId, int* w, int* h)
+{
+  SourceRef src = g_sources.acquire(srcId);
+  if(!src || !w || !h) return -1;
+  *w = src->params().width;
+  *h = src->params().height;
+  return 0;
+}
+
+int evo_irimager_synthetic_get_thermal_image_metadata(const unsigned int srcId, int* w, int* h, unsigned short* data, EvoIRFrameMetadata* metadata)
+{
+  SourceRef src = g_sources.acquire(srcId);
+  if(!src || !w || !h || !data || !metadata) return -1;
+  if(*w != src->params().width || *h != src->params().height) return -1;
+  return src->grab(data, metadata);
+}
@@ -0,0 +1,99 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRSyntheticSource.h
+ * @brief Provides a synthetic frame source for operation without a camera
+ *
+ * The synthetic source produces thermal images and frame metadata with the
+ * same signature as evo_irimager_get_thermal_image_metadata. It can be used
+ * to test and benchmark the processing chain without a device attached.
+ * Injected events (a spot heating up and cooling down again at a known
+ * time) allow to validate trigger logic: event k starts at
+ * (k + 1) * eventInterval seconds after the first frame.
+ */
+
+#ifndef EVOIRSYNTHETICSOURCE_H_
+#define EVOIRSYNTHETICSOURCE_H_
+
+#include "irdirectsdk_defs.h"
+#include "EvoIRFrameMetadata.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+typedef struct __IRDIRECTSDK_API__ EvoIRSyntheticParams
+{
+  int width;              /*!< Image width */
+  int height;             /*!< Image height */
+  float framerate;        /*!< Frame rate in Hz */
+  int realtime;           /*!< 1: frames are paced with framerate, 0: frames are delivered as fast as possible */
+  float dropRate;         /*!< Probability [0;1) of a frame not being delivered, visible as gap in EvoIRFrameMetadata::counter */
+  float flagInterval;     /*!< Seconds between two shutter flag cycles, 0 disables flag cycles */
+  float tBackground;      /*!< Background temperature in degree Celsius */
+  float noise;            /*!< Peak amplitude of pixel noise in degree Celsius */
+  int hotspots;           /*!< Number of hotspots moving across the image */
+  float tHotspot;         /*!< Temperature increase in the center of a hotspot in degree Celsius */
+  float eventInterval;    /*!< Seconds between injected hot events at fixed random positions, 0 disables events */
+  float eventDuration;    /*!< Seconds an injected event lasts, heating up linearly in the first and cooling down in the second half */
+  float tEvent;           /*!< Temperature increase in the center of an injected event at its peak in degree Celsius */
+  unsigned int seed;      /*!< Seed of random generator, equal seeds produce equal frame sequences */
+} EvoIRSyntheticParams;
+
+/**
+ * @brief Fills parameter structure with defaults (room temperature scene, one hotspot, flag cycle every 15 s, no injected events)
+ * @param[out] params parameter structure
+ * @param[in] w image width
+ * @param[in] h image height
+ * @param[in] framerate frame rate in Hz
+ */
+__IRDIRECTSDK_API__ void evo_irimager_synthetic_default_params(EvoIRSyntheticParams* params, int w, int h, float framerate);
+
+/**
+ * @brief Initializes a synthetic frame source
+ * @param[out] outSrcId source instance id for reference
+ * @param[in] params source parameters
+ * @return 0 on success, -1 on error (invalid parameters, e.g. dropRate outside of [0;1))
+ */
+__IRDIRECTSDK_API__ int evo_irimager_synthetic_init(unsigned int* outSrcId, const EvoIRSyntheticParams* params);
+
+/**
+ * @brief Releases a synthetic frame source
+ * @param[in] srcId source instance id from init to apply this function
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_synthetic_terminate(const unsigned int srcId);
+
+/**
+ * @brief Accessor to image width and height of synthetic source
+ * @param[in] srcId source instance id from init to apply this function
+ * @param[out] w width
+ * @param[out] h height
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_synthetic_get_thermal_image_size(const unsigned int srcId, int* w, int* h);
+
+/**
+ * @brief Accessor to next synthetic thermal image and frame metadata by reference.
+ * Blocks until the frame is due if the source runs in realtime mode.
+ * Conversion to temperature values are to be performed as follows:
+ * t = ((double)data[x] - 1000.0) / 10.0;
+ * @param[in] srcId source instance id from init to apply this function
+ * @param[in] w image width
+ * @param[in] h image height
+ * @param[out] data pointer to unsigned short array allocate by the user (size of w * h)
+ * @param[out] metadata pointer to EvoIRFrameMetadata allocate by the user
+ * @return error code: 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_synthetic_get_thermal_image_metadata(const unsigned int srcId, int* w, int* h, unsigned short* data, EvoIRFrameMetadata* metadata);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* EVOIRSYNTHETICSOURCE_H_ */
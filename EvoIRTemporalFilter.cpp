@@ -0,0 +1,542 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRTemporalFilter.cpp
+ * @brief Temporal mean, exponential moving average and recursive median of raw thermal images
+ *
+ * State per pixel: the mean keeps the last N frames and a 32 bit sum, the
+ * average a 32 bit accumulator holding 2^k times the estimate (new = acc -
+ * acc / 2^k + frame), the median the last inputs and outputs, sorted per
+ * pixel with a transposition network of min/max operations. Each kernel
+ * makes a single pass over the image and writes the output last, so input
+ * and output may be the same buffer.
+ */
+
+#include "EvoIRTemporalFilter.h"
+#include "EvoIRHandleTable.h"
+#include "EvoIRSimd.h"
+
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+namespace evo
+{
+
+namespace
+{
+
+const int MEAN_MAX_LENGTH   = 256;   // 65535 * 256 < 2^24, sums convert to float exactly
+const int EMA_MAX_SHIFT     = 15;    // 65535 * 2^15 < 2^31
+const int MEDIAN_MAX_LENGTH = 15;
+
+bool flagFrame(const EvoIRFrameMetadata* metadata)
+{
+  return metadata && (metadata->flagState == irFlagClosing || metadata->flagState == irFlagClose || metadata->flagState == irFlagOpening);
+}
+
+//------------------------------------------------------------------------------
+// plain C++
+//------------------------------------------------------------------------------
+
+// sum += data - old, old may alias store
+void meanScalar(const unsigned short* data, const unsigned short* old, unsigned short* store, unsigned int* sum, size_t n, float inv, unsigned short* out)
+{
+  for(size_t i = 0; i < n; i++)
+  {
+    const unsigned short v = data[i];
+    const unsigned int s   = sum[i] + v - old[i];
+    store[i] = v;
+    sum[i]   = s;
+    out[i]   = (unsigned short)std::lrint((float)s * inv);
+  }
+}
+
+void emaScalar(const unsigned short* data, unsigned int* acc, size_t n, int shift, unsigned short* out)
+{
+  for(size_t i = 0; i < n; i++)
+  {
+    const unsigned int a = acc[i] - (acc[i] >> shift) + data[i];
+    acc[i] = a;
+    out[i] = (unsigned short)(a >> shift);
+  }
+}
+
+// window[0] receives data before the median of all length window images is taken
+void medianScalar(const unsigned short* data, unsigned short* const* window, int length, size_t begin, size_t n, unsigned short* store, unsigned short* out)
+{
+  unsigned short v[MEDIAN_MAX_LENGTH];
+  for(size_t i = begin; i < n; i++)
+  {
+    window[0][i] = data[i];
+    for(int k = 0; k < length; k++)
+      v[k] = window[k][i];
+    // same network as the vector kernels, branch free on noisy data
+    for(int round = 0; round < length; round++)
+    {
+      for(int k = round & 1; k + 1 < length; k += 2)
+      {
+        const unsigned short lo = v[k] < v[k + 1] ? v[k] : v[k + 1];
+        v[k + 1] = v[k] < v[k + 1] ? v[k + 1] : v[k];
+        v[k]     = lo;
+      }
+    }
+    store[i] = v[length / 2];
+    out[i]   = v[length / 2];
+  }
+}
+
+#if EVO_SIMD_X86
+
+//------------------------------------------------------------------------------
+// SSE4.1
+//------------------------------------------------------------------------------
+
+EVO_TARGET_SSE41 void meanSse41(const unsigned short* data, const unsigned short* old, unsigned short* store, unsigned int* sum, size_t n, float inv, unsigned short* out)
+{
+  const __m128 vinv = _mm_set1_ps(inv);
+  size_t i = 0;
+  for(; i + 8 <= n; i += 8)
+  {
+    const __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+    const __m128i o = _mm_loadu_si128((const __m128i*)(old + i));
+    _mm_storeu_si128((__m128i*)(store + i), v);
+    __m128i s0 = _mm_loadu_si128((const __m128i*)(sum + i));
+    __m128i s1 = _mm_loadu_si128((const __m128i*)(sum + i + 4));
+    s0 = _mm_sub_epi32(_mm_add_epi32(s0, _mm_cvtepu16_epi32(v)), _mm_cvtepu16_epi32(o));
+    s1 = _mm_sub_epi32(_mm_add_epi32(s1, _mm_cvtepu16_epi32(_mm_srli_si128(v, 8))), _mm_cvtepu16_epi32(_mm_srli_si128(o, 8)));
+    _mm_storeu_si128((__m128i*)(sum + i), s0);
+    _mm_storeu_si128((__m128i*)(sum + i + 4), s1);
+    const __m128i f0 = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(s0), vinv));
+    const __m128i f1 = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(s1), vinv));
+    _mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi32(f0, f1));
+  }
+  meanScalar(data + i, old + i, store + i, sum + i, n - i, inv, out + i);
+}
+
+EVO_TARGET_SSE41 void emaSse41(const unsigned short* data, unsigned int* acc, size_t n, int shift, unsigned short* out)
+{
+  const __m128i count = _mm_cvtsi32_si128(shift);
+  size_t i = 0;
+  for(; i + 8 <= n; i += 8)
+  {
+    const __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+    __m128i a0 = _mm_loadu_si128((const __m128i*)(acc + i));
+    __m128i a1 = _mm_loadu_si128((const __m128i*)(acc + i + 4));
+    a0 = _mm_add_epi32(_mm_sub_epi32(a0, _mm_srl_epi32(a0, count)), _mm_cvtepu16_epi32(v));
+    a1 = _mm_add_epi32(_mm_sub_epi32(a1, _mm_srl_epi32(a1, count)), _mm_cvtepu16_epi32(_mm_srli_si128(v, 8)));
+    _mm_storeu_si128((__m128i*)(acc + i), a0);
+    _mm_storeu_si128((__m128i*)(acc + i + 4), a1);
+    _mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi32(_mm_srl_epi32(a0, count), _mm_srl_epi32(a1, count)));
+  }
+  emaScalar(data + i, acc + i, n - i, shift, out + i);
+}
+
+EVO_TARGET_SSE41 void medianSse41(const unsigned short* data, unsigned short* const* window, int length, size_t n, unsigned short* store, unsigned short* out)
+{
+  __m128i v[MEDIAN_MAX_LENGTH];
+  size_t i = 0;
+  for(; i + 8 <= n; i += 8)
+  {
+    const __m128i d = _mm_loadu_si128((const __m128i*)(data + i));
+    _mm_storeu_si128((__m128i*)(window[0] + i), d);
+    v[0] = d;
+    for(int k = 1; k < length; k++)
+      v[k] = _mm_loadu_si128((const __m128i*)(window[k] + i));
+    for(int round = 0; round < length; round++)
+    {
+      for(int k = round & 1; k + 1 < length; k += 2)
+      {
+        const __m128i lo = _mm_min_epu16(v[k], v[k + 1]);
+        v[k + 1] = _mm_max_epu16(v[k], v[k + 1]);
+        v[k]     = lo;
+      }
+    }
+    _mm_storeu_si128((__m128i*)(store + i), v[length / 2]);
+    _mm_storeu_si128((__m128i*)(out + i), v[length / 2]);
+  }
+  medianScalar(data, window, length, i, n, store, out);
+}
+
+//------------------------------------------------------------------------------
+// AVX2
+//------------------------------------------------------------------------------
+
+EVO_TARGET_AVX2 void meanAvx2(const unsigned short* data, const unsigned short* old, unsigned short* store, unsigned int* sum, size_t n, float inv, unsigned short* out)
+{
+  const __m256 vinv = _mm256_set1_ps(inv);
+  size_t i = 0;
+  for(; i + 16 <= n; i += 16)
+  {
+    const __m128i v0 = _mm_loadu_si128((const __m128i*)(data + i));
+    const __m128i v1 = _mm_loadu_si128((const __m128i*)(data + i + 8));
+    const __m128i o0 = _mm_loadu_si128((const __m128i*)(old + i));
+    const __m128i o1 = _mm_loadu_si128((const __m128i*)(old + i + 8));
+    _mm_storeu_si128((__m128i*)(store + i), v0);
+    _mm_storeu_si128((__m128i*)(store + i + 8), v1);
+    __m256i s0 = _mm256_loadu_si256((const __m256i*)(sum + i));
+    __m256i s1 = _mm256_loadu_si256((const __m256i*)(sum + i + 8));
+    s0 = _mm256_sub_epi32(_mm256_add_epi32(s0, _mm256_cvtepu16_epi32(v0)), _mm256_cvtepu16_epi32(o0));
+    s1 = _mm256_sub_epi32(_mm256_add_epi32(s1, _mm256_cvtepu16_epi32(v1)), _mm256_cvtepu16_epi32(o1));
+    _mm256_storeu_si256((__m256i*)(sum + i), s0);
+    _mm256_storeu_si256((__m256i*)(sum + i + 8), s1);
+    const __m256i f0 = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(s0), vinv));
+    const __m256i f1 = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(s1), vinv));
+    // packus works within 128 bit lanes
+    _mm256_storeu_si256((__m256i*)(out + i), _mm256_permute4x64_epi64(_mm256_packus_epi32(f0, f1), 0xD8));
+  }
+  meanScalar(data + i, old + i, store + i, sum + i, n - i, inv, out + i);
+}
+
+EVO_TARGET_AVX2 void emaAvx2(const unsigned short* data, unsigned int* acc, size_t n, int shift, unsigned short* out)
+{
+  const __m128i count = _mm_cvtsi32_si128(shift);
+  size_t i = 0;
+  for(; i + 16 <= n; i += 16)
+  {
+    __m256i a0 = _mm256_loadu_si256((const __m256i*)(acc + i));
+    __m256i a1 = _mm256_loadu_si256((const __m256i*)(acc + i + 8));
+    a0 = _mm256_add_epi32(_mm256_sub_epi32(a0, _mm256_srl_epi32(a0, count)), _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(data + i))));
+    a1 = _mm256_add_epi32(_mm256_sub_epi32(a1, _mm256_srl_epi32(a1, count)), _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(data + i + 8))));
+    _mm256_storeu_si256((__m256i*)(acc + i), a0);
+    _mm256_storeu_si256((__m256i*)(acc + i + 8), a1);
+    const __m256i packed = _mm256_packus_epi32(_mm256_srl_epi32(a0, count), _mm256_srl_epi32(a1, count));
+    _mm256_storeu_si256((__m256i*)(out + i), _mm256_permute4x64_epi64(packed, 0xD8));
+  }
+  emaScalar(data + i, acc + i, n - i, shift, out + i);
+}
+
+EVO_TARGET_AVX2 void medianAvx2(const unsigned short* data, unsigned short* const* window, int length, size_t n, unsigned short* store, unsigned short* out)
+{
+  __m256i v[MEDIAN_MAX_LENGTH];
+  size_t i = 0;
+  for(; i + 16 <= n; i += 16)
+  {
+    const __m256i d = _mm256_loadu_si256((const __m256i*)(data + i));
+    _mm256_storeu_si256((__m256i*)(window[0] + i), d);
+    v[0] = d;
+    for(int k = 1; k < length; k++)
+      v[k] = _mm256_loadu_si256((const __m256i*)(window[k] + i));
+    for(int round = 0; round < length; round++)
+    {
+      for(int k = round & 1; k + 1 < length; k += 2)
+      {
+        const __m256i lo = _mm256_min_epu16(v[k], v[k + 1]);
+        v[k + 1] = _mm256_max_epu16(v[k], v[k + 1]);
+        v[k]     = lo;
+      }
+    }
+    _mm256_storeu_si256((__m256i*)(store + i), v[length / 2]);
+    _mm256_storeu_si256((__m256i*)(out + i), v[length / 2]);
+  }
+  medianScalar(data, window, length, i, n, store, out);
+}
+
+#endif // EVO_SIMD_X86
+
+void mean(const unsigned short* data, const unsigned short* old, unsigned short* store, unsigned int* sum, size_t n, float inv, unsigned short* out)
+{
+#if EVO_SIMD_X86
+  const int level = simdLevel();
+  if(level >= SIMD_AVX2)  { meanAvx2(data, old, store, sum, n, inv, out); return; }
+  if(level >= SIMD_SSE41) { meanSse41(data, old, store, sum, n, inv, out); return; }
+#endif
+  meanScalar(data, old, store, sum, n, inv, out);
+}
+
+void ema(const unsigned short* data, unsigned int* acc, size_t n, int shift, unsigned short* out)
+{
+#if EVO_SIMD_X86
+  const int level = simdLevel();
+  if(level >= SIMD_AVX2)  { emaAvx2(data, acc, n, shift, out); return; }
+  if(level >= SIMD_SSE41) { emaSse41(data, acc, n, shift, out); return; }
+#endif
+  emaScalar(data, acc, n, shift, out);
+}
+
+void median(const unsigned short* data, unsigned short* const* window, int length, size_t n, unsigned short* store, unsigned short* out)
+{
+#if EVO_SIMD_X86
+  const int level = simdLevel();
+  if(level >= SIMD_AVX2)  { medianAvx2(data, window, length, n, store, out); return; }
+  if(level >= SIMD_SSE41) { medianSse41(data, window, length, n, store, out); return; }
+#endif
+  medianScalar(data, window, length, 0, n, store, out);
+}
+
+int emaShift(int length)
+{
+  // nearest power of two
+  int shift = 0;
+  while(shift < EMA_MAX_SHIFT && (2 << shift) <= length) shift++;
+  if(shift < EMA_MAX_SHIFT && length - (1 << shift) > (2 << shift) - length) shift++;
+  return shift;
+}
+
+} // namespace
+
+class EvoIRTemporalFilter
+{
+public:
+  explicit EvoIRTemporalFilter(const EvoIRTemporalParams& params) :
+    _params(params),
+    _pixels((size_t)params.width * params.height),
+    _frames(0),
+    _restart(false),
+    _slot(0),
+    _shift(0)
+  {
+    switch(_params.mode)
+    {
+      case EVO_TEMPORAL_MEAN:
+        _window = _params.length;
+        _history.resize(_pixels * _window);
+        _sum.resize(_pixels);
+        _zeros.resize(_pixels);
+        break;
+      case EVO_TEMPORAL_EMA:
+        _shift  = emaShift(_params.length);
+        _window = 1 << _shift;
+        _sum.resize(_pixels);
+        break;
+      case EVO_TEMPORAL_MEDIAN:
+        // inputs in slots [0; (N + 1) / 2), outputs behind
+        _window = (_params.length + 1) / 2;
+        _history.resize(_pixels * _params.length);
+        break;
+      default:
+        _window = 1;
+        break;
+    }
+  }
+
+  void reset()
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _frames  = 0;
+    _restart = false;
+  }
+
+  void process(const unsigned short* data, const EvoIRFrameMetadata* metadata, unsigned short* out, int* depth)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(_params.mode == EVO_TEMPORAL_NONE)
+    {
+      copy(data, out);
+      if(depth) *depth = 1;
+      return;
+    }
+
+    if(flagFrame(metadata))
+    {
+      if(_params.flagPolicy == EVO_TEMPORAL_FLAG_RESET) _restart = true;
+      if(_frames == 0) copy(data, out);
+      else             render(out);
+      if(depth) *depth = frameCount();
+      return;
+    }
+
+    if(_restart)
+    {
+      _frames  = 0;
+      _restart = false;
+    }
+    if(_frames == 0) start(data, out);
+    else             update(data, out);
+    _frames++;
+    if(depth) *depth = frameCount();
+  }
+
+private:
+  /**
+   * Frames contained in the estimate
+   */
+  int frameCount() const
+  {
+    return _frames < (unsigned long long)_window ? (int)_frames : _window;
+  }
+
+  void copy(const unsigned short* data, unsigned short* out)
+  {
+    if(data != out) std::memcpy(out, data, _pixels * sizeof(unsigned short));
+  }
+
+  void start(const unsigned short* data, unsigned short* out)
+  {
+    _slot = 0;
+    switch(_params.mode)
+    {
+      case EVO_TEMPORAL_MEAN:
+        std::memset(&_sum[0], 0, _pixels * sizeof(unsigned int));
+        update(data, out);
+        break;
+      case EVO_TEMPORAL_EMA:
+        for(size_t i = 0; i < _pixels; i++)
+          _sum[i] = (unsigned int)data[i] << _shift;
+        copy(data, out);
+        break;
+      case EVO_TEMPORAL_MEDIAN:
+        // a window of identical frames, the median converges as real frames replace them
+        for(int k = 0; k < _params.length; k++)
+          std::memcpy(&_history[_pixels * k], data, _pixels * sizeof(unsigned short));
+        copy(data, out);
+        break;
+    }
+  }
+
+  void update(const unsigned short* data, unsigned short* out)
+  {
+    switch(_params.mode)
+    {
+      case EVO_TEMPORAL_MEAN:
+      {
+        unsigned short* slot = &_history[_pixels * _slot];
+        const int count      = _frames < (unsigned long long)_window ? (int)_frames + 1 : _window;
+        // while filling up, the slot does not hold a frame to subtract
+        const unsigned short* old = _frames < (unsigned long long)_window ? &_zeros[0] : slot;
+        mean(data, old, slot, &_sum[0], _pixels, 1.f / count, out);
+        _slot = (_slot + 1) % _window;
+        break;
+      }
+      case EVO_TEMPORAL_EMA:
+        ema(data, &_sum[0], _pixels, _shift, out);
+        break;
+      case EVO_TEMPORAL_MEDIAN:
+      {
+        const int outputs = _params.length - _window;
+        unsigned short* window[MEDIAN_MAX_LENGTH];
+        // the oldest input is replaced by data, the oldest output by the result
+        window[0] = &_history[_pixels * (_slot % _window)];
+        int k = 1;
+        for(int s = 0; s < _window; s++)
+          if(s != _slot % _window) window[k++] = &_history[_pixels * s];
+        for(int s = 0; s < outputs; s++)
+          window[k++] = &_history[_pixels * (_window + s)];
+        unsigned short* store = &_history[_pixels * (_window + _slot % outputs)];
+        median(data, window, _params.length, _pixels, store, out);
+        _slot = (_slot + 1) % (_window * outputs);
+        break;
+      }
+    }
+  }
+
+  /**
+   * Current estimate without adding a frame
+   */
+  void render(unsigned short* out)
+  {
+    switch(_params.mode)
+    {
+      case EVO_TEMPORAL_MEAN:
+      {
+        const float inv = 1.f / frameCount();
+        for(size_t i = 0; i < _pixels; i++)
+          out[i] = (unsigned short)std::lrint((float)_sum[i] * inv);
+        break;
+      }
+      case EVO_TEMPORAL_EMA:
+        for(size_t i = 0; i < _pixels; i++)
+          out[i] = (unsigned short)(_sum[i] >> _shift);
+        break;
+      case EVO_TEMPORAL_MEDIAN:
+      {
+        const int outputs = _params.length - _window;
+        const int last    = _frames > 1 ? (int)((_slot + _window * outputs - 1) % outputs) : 0;
+        // after start all slots hold the first frame
+        std::memcpy(out, &_history[_pixels * (_window + last)], _pixels * sizeof(unsigned short));
+        break;
+      }
+    }
+  }
+
+  EvoIRTemporalFilter(const EvoIRTemporalFilter&);
+  EvoIRTemporalFilter& operator=(const EvoIRTemporalFilter&);
+
+  const EvoIRTemporalParams _params;
+  const size_t _pixels;
+  std::mutex _mutex;
+  unsigned long long _frames;
+  bool _restart;
+  int _window;
+  int _slot;
+  int _shift;
+  std::vector<unsigned short> _history;
+  std::vector<unsigned int> _sum;
+  std::vector<unsigned short> _zeros;
+};
+
+static EvoIRHandleTable<EvoIRTemporalFilter> g_filters;
+typedef EvoIRHandleTable<EvoIRTemporalFilter>::Ref FilterRef;
+
+} // namespace evo
+
+using namespace evo;
+
+void evo_irimager_temporal_default_params(EvoIRTemporalParams* params, int w, int h, int mode, int length)
+{
+  if(!params) return;
+  params->width      = w;
+  params->height     = h;
+  params->mode       = mode;
+  params->length     = length;
+  params->flagPolicy = EVO_TEMPORAL_FLAG_RESET;
+}
+
+int evo_irimager_temporal_create(unsigned int* outFilterId, const EvoIRTemporalParams* params)
+{
+  if(!outFilterId || !params || params->width <= 0 || params->height <= 0) return -1;
+  if(params->flagPolicy != EVO_TEMPORAL_FLAG_RESET && params->flagPolicy != EVO_TEMPORAL_FLAG_SKIP) return -1;
+  switch(params->mode)
+  {
+    case EVO_TEMPORAL_NONE:
+      break;
+    case EVO_TEMPORAL_MEAN:
+      if(params->length < 1 || params->length > MEAN_MAX_LENGTH) return -1;
+      break;
+    case EVO_TEMPORAL_EMA:
+      if(params->length < 1 || params->length > (1 << EMA_MAX_SHIFT)) return -1;
+      break;
+    case EVO_TEMPORAL_MEDIAN:
+      if(params->length < 3 || params->length > MEDIAN_MAX_LENGTH || params->length % 2 == 0) return -1;
+      break;
+    default:
+      return -1;
+  }
+  EvoIRTemporalFilter* filter = new EvoIRTemporalFilter(*params);
+  if(!g_filters.insert(filter, outFilterId))
+  {
+    delete filter;
+    return -1;
+  }
+  return 0;
+}
+
+int evo_irimager_temporal_destroy(const unsigned int filterId)
+{
+  EvoIRTemporalFilter* filter = g_filters.remove(filterId);
+  if(!filter) return -1;
+  delete filter;
+  return 0;
+}
+
+int evo_irimager_temporal_reset(const unsigned int filterId)
+{
+  FilterRef filter = g_filters.acquire(filterId);
+  if(!filter) return -1;
+  filter->reset();
+  return 0;
+}
+
+int evo_irimager_temporal_process(const unsigned int filterId, const unsigned short* data, const EvoIRFrameMetadata* metadata, unsigned short* out, int* depth)
+{
+  FilterRef filter = g_filters.acquire(filterId);
+  if(!filter || !data || !out) return -1;
+  filter->process(data, metadata, out, depth);
+  return 0;
+}
@@ -0,0 +1,112 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRTemporalFilter.h
+ * @brief Provides temporal denoising of raw thermal image streams
+ *
+ * The filters work on the raw unsigned short values with integer
+ * accumulators (SSE4.1/AVX2 selected at runtime, see
+ * evo_irimager_set_simd_level), so output images are raw images again and
+ * results do not depend on the instruction set.
+ *
+ * Frames captured while the shutter flag moves or covers the sensor
+ * (irFlagClosing, irFlagClose, irFlagOpening) are never accumulated. For
+ * these frames the current estimate is repeated. Since the camera corrects
+ * its offsets at each flag cycle, the default policy restarts the
+ * accumulation with the first frame after the flag has opened again.
+ * This covers automatic cycles (<autoflag> in the configuration file)
+ * as well as evo_irimager_trigger_shutter_flag.
+ */
+
+#ifndef EVOIRTEMPORALFILTER_H_
+#define EVOIRTEMPORALFILTER_H_
+
+#include "irdirectsdk_defs.h"
+#include "EvoIRFrameMetadata.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Filter algorithms
+ */
+typedef enum
+{
+  EVO_TEMPORAL_NONE   = 0, /*!< Frames are passed through */
+  EVO_TEMPORAL_MEAN   = 1, /*!< Mean of the last length frames [1; 256] */
+  EVO_TEMPORAL_EMA    = 2, /*!< Exponential moving average, weight of a new frame 1 / length, rounded to a power of two [1; 32768] */
+  EVO_TEMPORAL_MEDIAN = 3  /*!< Recursive median of the last (length + 1) / 2 frames and the last (length - 1) / 2 outputs, length odd [3; 15] */
+} EvoIRTemporalMode;
+
+/**
+ * @brief Handling of frames captured during a shutter flag cycle
+ */
+typedef enum
+{
+  EVO_TEMPORAL_FLAG_RESET = 0, /*!< Skip them and restart accumulating after the flag has opened */
+  EVO_TEMPORAL_FLAG_SKIP  = 1  /*!< Skip them and continue with the accumulated frames */
+} EvoIRTemporalFlagPolicy;
+
+typedef struct __IRDIRECTSDK_API__ EvoIRTemporalParams
+{
+  int width;      /*!< Image width */
+  int height;     /*!< Image height */
+  int mode;       /*!< Algorithm, see EvoIRTemporalMode */
+  int length;     /*!< Number of frames N, see EvoIRTemporalMode for the range */
+  int flagPolicy; /*!< see EvoIRTemporalFlagPolicy */
+} EvoIRTemporalParams;
+
+/**
+ * @brief Fills parameter structure with defaults (restart after flag cycles)
+ * @param[out] params parameter structure
+ * @param[in] w image width
+ * @param[in] h image height
+ * @param[in] mode algorithm, see EvoIRTemporalMode
+ * @param[in] length number of frames
+ */
+__IRDIRECTSDK_API__ void evo_irimager_temporal_default_params(EvoIRTemporalParams* params, int w, int h, int mode, int length);
+
+/**
+ * @brief Creates a temporal filter
+ * @param[out] outFilterId filter instance id for reference
+ * @param[in] params filter parameters
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_temporal_create(unsigned int* outFilterId, const EvoIRTemporalParams* params);
+
+/**
+ * @brief Releases a temporal filter
+ * @param[in] filterId filter instance id from create to apply this function
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_temporal_destroy(const unsigned int filterId);
+
+/**
+ * @brief Discards all accumulated frames, e.g. after the scene or the temperature range changed
+ * @param[in] filterId filter instance id from create to apply this function
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_temporal_reset(const unsigned int filterId);
+
+/**
+ * @brief Adds a frame and delivers the filtered image
+ * @param[in] filterId filter instance id from create to apply this function
+ * @param[in] data thermal image (size of width * height)
+ * @param[in] metadata metadata of the frame, NULL if unknown (no flag handling)
+ * @param[out] out pointer to unsigned short array allocate by the user (size of width * height), may be equal to data
+ * @param[out] depth number of frames contained in out, 0 if data was passed through (flag frame before any other), may be NULL
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_temporal_process(const unsigned int filterId, const unsigned short* data, const EvoIRFrameMetadata* metadata, unsigned short* out, int* depth);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* EVOIRTEMPORALFILTER_H_ */
@@ -0,0 +1,900 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRTileStore.cpp
+ * @brief Tile recorder and query engine of the pixel history store
+ *
+ * File layout (*.evotile), chunks as in recordings (see EvoIRRecordingFormat.h):
+ * @code
+ * TileFileHeader                    40 bytes
+ * Chunk 'ETBK' (one per block)      ChunkHeader | TileBlockInfo | long long timestamps[frames] | TileSummary[tiles] | tile data
+ * ...
+ * Chunk 'ETIX' (index footer)       ChunkHeader | TileIndexEntry[blocks]
+ * Trailer                           offset of index chunk | "EVOIRTIX"
+ * @endcode
+ *
+ * Tiles are numbered row by row, tiles at the right and bottom border are
+ * cut to the image. The data of a tile starts with the offsets of its pixels
+ * relative to the tile (tile pixels + 1 unsigned int), followed by the
+ * history of each pixel in row order. A history is compressed with the codec
+ * of recordings as an image of one row and frames columns, i.e. the
+ * difference to the previous frame, packed in groups of 16 frames.
+ *
+ * The CRC of a block is only checked when a store without index footer is
+ * recovered. Queries read single pixel histories from the mapped file and
+ * check their offsets, so they remain cheap while a corrupt block still
+ * cannot make them read outside of the file.
+ */
+
+#include "EvoIRTileStore.h"
+#include "EvoIRRecording.h"
+#include "EvoIRRecordingFormat.h"
+#include "EvoIRMappedFile.h"
+#include "EvoIRHandleTable.h"
+#include "EvoIRSimd.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace evo
+{
+
+namespace
+{
+
+const char         TILE_FILE_MAGIC[8]    = { 'E', 'V', 'O', 'I', 'R', 'T', 'I', 'L' };
+const char         TILE_TRAILER_MAGIC[8] = { 'E', 'V', 'O', 'I', 'R', 'T', 'I', 'X' };
+const unsigned int TILE_VERSION          = 1;
+const unsigned int CHUNK_BLOCK           = 0x4B425445; // 'ETBK'
+const unsigned int CHUNK_TILE_INDEX      = 0x58495445; // 'ETIX'
+const int MIN_TILE                       = 4;
+const int MAX_TILE                       = 64;
+const unsigned int MIN_BLOCK             = 16;
+const unsigned int MAX_BLOCK             = 4096;
+
+struct TileFileHeader
+{
+  char magic[8];
+  unsigned int version;
+  unsigned int width;
+  unsigned int height;
+  float framerate;
+  unsigned int tileSize;
+  unsigned int blockFrames;
+  unsigned int reserved[2];
+};
+
+struct TileBlockInfo
+{
+  unsigned long long firstFrame;
+  unsigned int frames;
+  unsigned int reserved;
+};
+
+struct TileSummary
+{
+  unsigned int offset; ///< start of tile data relative to the block payload
+  unsigned short min;
+  unsigned short max;
+};
+
+struct TileIndexEntry
+{
+  unsigned long long offset; ///< file offset of the block chunk
+  unsigned long long firstFrame;
+  long long timestampFirst;
+  long long timestampLast;
+  unsigned int frames;
+  unsigned int reserved;
+};
+
+static_assert(sizeof(TileFileHeader) == 40, "unexpected tile file header size");
+static_assert(sizeof(TileBlockInfo) == 16, "unexpected tile block info size");
+static_assert(sizeof(TileSummary) == 8, "unexpected tile summary size");
+static_assert(sizeof(TileIndexEntry) == 40, "unexpected tile index entry size");
+
+/**
+ * @brief Division of the image into tiles
+ */
+struct TileGrid
+{
+  int width;
+  int height;
+  int size;
+  int tilesX;
+  int tilesY;
+
+  TileGrid() : width(0), height(0), size(1), tilesX(0), tilesY(0) { }
+
+  TileGrid(int w, int h, int tileSize) : width(w), height(h), size(tileSize)
+  {
+    tilesX = (w + tileSize - 1) / tileSize;
+    tilesY = (h + tileSize - 1) / tileSize;
+  }
+
+  int tiles() const { return tilesX * tilesY; }
+
+  void rect(int tile, int* x0, int* y0, int* tw, int* th) const
+  {
+    *x0 = (tile % tilesX) * size;
+    *y0 = (tile / tilesX) * size;
+    *tw = std::min(size, width - *x0);
+    *th = std::min(size, height - *y0);
+  }
+};
+
+size_t blockHeaderSize(unsigned int frames, const TileGrid& grid)
+{
+  return sizeof(TileBlockInfo) + frames * sizeof(long long) + grid.tiles() * sizeof(TileSummary);
+}
+
+// Worst case block payload: tile offsets and the padding of every tile to 4 bytes, see encodeBlock
+unsigned long long maxPayloadSize(unsigned int frames, const TileGrid& grid)
+{
+  return blockHeaderSize(frames, grid) + (unsigned long long)grid.tiles() * ((grid.size * grid.size + 1) * sizeof(unsigned int) + 3)
+         + (unsigned long long)grid.width * grid.height * recordingCodecMaxSize((int)frames, 1);
+}
+
+// Chunk payload sizes and tile offsets are 32 bit, so the worst case block has to fit. The raw
+// pixels of a block are a lower bound of it and keep the grid arithmetic in range.
+bool validGeometry(int w, int h, int tileSize, unsigned int blockFrames)
+{
+  return w > 0 && h > 0 && tileSize >= MIN_TILE && tileSize <= MAX_TILE && blockFrames >= MIN_BLOCK && blockFrames <= MAX_BLOCK
+         && (unsigned long long)w * h * blockFrames * sizeof(unsigned short) <= 0xFFFFFFFFu
+         && maxPayloadSize(blockFrames, TileGrid(w, h, tileSize)) <= 0xFFFFFFFFu;
+}
+
+// Minimum, maximum and sum per frame over the pixels of a patch
+void accumulateScalar(const unsigned short* series, unsigned int frames, unsigned short* lo, unsigned short* hi, unsigned long long* sum)
+{
+  for(unsigned int f = 0; f < frames; f++)
+  {
+    const unsigned short v = series[f];
+    lo[f] = std::min(lo[f], v);
+    hi[f] = std::max(hi[f], v);
+    sum[f] += v;
+  }
+}
+
+#if EVO_SIMD_X86
+EVO_TARGET_SSE41 void accumulateSse41(const unsigned short* series, unsigned int frames, unsigned short* lo, unsigned short* hi, unsigned long long* sum)
+{
+  unsigned int f = 0;
+  for(; f + 8 <= frames; f += 8)
+  {
+    const __m128i v = _mm_loadu_si128((const __m128i*)(series + f));
+    _mm_storeu_si128((__m128i*)(lo + f), _mm_min_epu16(_mm_loadu_si128((const __m128i*)(lo + f)), v));
+    _mm_storeu_si128((__m128i*)(hi + f), _mm_max_epu16(_mm_loadu_si128((const __m128i*)(hi + f)), v));
+    const __m128i s0 = _mm_add_epi64(_mm_loadu_si128((const __m128i*)(sum + f)), _mm_cvtepu16_epi64(v));
+    const __m128i s1 = _mm_add_epi64(_mm_loadu_si128((const __m128i*)(sum + f + 2)), _mm_cvtepu16_epi64(_mm_srli_si128(v, 4)));
+    const __m128i s2 = _mm_add_epi64(_mm_loadu_si128((const __m128i*)(sum + f + 4)), _mm_cvtepu16_epi64(_mm_srli_si128(v, 8)));
+    const __m128i s3 = _mm_add_epi64(_mm_loadu_si128((const __m128i*)(sum + f + 6)), _mm_cvtepu16_epi64(_mm_srli_si128(v, 12)));
+    _mm_storeu_si128((__m128i*)(sum + f), s0);
+    _mm_storeu_si128((__m128i*)(sum + f + 2), s1);
+    _mm_storeu_si128((__m128i*)(sum + f + 4), s2);
+    _mm_storeu_si128((__m128i*)(sum + f + 6), s3);
+  }
+  accumulateScalar(series + f, frames - f, lo + f, hi + f, sum + f);
+}
+#endif
+
+void accumulate(const unsigned short* series, unsigned int frames, unsigned short* lo, unsigned short* hi, unsigned long long* sum)
+{
+#if EVO_SIMD_X86
+  if(simdLevel() >= SIMD_SSE41)
+  {
+    accumulateSse41(series, frames, lo, hi, sum);
+    return;
+  }
+#endif
+  accumulateScalar(series, frames, lo, hi, sum);
+}
+
+} // namespace
+
+//------------------------------------------------------------------------------
+// Writer
+
+class EvoIRTileRecorder
+{
+public:
+  EvoIRTileRecorder() :
+    _file(nullptr),
+    _blockFrames(0),
+    _fill(0),
+    _count(0),
+    _frames(0),
+    _offset(0),
+    _pending(false),
+    _pendingBuffer(0),
+    _pendingFrames(0),
+    _pendingFirst(0),
+    _stop(false),
+    _failed(false)
+  { }
+
+  ~EvoIRTileRecorder()
+  {
+    close();
+  }
+
+  bool open(const char* path, int w, int h, float framerate, int tileSize, unsigned int blockFrames)
+  {
+    _file = fopen(path, "wb");
+    if(!_file) return false;
+    _grid        = TileGrid(w, h, tileSize);
+    _blockFrames = blockFrames;
+
+    TileFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, TILE_FILE_MAGIC, sizeof(header.magic));
+    header.version     = TILE_VERSION;
+    header.width       = (unsigned int)w;
+    header.height      = (unsigned int)h;
+    header.framerate   = framerate;
+    header.tileSize    = (unsigned int)tileSize;
+    header.blockFrames = blockFrames;
+    if(fwrite(&header, sizeof(header), 1, _file) != 1) return false;
+    _offset = sizeof(header);
+
+    const size_t pixels = (size_t)w * h;
+    for(int b = 0; b < 2; b++)
+    {
+      _buffers[b].resize(pixels * blockFrames);
+      _timestamps[b].resize(blockFrames);
+    }
+    _series.resize((size_t)tileSize * tileSize * blockFrames);
+    _scratch.resize(recordingCodecScratchSize((int)blockFrames, 1));
+    _payload.resize((size_t)maxPayloadSize(blockFrames, _grid));
+    _thread = std::thread(&EvoIRTileRecorder::encodeLoop, this);
+    return true;
+  }
+
+  bool write(const unsigned short* data, const EvoIRFrameMetadata& metadata)
+  {
+    std::lock_guard<std::mutex> lock(_controlMutex);
+    if(!_file || _failed.load()) return false;
+    const size_t pixels = (size_t)_grid.width * _grid.height;
+    std::memcpy(&_buffers[_fill][_count * pixels], data, pixels * sizeof(unsigned short));
+    _timestamps[_fill][_count] = metadata.timestamp;
+    _count++;
+    _frames++;
+    if(_count == _blockFrames) submit();
+    return true;
+  }
+
+  bool close()
+  {
+    std::lock_guard<std::mutex> lock(_controlMutex);
+    if(!_file) return false;
+    if(_count > 0) submit();
+    {
+      std::lock_guard<std::mutex> workerLock(_mutex);
+      _stop = true;
+      _condition.notify_all();
+    }
+    if(_thread.joinable()) _thread.join();
+
+    bool ok = !_failed.load();
+    if(ok)
+    {
+      RecordingChunkHeader chunk;
+      chunk.magic       = CHUNK_TILE_INDEX;
+      chunk.payloadSize = (unsigned int)(_index.size() * sizeof(TileIndexEntry));
+      chunk.crc         = recordingCrc32(_index.empty() ? nullptr : &_index[0], chunk.payloadSize);
+      chunk.codec       = 0;
+      chunk.reserved    = 0;
+      RecordingTrailer trailer;
+      trailer.indexOffset = _offset;
+      std::memcpy(trailer.magic, TILE_TRAILER_MAGIC, sizeof(trailer.magic));
+      ok = writeChunk(chunk, _index.empty() ? nullptr : (const unsigned char*)&_index[0]) && fwrite(&trailer, sizeof(trailer), 1, _file) == 1;
+    }
+    ok = (fclose(_file) == 0) && ok;
+    _file = nullptr;
+    return ok;
+  }
+
+private:
+  EvoIRTileRecorder(const EvoIRTileRecorder&);
+  EvoIRTileRecorder& operator=(const EvoIRTileRecorder&);
+
+  // Hands the filled buffer to the encoder thread, waits while it still encodes the other one
+  void submit()
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _condition.wait(lock, [this]() { return !_pending; });
+    _pending       = true;
+    _pendingBuffer = _fill;
+    _pendingFrames = _count;
+    _pendingFirst  = _frames - _count;
+    _condition.notify_all();
+    _fill ^= 1;
+    _count = 0;
+  }
+
+  void encodeLoop()
+  {
+    for(;;)
+    {
+      int buffer;
+      unsigned int frames;
+      unsigned long long first;
+      {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _condition.wait(lock, [this]() { return _pending || _stop; });
+        if(!_pending) return;
+        buffer = _pendingBuffer;
+        frames = _pendingFrames;
+        first  = _pendingFirst;
+      }
+      if(!_failed.load() && !encodeBlock(buffer, frames, first)) _failed.store(true);
+      std::lock_guard<std::mutex> lock(_mutex);
+      _pending = false;
+      _condition.notify_all();
+    }
+  }
+
+  bool encodeBlock(int buffer, unsigned int frames, unsigned long long first)
+  {
+    const unsigned short* frameData = &_buffers[buffer][0];
+    const size_t pixels = (size_t)_grid.width * _grid.height;
+    unsigned char* payload = &_payload[0];
+
+    TileBlockInfo info;
+    info.firstFrame = first;
+    info.frames     = frames;
+    info.reserved   = 0;
+    std::memcpy(payload, &info, sizeof(info));
+    std::memcpy(payload + sizeof(info), &_timestamps[buffer][0], frames * sizeof(long long));
+    TileSummary* summaries = (TileSummary*)(payload + sizeof(info) + frames * sizeof(long long));
+
+    size_t pos = blockHeaderSize(frames, _grid);
+    for(int t = 0; t < _grid.tiles(); t++)
+    {
+      int x0, y0, tw, th;
+      _grid.rect(t, &x0, &y0, &tw, &th);
+      const unsigned int tilePixels = (unsigned int)(tw * th);
+
+      // transpose: frame by frame, rows of the tile into the histories of their pixels
+      unsigned short lo = 0xFFFF, hi = 0;
+      for(unsigned int f = 0; f < frames; f++)
+      {
+        const unsigned short* src = frameData + f * pixels + (size_t)y0 * _grid.width + x0;
+        for(int j = 0; j < th; j++, src += _grid.width)
+        {
+          unsigned short* dst = &_series[(size_t)j * tw * frames + f];
+          for(int i = 0; i < tw; i++, dst += frames)
+          {
+            const unsigned short v = src[i];
+            *dst = v;
+            lo = std::min(lo, v);
+            hi = std::max(hi, v);
+          }
+        }
+      }
+
+      summaries[t].offset = (unsigned int)pos;
+      summaries[t].min    = lo;
+      summaries[t].max    = hi;
+      unsigned int* offsets = (unsigned int*)(payload + pos);
+      unsigned int tilePos  = (tilePixels + 1) * sizeof(unsigned int);
+      for(unsigned int p = 0; p < tilePixels; p++)
+      {
+        offsets[p] = tilePos;
+        tilePos += recordingCodecEncode(&_series[(size_t)p * frames], (int)frames, 1, payload + pos + tilePos, &_scratch[0]);
+      }
+      offsets[tilePixels] = tilePos;
+      pos += (tilePos + 3) & ~3u;
+    }
+
+    RecordingChunkHeader chunk;
+    chunk.magic       = CHUNK_BLOCK;
+    chunk.payloadSize = (unsigned int)pos;
+    chunk.crc         = recordingCrc32(payload, pos);
+    chunk.codec       = CODEC_MED;
+    chunk.reserved    = 0;
+
+    TileIndexEntry entry;
+    entry.offset         = _offset;
+    entry.firstFrame     = first;
+    entry.timestampFirst = _timestamps[buffer][0];
+    entry.timestampLast  = _timestamps[buffer][frames - 1];
+    entry.frames         = frames;
+    entry.reserved       = 0;
+    if(!writeChunk(chunk, payload)) return false;
+    _index.push_back(entry);
+    return true;
+  }
+
+  bool writeChunk(const RecordingChunkHeader& chunk, const unsigned char* payload)
+  {
+    static const unsigned char PADDING[8] = { 0 };
+    const unsigned long long size = recordingChunkSize(chunk.payloadSize);
+    const size_t padding = (size_t)(size - sizeof(chunk) - chunk.payloadSize);
+    if(fwrite(&chunk, sizeof(chunk), 1, _file) != 1) return false;
+    if(chunk.payloadSize && fwrite(payload, 1, chunk.payloadSize, _file) != chunk.payloadSize) return false;
+    if(padding && fwrite(PADDING, 1, padding, _file) != padding) return false;
+    _offset += size;
+    return true;
+  }
+
+  std::mutex _controlMutex;
+  FILE* _file;
+  TileGrid _grid;
+  unsigned int _blockFrames;
+
+  // filled by the caller
+  std::vector<unsigned short> _buffers[2];
+  std::vector<long long> _timestamps[2];
+  int _fill;
+  unsigned int _count;
+  unsigned long long _frames;
+
+  // used by the encoder thread
+  std::vector<unsigned short> _series;
+  std::vector<unsigned short> _scratch;
+  std::vector<unsigned char> _payload;
+  std::vector<TileIndexEntry> _index;
+  unsigned long long _offset;
+
+  std::mutex _mutex;
+  std::condition_variable _condition;
+  bool _pending;
+  int _pendingBuffer;
+  unsigned int _pendingFrames;
+  unsigned long long _pendingFirst;
+  bool _stop;
+  std::atomic<bool> _failed;
+  std::thread _thread;
+};
+
+//------------------------------------------------------------------------------
+// Reader
+
+class EvoIRTileStore
+{
+public:
+  EvoIRTileStore() : _header(nullptr), _frames(0), _recovered(false) { }
+
+  bool open(const char* path)
+  {
+    if(!_file.open(path) || _file.size() < sizeof(TileFileHeader)) return false;
+    _header = (const TileFileHeader*)_file.data();
+    if(std::memcmp(_header->magic, TILE_FILE_MAGIC, sizeof(_header->magic)) != 0 || _header->version != TILE_VERSION
+       || !validGeometry((int)_header->width, (int)_header->height, (int)_header->tileSize, _header->blockFrames))
+      return false;
+    _grid = TileGrid((int)_header->width, (int)_header->height, (int)_header->tileSize);
+
+    if(!readIndex())
+    {
+      _recovered = true;
+      scan();
+    }
+    // blocks have to follow each other without gaps, the frame index of a query is located by binary search
+    _frames = 0;
+    for(size_t i = 0; i < _index.size(); i++)
+    {
+      if(_index[i].firstFrame != _frames || !validBlock(_index[i])) return false;
+      _frames += _index[i].frames;
+    }
+    return _frames <= 0xFFFFFFFFULL;
+  }
+
+  void info(EvoIRTileStoreInfo* info) const
+  {
+    info->width          = _grid.width;
+    info->height         = _grid.height;
+    info->framerate      = _header->framerate;
+    info->tileSize       = _grid.size;
+    info->blockFrames    = _header->blockFrames;
+    info->frames         = _frames;
+    info->blocks         = (unsigned int)_index.size();
+    info->timestampFirst = _index.empty() ? 0 : _index.front().timestampFirst;
+    info->timestampLast  = _index.empty() ? 0 : _index.back().timestampLast;
+    info->recovered      = _recovered ? 1 : 0;
+  }
+
+  unsigned long long findTime(long long timestamp) const
+  {
+    // first block whose last frame is not older, then within its timestamps
+    size_t lo = 0, hi = _index.size();
+    while(lo < hi)
+    {
+      const size_t mid = (lo + hi) / 2;
+      if(_index[mid].timestampLast < timestamp) lo = mid + 1;
+      else hi = mid;
+    }
+    if(lo == _index.size()) return _frames;
+    const long long* t = timestamps(_index[lo]);
+    return _index[lo].firstFrame + (std::lower_bound(t, t + _index[lo].frames, timestamp) - t);
+  }
+
+  bool validPatch(int x, int y, int w, int h, unsigned long long first, unsigned long long count) const
+  {
+    return x >= 0 && y >= 0 && w > 0 && h > 0 && x + w <= _grid.width && y + h <= _grid.height && count > 0 && first < _frames
+           && count <= _frames - first;
+  }
+
+  bool readPatch(int x, int y, int w, int h, unsigned long long first, unsigned long long count, unsigned short* data, long long* times) const
+  {
+    std::vector<unsigned short> series(_header->blockFrames), scratch(recordingCodecScratchSize((int)_header->blockFrames, 1));
+    for(size_t b = firstBlock(first); b < _index.size() && _index[b].firstFrame < first + count; b++)
+    {
+      unsigned int f0, f1;
+      const TileIndexEntry& block = blockRange(b, first, count, &f0, &f1);
+      const unsigned long long out = block.firstFrame + f0 - first;
+      if(times) std::memcpy(times + out, timestamps(block) + f0, (f1 - f0) * sizeof(long long));
+      const bool ok = forEachPixel(block, x, y, w, h, &series[0], &scratch[0], [&](int i, int j, const unsigned short* s) {
+        std::memcpy(data + ((size_t)j * w + i) * count + out, s + f0, (f1 - f0) * sizeof(unsigned short));
+      });
+      if(!ok) return false;
+    }
+    return true;
+  }
+
+  bool patchHistory(int x, int y, int w, int h, unsigned long long first, unsigned long long count, EvoIRPatchSample* samples) const
+  {
+    const unsigned int blockFrames = _header->blockFrames;
+    std::vector<unsigned short> series(blockFrames), scratch(recordingCodecScratchSize((int)blockFrames, 1));
+    std::vector<unsigned short> lo(blockFrames), hi(blockFrames);
+    std::vector<unsigned long long> sum(blockFrames);
+    const double scale = 1.0 / ((double)w * h);
+    for(size_t b = firstBlock(first); b < _index.size() && _index[b].firstFrame < first + count; b++)
+    {
+      unsigned int f0, f1;
+      const TileIndexEntry& block = blockRange(b, first, count, &f0, &f1);
+      std::fill(lo.begin(), lo.end(), 0xFFFF);
+      std::fill(hi.begin(), hi.end(), 0);
+      std::fill(sum.begin(), sum.end(), 0);
+      const bool ok = forEachPixel(block, x, y, w, h, &series[0], &scratch[0], [&](int, int, const unsigned short* s) {
+        accumulate(s + f0, f1 - f0, &lo[f0], &hi[f0], &sum[f0]);
+      });
+      if(!ok) return false;
+      const long long* t = timestamps(block);
+      EvoIRPatchSample* out = samples + (block.firstFrame + f0 - first);
+      for(unsigned int f = f0; f < f1; f++, out++)
+      {
+        out->timestamp = t[f];
+        out->min       = lo[f];
+        out->max       = hi[f];
+        out->mean      = (float)(sum[f] * scale);
+      }
+    }
+    return true;
+  }
+
+  bool findRange(int x, int y, int w, int h, unsigned long long first, unsigned long long count, unsigned short rawMin, unsigned short rawMax,
+                 EvoIRFrameRun* runs, unsigned int maxRuns, unsigned int* runCount, unsigned int* skipped) const
+  {
+    const unsigned int blockFrames = _header->blockFrames;
+    std::vector<unsigned short> series(blockFrames), scratch(recordingCodecScratchSize((int)blockFrames, 1));
+    std::vector<char> match(blockFrames);
+    unsigned int found = 0, skips = 0;
+    bool open = false; // last run reaches up to the previous frame
+    unsigned long long runFirst = 0;
+    unsigned long long next = first;
+    for(size_t b = firstBlock(first); b < _index.size() && _index[b].firstFrame < first + count; b++)
+    {
+      unsigned int f0, f1;
+      const TileIndexEntry& block = blockRange(b, first, count, &f0, &f1);
+      const unsigned char* payload = (const unsigned char*)(chunkHeader(block) + 1);
+      const TileSummary* summaries = (const TileSummary*)(payload + sizeof(TileBlockInfo) + block.frames * sizeof(long long));
+
+      bool possible = false;
+      for(int ty = y / _grid.size; ty <= (y + h - 1) / _grid.size && !possible; ty++)
+        for(int tx = x / _grid.size; tx <= (x + w - 1) / _grid.size && !possible; tx++)
+        {
+          const TileSummary& s = summaries[ty * _grid.tilesX + tx];
+          possible = s.max >= rawMin && s.min <= rawMax;
+        }
+
+      std::fill(match.begin(), match.end(), 0);
+      if(possible)
+      {
+        const bool ok = forEachPixel(block, x, y, w, h, &series[0], &scratch[0], [&](int, int, const unsigned short* s) {
+          for(unsigned int f = f0; f < f1; f++)
+            match[f] |= (s[f] >= rawMin && s[f] <= rawMax) ? 1 : 0;
+        });
+        if(!ok) return false;
+      }
+      else
+      {
+        skips++;
+      }
+
+      for(unsigned int f = f0; f < f1; f++, next++)
+      {
+        if(match[f] && !open)
+        {
+          open     = true;
+          runFirst = next;
+        }
+        else if(!match[f] && open)
+        {
+          open = false;
+          if(found < maxRuns) { runs[found].first = (unsigned int)runFirst; runs[found].count = (unsigned int)(next - runFirst); }
+          found++;
+        }
+      }
+    }
+    if(open)
+    {
+      if(found < maxRuns) { runs[found].first = (unsigned int)runFirst; runs[found].count = (unsigned int)(next - runFirst); }
+      found++;
+    }
+    *runCount = found;
+    if(skipped) *skipped = skips;
+    return true;
+  }
+
+private:
+  EvoIRTileStore(const EvoIRTileStore&);
+  EvoIRTileStore& operator=(const EvoIRTileStore&);
+
+  const RecordingChunkHeader* chunkHeader(const TileIndexEntry& block) const
+  {
+    return (const RecordingChunkHeader*)(_file.data() + block.offset);
+  }
+
+  const long long* timestamps(const TileIndexEntry& block) const
+  {
+    return (const long long*)((const unsigned char*)(chunkHeader(block) + 1) + sizeof(TileBlockInfo));
+  }
+
+  size_t firstBlock(unsigned long long frame) const
+  {
+    size_t lo = 0, hi = _index.size();
+    while(hi - lo > 1)
+    {
+      const size_t mid = (lo + hi) / 2;
+      if(_index[mid].firstFrame <= frame) lo = mid;
+      else hi = mid;
+    }
+    return lo;
+  }
+
+  // Frames [f0; f1) of block b within the queried range
+  const TileIndexEntry& blockRange(size_t b, unsigned long long first, unsigned long long count, unsigned int* f0, unsigned int* f1) const
+  {
+    const TileIndexEntry& block = _index[b];
+    *f0 = first > block.firstFrame ? (unsigned int)(first - block.firstFrame) : 0;
+    *f1 = (unsigned int)std::min<unsigned long long>(block.frames, first + count - block.firstFrame);
+    return block;
+  }
+
+  // Decodes the history of every pixel of the patch within a block and passes it with its patch coordinates
+  template<typename F>
+  bool forEachPixel(const TileIndexEntry& block, int x, int y, int w, int h, unsigned short* series, unsigned short* scratch, F consume) const
+  {
+    const RecordingChunkHeader* chunk = chunkHeader(block);
+    const unsigned char* payload = (const unsigned char*)(chunk + 1);
+    const unsigned int size      = chunk->payloadSize;
+    const TileSummary* summaries = (const TileSummary*)(payload + sizeof(TileBlockInfo) + block.frames * sizeof(long long));
+    for(int ty = y / _grid.size; ty <= (y + h - 1) / _grid.size; ty++)
+    {
+      for(int tx = x / _grid.size; tx <= (x + w - 1) / _grid.size; tx++)
+      {
+        const int tile = ty * _grid.tilesX + tx;
+        int x0, y0, tw, th;
+        _grid.rect(tile, &x0, &y0, &tw, &th);
+        const unsigned int tilePixels = (unsigned int)(tw * th);
+        const unsigned int offset     = summaries[tile].offset;
+        if((unsigned long long)offset + (tilePixels + 1) * sizeof(unsigned int) > size) return false;
+        const unsigned int* offsets = (const unsigned int*)(payload + offset);
+
+        for(int py = std::max(y, y0); py < std::min(y + h, y0 + th); py++)
+        {
+          for(int px = std::max(x, x0); px < std::min(x + w, x0 + tw); px++)
+          {
+            const unsigned int p     = (unsigned int)((py - y0) * tw + (px - x0));
+            const unsigned int begin = offsets[p];
+            const unsigned int end   = offsets[p + 1];
+            if(end < begin || (unsigned long long)offset + end > size) return false;
+            if(!recordingCodecDecode(payload + offset + begin, end - begin, (int)block.frames, 1, series, scratch)) return false;
+            consume(px - x, py - y, series);
+          }
+        }
+      }
+    }
+    return true;
+  }
+
+  bool validBlock(const TileIndexEntry& block) const
+  {
+    if(block.offset + sizeof(RecordingChunkHeader) > _file.size() || block.frames == 0 || block.frames > _header->blockFrames) return false;
+    const RecordingChunkHeader* chunk = chunkHeader(block);
+    if(chunk->magic != CHUNK_BLOCK || block.offset + sizeof(RecordingChunkHeader) + chunk->payloadSize > _file.size()) return false;
+    if(chunk->payloadSize < blockHeaderSize(block.frames, _grid)) return false;
+    const TileBlockInfo* info = (const TileBlockInfo*)(chunk + 1);
+    return info->frames == block.frames && info->firstFrame == block.firstFrame;
+  }
+
+  bool readIndex()
+  {
+    const unsigned long long size = _file.size();
+    if(size < sizeof(TileFileHeader) + sizeof(RecordingChunkHeader) + sizeof(RecordingTrailer)) return false;
+    const RecordingTrailer* trailer = (const RecordingTrailer*)(_file.data() + size - sizeof(RecordingTrailer));
+    if(std::memcmp(trailer->magic, TILE_TRAILER_MAGIC, sizeof(trailer->magic)) != 0) return false;
+    if(trailer->indexOffset < sizeof(TileFileHeader) || trailer->indexOffset + sizeof(RecordingChunkHeader) > size) return false;
+    const RecordingChunkHeader* chunk = (const RecordingChunkHeader*)(_file.data() + trailer->indexOffset);
+    if(chunk->magic != CHUNK_TILE_INDEX || trailer->indexOffset + sizeof(RecordingChunkHeader) + chunk->payloadSize > size) return false;
+    if(recordingCrc32(chunk + 1, chunk->payloadSize) != chunk->crc) return false;
+    const size_t count = chunk->payloadSize / sizeof(TileIndexEntry);
+    _index.resize(count);
+    if(count) std::memcpy(&_index[0], chunk + 1, count * sizeof(TileIndexEntry));
+    return true;
+  }
+
+  // Recovery of stores without footer: collect blocks up to the first broken one
+  void scan()
+  {
+    _index.clear();
+    const unsigned long long size = _file.size();
+    unsigned long long offset = sizeof(TileFileHeader);
+    unsigned long long frames = 0;
+    while(offset + sizeof(RecordingChunkHeader) <= size)
+    {
+      const RecordingChunkHeader* chunk = (const RecordingChunkHeader*)(_file.data() + offset);
+      if(chunk->magic != CHUNK_BLOCK || offset + recordingChunkSize(chunk->payloadSize) > size) break;
+      if(chunk->payloadSize < sizeof(TileBlockInfo) || recordingCrc32(chunk + 1, chunk->payloadSize) != chunk->crc) break;
+      const TileBlockInfo* info = (const TileBlockInfo*)(chunk + 1);
+      if(info->firstFrame != frames || info->frames == 0 || chunk->payloadSize < blockHeaderSize(info->frames, _grid)) break;
+
+      const long long* t = (const long long*)(info + 1);
+      TileIndexEntry entry;
+      entry.offset         = offset;
+      entry.firstFrame     = info->firstFrame;
+      entry.timestampFirst = t[0];
+      entry.timestampLast  = t[info->frames - 1];
+      entry.frames         = info->frames;
+      entry.reserved       = 0;
+      _index.push_back(entry);
+      frames += info->frames;
+      offset += recordingChunkSize(chunk->payloadSize);
+    }
+  }
+
+  EvoIRMappedFile _file;
+  const TileFileHeader* _header;
+  TileGrid _grid;
+  std::vector<TileIndexEntry> _index;
+  unsigned long long _frames;
+  bool _recovered;
+};
+
+static EvoIRHandleTable<EvoIRTileRecorder> g_tileRecorders;
+static EvoIRHandleTable<EvoIRTileStore> g_tileStores;
+typedef EvoIRHandleTable<EvoIRTileRecorder>::Ref TileRecorderRef;
+typedef EvoIRHandleTable<EvoIRTileStore>::Ref TileStoreRef;
+
+} // namespace evo
+
+using namespace evo;
+
+int evo_irimager_tile_recorder_open(unsigned int* outTileId, const char* path, int w, int h, float framerate, int tileSize, unsigned int blockFrames)
+{
+  if(!outTileId || !path || !validGeometry(w, h, tileSize, blockFrames)) return -1;
+  EvoIRTileRecorder* recorder = new EvoIRTileRecorder();
+  if(!recorder->open(path, w, h, framerate, tileSize, blockFrames) || !g_tileRecorders.insert(recorder, outTileId))
+  {
+    delete recorder;
+    return -1;
+  }
+  return 0;
+}
+
+int evo_irimager_tile_recorder_write_frame(const unsigned int tileId, const unsigned short* data, const EvoIRFrameMetadata* metadata)
+{
+  TileRecorderRef recorder = g_tileRecorders.acquire(tileId);
+  if(!recorder || !data || !metadata) return -1;
+  return recorder->write(data, *metadata) ? 0 : -1;
+}
+
+int evo_irimager_tile_recorder_close(const unsigned int tileId)
+{
+  EvoIRTileRecorder* recorder = g_tileRecorders.remove(tileId);
+  if(!recorder) return -1;
+  const bool ok = recorder->close();
+  delete recorder;
+  return ok ? 0 : -1;
+}
+
+int evo_irimager_tile_store_build(const char* recordingPath, const char* path, int tileSize, unsigned int blockFrames)
+{
+  if(!recordingPath || !path) return -1;
+  unsigned int recId;
+  if(evo_irimager_recording_open(&recId, recordingPath) != 0) return -1;
+  EvoIRRecordingInfo info;
+  evo_irimager_recording_get_info(recId, &info);
+
+  unsigned int tileId;
+  if(evo_irimager_tile_recorder_open(&tileId, path, info.width, info.height, info.framerate, tileSize, blockFrames) != 0)
+  {
+    evo_irimager_recording_close(recId);
+    return -1;
+  }
+  std::vector<unsigned short> data((size_t)info.width * info.height);
+  bool ok = true;
+  for(unsigned long long i = 0; i < info.frames && ok; i++)
+  {
+    int w = info.width, h = info.height;
+    EvoIRFrameMetadata metadata;
+    ok = evo_irimager_recording_read_frame(recId, i, &w, &h, &data[0], &metadata) == 0
+         && evo_irimager_tile_recorder_write_frame(tileId, &data[0], &metadata) == 0;
+  }
+  ok = evo_irimager_tile_recorder_close(tileId) == 0 && ok;
+  evo_irimager_recording_close(recId);
+  return ok ? 0 : -1;
+}
+
+int evo_irimager_tile_store_open(unsigned int* outStoreId, const char* path)
+{
+  if(!outStoreId || !path) return -1;
+  EvoIRTileStore* store = new EvoIRTileStore();
+  if(!store->open(path) || !g_tileStores.insert(store, outStoreId))
+  {
+    delete store;
+    return -1;
+  }
+  return 0;
+}
+
+int evo_irimager_tile_store_close(const unsigned int storeId)
+{
+  EvoIRTileStore* store = g_tileStores.remove(storeId);
+  if(!store) return -1;
+  delete store;
+  return 0;
+}
+
+int evo_irimager_tile_store_get_info(const unsigned int storeId, EvoIRTileStoreInfo* info)
+{
+  TileStoreRef store = g_tileStores.acquire(storeId);
+  if(!store || !info) return -1;
+  store->info(info);
+  return 0;
+}
+
+int evo_irimager_tile_store_find_time(const unsigned int storeId, long long timestamp, unsigned long long* index)
+{
+  TileStoreRef store = g_tileStores.acquire(storeId);
+  if(!store || !index) return -1;
+  *index = store->findTime(timestamp);
+  return 0;
+}
+
+int evo_irimager_tile_store_read_patch(const unsigned int storeId, int x, int y, int w, int h, unsigned long long first, unsigned long long count,
+                                       unsigned short* data, long long* timestamps)
+{
+  TileStoreRef store = g_tileStores.acquire(storeId);
+  if(!store || !data || !store->validPatch(x, y, w, h, first, count)) return -1;
+  return store->readPatch(x, y, w, h, first, count, data, timestamps) ? 0 : -1;
+}
+
+int evo_irimager_tile_store_patch_history(const unsigned int storeId, int x, int y, int w, int h, unsigned long long first, unsigned long long count,
+                                          EvoIRPatchSample* samples)
+{
+  TileStoreRef store = g_tileStores.acquire(storeId);
+  if(!store || !samples || !store->validPatch(x, y, w, h, first, count)) return -1;
+  return store->patchHistory(x, y, w, h, first, count, samples) ? 0 : -1;
+}
+
+int evo_irimager_tile_store_find_range(const unsigned int storeId, int x, int y, int w, int h, unsigned long long first, unsigned long long count,
+                                       unsigned short rawMin, unsigned short rawMax, EvoIRFrameRun* runs, unsigned int maxRuns,
+                                       unsigned int* runCount, unsigned int* skippedBlocks)
+{
+  TileStoreRef store = g_tileStores.acquire(storeId);
+  if(!store || (!runs && maxRuns > 0) || !runCount || rawMax < rawMin || !store->validPatch(x, y, w, h, first, count)) return -1;
+  return store->findRange(x, y, w, h, first, count, rawMin, rawMax, runs, maxRuns, runCount, skippedBlocks) ? 0 : -1;
+}
@@ -0,0 +1,203 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRTileStore.h
+ * @brief Provides a pixel history store of thermal images for Easy API C-Library Interface
+ *
+ * Recordings (see EvoIRRecording.h) store frame after frame, so the history of
+ * a single pixel touches every frame. The tile store keeps the same raw values
+ * in a second layout for trend queries: frames are grouped into blocks of
+ * blockFrames, and each block is divided into square tiles of tileSize pixels.
+ * Within a tile the values of a pixel are stored consecutively for all frames
+ * of the block, compressed without loss. The history of a pixel or patch thus
+ * consists of a few short reads per block, and only the pixels of the patch
+ * are decoded. Every tile of a block carries the minimum and maximum of its
+ * values, so searches for values in a range skip blocks that cannot contain
+ * them.
+ *
+ * The tile recorder is fed frame by frame like evo_irimager_recorder_write_frame,
+ * e.g. next to a recording. Blocks are transposed and written by a background
+ * thread, the caller only copies the frame. Files use the extension .evotile.
+ *
+ * @code
+ * evo_irimager_tile_recorder_open(&tileId, "C:/rec/line.evotile", w, h, 27.f, 16, 128);
+ * // for every frame
+ * evo_irimager_tile_recorder_write_frame(tileId, data, &metadata);
+ * evo_irimager_tile_recorder_close(tileId);
+ *
+ * evo_irimager_tile_store_open(&storeId, "C:/rec/line.evotile");
+ * evo_irimager_tile_store_patch_history(storeId, 100, 80, 10, 10, 0, info.frames, samples);
+ * @endcode
+ */
+
+#ifndef EVOIRTILESTORE_H_
+#define EVOIRTILESTORE_H_
+
+#include "irdirectsdk_defs.h"
+#include "EvoIRFrameMetadata.h"
+#include "EvoIRRecordingMap.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+typedef struct __IRDIRECTSDK_API__ EvoIRTileStoreInfo
+{
+  int width;                     /*!< Image width */
+  int height;                    /*!< Image height */
+  float framerate;               /*!< Frame rate given on creation */
+  int tileSize;                  /*!< Edge length of tiles in pixels */
+  unsigned int blockFrames;      /*!< Frames per block */
+  unsigned long long frames;     /*!< Number of frames */
+  unsigned int blocks;           /*!< Number of blocks */
+  long long timestampFirst;      /*!< EvoIRFrameMetadata::timestamp of first frame */
+  long long timestampLast;       /*!< EvoIRFrameMetadata::timestamp of last frame */
+  int recovered;                 /*!< 1 if the store was not closed properly and has been recovered */
+} EvoIRTileStoreInfo;
+
+/**
+ * @brief Statistics of a patch in one frame
+ */
+typedef struct __IRDIRECTSDK_API__ EvoIRPatchSample
+{
+  long long timestamp;           /*!< EvoIRFrameMetadata::timestamp of the frame */
+  unsigned short min;            /*!< Minimum raw value */
+  unsigned short max;            /*!< Maximum raw value */
+  float mean;                    /*!< Mean raw value */
+} EvoIRPatchSample;
+
+/**
+ * @brief Creates a tile store file
+ * @param[out] outTileId tile recorder instance id for reference
+ * @param[in] path path of file, existing files are overwritten
+ * @param[in] w image width
+ * @param[in] h image height
+ * @param[in] framerate frame rate in Hz, stored for information
+ * @param[in] tileSize edge length of tiles in pixels [4; 64], 16 recommended
+ * @param[in] blockFrames frames per block [16; 4096], 128 recommended. Two blocks of frames are buffered in memory.
+ * @return 0 on success, -1 on error or if a block of this geometry could exceed 4 GiB
+ */
+__IRDIRECTSDK_API__ int evo_irimager_tile_recorder_open(unsigned int* outTileId, const char* path, int w, int h, float framerate, int tileSize, unsigned int blockFrames);
+
+/**
+ * @brief Appends a frame. Waits only if the background thread is still busy with the block before the previous one.
+ * @param[in] tileId tile recorder instance id from open to apply this function
+ * @param[in] data thermal image (size of w * h)
+ * @param[in] metadata frame metadata, the timestamp is stored
+ * @return 0 on success, -1 on error (write error of an earlier block)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_tile_recorder_write_frame(const unsigned int tileId, const unsigned short* data, const EvoIRFrameMetadata* metadata);
+
+/**
+ * @brief Writes the pending frames as a last, shorter block and the block index, then closes the file
+ * @param[in] tileId tile recorder instance id from open to apply this function
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_tile_recorder_close(const unsigned int tileId);
+
+/**
+ * @brief Creates a tile store from a recording
+ * @param[in] recordingPath path of recording
+ * @param[in] path path of tile store file
+ * @param[in] tileSize edge length of tiles in pixels [4; 64]
+ * @param[in] blockFrames frames per block [16; 4096]
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_tile_store_build(const char* recordingPath, const char* path, int tileSize, unsigned int blockFrames);
+
+/**
+ * @brief Opens a tile store for queries. Queries do not modify the instance and may be called from several threads.
+ * @param[out] outStoreId tile store instance id for reference
+ * @param[in] path path of tile store file
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_tile_store_open(unsigned int* outStoreId, const char* path);
+
+/**
+ * @brief Closes a tile store
+ * @param[in] storeId tile store instance id from open to apply this function
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_tile_store_close(const unsigned int storeId);
+
+/**
+ * @brief Accessor to tile store properties
+ * @param[in] storeId tile store instance id from open to apply this function
+ * @param[out] info pointer to EvoIRTileStoreInfo allocate by the user
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_tile_store_get_info(const unsigned int storeId, EvoIRTileStoreInfo* info);
+
+/**
+ * @brief Finds the first frame captured at or after a point in time
+ * @param[in] storeId tile store instance id from open to apply this function
+ * @param[in] timestamp time in UNITS (10000000 per second), see EvoIRFrameMetadata::timestamp
+ * @param[out] index frame index, number of frames if all frames are older
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_tile_store_find_time(const unsigned int storeId, long long timestamp, unsigned long long* index);
+
+/**
+ * @brief Reads the raw values of a patch for a range of frames
+ * @param[in] storeId tile store instance id from open to apply this function
+ * @param[in] x left column of patch
+ * @param[in] y top row of patch
+ * @param[in] w patch width
+ * @param[in] h patch height
+ * @param[in] first index of first frame
+ * @param[in] count number of frames
+ * @param[out] data pointer to unsigned short array allocate by the user (size of w * h * count),
+ * the history of pixel (x + i, y + j) starts at data[(j * w + i) * count]
+ * @param[out] timestamps pointer to long long array allocate by the user (size of count), may be NULL
+ * @return 0 on success, -1 on error (patch outside of image, frame range outside of store, corrupt block)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_tile_store_read_patch(const unsigned int storeId, int x, int y, int w, int h, unsigned long long first, unsigned long long count,
+                                                           unsigned short* data, long long* timestamps);
+
+/**
+ * @brief Computes minimum, maximum and mean of a patch for each frame of a range
+ * @param[in] storeId tile store instance id from open to apply this function
+ * @param[in] x left column of patch
+ * @param[in] y top row of patch
+ * @param[in] w patch width
+ * @param[in] h patch height
+ * @param[in] first index of first frame
+ * @param[in] count number of frames
+ * @param[out] samples pointer to EvoIRPatchSample array allocate by the user (size of count)
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_tile_store_patch_history(const unsigned int storeId, int x, int y, int w, int h, unsigned long long first, unsigned long long count,
+                                                              EvoIRPatchSample* samples);
+
+/**
+ * @brief Finds the frames in which at least one pixel of a patch lies within [rawMin; rawMax].
+ * Blocks whose tile summaries exclude the range are skipped without decoding.
+ * @param[in] storeId tile store instance id from open to apply this function
+ * @param[in] x left column of patch
+ * @param[in] y top row of patch
+ * @param[in] w patch width
+ * @param[in] h patch height
+ * @param[in] first index of first frame
+ * @param[in] count number of frames
+ * @param[in] rawMin lower bound of raw values (inclusive)
+ * @param[in] rawMax upper bound of raw values (inclusive)
+ * @param[out] runs pointer to EvoIRFrameRun array allocate by the user, consecutive matching frames ordered by index
+ * @param[in] maxRuns size of runs
+ * @param[out] runCount number of runs found, may exceed maxRuns, in which case only maxRuns are stored
+ * @param[out] skippedBlocks number of blocks skipped by their summaries, may be NULL
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_tile_store_find_range(const unsigned int storeId, int x, int y, int w, int h, unsigned long long first, unsigned long long count,
+                                                           unsigned short rawMin, unsigned short rawMax, EvoIRFrameRun* runs, unsigned int maxRuns,
+                                                           unsigned int* runCount, unsigned int* skippedBlocks);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* EVOIRTILESTORE_H_ */
@@ -0,0 +1,141 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRTransportProtocol.h
+ * @brief Wire format and shared memory layout of the frame transport
+ *
+ * Internal header, only used by the implementation files of the Easy API
+ * extensions.
+ *
+ * Connection setup:
+ *   client -> server  TransportHello
+ *   server -> client  TransportWelcome (shared memory offered if flagged)
+ *   client -> server  TransportReady (shared memory in use if flagged)
+ * Afterwards the server sends TransportBatch headers. Without shared memory
+ * each header is followed by the frames of the batch, each consisting of a
+ * TransportFrameHeader and w * h image words. With shared memory the batch
+ * only announces the sequence numbers firstSeq ... firstSeq + frames - 1,
+ * stored in slot (seq % slots) of the segment.
+ *
+ * Shared memory slots are guarded by a sequence lock: the server sets the
+ * slot sequence to SHARED_SLOT_WRITING while writing. A reader copies the
+ * slot and accepts the copy if the sequence was the expected one before and
+ * after copying.
+ */
+
+#ifndef EVOIRTRANSPORTPROTOCOL_H_
+#define EVOIRTRANSPORTPROTOCOL_H_
+
+#include "EvoIRFrameMetadata.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+
+namespace evo
+{
+
+const unsigned int TRANSPORT_HELLO_MAGIC   = 0x48545645; // 'EVTH'
+const unsigned int TRANSPORT_WELCOME_MAGIC = 0x57545645; // 'EVTW'
+const unsigned int TRANSPORT_READY_MAGIC   = 0x52545645; // 'EVTR'
+const unsigned int TRANSPORT_BATCH_MAGIC   = 0x42545645; // 'EVTB'
+const unsigned int TRANSPORT_VERSION       = 1;
+const unsigned int TRANSPORT_FLAG_SHARED   = 1;
+
+const unsigned int SHARED_MAGIC                = 0x4D485345; // 'ESHM'
+const unsigned long long SHARED_SLOT_WRITING   = ~0ULL;
+
+struct TransportHello
+{
+  unsigned int magic;
+  unsigned int version;
+  unsigned int flags;
+  unsigned int reserved;
+};
+
+struct TransportWelcome
+{
+  unsigned int magic;
+  unsigned int version;
+  int width;
+  int height;
+  unsigned int flags;
+  unsigned int sharedSlots;
+  unsigned long long sharedSize;
+  char sharedName[64];
+};
+
+struct TransportReady
+{
+  unsigned int magic;
+  unsigned int flags;
+};
+
+struct TransportBatch
+{
+  unsigned int magic;
+  unsigned int frames;
+  unsigned long long firstSeq;
+};
+
+struct TransportFrameHeader
+{
+  unsigned long long seq;
+  long long publishTime;
+  EvoIRFrameMetadata metadata;
+};
+
+struct SharedHeader
+{
+  unsigned int magic;
+  unsigned int version;
+  int width;
+  int height;
+  unsigned int slots;
+  unsigned int reserved;
+  unsigned long long slotSize;
+  std::atomic<unsigned long long> published;
+  char pad[24];
+};
+
+struct SharedSlot
+{
+  std::atomic<unsigned long long> seq;
+  long long publishTime;
+  EvoIRFrameMetadata metadata;
+  // image data follows
+};
+
+inline size_t sharedSlotSize(int w, int h)
+{
+  return (sizeof(SharedSlot) + (size_t)w * h * sizeof(unsigned short) + 63) & ~(size_t)63;
+}
+
+inline SharedSlot* sharedSlot(void* base, unsigned long long seq)
+{
+  const SharedHeader* header = (const SharedHeader*)base;
+  return (SharedSlot*)((char*)base + sizeof(SharedHeader) + (size_t)(seq % header->slots) * header->slotSize);
+}
+
+inline unsigned short* sharedSlotData(SharedSlot* slot)
+{
+  return (unsigned short*)(slot + 1);
+}
+
+/**
+ * @brief Monotonic time in UNITS (10000000 per second), comparable between processes of one host
+ */
+inline long long transportTime()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+           std::chrono::steady_clock::now().time_since_epoch()).count() * 10LL;
+}
+
+} // namespace evo
+
+#endif /* EVOIRTRANSPORTPROTOCOL_H_ */
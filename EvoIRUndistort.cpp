@@ -0,0 +1,437 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRUndistort.cpp
+ * @brief Remap table of a Brown-Conrady lens model and bilinear resampling kernels
+ *
+ * The table is kept as three arrays per output pixel: offset of the top left
+ * source pixel, weights of the top pair and weights of the bottom pair (two
+ * 16 bit values each, summing up to 2^14 over all four). A thermal pixel is
+ * then two 32 bit loads of adjacent source pixels and two multiply-adds.
+ * Since pmaddwd multiplies signed values, raw values are biased by -32768
+ * first and the bias is added back after the shift, which yields exactly
+ * (sum + 2^13) >> 14 of the plain C++ kernel. Vector kernels build their
+ * registers from scalar loads instead of gather instructions, which are not
+ * faster for 32 bit elements on most processors.
+ */
+
+#include "EvoIRUndistort.h"
+#include "EvoIRHandleTable.h"
+#include "EvoIRRecording.h"
+#include "EvoIRRemap.h"
+#include "EvoIRSimd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace evo
+{
+
+namespace
+{
+
+const int FRAC_BITS     = REMAP_FRAC_BITS;
+const int FRAC_ONE      = REMAP_FRAC_ONE;
+const int WEIGHT_BITS   = 2 * FRAC_BITS;     // weights sum up to 2^14
+const int WEIGHT_ROUND  = 1 << (WEIGHT_BITS - 1);
+const int BLOCK_ROWS    = 8;                 // table rows applied to all images of a batch
+const unsigned int RECORDING_BATCH = 16;
+
+// pair of adjacent source values as one 32 bit lane
+int load2x16(const unsigned short* p)
+{
+  int v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+//------------------------------------------------------------------------------
+// plain C++
+//------------------------------------------------------------------------------
+
+void thermalScalar(const unsigned short* src, size_t stride, const unsigned int* offset, const unsigned int* wTop, const unsigned int* wBottom, size_t n, unsigned short* out)
+{
+  for(size_t i = 0; i < n; i++)
+  {
+    const unsigned short* p = src + offset[i];
+    const unsigned int t = wTop[i];
+    const unsigned int b = wBottom[i];
+    const unsigned int s = (t & 0xffff) * p[0] + (t >> 16) * p[1] + (b & 0xffff) * p[stride] + (b >> 16) * p[stride + 1];
+    out[i] = (unsigned short)((s + WEIGHT_ROUND) >> WEIGHT_BITS);
+  }
+}
+
+void rgbPixel(const unsigned char* src, size_t stride, unsigned int offset, unsigned int t, unsigned int b, unsigned char* out)
+{
+  const unsigned char* top    = src + 3 * (size_t)offset;
+  const unsigned char* bottom = top + 3 * stride;
+  for(int c = 0; c < 3; c++)
+  {
+    const unsigned int s = (t & 0xffff) * top[c] + (t >> 16) * top[c + 3] + (b & 0xffff) * bottom[c] + (b >> 16) * bottom[c + 3];
+    out[c] = (unsigned char)((s + WEIGHT_ROUND) >> WEIGHT_BITS);
+  }
+}
+
+void rgbScalar(const unsigned char* src, size_t stride, size_t, const unsigned int* offset, const unsigned int* wTop, const unsigned int* wBottom, size_t n, unsigned char* out)
+{
+  for(size_t i = 0; i < n; i++)
+    rgbPixel(src, stride, offset[i], wTop[i], wBottom[i], out + 3 * i);
+}
+
+#if EVO_SIMD_X86
+
+//------------------------------------------------------------------------------
+// SSE4.1
+//------------------------------------------------------------------------------
+
+EVO_TARGET_SSE41 void thermalSse41(const unsigned short* src, size_t stride, const unsigned int* offset, const unsigned int* wTop, const unsigned int* wBottom, size_t n, unsigned short* out)
+{
+  const __m128i bias  = _mm_set1_epi32((int)0x80008000);
+  const __m128i round = _mm_set1_epi32(WEIGHT_ROUND);
+  const __m128i back  = _mm_set1_epi32(32768);
+  size_t i = 0;
+  for(; i + 4 <= n; i += 4)
+  {
+    const unsigned short* p0 = src + offset[i];
+    const unsigned short* p1 = src + offset[i + 1];
+    const unsigned short* p2 = src + offset[i + 2];
+    const unsigned short* p3 = src + offset[i + 3];
+    const __m128i t = _mm_setr_epi32(load2x16(p0), load2x16(p1), load2x16(p2), load2x16(p3));
+    const __m128i b = _mm_setr_epi32(load2x16(p0 + stride), load2x16(p1 + stride), load2x16(p2 + stride), load2x16(p3 + stride));
+    __m128i s = _mm_add_epi32(_mm_madd_epi16(_mm_xor_si128(t, bias), _mm_loadu_si128((const __m128i*)(wTop + i))),
+                              _mm_madd_epi16(_mm_xor_si128(b, bias), _mm_loadu_si128((const __m128i*)(wBottom + i))));
+    s = _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(s, round), WEIGHT_BITS), back);
+    _mm_storel_epi64((__m128i*)(out + i), _mm_packus_epi32(s, s));
+  }
+  thermalScalar(src, stride, offset + i, wTop + i, wBottom + i, n - i, out + i);
+}
+
+// 8 bytes are loaded per source pair, pixels at the very end of the image take the plain C++ path
+EVO_TARGET_SSE41 void rgbSse41(const unsigned char* src, size_t stride, size_t pixels, const unsigned int* offset, const unsigned int* wTop, const unsigned int* wBottom, size_t n, unsigned char* out)
+{
+  const __m128i pairs = _mm_setr_epi8(0, -1, 3, -1, 1, -1, 4, -1, 2, -1, 5, -1, -1, -1, -1, -1);
+  const __m128i round = _mm_set1_epi32(WEIGHT_ROUND);
+  for(size_t i = 0; i < n; i++)
+  {
+    if(offset[i] + stride + 3 > pixels)
+    {
+      rgbPixel(src, stride, offset[i], wTop[i], wBottom[i], out + 3 * i);
+      continue;
+    }
+    const unsigned char* top = src + 3 * (size_t)offset[i];
+    const __m128i t = _mm_shuffle_epi8(_mm_loadl_epi64((const __m128i*)top), pairs);
+    const __m128i b = _mm_shuffle_epi8(_mm_loadl_epi64((const __m128i*)(top + 3 * stride)), pairs);
+    __m128i s = _mm_add_epi32(_mm_madd_epi16(t, _mm_set1_epi32((int)wTop[i])), _mm_madd_epi16(b, _mm_set1_epi32((int)wBottom[i])));
+    s = _mm_srli_epi32(_mm_add_epi32(s, round), WEIGHT_BITS);
+    s = _mm_packus_epi16(_mm_packus_epi32(s, s), s);
+    const int rgb = _mm_cvtsi128_si32(s);
+    std::memcpy(out + 3 * i, &rgb, 3);
+  }
+}
+
+//------------------------------------------------------------------------------
+// AVX2
+//------------------------------------------------------------------------------
+
+// two pixels per iteration, one per lane with top and bottom pair in the low and high half
+EVO_TARGET_AVX2 void rgbAvx2(const unsigned char* src, size_t stride, size_t pixels, const unsigned int* offset, const unsigned int* wTop, const unsigned int* wBottom, size_t n, unsigned char* out)
+{
+  const __m256i topPairs    = _mm256_setr_epi8(0, -1, 3, -1, 1, -1, 4, -1, 2, -1, 5, -1, -1, -1, -1, -1,
+                                               0, -1, 3, -1, 1, -1, 4, -1, 2, -1, 5, -1, -1, -1, -1, -1);
+  const __m256i bottomPairs = _mm256_setr_epi8(8, -1, 11, -1, 9, -1, 12, -1, 10, -1, 13, -1, -1, -1, -1, -1,
+                                               8, -1, 11, -1, 9, -1, 12, -1, 10, -1, 13, -1, -1, -1, -1, -1);
+  const __m256i spread = _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1);
+  const __m256i round  = _mm256_set1_epi32(WEIGHT_ROUND);
+  size_t i = 0;
+  for(; i + 2 <= n; i += 2)
+  {
+    if(offset[i] + stride + 3 > pixels || offset[i + 1] + stride + 3 > pixels)
+    {
+      rgbPixel(src, stride, offset[i], wTop[i], wBottom[i], out + 3 * i);
+      rgbPixel(src, stride, offset[i + 1], wTop[i + 1], wBottom[i + 1], out + 3 * i + 3);
+      continue;
+    }
+    const unsigned char* top0 = src + 3 * (size_t)offset[i];
+    const unsigned char* top1 = src + 3 * (size_t)offset[i + 1];
+    const __m128i v0 = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)top0), _mm_loadl_epi64((const __m128i*)(top0 + 3 * stride)));
+    const __m128i v1 = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)top1), _mm_loadl_epi64((const __m128i*)(top1 + 3 * stride)));
+    const __m256i v  = _mm256_inserti128_si256(_mm256_castsi128_si256(v0), v1, 1);
+    const __m256i t  = _mm256_permutevar8x32_epi32(_mm256_castsi128_si256(_mm_loadl_epi64((const __m128i*)(wTop + i))), spread);
+    const __m256i b  = _mm256_permutevar8x32_epi32(_mm256_castsi128_si256(_mm_loadl_epi64((const __m128i*)(wBottom + i))), spread);
+    __m256i s = _mm256_add_epi32(_mm256_madd_epi16(_mm256_shuffle_epi8(v, topPairs), t),
+                                 _mm256_madd_epi16(_mm256_shuffle_epi8(v, bottomPairs), b));
+    s = _mm256_srli_epi32(_mm256_add_epi32(s, round), WEIGHT_BITS);
+    s = _mm256_packus_epi16(_mm256_packus_epi32(s, s), s);
+    const int rgb0 = _mm_cvtsi128_si32(_mm256_castsi256_si128(s));
+    const int rgb1 = _mm_cvtsi128_si32(_mm256_extracti128_si256(s, 1));
+    std::memcpy(out + 3 * i, &rgb0, 3);
+    std::memcpy(out + 3 * i + 3, &rgb1, 3);
+  }
+  rgbScalar(src, stride, pixels, offset + i, wTop + i, wBottom + i, n - i, out + 3 * i);
+}
+
+#endif // EVO_SIMD_X86
+
+} // namespace
+
+void remapThermal(const unsigned short* src, size_t stride, const unsigned int* offset, const unsigned int* wTop, const unsigned int* wBottom, size_t n, unsigned short* out)
+{
+#if EVO_SIMD_X86
+  // assembling eight scattered pairs per AVX2 register, by inserts or gathers, costs more than the
+  // wider multiply-add saves, so thermal images stay with SSE4.1
+  if(simdLevel() >= SIMD_SSE41) { thermalSse41(src, stride, offset, wTop, wBottom, n, out); return; }
+#endif
+  thermalScalar(src, stride, offset, wTop, wBottom, n, out);
+}
+
+void remapRgb(const unsigned char* src, size_t stride, size_t pixels, const unsigned int* offset, const unsigned int* wTop, const unsigned int* wBottom, size_t n, unsigned char* out)
+{
+#if EVO_SIMD_X86
+  const int level = simdLevel();
+  if(level >= SIMD_AVX2)  { rgbAvx2(src, stride, pixels, offset, wTop, wBottom, n, out); return; }
+  if(level >= SIMD_SSE41) { rgbSse41(src, stride, pixels, offset, wTop, wBottom, n, out); return; }
+#endif
+  rgbScalar(src, stride, pixels, offset, wTop, wBottom, n, out);
+}
+
+// source position in 1/128 pixel, split into the index of the left/top neighbour and the fraction
+// of the right/bottom one. The last column/row is addressed as fraction 1 of its predecessor.
+bool remapQuantize(double pos, int size, int* index, int* frac)
+{
+  if(!(pos >= 0.0 && pos <= size - 1)) return false;
+  const int q = (int)std::floor(pos * FRAC_ONE + 0.5);
+  *index = q >> FRAC_BITS;
+  *frac  = q & (FRAC_ONE - 1);
+  if(*index >= size - 1)
+  {
+    *index = size - 2;
+    *frac  = FRAC_ONE;
+  }
+  return true;
+}
+
+class EvoIRUndistort
+{
+public:
+  explicit EvoIRUndistort(const EvoIRUndistortParams& params) :
+    _params(params),
+    _pixels((size_t)params.width * params.height),
+    _offset(_pixels),
+    _wTop(_pixels),
+    _wBottom(_pixels)
+  {
+    const double zx = _params.fx * _params.zoom;
+    const double zy = _params.fy * _params.zoom;
+    size_t i = 0;
+    for(int v = 0; v < _params.height; v++)
+    {
+      for(int u = 0; u < _params.width; u++, i++)
+      {
+        const double x  = (u - _params.cx) / zx;
+        const double y  = (v - _params.cy) / zy;
+        const double r2 = x * x + y * y;
+        const double radial = 1.0 + r2 * (_params.k1 + r2 * (_params.k2 + r2 * _params.k3));
+        const double xd = x * radial + 2.0 * _params.p1 * x * y + _params.p2 * (r2 + 2.0 * x * x);
+        const double yd = y * radial + _params.p1 * (r2 + 2.0 * y * y) + 2.0 * _params.p2 * x * y;
+
+        int x0, y0, ax, ay;
+        if(!remapQuantize(_params.fx * xd + _params.cx, _params.width, &x0, &ax) || !remapQuantize(_params.fy * yd + _params.cy, _params.height, &y0, &ay))
+        {
+          // reads the first source pixel with full weight, overwritten with the border value afterwards
+          _offset[i]  = 0;
+          _wTop[i]    = remapPack(FRAC_ONE * FRAC_ONE, 0);
+          _wBottom[i] = 0;
+          _border.push_back((unsigned int)i);
+          continue;
+        }
+        _offset[i]  = (unsigned int)(y0 * _params.width + x0);
+        _wTop[i]    = remapPack((FRAC_ONE - ax) * (FRAC_ONE - ay), ax * (FRAC_ONE - ay));
+        _wBottom[i] = remapPack((FRAC_ONE - ax) * ay, ax * ay);
+      }
+    }
+  }
+
+  bool source(int x, int y, float* sx, float* sy) const
+  {
+    const size_t i = (size_t)y * _params.width + x;
+    const unsigned int t = _wTop[i];
+    const unsigned int b = _wBottom[i];
+    // fractions follow from the weights of the right column and the bottom row
+    const int ax = (int)((t >> 16) + (b >> 16)) >> FRAC_BITS;
+    const int ay = (int)((b & 0xffff) + (b >> 16)) >> FRAC_BITS;
+    *sx = (float)(_offset[i] % _params.width) + (float)ax / FRAC_ONE;
+    *sy = (float)(_offset[i] / _params.width) + (float)ay / FRAC_ONE;
+    return !isBorder(i);
+  }
+
+  void thermalImages(const unsigned short* data, unsigned int count, unsigned short* out) const
+  {
+    const size_t w = _params.width;
+    for(int row = 0; row < _params.height; row += BLOCK_ROWS)
+    {
+      const size_t begin = row * w;
+      const size_t n     = (size_t)((row + BLOCK_ROWS < _params.height) ? BLOCK_ROWS : _params.height - row) * w;
+      for(unsigned int k = 0; k < count; k++)
+        remapThermal(data + k * _pixels, w, &_offset[begin], &_wTop[begin], &_wBottom[begin], n, out + k * _pixels + begin);
+    }
+    for(unsigned int k = 0; k < count; k++)
+    {
+      unsigned short* image = out + k * _pixels;
+      for(size_t j = 0; j < _border.size(); j++)
+        image[_border[j]] = _params.border;
+    }
+  }
+
+  void paletteImage(const unsigned char* data, unsigned char* out) const
+  {
+    remapRgb(data, _params.width, _pixels, &_offset[0], &_wTop[0], &_wBottom[0], _pixels, out);
+    for(size_t j = 0; j < _border.size(); j++)
+      std::memset(out + 3 * (size_t)_border[j], 0, 3);
+  }
+
+  int recording(const char* path, const char* outPath, int compress) const
+  {
+    unsigned int inId;
+    if(evo_irimager_recording_open(&inId, path) != 0) return -1;
+    EvoIRRecordingInfo info;
+    unsigned int outId;
+    if(evo_irimager_recording_get_info(inId, &info) != 0
+       || info.width != _params.width || info.height != _params.height
+       || evo_irimager_recorder_open(&outId, outPath, info.width, info.height, info.framerate, compress) != 0)
+    {
+      evo_irimager_recording_close(inId);
+      return -1;
+    }
+
+    std::vector<unsigned short> in(_pixels * RECORDING_BATCH);
+    std::vector<unsigned short> corrected(_pixels * RECORDING_BATCH);
+    std::vector<EvoIRFrameMetadata> metadata(RECORDING_BATCH);
+    int ret = 0;
+    for(unsigned long long index = 0; index < info.frames && ret == 0; index += RECORDING_BATCH)
+    {
+      const unsigned int count = (info.frames - index < RECORDING_BATCH) ? (unsigned int)(info.frames - index) : RECORDING_BATCH;
+      for(unsigned int k = 0; k < count && ret == 0; k++)
+      {
+        int w = info.width;
+        int h = info.height;
+        ret = evo_irimager_recording_read_frame(inId, index + k, &w, &h, &in[k * _pixels], &metadata[k]);
+      }
+      if(ret != 0) break;
+      thermalImages(&in[0], count, &corrected[0]);
+      for(unsigned int k = 0; k < count && ret == 0; k++)
+        ret = evo_irimager_recorder_write_frame(outId, &corrected[k * _pixels], &metadata[k]);
+    }
+    if(evo_irimager_recorder_close(outId) != 0) ret = -1;
+    evo_irimager_recording_close(inId);
+    return ret == 0 ? 0 : -1;
+  }
+
+  const EvoIRUndistortParams& params() const { return _params; }
+
+private:
+  EvoIRUndistort(const EvoIRUndistort&);
+  EvoIRUndistort& operator=(const EvoIRUndistort&);
+
+  bool isBorder(size_t i) const
+  {
+    return std::binary_search(_border.begin(), _border.end(), (unsigned int)i);
+  }
+
+  const EvoIRUndistortParams _params;
+  const size_t _pixels;
+  std::vector<unsigned int> _offset;
+  std::vector<unsigned int> _wTop;
+  std::vector<unsigned int> _wBottom;
+  std::vector<unsigned int> _border;  // ascending output indices without source
+};
+
+static EvoIRHandleTable<EvoIRUndistort> g_correctors;
+typedef EvoIRHandleTable<EvoIRUndistort>::Ref CorrectorRef;
+
+} // namespace evo
+
+using namespace evo;
+
+void evo_irimager_undistort_default_params(EvoIRUndistortParams* params, int w, int h)
+{
+  if(!params) return;
+  params->width  = w;
+  params->height = h;
+  params->fx     = w;
+  params->fy     = w;
+  params->cx     = 0.5 * (w - 1);
+  params->cy     = 0.5 * (h - 1);
+  params->k1     = 0.0;
+  params->k2     = 0.0;
+  params->k3     = 0.0;
+  params->p1     = 0.0;
+  params->p2     = 0.0;
+  params->zoom   = 1.0;
+  params->border = 0;
+}
+
+int evo_irimager_undistort_create(unsigned int* outUndistId, const EvoIRUndistortParams* params)
+{
+  if(!outUndistId || !params || params->width < 2 || params->height < 2) return -1;
+  // offsets are 32 bit, positions in 1/128 pixel must fit into int
+  if((unsigned long long)params->width * params->height > 0xffffffffULL || params->width > (1 << 23) || params->height > (1 << 23)) return -1;
+  if(!(params->fx > 0.0) || !(params->fy > 0.0) || !(params->zoom > 0.0)) return -1;
+  EvoIRUndistort* corrector = new EvoIRUndistort(*params);
+  if(!g_correctors.insert(corrector, outUndistId))
+  {
+    delete corrector;
+    return -1;
+  }
+  return 0;
+}
+
+int evo_irimager_undistort_destroy(const unsigned int undistId)
+{
+  EvoIRUndistort* corrector = g_correctors.remove(undistId);
+  if(!corrector) return -1;
+  delete corrector;
+  return 0;
+}
+
+int evo_irimager_undistort_get_source(const unsigned int undistId, int x, int y, float* sx, float* sy)
+{
+  CorrectorRef corrector = g_correctors.acquire(undistId);
+  if(!corrector || !sx || !sy) return -1;
+  if(x < 0 || y < 0 || x >= corrector->params().width || y >= corrector->params().height) return -1;
+  return corrector->source(x, y, sx, sy) ? 0 : 1;
+}
+
+int evo_irimager_undistort_thermal(const unsigned int undistId, const unsigned short* data, unsigned short* out)
+{
+  return evo_irimager_undistort_thermal_batch(undistId, data, 1, out);
+}
+
+int evo_irimager_undistort_thermal_batch(const unsigned int undistId, const unsigned short* data, unsigned int count, unsigned short* out)
+{
+  CorrectorRef corrector = g_correctors.acquire(undistId);
+  if(!corrector || !data || !out) return -1;
+  corrector->thermalImages(data, count, out);
+  return 0;
+}
+
+int evo_irimager_undistort_palette(const unsigned int undistId, const unsigned char* data, unsigned char* out)
+{
+  CorrectorRef corrector = g_correctors.acquire(undistId);
+  if(!corrector || !data || !out) return -1;
+  corrector->paletteImage(data, out);
+  return 0;
+}
+
+int evo_irimager_undistort_recording(const unsigned int undistId, const char* path, const char* outPath, int compress)
+{
+  CorrectorRef corrector = g_correctors.acquire(undistId);
+  if(!corrector || !path || !outPath) return -1;
+  return corrector->recording(path, outPath, compress);
+}
@@ -0,0 +1,130 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRUndistort.h
+ * @brief Provides lens distortion correction of thermal and palette images
+ *
+ * Alternative to <radial_distortion_correction> of the configuration file,
+ * which is applied inside the library to live images only. With this module
+ * the correction is done on demand, e.g. to recorded raw frames, with the
+ * lens model given explicitly (Brown-Conrady with three radial and two
+ * tangential coefficients, as estimated by common calibration tools).
+ *
+ * The model is evaluated once per image format when the corrector is
+ * created: every output pixel stores the offset of its top left source
+ * pixel and the bilinear weights of the four neighbours, quantized to 1/128
+ * pixel and packed in pairs of 16 bit. Applying the table then only takes
+ * integer multiply-adds (SSE4.1 for thermal images, SSE4.1/AVX2 for palette
+ * images, selected at runtime, see evo_irimager_set_simd_level) and yields the same result on every code path.
+ * Output pixels mapped outside of the source image are set to the border
+ * value.
+ */
+
+#ifndef EVOIRUNDISTORT_H_
+#define EVOIRUNDISTORT_H_
+
+#include "irdirectsdk_defs.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+typedef struct __IRDIRECTSDK_API__ EvoIRUndistortParams
+{
+  int width;             /*!< Image width */
+  int height;            /*!< Image height */
+  double fx;             /*!< Focal length in pixels, horizontal */
+  double fy;             /*!< Focal length in pixels, vertical */
+  double cx;             /*!< Principal point in pixels, horizontal */
+  double cy;             /*!< Principal point in pixels, vertical */
+  double k1;             /*!< Radial coefficients */
+  double k2;
+  double k3;
+  double p1;             /*!< Tangential coefficients */
+  double p2;
+  double zoom;           /*!< Focal length of the corrected image relative to fx/fy, values > 1 crop the border */
+  unsigned short border; /*!< Raw value of thermal output pixels without source, palette images get black */
+} EvoIRUndistortParams;
+
+/**
+ * @brief Fills parameter structure with a distortion free model (principal point in the image center, focal length of the image width, no zoom, border 0)
+ * @param[out] params parameter structure
+ * @param[in] w image width
+ * @param[in] h image height
+ */
+__IRDIRECTSDK_API__ void evo_irimager_undistort_default_params(EvoIRUndistortParams* params, int w, int h);
+
+/**
+ * @brief Builds the remap table of an image format
+ * @param[out] outUndistId corrector instance id for reference
+ * @param[in] params lens model and image size (at least 2 x 2)
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_undistort_create(unsigned int* outUndistId, const EvoIRUndistortParams* params);
+
+/**
+ * @brief Releases a corrector
+ * @param[in] undistId corrector instance id from create to apply this function
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_undistort_destroy(const unsigned int undistId);
+
+/**
+ * @brief Accessor to the source position of an output pixel as stored in the table, e.g. to check a model
+ * @param[in] undistId corrector instance id from create to apply this function
+ * @param[in] x output column
+ * @param[in] y output row
+ * @param[out] sx source column
+ * @param[out] sy source row
+ * @return 0 on success, 1 if the pixel has no source (border), -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_undistort_get_source(const unsigned int undistId, int x, int y, float* sx, float* sy);
+
+/**
+ * @brief Corrects a thermal image
+ * @param[in] undistId corrector instance id from create to apply this function
+ * @param[in] data thermal image (size of width * height)
+ * @param[out] out pointer to unsigned short array allocate by the user (size of width * height), must not overlap data
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_undistort_thermal(const unsigned int undistId, const unsigned short* data, unsigned short* out);
+
+/**
+ * @brief Corrects consecutive thermal images. The table is traversed once in blocks of rows, each applied to all images, so it stays in cache.
+ * @param[in] undistId corrector instance id from create to apply this function
+ * @param[in] data thermal images (size of count * width * height)
+ * @param[in] count number of images
+ * @param[out] out pointer to unsigned short array allocate by the user (size of count * width * height), must not overlap data
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_undistort_thermal_batch(const unsigned int undistId, const unsigned short* data, unsigned int count, unsigned short* out);
+
+/**
+ * @brief Corrects an interleaved palette image (r,g,b or b,g,r, the channel order is kept)
+ * @param[in] undistId corrector instance id from create to apply this function
+ * @param[in] data palette image (size of 3 * width * height)
+ * @param[out] out pointer to unsigned char array allocate by the user (size of 3 * width * height), must not overlap data
+ * @return 0 on success, -1 on error
+ */
+__IRDIRECTSDK_API__ int evo_irimager_undistort_palette(const unsigned int undistId, const unsigned char* data, unsigned char* out);
+
+/**
+ * @brief Writes a corrected copy of a recording (see EvoIRRecording.h), metadata is kept
+ * @param[in] undistId corrector instance id from create to apply this function
+ * @param[in] path recording to read
+ * @param[in] outPath recording to create, an existing file is overwritten
+ * @param[in] compress 1: compress frames lossless, 0: store raw frames
+ * @return 0 on success, -1 on error (image size mismatch, read or write error)
+ */
+__IRDIRECTSDK_API__ int evo_irimager_undistort_recording(const unsigned int undistId, const char* path, const char* outPath, int compress);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* EVOIRUNDISTORT_H_ */
@@ -0,0 +1,110 @@
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+% Copyright (c) 2012-2020 All Rights Reserved, 
+% http://www.evocortex.com      
+% Evocortex GmbH                                                         
+% Emilienstr. 10                                                             
+% 90489 Nuremberg                                                        
+% Germany    
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+% Description: 
+% Builds the MEX gateway evo_irimager_mex (EvoIRMex.cpp)
+% used by EvoIRMatlabInterface instead of loadlibrary.
+%
+%   evo_irimager_mex_build          links libirimager
+%   evo_irimager_mex_build('stub')  links the synthetic
+%                                   stand-in of the library
+%                                   (EvoIRBindingStub.cpp)
+%                                   and checks the gateway
+%
+% A stub build has to be replaced by a library build
+% before connecting to a camera. On Windows the import
+% library libirimager.lib is used if present, otherwise
+% libirimager.dll is linked directly (MinGW only).
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+function evo_irimager_mex_build(target)
+    if nargin < 1
+        target = 'library';
+    end
+    
+    % the configuration manager and the pipeline of the Easy API extensions
+    % are compiled into the gateway
+    args = {'-output', 'evo_irimager_mex', 'EvoIRMex.cpp', 'EvoIRConfig.cpp', ...
+            'EvoIRPipeline.cpp', 'EvoIRTemporalFilter.cpp', ...
+            'EvoIRSyntheticSource.cpp', 'EvoIRPalette.cpp'};
+    if isunix
+        args = [args, {'CXXFLAGS=$CXXFLAGS -std=c++11', 'LDFLAGS=$LDFLAGS -pthread'}];
+    end
+    
+    switch target
+        case 'library'
+            if ispc
+                if exist('libirimager.lib', 'file')
+                    args = [args, {'libirimager.lib'}];
+                else
+                    args = [args, {'-L.', '-lirimager'}];
+                end
+            else
+                args = [args, {'-I/usr/include/libirimager', '-lirdirectsdk'}];
+            end
+        case 'stub'
+            args = [args, {'-DIRDIRECTSDK_STATIC=1', 'EvoIRBindingStub.cpp', ...
+                           'EvoIRFormatPlan.cpp', 'EvoIRRecording.cpp'}];
+        otherwise
+            error('unknown target %s, use library or stub', target);
+    end
+    
+    clear evo_irimager_mex;                     % release a loaded gateway
+    mex(args{:});
+    
+    if strcmp(target, 'stub')
+        check_stub();
+    end
+end
+
+%% Exercises all image paths against the stand-in of the library
+function check_stub()
+    assert(evo_irimager_mex('usb_init', 'generic.xml') == 0, 'init failed');
+    cleanup = onCleanup(@() evo_irimager_mex('terminate'));
+    [w, h] = evo_irimager_mex('get_thermal_image_size');
+    
+    [THM, meta, ret] = evo_irimager_mex('get_thermal');
+    assert(ret == 0 && isa(THM, 'uint16') && isequal(size(THM), [h w]), 'thermal image');
+    % the synthetic scene gets warmer from left to right
+    assert(median(double(THM(:, end))) > median(double(THM(:, 1))), 'thermal image orientation');
+    
+    [THM, RGB, meta2, ret] = evo_irimager_mex('get_thermal_palette');
+    assert(ret == 0 && isequal(size(THM), [h w]), 'thermal image of thermal/palette pair');
+    assert(isa(RGB, 'uint8') && isequal(size(RGB), [h w 3]), 'palette image');
+    assert(meta2.counter == meta.counter + 1, 'frame counter');
+    
+    % gray palette: three equal channels
+    assert(evo_irimager_mex('set_palette', 3) == 0, 'set palette');
+    RGB = evo_irimager_mex('get_palette');
+    assert(isequal(RGB(:, :, 1), RGB(:, :, 2), RGB(:, :, 3)), 'palette channels');
+    
+    [STACK, meta, ret] = evo_irimager_mex('grab', 8);
+    assert(ret == 0 && isequal(size(STACK), [h w 8]), 'frame stack');
+    assert(all(diff(double(meta.counter)) == 1), 'frame stack counters');
+    
+    % frames of the pipeline, the gateway keeps acquiring while MATLAB waits
+    assert(evo_irimager_mex('pipeline_start') == 0, 'pipeline start');
+    [THM, RGB, meta, ret] = evo_irimager_mex('pipeline_frame');
+    assert(ret == 0 && isequal(size(THM), [h w]) && isequal(size(RGB), [h w 3]), 'pipeline frame');
+    pause(0.25);
+    [THM, RGB, meta2, ret] = evo_irimager_mex('pipeline_frame');
+    assert(ret == 0 && meta2.counter > meta.counter + 1, 'stale pipeline frames dropped');
+    stats = evo_irimager_mex('pipeline_stats');
+    assert(stats.frames(1) >= meta2.counter - meta.counter && stats.dropped(3) > 0, 'pipeline statistics');
+    THM = evo_irimager_mex('get_thermal');
+    assert(isequal(size(THM), [h w]), 'single frame after pipeline');
+    stats2 = evo_irimager_mex('pipeline_stats');
+    assert(stats2.frames(1) >= stats.frames(1), 'statistics of the suspended pipeline');
+    assert(evo_irimager_mex('set_palette', 6) == 0, 'palette while pipeline suspended');
+    [THM, RGB, meta3, ret] = evo_irimager_mex('pipeline_frame');
+    assert(ret == 0 && meta3.counter > meta2.counter, 'pipeline restarted after single frame command');
+    assert(evo_irimager_mex('set_palette_scale', 2) == 0, 'palette scale stops the pipeline');
+    assert(evo_irimager_mex('pipeline_stop') == 0, 'suspended pipeline stopped');
+    assert(evo_irimager_mex('pipeline_stop') == -1, 'pipeline already stopped');
+    
+    disp('evo_irimager_mex: stub build checked');
+end
@@ -37,29 +37,49 @@ end
 % set temp range (uncomment next line for usage)
 %IRInterface.set_temperature_range(-20, 100);
 
+% acquisition runs on native threads while this loop draws, each iteration
+% takes the most recent frame (without evo_irimager_mex or if the pipeline
+% cannot start, frames are grabbed here, thermal and palette image with a
+% single call)
+usePipeline = IRInterface.start_pipeline();
+
+% image object is created with the first frame, afterwards only its pixels
+% are replaced (the close button is part of EvoIRViewer)
+hImage = [];
+
 % main loop
 while(viewer_is_running) 
 
-    % grab image data
-    RGB = IRInterface.get_palette();        % grab palette image
-    THM = IRInterface.get_thermal();        % grab thermal image
+    if usePipeline
+        [THM, RGB] = IRInterface.get_frame();
+    else
+        [THM, RGB] = IRInterface.get_thermal_palette();
+    end
+    
+    % keep the last frame on screen if none arrived
+    if isempty(RGB)
+        drawnow();
+        continue
+    end
     
     % process data here...
     
     
     
     
-     uicontrol('Style','PushButton',     ...
-                'String','Close',         ...
-                'Position', [0 0 100 25],...
-                'Callback','viewer_is_running=0');
-            
     % draw RGB image
-    imagesc(RGB);                           
+    if isempty(hImage)
+        hImage = imagesc(RGB);
+    else
+        set(hImage, 'CData', RGB);
+    end
     drawnow();   
     
 end
 
+if usePipeline
+    IRInterface.stop_pipeline();
+end
 IRInterface.terminate();                    % disconnect from camera
 
 close all; 
@@ -0,0 +1,414 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRBlobBench.cpp
+ * @brief Correctness and throughput of the blob tracker
+ *
+ * Labeling: frames of the synthetic source with moving hotspots and noise,
+ * whose thresholded edges are ragged, are labeled with 4 and 8 neighbours
+ * and compared blob by blob with a flood fill reference; all instruction
+ * sets must deliver identical blobs and label images.
+ *
+ * Tracking: a conveyor scene of hot parts in four lanes at different speeds,
+ * entering on the left and leaving on the right, with every 7th frame
+ * dropped. Every part has to keep one track id while it is visible, ids must
+ * not be reused, and the velocity of parts inside the image for a few
+ * frames has to match within 3 % (centroids of the rasterized parts jitter).
+ *
+ * Throughput is reported for 382 x 288 and 640 x 480 images of both scenes;
+ * a 640 x 480 frame has to take less than 1 ms:
+ *
+ *   EvoIRBlobBench [--frames 2000] [--hotspots 8]
+ *
+ * Build e.g. on Linux:
+ *
+ *   g++ -std=c++11 -O2 -pthread -I.. EvoIRBlobBench.cpp ../EvoIRBlob.cpp ../EvoIRPalette.cpp ../EvoIRSyntheticSource.cpp
+ */
+
+#include "EvoIRBlob.h"
+#include "EvoIRPalette.h"
+#include "EvoIRSyntheticSource.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <vector>
+
+static const char* const LEVELS[] = { "none", "sse4.1", "avx2" };
+
+// hotspot and conveyor scenes rendered ahead of timing, the tracker runs through them in a loop
+static const int PREPARED_FRAMES = 64;
+
+// frame rate of the simulated camera, converts conveyor speed into pixels per frame
+static const float RATE = 80.f;
+
+static unsigned short toRaw(double t)
+{
+  return (unsigned short)((t + 100.0) * 10.0 + 0.5);
+}
+
+//------------------------------------------------------------------------------
+// conveyor scene
+//------------------------------------------------------------------------------
+
+struct Conveyor
+{
+  int width;
+  int height;
+  double radius;
+  double spacing;
+  int perLane;
+
+  Conveyor(int w, int h) :
+    width(w),
+    height(h),
+    radius(h / 40.0),
+    spacing(w / 5.0)
+  {
+    perLane = (int)std::ceil((w + 4.0 * radius) / spacing);
+  }
+
+  double speed(int lane) const { return width * (0.3 + 0.15 * lane); }
+  double laneY(int lane) const { return height * (lane + 0.5) / 4.0; }
+
+  // x of part j of a lane and the number of times it went round, which identifies the physical part
+  double partX(int lane, int j, double t, long long* cycle) const
+  {
+    const double period = perLane * spacing;
+    const double p = j * spacing + speed(lane) * t;
+    *cycle = (long long)std::floor(p / period);
+    return p - *cycle * period - 2.0 * radius;
+  }
+
+  void render(double t, unsigned int seed, unsigned short* data) const
+  {
+    const unsigned short background = toRaw(25.0);
+    const unsigned short hot        = toRaw(80.0);
+    for(size_t i = 0; i < (size_t)width * height; i++)
+    {
+      seed = seed * 1664525u + 1013904223u;
+      data[i] = (unsigned short)(background + (seed >> 28));
+    }
+    for(int lane = 0; lane < 4; lane++)
+      for(int j = 0; j < perLane; j++)
+      {
+        long long cycle;
+        const double cx = partX(lane, j, t, &cycle);
+        const double cy = laneY(lane);
+        for(int y = std::max(0, (int)(cy - radius) - 1); y <= std::min(height - 1, (int)(cy + radius) + 1); y++)
+          for(int x = std::max(0, (int)(cx - radius) - 1); x <= std::min(width - 1, (int)(cx + radius) + 1); x++)
+            if((x - cx) * (x - cx) + (y - cy) * (y - cy) <= radius * radius)
+              data[(size_t)y * width + x] = (unsigned short)(hot + ((x * 7 + y * 3) & 15));
+      }
+  }
+};
+
+//------------------------------------------------------------------------------
+// flood fill reference
+//------------------------------------------------------------------------------
+
+struct Component
+{
+  unsigned int pixels;
+  double cx, cy;
+  int xMin, yMin, xMax, yMax;
+  unsigned short peak;
+  int xPeak, yPeak;
+};
+
+static void floodFill(const unsigned short* data, int w, int h, unsigned short threshold, int connectivity, int minPixels, std::vector<Component>& out)
+{
+  std::vector<int> seen((size_t)w * h, 0);
+  std::vector<int> stack;
+  out.clear();
+  for(int i = 0; i < w * h; i++)
+  {
+    if(seen[i] || data[i] < threshold) continue;
+    Component c = { 0, 0.0, 0.0, w, h, -1, -1, 0, 0, 0 };
+    stack.push_back(i);
+    seen[i] = 1;
+    while(!stack.empty())
+    {
+      const int p = stack.back();
+      stack.pop_back();
+      const int x = p % w, y = p / w;
+      c.pixels++;
+      c.cx += x;
+      c.cy += y;
+      c.xMin = std::min(c.xMin, x); c.xMax = std::max(c.xMax, x);
+      c.yMin = std::min(c.yMin, y); c.yMax = std::max(c.yMax, y);
+      if(data[p] > c.peak || (data[p] == c.peak && (y < c.yPeak || (y == c.yPeak && x < c.xPeak))))
+      {
+        c.peak  = data[p];
+        c.xPeak = x;
+        c.yPeak = y;
+      }
+      for(int dy = -1; dy <= 1; dy++)
+        for(int dx = -1; dx <= 1; dx++)
+        {
+          if((dx == 0 && dy == 0) || (connectivity == 4 && dx != 0 && dy != 0)) continue;
+          const int nx = x + dx, ny = y + dy;
+          if(nx < 0 || ny < 0 || nx >= w || ny >= h) continue;
+          const int q = ny * w + nx;
+          if(seen[q] || data[q] < threshold) continue;
+          seen[q] = 1;
+          stack.push_back(q);
+        }
+    }
+    c.cx /= c.pixels;
+    c.cy /= c.pixels;
+    // discovered in scan order, a stable sort keeps it for equal areas
+    if(c.pixels >= (unsigned int)minPixels) out.push_back(c);
+  }
+  std::stable_sort(out.begin(), out.end(), [](const Component& a, const Component& b) { return a.pixels > b.pixels; });
+}
+
+static bool sameBlobs(const std::vector<Component>& reference, const EvoIRBlob* blobs, unsigned int count)
+{
+  if(reference.size() != count) return false;
+  for(unsigned int i = 0; i < count; i++)
+  {
+    const Component& c = reference[i];
+    const EvoIRBlob& b = blobs[i];
+    if(c.pixels != b.pixels || c.xMin != b.xMin || c.yMin != b.yMin || c.xMax != b.xMax || c.yMax != b.yMax
+       || c.xPeak != b.xPeak || c.yPeak != b.yPeak || std::fabs(c.cx - b.cx) > 1e-3 || std::fabs(c.cy - b.cy) > 1e-3)
+      return false;
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+
+static bool checkLabeling(int w, int h, int hotspots, int maxLevel)
+{
+  EvoIRSyntheticParams synthetic;
+  evo_irimager_synthetic_default_params(&synthetic, w, h, RATE);
+  synthetic.realtime     = 0;
+  synthetic.flagInterval = 0.f;
+  synthetic.hotspots     = hotspots;
+  synthetic.noise        = 2.f;
+  unsigned int srcId;
+  if(evo_irimager_synthetic_init(&srcId, &synthetic) != 0) return false;
+  const size_t pixels = (size_t)w * h;
+  std::vector<unsigned short> frame(pixels);
+  std::vector<Component> reference;
+  std::vector<EvoIRBlob> blobs(1024), blobsRef(1024);
+  std::vector<unsigned int> labels(pixels), labelsRef(pixels);
+  int frames = 0, mismatches = 0, differences = 0;
+  size_t found = 0;
+  for(int i = 0; i < 40; i++)
+  {
+    EvoIRFrameMetadata metadata;
+    int fw = w, fh = h;
+    evo_irimager_synthetic_get_thermal_image_metadata(srcId, &fw, &fh, &frame[0], &metadata);
+    for(int connectivity = 4; connectivity <= 8; connectivity += 4)
+    {
+      EvoIRBlobParams params;
+      evo_irimager_blob_default_params(&params, w, h);
+      // around half of the hotspot amplitude above the background, edges cross the noise
+      params.tThreshold   = synthetic.tBackground + 0.5f * synthetic.tHotspot;
+      params.connectivity = connectivity;
+      params.minPixels    = 1;
+      params.maxBlobs     = 1024;
+      floodFill(&frame[0], w, h, toRaw(params.tThreshold), connectivity, params.minPixels, reference);
+      for(int level = 0; level <= maxLevel; level++)
+      {
+        evo_irimager_set_simd_level(level);
+        unsigned int trackerId, count;
+        evo_irimager_blob_tracker_create(&trackerId, &params);
+        evo_irimager_blob_process(trackerId, &frame[0], &metadata, &blobs[0], (unsigned int)blobs.size(), &count, &labels[0]);
+        evo_irimager_blob_tracker_destroy(trackerId);
+        if(level == 0)
+        {
+          if(!sameBlobs(reference, &blobs[0], count)) mismatches++;
+          blobsRef  = blobs;
+          labelsRef = labels;
+          found += count;
+        }
+        else if(std::memcmp(&blobs[0], &blobsRef[0], count * sizeof(EvoIRBlob)) != 0 || labels != labelsRef)
+          differences++;
+      }
+      frames++;
+    }
+  }
+  evo_irimager_synthetic_terminate(srcId);
+  evo_irimager_set_simd_level(maxLevel);
+  std::printf("  labeling: %d frames, %zu blobs, mismatches with flood fill %d, instruction set differences %d\n", frames, found, mismatches, differences);
+  return mismatches == 0 && differences == 0 && found > 0;
+}
+
+static bool checkTracking(int w, int h, int frames)
+{
+  const Conveyor conveyor(w, h);
+  EvoIRBlobParams params;
+  evo_irimager_blob_default_params(&params, w, h);
+  params.minPixels = 2;
+  unsigned int trackerId;
+  if(evo_irimager_blob_tracker_create(&trackerId, &params) != 0) return false;
+
+  const size_t pixels = (size_t)w * h;
+  std::vector<unsigned short> frame(pixels);
+  std::vector<EvoIRBlob> blobs(64);
+  std::map<long long, unsigned int> partTrack;   // part -> track id
+  std::map<unsigned int, long long> trackPart;   // track id -> part
+  int switches = 0, reused = 0, unmatched = 0, velocities = 0, velocityErrors = 0;
+  double maxError = 0.0;
+  for(int k = 0; k < frames; k++)
+  {
+    if(k % 7 == 6) continue;
+    const double t = k / RATE;
+    conveyor.render(t, 1234u + k, &frame[0]);
+    EvoIRFrameMetadata metadata;
+    std::memset(&metadata, 0, sizeof(metadata));
+    metadata.counter   = k;
+    metadata.timestamp = (long long)(t * 1e7);
+    unsigned int count;
+    evo_irimager_blob_process(trackerId, &frame[0], &metadata, &blobs[0], (unsigned int)blobs.size(), &count, NULL);
+
+    for(unsigned int i = 0; i < count; i++)
+    {
+      const EvoIRBlob& b = blobs[i];
+      const int lane = (int)std::floor(b.cy / (h / 4.0));
+      // part whose center is nearest, partially visible parts have shifted centroids
+      long long part = -1;
+      double best = 1.5 * conveyor.radius;
+      for(int j = 0; j < conveyor.perLane; j++)
+      {
+        long long cycle;
+        const double x = conveyor.partX(lane, j, t, &cycle);
+        const double d = std::fabs(std::min(std::max(x, 0.0), w - 1.0) - b.cx);
+        if(d < best)
+        {
+          best = d;
+          part = ((long long)lane * conveyor.perLane + j) * 1000000 + cycle;
+        }
+      }
+      if(part < 0) { unmatched++; continue; }
+      if(partTrack.count(part) && partTrack[part] != b.trackId) switches++;
+      if(trackPart.count(b.trackId) && trackPart[b.trackId] != part) reused++;
+      partTrack[part]      = b.trackId;
+      trackPart[b.trackId] = part;
+
+      // while a part enters, its centroid is slower, velocities are measured over 8 detections
+      const double v = conveyor.speed(lane);
+      const bool inside = b.xMin > 10.0 * v / RATE && b.xMax < w - 1;
+      if(inside && b.age >= 8)
+      {
+        const double e = std::max(std::fabs(b.vx - v), std::fabs((double)b.vy)) / v;
+        maxError = std::max(maxError, e);
+        velocities++;
+        if(e > 0.03) velocityErrors++;
+      }
+    }
+  }
+  evo_irimager_blob_tracker_destroy(trackerId);
+  std::printf("  tracking: %zu parts, id switches %d, ids reused %d, unmatched blobs %d, velocity error max %.2f %% over %d blobs\n",
+              partTrack.size(), switches, reused, unmatched, 100.0 * maxError, velocities);
+  return switches == 0 && reused == 0 && unmatched == 0 && velocityErrors == 0 && velocities > 0;
+}
+
+static double measure(const std::vector<unsigned short>& prepared, int w, int h, float tThreshold, int frames, bool withLabels, unsigned int* blobsPerFrame)
+{
+  EvoIRBlobParams params;
+  evo_irimager_blob_default_params(&params, w, h);
+  params.tThreshold = tThreshold;
+  unsigned int trackerId;
+  evo_irimager_blob_tracker_create(&trackerId, &params);
+  const size_t pixels = (size_t)w * h;
+  std::vector<EvoIRBlob> blobs(64);
+  std::vector<unsigned int> labels(pixels);
+  EvoIRFrameMetadata metadata;
+  std::memset(&metadata, 0, sizeof(metadata));
+  unsigned int count = 0, total = 0;
+  const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  for(int i = 0; i < frames; i++)
+  {
+    metadata.timestamp = (long long)(i * 1e7 / RATE);
+    evo_irimager_blob_process(trackerId, &prepared[pixels * (i % PREPARED_FRAMES)], &metadata, &blobs[0], 64, &count, withLabels ? &labels[0] : NULL);
+    total += count;
+  }
+  const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count() / frames;
+  evo_irimager_blob_tracker_destroy(trackerId);
+  *blobsPerFrame = total / frames;
+  return us;
+}
+
+static bool run(int w, int h, int frames, int hotspots, int maxLevel)
+{
+  std::printf("%d x %d\n", w, h);
+  bool ok = checkLabeling(w, h, hotspots, maxLevel);
+  ok = checkTracking(w, h, 800) && ok;
+
+  const size_t pixels = (size_t)w * h;
+  EvoIRSyntheticParams synthetic;
+  evo_irimager_synthetic_default_params(&synthetic, w, h, RATE);
+  synthetic.realtime     = 0;
+  synthetic.flagInterval = 0.f;
+  synthetic.hotspots     = hotspots;
+  unsigned int srcId;
+  if(evo_irimager_synthetic_init(&srcId, &synthetic) != 0) return false;
+  std::vector<unsigned short> hotspotFrames(pixels * PREPARED_FRAMES), conveyorFrames(pixels * PREPARED_FRAMES);
+  const Conveyor conveyor(w, h);
+  for(int i = 0; i < PREPARED_FRAMES; i++)
+  {
+    EvoIRFrameMetadata metadata;
+    int fw = w, fh = h;
+    evo_irimager_synthetic_get_thermal_image_metadata(srcId, &fw, &fh, &hotspotFrames[pixels * i], &metadata);
+    conveyor.render(i / RATE, 99u + i, &conveyorFrames[pixels * i]);
+  }
+  evo_irimager_synthetic_terminate(srcId);
+
+  std::printf("  %-6s %-9s %8s %10s %18s %8s\n", "simd", "scene", "blobs", "us/frame", "us/frame labels", "period");
+  for(int level = 0; level <= maxLevel; level++)
+  {
+    evo_irimager_set_simd_level(level);
+    for(int scene = 0; scene < 2; scene++)
+    {
+      const std::vector<unsigned short>& prepared = scene == 0 ? hotspotFrames : conveyorFrames;
+      const float threshold = scene == 0 ? synthetic.tBackground + 0.5f * synthetic.tHotspot : 50.f;
+      unsigned int blobs;
+      const double us       = measure(prepared, w, h, threshold, frames, false, &blobs);
+      const double usLabels = measure(prepared, w, h, threshold, frames, true, &blobs);
+      std::printf("  %-6s %-9s %8u %10.1f %18.1f %7.1f%%\n", LEVELS[level], scene == 0 ? "hotspots" : "conveyor", blobs, us, usLabels, us * RATE * 1e-4);
+      if(level == maxLevel && w * h >= 640 * 480) ok = ok && us < 1000.0;
+    }
+  }
+  evo_irimager_set_simd_level(maxLevel);
+  return ok;
+}
+
+int main(int argc, char* argv[])
+{
+  int frames   = 2000;
+  int hotspots = 8;
+  for(int i = 1; i < argc; i++)
+  {
+    const bool hasValue = i + 1 < argc;
+    if(!std::strcmp(argv[i], "--frames") && hasValue)        frames   = std::atoi(argv[++i]);
+    else if(!std::strcmp(argv[i], "--hotspots") && hasValue) hotspots = std::atoi(argv[++i]);
+    else
+    {
+      std::printf("usage: EvoIRBlobBench [--frames n] [--hotspots n]\n");
+      return 1;
+    }
+  }
+  if(frames < 1 || hotspots < 1) return 1;
+
+  int supported;
+  evo_irimager_set_simd_level(2);
+  evo_irimager_get_simd_level(&supported);
+
+  bool ok = run(382, 288, frames, hotspots, supported);
+  ok = run(640, 480, frames, hotspots, supported) && ok;
+  std::printf("%s\n", ok ? "passed" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,189 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRCaptureGroupCheck.cpp
+ * @brief Frame set alignment of a capture group with cameras at 27 Hz and 80 Hz
+ *
+ * Two synthetic sources in realtime mode stand in for PI400 cameras at 27 Hz
+ * (reference) and 80 Hz. Reference frame k is taken at k / 27 s, the closest
+ * 80 Hz frame lies |80 k mod 27| / 2160 s away when counting the residue
+ * from the nearer side. With the default window of 5 ms, about 21 of every 27
+ * reference frames find a partner. The clocks of the sources start a little
+ * apart, so the exact numbers are computed from the timestamps of the first
+ * frames with the formula of the synthetic source and compared with
+ *
+ * - incomplete sets allowed: 27 n sets, the matched ones with both frames
+ * - complete sets only: as many sets as matches, the other reference frames
+ *   counted unmatched
+ *
+ * 80 Hz frames between the partners are counted unmatched, up to the window
+ * behind the last reference frame:
+ *
+ *   EvoIRCaptureGroupCheck [--periods 2]
+ *
+ * A period takes one second per mode. Build e.g. on Linux:
+ *
+ *   g++ -std=c++11 -O2 -pthread -I.. EvoIRCaptureGroupCheck.cpp ../EvoIRCaptureGroup.cpp ../EvoIRFrameRing.cpp ../EvoIRSyntheticSource.cpp ../EvoIRBindingStub.cpp ../EvoIRFormatPlan.cpp ../EvoIRPalette.cpp ../EvoIRRecording.cpp
+ */
+
+#include "EvoIRCaptureGroup.h"
+#include "EvoIRSyntheticSource.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static const int WIDTH     = 382;
+static const int HEIGHT    = 288;
+static const int REF_FPS   = 27;
+static const int OTHER_FPS = 80;
+static const long long UNITS = 10000000;
+
+// Timestamp of frame index of a synthetic source, see EvoIRSyntheticSource.cpp
+static long long timestamp(long long t0, int fps, long long index)
+{
+  const double period = 1.0 / (float)fps;
+  return t0 + (long long)(index * period * 1e7);
+}
+
+// Distance of reference frame k to the closest 80 Hz frame
+static long long distance(long long t0Ref, long long t0Other, long long k)
+{
+  const long long r = timestamp(t0Ref, REF_FPS, k);
+  long long j = (r - t0Other) * OTHER_FPS / UNITS;
+  if(j < 0) j = 0;
+  const long long before = r - timestamp(t0Other, OTHER_FPS, j);
+  const long long after  = timestamp(t0Other, OTHER_FPS, j + 1) - r;
+  return std::min(before < 0 ? -before : before, after);
+}
+
+// Number of 80 Hz frames with timestamp <= limit
+static long long framesUpTo(long long t0Other, long long limit)
+{
+  long long n = 0;
+  while(timestamp(t0Other, OTHER_FPS, n) <= limit) n++;
+  return n;
+}
+
+static bool run(bool complete, unsigned int periods)
+{
+  EvoIRSyntheticParams params;
+  unsigned int refId, otherId;
+  evo_irimager_synthetic_default_params(&params, WIDTH, HEIGHT, (float)REF_FPS);
+  params.realtime = 1;
+  if(evo_irimager_synthetic_init(&refId, &params) != 0) return false;
+  evo_irimager_synthetic_default_params(&params, WIDTH, HEIGHT, (float)OTHER_FPS);
+  params.realtime = 1;
+  if(evo_irimager_synthetic_init(&otherId, &params) != 0) return false;
+
+  EvoIRGroupParams groupParams;
+  evo_irimager_group_default_params(&groupParams);
+  groupParams.complete = complete ? 1 : 0;
+  unsigned int groupId, index;
+  if(evo_irimager_group_create(&groupId, &groupParams) != 0 ||
+     evo_irimager_group_add_synthetic(groupId, refId, -1, &index) != 0 ||
+     evo_irimager_group_add_synthetic(groupId, otherId, -1, &index) != 0 ||
+     evo_irimager_group_start(groupId) != 0)
+    return false;
+
+  // The first set pairs the first frames of both sources, their timestamps are the clock origins
+  EvoIRFrameSet set;
+  bool ok = evo_irimager_group_acquire_set(groupId, 1000, &set) == 0 && set.matched == 2 && set.metadata[0]->counterHW == 1
+            && set.metadata[1]->counterHW == 1;
+  const long long t0Ref   = ok ? set.metadata[0]->timestamp : 0;
+  const long long t0Other = ok ? set.metadata[1]->timestamp : 0;
+  if(ok) evo_irimager_group_release_set(groupId, &set);
+
+  // Expected sets: reference frames [0; frames) with frames covering n periods, in complete mode up to the last match
+  const long long frames = (long long)REF_FPS * periods;
+  unsigned int expectedPairs = 0;
+  unsigned long long expectedRefUnmatched = 0;
+  long long kLast = 0;
+  for(long long k = 0; k < frames; k++)
+  {
+    if(distance(t0Ref, t0Other, k) <= groupParams.window)
+    {
+      expectedPairs++;
+      kLast = k;
+    }
+  }
+  if(complete)
+  {
+    for(long long k = 0; k < kLast; k++)
+      if(distance(t0Ref, t0Other, k) > groupParams.window) expectedRefUnmatched++;
+  }
+  else
+  {
+    kLast = frames - 1;
+  }
+  const unsigned int sets = complete ? expectedPairs : (unsigned int)frames;
+
+  unsigned int pairs = ok ? 1 : 0;
+  long long tLast = t0Ref;
+  for(unsigned int s = 1; s < sets && ok; s++)
+  {
+    ok = evo_irimager_group_acquire_set(groupId, 1000, &set) == 0;
+    if(!ok) break;
+    tLast = set.metadata[0]->timestamp;
+    if(set.matched == 2)
+    {
+      pairs++;
+      ok = set.skew <= groupParams.window;
+    }
+    evo_irimager_group_release_set(groupId, &set);
+  }
+  evo_irimager_group_stop(groupId);
+
+  EvoIRCameraStats ref, other;
+  ok = ok && evo_irimager_group_get_camera_stats(groupId, 0, &ref) == 0 && evo_irimager_group_get_camera_stats(groupId, 1, &other) == 0;
+  evo_irimager_group_destroy(groupId);
+  evo_irimager_synthetic_terminate(refId);
+  evo_irimager_synthetic_terminate(otherId);
+  if(!ok)
+  {
+    std::printf("%s sets: acquire FAILED\n", complete ? "complete" : "incomplete");
+    return false;
+  }
+
+  // 80 Hz frames handled: all before the last reference frame minus the window, at most those within the window after it
+  const long long lowest = framesUpTo(t0Other, tLast - groupParams.window - 1) - (long long)other.framesMatched;
+  const long long most   = framesUpTo(t0Other, tLast + groupParams.window) - (long long)other.framesMatched;
+
+  const bool passed = tLast == timestamp(t0Ref, REF_FPS, kLast) && pairs == expectedPairs && ref.framesMatched == sets
+                      && ref.framesUnmatched == expectedRefUnmatched && other.framesMatched == expectedPairs
+                      && (long long)other.framesUnmatched >= lowest && (long long)other.framesUnmatched <= most
+                      && ref.framesDropped == 0 && other.framesDropped == 0;
+  std::printf("%s sets: clocks %.3f ms apart, %u sets, %u with both frames (expected %u)\n", complete ? "complete" : "incomplete",
+              (t0Other - t0Ref) / 1e4, sets, pairs, expectedPairs);
+  std::printf("  27 Hz: %llu matched, %llu unmatched (expected %u, %llu)\n", ref.framesMatched, ref.framesUnmatched, sets, expectedRefUnmatched);
+  std::printf("  80 Hz: %llu matched, %llu unmatched (expected %u, %lld to %lld)\n", other.framesMatched, other.framesUnmatched, expectedPairs,
+              lowest, most);
+  return passed;
+}
+
+int main(int argc, char* argv[])
+{
+  unsigned int periods = 2;
+  for(int i = 1; i < argc; i++)
+  {
+    const bool hasValue = i + 1 < argc;
+    if(!std::strcmp(argv[i], "--periods") && hasValue) periods = (unsigned int)std::atoi(argv[++i]);
+    else
+    {
+      std::printf("usage: EvoIRCaptureGroupCheck [--periods n]\n");
+      return 1;
+    }
+  }
+  if(periods == 0) return 1;
+
+  bool passed = run(false, periods);
+  passed = run(true, periods) && passed;
+  std::printf("%s\n", passed ? "passed" : "FAILED");
+  return passed ? 0 : 1;
+}
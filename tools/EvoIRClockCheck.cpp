@@ -0,0 +1,188 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRClockCheck.cpp
+ * @brief Validation of the clock model with simulated camera and host clocks
+ *
+ * Simulates the frame metadata of an 80 Hz camera whose clock deviates from
+ * the host clock by a drift that slowly wanders, e.g. with the housing
+ * temperature. Host timestamps are taken on arrival after a constant latency
+ * plus an exponentially distributed one, transfer stalls delay all frames
+ * until they end, and frames are dropped at random. The hardware counter
+ * starts shortly before its wraparound, and halfway through the camera
+ * reconnects with a pause and a restarted counter.
+ *
+ * The corrected timestamps are compared with the true capture time plus the
+ * constant latency, which cannot be observed by the host. The lowest latency
+ * found per bucket still exceeds the constant one by a small amount, which
+ * is reported as offset. The error bound has to hold for the deviation from
+ * this offset, i.e. for the variation of the corrected timestamps:
+ *
+ *   EvoIRClockCheck [--minutes 10] [--drift 40] [--wander 5] [--jitter 1] [--stalls 0.005] [--drop 0.02] [--seed 1]
+ *
+ * drift and wander in parts per million, jitter is the mean latency in
+ * milliseconds on top of 0.3 ms. Build e.g. on Linux:
+ *
+ *   g++ -std=c++11 -O2 -I.. EvoIRClockCheck.cpp ../EvoIRClockModel.cpp
+ */
+
+#include "EvoIRClockModel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+static const double FPS           = 80.0;
+static const double BASE_LATENCY  = 0.3e-3;
+static const double WANDER_PERIOD = 600.0;
+static const double RECONNECT_GAP = 3.0;
+static const double UNITS         = 1e7;
+
+struct Errors
+{
+  std::vector<double> corrected; // signed
+  std::vector<double> bound;
+  std::vector<double> raw;
+  unsigned int invalid;
+  Errors() : invalid(0) { }
+};
+
+static double percentile(std::vector<double> values, double p)
+{
+  if(values.empty()) return 0.0;
+  const size_t k = std::min(values.size() - 1, (size_t)(p * values.size()));
+  std::nth_element(values.begin(), values.begin() + k, values.end());
+  return values[k];
+}
+
+int main(int argc, char* argv[])
+{
+  double minutes = 10.0;
+  double drift   = 40.0;
+  double wander  = 5.0;
+  double jitter  = 1.0;
+  double stalls  = 0.005;
+  double drop    = 0.02;
+  unsigned int seed = 1;
+  for(int i = 1; i < argc; i++)
+  {
+    const bool hasValue = i + 1 < argc;
+    if(!std::strcmp(argv[i], "--minutes") && hasValue)     minutes = std::atof(argv[++i]);
+    else if(!std::strcmp(argv[i], "--drift") && hasValue)  drift   = std::atof(argv[++i]);
+    else if(!std::strcmp(argv[i], "--wander") && hasValue) wander  = std::atof(argv[++i]);
+    else if(!std::strcmp(argv[i], "--jitter") && hasValue) jitter  = std::atof(argv[++i]);
+    else if(!std::strcmp(argv[i], "--stalls") && hasValue) stalls  = std::atof(argv[++i]);
+    else if(!std::strcmp(argv[i], "--drop") && hasValue)   drop    = std::atof(argv[++i]);
+    else if(!std::strcmp(argv[i], "--seed") && hasValue)   seed    = (unsigned int)std::atoi(argv[++i]);
+    else
+    {
+      std::printf("usage: EvoIRClockCheck [--minutes m] [--drift ppm] [--wander ppm] [--jitter ms] [--stalls p] [--drop p] [--seed n]\n");
+      return 1;
+    }
+  }
+  if(minutes <= 0.0 || jitter < 0.0) return 1;
+
+  EvoIRClockParams params;
+  evo_irimager_clock_default_params(&params, (float)FPS);
+  unsigned int clockId;
+  if(evo_irimager_clock_create(&clockId, &params) != 0) return 1;
+
+  std::mt19937 random(seed);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  std::exponential_distribution<double> latency(jitter > 0.0 ? 1.0 / (jitter * 1e-3) : 1e9);
+
+  const double duration  = minutes * 60.0;
+  const double reconnect = duration / 2;
+  double tTrue           = 1000.0;    // capture time in host seconds, arbitrary origin
+  double tArrival        = 0.0;
+  double stallEnd        = 0.0;
+  unsigned int counterHW = 0xFFFFFFFFu - (unsigned int)(30 * FPS); // wraps after 30 s
+  unsigned int counter   = 0;
+  bool reconnected       = false;
+  double driftLast       = 0.0;
+  Errors errors;
+
+  for(double t = 0.0; t < duration; )
+  {
+    // camera clock: one counter step takes this many host seconds
+    const double ppm    = drift + wander * std::sin(2.0 * M_PI * t / WANDER_PERIOD);
+    const double period = (1.0 + ppm * 1e-6) / FPS;
+    tTrue += period;
+    t     += period;
+    counterHW++;
+    if(!reconnected && t >= reconnect)
+    {
+      reconnected = true;
+      tTrue     += RECONNECT_GAP;
+      t         += RECONNECT_GAP;
+      counterHW  = 1 + (unsigned int)(uniform(random) * 100);
+    }
+    if(uniform(random) < drop) continue;
+
+    if(uniform(random) < stalls) stallEnd = tTrue + 5e-3 + uniform(random) * 45e-3;
+    // frames arrive in order, delayed by a stall until it ends
+    tArrival = std::max(std::max(tTrue + BASE_LATENCY + latency(random), stallEnd), tArrival + 20e-6);
+
+    EvoIRFrameMetadata metadata;
+    std::memset(&metadata, 0, sizeof(metadata));
+    metadata.counter   = ++counter;
+    metadata.counterHW = counterHW;
+    metadata.timestamp = (long long)std::floor(tArrival * UNITS);
+
+    long long corrected;
+    double bound;
+    const int ret = evo_irimager_clock_update(clockId, &metadata, &corrected, &bound);
+    if(ret < 0) return 1;
+    driftLast = ppm;
+    if(ret == 1)
+    {
+      errors.invalid++;
+      continue;
+    }
+    const double truth = tTrue + BASE_LATENCY;
+    const double error = corrected / UNITS - truth;
+    errors.corrected.push_back(error);
+    errors.bound.push_back(bound);
+    errors.raw.push_back(std::fabs(metadata.timestamp / UNITS - truth));
+  }
+
+  EvoIRClockStats stats;
+  evo_irimager_clock_get_stats(clockId, &stats);
+  evo_irimager_clock_destroy(clockId);
+
+  const size_t n = errors.corrected.size();
+  const double offset = percentile(errors.corrected, 0.5);
+  std::vector<double> deviation(n);
+  unsigned int covered = 0;
+  for(size_t i = 0; i < n; i++)
+  {
+    deviation[i] = std::fabs(errors.corrected[i] - offset);
+    if(deviation[i] <= errors.bound[i] + 1.0 / UNITS) covered++;
+  }
+  const double coverage = n ? (double)covered / n : 0.0;
+  const double p50 = percentile(deviation, 0.5) * 1e6;
+  const double p99 = percentile(deviation, 0.99) * 1e6;
+  const double max = n ? (*std::max_element(deviation.begin(), deviation.end()) + std::fabs(offset)) * 1e6 : 0.0;
+  std::printf("frames %llu, corrected %zu, before valid %u, resets %u, wraps %u, outlier buckets %u\n",
+              stats.frames, n, errors.invalid, stats.resets, stats.wraps, stats.outliers);
+  std::printf("drift: fitted %.2f ppm, simulated %.2f ppm, sigma %.1f us, error bound %.1f us\n", stats.drift, driftLast, stats.sigma * 1e6, stats.error * 1e6);
+  std::printf("offset of corrected timestamps %.1f us\n", offset * 1e6);
+  std::printf("  %-10s %10s %10s %10s\n", "|error|", "median", "p99", "max");
+  std::printf("  %-10s %8.1f us %7.1f us %7.1f us\n", "raw", percentile(errors.raw, 0.5) * 1e6, percentile(errors.raw, 0.99) * 1e6,
+              n ? *std::max_element(errors.raw.begin(), errors.raw.end()) * 1e6 : 0.0);
+  std::printf("  %-10s %8.1f us %7.1f us %7.1f us   (deviation from offset, max including offset)\n", "corrected", p50, p99, max);
+  std::printf("within error bound: %.2f%%\n", 100.0 * coverage);
+
+  const bool passed = stats.resets == 1 && stats.wraps == 1 && max < 1000.0 && coverage > 0.95;
+  std::printf("%s\n", passed ? "passed" : "FAILED");
+  return passed ? 0 : 1;
+}
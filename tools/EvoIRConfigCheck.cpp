@@ -0,0 +1,171 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRConfigCheck.cpp
+ * @brief Outage per change type of the configuration manager
+ *
+ * Initializes the camera with a configuration file, then edits one setting
+ * after the other in a copy of it and applies the copy. For every change the
+ * report of the configuration manager is printed next to the gap between the
+ * timestamps of the last frame before and the first frame after applying,
+ * i.e. the outage an application sees, and the configuration the camera runs
+ * with is compared with the edited one. A temperature range the camera
+ * refuses at runtime has to be reported with the restart applying it, without
+ * the failed call adding to the outage. Last, the replay camera stops
+ * delivering frames, a restart has to fail and leave the library released:
+ *
+ *   EvoIRConfigCheck [--xml ../generic.xml] [--work check.xml]
+ *
+ * Build e.g. on Linux, with the stand-in of the library instead of a camera:
+ *
+ *   g++ -std=c++11 -O2 -pthread -I.. -DIRDIRECTSDK_STATIC=1 EvoIRConfigCheck.cpp ../EvoIRConfig.cpp ../EvoIRBindingStub.cpp ../EvoIRSyntheticSource.cpp ../EvoIRPalette.cpp ../EvoIRFormatPlan.cpp ../EvoIRRecording.cpp
+ */
+
+#include "EvoIRConfig.h"
+#include "EvoIRReplay.h"
+#include "direct_binding.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static const char* const METHOD_NAMES[] = { "-", "runtime", "restart" };
+
+struct Step
+{
+  const char* name;
+  int type;      // expected change type
+  int method;    // expected method
+  void (*edit)(EvoIRConfig* config);
+};
+
+static void editTemperature(EvoIRConfig* c) { c->tMin = 0; c->tMax = 250; }
+static void editShutter(EvoIRConfig* c)     { c->autoflagEnable = 0; }
+static void editFocus(EvoIRConfig* c)       { c->focus = 35.f; }
+static void editPalette(EvoIRConfig* c)     { c->paletteId = 3; c->paletteScale = 1; c->paletteMin = 15.f; c->paletteMax = 45.f; }
+static void editFramerate(EvoIRConfig* c)   { c->framerate = 27.f; }
+static void editInterval(EvoIRConfig* c)    { c->autoflagMinInterval = 30.f; c->autoflagMaxInterval = 120.f; }
+static void editProcessing(EvoIRConfig* c)  { c->radialDistortionCorrection = 1; }
+
+int main(int argc, char* argv[])
+{
+  const char* xml  = "../generic.xml";
+  const char* work = "check.xml";
+  for(int i = 1; i < argc; i++)
+  {
+    const bool hasValue = i + 1 < argc;
+    if(!std::strcmp(argv[i], "--xml") && hasValue)       xml  = argv[++i];
+    else if(!std::strcmp(argv[i], "--work") && hasValue) work = argv[++i];
+    else
+    {
+      std::printf("usage: EvoIRConfigCheck [--xml path] [--work path]\n");
+      return 1;
+    }
+  }
+
+  EvoIRConfig config;
+  evo_irimager_config_default(&config);
+  if(evo_irimager_config_load(xml, &config) != 0 || evo_irimager_config_save(work, &config) != 0)
+  {
+    std::printf("cannot read %s or write %s\n", xml, work);
+    return 1;
+  }
+  unsigned int cfgId;
+  if(evo_irimager_usb_init(work, "", "") != 0 || evo_irimager_config_attach(&cfgId, work, "", "") != 0)
+  {
+    std::printf("cannot initialize camera\n");
+    return 1;
+  }
+  int w, h;
+  evo_irimager_get_thermal_image_size(&w, &h);
+  std::vector<unsigned short> data((size_t)w * h);
+  const void* buffer = &data[0];
+
+  const Step steps[] = {
+    { "temperature range", EVO_CONFIG_TEMPERATURE_RANGE, EVO_CONFIG_RUNTIME, editTemperature },
+    { "autoflag off",      EVO_CONFIG_SHUTTER_MODE,      EVO_CONFIG_RUNTIME, editShutter },
+    { "focus",             EVO_CONFIG_FOCUS,             EVO_CONFIG_RUNTIME, editFocus },
+    { "palette",           EVO_CONFIG_PALETTE,           EVO_CONFIG_RUNTIME, editPalette },
+    { "framerate",         EVO_CONFIG_FRAMERATE,         EVO_CONFIG_RESTART, editFramerate },
+    { "autoflag interval", EVO_CONFIG_AUTOFLAG_INTERVAL, EVO_CONFIG_RESTART, editInterval },
+    { "distortion",        EVO_CONFIG_PROCESSING,        EVO_CONFIG_RESTART, editProcessing }
+  };
+
+  bool passed = true;
+  std::printf("  %-18s %-8s %10s %12s   %s\n", "change", "method", "reported", "frame gap", "");
+  for(size_t s = 0; s < sizeof(steps) / sizeof(steps[0]); s++)
+  {
+    const Step& step = steps[s];
+    step.edit(&config);
+    EvoIRFrameMetadata before, after;
+    EvoIRConfigReport report;
+    int ret;
+    // the palette is not part of the file
+    if(step.type == EVO_CONFIG_PALETTE)
+    {
+      evo_irimager_get_thermal_image_metadata(&w, &h, &data[0], &before);
+      ret = evo_irimager_config_apply(cfgId, &config, &report);
+    }
+    else
+    {
+      if(evo_irimager_config_save(work, &config) != 0) return 1;
+      evo_irimager_get_thermal_image_metadata(&w, &h, &data[0], &before);
+      ret = evo_irimager_config_apply_file(cfgId, work, &report);
+    }
+    if(report.sizeChanged) data.resize((size_t)report.width * report.height);
+    w = report.width;
+    h = report.height;
+    const bool fetched = evo_irimager_get_thermal_image_metadata(&w, &h, &data[0], &after) == 0;
+    const double gap = fetched ? (after.timestamp - before.timestamp) * 1e-7 : -1.0;
+
+    EvoIRConfig live;
+    evo_irimager_config_get(cfgId, &live);
+    unsigned int others = 0;
+    for(int t = 0; t < EVO_CONFIG_CHANGE_TYPES; t++)
+      if(t != step.type && report.changes[t].method != EVO_CONFIG_UNCHANGED && !(report.restarted && t == EVO_CONFIG_PALETTE)) others++;
+    const bool ok = ret == 0 && fetched && report.changes[step.type].method == step.method && others == 0 && !report.sizeChanged
+                    && std::memcmp(&live, &config, sizeof(config)) == 0;
+    std::printf("  %-18s %-8s %7.1f ms %9.1f ms   %s\n", step.name, METHOD_NAMES[report.changes[step.type].method],
+                report.changes[step.type].outage * 1e3, gap * 1e3, ok ? "" : "FAILED");
+    passed = passed && ok;
+  }
+
+  // nothing changed, nothing applied
+  EvoIRConfigReport report;
+  passed = passed && evo_irimager_config_apply_file(cfgId, work, &report) == 0 && report.outage == 0.0 && !report.restarted;
+  // the image buffer has never been reallocated
+  passed = passed && buffer == &data[0];
+
+  // the stand-in refuses an empty temperature range at runtime
+  config.tMin = config.tMax;
+  const EvoIRConfigChange& refused = report.changes[EVO_CONFIG_TEMPERATURE_RANGE];
+  const bool restarted = evo_irimager_config_save(work, &config) == 0 && evo_irimager_config_apply_file(cfgId, work, &report) == 0 && report.restarted
+                         && refused.method == EVO_CONFIG_RESTART && refused.result == 0
+                         && report.outage == refused.outage + report.changes[EVO_CONFIG_PALETTE].outage;
+  std::printf("  %-18s %-8s %7.1f ms %12s   %s\n", "refused range", METHOD_NAMES[refused.method], refused.outage * 1e3, "-", restarted ? "" : "FAILED");
+  passed = passed && restarted;
+
+  // a camera that does not stream after the restart, nor with the previous file: the library has to be released
+  EvoIRReplayParams params;
+  evo_irimager_replay_get_params(&params);
+  params.frameLimit = 0;
+  config.framerate = 32.f;
+  bool released = evo_irimager_replay_set_params(&params) == 0 && evo_irimager_config_save(work, &config) == 0
+                  && evo_irimager_config_apply_file(cfgId, work, &report) != 0 && report.restarted && report.width == 0;
+  params.frameLimit = -1;
+  evo_irimager_replay_set_params(&params);
+  released = released && evo_irimager_usb_init(work, "", "") == 0;
+  std::printf("  %-18s %-8s %7.1f ms %12s   %s\n", "no frames", "restart", report.outage * 1e3, "-", released ? "released" : "FAILED");
+  passed = passed && released;
+  std::printf("%s\n", passed ? "passed" : "FAILED");
+
+  evo_irimager_config_detach(cfgId);
+  evo_irimager_terminate();
+  std::remove(work);
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,157 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRDaemonStandIn.cpp
+ * @brief Serves synthetic or recorded frames with the batched frame transport
+ *
+ * Stands in for a daemon with a camera attached, so the transport can be
+ * tested without hardware:
+ *
+ *   EvoIRDaemonStandIn [--port 1338] [--fps 80] [--size 382x288]
+ *                      [--recording file.evoir] [--no-shm] [--batch 16]
+ *                      [--history 64] [--all-interfaces]
+ *
+ * Recordings are looped and paced with --fps, or with the frame rate stored in
+ * the recording if --fps is not given. Server statistics are printed every
+ * second. Build together with the library sources, e.g. on Linux:
+ *
+ *   g++ -std=c++11 -O2 -pthread -I.. EvoIRDaemonStandIn.cpp ../EvoIRFrameServer.cpp
+ *       ../EvoIRSyntheticSource.cpp ../EvoIRRecording.cpp -lrt
+ */
+
+#include "EvoIRFrameTransport.h"
+#include "EvoIRSyntheticSource.h"
+#include "EvoIRRecording.h"
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+static std::atomic<bool> g_run(true);
+
+static void onSignal(int)
+{
+  g_run.store(false);
+}
+
+static void usage()
+{
+  std::printf("usage: EvoIRDaemonStandIn [--port n] [--fps f] [--size wxh] [--recording file] [--no-shm] [--batch n] [--history n] [--all-interfaces]\n");
+}
+
+int main(int argc, char* argv[])
+{
+  EvoIRServerParams params;
+  evo_irimager_server_default_params(&params);
+  float fps             = 0.f;
+  int w                 = 382;
+  int h                 = 288;
+  const char* recording = NULL;
+
+  for(int i = 1; i < argc; i++)
+  {
+    const bool hasValue = i + 1 < argc;
+    if(!std::strcmp(argv[i], "--port") && hasValue)                params.port = std::atoi(argv[++i]);
+    else if(!std::strcmp(argv[i], "--fps") && hasValue)            fps = (float)std::atof(argv[++i]);
+    else if(!std::strcmp(argv[i], "--size") && hasValue)           { if(std::sscanf(argv[++i], "%dx%d", &w, &h) != 2) { usage(); return 1; } }
+    else if(!std::strcmp(argv[i], "--recording") && hasValue)      recording = argv[++i];
+    else if(!std::strcmp(argv[i], "--no-shm"))                     params.sharedMemory = 0;
+    else if(!std::strcmp(argv[i], "--batch") && hasValue)          params.batchFrames = (unsigned int)std::atoi(argv[++i]);
+    else if(!std::strcmp(argv[i], "--history") && hasValue)        params.historyFrames = (unsigned int)std::atoi(argv[++i]);
+    else if(!std::strcmp(argv[i], "--all-interfaces"))             params.localOnly = 0;
+    else { usage(); return 1; }
+  }
+
+  unsigned int sourceId;
+  unsigned long long frames = 0;
+  if(recording)
+  {
+    EvoIRRecordingInfo info;
+    if(evo_irimager_recording_open(&sourceId, recording) != 0 || evo_irimager_recording_get_info(sourceId, &info) != 0 || info.frames == 0)
+    {
+      std::printf("cannot open recording %s\n", recording);
+      return 1;
+    }
+    w      = info.width;
+    h      = info.height;
+    frames = info.frames;
+    if(fps <= 0.f) fps = info.framerate;
+  }
+  else
+  {
+    if(fps <= 0.f) fps = 80.f;
+    EvoIRSyntheticParams synthetic;
+    evo_irimager_synthetic_default_params(&synthetic, w, h, fps);
+    synthetic.realtime = 0;
+    if(evo_irimager_synthetic_init(&sourceId, &synthetic) != 0)
+    {
+      std::printf("cannot create synthetic source %dx%d\n", w, h);
+      return 1;
+    }
+  }
+
+  unsigned int serverId;
+  if(evo_irimager_server_create(&serverId, w, h, &params) != 0)
+  {
+    std::printf("cannot listen on port %d\n", params.port);
+    return 1;
+  }
+  std::printf("serving %s frames %dx%d at %.1f Hz on port %d%s\n", recording ? "recorded" : "synthetic", w, h, fps, params.port,
+              params.sharedMemory ? ", shared memory enabled" : "");
+
+  std::signal(SIGINT, onSignal);
+  std::signal(SIGTERM, onSignal);
+
+  std::vector<unsigned short> data((size_t)w * h);
+  EvoIRFrameMetadata metadata;
+  const std::chrono::nanoseconds period((long long)(1e9 / fps));
+  std::chrono::steady_clock::time_point next   = std::chrono::steady_clock::now();
+  std::chrono::steady_clock::time_point report = next + std::chrono::seconds(1);
+  unsigned long long index = 0;
+
+  while(g_run.load())
+  {
+    int fw = w, fh = h;
+    const int ret = recording ? evo_irimager_recording_read_frame(sourceId, index++ % frames, &fw, &fh, &data[0], &metadata)
+                              : evo_irimager_synthetic_get_thermal_image_metadata(sourceId, &fw, &fh, &data[0], &metadata);
+    if(ret != 0)
+    {
+      std::printf("frame source failed\n");
+      break;
+    }
+
+    // pace on an absolute schedule, a late frame does not shift the following ones
+    next += period;
+    std::this_thread::sleep_until(next);
+    evo_irimager_server_publish(serverId, &data[0], &metadata);
+
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if(now >= report)
+    {
+      EvoIRServerStats stats;
+      evo_irimager_server_get_stats(serverId, &stats);
+      std::printf("published %llu, clients %u (%u shared memory), sent %llu in %llu batches, dropped %llu\n",
+                  stats.framesPublished, stats.clients, stats.sharedMemoryClients, stats.framesSent, stats.batchesSent, stats.framesDropped);
+      std::fflush(stdout);
+      report += std::chrono::seconds(1);
+    }
+    if(now > next + std::chrono::milliseconds(100)) next = now;
+  }
+
+  evo_irimager_server_destroy(serverId);
+  if(recording)
+    evo_irimager_recording_close(sourceId);
+  else
+    evo_irimager_synthetic_terminate(sourceId);
+  return 0;
+}
@@ -0,0 +1,203 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIREventCheck.cpp
+ * @brief Validation of the event recorder with injected hot events
+ *
+ * Runs an event recorder on a synthetic 382 x 288 source at 80 Hz without
+ * moving hotspots, which injects a spot heating up to tEvent above the
+ * background every few seconds. Afterwards every written recording is read
+ * back and checked:
+ *
+ * - frames are consecutive (EvoIRFrameMetadata::counter without gaps
+ *   except for the frames reported as lost)
+ * - the triggering frame follows the configured pre-trigger history and is
+ *   the first frame exceeding the threshold
+ * - the event ends the configured post-trigger period after the last frame
+ *   exceeding the threshold, unless it is the last one completed by stop
+ * - the trigger lies within the injected event
+ *
+ *   EvoIREventCheck [--seconds 20] [--interval 4] [--threshold 50] [--pre 1] [--post 1] [--prefix event_] [--fast]
+ *
+ * --fast delivers frames as fast as possible instead of in realtime, so the
+ * writer falls behind and frames get lost, but no event may be corrupted.
+ * Build e.g. on Linux:
+ *
+ *   g++ -std=c++11 -O2 -pthread -I.. EvoIREventCheck.cpp ../EvoIREventRecorder.cpp ../EvoIRRecording.cpp ../EvoIRSyntheticSource.cpp ../EvoIRBindingStub.cpp ../EvoIRPalette.cpp ../EvoIRFormatPlan.cpp
+ */
+
+#include "EvoIREventRecorder.h"
+#include "EvoIRRecording.h"
+#include "EvoIRSyntheticSource.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+static const int WIDTH      = 382;
+static const int HEIGHT     = 288;
+static const float FPS      = 80.f;
+static const float DURATION = 1.f;
+static const float T_EVENT  = 60.f;
+
+static int maximum(const std::vector<unsigned short>& data)
+{
+  int m = 0;
+  for(size_t i = 0; i < data.size(); i++)
+    if(data[i] > m) m = data[i];
+  return m;
+}
+
+// checks a written event, returns the number of failed checks; the last event may be cut short by stop
+static int check(const EvoIREventInfo& info, bool last, int rawThreshold, unsigned int pre, unsigned int post, float interval)
+{
+  unsigned int recId;
+  if(info.error != 0 || evo_irimager_recording_open(&recId, info.path) != 0)
+  {
+    std::printf("  %3llu %s: not readable\n", info.index, info.path);
+    return 1;
+  }
+  EvoIRRecordingInfo rec;
+  evo_irimager_recording_get_info(recId, &rec);
+
+  std::vector<unsigned short> data((size_t)WIDTH * HEIGHT);
+  int gaps = 0;
+  int firstAbove = -1, lastAbove = -1;
+  unsigned int lastCounter = 0;
+  double tTrigger = 0.0;
+  for(unsigned long long i = 0; i < rec.frames; i++)
+  {
+    int w = WIDTH, h = HEIGHT;
+    EvoIRFrameMetadata metadata;
+    if(evo_irimager_recording_read_frame(recId, i, &w, &h, &data[0], &metadata) != 0)
+    {
+      std::printf("  %3llu %s: frame %llu not readable\n", info.index, info.path, i);
+      evo_irimager_recording_close(recId);
+      return 1;
+    }
+    if(i > 0) gaps += (int)(metadata.counter - lastCounter - 1);
+    lastCounter = metadata.counter;
+    if(maximum(data) > rawThreshold)
+    {
+      if(firstAbove < 0) firstAbove = (int)i;
+      lastAbove = (int)i;
+    }
+    if(metadata.timestamp == info.timestampTrigger) tTrigger = (metadata.counterHW - 1) / FPS;
+  }
+  evo_irimager_recording_close(recId);
+
+  // time since the start of the injected event, which begins at a multiple of the interval
+  const double phase = tTrigger - std::floor(tTrigger / interval) * interval;
+  const bool history = info.preFrames == pre || (info.index > 0 && info.preFrames < pre);
+  const bool first   = firstAbove == (int)info.preFrames || info.lost > 0;
+  const bool tail    = lastAbove >= 0 && (unsigned long long)lastAbove + 1 + post == rec.frames;
+  const bool inside  = phase < DURATION || tTrigger == 0.0;
+  const int failed   = (gaps == (int)info.lost ? 0 : 1) + (history ? 0 : 1) + (first ? 0 : 1) + (tail || info.lost > 0 || last ? 0 : 1) + (inside ? 0 : 1);
+
+  std::printf("  %3llu %7llu %5u %5u %6.2f %9.3f %5d %s\n", info.index, rec.frames, info.preFrames, info.lost, tTrigger, phase, gaps,
+              failed ? "FAILED" : "ok");
+  return failed;
+}
+
+int main(int argc, char* argv[])
+{
+  float seconds   = 20.f;
+  float interval  = 4.f;
+  float threshold = 50.f;
+  float pre       = 1.f;
+  float post      = 1.f;
+  const char* prefix = "event_";
+  bool fast = false;
+  for(int i = 1; i < argc; i++)
+  {
+    const bool hasValue = i + 1 < argc;
+    if(!std::strcmp(argv[i], "--seconds") && hasValue)        seconds   = (float)std::atof(argv[++i]);
+    else if(!std::strcmp(argv[i], "--interval") && hasValue)  interval  = (float)std::atof(argv[++i]);
+    else if(!std::strcmp(argv[i], "--threshold") && hasValue) threshold = (float)std::atof(argv[++i]);
+    else if(!std::strcmp(argv[i], "--pre") && hasValue)       pre       = (float)std::atof(argv[++i]);
+    else if(!std::strcmp(argv[i], "--post") && hasValue)      post      = (float)std::atof(argv[++i]);
+    else if(!std::strcmp(argv[i], "--prefix") && hasValue)    prefix    = argv[++i];
+    else if(!std::strcmp(argv[i], "--fast"))                  fast      = true;
+    else
+    {
+      std::printf("usage: EvoIREventCheck [--seconds s] [--interval s] [--threshold t] [--pre s] [--post s] [--prefix path] [--fast]\n");
+      return 1;
+    }
+  }
+  if(seconds <= 0.f || interval <= DURATION) return 1;
+
+  EvoIRSyntheticParams synthetic;
+  evo_irimager_synthetic_default_params(&synthetic, WIDTH, HEIGHT, FPS);
+  synthetic.realtime      = fast ? 0 : 1;
+  synthetic.hotspots      = 0;
+  synthetic.eventInterval = interval;
+  synthetic.eventDuration = DURATION;
+  synthetic.tEvent        = T_EVENT;
+  unsigned int srcId;
+  if(evo_irimager_synthetic_init(&srcId, &synthetic) != 0) return 1;
+
+  EvoIREventParams params;
+  evo_irimager_event_default_params(&params, WIDTH, HEIGHT, FPS);
+  params.preTrigger  = pre;
+  params.postTrigger = post;
+  params.conditions[0].temperature = threshold;
+  unsigned int eventId;
+  if(evo_irimager_event_create(&eventId, &params, prefix) != 0 || evo_irimager_event_start_synthetic(eventId, srcId) != 0)
+  {
+    std::printf("cannot start event recorder\n");
+    return 1;
+  }
+
+  if(fast)
+  {
+    // run until the source has delivered the frames of the given period
+    EvoIREventStats stats;
+    do
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      evo_irimager_event_get_stats(eventId, &stats);
+    } while(stats.frames < (unsigned long long)(seconds * FPS));
+  }
+  else
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds((long long)(seconds * 1000.f)));
+  }
+  evo_irimager_event_stop(eventId);
+
+  EvoIREventStats stats;
+  EvoIREventInfo info;
+  const int rawThreshold = (int)std::floor((threshold + 100.0) * 10.0);
+  int failed = 0;
+  int events = 0;
+  std::printf("  %3s %7s %5s %5s %6s %9s %5s\n", "#", "frames", "pre", "lost", "t [s]", "phase [s]", "gaps");
+  // the writer completes the last event in the background, an event counted as written has been queued for poll
+  for(;;)
+  {
+    evo_irimager_event_get_stats(eventId, &stats);
+    while(evo_irimager_event_poll(eventId, &info) == 0)
+    {
+      failed += check(info, info.index + 1 == stats.events, rawThreshold, (unsigned int)std::ceil(pre * FPS - 1e-6), (unsigned int)std::ceil(post * FPS - 1e-6), interval);
+      events++;
+    }
+    if(stats.eventsWritten == stats.events) break;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  evo_irimager_event_destroy(eventId);
+  evo_irimager_synthetic_terminate(srcId);
+
+  const int expected = (int)std::floor((seconds - DURATION) / interval);
+  std::printf("frames %llu, triggers %llu, events %d of %d injected, lost events %llu, lost frames %llu, backlog max %u of %u slots (%.1f MB)\n",
+              stats.frames, stats.triggers, events, expected, stats.eventsLost, stats.framesLost, stats.backlogMax, stats.slots, stats.bytes / 1048576.0);
+  if(!fast && (events != expected || stats.framesLost > 0)) failed++;
+  std::printf("%s\n", failed ? "FAILED" : "passed");
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,259 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRFormatCheck.cpp
+ * @brief Round trip of every format of Formats.def and copy plans against a Def interpreter
+ *
+ * The file is read a second time here with a plain interpreter, which parses
+ * and executes the Def line of a sub-frame word by word on every call, the
+ * way unpacking worked without copy plans. For every format, channel and
+ * sub-frame a synthetic frame with random words and metadata is packed into
+ * a transfer by running the Def line backwards, the remaining transfer words
+ * are filled with noise. evo_irimager_formats_unpack has to restore frame and
+ * metadata exactly, and both have to equal the interpreter's output. Then
+ * unpacking all sub-frames of a transfer is timed with both:
+ *
+ *   EvoIRFormatCheck [--formats ../Formats.def] [--repeat 200] [--seed 1]
+ *
+ * Build e.g. on Linux:
+ *
+ *   g++ -std=c++11 -O2 -I.. EvoIRFormatCheck.cpp ../EvoIRFormatPlan.cpp
+ */
+
+#include "EvoIRFormatPlan.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+struct PlainChannel
+{
+  int width;
+  int height;
+  std::vector<std::string> defs;
+};
+
+struct PlainFormat
+{
+  std::string guid;
+  int inWidth;
+  int inHeight;
+  std::vector<PlainChannel> channels;
+};
+
+static std::string trim(const std::string& s)
+{
+  size_t b = 0, e = s.size();
+  while(b < e && (s[b] == ' ' || s[b] == '\t' || s[b] == '\r')) b++;
+  while(e > b && (s[e - 1] == ' ' || s[e - 1] == '\t' || s[e - 1] == '\r')) e--;
+  return s.substr(b, e - b);
+}
+
+static bool readFormats(const char* path, std::vector<PlainFormat>* formats)
+{
+  std::ifstream file(path);
+  if(!file) return false;
+  std::string line;
+  PlainFormat* format = nullptr;
+  while(std::getline(file, line))
+  {
+    const size_t hash = line.find('#');
+    if(hash != std::string::npos) line.erase(hash);
+    line = trim(line);
+    if(line == "[Format]")
+    {
+      formats->push_back(PlainFormat());
+      format = &formats->back();
+      continue;
+    }
+    if(line == "[Format end]") format = nullptr;
+    const size_t eq = line.find('=');
+    if(!format || eq == std::string::npos) continue;
+    const std::string key   = trim(line.substr(0, eq));
+    const std::string value = trim(line.substr(eq + 1));
+    if(key == "Guid") format->guid = value;
+    else if(key == "In") std::sscanf(value.c_str(), "%d %d", &format->inWidth, &format->inHeight);
+    else if(key == "Out")
+    {
+      PlainChannel c;
+      std::sscanf(value.c_str(), "%d %d", &c.width, &c.height);
+      format->channels.push_back(c);
+    }
+    else if(key == "Def" && !format->channels.empty()) format->channels.back().defs.push_back(value);
+  }
+  return true;
+}
+
+// Executes a Def line word by word. Unpacks transfer into frame and metadata, or packs them into transfer if pack is set.
+static void interpret(const std::string& def, unsigned short* transfer, unsigned short* frame, unsigned short* metadata, bool pack)
+{
+  const char* p = def.c_str();
+  unsigned int d = 0, m = 0;
+  while((p = std::strchr(p, '(')) != nullptr)
+  {
+    char* end;
+    unsigned long src = std::strtoul(p + 1, &end, 10);
+    const unsigned long count = std::strtoul(end, &end, 10);
+    const char* ops = end;
+    for(unsigned long k = 0; k < count; k++)
+    {
+      for(const char* o = ops; *o != ')'; )
+      {
+        while(*o == ' ') o++;
+        if(*o == ')') break;
+        const char type = *o;
+        const unsigned long n = std::strtoul(o + 2, &end, 10);
+        o = end;
+        for(unsigned long i = 0; i < n; i++, src++)
+        {
+          if(type == 'd')
+          {
+            if(pack) transfer[src] = frame[d];
+            else     frame[d] = transfer[src];
+            d++;
+          }
+          else if(type == 'm')
+          {
+            if(pack)          transfer[src] = metadata[m];
+            else if(metadata) metadata[m] = transfer[src];
+            m++;
+          }
+        }
+      }
+    }
+    p = std::strchr(p, ')');
+  }
+}
+
+static double seconds(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[])
+{
+  const char* path = "../Formats.def";
+  int repeat = 200;
+  unsigned int seed = 1;
+  for(int i = 1; i < argc; i++)
+  {
+    const bool hasValue = i + 1 < argc;
+    if(!std::strcmp(argv[i], "--formats") && hasValue)     path   = argv[++i];
+    else if(!std::strcmp(argv[i], "--repeat") && hasValue) repeat = std::atoi(argv[++i]);
+    else if(!std::strcmp(argv[i], "--seed") && hasValue)   seed   = (unsigned int)std::atoi(argv[++i]);
+    else
+    {
+      std::printf("usage: EvoIRFormatCheck [--formats path] [--repeat n] [--seed n]\n");
+      return 1;
+    }
+  }
+  if(repeat < 1) return 1;
+
+  unsigned int formatsId, count;
+  std::vector<PlainFormat> plain;
+  if(evo_irimager_formats_load(&formatsId, path) != 0 || !readFormats(path, &plain) ||
+     evo_irimager_formats_get_count(formatsId, &count) != 0)
+  {
+    std::printf("cannot load %s\n", path);
+    return 1;
+  }
+  if(count != plain.size())
+  {
+    std::printf("%u formats loaded, %u in file: FAILED\n", count, (unsigned int)plain.size());
+    return 1;
+  }
+
+  std::mt19937 rng(seed);
+  std::set<std::string> guids;
+  bool passed = true;
+  double tPlanTotal = 0.0, tPlainTotal = 0.0;
+  std::printf("%-40s %-26s %9s %9s %9s %7s\n", "GUID", "name", "copies", "plan us", "plain us", "speedup");
+  for(unsigned int f = 0; f < count; f++)
+  {
+    EvoIRFormatInfo info;
+    evo_irimager_formats_get_info(formatsId, f, &info);
+    const PlainFormat& pf = plain[f];
+    guids.insert(info.guid);
+    const size_t inWords = (size_t)info.inWidth * info.inHeight;
+    std::vector<unsigned short> transfer(inWords);
+    bool ok = pf.guid == info.guid && (int)pf.channels.size() == info.channels;
+
+    // round trip of every sub-frame
+    unsigned int copies = 0;
+    size_t maxOutWords = 0, maxMetadataWords = 0;
+    for(int c = 0; c < info.channels && ok; c++)
+    {
+      EvoIRFormatChannel channel;
+      ok = evo_irimager_formats_get_channel(formatsId, f, c, &channel) == 0 && (int)pf.channels[c].defs.size() == channel.subFrames;
+      const size_t outWords = (size_t)channel.width * channel.height;
+      std::vector<unsigned short> frame(outWords), meta(channel.metadataWords + 1);
+      std::vector<unsigned short> unpacked(outWords), unpackedMeta(channel.metadataWords + 1);
+      std::vector<unsigned short> plainFrame(outWords), plainMeta(channel.metadataWords + 1);
+      for(int s = 0; s < channel.subFrames && ok; s++)
+      {
+        for(size_t i = 0; i < inWords; i++)  transfer[i] = (unsigned short)rng();
+        for(size_t i = 0; i < outWords; i++) frame[i] = (unsigned short)rng();
+        for(size_t i = 0; i < meta.size(); i++) meta[i] = (unsigned short)rng();
+        interpret(pf.channels[c].defs[s], &transfer[0], &frame[0], &meta[0], true);
+        std::fill(unpacked.begin(), unpacked.end(), 0);
+        std::fill(unpackedMeta.begin(), unpackedMeta.end(), 0);
+        std::fill(plainMeta.begin(), plainMeta.end(), 0);
+        ok = evo_irimager_formats_unpack(formatsId, f, c, s, &transfer[0], &unpacked[0], &unpackedMeta[0]) == 0;
+        interpret(pf.channels[c].defs[s], &transfer[0], &plainFrame[0], &plainMeta[0], false);
+        ok = ok && unpacked == frame && plainFrame == frame
+             && std::equal(meta.begin(), meta.begin() + channel.metadataWords, unpackedMeta.begin()) && unpackedMeta == plainMeta;
+      }
+      copies += channel.copies * channel.subFrames;
+      maxOutWords      = std::max(maxOutWords, outWords);
+      maxMetadataWords = std::max(maxMetadataWords, (size_t)channel.metadataWords);
+    }
+    if(!ok)
+    {
+      std::printf("%-40s %-26.26s round trip FAILED\n", info.guid, info.name);
+      passed = false;
+      continue;
+    }
+
+    // all sub-frames of all channels of a transfer
+    std::vector<unsigned short> frame(maxOutWords), meta(maxMetadataWords + 1);
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    for(int r = 0; r < repeat; r++)
+    {
+      for(int c = 0; c < info.channels; c++)
+      {
+        EvoIRFormatChannel channel;
+        evo_irimager_formats_get_channel(formatsId, f, c, &channel);
+        for(int s = 0; s < channel.subFrames; s++)
+          evo_irimager_formats_unpack(formatsId, f, c, s, &transfer[0], &frame[0], &meta[0]);
+      }
+    }
+    const double tPlan = seconds(t0) / repeat;
+    t0 = std::chrono::steady_clock::now();
+    for(int r = 0; r < repeat; r++)
+      for(size_t c = 0; c < pf.channels.size(); c++)
+        for(size_t s = 0; s < pf.channels[c].defs.size(); s++)
+          interpret(pf.channels[c].defs[s], &transfer[0], &frame[0], &meta[0], false);
+    const double tPlain = seconds(t0) / repeat;
+    tPlanTotal  += tPlan;
+    tPlainTotal += tPlain;
+    std::printf("%-40s %-26.26s %9u %9.2f %9.2f %6.1fx\n", info.guid, info.name, copies, tPlan * 1e6, tPlain * 1e6, tPlain / tPlan);
+  }
+  evo_irimager_formats_release(formatsId);
+
+  std::printf("%u formats, %u GUIDs, all formats %.1f us plan versus %.1f us interpreter per transfer\n", count, (unsigned int)guids.size(),
+              tPlanTotal * 1e6, tPlainTotal * 1e6);
+  std::printf("%s\n", passed ? "passed" : "FAILED");
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,372 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRFrameRingCheck.cpp
+ * @brief Semantics and multi-reader stress of the frame ring, capture from a synthetic source
+ *
+ * First the ring is driven step by step through begin_write/end_write:
+ * NEXT and LATEST selection, timeouts, counter gaps counted as dropped (but
+ * not a counter running backwards), readers lagging behind recycled slots,
+ * rejected frames while consumers hold every slot, and held slots surviving
+ * the producer. Then a producer thread writes frames whose every pixel
+ * depends on the sequence number, while NEXT and LATEST readers, some of
+ * them holding frames for a while, check each acquired frame for tearing and
+ * its sequence number for order. Latency from end_write to acquire is
+ * reported per mode. Consumers blocked in acquire have to return -1 when the
+ * ring is destroyed. Last, a capture thread feeds the ring from a synthetic
+ * source as fast as it delivers:
+ *
+ *   EvoIRFrameRingCheck [--frames 20000] [--readers 4] [--seconds 1]
+ *
+ * Build e.g. on Linux:
+ *
+ *   g++ -std=c++11 -O2 -pthread -I.. EvoIRFrameRingCheck.cpp ../EvoIRFrameRing.cpp ../EvoIRSyntheticSource.cpp ../EvoIRBindingStub.cpp ../EvoIRFormatPlan.cpp ../EvoIRPalette.cpp ../EvoIRRecording.cpp
+ */
+
+#include "EvoIRFrameRing.h"
+#include "EvoIRSyntheticSource.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+static const int WIDTH  = 160;
+static const int HEIGHT = 120;
+
+static long long nowNs()
+{
+  return (long long)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static unsigned short pixel(unsigned long long seq, int i)
+{
+  return (unsigned short)(seq * 40503u + (unsigned int)i * 7u);
+}
+
+static bool intact(const unsigned short* data, unsigned long long seq)
+{
+  for(int i = 0; i < WIDTH * HEIGHT; i++)
+    if(data[i] != pixel(seq, i)) return false;
+  return true;
+}
+
+static double percentile(std::vector<double> values, double p)
+{
+  if(values.empty()) return 0.0;
+  const size_t k = std::min(values.size() - 1, (size_t)(p * values.size()));
+  std::nth_element(values.begin(), values.begin() + k, values.end());
+  return values[k];
+}
+
+// Writes frame seq of a manually fed ring, the producer knows the sequence number end_write assigns
+static bool write(unsigned int ringId, unsigned long long seq, unsigned int counter)
+{
+  unsigned short* data;
+  EvoIRFrameMetadata* metadata;
+  if(evo_irimager_ring_begin_write(ringId, &data, &metadata) != 0) return false;
+  for(int i = 0; i < WIDTH * HEIGHT; i++)
+    data[i] = pixel(seq, i);
+  std::memset(metadata, 0, sizeof(*metadata));
+  metadata->counter   = counter;
+  metadata->timestamp = nowNs();
+  return evo_irimager_ring_end_write(ringId, 1) == 0;
+}
+
+struct Acquired
+{
+  int ret;
+  unsigned long long seq;
+  unsigned short* data;
+  EvoIRFrameMetadata* metadata;
+  unsigned int slot;
+};
+
+static Acquired acquire(unsigned int ringId, int mode, unsigned long long last, int timeoutMs = 0)
+{
+  Acquired a;
+  a.seq = last;
+  a.ret = evo_irimager_ring_acquire(ringId, mode, timeoutMs, &a.seq, &a.data, &a.metadata, &a.slot);
+  return a;
+}
+
+static bool expect(bool condition, const char* what, bool* ok)
+{
+  if(!condition) std::printf("  %s FAILED\n", what);
+  *ok = *ok && condition;
+  return condition;
+}
+
+static bool checkSemantics()
+{
+  const unsigned int SLOTS = 4;
+  unsigned int ringId;
+  if(evo_irimager_ring_create(&ringId, WIDTH, HEIGHT, SLOTS) != 0) return false;
+  bool ok = true;
+  EvoIRRingStats stats;
+
+  expect(acquire(ringId, EVO_RING_NEXT, 0).ret == -3, "empty ring polls -3", &ok);
+  expect(write(ringId, 1, 10) && write(ringId, 2, 11) && write(ringId, 3, 14), "three frames written", &ok);
+  evo_irimager_ring_get_stats(ringId, &stats);
+  expect(stats.framesProduced == 3 && stats.lastSequence == 3 && stats.framesDropped == 2, "counter gap of 2 counted as dropped", &ok);
+
+  Acquired a = acquire(ringId, EVO_RING_NEXT, 0);
+  expect(a.ret == 0 && a.seq == 1 && a.metadata->counter == 10 && intact(a.data, 1), "NEXT from 0 yields oldest frame", &ok);
+  if(a.ret == 0) evo_irimager_ring_release(ringId, a.slot);
+  a = acquire(ringId, EVO_RING_NEXT, 1);
+  expect(a.ret == 0 && a.seq == 2 && intact(a.data, 2), "NEXT from 1 yields frame 2", &ok);
+  if(a.ret == 0) evo_irimager_ring_release(ringId, a.slot);
+  a = acquire(ringId, EVO_RING_LATEST, 0);
+  expect(a.ret == 0 && a.seq == 3 && a.metadata->counter == 14 && intact(a.data, 3), "LATEST yields newest frame", &ok);
+  if(a.ret == 0) evo_irimager_ring_release(ringId, a.slot);
+  expect(acquire(ringId, EVO_RING_NEXT, 3).ret == -3 && acquire(ringId, EVO_RING_LATEST, 3, 20).ret == -3, "no newer frame times out -3", &ok);
+
+  unsigned short* data;
+  EvoIRFrameMetadata* metadata;
+  expect(evo_irimager_ring_begin_write(ringId, &data, &metadata) == 0 && evo_irimager_ring_end_write(ringId, 0) == 0, "discarded write", &ok);
+  expect(write(ringId, 4, 0), "frame after reconnect written", &ok);
+  evo_irimager_ring_get_stats(ringId, &stats);
+  expect(stats.framesProduced == 4 && stats.lastSequence == 4 && stats.framesDropped == 2, "discard and counter running backwards not counted", &ok);
+
+  // 6 more frames recycle every slot, a reader at sequence 1 misses 2 to 6
+  for(unsigned long long s = 5; s <= 10; s++)
+    ok = write(ringId, s, (unsigned int)s) && ok;
+  a = acquire(ringId, EVO_RING_NEXT, 1);
+  expect(a.ret == 0 && a.seq == 7 && intact(a.data, 7), "lagging NEXT reader jumps to oldest held frame", &ok);
+
+  // frame 7 stays held while the producer cycles through the other slots
+  for(unsigned long long s = 11; s <= 30; s++)
+    ok = write(ringId, s, (unsigned int)s) && ok;
+  expect(a.ret == 0 && a.seq == 7 && intact(a.data, 7) && a.metadata->counter == 7, "held slot not overwritten", &ok);
+  Acquired latest = acquire(ringId, EVO_RING_LATEST, 0);
+  expect(latest.ret == 0 && latest.seq == 30 && intact(latest.data, 30), "LATEST next to a held slot", &ok);
+
+  // with every slot held the producer has to reject
+  Acquired held[2];
+  held[0] = acquire(ringId, EVO_RING_NEXT, 7);
+  held[1] = acquire(ringId, EVO_RING_NEXT, held[0].seq);
+  expect(held[0].ret == 0 && held[1].ret == 0 && held[0].seq < held[1].seq && held[1].seq < 30, "two more frames held", &ok);
+  expect(evo_irimager_ring_begin_write(ringId, &data, &metadata) == -1, "begin_write rejected with all slots held", &ok);
+  evo_irimager_ring_get_stats(ringId, &stats);
+  expect(stats.framesRejected == 1, "rejected frame counted", &ok);
+  for(int i = 0; i < 2; i++)
+    if(held[i].ret == 0) evo_irimager_ring_release(ringId, held[i].slot);
+  if(latest.ret == 0) evo_irimager_ring_release(ringId, latest.slot);
+  if(a.ret == 0) evo_irimager_ring_release(ringId, a.slot);
+  expect(a.ret == 0 && evo_irimager_ring_release(ringId, a.slot) == -1 && evo_irimager_ring_release(ringId, SLOTS) == -1, "release of unheld slots fails", &ok);
+  expect(write(ringId, 31, 31), "write after release", &ok);
+
+  evo_irimager_ring_destroy(ringId);
+  std::printf("%-44s %s\n", "acquire modes, drops, rejects, held slots", ok ? "ok" : "FAILED");
+  return ok;
+}
+
+struct ReaderResult
+{
+  unsigned long long frames;
+  unsigned long long skipped;
+  unsigned int torn;
+  unsigned int disordered;
+  std::vector<double> latency;
+  ReaderResult() : frames(0), skipped(0), torn(0), disordered(0) { }
+};
+
+static void reader(unsigned int ringId, int mode, bool hold, unsigned long long frames, const std::atomic<bool>* done, ReaderResult* result)
+{
+  unsigned long long seq = 0;
+  result->latency.reserve((size_t)frames);
+  while(seq < frames)
+  {
+    unsigned long long last = seq;
+    unsigned short* data;
+    EvoIRFrameMetadata* metadata;
+    unsigned int slot;
+    const int ret = evo_irimager_ring_acquire(ringId, mode, 100, &seq, &data, &metadata, &slot);
+    if(ret == -3 && !done->load()) continue;
+    if(ret != 0) break;
+    result->latency.push_back((nowNs() - metadata->timestamp) * 1e-3);
+    if(seq <= last) result->disordered++;
+    result->skipped += seq - last - 1;
+    result->frames++;
+    if(!intact(data, seq) || metadata->counter != (unsigned int)(seq + seq / 100 * 3)) result->torn++;
+    // some readers keep every 16th frame a while, so slots are held when the producer comes by
+    if(hold && seq % 16 == 0) std::this_thread::sleep_for(std::chrono::microseconds(200));
+    // the frame has to stay intact until it is released
+    if(hold && seq % 16 == 0 && !intact(data, seq)) result->torn++;
+    evo_irimager_ring_release(ringId, slot);
+  }
+}
+
+static bool checkStress(unsigned long long frames, int readers)
+{
+  const unsigned int SLOTS = 8;
+  unsigned int ringId;
+  if(evo_irimager_ring_create(&ringId, WIDTH, HEIGHT, SLOTS) != 0) return false;
+
+  std::atomic<bool> done(false);
+  std::vector<ReaderResult> results(2 * readers);
+  std::vector<std::thread> threads;
+  for(int r = 0; r < 2 * readers; r++)
+    threads.push_back(std::thread(reader, ringId, r < readers ? EVO_RING_NEXT : EVO_RING_LATEST, r % 2 == 1, frames, &done, &results[r]));
+
+  // every 100 frames 3 counters are skipped, as if the device lost frames
+  unsigned long long rejected = 0;
+  const long long start = nowNs();
+  for(unsigned long long s = 1; s <= frames; s++)
+  {
+    while(!write(ringId, s, (unsigned int)(s + s / 100 * 3)))
+    {
+      rejected++;
+      std::this_thread::yield();
+    }
+  }
+  const double seconds = (nowNs() - start) * 1e-9;
+  done.store(true);
+  for(size_t t = 0; t < threads.size(); t++)
+    threads[t].join();
+
+  EvoIRRingStats stats;
+  evo_irimager_ring_get_stats(ringId, &stats);
+  evo_irimager_ring_destroy(ringId);
+  bool ok = stats.framesProduced == frames && stats.lastSequence == frames && stats.framesRejected == rejected &&
+            stats.framesDropped == frames / 100 * 3;
+
+  std::printf("%llu frames %dx%d into %u slots in %.2f s (%.0f frames/s), %llu rejected, %llu dropped\n", frames, WIDTH, HEIGHT, SLOTS, seconds,
+              frames / seconds, stats.framesRejected, stats.framesDropped);
+  std::printf("  %-16s %10s %10s %8s %8s %10s %10s %10s\n", "reader", "frames", "skipped", "torn", "order", "median", "p99", "max");
+  for(int r = 0; r < 2 * readers; r++)
+  {
+    const ReaderResult& result = results[r];
+    char name[32];
+    std::snprintf(name, sizeof(name), "%s%s", r < readers ? "NEXT" : "LATEST", r % 2 == 1 ? " holding" : "");
+    const double max = result.latency.empty() ? 0.0 : *std::max_element(result.latency.begin(), result.latency.end());
+    std::printf("  %-16s %10llu %10llu %8u %8u %7.1f us %7.1f us %7.1f us\n", name, result.frames, result.skipped, result.torn, result.disordered,
+                percentile(result.latency, 0.5), percentile(result.latency, 0.99), max);
+    // every reader ends on the last frame, NEXT readers see every frame they did not skip
+    ok = ok && result.torn == 0 && result.disordered == 0 && result.frames > 0 && result.frames + result.skipped == frames;
+  }
+  std::printf("%-44s %s\n", "multi-reader stress", ok ? "ok" : "FAILED");
+  return ok;
+}
+
+static bool checkDestroy()
+{
+  unsigned int ringId;
+  if(evo_irimager_ring_create(&ringId, WIDTH, HEIGHT, 4) != 0) return false;
+  const int WAITERS = 4;
+  std::atomic<int> returned(0);
+  std::vector<int> ret(WAITERS, 0);
+  std::vector<std::thread> threads;
+  for(int w = 0; w < WAITERS; w++)
+  {
+    threads.push_back(std::thread([ringId, w, &ret, &returned]() {
+      // half of them wait infinitely, the others far beyond the check
+      ret[w] = acquire(ringId, EVO_RING_NEXT, 0, w % 2 ? -1 : 10000).ret;
+      returned.fetch_add(1);
+    }));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  bool ok = returned.load() == 0;
+  const long long start = nowNs();
+  ok = evo_irimager_ring_destroy(ringId) == 0 && ok;
+  for(int w = 0; w < WAITERS; w++)
+    threads[w].join();
+  const double ms = (nowNs() - start) * 1e-6;
+  for(int w = 0; w < WAITERS; w++)
+    ok = ok && ret[w] == -1;
+  ok = ok && ms < 1000.0 && acquire(ringId, EVO_RING_NEXT, 0).ret == -1 && evo_irimager_ring_destroy(ringId) == -1;
+  std::printf("%-44s %s (%.2f ms)\n", "destroy with blocked readers", ok ? "ok" : "FAILED", ms);
+  return ok;
+}
+
+static bool checkSynthetic(double seconds)
+{
+  EvoIRSyntheticParams params;
+  evo_irimager_synthetic_default_params(&params, 382, 288, 80.f);
+  params.realtime = 0;
+  params.dropRate = 0.01f;
+  unsigned int srcId, ringId;
+  if(evo_irimager_synthetic_init(&srcId, &params) != 0) return false;
+  if(evo_irimager_ring_create(&ringId, 382, 288, 8) != 0 || evo_irimager_ring_start_synthetic(ringId, srcId) != 0)
+  {
+    evo_irimager_synthetic_terminate(srcId);
+    return false;
+  }
+
+  // one reader in each mode, counters seen by NEXT have to increase
+  std::atomic<bool> stop(false);
+  unsigned long long consumed[2] = { 0, 0 };
+  bool ordered[2] = { true, true };
+  std::vector<std::thread> threads;
+  for(int m = 0; m < 2; m++)
+  {
+    threads.push_back(std::thread([ringId, m, &stop, &consumed, &ordered]() {
+      unsigned long long seq = 0;
+      unsigned int counter = 0;
+      while(!stop.load())
+      {
+        const unsigned long long last = seq;
+        Acquired a = acquire(ringId, m, last, 100);
+        if(a.ret == -3) continue;
+        if(a.ret != 0) break;
+        if(a.seq <= last || (consumed[m] > 0 && a.metadata->counter <= counter)) ordered[m] = false;
+        seq     = a.seq;
+        counter = a.metadata->counter;
+        consumed[m]++;
+        evo_irimager_ring_release(ringId, a.slot);
+      }
+    }));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds((int)(seconds * 1000)));
+  stop.store(true);
+  for(size_t t = 0; t < threads.size(); t++)
+    threads[t].join();
+  const bool stopped = evo_irimager_ring_stop(ringId) == 0;
+
+  EvoIRRingStats stats;
+  evo_irimager_ring_get_stats(ringId, &stats);
+  evo_irimager_ring_destroy(ringId);
+  evo_irimager_synthetic_terminate(srcId);
+
+  const bool ok = stopped && ordered[0] && ordered[1] && consumed[0] > 0 && consumed[1] > 0 && stats.framesProduced > 0 && stats.framesDropped > 0;
+  std::printf("synthetic 382x288: %.0f frames/s into the ring, %llu dropped by source, %llu rejected, NEXT %llu, LATEST %llu frames\n",
+              stats.framesProduced / seconds, stats.framesDropped, stats.framesRejected, consumed[0], consumed[1]);
+  std::printf("%-44s %s\n", "capture from synthetic source", ok ? "ok" : "FAILED");
+  return ok;
+}
+
+int main(int argc, char* argv[])
+{
+  unsigned long long frames = 20000;
+  int readers = 4;
+  double seconds = 1.0;
+  for(int i = 1; i < argc; i++)
+  {
+    const bool hasValue = i + 1 < argc;
+    if(!std::strcmp(argv[i], "--frames") && hasValue)       frames  = (unsigned long long)std::atoll(argv[++i]);
+    else if(!std::strcmp(argv[i], "--readers") && hasValue) readers = std::atoi(argv[++i]);
+    else if(!std::strcmp(argv[i], "--seconds") && hasValue) seconds = std::atof(argv[++i]);
+    else
+    {
+      std::printf("usage: EvoIRFrameRingCheck [--frames n] [--readers n] [--seconds s]\n");
+      return 1;
+    }
+  }
+  if(frames == 0 || readers < 1 || seconds <= 0.0) return 1;
+
+  bool passed = checkSemantics();
+  passed = checkStress(frames, readers) && passed;
+  passed = checkDestroy() && passed;
+  passed = checkSynthetic(seconds) && passed;
+  std::printf("%s\n", passed ? "passed" : "FAILED");
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,282 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRFusionBench.cpp
+ * @brief Pairing, registration accuracy and throughput of the thermal/visible fusion
+ *
+ * Simulates both bispectral modes of the PI 200/230: synthetic thermal frames
+ * of 160 x 120 at 96 Hz with 640 x 480 visible frames, and at 128 Hz with
+ * 596 x 447 visible frames, both at 32 Hz. Every visible frame is rendered
+ * from a thermal frame through a known homography (rotated, scaled and
+ * shifted against the plain scaling), its luma being the raw value mapped
+ * linearly, and pushed after the following thermal frames with a timestamp close
+ * to its source. Checked are:
+ *
+ * - every visible frame is paired with its source frame, and frames outside maxSkew are rejected
+ * - the registered thermal image mapped to luma matches the visible image
+ * - fused images of all instruction sets are identical
+ * - a fused image of both overlay modes, including the pushes, is made at least at 32 Hz
+ *
+ *   EvoIRFusionBench [--frames 320]
+ *
+ * Build e.g. on Linux:
+ *
+ *   g++ -std=c++11 -O2 -pthread -I.. EvoIRFusionBench.cpp ../EvoIRFusion.cpp ../EvoIRUndistort.cpp ../EvoIRRecording.cpp ../EvoIRPalette.cpp ../EvoIRSyntheticSource.cpp
+ */
+
+#include "EvoIRFusion.h"
+#include "EvoIRPalette.h"
+#include "EvoIRSyntheticSource.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+struct Mode
+{
+  float thermalRate;
+  int visibleWidth;
+  int visibleHeight;
+};
+
+static const int THERMAL_WIDTH  = 160;
+static const int THERMAL_HEIGHT = 120;
+static const float VISIBLE_RATE = 32.f;
+
+// visible frames are prepared once and replayed, so rendering them does not enter the measurement
+static const int PREPARED_VISIBLE = 8;
+
+static const char* const LEVELS[] = { "none", "sse4.1", "avx2" };
+
+// visible pixel onto thermal pixel
+static void project(const double* m, double x, double y, double* u, double* v)
+{
+  const double w = m[6] * x + m[7] * y + m[8];
+  *u = (m[0] * x + m[1] * y + m[2]) / w;
+  *v = (m[3] * x + m[4] * y + m[5]) / w;
+}
+
+static bool inside(double u, double v, double margin)
+{
+  return u >= margin && v >= margin && u <= THERMAL_WIDTH - 1 - margin && v <= THERMAL_HEIGHT - 1 - margin;
+}
+
+static double bilinear(const unsigned short* data, double u, double v)
+{
+  int x0 = (int)u;
+  int y0 = (int)v;
+  if(x0 > THERMAL_WIDTH - 2) x0 = THERMAL_WIDTH - 2;
+  if(y0 > THERMAL_HEIGHT - 2) y0 = THERMAL_HEIGHT - 2;
+  const double ax = u - x0;
+  const double ay = v - y0;
+  const unsigned short* p = data + y0 * THERMAL_WIDTH + x0;
+  return (1.0 - ay) * ((1.0 - ax) * p[0] + ax * p[1]) + ay * ((1.0 - ax) * p[THERMAL_WIDTH] + ax * p[THERMAL_WIDTH + 1]);
+}
+
+struct LumaMap
+{
+  double rawMin;
+  double rawMax;
+  double operator()(double raw) const { return std::min(255.0, std::max(0.0, (raw - rawMin) * 255.0 / (rawMax - rawMin))); }
+};
+
+static void renderVisible(const double* m, const LumaMap& luma, const unsigned short* thermal, int vw, int vh, unsigned short* yuyv)
+{
+  for(int y = 0; y < vh; y++)
+    for(int x = 0; x < vw; x++)
+    {
+      double u, v;
+      project(m, x, y, &u, &v);
+      const int value = inside(u, v, 0.0) ? (int)(luma(bilinear(thermal, u, v)) + 0.5) : 0;
+      yuyv[(size_t)y * vw + x] = (unsigned short)(value | (128 << 8));
+    }
+}
+
+static bool run(const Mode& mode, int frames)
+{
+  const int vw      = mode.visibleWidth;
+  const int vh      = mode.visibleHeight;
+  const int ratio   = (int)(mode.thermalRate / VISIBLE_RATE + 0.5f);
+  const size_t tPixels = (size_t)THERMAL_WIDTH * THERMAL_HEIGHT;
+  const size_t vPixels = (size_t)vw * vh;
+
+  EvoIRSyntheticParams synthetic;
+  evo_irimager_synthetic_default_params(&synthetic, THERMAL_WIDTH, THERMAL_HEIGHT, mode.thermalRate);
+  synthetic.realtime     = 0;
+  synthetic.flagInterval = 0.f;
+  synthetic.hotspots     = 3;
+  unsigned int srcId;
+  if(evo_irimager_synthetic_init(&srcId, &synthetic) != 0) return false;
+  const int thermalFrames = PREPARED_VISIBLE * ratio + 1;
+  std::vector<unsigned short> thermal(tPixels * thermalFrames);
+  std::vector<EvoIRFrameMetadata> thermalMetadata(thermalFrames);
+  for(int i = 0; i < thermalFrames; i++)
+  {
+    int w = THERMAL_WIDTH;
+    int h = THERMAL_HEIGHT;
+    evo_irimager_synthetic_get_thermal_image_metadata(srcId, &w, &h, &thermal[tPixels * i], &thermalMetadata[i]);
+  }
+  evo_irimager_synthetic_terminate(srcId);
+
+  // visible camera slightly rotated, with a wider field of view and shifted against the thermal one
+  EvoIRFusionParams params;
+  evo_irimager_fusion_default_params(&params, THERMAL_WIDTH, THERMAL_HEIGHT, vw, vh);
+  const double angle = 1.5 * 3.14159265358979 / 180.0;
+  const double s     = 1.08;
+  const double* d    = params.homography;
+  const double cx    = 0.5 * (THERMAL_WIDTH - 1);
+  const double cy    = 0.5 * (THERMAL_HEIGHT - 1);
+  const double r[4]  = { s * std::cos(angle), -s * std::sin(angle), s * std::sin(angle), s * std::cos(angle) };
+  // m = rotation/scale about the thermal center, shifted by (2.5, -1.75), after the plain scaling
+  double m[9] = { r[0] * d[0], r[1] * d[4], r[0] * d[2] + r[1] * d[5] + cx - r[0] * cx - r[1] * cy + 2.5,
+                  r[2] * d[0], r[3] * d[4], r[2] * d[2] + r[3] * d[5] + cy - r[2] * cx - r[3] * cy - 1.75,
+                  0.0, 0.0, 1.0 };
+  std::memcpy(params.homography, m, sizeof(m));
+  const long long thermalPeriod = (long long)(1e7 / mode.thermalRate);
+  params.maxSkew = thermalPeriod / 2;
+
+  EvoIRThermalStats stats;
+  evo_irimager_thermal_stats(&thermal[0], THERMAL_WIDTH, THERMAL_HEIGHT, &stats);
+  LumaMap luma;
+  luma.rawMin = stats.min;
+  luma.rawMax = stats.max + 1.0;
+
+  // visible frame j shows thermal frame j * ratio, captured 1 ms later
+  std::vector<unsigned short> visible(vPixels * PREPARED_VISIBLE);
+  std::vector<EvoIRFrameMetadata> visibleMetadata(PREPARED_VISIBLE);
+  for(int j = 0; j < PREPARED_VISIBLE; j++)
+  {
+    renderVisible(m, luma, &thermal[tPixels * j * ratio], vw, vh, &visible[vPixels * j]);
+    std::memset(&visibleMetadata[j], 0, sizeof(EvoIRFrameMetadata));
+    visibleMetadata[j].counter   = j;
+    visibleMetadata[j].timestamp = thermalMetadata[j * ratio].timestamp + 10000;
+  }
+
+  unsigned int fusionId;
+  const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  if(evo_irimager_fusion_create(&fusionId, &params) != 0) return false;
+  const double createMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+  std::printf("thermal %d x %d at %.0f Hz, visible %d x %d at %.0f Hz, table built in %.1f ms\n",
+              THERMAL_WIDTH, THERMAL_HEIGHT, mode.thermalRate, vw, vh, VISIBLE_RATE, createMs);
+
+  std::vector<unsigned short> registered(vPixels);
+  std::vector<unsigned char> fused(3 * vPixels);
+  EvoIRFusionInfo info;
+  bool ok = evo_irimager_fusion_get_fused(fusionId, &fused[0], &info) == -1;
+
+  // pairing and registration, visible frame pushed after the next thermal frame
+  int paired = 0, compared = 0;
+  double maxLuma = 0.0, sumLuma = 0.0;
+  for(int j = 0; j < PREPARED_VISIBLE; j++)
+  {
+    for(int k = 0; k < ratio; k++)
+      evo_irimager_fusion_push_thermal(fusionId, &thermal[tPixels * (j * ratio + k)], &thermalMetadata[j * ratio + k]);
+    if(j > 0)
+    {
+      evo_irimager_fusion_push_visible(fusionId, &visible[vPixels * (j - 1)], &visibleMetadata[j - 1]);
+      if(evo_irimager_fusion_get_registered_thermal(fusionId, &registered[0], &info) == 0 && info.thermal.counter == thermalMetadata[(j - 1) * ratio].counter
+         && info.visible.counter == visibleMetadata[j - 1].counter)
+        paired++;
+      for(int y = 0; y < vh; y++)
+        for(int x = 0; x < vw; x++)
+        {
+          double u, v;
+          project(m, x, y, &u, &v);
+          // the table rounds positions to 1/128 pixel
+          if(!inside(u, v, 0.01)) continue;
+          const double e = std::fabs(luma(registered[(size_t)y * vw + x]) - (visible[vPixels * (j - 1) + (size_t)y * vw + x] & 0xff));
+          maxLuma = std::max(maxLuma, e);
+          sumLuma += e;
+          compared++;
+        }
+    }
+  }
+  ok = ok && paired == PREPARED_VISIBLE - 1 && maxLuma <= 1.5;
+
+  // a visible frame far from all thermal frames of the history
+  EvoIRFrameMetadata late = visibleMetadata[0];
+  late.timestamp = thermalMetadata[thermalFrames - 1].timestamp + 4 * thermalPeriod;
+  evo_irimager_fusion_push_visible(fusionId, &visible[0], &late);
+  const bool rejected = evo_irimager_fusion_get_fused(fusionId, &fused[0], &info) == 1;
+  ok = ok && rejected;
+  std::printf("  pairing: %d of %d visible frames with their source, far frame rejected: %s\n", paired, PREPARED_VISIBLE - 1, rejected ? "yes" : "NO");
+  std::printf("  registration: %d pixels, |luma(registered) - visible| max %.2f mean %.3f\n", compared, maxLuma, compared ? sumLuma / compared : 0.0);
+
+  int supported;
+  evo_irimager_set_simd_level(2);
+  evo_irimager_get_simd_level(&supported);
+
+  // one visible period: the thermal frames, then the visible frame showing the first of them
+  auto pushPeriod = [&](int j) {
+    for(int k = 0; k < ratio; k++)
+      evo_irimager_fusion_push_thermal(fusionId, &thermal[tPixels * (j * ratio + k)], &thermalMetadata[j * ratio + k]);
+    evo_irimager_fusion_push_visible(fusionId, &visible[vPixels * j], &visibleMetadata[j]);
+  };
+  std::vector<unsigned char> reference[2];
+  std::printf("  %-6s %-6s %14s %12s %10s %9s\n", "simd", "mode", "us/registered", "us/fused", "fused fps", "identical");
+  for(int overlay = EVO_FUSION_BLEND; overlay <= EVO_FUSION_EDGES; overlay++)
+  {
+    evo_irimager_fusion_set_overlay(fusionId, overlay, params.alpha, 8, params.paletteId, params.scale, params.tMin, params.tMax);
+    for(int level = 0; level <= supported; level++)
+    {
+      evo_irimager_set_simd_level(level);
+      pushPeriod(PREPARED_VISIBLE - 1);
+      evo_irimager_fusion_get_fused(fusionId, &fused[0], &info);
+      if(level == 0) reference[overlay] = fused;
+      const bool identical = fused == reference[overlay];
+
+      int failed = 0;
+      std::chrono::steady_clock::time_point t = std::chrono::steady_clock::now();
+      for(int i = 0; i < frames; i++)
+        if(evo_irimager_fusion_get_registered_thermal(fusionId, &registered[0], &info) != 0) failed++;
+      const double usRegistered = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t).count() / frames;
+      t = std::chrono::steady_clock::now();
+      // pushes of one visible period and the accessor
+      for(int i = 0; i < frames; i++)
+      {
+        pushPeriod(i % PREPARED_VISIBLE);
+        if(evo_irimager_fusion_get_fused(fusionId, &fused[0], &info) != 0) failed++;
+      }
+      const double usFused = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t).count() / frames;
+      const double fps = 1e6 / usFused;
+      ok = ok && identical && failed == 0 && fps >= VISIBLE_RATE;
+      std::printf("  %-6s %-6s %14.1f %12.1f %10.1f %9s\n", LEVELS[level], overlay == EVO_FUSION_BLEND ? "blend" : "edges", usRegistered, usFused, fps,
+                  identical ? "yes" : "NO");
+    }
+  }
+  evo_irimager_set_simd_level(supported);
+  evo_irimager_fusion_destroy(fusionId);
+  return ok;
+}
+
+int main(int argc, char* argv[])
+{
+  int frames = 320;
+  for(int i = 1; i < argc; i++)
+  {
+    const bool hasValue = i + 1 < argc;
+    if(!std::strcmp(argv[i], "--frames") && hasValue) frames = std::atoi(argv[++i]);
+    else
+    {
+      std::printf("usage: EvoIRFusionBench [--frames n]\n");
+      return 1;
+    }
+  }
+  if(frames < 1) return 1;
+
+  const Mode modes[] = { { 96.f, 640, 480 }, { 128.f, 596, 447 } };
+  bool ok = true;
+  for(int i = 0; i < 2; i++)
+    ok = run(modes[i], frames) && ok;
+  std::printf("%s\n", ok ? "passed" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,490 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRHubBench.cpp
+ * @brief Correctness and CPU load of the publish/subscribe hub
+ *
+ * Checks, with frames of the synthetic source published by the caller:
+ *
+ * - received temperatures and palette images of whole images and crops equal
+ *   those computed directly, a representation nobody subscribed is not computed
+ * - subscribers at 10 and 30 Hz of an 80 Hz stream get their rate on average
+ * - a subscriber never receiving, or holding a frame forever, does not stop
+ *   publishing; it loses frames while the others get all of theirs
+ * - the acquisition thread of a synthetic source delivers until stopped and
+ *   unsubscribing wakes up a waiting receive
+ *
+ * Load: 640 x 480 frames are published at 80 Hz to a growing number of
+ * subscribers with a mix of a recorder (raw thermal, every frame), an HMI
+ * (palette image, 10 Hz) and an alarm (temperatures of a 160 x 120 crop,
+ * every frame), each with an own consumer thread. The process CPU time per
+ * frame is compared with subscribers receiving raw frames and converting
+ * them on their own:
+ *
+ *   EvoIRHubBench [--frames 240] [--max-subscribers 32]
+ *
+ * Build e.g. on Linux (the replay backend stands in for the camera functions):
+ *
+ *   g++ -std=c++11 -O2 -pthread -I.. EvoIRHubBench.cpp ../EvoIRHub.cpp ../EvoIRPalette.cpp ../EvoIRSyntheticSource.cpp ../EvoIRBindingStub.cpp ../EvoIRFormatPlan.cpp ../EvoIRRecording.cpp
+ */
+
+#include "EvoIRHub.h"
+#include "EvoIRPalette.h"
+#include "EvoIRSyntheticSource.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <thread>
+#include <vector>
+
+// publishing cycles through these, so the process CPU time of the load test leaves out the synthetic source
+static const int PREPARED_FRAMES = 32;
+
+// publish rate the 10 and 30 Hz subscribers are decimated from
+static const float RATE = 80.f;
+
+static const int W = 640;
+static const int H = 480;
+
+static const size_t PIXELS = (size_t)W * H;
+
+static std::vector<unsigned short> prepare()
+{
+  std::vector<unsigned short> frames(PIXELS * PREPARED_FRAMES);
+  EvoIRSyntheticParams synthetic;
+  evo_irimager_synthetic_default_params(&synthetic, W, H, RATE);
+  synthetic.realtime     = 0;
+  synthetic.flagInterval = 0.f;
+  synthetic.hotspots     = 4;
+  unsigned int srcId;
+  evo_irimager_synthetic_init(&srcId, &synthetic);
+  for(int i = 0; i < PREPARED_FRAMES; i++)
+  {
+    EvoIRFrameMetadata metadata;
+    int w = W, h = H;
+    evo_irimager_synthetic_get_thermal_image_metadata(srcId, &w, &h, &frames[PIXELS * i], &metadata);
+  }
+  evo_irimager_synthetic_terminate(srcId);
+  return frames;
+}
+
+static EvoIRFrameMetadata metadataOf(int k)
+{
+  EvoIRFrameMetadata metadata;
+  std::memset(&metadata, 0, sizeof(metadata));
+  metadata.counter   = k;
+  metadata.timestamp = (long long)(k * 1e7 / RATE);
+  return metadata;
+}
+
+static bool sameRows(const EvoIRHubFrame& frame, const void* reference, int referenceStride, size_t rowBytes)
+{
+  for(int y = 0; y < frame.height; y++)
+    if(std::memcmp((const unsigned char*)frame.data + (size_t)y * frame.stride, (const unsigned char*)reference + (size_t)y * referenceStride, rowBytes) != 0)
+      return false;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+
+static bool checkContent(const std::vector<unsigned short>& prepared)
+{
+  unsigned int hubId;
+  if(evo_irimager_hub_create(&hubId, W, H, 1) != 0) return false;
+  evo_irimager_hub_set_palette(hubId, 6, 2, 0.f, 0.f);
+
+  // whole images and two overlapping crops per representation, the crops are converted for their union
+  EvoIRHubSubscription subs[7];
+  evo_irimager_hub_default_subscription(&subs[0], EVO_HUB_THERMAL);
+  for(int r = EVO_HUB_CELSIUS; r <= EVO_HUB_PALETTE; r++)
+  {
+    EvoIRHubSubscription& whole = subs[3 * r - 2];
+    EvoIRHubSubscription& a     = subs[3 * r - 1];
+    EvoIRHubSubscription& b     = subs[3 * r];
+    evo_irimager_hub_default_subscription(&whole, r);
+    evo_irimager_hub_default_subscription(&a, r);
+    evo_irimager_hub_default_subscription(&b, r);
+    a.x = 16;  a.y = 40; a.width = 200; a.height = 100;
+    b.x = 150; b.y = 90; b.width = 333; b.height = 77;
+  }
+  unsigned int subIds[7];
+  // the whole image subscribers are added for the second half of the frames only
+  for(int i = 0; i < 7; i++)
+    if(i != 1 && i != 4 && evo_irimager_hub_subscribe(hubId, &subs[i], &subIds[i]) != 0) return false;
+
+  std::vector<float> celsius(PIXELS);
+  std::vector<unsigned char> palette(3 * PIXELS);
+  const int frames = 20;
+  int mismatches = 0;
+  for(int k = 0; k < frames; k++)
+  {
+    if(k == frames / 2)
+    {
+      if(evo_irimager_hub_subscribe(hubId, &subs[1], &subIds[1]) != 0 || evo_irimager_hub_subscribe(hubId, &subs[4], &subIds[4]) != 0) return false;
+    }
+    const unsigned short* data = &prepared[PIXELS * (k % PREPARED_FRAMES)];
+    const EvoIRFrameMetadata metadata = metadataOf(k);
+    evo_irimager_hub_publish(hubId, data, &metadata);
+
+    evo_irimager_thermal_to_celsius(data, W, H, 1, &celsius[0]);
+    EvoIRThermalStats stats;
+    evo_irimager_thermal_stats(data, W, H, &stats);
+    unsigned short rawMin, rawMax;
+    evo_irimager_palette_scale_range(&stats, 2, 0.f, 0.f, 1, &rawMin, &rawMax);
+    evo_irimager_palette_apply(data, W, H, 6, rawMin, rawMax, EVO_PALETTE_INTERLEAVED, &palette[0]);
+
+    for(int i = 0; i < 7; i++)
+    {
+      if((i == 1 || i == 4) && k < frames / 2) continue;
+      EvoIRHubFrame frame;
+      if(evo_irimager_hub_receive(hubId, subIds[i], 0, &frame) != 0)
+      {
+        mismatches++;
+        continue;
+      }
+      const size_t first = (size_t)frame.y * W + frame.x;
+      bool same = frame.sequence == (unsigned long long)k + 1 && frame.metadata.counter == (unsigned int)k;
+      if(frame.representation == EVO_HUB_THERMAL)
+        same = same && sameRows(frame, data + first, W * 2, frame.width * 2);
+      else if(frame.representation == EVO_HUB_CELSIUS)
+        same = same && sameRows(frame, &celsius[first], W * 4, frame.width * 4);
+      else
+        same = same && sameRows(frame, &palette[3 * first], W * 3, frame.width * 3);
+      if(!same) mismatches++;
+      evo_irimager_hub_release(hubId, subIds[i]);
+    }
+  }
+
+  EvoIRHubStats stats;
+  evo_irimager_hub_get_stats(hubId, &stats);
+  evo_irimager_hub_destroy(hubId);
+
+  // a hub without palette subscribers must not compute palette images
+  unsigned int lazyHubId, lazySubId;
+  EvoIRHubSubscription sub;
+  evo_irimager_hub_default_subscription(&sub, EVO_HUB_CELSIUS);
+  evo_irimager_hub_create(&lazyHubId, W, H, 1);
+  evo_irimager_hub_subscribe(lazyHubId, &sub, &lazySubId);
+  EvoIRHubStats lazy;
+  for(int k = 0; k < 10; k++)
+  {
+    const EvoIRFrameMetadata metadata = metadataOf(k);
+    evo_irimager_hub_publish(lazyHubId, &prepared[PIXELS * (k % PREPARED_FRAMES)], &metadata);
+    EvoIRHubFrame frame;
+    // frames dropped from the queue before being received are never converted
+    if(k % 2 == 0 && evo_irimager_hub_receive(lazyHubId, lazySubId, 0, &frame) == 0)
+      evo_irimager_hub_release(lazyHubId, lazySubId);
+  }
+  evo_irimager_hub_get_stats(lazyHubId, &lazy);
+  evo_irimager_hub_destroy(lazyHubId);
+
+  std::printf("  content: %d frames, mismatches %d, computed celsius %llu palette %llu of %llu, unused hub computed celsius %llu palette %llu of %llu\n",
+              frames, mismatches, stats.computed[EVO_HUB_CELSIUS], stats.computed[EVO_HUB_PALETTE], stats.published,
+              lazy.computed[EVO_HUB_CELSIUS], lazy.computed[EVO_HUB_PALETTE], lazy.published);
+  return mismatches == 0 && stats.computed[EVO_HUB_CELSIUS] == (unsigned long long)frames && stats.computed[EVO_HUB_PALETTE] == (unsigned long long)frames
+         && lazy.computed[EVO_HUB_PALETTE] == 0 && lazy.computed[EVO_HUB_CELSIUS] == 5;
+}
+
+static bool checkRates(const std::vector<unsigned short>& prepared)
+{
+  unsigned int hubId;
+  if(evo_irimager_hub_create(&hubId, W, H, 1) != 0) return false;
+  const float rates[] = { 0.f, 10.f, 30.f };
+  unsigned int subIds[3];
+  for(int i = 0; i < 3; i++)
+  {
+    EvoIRHubSubscription sub;
+    evo_irimager_hub_default_subscription(&sub, EVO_HUB_THERMAL);
+    sub.rate        = rates[i];
+    sub.queueFrames = 16;
+    evo_irimager_hub_subscribe(hubId, &sub, &subIds[i]);
+  }
+  // every 5th frame is missing from the stream, decimation follows the timestamps
+  const int frames = 800;
+  int published = 0;
+  for(int k = 0; k < frames; k++)
+  {
+    if(k % 5 == 4) continue;
+    const EvoIRFrameMetadata metadata = metadataOf(k);
+    evo_irimager_hub_publish(hubId, &prepared[PIXELS * (k % PREPARED_FRAMES)], &metadata);
+    published++;
+    for(int i = 0; i < 3; i++)
+    {
+      EvoIRHubFrame frame;
+      while(evo_irimager_hub_receive(hubId, subIds[i], 0, &frame) == 0)
+        evo_irimager_hub_release(hubId, subIds[i]);
+    }
+  }
+  bool ok = true;
+  std::printf("  rates: %d of %d frames at %.0f Hz published\n", published, frames, RATE);
+  for(int i = 0; i < 3; i++)
+  {
+    EvoIRHubSubscriberStats stats;
+    evo_irimager_hub_get_subscriber_stats(hubId, subIds[i], &stats);
+    const double expected = rates[i] > 0.f ? frames * rates[i] / RATE : published;
+    std::printf("    %4.0f Hz: delivered %llu, expected %.0f, dropped %llu\n", rates[i], stats.delivered, expected, stats.dropped);
+    ok = ok && std::abs((double)stats.delivered - expected) <= 1.0 && stats.dropped == 0;
+  }
+  evo_irimager_hub_destroy(hubId);
+  return ok;
+}
+
+static bool checkSlowSubscribers(const std::vector<unsigned short>& prepared)
+{
+  unsigned int hubId;
+  if(evo_irimager_hub_create(&hubId, W, H, 1) != 0) return false;
+  EvoIRHubSubscription sub;
+  evo_irimager_hub_default_subscription(&sub, EVO_HUB_CELSIUS);
+  unsigned int idle, holding, active;
+  evo_irimager_hub_subscribe(hubId, &sub, &idle);
+  evo_irimager_hub_subscribe(hubId, &sub, &holding);
+  sub.queueFrames = 1;
+  evo_irimager_hub_subscribe(hubId, &sub, &active);
+
+  const int frames = 200;
+  int received = 0, errors = 0;
+  EvoIRHubFrame held;
+  const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  for(int k = 0; k < frames; k++)
+  {
+    const EvoIRFrameMetadata metadata = metadataOf(k);
+    if(evo_irimager_hub_publish(hubId, &prepared[PIXELS * (k % PREPARED_FRAMES)], &metadata) != 0) errors++;
+    if(k == 0 && evo_irimager_hub_receive(hubId, holding, 0, &held) != 0) errors++;
+    EvoIRHubFrame frame;
+    if(evo_irimager_hub_receive(hubId, active, 0, &frame) == 0)
+    {
+      received += frame.metadata.counter == (unsigned int)k;
+      evo_irimager_hub_release(hubId, active);
+    }
+  }
+  const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+  // the frame held since the beginning is still intact
+  const bool intact = held.metadata.counter == 0 && std::fabs(((const float*)held.data)[W + 1] - (prepared[W + 1] / 10.f - 100.f)) < 1e-3f;
+  EvoIRHubSubscriberStats sIdle, sHolding;
+  evo_irimager_hub_get_subscriber_stats(hubId, idle, &sIdle);
+  evo_irimager_hub_get_subscriber_stats(hubId, holding, &sHolding);
+  evo_irimager_hub_destroy(hubId);
+  std::printf("  slow subscribers: %d frames in %.1f ms, received by active %d, dropped by idle %llu, by holding %llu, held frame intact %s\n",
+              frames, ms, received, sIdle.dropped, sHolding.dropped, intact ? "yes" : "no");
+  return errors == 0 && received == frames && intact && sIdle.dropped == (unsigned long long)frames - 2
+         && sHolding.dropped == (unsigned long long)frames - 3;
+}
+
+static bool checkAcquisition(const std::vector<unsigned short>& prepared)
+{
+  EvoIRSyntheticParams synthetic;
+  evo_irimager_synthetic_default_params(&synthetic, W, H, RATE);
+  unsigned int srcId, hubId, subId, waitId;
+  if(evo_irimager_synthetic_init(&srcId, &synthetic) != 0) return false;
+  evo_irimager_hub_create(&hubId, W, H, 1);
+  EvoIRHubSubscription sub;
+  evo_irimager_hub_default_subscription(&sub, EVO_HUB_PALETTE);
+  sub.rate = 20.f;
+  evo_irimager_hub_subscribe(hubId, &sub, &subId);
+  sub.rate = 0.5f;
+  evo_irimager_hub_subscribe(hubId, &sub, &waitId);
+
+  bool ok = evo_irimager_hub_start_synthetic(hubId, srcId) == 0 && evo_irimager_hub_start_synthetic(hubId, srcId) == -1;
+  const EvoIRFrameMetadata metadata = metadataOf(0);
+  ok = ok && evo_irimager_hub_publish(hubId, &prepared[0], &metadata) == -1;
+  int received = 0;
+  for(int i = 0; i < 10; i++)
+  {
+    EvoIRHubFrame frame;
+    if(evo_irimager_hub_receive(hubId, subId, 1000, &frame) == 0)
+    {
+      received++;
+      evo_irimager_hub_release(hubId, subId);
+    }
+  }
+  // the first frame was delivered, the next one is due in 2 s
+  EvoIRHubFrame frame;
+  if(evo_irimager_hub_receive(hubId, waitId, 0, &frame) == 0) evo_irimager_hub_release(hubId, waitId);
+  int waitResult = 0;
+  std::thread waiter([&]() { waitResult = evo_irimager_hub_receive(hubId, waitId, -1, &frame); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  evo_irimager_hub_unsubscribe(hubId, waitId);
+  waiter.join();
+  ok = ok && evo_irimager_hub_stop(hubId) == 0 && evo_irimager_hub_stop(hubId) == -1;
+  EvoIRHubStats stats;
+  evo_irimager_hub_get_stats(hubId, &stats);
+  evo_irimager_hub_destroy(hubId);
+  evo_irimager_synthetic_terminate(srcId);
+  std::printf("  acquisition: received %d of 10, published %llu, waiting receive after unsubscribe %d\n", received, stats.published, waitResult);
+  return ok && received == 10 && waitResult == -1;
+}
+
+//------------------------------------------------------------------------------
+// load
+//------------------------------------------------------------------------------
+
+struct Consumer
+{
+  int role;                      // 0 recorder, 1 HMI, 2 alarm
+  bool convert;                  // receives raw frames and converts them on its own
+  EvoIRHubSubscription sub;
+  unsigned int subId;
+  std::vector<float> celsius;
+  std::vector<unsigned char> palette;
+  double sink;
+};
+
+static void consume(unsigned int hubId, Consumer* c, const std::atomic<bool>* running)
+{
+  EvoIRHubFrame frame;
+  while(running->load())
+  {
+    if(evo_irimager_hub_receive(hubId, c->subId, 20, &frame) != 0) continue;
+    if(c->role == 0)
+    {
+      // a recorder touches every row
+      for(int y = 0; y < frame.height; y++)
+        c->sink += ((const unsigned short*)((const unsigned char*)frame.data + (size_t)y * frame.stride))[y % frame.width];
+    }
+    else if(c->role == 1)
+    {
+      const unsigned char* rgb = (const unsigned char*)frame.data;
+      if(c->convert)
+      {
+        const unsigned short* data = (const unsigned short*)frame.data;
+        EvoIRThermalStats stats;
+        evo_irimager_thermal_stats(data, W, H, &stats);
+        unsigned short rawMin, rawMax;
+        evo_irimager_palette_scale_range(&stats, 2, 0.f, 0.f, 1, &rawMin, &rawMax);
+        evo_irimager_palette_apply(data, W, H, 6, rawMin, rawMax, EVO_PALETTE_INTERLEAVED, &c->palette[0]);
+        rgb = &c->palette[0];
+      }
+      c->sink += rgb[3 * (PIXELS / 2)];
+    }
+    else
+    {
+      float tMax = -1000.f;
+      for(int y = 0; y < frame.height; y++)
+      {
+        const unsigned char* row = (const unsigned char*)frame.data + (size_t)y * frame.stride;
+        const float* t = (const float*)row;
+        if(c->convert)
+        {
+          evo_irimager_thermal_to_celsius((const unsigned short*)row, frame.width, 1, 1, &c->celsius[0]);
+          t = &c->celsius[0];
+        }
+        for(int x = 0; x < frame.width; x++) tMax = std::max(tMax, t[x]);
+      }
+      c->sink += tMax;
+    }
+    evo_irimager_hub_release(hubId, c->subId);
+  }
+}
+
+static bool measure(const std::vector<unsigned short>& prepared, int subscribers, bool convert, int frames, double* msPerFrame, double* computed, unsigned long long* dropped)
+{
+  unsigned int hubId;
+  if(evo_irimager_hub_create(&hubId, W, H, 1) != 0) return false;
+  evo_irimager_hub_set_palette(hubId, 6, 2, 0.f, 0.f);
+  std::vector<Consumer> consumers(subscribers);
+  for(int i = 0; i < subscribers; i++)
+  {
+    Consumer& c = consumers[i];
+    c.role    = i % 3;
+    c.convert = convert;
+    c.sink    = 0.0;
+    const int representation = c.role == 0 ? EVO_HUB_THERMAL : (c.role == 1 ? EVO_HUB_PALETTE : EVO_HUB_CELSIUS);
+    evo_irimager_hub_default_subscription(&c.sub, convert ? EVO_HUB_THERMAL : representation);
+    c.sub.queueFrames = 4;
+    if(c.role == 1) c.sub.rate = 10.f;
+    if(c.role == 2)
+    {
+      // alarm zones spread over the image, some overlap
+      const int zone = i / 3;
+      c.sub.x      = 80 * (zone % 7);
+      c.sub.y      = 60 * ((zone / 7) % 7);
+      c.sub.width  = 160;
+      c.sub.height = 120;
+    }
+    c.celsius.resize(160);
+    c.palette.resize(3 * PIXELS);
+    if(evo_irimager_hub_subscribe(hubId, &c.sub, &c.subId) != 0) return false;
+  }
+
+  std::atomic<bool> running(true);
+  std::vector<std::thread> threads;
+  for(int i = 0; i < subscribers; i++)
+    threads.push_back(std::thread(consume, hubId, &consumers[i], &running));
+
+  const std::clock_t cpu0 = std::clock();
+  std::chrono::steady_clock::time_point due = std::chrono::steady_clock::now();
+  for(int k = 0; k < frames; k++)
+  {
+    std::this_thread::sleep_until(due);
+    due += std::chrono::microseconds((long long)(1e6 / RATE));
+    const EvoIRFrameMetadata metadata = metadataOf(k);
+    evo_irimager_hub_publish(hubId, &prepared[PIXELS * (k % PREPARED_FRAMES)], &metadata);
+  }
+  // consumers catch up with the last frames
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  running.store(false);
+  for(size_t i = 0; i < threads.size(); i++) threads[i].join();
+  const std::clock_t cpu1 = std::clock();
+
+  EvoIRHubStats stats;
+  evo_irimager_hub_get_stats(hubId, &stats);
+  *dropped = 0;
+  for(int i = 0; i < subscribers; i++)
+  {
+    EvoIRHubSubscriberStats s;
+    evo_irimager_hub_get_subscriber_stats(hubId, consumers[i].subId, &s);
+    *dropped += s.dropped;
+  }
+  evo_irimager_hub_destroy(hubId);
+  *msPerFrame = 1000.0 * (cpu1 - cpu0) / CLOCKS_PER_SEC / frames;
+  *computed   = (double)(stats.computed[EVO_HUB_CELSIUS] + stats.computed[EVO_HUB_PALETTE]) / stats.published;
+  return stats.computed[EVO_HUB_CELSIUS] <= stats.published && stats.computed[EVO_HUB_PALETTE] <= stats.published;
+}
+
+int main(int argc, char* argv[])
+{
+  int frames         = 240;
+  int maxSubscribers = 32;
+  for(int i = 1; i < argc; i++)
+  {
+    const bool hasValue = i + 1 < argc;
+    if(!std::strcmp(argv[i], "--frames") && hasValue)               frames         = std::atoi(argv[++i]);
+    else if(!std::strcmp(argv[i], "--max-subscribers") && hasValue) maxSubscribers = std::atoi(argv[++i]);
+    else
+    {
+      std::printf("usage: EvoIRHubBench [--frames n] [--max-subscribers n]\n");
+      return 1;
+    }
+  }
+  if(frames < 1 || maxSubscribers < 1 || maxSubscribers > EVO_HUB_MAX_SUBSCRIBERS) return 1;
+
+  const std::vector<unsigned short> prepared = prepare();
+  std::printf("%d x %d\n", W, H);
+  bool ok = checkContent(prepared);
+  ok = checkRates(prepared) && ok;
+  ok = checkSlowSubscribers(prepared) && ok;
+  ok = checkAcquisition(prepared) && ok;
+
+  std::printf("  %11s %12s %12s %16s %12s %12s\n", "subscribers", "hub ms/frame", "conversions", "own ms/frame", "hub dropped", "own dropped");
+  for(int n = 1; n <= maxSubscribers; n *= 2)
+  {
+    double hubMs, ownMs, hubComputed, ownComputed;
+    unsigned long long hubDropped, ownDropped;
+    ok = measure(prepared, n, false, frames, &hubMs, &hubComputed, &hubDropped) && ok;
+    ok = measure(prepared, n, true, frames, &ownMs, &ownComputed, &ownDropped) && ok;
+    std::printf("  %11d %12.3f %12.2f %16.3f %12llu %12llu\n", n, hubMs, hubComputed, ownMs, hubDropped, ownDropped);
+  }
+  std::printf("%s\n", ok ? "passed" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,179 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRInstrumentationBench.cpp
+ * @brief Overhead of the instrumented accessors per frame and of the histogram per sample
+ *
+ * A camera of the replay backend (EvoIRReplay.h) with 8 x 8 images delivers
+ * frames as fast as possible, so the grab itself costs little next to the
+ * instrumentation. Blocks of calls to
+ * evo_irimager_multi_get_thermal_image_metadata are timed directly, through
+ * the instrumented twin with recording disabled and with recording enabled,
+ * taking turns; the overhead is the median difference to the direct block of
+ * the same round. The instrumented call records the call duration, skew,
+ * interval and jitter of every frame.
+ * Besides, record and recordExclusive of the histogram are timed per sample
+ * on durations spread over all buckets. Fails if recording adds 100 ns or
+ * more per frame:
+ *
+ *   EvoIRInstrumentationBench [--blocks 200] [--calls 2000] [--limit 100]
+ *
+ * Build e.g. on Linux:
+ *
+ *   g++ -std=c++11 -O2 -pthread -I.. EvoIRInstrumentationBench.cpp ../EvoIRInstrumentation.cpp ../EvoIRBindingStub.cpp ../EvoIRSyntheticSource.cpp ../EvoIRPalette.cpp ../EvoIRFormatPlan.cpp ../EvoIRRecording.cpp
+ */
+
+#include "direct_binding.h"
+#include "EvoIRInstrumentation.h"
+#include "EvoIRLogHistogram.h"
+#include "EvoIRReplay.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+static const int SIZE = 8;
+
+enum Mode
+{
+  DIRECT   = 0,
+  DISABLED = 1,
+  ENABLED  = 2,
+  MODES    = 3
+};
+
+static const char* const MODE_NAMES[MODES] = { "direct", "instrumented, disabled", "instrumented, enabled" };
+
+static double seconds(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static double median(std::vector<double> values)
+{
+  std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+  return values[values.size() / 2];
+}
+
+// Nanoseconds per call of a block
+static double block(int mode, unsigned int camId, int calls, unsigned short* data, bool* ok)
+{
+  EvoIRFrameMetadata metadata;
+  evo_irimager_instr_enable(mode == ENABLED ? 1 : 0);
+  const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  for(int i = 0; i < calls; i++)
+  {
+    int w = SIZE, h = SIZE;
+    const int ret = mode == DIRECT ? evo_irimager_multi_get_thermal_image_metadata(camId, &w, &h, data, &metadata)
+                                   : evo_irimager_instr_multi_get_thermal_image_metadata(camId, &w, &h, data, &metadata);
+    *ok = *ok && ret == 0;
+  }
+  return seconds(t0) * 1e9 / calls;
+}
+
+// Nanoseconds per sample of record (shared) or recordExclusive
+static double samples(evo::LogHistogram& histogram, const std::vector<unsigned long long>& values, int repeat, bool exclusive)
+{
+  const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  for(int r = 0; r < repeat; r++)
+  {
+    if(exclusive)
+      for(size_t i = 0; i < values.size(); i++) histogram.recordExclusive(values[i]);
+    else
+      for(size_t i = 0; i < values.size(); i++) histogram.recordValue(values[i]);
+  }
+  return seconds(t0) * 1e9 / ((double)values.size() * repeat);
+}
+
+int main(int argc, char* argv[])
+{
+  int blocks = 200;
+  int calls  = 2000;
+  double limit = 100.0;
+  for(int i = 1; i < argc; i++)
+  {
+    const bool hasValue = i + 1 < argc;
+    if(!std::strcmp(argv[i], "--blocks") && hasValue)     blocks = std::atoi(argv[++i]);
+    else if(!std::strcmp(argv[i], "--calls") && hasValue) calls  = std::atoi(argv[++i]);
+    else if(!std::strcmp(argv[i], "--limit") && hasValue) limit  = std::atof(argv[++i]);
+    else
+    {
+      std::printf("usage: EvoIRInstrumentationBench [--blocks n] [--calls n] [--limit ns]\n");
+      return 1;
+    }
+  }
+  if(blocks < 1 || calls < 1) return 1;
+
+  EvoIRReplayParams params;
+  evo_irimager_replay_default_params(&params);
+  params.formatIndex = -1;
+  params.width       = SIZE;
+  params.height      = SIZE;
+  params.realtime    = 0;
+  unsigned int camId;
+  if(evo_irimager_replay_set_params(&params) != 0 || evo_irimager_multi_usb_init(&camId, 0, 0, 0) != 0)
+  {
+    std::printf("cannot initialize replay camera\n");
+    return 1;
+  }
+
+  // the first enable calibrates the tick source, keep it out of the timing
+  std::vector<unsigned short> data(SIZE * SIZE);
+  bool ok = true;
+  for(int mode = 0; mode < MODES; mode++)
+    block(mode, camId, calls, &data[0], &ok);
+  evo_irimager_instr_reset();
+
+  std::vector<double> times[MODES];
+  for(int b = 0; b < blocks; b++)
+    for(int mode = 0; mode < MODES; mode++)
+      times[mode].push_back(block(mode, camId, calls, &data[0], &ok));
+  evo_irimager_instr_enable(0);
+  evo_irimager_multi_terminate(camId);
+
+  EvoIRInstrChannelStats stats;
+  ok = ok && evo_irimager_instr_get_channel_stats(0, &stats) == 0 && stats.frames == (unsigned long long)blocks * calls
+       && stats.metrics[EVO_INSTR_CALL].count == stats.calls;
+
+  // differences of neighbouring blocks cancel most of the drift of the machine
+  std::vector<double> enabled, disabled;
+  for(int b = 0; b < blocks; b++)
+  {
+    enabled.push_back(times[ENABLED][b] - times[DIRECT][b]);
+    disabled.push_back(times[DISABLED][b] - times[DIRECT][b]);
+  }
+  std::printf("%d x %d frames per mode, median of blocks of %d calls\n", blocks, calls, calls);
+  for(int mode = 0; mode < MODES; mode++)
+    std::printf("  %-24s %8.1f ns/frame\n", MODE_NAMES[mode], median(times[mode]));
+  const double overhead = median(enabled);
+  std::printf("  recording adds %.1f ns/frame, disabled twins %.1f ns/frame (limit %.0f ns)\n", overhead, median(disabled), limit);
+  std::printf("  call duration %.3f us median, %.3f us 99%%\n", stats.metrics[EVO_INSTR_CALL].p50, stats.metrics[EVO_INSTR_CALL].p99);
+
+  // durations from 1 ns to 1 s, uniform in the logarithm, cover all buckets in use
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<double> exponent(0.0, 30.0);
+  std::vector<unsigned long long> values(1 << 16);
+  for(size_t i = 0; i < values.size(); i++)
+    values[i] = evo::LogHistogram::fromNanoseconds((long long)std::pow(2.0, exponent(rng)));
+  evo::LogHistogram* histogram = new evo::LogHistogram();
+  samples(*histogram, values, 10, true);
+  const double exclusive = samples(*histogram, values, 200, true);
+  const double shared    = samples(*histogram, values, 200, false);
+  ok = ok && histogram->count() == values.size() * 410;
+  delete histogram;
+  std::printf("histogram: recordExclusive %.1f ns/sample, record %.1f ns/sample\n", exclusive, shared);
+
+  const bool passed = ok && overhead < limit;
+  std::printf("%s\n", passed ? "passed" : "FAILED");
+  return passed ? 0 : 1;
+}
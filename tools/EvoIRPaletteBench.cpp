@@ -0,0 +1,305 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRPaletteBench.cpp
+ * @brief Conversion, statistics and palette kernels against a scalar reference
+ *
+ * The reference is written the straightforward way: a float division per
+ * pixel for temperatures, two passes in double for the statistics and an
+ * interleaved image split into planes afterwards, as the MATLAB interface
+ * did. For synthetic 640 x 480 and 382 x 288 frames every instruction set of
+ * the processor (see evo_irimager_set_simd_level) is timed against it. The
+ * kernels must give bit-identical results on all instruction sets and match
+ * the reference: temperatures within 0.001 degree, exact minimum and maximum,
+ * palette colors at most one table entry apart:
+ *
+ *   EvoIRPaletteBench [--repeat 200] [--palette 3] [--scale 4] [--decimals 1]
+ *
+ * Build e.g. on Linux:
+ *
+ *   g++ -std=c++11 -O2 -pthread -I.. EvoIRPaletteBench.cpp ../EvoIRPalette.cpp ../EvoIRSyntheticSource.cpp
+ */
+
+#include "EvoIRPalette.h"
+#include "EvoIRSyntheticSource.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+static const int SIZES[][2] = { { 640, 480 }, { 382, 288 } };
+static const char* const LEVEL_NAMES[] = { "plain C++", "SSE4.1", "AVX2" };
+
+enum Kernel
+{
+  CELSIUS,
+  STATS,
+  INTERLEAVED,
+  PLANAR,
+  KERNELS
+};
+
+static const char* const KERNEL_NAMES[KERNELS] = { "to celsius", "statistics", "palette rgb", "palette planar" };
+
+struct Output
+{
+  std::vector<float> celsius;
+  EvoIRThermalStats stats;
+  std::vector<unsigned char> interleaved;
+  std::vector<unsigned char> planar;
+};
+
+//------------------------------------------------------------------------------
+// scalar reference
+//------------------------------------------------------------------------------
+
+static void referenceCelsius(const unsigned short* data, size_t n, short decimalPlaces, float* out)
+{
+  const double divisor = std::pow(10.0, decimalPlaces);
+  for(size_t i = 0; i < n; i++)
+    out[i] = (float)((double)data[i] / divisor - 100.0);
+}
+
+static void referenceStats(const unsigned short* data, size_t n, EvoIRThermalStats* stats)
+{
+  stats->min = 0xFFFF;
+  stats->max = 0;
+  double sum = 0.0;
+  for(size_t i = 0; i < n; i++)
+  {
+    if(data[i] < stats->min) stats->min = data[i];
+    if(data[i] > stats->max) stats->max = data[i];
+    sum += data[i];
+  }
+  stats->mean = sum / n;
+  double sq = 0.0;
+  for(size_t i = 0; i < n; i++)
+    sq += (data[i] - stats->mean) * (data[i] - stats->mean);
+  stats->sigma = std::sqrt(sq / n);
+}
+
+static int referenceIndex(unsigned short raw, unsigned short rawMin, unsigned short rawMax)
+{
+  if(rawMax == rawMin) return 0;
+  const float v = raw < rawMin ? rawMin : (raw > rawMax ? rawMax : raw);
+  return (int)((v - rawMin) * 255.f / (rawMax - rawMin));
+}
+
+static void referenceInterleaved(const unsigned short* data, size_t n, const unsigned char* colors, unsigned short rawMin, unsigned short rawMax,
+                                 unsigned char* out)
+{
+  for(size_t i = 0; i < n; i++)
+  {
+    const int idx = referenceIndex(data[i], rawMin, rawMax);
+    out[i * 3]     = colors[idx * 3];
+    out[i * 3 + 1] = colors[idx * 3 + 1];
+    out[i * 3 + 2] = colors[idx * 3 + 2];
+  }
+}
+
+static void referencePlanar(const unsigned short* data, size_t n, const unsigned char* colors, unsigned short rawMin, unsigned short rawMax,
+                            unsigned char* rgb, unsigned char* out)
+{
+  referenceInterleaved(data, n, colors, rawMin, rawMax, rgb);
+  for(size_t i = 0; i < n; i++)
+  {
+    out[i]         = rgb[i * 3];
+    out[n + i]     = rgb[i * 3 + 1];
+    out[2 * n + i] = rgb[i * 3 + 2];
+  }
+}
+
+//------------------------------------------------------------------------------
+
+static double seconds(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Colors of the kernel must equal the reference color or one of its neighbours in the table
+static bool colorsMatch(const unsigned short* data, size_t n, const unsigned char* colors, unsigned short rawMin, unsigned short rawMax,
+                        const unsigned char* out, size_t pixelStep, size_t planeStep)
+{
+  for(size_t i = 0; i < n; i++)
+  {
+    const int idx = referenceIndex(data[i], rawMin, rawMax);
+    bool found = false;
+    for(int k = (idx > 0 ? idx - 1 : 0); k <= (idx < 255 ? idx + 1 : 255) && !found; k++)
+      found = out[i * pixelStep] == colors[k * 3] && out[i * pixelStep + planeStep] == colors[k * 3 + 1]
+              && out[i * pixelStep + 2 * planeStep] == colors[k * 3 + 2];
+    if(!found) return false;
+  }
+  return true;
+}
+
+int main(int argc, char* argv[])
+{
+  int repeat = 200;
+  int paletteId = 3;
+  int scale = 4;
+  short decimalPlaces = 1;
+  for(int i = 1; i < argc; i++)
+  {
+    const bool hasValue = i + 1 < argc;
+    if(!std::strcmp(argv[i], "--repeat") && hasValue)        repeat        = std::atoi(argv[++i]);
+    else if(!std::strcmp(argv[i], "--palette") && hasValue)  paletteId     = std::atoi(argv[++i]);
+    else if(!std::strcmp(argv[i], "--scale") && hasValue)    scale         = std::atoi(argv[++i]);
+    else if(!std::strcmp(argv[i], "--decimals") && hasValue) decimalPlaces = (short)std::atoi(argv[++i]);
+    else
+    {
+      std::printf("usage: EvoIRPaletteBench [--repeat n] [--palette id] [--scale id] [--decimals n]\n");
+      return 1;
+    }
+  }
+  if(repeat < 1) return 1;
+
+  unsigned char colors[256 * 3];
+  if(evo_irimager_palette_get_colors(paletteId, colors) != 0)
+  {
+    std::printf("invalid palette %d\n", paletteId);
+    return 1;
+  }
+  int maxLevel;
+  evo_irimager_get_simd_level(&maxLevel);
+
+  bool passed = true;
+  for(size_t s = 0; s < sizeof(SIZES) / sizeof(SIZES[0]); s++)
+  {
+    const int w = SIZES[s][0];
+    const int h = SIZES[s][1];
+    const size_t n = (size_t)w * h;
+
+    EvoIRSyntheticParams params;
+    evo_irimager_synthetic_default_params(&params, w, h, 30.f);
+    params.realtime = 0;
+    params.hotspots = 3;
+    unsigned int srcId;
+    std::vector<unsigned short> data(n);
+    EvoIRFrameMetadata metadata;
+    int sw = w, sh = h;
+    if(evo_irimager_synthetic_init(&srcId, &params) != 0 ||
+       evo_irimager_synthetic_get_thermal_image_metadata(srcId, &sw, &sh, &data[0], &metadata) != 0)
+      return 1;
+    evo_irimager_synthetic_terminate(srcId);
+    // the synthetic source delivers one decimal place, (t + 100) * 10^d for the ones requested
+    const double factor = std::pow(10.0, decimalPlaces - 1);
+    for(size_t i = 0; i < n && decimalPlaces > 1; i++)
+      data[i] = (unsigned short)std::min(65535.0, data[i] * factor);
+
+    // reference
+    Output ref;
+    ref.celsius.resize(n);
+    ref.interleaved.resize(n * 3);
+    ref.planar.resize(n * 3);
+    std::vector<unsigned char> rgb(n * 3);
+    double tRef[KERNELS];
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    for(int r = 0; r < repeat; r++) referenceCelsius(&data[0], n, decimalPlaces, &ref.celsius[0]);
+    tRef[CELSIUS] = seconds(t0) / repeat;
+    t0 = std::chrono::steady_clock::now();
+    for(int r = 0; r < repeat; r++) referenceStats(&data[0], n, &ref.stats);
+    tRef[STATS] = seconds(t0) / repeat;
+    unsigned short rawMin, rawMax;
+    if(evo_irimager_palette_scale_range(&ref.stats, scale, 20.f, 40.f, decimalPlaces, &rawMin, &rawMax) != 0)
+    {
+      std::printf("invalid scale %d\n", scale);
+      return 1;
+    }
+    // statistics are included like in evo_irimager_palette_render
+    t0 = std::chrono::steady_clock::now();
+    for(int r = 0; r < repeat; r++)
+    {
+      referenceStats(&data[0], n, &ref.stats);
+      referenceInterleaved(&data[0], n, colors, rawMin, rawMax, &ref.interleaved[0]);
+    }
+    tRef[INTERLEAVED] = seconds(t0) / repeat;
+    t0 = std::chrono::steady_clock::now();
+    for(int r = 0; r < repeat; r++)
+    {
+      referenceStats(&data[0], n, &ref.stats);
+      referencePlanar(&data[0], n, colors, rawMin, rawMax, &rgb[0], &ref.planar[0]);
+    }
+    tRef[PLANAR] = seconds(t0) / repeat;
+
+    std::printf("%d x %d, palette %d, scale %d, raw range [%u; %u]\n", w, h, paletteId, scale, rawMin, rawMax);
+    std::printf("  %-15s %12s", "", "reference");
+    for(int level = EVO_SIMD_NONE; level <= maxLevel; level++) std::printf(" %20s", LEVEL_NAMES[level]);
+    std::printf("\n");
+
+    std::vector<Output> outputs(maxLevel + 1);
+    std::vector<std::vector<double> > times(maxLevel + 1, std::vector<double>(KERNELS));
+    for(int level = EVO_SIMD_NONE; level <= maxLevel; level++)
+    {
+      evo_irimager_set_simd_level(level);
+      Output& o = outputs[level];
+      o.celsius.resize(n);
+      o.interleaved.resize(n * 3);
+      o.planar.resize(n * 3);
+      bool ok = true;
+      t0 = std::chrono::steady_clock::now();
+      for(int r = 0; r < repeat; r++) ok = ok && evo_irimager_thermal_to_celsius(&data[0], w, h, decimalPlaces, &o.celsius[0]) == 0;
+      times[level][CELSIUS] = seconds(t0) / repeat;
+      t0 = std::chrono::steady_clock::now();
+      for(int r = 0; r < repeat; r++) ok = ok && evo_irimager_thermal_stats(&data[0], w, h, &o.stats) == 0;
+      times[level][STATS] = seconds(t0) / repeat;
+      t0 = std::chrono::steady_clock::now();
+      for(int r = 0; r < repeat; r++)
+        ok = ok && evo_irimager_palette_render(&data[0], w, h, paletteId, scale, 20.f, 40.f, decimalPlaces, EVO_PALETTE_INTERLEAVED, &o.interleaved[0]) == 0;
+      times[level][INTERLEAVED] = seconds(t0) / repeat;
+      t0 = std::chrono::steady_clock::now();
+      for(int r = 0; r < repeat; r++)
+        ok = ok && evo_irimager_palette_render(&data[0], w, h, paletteId, scale, 20.f, 40.f, decimalPlaces, EVO_PALETTE_PLANAR, &o.planar[0]) == 0;
+      times[level][PLANAR] = seconds(t0) / repeat;
+      if(!ok)
+      {
+        std::printf("  %s: call FAILED\n", LEVEL_NAMES[level]);
+        passed = false;
+      }
+    }
+    evo_irimager_set_simd_level(maxLevel);
+
+    for(int k = 0; k < KERNELS; k++)
+    {
+      std::printf("  %-15s %9.3f ms", KERNEL_NAMES[k], tRef[k] * 1e3);
+      for(int level = EVO_SIMD_NONE; level <= maxLevel; level++)
+        std::printf(" %9.3f ms (%5.1fx)", times[level][k] * 1e3, tRef[k] / times[level][k]);
+      std::printf("\n");
+    }
+
+    // all instruction sets identical
+    for(int level = EVO_SIMD_NONE + 1; level <= maxLevel; level++)
+    {
+      const Output& a = outputs[EVO_SIMD_NONE];
+      const Output& b = outputs[level];
+      const bool identical = std::memcmp(&a.celsius[0], &b.celsius[0], n * sizeof(float)) == 0 && a.stats.min == b.stats.min
+                             && a.stats.max == b.stats.max && a.stats.mean == b.stats.mean && a.stats.sigma == b.stats.sigma
+                             && a.interleaved == b.interleaved && a.planar == b.planar;
+      if(!identical) std::printf("  %s differs from plain C++: FAILED\n", LEVEL_NAMES[level]);
+      passed = passed && identical;
+    }
+
+    // against the reference
+    const Output& o = outputs[EVO_SIMD_NONE];
+    float maxError = 0.f;
+    for(size_t i = 0; i < n; i++) maxError = std::max(maxError, std::fabs(o.celsius[i] - ref.celsius[i]));
+    const bool celsiusOk = maxError <= 0.001f;
+    const bool statsOk = o.stats.min == ref.stats.min && o.stats.max == ref.stats.max && std::fabs(o.stats.mean - ref.stats.mean) < 1e-6
+                         && std::fabs(o.stats.sigma - ref.stats.sigma) < 1e-6;
+    const bool colorsOk = colorsMatch(&data[0], n, colors, rawMin, rawMax, &o.interleaved[0], 3, 1)
+                          && colorsMatch(&data[0], n, colors, rawMin, rawMax, &o.planar[0], 1, n);
+    std::printf("  max temperature error %.5f, statistics %s, colors %s\n", maxError, statsOk ? "exact" : "FAILED", colorsOk ? "match" : "FAILED");
+    passed = passed && celsiusOk && statsOk && colorsOk;
+  }
+
+  std::printf("%s\n", passed ? "passed" : "FAILED");
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,175 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRPipelineCheck.cpp
+ * @brief Stage counters and frame dropping of the acquire/convert/present pipeline
+ *
+ * A synthetic 382 x 288 source at 80 Hz in realtime mode feeds the pipeline,
+ * the caller simulates drawing by sleeping after every frame. For each
+ * drawing time it is checked that
+ *
+ * - acquisition keeps the frame rate of the source, i.e. presenting never
+ *   back-pressures capture
+ * - every delivered frame stems from one grab call: the counter of the
+ *   source advances exactly with the pipeline sequence
+ * - thermal image, statistics and palette image belong to the same frame
+ * - sequence gaps equal the frames dropped as stale and on queue overflow,
+ *   and acquired frames add up to delivered, dropped and in flight ones
+ *
+ * Drawing faster than the source must not drop any frame, drawing slower has
+ * to drop stale ones. Per stage timings are printed:
+ *
+ *   EvoIRPipelineCheck [--seconds 2] [--draw 5,20]
+ *
+ * Build e.g. on Linux:
+ *
+ *   g++ -std=c++11 -O2 -pthread -I.. EvoIRPipelineCheck.cpp ../EvoIRPipeline.cpp ../EvoIRSyntheticSource.cpp ../EvoIRPalette.cpp ../EvoIRTemporalFilter.cpp ../EvoIRBindingStub.cpp ../EvoIRFormatPlan.cpp ../EvoIRRecording.cpp
+ */
+
+#include "EvoIRPipeline.h"
+#include "EvoIRSyntheticSource.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+static const int WIDTH   = 382;
+static const int HEIGHT  = 288;
+static const float FPS   = 80.f;
+static const char* const STAGE_NAMES[] = { "acquire", "convert", "present" };
+
+static double seconds(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool run(double duration, int drawMs)
+{
+  EvoIRSyntheticParams sourceParams;
+  evo_irimager_synthetic_default_params(&sourceParams, WIDTH, HEIGHT, FPS);
+  sourceParams.realtime = 1;
+  unsigned int srcId, pipeId;
+  if(evo_irimager_synthetic_init(&srcId, &sourceParams) != 0) return false;
+
+  EvoIRPipelineParams params;
+  evo_irimager_pipeline_default_params(&params);
+  if(evo_irimager_pipeline_create(&pipeId, WIDTH, HEIGHT, &params) != 0 || evo_irimager_pipeline_start_synthetic(pipeId, srcId) != 0)
+  {
+    std::printf("draw %2d ms: start FAILED\n", drawMs);
+    return false;
+  }
+
+  std::vector<unsigned char> palette((size_t)WIDTH * HEIGHT * 3);
+  unsigned long long delivered = 0, gaps = 0, firstSequence = 0, lastSequence = 0;
+  unsigned int firstCounter = 0;
+  bool sameGrab = true, sameFrame = true, held = true;
+  const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  while(seconds(t0) < duration)
+  {
+    EvoIRPipelineFrame frame;
+    if(evo_irimager_pipeline_acquire_frame(pipeId, 1000, &frame) != 0) break;
+    if(delivered == 0)
+    {
+      firstSequence = frame.sequence;
+      firstCounter  = frame.metadata.counter;
+      // only one frame can be held
+      EvoIRPipelineFrame second;
+      held = evo_irimager_pipeline_acquire_frame(pipeId, 0, &second) == -1;
+    }
+    else
+    {
+      gaps += frame.sequence - lastSequence - 1;
+    }
+    lastSequence = frame.sequence;
+    delivered++;
+
+    sameGrab = sameGrab && frame.metadata.counter - firstCounter == frame.sequence - firstSequence;
+    EvoIRThermalStats stats;
+    evo_irimager_thermal_stats(frame.thermal, WIDTH, HEIGHT, &stats);
+    evo_irimager_palette_render(frame.thermal, WIDTH, HEIGHT, 6, 2, 20.f, 40.f, params.decimalPlaces, EVO_PALETTE_INTERLEAVED, &palette[0]);
+    sameFrame = sameFrame && stats.min == frame.stats.min && stats.max == frame.stats.max && stats.mean == frame.stats.mean
+                && stats.sigma == frame.stats.sigma && !std::memcmp(&palette[0], frame.palette, palette.size());
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(drawMs));
+    evo_irimager_pipeline_release_frame(pipeId, frame.buffer);
+  }
+  const double elapsed = seconds(t0);
+  evo_irimager_pipeline_stop(pipeId);
+
+  EvoIRPipelineFrame frame;
+  const bool stopped = evo_irimager_pipeline_acquire_frame(pipeId, 0, &frame) == -1;
+  EvoIRPipelineStats stats;
+  evo_irimager_pipeline_get_stats(pipeId, &stats);
+  evo_irimager_pipeline_destroy(pipeId);
+  evo_irimager_synthetic_terminate(srcId);
+
+  const EvoIRPipelineStageStats& acquire = stats.stages[EVO_PIPELINE_ACQUIRE];
+  const EvoIRPipelineStageStats& convert = stats.stages[EVO_PIPELINE_CONVERT];
+  const EvoIRPipelineStageStats& present = stats.stages[EVO_PIPELINE_PRESENT];
+  const double rate = acquire.frames / elapsed;
+
+  // frames in flight at stop: the convert queue and the mailbox
+  const unsigned long long accounted = present.frames + present.dropped + convert.dropped;
+  const bool counted = present.frames == delivered && convert.frames >= present.frames + present.dropped
+                       && acquire.frames >= accounted && acquire.frames - accounted <= params.queueFrames + 1
+                       && gaps <= present.dropped + convert.dropped && acquire.failed == 0;
+  const bool dropping = drawMs * FPS < 1000.f ? present.dropped + convert.dropped <= 1 : present.dropped > 0;
+  const bool passed = delivered > 0 && held && stopped && sameGrab && sameFrame && counted && dropping && rate > 0.95 * FPS;
+
+  std::printf("draw %2d ms: %.1f Hz acquired, %llu frames delivered, %llu stale, %llu overflow, latency %.2f ms mean %s\n", drawMs, rate,
+              delivered, present.dropped, convert.dropped, stats.latency.mean / 1000.0, passed ? "" : "FAILED");
+  if(!passed)
+    std::printf("  held %d, stopped %d, one grab per frame %d, same frame %d, counters %d, dropping %d\n", held, stopped, sameGrab, sameFrame,
+                counted, dropping);
+  for(int s = 0; s < EVO_PIPELINE_STAGES; s++)
+    std::printf("  %-8s %6llu frames, wait %8.1f us mean, busy %8.1f us mean, %8.1f us max\n", STAGE_NAMES[s], stats.stages[s].frames,
+                stats.stages[s].wait.mean, stats.stages[s].busy.mean, stats.stages[s].busy.max);
+  return passed;
+}
+
+int main(int argc, char* argv[])
+{
+  double duration = 2.0;
+  std::vector<int> draws;
+  for(int i = 1; i < argc; i++)
+  {
+    const bool hasValue = i + 1 < argc;
+    if(!std::strcmp(argv[i], "--seconds") && hasValue) duration = std::atof(argv[++i]);
+    else if(!std::strcmp(argv[i], "--draw") && hasValue)
+    {
+      for(const char* p = argv[++i]; *p; )
+      {
+        char* end;
+        const int ms = (int)std::strtol(p, &end, 10);
+        if(end == p) break;
+        draws.push_back(ms);
+        p = *end == ',' ? end + 1 : end;
+      }
+    }
+    else
+    {
+      std::printf("usage: EvoIRPipelineCheck [--seconds s] [--draw ms,ms,...]\n");
+      return 1;
+    }
+  }
+  if(draws.empty())
+  {
+    draws.push_back(5);
+    draws.push_back(20);
+  }
+  if(duration <= 0.0) return 1;
+
+  bool passed = true;
+  for(size_t i = 0; i < draws.size(); i++)
+    passed = run(duration, draws[i]) && passed;
+  std::printf("%s\n", passed ? "passed" : "FAILED");
+  return passed ? 0 : 1;
+}
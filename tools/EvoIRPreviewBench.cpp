@@ -0,0 +1,390 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRPreviewBench.cpp
+ * @brief Correctness, bandwidth and CPU time of the preview encoder
+ *
+ * Checks:
+ *
+ * - every level of the pyramid holds the minimum and maximum of the pixels
+ *   below it, for odd sizes too, equal for all instruction sets
+ * - a single hot pixel shows up in the maximum of the coarsest level
+ * - decoded overviews and regions equal the frames without threshold and
+ *   deviate at most by the threshold with it
+ * - with a byte budget no packet exceeds it, and after zooming into a new
+ *   region of a static scene the region is complete within a few frames,
+ *   after which packets carry nothing but the header
+ *
+ * Bandwidth and CPU time per frame at 80 Hz are compared for a static and a
+ * dynamic scene (moving hotspots) between full frames, raw and compressed
+ * with the codec of recordings, and the preview of an overview at level 2
+ * plus a 160 x 120 region, for 640 x 480 and 764 x 480 images:
+ *
+ *   EvoIRPreviewBench [--frames 400] [--hotspots 8]
+ *
+ * Build e.g. on Linux:
+ *
+ *   g++ -std=c++11 -O2 -pthread -I.. EvoIRPreviewBench.cpp ../EvoIRPreview.cpp ../EvoIRRecording.cpp ../EvoIRPalette.cpp ../EvoIRSyntheticSource.cpp
+ */
+
+#include "EvoIRPreview.h"
+#include "EvoIRPalette.h"
+#include "EvoIRRecording.h"
+#include "EvoIRSyntheticSource.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+static const char* const LEVELS[] = { "none", "sse4.1", "avx2" };
+
+// per scene, long enough for the dynamic scene's hotspots to keep changing tiles between packets
+static const int PREPARED_FRAMES = 64;
+
+// stream rate the bandwidth in kB/s and the share of the frame period refer to
+static const float RATE = 80.f;
+
+static const int REGION_WIDTH  = 160;
+static const int REGION_HEIGHT = 120;
+
+static std::vector<unsigned short> prepare(int w, int h, int hotspots, int frames)
+{
+  const size_t pixels = (size_t)w * h;
+  std::vector<unsigned short> prepared(pixels * frames);
+  EvoIRSyntheticParams synthetic;
+  evo_irimager_synthetic_default_params(&synthetic, w, h, RATE);
+  synthetic.realtime     = 0;
+  synthetic.flagInterval = 0.f;
+  synthetic.hotspots     = hotspots;
+  unsigned int srcId;
+  evo_irimager_synthetic_init(&srcId, &synthetic);
+  for(int i = 0; i < frames; i++)
+  {
+    EvoIRFrameMetadata metadata;
+    int fw = w, fh = h;
+    evo_irimager_synthetic_get_thermal_image_metadata(srcId, &fw, &fh, &prepared[pixels * i], &metadata);
+  }
+  evo_irimager_synthetic_terminate(srcId);
+  return prepared;
+}
+
+static EvoIRFrameMetadata metadataOf(int k)
+{
+  EvoIRFrameMetadata metadata;
+  std::memset(&metadata, 0, sizeof(metadata));
+  metadata.counter   = k;
+  metadata.timestamp = (long long)(k * 1e7 / RATE);
+  return metadata;
+}
+
+static int maxDeviation(const std::vector<unsigned short>& a, const std::vector<unsigned short>& b)
+{
+  int d = 0;
+  for(size_t i = 0; i < a.size(); i++) d = std::max(d, std::abs((int)a[i] - (int)b[i]));
+  return d;
+}
+
+//------------------------------------------------------------------------------
+
+static bool checkPyramid(int w, int h, int maxLevel)
+{
+  const int levels = EVO_PREVIEW_MAX_LEVELS;
+  std::vector<unsigned short> frame((size_t)w * h);
+  unsigned int seed = 4711u + w;
+  for(size_t i = 0; i < frame.size(); i++)
+  {
+    seed = seed * 1664525u + 1013904223u;
+    frame[i] = (unsigned short)(1200 + (seed >> 22));
+  }
+
+  int mismatches = 0, differences = 0;
+  std::vector<unsigned short> levelMin, levelMax;
+  std::vector<std::vector<unsigned short> > firstMin(levels), firstMax(levels);
+  for(int simd = 0; simd <= maxLevel; simd++)
+  {
+    evo_irimager_set_simd_level(simd);
+    EvoIRPreviewParams params;
+    evo_irimager_preview_default_params(&params, w, h);
+    params.levels = levels;
+    unsigned int encoderId, size;
+    evo_irimager_preview_encoder_create(&encoderId, &params);
+    std::vector<unsigned char> packet(evo_irimager_preview_max_packet_size(encoderId));
+    const EvoIRFrameMetadata metadata = metadataOf(0);
+    evo_irimager_preview_encode(encoderId, &frame[0], &metadata, &packet[0], (unsigned int)packet.size(), &size);
+    for(int l = 0; l < levels; l++)
+    {
+      int lw, lh;
+      evo_irimager_preview_level_size(w, h, l, &lw, &lh);
+      levelMin.assign((size_t)lw * lh, 0);
+      levelMax.assign((size_t)lw * lh, 0);
+      evo_irimager_preview_get_level(encoderId, l, &levelMin[0], &levelMax[0]);
+      if(simd == 0)
+      {
+        // every pixel covers a block of 2^l x 2^l pixels cut to the image
+        for(int y = 0; y < lh; y++)
+          for(int x = 0; x < lw; x++)
+          {
+            unsigned short lo = 0xFFFF, hi = 0;
+            for(int yy = y << l; yy < std::min(h, (y + 1) << l); yy++)
+              for(int xx = x << l; xx < std::min(w, (x + 1) << l); xx++)
+              {
+                lo = std::min(lo, frame[(size_t)yy * w + xx]);
+                hi = std::max(hi, frame[(size_t)yy * w + xx]);
+              }
+            if(levelMin[(size_t)y * lw + x] != lo || levelMax[(size_t)y * lw + x] != hi) mismatches++;
+          }
+        firstMin[l] = levelMin;
+        firstMax[l] = levelMax;
+      }
+      else if(levelMin != firstMin[l] || levelMax != firstMax[l])
+        differences++;
+    }
+    evo_irimager_preview_encoder_destroy(encoderId);
+  }
+  evo_irimager_set_simd_level(maxLevel);
+
+  // hot pixels at random positions, one at a time
+  EvoIRPreviewParams params;
+  evo_irimager_preview_default_params(&params, w, h);
+  params.levels = levels;
+  unsigned int encoderId, size;
+  evo_irimager_preview_encoder_create(&encoderId, &params);
+  std::vector<unsigned char> packet(evo_irimager_preview_max_packet_size(encoderId));
+  int lw, lh, lost = 0;
+  evo_irimager_preview_level_size(w, h, levels - 1, &lw, &lh);
+  levelMin.resize((size_t)lw * lh);
+  levelMax.resize((size_t)lw * lh);
+  const unsigned short hot = 4000; // above all background values
+  for(int k = 0; k < 50; k++)
+  {
+    std::vector<unsigned short> spot = frame;
+    seed = seed * 1664525u + 1013904223u;
+    const size_t i = (seed >> 8) % spot.size();
+    spot[i] = hot;
+    const EvoIRFrameMetadata metadata = metadataOf(k);
+    evo_irimager_preview_encode(encoderId, &spot[0], &metadata, &packet[0], (unsigned int)packet.size(), &size);
+    evo_irimager_preview_get_level(encoderId, levels - 1, &levelMin[0], &levelMax[0]);
+    const int x = (int)(i % w) >> (levels - 1), y = (int)(i / w) >> (levels - 1);
+    if(levelMax[(size_t)y * lw + x] != hot) lost++;
+  }
+  evo_irimager_preview_encoder_destroy(encoderId);
+
+  std::printf("  pyramid %d x %d: %d levels, mismatches with reference %d, instruction set differences %d, hot pixels lost in level %d: %d of 50\n",
+              w, h, levels, mismatches, differences, levels - 1, lost);
+  return mismatches == 0 && differences == 0 && lost == 0;
+}
+
+static bool checkRoundTrip(int w, int h, const std::vector<unsigned short>& prepared)
+{
+  const size_t pixels = (size_t)w * h;
+  bool ok = true;
+  for(int pass = 0; pass < 2; pass++)
+  {
+    EvoIRPreviewParams params;
+    evo_irimager_preview_default_params(&params, w, h);
+    params.tThreshold = pass == 0 ? 0.f : 1.f;
+    const int tolerance = pass == 0 ? 0 : 10;
+    unsigned int encoderId, decoderId, size;
+    evo_irimager_preview_encoder_create(&encoderId, &params);
+    evo_irimager_preview_decoder_create(&decoderId);
+    std::vector<unsigned char> packet(evo_irimager_preview_max_packet_size(encoderId));
+    int deviation = 0, errors = 0;
+    for(int k = 0; k < 120; k++)
+    {
+      // the view moves every 30 frames, the overview between levels 1 and 3
+      const int level = 1 + (k / 30) % 3;
+      const int x = (k / 30) * (w - REGION_WIDTH) / 3, y = (k / 30) * (h - REGION_HEIGHT) / 3;
+      if(k % 30 == 0) evo_irimager_preview_request(encoderId, level, x, y, REGION_WIDTH, REGION_HEIGHT);
+      const unsigned short* frame = &prepared[pixels * (k % PREPARED_FRAMES)];
+      const EvoIRFrameMetadata metadata = metadataOf(k);
+      EvoIRPreviewPacketInfo info;
+      if(evo_irimager_preview_encode(encoderId, frame, &metadata, &packet[0], (unsigned int)packet.size(), &size) != 0
+         || evo_irimager_preview_decode(decoderId, &packet[0], size, &info) != 0
+         || info.level != level || info.regionX != x || info.regionY != y || info.pending != 0 || info.metadata.counter != (unsigned int)k)
+      {
+        errors++;
+        continue;
+      }
+      int lw, lh;
+      evo_irimager_preview_level_size(w, h, level, &lw, &lh);
+      std::vector<unsigned short> encMin((size_t)lw * lh), encMax((size_t)lw * lh), decMin((size_t)lw * lh), decMax((size_t)lw * lh);
+      evo_irimager_preview_get_level(encoderId, level, &encMin[0], &encMax[0]);
+      evo_irimager_preview_decoder_get_level(decoderId, level, &decMin[0], &decMax[0]);
+      std::vector<unsigned short> region((size_t)REGION_WIDTH * REGION_HEIGHT), expected(region.size());
+      evo_irimager_preview_decoder_get_region(decoderId, x, y, REGION_WIDTH, REGION_HEIGHT, &region[0]);
+      for(int row = 0; row < REGION_HEIGHT; row++)
+        std::memcpy(&expected[(size_t)row * REGION_WIDTH], frame + (size_t)(y + row) * w + x, REGION_WIDTH * sizeof(unsigned short));
+      deviation = std::max(deviation, std::max(maxDeviation(encMin, decMin), std::max(maxDeviation(encMax, decMax), maxDeviation(expected, region))));
+    }
+    EvoIRPreviewStats stats;
+    evo_irimager_preview_get_stats(encoderId, &stats);
+    evo_irimager_preview_encoder_destroy(encoderId);
+    evo_irimager_preview_decoder_destroy(decoderId);
+    std::printf("  round trip, threshold %.0f C: %llu frames, %llu tiles sent, %llu unchanged, largest deviation %d raw, errors %d\n",
+                params.tThreshold, stats.frames, stats.tiles, stats.unchanged, deviation, errors);
+    ok = ok && errors == 0 && deviation <= tolerance;
+  }
+  return ok;
+}
+
+static bool checkBudget(int w, int h, const std::vector<unsigned short>& prepared)
+{
+  const size_t pixels = (size_t)w * h;
+  EvoIRPreviewParams params;
+  evo_irimager_preview_default_params(&params, w, h);
+  params.budget = 4096;
+  unsigned int encoderId, decoderId, size;
+  evo_irimager_preview_encoder_create(&encoderId, &params);
+  evo_irimager_preview_decoder_create(&decoderId);
+  std::vector<unsigned char> packet(evo_irimager_preview_max_packet_size(encoderId));
+  unsigned int largest = 0;
+  int frames[2] = { -1, -1 }, headerOnly = 0, deviation = 0;
+  for(int zoom = 0; zoom < 2; zoom++)
+  {
+    const int x = zoom == 0 ? 0 : w - REGION_WIDTH, y = zoom == 0 ? 0 : h - REGION_HEIGHT;
+    evo_irimager_preview_request(encoderId, 2, x, y, REGION_WIDTH, REGION_HEIGHT);
+    for(int k = 0; k < 100; k++)
+    {
+      const unsigned short* frame = &prepared[pixels * (k % PREPARED_FRAMES)];
+      const EvoIRFrameMetadata metadata = metadataOf(k);
+      EvoIRPreviewPacketInfo info;
+      evo_irimager_preview_encode(encoderId, frame, &metadata, &packet[0], (unsigned int)packet.size(), &size);
+      evo_irimager_preview_decode(decoderId, &packet[0], size, &info);
+      largest = std::max(largest, size);
+      if(frames[zoom] < 0 && info.pending == 0) frames[zoom] = k + 1;
+      if(frames[zoom] >= 0 && k >= frames[zoom] + 10)
+      {
+        headerOnly += size == 80;
+        std::vector<unsigned short> region((size_t)REGION_WIDTH * REGION_HEIGHT), expected(region.size());
+        evo_irimager_preview_decoder_get_region(decoderId, x, y, REGION_WIDTH, REGION_HEIGHT, &region[0]);
+        for(int row = 0; row < REGION_HEIGHT; row++)
+          std::memcpy(&expected[(size_t)row * REGION_WIDTH], frame + (size_t)(y + row) * w + x, REGION_WIDTH * sizeof(unsigned short));
+        deviation = std::max(deviation, maxDeviation(expected, region));
+      }
+    }
+  }
+  evo_irimager_preview_encoder_destroy(encoderId);
+  evo_irimager_preview_decoder_destroy(decoderId);
+  std::printf("  budget %u bytes, static scene: largest packet %u, complete after %d frames, after zooming %d frames, header only %d of %d, deviation %d raw\n",
+              params.budget, largest, frames[0], frames[1], headerOnly, 200 - 20 - frames[0] - frames[1], deviation);
+  return largest <= params.budget && frames[0] > 1 && frames[0] <= 20 && frames[1] > 1 && frames[1] <= 20
+         && headerOnly == 200 - 20 - frames[0] - frames[1] && deviation <= 10;
+}
+
+//------------------------------------------------------------------------------
+
+struct Result
+{
+  double bytes;  // per frame
+  double us;     // per frame
+};
+
+static Result measureFull(int w, int h, const std::vector<unsigned short>& prepared, int frames, bool compress)
+{
+  const size_t pixels = (size_t)w * h;
+  std::vector<unsigned char> out(evo_irimager_codec_max_size(w, h));
+  unsigned long long bytes = 0;
+  const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  for(int k = 0; k < frames; k++)
+  {
+    const unsigned short* frame = &prepared[pixels * (k % PREPARED_FRAMES)];
+    unsigned int size = (unsigned int)out.size();
+    if(compress) evo_irimager_codec_encode(frame, w, h, &out[0], &size);
+    else
+    {
+      size = (unsigned int)(pixels * sizeof(unsigned short));
+      std::memcpy(&out[0], frame, size);
+    }
+    bytes += size;
+  }
+  const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+  Result r = { (double)bytes / frames, us / frames };
+  return r;
+}
+
+static Result measurePreview(int w, int h, const std::vector<unsigned short>& prepared, int frames)
+{
+  const size_t pixels = (size_t)w * h;
+  EvoIRPreviewParams params;
+  evo_irimager_preview_default_params(&params, w, h);
+  unsigned int encoderId, size;
+  evo_irimager_preview_encoder_create(&encoderId, &params);
+  evo_irimager_preview_request(encoderId, 2, (w - REGION_WIDTH) / 2, (h - REGION_HEIGHT) / 2, REGION_WIDTH, REGION_HEIGHT);
+  std::vector<unsigned char> packet(evo_irimager_preview_max_packet_size(encoderId));
+  // the first packet carries the whole view, it is not part of the steady state
+  EvoIRFrameMetadata metadata = metadataOf(0);
+  evo_irimager_preview_encode(encoderId, &prepared[0], &metadata, &packet[0], (unsigned int)packet.size(), &size);
+  unsigned long long bytes = 0;
+  const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  for(int k = 1; k <= frames; k++)
+  {
+    metadata = metadataOf(k);
+    evo_irimager_preview_encode(encoderId, &prepared[pixels * (k % PREPARED_FRAMES)], &metadata, &packet[0], (unsigned int)packet.size(), &size);
+    bytes += size;
+  }
+  const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+  evo_irimager_preview_encoder_destroy(encoderId);
+  Result r = { (double)bytes / frames, us / frames };
+  return r;
+}
+
+static bool run(int w, int h, int frames, int hotspots, int maxLevel)
+{
+  std::printf("%d x %d\n", w, h);
+  bool ok = checkPyramid(w, h, maxLevel);
+  ok = checkPyramid(w - 1, h - 3, maxLevel) && ok;
+  const std::vector<unsigned short> staticScene  = prepare(w, h, 0, PREPARED_FRAMES);
+  const std::vector<unsigned short> dynamicScene = prepare(w, h, hotspots, PREPARED_FRAMES);
+  ok = checkRoundTrip(w, h, dynamicScene) && ok;
+  ok = checkBudget(w, h, staticScene) && ok;
+
+  std::printf("  %-8s %-16s %12s %12s %10s %8s\n", "scene", "stream", "bytes/frame", "kB/s", "us/frame", "period");
+  for(int scene = 0; scene < 2; scene++)
+  {
+    const std::vector<unsigned short>& prepared = scene == 0 ? staticScene : dynamicScene;
+    const Result results[3] = { measureFull(w, h, prepared, frames, false), measureFull(w, h, prepared, frames, true), measurePreview(w, h, prepared, frames) };
+    const char* const names[3] = { "full raw", "full compressed", "preview" };
+    for(int i = 0; i < 3; i++)
+      std::printf("  %-8s %-16s %12.0f %12.1f %10.1f %7.1f%%\n", scene == 0 ? "static" : "dynamic", names[i], results[i].bytes, results[i].bytes * RATE / 1000.0,
+                  results[i].us, results[i].us * RATE * 1e-4);
+    // the preview has to undercut compressed full frames in both scenes
+    ok = ok && results[2].bytes < results[1].bytes;
+  }
+  return ok;
+}
+
+int main(int argc, char* argv[])
+{
+  int frames   = 400;
+  int hotspots = 8;
+  for(int i = 1; i < argc; i++)
+  {
+    const bool hasValue = i + 1 < argc;
+    if(!std::strcmp(argv[i], "--frames") && hasValue)        frames   = std::atoi(argv[++i]);
+    else if(!std::strcmp(argv[i], "--hotspots") && hasValue) hotspots = std::atoi(argv[++i]);
+    else
+    {
+      std::printf("usage: EvoIRPreviewBench [--frames n] [--hotspots n]\n");
+      return 1;
+    }
+  }
+  if(frames < 1 || hotspots < 1) return 1;
+
+  int supported;
+  evo_irimager_set_simd_level(2);
+  evo_irimager_get_simd_level(&supported);
+  std::printf("instruction set %s\n", LEVELS[supported]);
+
+  bool ok = run(640, 480, frames, hotspots, supported);
+  ok = run(764, 480, frames, hotspots, supported) && ok;
+  std::printf("%s\n", ok ? "passed" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,198 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRRecordingBench.cpp
+ * @brief Write and read throughput of recordings on synthetic frames
+ *
+ * Frames of a synthetic source are generated up front, so only the recorder
+ * is timed. For every stream they are written compressed and raw on the
+ * calling thread, read back, compared and the file is reopened without its
+ * index footer to check recovery. Passes if the compressed recording keeps up
+ * with the frame rate of every stream on one core, the PI1M at 1000 Hz being
+ * the demanding one:
+ *
+ *   EvoIRRecordingBench [--frames 2000] [--file bench.evorec]
+ *
+ * Build e.g. on Linux:
+ *
+ *   g++ -std=c++11 -O2 -pthread -I.. EvoIRRecordingBench.cpp ../EvoIRRecording.cpp ../EvoIRSyntheticSource.cpp
+ */
+
+#include "EvoIRRecording.h"
+#include "EvoIRRecordingFormat.h"
+#include "EvoIRSyntheticSource.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+struct Stream
+{
+  const char* name;
+  int width;
+  int height;
+  float framerate;
+};
+
+static const Stream STREAMS[] = { { "PI1M", 72, 56, 1000.f }, { "PI450", 382, 288, 80.f }, { "PI640", 640, 480, 32.f } };
+
+static double seconds(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static long long fileSize(const char* path)
+{
+  FILE* f = fopen(path, "rb");
+  if(!f) return -1;
+  fseek(f, 0, SEEK_END);
+  const long long size = (long long)ftell(f);
+  fclose(f);
+  return size;
+}
+
+// Writes all frames, returns seconds spent in write and close, negative on error
+static double record(const char* path, const Stream& stream, bool compress, const std::vector<unsigned short>& frames,
+                     const std::vector<EvoIRFrameMetadata>& metadata)
+{
+  const size_t pixels = (size_t)stream.width * stream.height;
+  unsigned int recId;
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  if(evo_irimager_recorder_open(&recId, path, stream.width, stream.height, stream.framerate, compress ? 1 : 0) != 0) return -1.0;
+  for(size_t f = 0; f < metadata.size(); f++)
+  {
+    if(evo_irimager_recorder_write_frame(recId, &frames[f * pixels], &metadata[f]) != 0)
+    {
+      evo_irimager_recorder_close(recId);
+      return -1.0;
+    }
+  }
+  if(evo_irimager_recorder_close(recId) != 0) return -1.0;
+  return seconds(start);
+}
+
+// Reads all frames back and compares them, returns seconds spent in read, negative on error or mismatch
+static double playback(const char* path, const Stream& stream, const std::vector<unsigned short>& frames,
+                       const std::vector<EvoIRFrameMetadata>& metadata, int recovered)
+{
+  const size_t pixels = (size_t)stream.width * stream.height;
+  unsigned int recId;
+  if(evo_irimager_recording_open(&recId, path) != 0) return -1.0;
+  EvoIRRecordingInfo info;
+  bool ok = evo_irimager_recording_get_info(recId, &info) == 0 && info.frames == metadata.size() && info.recovered == recovered;
+
+  std::vector<unsigned short> data(pixels);
+  double read = 0.0;
+  for(size_t f = 0; f < metadata.size() && ok; f++)
+  {
+    int w = stream.width, h = stream.height;
+    EvoIRFrameMetadata meta;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    ok = evo_irimager_recording_read_frame(recId, f, &w, &h, &data[0], &meta) == 0;
+    read += seconds(start);
+    ok = ok && std::memcmp(&data[0], &frames[f * pixels], pixels * sizeof(unsigned short)) == 0
+         && std::memcmp(&meta, &metadata[f], sizeof(meta)) == 0;
+  }
+  evo_irimager_recording_close(recId);
+  return ok ? read : -1.0;
+}
+
+// Cuts off index footer and trailer, as if the recording process crashed before close
+static bool dropFooter(const char* path, const char* cutPath, long long frameBytes)
+{
+  FILE* in = fopen(path, "rb");
+  FILE* out = fopen(cutPath, "wb");
+  bool ok = in && out;
+  std::vector<char> buffer(1 << 16);
+  while(ok && frameBytes > 0)
+  {
+    const size_t n = fread(&buffer[0], 1, (size_t)(frameBytes < (long long)buffer.size() ? frameBytes : (long long)buffer.size()), in);
+    ok = n > 0 && fwrite(&buffer[0], 1, n, out) == n;
+    frameBytes -= (long long)n;
+  }
+  if(in) fclose(in);
+  if(out) fclose(out);
+  return ok;
+}
+
+int main(int argc, char* argv[])
+{
+  unsigned int count = 2000;
+  const char* path = "bench.evorec";
+  for(int i = 1; i < argc; i++)
+  {
+    const bool hasValue = i + 1 < argc;
+    if(!std::strcmp(argv[i], "--frames") && hasValue)    count = (unsigned int)std::atoi(argv[++i]);
+    else if(!std::strcmp(argv[i], "--file") && hasValue) path  = argv[++i];
+    else
+    {
+      std::printf("usage: EvoIRRecordingBench [--frames n] [--file path]\n");
+      return 1;
+    }
+  }
+  if(count == 0) return 1;
+  const std::string cutPath = std::string(path) + ".cut";
+
+  bool passed = true;
+  for(size_t s = 0; s < sizeof(STREAMS) / sizeof(STREAMS[0]); s++)
+  {
+    const Stream& stream = STREAMS[s];
+    const size_t pixels = (size_t)stream.width * stream.height;
+
+    EvoIRSyntheticParams params;
+    evo_irimager_synthetic_default_params(&params, stream.width, stream.height, stream.framerate);
+    params.realtime = 0;
+    unsigned int srcId;
+    if(evo_irimager_synthetic_init(&srcId, &params) != 0) return 1;
+    std::vector<unsigned short> frames(pixels * count);
+    std::vector<EvoIRFrameMetadata> metadata(count);
+    for(unsigned int f = 0; f < count; f++)
+    {
+      int w = stream.width, h = stream.height;
+      if(evo_irimager_synthetic_get_thermal_image_metadata(srcId, &w, &h, &frames[f * pixels], &metadata[f]) != 0) return 1;
+    }
+    evo_irimager_synthetic_terminate(srcId);
+
+    const double rawBytes = (double)count * pixels * sizeof(unsigned short);
+    for(int compress = 1; compress >= 0; compress--)
+    {
+      const double write = record(path, stream, compress != 0, frames, metadata);
+      const long long size = fileSize(path);
+      const double read = write < 0.0 ? -1.0 : playback(path, stream, frames, metadata, 0);
+      if(write < 0.0 || read < 0.0 || size <= 0)
+      {
+        std::printf("%-6s %4dx%-4d %s: FAILED (%s)\n", stream.name, stream.width, stream.height, compress ? "compressed" : "raw",
+                    write < 0.0 ? "write" : "read back");
+        passed = false;
+        continue;
+      }
+      const double writeFps = count / write;
+      std::printf("%-6s %4dx%-4d %-10s write %8.0f frames/s (%5.1fx %4.0f Hz, %6.1f MB/s), read %8.0f frames/s, ratio %.2f\n",
+                  stream.name, stream.width, stream.height, compress ? "compressed" : "raw", writeFps, writeFps / stream.framerate,
+                  stream.framerate, rawBytes / write / 1e6, count / read, rawBytes / size);
+      if(compress)
+      {
+        passed = passed && writeFps >= stream.framerate;
+
+        // recovery: index chunk and trailer removed
+        const long long footer = (long long)(sizeof(evo::RecordingChunkHeader) + count * sizeof(evo::RecordingIndexEntry) + sizeof(evo::RecordingTrailer));
+        const bool recovered = dropFooter(path, cutPath.c_str(), size - footer) && playback(cutPath.c_str(), stream, frames, metadata, 1) >= 0.0;
+        if(!recovered) std::printf("%-6s recovery without footer FAILED\n", stream.name);
+        passed = passed && recovered;
+      }
+    }
+  }
+  std::remove(path);
+  std::remove(cutPath.c_str());
+
+  std::printf("%s\n", passed ? "passed" : "FAILED");
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,356 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRRecordingMapCheck.cpp
+ * @brief Lookups of mapped recordings against a brute force scan of the frames
+ *
+ * Writes a synthetic recording whose timestamps jitter backwards and repeat,
+ * whose counter wraps past 0xFFFFFFFF and whose shutter flag cycles through
+ * all states, including invalid ones. Time, counter and flag run lookups of
+ * the map have to equal a plain scan over the written metadata, with
+ *
+ *   - a freshly built index, which is persisted
+ *   - the persisted index mapped from <recording>.idx
+ *   - index files with swapped, duplicated or wrong entries, to be rebuilt
+ *   - a replaced recording of equal size and first/last timestamp next to a stale index
+ *   - a recording whose index footer fails its CRC, to be recovered by scanning
+ *
+ *   EvoIRRecordingMapCheck [--frames 3000] [--queries 2000] [--seed 1] [--file check.evoir]
+ *
+ * Build e.g. on Linux:
+ *
+ *   g++ -std=c++11 -O2 -pthread -I.. EvoIRRecordingMapCheck.cpp ../EvoIRRecordingMap.cpp ../EvoIRRecording.cpp
+ */
+
+#include "EvoIRRecordingMap.h"
+#include "EvoIRRecordingFormat.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace evo;
+
+static const int WIDTH  = 32;
+static const int HEIGHT = 24;
+
+static long long distance(long long a, long long b)
+{
+  return a < b ? b - a : a - b;
+}
+
+// Metadata of a recording with non-monotonic timestamps, a counter wrap and flag cycles
+static std::vector<EvoIRFrameMetadata> makeMetadata(unsigned int frames, std::mt19937& rng)
+{
+  std::vector<EvoIRFrameMetadata> metadata(frames);
+  long long t = 1000000000LL;
+  unsigned int counter = 0xFFFFFFFFu - frames / 2;
+  const int cycle[] = { irFlagOpen, irFlagClosing, irFlagClose, irFlagOpening };
+  int phase = 0, left = 1;
+  for(unsigned int f = 0; f < frames; f++)
+  {
+    EvoIRFrameMetadata& m = metadata[f];
+    std::memset(&m, 0, sizeof(m));
+    // steps of 37 ms jitter by up to +-50 ms, some frames repeat the previous time
+    const unsigned int r = rng() % 16;
+    if(r == 0)      t += 0;
+    else if(r == 1) t -= (long long)(rng() % 500000);
+    else            t += 370370 + (long long)(rng() % 500000) - 250000;
+    m.timestamp = (f == 0 || f + 1 == frames) ? 1000000000LL + (long long)f * 370370 : t;
+    // counter wraps, drops frames and sometimes repeats
+    m.counter = counter;
+    counter += (rng() % 8 == 0) ? 0 : 1 + rng() % 3;
+    if(--left == 0)
+    {
+      phase = (phase + 1) % 4;
+      left  = 1 + (int)(rng() % 40);
+    }
+    m.flagState = (EvoIRFlagState)cycle[phase];
+    if(rng() % 97 == 0) m.flagState = (EvoIRFlagState)(irFlagError + rng() % 2);
+    if(rng() % 211 == 0) m.flagState = (EvoIRFlagState)(7 + rng() % 5); // invalid, indexed as irFlagError
+  }
+  return metadata;
+}
+
+static bool writeRecording(const char* path, const std::vector<EvoIRFrameMetadata>& metadata)
+{
+  unsigned int recId;
+  if(evo_irimager_recorder_open(&recId, path, WIDTH, HEIGHT, 27.f, 0) != 0) return false;
+  std::vector<unsigned short> data((size_t)WIDTH * HEIGHT);
+  bool ok = true;
+  for(size_t f = 0; f < metadata.size() && ok; f++)
+  {
+    for(size_t i = 0; i < data.size(); i++)
+      data[i] = (unsigned short)(f * 7 + i);
+    ok = evo_irimager_recorder_write_frame(recId, &data[0], &metadata[f]) == 0;
+  }
+  return evo_irimager_recorder_close(recId) == 0 && ok;
+}
+
+static bool readFile(const std::string& path, std::vector<unsigned char>* bytes)
+{
+  FILE* f = fopen(path.c_str(), "rb");
+  if(!f) return false;
+  const long long size = recordingFileSize(f);
+  bytes->resize(size > 0 ? (size_t)size : 0);
+  bool ok = size > 0 && recordingSeek(f, 0) == 0 && fread(&(*bytes)[0], 1, bytes->size(), f) == bytes->size();
+  fclose(f);
+  return ok;
+}
+
+static bool writeFile(const std::string& path, const std::vector<unsigned char>& bytes)
+{
+  FILE* f = fopen(path.c_str(), "wb");
+  if(!f) return false;
+  const bool ok = fwrite(&bytes[0], 1, bytes.size(), f) == bytes.size();
+  return (fclose(f) == 0) && ok;
+}
+
+static unsigned int stateOf(const EvoIRFrameMetadata& m)
+{
+  return (unsigned int)m.flagState < INDEX_FLAG_STATES ? (unsigned int)m.flagState : (unsigned int)irFlagError;
+}
+
+// Compares every lookup of an open map with a scan over the metadata
+static bool compare(unsigned int mapId, const std::vector<EvoIRFrameMetadata>& metadata, unsigned int queries, std::mt19937& rng)
+{
+  const unsigned int n = (unsigned int)metadata.size();
+  long long tMin = metadata[0].timestamp, tMax = metadata[0].timestamp;
+  for(unsigned int f = 0; f < n; f++)
+  {
+    tMin = std::min(tMin, metadata[f].timestamp);
+    tMax = std::max(tMax, metadata[f].timestamp);
+  }
+
+  EvoIRRecordingInfo info;
+  if(evo_irimager_recording_map_get_info(mapId, &info) != 0 || info.frames != n) return false;
+
+  // every frame by its own keys, then random keys around the recorded ones
+  for(unsigned int q = 0; q < n + queries; q++)
+  {
+    long long t;
+    unsigned int c;
+    if(q < n)
+    {
+      t = metadata[q].timestamp;
+      c = metadata[q].counter;
+    }
+    else
+    {
+      t = tMin - 1000000 + (long long)(rng() % (unsigned long long)(tMax - tMin + 2000000));
+      c = metadata[rng() % n].counter + rng() % 5 - 2;
+    }
+
+    // nearest frame in time
+    unsigned int index;
+    long long best = -1;
+    for(unsigned int f = 0; f < n; f++)
+      if(best < 0 || distance(metadata[f].timestamp, t) < best) best = distance(metadata[f].timestamp, t);
+    if(evo_irimager_recording_map_find_time(mapId, t, &index) != 0 || index >= n || distance(metadata[index].timestamp, t) != best)
+    {
+      std::printf("  find_time(%lld) wrong\n", t);
+      return false;
+    }
+
+    // first frame carrying the counter
+    unsigned int expected = n;
+    for(unsigned int f = 0; f < n && expected == n; f++)
+      if(metadata[f].counter == c) expected = f;
+    const int found = evo_irimager_recording_map_find_counter(mapId, c, &index);
+    if((expected == n) != (found != 0) || (found == 0 && index != expected))
+    {
+      std::printf("  find_counter(%u) wrong\n", c);
+      return false;
+    }
+
+    // ranges ordered by key, ties by frame number
+    const long long tLast = t + (long long)(rng() % 20000000);
+    std::vector<std::pair<long long, unsigned int> > times;
+    for(unsigned int f = 0; f < n; f++)
+      if(metadata[f].timestamp >= t && metadata[f].timestamp <= tLast) times.push_back(std::make_pair(metadata[f].timestamp, f));
+    std::sort(times.begin(), times.end());
+    const unsigned int* frames;
+    unsigned int count;
+    bool ok = evo_irimager_recording_map_find_time_range(mapId, t, tLast, &frames, &count) == 0 && count == times.size();
+    for(unsigned int i = 0; i < count && ok; i++)
+      ok = frames[i] == times[i].second;
+    if(!ok)
+    {
+      std::printf("  find_time_range(%lld, %lld) wrong\n", t, tLast);
+      return false;
+    }
+
+    const unsigned int span  = rng() % 200;
+    const unsigned int cLast = c + span < c ? 0xFFFFFFFFu : c + span;
+    std::vector<std::pair<unsigned int, unsigned int> > counters;
+    for(unsigned int f = 0; f < n; f++)
+      if(metadata[f].counter >= c && metadata[f].counter <= cLast) counters.push_back(std::make_pair(metadata[f].counter, f));
+    std::sort(counters.begin(), counters.end());
+    ok = evo_irimager_recording_map_find_counter_range(mapId, c, cLast, &frames, &count) == 0 && count == counters.size();
+    for(unsigned int i = 0; i < count && ok; i++)
+      ok = frames[i] == counters[i].second;
+    if(!ok)
+    {
+      std::printf("  find_counter_range(%u, %u) wrong\n", c, cLast);
+      return false;
+    }
+  }
+
+  // maximal runs of equal flag state
+  for(unsigned int s = 0; s < INDEX_FLAG_STATES; s++)
+  {
+    std::vector<EvoIRFrameRun> expected;
+    for(unsigned int f = 0; f < n; )
+    {
+      const unsigned int state = stateOf(metadata[f]);
+      EvoIRFrameRun run;
+      run.first = f;
+      while(f < n && stateOf(metadata[f]) == state) f++;
+      run.count = f - run.first;
+      if(state == s) expected.push_back(run);
+    }
+    const EvoIRFrameRun* runs;
+    unsigned int count;
+    bool ok = evo_irimager_recording_map_get_flag_runs(mapId, (int)s, &runs, &count) == 0 && count == expected.size();
+    for(unsigned int r = 0; r < count && ok; r++)
+      ok = runs[r].first == expected[r].first && runs[r].count == expected[r].count;
+    if(!ok)
+    {
+      std::printf("  get_flag_runs(%u) wrong\n", s);
+      return false;
+    }
+  }
+
+  // metadata of the frames themselves
+  for(unsigned int f = 0; f < n; f++)
+  {
+    const unsigned short* data;
+    const EvoIRFrameMetadata* m;
+    if(evo_irimager_recording_map_get_frame(mapId, f, &data, &m) != 0 || std::memcmp(m, &metadata[f], sizeof(*m)) != 0 ||
+       data[0] != (unsigned short)(f * 7))
+    {
+      std::printf("  get_frame(%u) wrong\n", f);
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool check(const char* name, const char* path, bool persist, const std::vector<EvoIRFrameMetadata>& metadata, unsigned int queries,
+                  std::mt19937& rng, int recovered = 0)
+{
+  unsigned int mapId;
+  EvoIRRecordingInfo info;
+  bool ok = evo_irimager_recording_map_open(&mapId, path, persist ? 1 : 0) == 0;
+  if(ok)
+  {
+    ok = evo_irimager_recording_map_get_info(mapId, &info) == 0 && info.recovered == recovered && compare(mapId, metadata, queries, rng);
+    evo_irimager_recording_map_close(mapId);
+  }
+  std::printf("%-44s %s\n", name, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+int main(int argc, char* argv[])
+{
+  unsigned int frames  = 3000;
+  unsigned int queries = 2000;
+  unsigned int seed    = 1;
+  const char* path     = "check.evoir";
+  for(int i = 1; i < argc; i++)
+  {
+    const bool hasValue = i + 1 < argc;
+    if(!std::strcmp(argv[i], "--frames") && hasValue)       frames  = (unsigned int)std::atoi(argv[++i]);
+    else if(!std::strcmp(argv[i], "--queries") && hasValue) queries = (unsigned int)std::atoi(argv[++i]);
+    else if(!std::strcmp(argv[i], "--seed") && hasValue)    seed    = (unsigned int)std::atoi(argv[++i]);
+    else if(!std::strcmp(argv[i], "--file") && hasValue)    path    = argv[++i];
+    else
+    {
+      std::printf("usage: EvoIRRecordingMapCheck [--frames n] [--queries n] [--seed n] [--file path]\n");
+      return 1;
+    }
+  }
+  if(frames < 8) return 1;
+
+  const std::string indexPath = std::string(path) + ".idx";
+  std::mt19937 rng(seed);
+  std::vector<EvoIRFrameMetadata> metadata = makeMetadata(frames, rng);
+  std::remove(indexPath.c_str());
+  if(!writeRecording(path, metadata))
+  {
+    std::printf("cannot write %s\n", path);
+    return 1;
+  }
+
+  bool passed = check("fresh index", path, true, metadata, queries, rng);
+  std::vector<unsigned char> index;
+  if(!readFile(indexPath, &index) || index.size() < sizeof(RecordingIndexFileHeader) + 2 * frames * sizeof(unsigned int))
+  {
+    std::printf("index not persisted\n");
+    passed = false;
+  }
+  else
+  {
+    passed = check("persisted index", path, true, metadata, queries, rng) && passed;
+
+    // damaged index files keep their header, so only the consistency checks can catch them
+    unsigned int* order = (unsigned int*)&index[sizeof(RecordingIndexFileHeader)];
+    EvoIRFrameRun* runs = (EvoIRFrameRun*)(order + 2 * frames);
+    const unsigned int a = frames / 3, b = 2 * frames / 3;
+    struct Damage
+    {
+      const char* name;
+      unsigned int* word;
+      unsigned int value;
+    } damages[] = {
+      { "index with swapped time order", &order[a], order[b] },
+      { "index with duplicated counter order entry", &order[frames + a], order[frames + a + 1] },
+      { "index with frame number out of range", &order[b], frames + 5 },
+      { "index with shortened flag run", &runs[0].count, runs[0].count - 1 },
+      { "index with moved flag run", &runs[1].first, runs[1].first + 1 },
+    };
+    for(size_t d = 0; d < sizeof(damages) / sizeof(damages[0]); d++)
+    {
+      const unsigned int saved = *damages[d].word;
+      *damages[d].word = damages[d].value;
+      if(d == 0) order[b] = saved; // a swap, still a permutation
+      passed = writeFile(indexPath, index) && check(damages[d].name, path, false, metadata, queries, rng) && passed;
+      *damages[d].word = saved;
+      if(d == 0) order[b] = damages[d].value;
+    }
+
+    // same frame count, size and first/last timestamp, different order inside
+    std::vector<EvoIRFrameMetadata> replaced = metadata;
+    std::reverse(replaced.begin() + 1, replaced.end() - 1);
+    passed = writeFile(indexPath, index) && writeRecording(path, replaced) &&
+             check("replaced recording with stale index", path, true, replaced, queries, rng) && passed;
+    metadata.swap(replaced);
+  }
+
+  // a flipped bit in the index footer has to be caught by its CRC, frames are then recovered by scanning
+  std::vector<unsigned char> recording;
+  if(readFile(path, &recording))
+  {
+    const RecordingTrailer* trailer = (const RecordingTrailer*)&recording[recording.size() - sizeof(RecordingTrailer)];
+    const size_t entry = (size_t)trailer->indexOffset + sizeof(RecordingChunkHeader) + (frames / 2) * sizeof(RecordingIndexEntry);
+    ((RecordingIndexEntry*)&recording[entry])->counter ^= 0x10;
+    std::remove(indexPath.c_str());
+    passed = writeFile(path, recording) && check("index footer with wrong CRC", path, false, metadata, queries, rng, 1) && passed;
+  }
+  else
+    passed = false;
+
+  std::remove(path);
+  std::remove(indexPath.c_str());
+  std::printf("%s\n", passed ? "passed" : "FAILED");
+  return passed ? 0 : 1;
+}
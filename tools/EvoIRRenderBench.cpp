@@ -0,0 +1,485 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRRenderBench.cpp
+ * @brief Scaling and determinism of the batch renderer
+ *
+ * Records a synthetic 382 x 288 stream and renders it with 1, 2, 4, ... up to
+ * the given number of threads, as raw RGB video with sigma scaling and changed
+ * emissivity. The output of every run must be identical to the single
+ * threaded one. Reported are frames per second, speedup, parallel efficiency
+ * and the number of stolen chunks, then the PNG throughput with all threads.
+ * Every PNG is decoded again (inflate and unfilter, independent of the encoder
+ * of the renderer) and must match the raw RGB frame:
+ *
+ *   EvoIRRenderBench [--frames 2000] [--threads <cores>] [--chunk 4] [--scale 3] [--dir .]
+ *
+ * Build e.g. on Linux:
+ *
+ *   g++ -std=c++11 -O2 -pthread -I.. EvoIRRenderBench.cpp ../EvoIRBatchRender.cpp ../EvoIRRecording.cpp ../EvoIRRecordingMap.cpp ../EvoIRPalette.cpp ../EvoIRSyntheticSource.cpp
+ */
+
+#include "EvoIRBatchRender.h"
+#include "EvoIRRecording.h"
+#include "EvoIRRecordingFormat.h"
+#include "EvoIRSyntheticSource.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const int WIDTH  = 382;
+static const int HEIGHT = 288;
+static const float FPS  = 80.f;
+
+static bool readFile(const std::string& path, std::vector<unsigned char>& content)
+{
+  FILE* f = fopen(path.c_str(), "rb");
+  if(!f) return false;
+  content.clear();
+  unsigned char buffer[65536];
+  size_t n;
+  while((n = fread(buffer, 1, sizeof(buffer), f)) > 0) content.insert(content.end(), buffer, buffer + n);
+  fclose(f);
+  return true;
+}
+
+/**
+ * Canonical Huffman code of a deflate block, decoded bit by bit (RFC 1951 3.2.2)
+ */
+struct Huffman
+{
+  unsigned short count[16];    // codes per length
+  unsigned short symbol[320];  // symbols ordered by code
+};
+
+static bool buildHuffman(Huffman& h, const unsigned char* lengths, int n)
+{
+  std::memset(h.count, 0, sizeof(h.count));
+  for(int i = 0; i < n; i++) h.count[lengths[i]]++;
+  int left = 1;
+  for(int len = 1; len < 16; len++)
+  {
+    left = 2 * left - h.count[len];
+    if(left < 0) return false; // over-subscribed
+  }
+  unsigned short offset[16] = { 0 };
+  for(int len = 1; len < 15; len++) offset[len + 1] = offset[len] + h.count[len];
+  for(int i = 0; i < n; i++)
+    if(lengths[i]) h.symbol[offset[lengths[i]]++] = (unsigned short)i;
+  return true;
+}
+
+class Inflater
+{
+public:
+  Inflater(const unsigned char* in, size_t size) : _in(in), _size(size), _pos(0), _bits(0), _count(0), _error(false) { }
+
+  /**
+   * Decompresses a zlib stream (RFC 1950) including the Adler-32 check
+   */
+  bool zlib(std::vector<unsigned char>& out)
+  {
+    if(_size < 6 || (_in[0] & 0x0F) != 8 || (_in[0] * 256 + _in[1]) % 31 != 0 || (_in[1] & 0x20)) return false;
+    _pos = 2;
+    out.clear();
+    bool last = false;
+    while(!last && !_error)
+    {
+      last = bits(1) != 0;
+      const unsigned int type = bits(2);
+      if(type == 0)      stored(out);
+      else if(type == 1) fixed(out);
+      else if(type == 2) dynamic(out);
+      else               _error = true;
+    }
+    if(_error || _pos + 4 > _size) return false;
+    unsigned int a = 1, b = 0;
+    for(size_t i = 0; i < out.size(); i++)
+    {
+      a = (a + out[i]) % 65521;
+      b = (b + a) % 65521;
+    }
+    const unsigned int adler = (unsigned int)_in[_pos] << 24 | _in[_pos + 1] << 16 | _in[_pos + 2] << 8 | _in[_pos + 3];
+    return adler == ((b << 16) | a);
+  }
+
+private:
+  unsigned int bits(int n)
+  {
+    while(_count < n)
+    {
+      if(_pos == _size)
+      {
+        _error = true;
+        return 0;
+      }
+      _bits |= (unsigned long)_in[_pos++] << _count;
+      _count += 8;
+    }
+    const unsigned int value = (unsigned int)(_bits & ((1ul << n) - 1));
+    _bits >>= n;
+    _count -= n;
+    return value;
+  }
+
+  int decode(const Huffman& h)
+  {
+    int code = 0, first = 0, index = 0;
+    for(int len = 1; len < 16 && !_error; len++)
+    {
+      code |= (int)bits(1);
+      const int count = h.count[len];
+      if(code - count < first) return h.symbol[index + code - first];
+      index += count;
+      first  = (first + count) << 1;
+      code <<= 1;
+    }
+    _error = true;
+    return -1;
+  }
+
+  void stored(std::vector<unsigned char>& out)
+  {
+    _bits  = 0;
+    _count = 0;
+    if(_pos + 4 > _size)
+    {
+      _error = true;
+      return;
+    }
+    const unsigned int len  = _in[_pos] | _in[_pos + 1] << 8;
+    const unsigned int nlen = _in[_pos + 2] | _in[_pos + 3] << 8;
+    _pos += 4;
+    if(len != (~nlen & 0xFFFF) || _pos + len > _size)
+    {
+      _error = true;
+      return;
+    }
+    out.insert(out.end(), _in + _pos, _in + _pos + len);
+    _pos += len;
+  }
+
+  void fixed(std::vector<unsigned char>& out)
+  {
+    unsigned char lengths[288 + 30];
+    for(int i = 0; i < 288; i++) lengths[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+    for(int i = 0; i < 30; i++) lengths[288 + i] = 5;
+    Huffman lit, dist;
+    buildHuffman(lit, lengths, 288);
+    buildHuffman(dist, lengths + 288, 30);
+    codes(out, lit, dist);
+  }
+
+  void dynamic(std::vector<unsigned char>& out)
+  {
+    static const unsigned char ORDER[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+    const int hlit  = (int)bits(5) + 257;
+    const int hdist = (int)bits(5) + 1;
+    const int hclen = (int)bits(4) + 4;
+    if(hlit > 286 || hdist > 30)
+    {
+      _error = true;
+      return;
+    }
+    unsigned char lengths[320] = { 0 };
+    for(int i = 0; i < hclen; i++) lengths[ORDER[i]] = (unsigned char)bits(3);
+    Huffman code;
+    if(!buildHuffman(code, lengths, 19))
+    {
+      _error = true;
+      return;
+    }
+    int n = 0;
+    while(n < hlit + hdist && !_error)
+    {
+      const int symbol = decode(code);
+      if(symbol < 16)
+      {
+        lengths[n++] = (unsigned char)symbol;
+        continue;
+      }
+      unsigned char repeat = 0;
+      int times;
+      if(symbol == 16)
+      {
+        if(n == 0) break;
+        repeat = lengths[n - 1];
+        times  = 3 + (int)bits(2);
+      }
+      else
+      {
+        times = symbol == 17 ? 3 + (int)bits(3) : 11 + (int)bits(7);
+      }
+      if(n + times > hlit + hdist) break;
+      while(times--) lengths[n++] = repeat;
+    }
+    Huffman lit, dist;
+    if(n != hlit + hdist || !lengths[256] || !buildHuffman(lit, lengths, hlit) || !buildHuffman(dist, lengths + hlit, hdist))
+    {
+      _error = true;
+      return;
+    }
+    codes(out, lit, dist);
+  }
+
+  void codes(std::vector<unsigned char>& out, const Huffman& lit, const Huffman& dist)
+  {
+    static const unsigned short LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    static const unsigned char LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    static const unsigned short DIST_BASE[30]   = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+                                                    4097, 6145, 8193, 12289, 16385, 24577 };
+    static const unsigned char DIST_EXTRA[30]   = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+    while(!_error)
+    {
+      const int symbol = decode(lit);
+      if(symbol < 0 || symbol == 256) return;
+      if(symbol < 256)
+      {
+        out.push_back((unsigned char)symbol);
+        continue;
+      }
+      if(symbol > 285)
+      {
+        _error = true;
+        return;
+      }
+      const size_t len = LENGTH_BASE[symbol - 257] + bits(LENGTH_EXTRA[symbol - 257]);
+      const int d = decode(dist);
+      if(d < 0 || d > 29)
+      {
+        _error = true;
+        return;
+      }
+      const size_t distance = DIST_BASE[d] + bits(DIST_EXTRA[d]);
+      if(distance > out.size())
+      {
+        _error = true;
+        return;
+      }
+      for(size_t i = 0; i < len; i++) out.push_back(out[out.size() - distance]);
+    }
+  }
+
+  const unsigned char* _in;
+  size_t _size;
+  size_t _pos;
+  unsigned long _bits;
+  int _count;
+  bool _error;
+};
+
+static unsigned int bigEndian(const unsigned char* p)
+{
+  return (unsigned int)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+/**
+ * Decodes an 8 bit RGB PNG without interlacing as written by the renderer, chunk CRCs included
+ */
+static bool decodePng(const std::vector<unsigned char>& png, int* w, int* h, std::vector<unsigned char>& rgb)
+{
+  static const unsigned char SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+  if(png.size() < 8 || std::memcmp(&png[0], SIGNATURE, 8)) return false;
+  std::vector<unsigned char> idat;
+  bool header = false, end = false;
+  size_t pos = 8;
+  while(!end)
+  {
+    if(pos + 12 > png.size()) return false;
+    const unsigned int size = bigEndian(&png[pos]);
+    if(size > png.size() - pos - 12) return false;
+    const unsigned char* type = &png[pos + 4];
+    const unsigned char* data = type + 4;
+    if(bigEndian(data + size) != evo::recordingCrc32(data, size, evo::recordingCrc32(type, 4))) return false;
+    if(!std::memcmp(type, "IHDR", 4))
+    {
+      // 8 bit, RGB, deflate, adaptive filtering, no interlacing
+      if(size != 13 || data[8] != 8 || data[9] != 2 || data[10] || data[11] || data[12]) return false;
+      *w     = (int)bigEndian(data);
+      *h     = (int)bigEndian(data + 4);
+      header = *w > 0 && *h > 0;
+    }
+    else if(!std::memcmp(type, "IDAT", 4))
+    {
+      idat.insert(idat.end(), data, data + size);
+    }
+    else if(!std::memcmp(type, "IEND", 4))
+    {
+      end = true;
+    }
+    pos += 12 + size;
+  }
+  std::vector<unsigned char> rows;
+  if(!header || idat.empty() || !Inflater(&idat[0], idat.size()).zlib(rows)) return false;
+
+  // PNG 9.2, three bytes per pixel
+  const size_t line = (size_t)*w * 3;
+  if(rows.size() != (line + 1) * *h) return false;
+  rgb.resize(line * *h);
+  for(int y = 0; y < *h; y++)
+  {
+    const unsigned char type = rows[y * (line + 1)];
+    const unsigned char* in  = &rows[y * (line + 1) + 1];
+    unsigned char* row       = &rgb[y * line];
+    const unsigned char* up  = y ? row - line : nullptr;
+    for(size_t i = 0; i < line; i++)
+    {
+      const int a = i >= 3 ? row[i - 3] : 0;
+      const int b = up ? up[i] : 0;
+      const int c = up && i >= 3 ? up[i - 3] : 0;
+      int predictor;
+      if(type == 0)      predictor = 0;
+      else if(type == 1) predictor = a;
+      else if(type == 2) predictor = b;
+      else if(type == 3) predictor = (a + b) >> 1;
+      else if(type == 4)
+      {
+        const int p = a + b - c, pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+        predictor = pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+      }
+      else return false;
+      row[i] = (unsigned char)(in[i] + predictor);
+    }
+  }
+  return true;
+}
+
+static bool record(const std::string& path, int frames)
+{
+  EvoIRSyntheticParams synthetic;
+  evo_irimager_synthetic_default_params(&synthetic, WIDTH, HEIGHT, FPS);
+  synthetic.realtime = 0;
+  unsigned int srcId, recId;
+  if(evo_irimager_synthetic_init(&srcId, &synthetic) != 0) return false;
+  if(evo_irimager_recorder_open(&recId, path.c_str(), WIDTH, HEIGHT, FPS, 1) != 0)
+  {
+    evo_irimager_synthetic_terminate(srcId);
+    return false;
+  }
+  std::vector<unsigned short> data((size_t)WIDTH * HEIGHT);
+  bool ok = true;
+  for(int i = 0; i < frames && ok; i++)
+  {
+    int w = WIDTH, h = HEIGHT;
+    EvoIRFrameMetadata metadata;
+    ok = evo_irimager_synthetic_get_thermal_image_metadata(srcId, &w, &h, &data[0], &metadata) == 0
+         && evo_irimager_recorder_write_frame(recId, &data[0], &metadata) == 0;
+  }
+  ok = evo_irimager_recorder_close(recId) == 0 && ok;
+  evo_irimager_synthetic_terminate(srcId);
+  return ok;
+}
+
+static bool render(const std::string& recording, const std::string& out, EvoIRRenderParams params, EvoIRRenderProgress* progress)
+{
+  unsigned int renderId;
+  if(evo_irimager_render_start(&renderId, recording.c_str(), out.c_str(), &params) != 0) return false;
+  const bool ok = evo_irimager_render_wait(renderId, progress) == 0;
+  evo_irimager_render_destroy(renderId);
+  return ok;
+}
+
+int main(int argc, char* argv[])
+{
+  int frames           = 2000;
+  unsigned int threads = std::thread::hardware_concurrency();
+  unsigned int chunk   = 4;
+  int scale            = 3;
+  std::string dir      = ".";
+  for(int i = 1; i < argc; i++)
+  {
+    const bool hasValue = i + 1 < argc;
+    if(!std::strcmp(argv[i], "--frames") && hasValue)       frames  = std::atoi(argv[++i]);
+    else if(!std::strcmp(argv[i], "--threads") && hasValue) threads = (unsigned int)std::atoi(argv[++i]);
+    else if(!std::strcmp(argv[i], "--chunk") && hasValue)   chunk   = (unsigned int)std::atoi(argv[++i]);
+    else if(!std::strcmp(argv[i], "--scale") && hasValue)   scale   = std::atoi(argv[++i]);
+    else if(!std::strcmp(argv[i], "--dir") && hasValue)     dir     = argv[++i];
+    else
+    {
+      std::printf("usage: EvoIRRenderBench [--frames n] [--threads n] [--chunk n] [--scale id] [--dir path]\n");
+      return 1;
+    }
+  }
+  if(frames < 1 || threads < 1 || chunk < 1) return 1;
+
+  const std::string recording = dir + "/render_bench.evoir";
+  if(!record(recording, frames))
+  {
+    std::printf("cannot write %s\n", recording.c_str());
+    return 1;
+  }
+
+  EvoIRRenderParams params;
+  evo_irimager_render_default_params(&params);
+  params.scale              = scale;
+  params.emissivity         = 0.9f;
+  params.output             = EVO_RENDER_RAW_RGB;
+  params.chunk              = chunk;
+
+  std::printf("%d frames of %d x %d, scale %d, chunk %u\n", frames, WIDTH, HEIGHT, scale, chunk);
+  std::printf("  %7s %10s %8s %10s %7s %9s\n", "threads", "frames/s", "speedup", "efficiency", "steals", "identical");
+  std::vector<unsigned char> reference, output;
+  double single = 0.0;
+  int failed    = 0;
+  for(unsigned int n = 1; ; n = (n * 2 > threads && n < threads) ? threads : n * 2)
+  {
+    params.threads = n;
+    const std::string out = dir + "/render_bench.rgb";
+    EvoIRRenderProgress progress;
+    if(!render(recording, out, params, &progress) || !readFile(out, n == 1 ? reference : output))
+    {
+      std::printf("  %7u failed\n", n);
+      failed++;
+      break;
+    }
+    const double fps = progress.rendered / progress.seconds;
+    if(n == 1) single = fps;
+    const bool identical = n == 1 || output == reference;
+    if(!identical) failed++;
+    std::printf("  %7u %10.0f %7.2fx %9.0f%% %7u %9s\n", n, fps, fps / single, 100.0 * fps / single / n, progress.steals, identical ? "yes" : "NO");
+    if(n >= threads) break;
+  }
+  std::remove((dir + "/render_bench.rgb").c_str());
+
+  params.output  = EVO_RENDER_PNG;
+  params.threads = threads;
+  EvoIRRenderProgress progress;
+  const bool rendered = render(recording, dir + "/render_bench_", params, &progress);
+  if(!rendered) failed++;
+  const size_t frameSize = (size_t)WIDTH * HEIGHT * 3;
+  size_t bytes = 0;
+  int decoded  = 0;
+  std::vector<unsigned char> png, rgb;
+  for(int i = 0; i < frames; i++)
+  {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%06d.png", i);
+    const std::string path = dir + "/render_bench_" + name;
+    int w = 0, h = 0;
+    // the raw run of one thread holds the expected pixels of every frame
+    if(rendered && readFile(path, png) && decodePng(png, &w, &h, rgb) && w == WIDTH && h == HEIGHT
+       && reference.size() == (size_t)frames * frameSize && !std::memcmp(&rgb[0], &reference[i * frameSize], frameSize))
+      decoded++;
+    bytes += png.size();
+    std::remove(path.c_str());
+  }
+  if(rendered)
+  {
+    std::printf("PNG with %u threads: %.0f frames/s, %.1f kB per frame (raw %.1f kB), %d of %d decoded equal to raw\n", threads,
+                progress.rendered / progress.seconds, bytes / 1024.0 / frames, frameSize / 1024.0, decoded, frames);
+    if(decoded != frames) failed++;
+  }
+  std::remove(recording.c_str());
+  std::remove((recording + ".idx").c_str());
+  std::printf("%s\n", failed ? "FAILED" : "passed");
+  return failed ? 1 : 0;
+}
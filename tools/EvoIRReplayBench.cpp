@@ -0,0 +1,306 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRReplayBench.cpp
+ * @brief Frame rate, call latency and allocations of the Easy API accessors
+ *
+ * Runs against the replay backend (EvoIRReplay.h) instead of a camera. For
+ * every resolution and frame rate of Formats.def, or a recording, a camera is
+ * initialized and every accessor called for a number of frames. Reported are
+ * the init time, frames per second, latency percentiles per call and heap
+ * allocations per frame (operator new, counted by this program). Frames of
+ * two cameras with equal seeds are compared to check the replay is
+ * deterministic. --csv writes one row per format and accessor for tracking
+ * regressions:
+ *
+ *   EvoIRReplayBench [--formats ../Formats.def] [--format index] [--recording path] [--frames 100] [--realtime] [--csv path]
+ *
+ * Build e.g. on Linux:
+ *
+ *   g++ -std=c++11 -O2 -pthread -I.. EvoIRReplayBench.cpp ../EvoIRBindingStub.cpp ../EvoIRFormatPlan.cpp ../EvoIRSyntheticSource.cpp ../EvoIRPalette.cpp ../EvoIRRecording.cpp
+ */
+
+#include "direct_binding.h"
+#include "EvoIRFormatPlan.h"
+#include "EvoIRRecording.h"
+#include "EvoIRReplay.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+
+static std::atomic<unsigned long long> g_allocations(0);
+
+void* operator new(size_t size)
+{
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  void* p = std::malloc(size ? size : 1);
+  if(!p) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+  std::free(p);
+}
+
+enum Accessor
+{
+  THERMAL,
+  THERMAL_METADATA,
+  PALETTE,
+  PALETTE_METADATA,
+  THERMAL_PALETTE_METADATA,
+  MULTI_THERMAL_METADATA,
+  MULTI_PALETTE,
+  ACCESSORS
+};
+
+static const char* const ACCESSOR_NAMES[ACCESSORS] = { "get_thermal_image", "get_thermal_image_metadata", "get_palette_image",
+                                                       "get_palette_image_metadata", "get_thermal_palette_image_metadata",
+                                                       "multi_get_thermal_image_metadata", "multi_get_palette_image" };
+
+struct Result
+{
+  double fps;
+  double p50, p90, p99, max; // microseconds
+  double allocations;        // per frame
+};
+
+struct Buffers
+{
+  std::vector<unsigned short> thermal;
+  std::vector<unsigned char> palette;
+  std::vector<double> latency;
+};
+
+static int call(int accessor, unsigned int camId, int w, int h, Buffers& b)
+{
+  EvoIRFrameMetadata metadata;
+  int tw = w, th = h;
+  switch(accessor)
+  {
+  case THERMAL:                  return evo_irimager_get_thermal_image(&tw, &th, &b.thermal[0]);
+  case THERMAL_METADATA:         return evo_irimager_get_thermal_image_metadata(&tw, &th, &b.thermal[0], &metadata);
+  case PALETTE:                  return evo_irimager_get_palette_image(&tw, &th, &b.palette[0]);
+  case PALETTE_METADATA:         return evo_irimager_get_palette_image_metadata(&tw, &th, &b.palette[0], &metadata);
+  case THERMAL_PALETTE_METADATA: return evo_irimager_get_thermal_palette_image_metadata(w, h, &b.thermal[0], w, h, &b.palette[0], &metadata);
+  case MULTI_THERMAL_METADATA:   return evo_irimager_multi_get_thermal_image_metadata(camId, &tw, &th, &b.thermal[0], &metadata);
+  case MULTI_PALETTE:            return evo_irimager_multi_get_palette_image(camId, &tw, &th, &b.palette[0]);
+  }
+  return -1;
+}
+
+/**
+ * Calls an accessor for frames frames, latency buffer preallocated so the loop does not allocate itself
+ */
+static bool measure(int accessor, unsigned int camId, int w, int h, int frames, Buffers& b, Result* r)
+{
+  for(int i = 0; i < 3; i++)
+    if(call(accessor, camId, w, h, b) != 0) return false;
+  const unsigned long long allocations = g_allocations.load();
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for(int i = 0; i < frames; i++)
+  {
+    const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    if(call(accessor, camId, w, h, b) != 0) return false;
+    b.latency[i] = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+  }
+  const double total = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  r->allocations = (double)(g_allocations.load() - allocations) / frames;
+  std::sort(b.latency.begin(), b.latency.begin() + frames);
+  r->fps = frames / total;
+  r->p50 = b.latency[(size_t)(0.5 * (frames - 1))];
+  r->p90 = b.latency[(size_t)(0.9 * (frames - 1))];
+  r->p99 = b.latency[(size_t)(0.99 * (frames - 1))];
+  r->max = b.latency[frames - 1];
+  return true;
+}
+
+/**
+ * Two cameras with equal parameters have to deliver equal images and counters
+ */
+static bool deterministic(const char* formats, int w, int h)
+{
+  unsigned int a, b;
+  if(evo_irimager_multi_usb_init(&a, 0, formats, 0) != 0) return false;
+  if(evo_irimager_multi_usb_init(&b, 0, formats, 0) != 0)
+  {
+    evo_irimager_multi_terminate(a);
+    return false;
+  }
+  std::vector<unsigned short> da((size_t)w * h), db((size_t)w * h);
+  bool equal = true;
+  for(int i = 0; i < 5 && equal; i++)
+  {
+    EvoIRFrameMetadata ma, mb;
+    int wa = w, ha = h, wb = w, hb = h;
+    equal = evo_irimager_multi_get_thermal_image_metadata(a, &wa, &ha, &da[0], &ma) == 0
+            && evo_irimager_multi_get_thermal_image_metadata(b, &wb, &hb, &db[0], &mb) == 0
+            && da == db && ma.counter == mb.counter && ma.flagState == mb.flagState;
+  }
+  evo_irimager_multi_terminate(a);
+  evo_irimager_multi_terminate(b);
+  return equal;
+}
+
+int main(int argc, char* argv[])
+{
+  const char* formats   = "../Formats.def";
+  const char* recording = 0;
+  const char* csvPath   = 0;
+  int only     = -1;
+  int frames   = 100;
+  int realtime = 0;
+  for(int i = 1; i < argc; i++)
+  {
+    const bool hasValue = i + 1 < argc;
+    if(!std::strcmp(argv[i], "--formats") && hasValue)        formats   = argv[++i];
+    else if(!std::strcmp(argv[i], "--format") && hasValue)    only      = std::atoi(argv[++i]);
+    else if(!std::strcmp(argv[i], "--recording") && hasValue) recording = argv[++i];
+    else if(!std::strcmp(argv[i], "--frames") && hasValue)    frames    = std::atoi(argv[++i]);
+    else if(!std::strcmp(argv[i], "--csv") && hasValue)       csvPath   = argv[++i];
+    else if(!std::strcmp(argv[i], "--realtime"))              realtime  = 1;
+    else
+    {
+      std::printf("usage: EvoIRReplayBench [--formats path] [--format index] [--recording path] [--frames n] [--realtime] [--csv path]\n");
+      return 1;
+    }
+  }
+  if(frames < 1) return 1;
+
+  // one entry per resolution and frame rate, the first format having it
+  struct Entry { int index; EvoIRFormatInfo info; EvoIRFormatChannel channel; };
+  std::vector<Entry> entries;
+  if(recording)
+  {
+    Entry e;
+    std::memset(&e, 0, sizeof(e));
+    e.index = -1;
+    std::snprintf(e.info.name, sizeof(e.info.name), "recording");
+    unsigned int recId;
+    EvoIRRecordingInfo info;
+    if(evo_irimager_recording_open(&recId, recording) != 0 || evo_irimager_recording_get_info(recId, &info) != 0)
+    {
+      std::printf("cannot read %s\n", recording);
+      return 1;
+    }
+    evo_irimager_recording_close(recId);
+    e.channel.framerate = info.framerate;
+    entries.push_back(e);
+  }
+  else
+  {
+    unsigned int formatsId, count = 0;
+    if(evo_irimager_formats_load(&formatsId, formats) != 0)
+    {
+      std::printf("cannot read %s\n", formats);
+      return 1;
+    }
+    evo_irimager_formats_get_count(formatsId, &count);
+    for(unsigned int i = 0; i < count; i++)
+    {
+      Entry e;
+      e.index = (int)i;
+      if(evo_irimager_formats_get_info(formatsId, i, &e.info) != 0 || evo_irimager_formats_get_channel(formatsId, i, 0, &e.channel) != 0) return 1;
+      bool seen = false;
+      for(size_t k = 0; k < entries.size(); k++)
+        seen = seen || (entries[k].channel.width == e.channel.width && entries[k].channel.height == e.channel.height
+                        && entries[k].channel.framerate == e.channel.framerate);
+      if((only < 0 && !seen) || only == e.index) entries.push_back(e);
+    }
+    evo_irimager_formats_release(formatsId);
+  }
+
+  FILE* csv = 0;
+  if(csvPath)
+  {
+    csv = std::fopen(csvPath, "w");
+    if(!csv)
+    {
+      std::printf("cannot write %s\n", csvPath);
+      return 1;
+    }
+    std::fprintf(csv, "format,name,width,height,framerate,realtime,accessor,frames,init_ms,fps,p50_us,p90_us,p99_us,max_us,allocs_per_frame,deterministic\n");
+  }
+
+  bool passed = !entries.empty();
+  Buffers b;
+  b.latency.resize(frames);
+  for(size_t k = 0; k < entries.size(); k++)
+  {
+    const Entry& e = entries[k];
+    EvoIRReplayParams params;
+    evo_irimager_replay_default_params(&params);
+    params.realtime = realtime;
+    if(recording)
+    {
+      params.source = EVO_REPLAY_RECORDING;
+      params.loop   = 1;
+      std::snprintf(params.recording, sizeof(params.recording), "%s", recording);
+    }
+    else
+    {
+      params.formatIndex = e.index;
+    }
+    if(evo_irimager_replay_set_params(&params) != 0) return 1;
+
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    if(evo_irimager_usb_init(0, formats, 0) != 0)
+    {
+      std::printf("cannot initialize %s\n", e.info.name);
+      passed = false;
+      continue;
+    }
+    const double init = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    int w, h;
+    evo_irimager_get_thermal_image_size(&w, &h);
+    b.thermal.resize((size_t)w * h);
+    b.palette.resize((size_t)w * h * 3);
+    const float framerate = e.channel.framerate;
+    const bool same = deterministic(formats, w, h);
+    passed = passed && same;
+
+    std::printf("%s, %d x %d @ %.4g Hz, init %.1f ms%s\n", e.info.name, w, h, framerate, init, same ? "" : ", NOT deterministic");
+    std::printf("  %-36s %10s %9s %9s %9s %9s %8s\n", "accessor", "frames/s", "p50 us", "p90 us", "p99 us", "max us", "allocs");
+    unsigned int camId = 0;
+    for(int a = 0; a < ACCESSORS; a++)
+    {
+      // initialized just before use, a paced camera left idle delivers the frames due in a burst
+      if(a == MULTI_THERMAL_METADATA && evo_irimager_multi_usb_init(&camId, 0, formats, 0) != 0) return 1;
+      Result r;
+      if(!measure(a, camId, w, h, frames, b, &r))
+      {
+        std::printf("  %-36s FAILED\n", ACCESSOR_NAMES[a]);
+        passed = false;
+        continue;
+      }
+      std::printf("  %-36s %10.0f %9.1f %9.1f %9.1f %9.1f %8.2f\n", ACCESSOR_NAMES[a], r.fps, r.p50, r.p90, r.p99, r.max, r.allocations);
+      if(csv)
+        std::fprintf(csv, "%d,\"%s\",%d,%d,%g,%d,%s,%d,%.3f,%.1f,%.2f,%.2f,%.2f,%.2f,%.3f,%d\n", e.index, e.info.name, w, h, framerate, realtime,
+                     ACCESSOR_NAMES[a], frames, init, r.fps, r.p50, r.p90, r.p99, r.max, r.allocations, same ? 1 : 0);
+      // the replay promises not to allocate per frame
+      passed = passed && r.allocations == 0.0;
+    }
+    evo_irimager_multi_terminate(camId);
+    evo_irimager_terminate();
+  }
+  if(csv) std::fclose(csv);
+  std::printf("%s\n", passed ? "passed" : "FAILED");
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,295 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRRoiBench.cpp
+ * @brief Evaluation time of the ROI engine on 640 x 480 frames
+ *
+ * Places random rectangles and polygons (half each, fixed seed) of up to the
+ * given size on a synthetic 640 x 480 stream and evaluates them on every
+ * frame with each instruction set of the processor (see
+ * evo_irimager_set_simd_level). Reported are the median and 99th percentile
+ * time per frame and per covered pixel. Results are checked against a
+ * reference testing every pixel of the bounding box of a region, which is
+ * also timed. Every region gets alarm thresholds, one in eight an emissivity
+ * override, which is excluded from the comparison. Without a size, small
+ * regions of up to 48 pixels and large ones of up to 320 pixels are run; the
+ * large ones overlap and cover about 1.3 M pixels per frame in total:
+ *
+ *   EvoIRRoiBench [--rois 64] [--size pixels] [--frames 200] [--seed 1]
+ *
+ * Build e.g. on Linux:
+ *
+ *   g++ -std=c++11 -O2 -pthread -I.. EvoIRRoiBench.cpp ../EvoIRRoi.cpp ../EvoIRPalette.cpp ../EvoIRSyntheticSource.cpp
+ */
+
+#include "EvoIRRoi.h"
+#include "EvoIRPalette.h"
+#include "EvoIRSyntheticSource.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+static const int WIDTH  = 640;
+static const int HEIGHT = 480;
+static const char* const LEVEL_NAMES[] = { "plain C++", "SSE4.1", "AVX2" };
+static const int SIZES[] = { 48, 320 }; // small regions, large ones covering about 1.3 M pixels
+
+struct Region
+{
+  std::vector<float> xy; // polygon vertices, a rectangle has 4
+  int x0, y0, x1, y1;    // bounding box of covered pixels [x0; x1) x [y0; y1)
+  bool rect;
+  bool overridden;
+};
+
+static double seconds(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static double percentile(std::vector<double> values, double p)
+{
+  const size_t k = std::min(values.size() - 1, (size_t)(p * values.size()));
+  std::nth_element(values.begin(), values.begin() + k, values.end());
+  return values[k];
+}
+
+// Even-odd rule on the pixel center
+static bool inside(const Region& region, int x, int y)
+{
+  if(region.rect) return true;
+  const double xc = x + 0.5, yc = y + 0.5;
+  const std::vector<float>& p = region.xy;
+  const int n = (int)p.size() / 2;
+  bool in = false;
+  for(int i = 0, j = n - 1; i < n; j = i++)
+  {
+    const double xi = p[2 * i], yi = p[2 * i + 1];
+    const double xj = p[2 * j], yj = p[2 * j + 1];
+    if((yi <= yc) != (yj <= yc) && xc < xi + (yc - yi) * (xj - xi) / (yj - yi))
+      in = !in;
+  }
+  return in;
+}
+
+// Scans the bounding box pixel by pixel
+static void reference(const Region& region, const unsigned short* data, EvoIRRoiResult* r)
+{
+  unsigned short lo = 0xFFFF, hi = 0;
+  unsigned long long sum = 0;
+  unsigned int pixels = 0;
+  for(int y = region.y0; y < region.y1; y++)
+  {
+    for(int x = region.x0; x < region.x1; x++)
+    {
+      if(!inside(region, x, y)) continue;
+      const unsigned short v = data[y * WIDTH + x];
+      if(pixels == 0 || v < lo)
+      {
+        lo = v;
+        r->xMin = (short)x;
+        r->yMin = (short)y;
+      }
+      if(pixels == 0 || v > hi)
+      {
+        hi = v;
+        r->xMax = (short)x;
+        r->yMax = (short)y;
+      }
+      sum += v;
+      pixels++;
+    }
+  }
+  r->pixels = pixels;
+  r->tMin   = (float)(lo * 0.1 - 100.0);
+  r->tMax   = (float)(hi * 0.1 - 100.0);
+  r->tMean  = pixels ? (float)((double)sum / pixels * 0.1 - 100.0) : 0.f;
+}
+
+static Region randomRegion(std::mt19937& rng, int size, bool rect)
+{
+  std::uniform_real_distribution<float> extent(4.f, (float)size);
+  std::uniform_real_distribution<float> posX(0.f, WIDTH - (float)size);
+  std::uniform_real_distribution<float> posY(0.f, HEIGHT - (float)size);
+  Region region;
+  region.rect = rect;
+  region.overridden = false;
+  const float x = std::floor(posX(rng)), y = std::floor(posY(rng));
+  if(rect)
+  {
+    const int w = (int)extent(rng), h = (int)extent(rng);
+    region.xy = { x, y, x + w, y, x + w, y + h, x, y + h };
+    region.x0 = (int)x;
+    region.y0 = (int)y;
+    region.x1 = (int)x + w;
+    region.y1 = (int)y + h;
+    return region;
+  }
+  // star shaped polygon around the center, vertices at random radii
+  const float cx = x + size * 0.5f, cy = y + size * 0.5f;
+  const int points = 3 + (int)(rng() % 8);
+  std::uniform_real_distribution<float> radius(2.f, size * 0.5f);
+  for(int i = 0; i < points; i++)
+  {
+    const float a = 6.2831853f * i / points;
+    const float r = radius(rng);
+    region.xy.push_back(cx + r * std::cos(a));
+    region.xy.push_back(cy + r * std::sin(a));
+  }
+  region.x0 = std::max(0, (int)std::floor(x));
+  region.y0 = std::max(0, (int)std::floor(y));
+  region.x1 = std::min(WIDTH, (int)std::ceil(x + size));
+  region.y1 = std::min(HEIGHT, (int)std::ceil(y + size));
+  return region;
+}
+
+// Evaluates random regions of up to size pixels on all frames with every instruction set
+static bool run(const std::vector<unsigned short>& data, unsigned int frames, unsigned int rois, int size, unsigned int seed)
+{
+  const size_t pixels = (size_t)WIDTH * HEIGHT;
+  unsigned int engineId;
+  if(evo_irimager_roi_engine_create(&engineId, WIDTH, HEIGHT, 1) != 0) return false;
+  std::mt19937 rng(seed);
+  std::vector<Region> regions;
+  std::vector<unsigned int> ids;
+  unsigned long long covered = 0;
+  while(regions.size() < rois)
+  {
+    Region region = randomRegion(rng, size, regions.size() % 2 == 0);
+    unsigned int id;
+    const int rc = region.rect ? evo_irimager_roi_add_rect(engineId, region.x0, region.y0, region.x1 - region.x0, region.y1 - region.y0, &id)
+                               : evo_irimager_roi_add_polygon(engineId, &region.xy[0], (int)region.xy.size() / 2, &id);
+    if(rc != 0) continue; // polygon between pixel centers
+    evo_irimager_roi_set_alarm(engineId, id, 20.f, 40.f);
+    if(regions.size() % 8 == 7)
+    {
+      evo_irimager_roi_set_radiation_parameters(engineId, id, 0.9f, 1.f, 20.f);
+      region.overridden = true;
+    }
+    regions.push_back(region);
+    ids.push_back(id);
+  }
+
+  std::vector<EvoIRRoiResult> results(rois);
+  std::vector<EvoIRRoiResult> refResults(rois);
+  std::vector<double> times(frames);
+
+  // reference on all frames
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  for(unsigned int f = 0; f < frames; f++)
+    for(unsigned int i = 0; i < rois; i++)
+      reference(regions[i], &data[f * pixels], &refResults[i]);
+  const double tReference = seconds(t0) / frames;
+  for(unsigned int i = 0; i < rois; i++) covered += refResults[i].pixels;
+  std::printf("%u regions of up to %d pixels on %d x %d, %llu pixels covered\n", rois, size, WIDTH, HEIGHT, covered);
+  std::printf("  %-10s %9.1f us/frame\n", "reference", tReference * 1e6);
+
+  int maxLevel;
+  evo_irimager_get_simd_level(&maxLevel);
+  bool passed = true;
+  for(int level = EVO_SIMD_NONE; level <= maxLevel; level++)
+  {
+    evo_irimager_set_simd_level(level);
+    unsigned int mismatches = 0;
+    unsigned int count = 0;
+    for(unsigned int f = 0; f < frames; f++)
+    {
+      const unsigned short* frame = &data[f * pixels];
+      t0 = std::chrono::steady_clock::now();
+      const int rc = evo_irimager_roi_evaluate(engineId, frame, &results[0], rois, &count);
+      times[f] = seconds(t0);
+      if(rc != 0 || count != rois)
+      {
+        passed = false;
+        break;
+      }
+
+      // every frame is checked on one instruction set, the last frame on all
+      if(f % (maxLevel + 1) != (unsigned int)level && f + 1 != frames) continue;
+      for(unsigned int i = 0; i < rois; i++)
+      {
+        reference(regions[i], frame, &refResults[i]);
+        const EvoIRRoiResult& r = results[i];
+        const EvoIRRoiResult& e = refResults[i];
+        bool ok = r.roiId == ids[i] && r.pixels == e.pixels;
+        if(!regions[i].overridden)
+        {
+          ok = ok && r.tMin == e.tMin && r.tMax == e.tMax && std::fabs(r.tMean - e.tMean) < 0.01f && r.xMin == e.xMin && r.yMin == e.yMin
+               && r.xMax == e.xMax && r.yMax == e.yMax
+               && r.alarm == ((r.tMin < 20.f ? EVO_ROI_ALARM_LOW : 0) | (r.tMax > 40.f ? EVO_ROI_ALARM_HIGH : 0));
+        }
+        if(!ok) mismatches++;
+      }
+    }
+    const double median = percentile(times, 0.5);
+    std::printf("  %-10s %9.1f us/frame median, %9.1f us 99%%, %.2f ns/pixel, %5.1fx reference%s\n", LEVEL_NAMES[level], median * 1e6,
+                percentile(times, 0.99) * 1e6, median * 1e9 / covered, tReference / median, mismatches ? ", results FAILED" : "");
+    passed = passed && mismatches == 0;
+  }
+  evo_irimager_set_simd_level(maxLevel);
+  evo_irimager_roi_engine_destroy(engineId);
+  return passed;
+}
+
+int main(int argc, char* argv[])
+{
+  unsigned int rois = 64;
+  int size = 0;
+  unsigned int frames = 200;
+  unsigned int seed = 1;
+  for(int i = 1; i < argc; i++)
+  {
+    const bool hasValue = i + 1 < argc;
+    if(!std::strcmp(argv[i], "--rois") && hasValue)        rois   = (unsigned int)std::atoi(argv[++i]);
+    else if(!std::strcmp(argv[i], "--size") && hasValue)   size   = std::atoi(argv[++i]);
+    else if(!std::strcmp(argv[i], "--frames") && hasValue) frames = (unsigned int)std::atoi(argv[++i]);
+    else if(!std::strcmp(argv[i], "--seed") && hasValue)   seed   = (unsigned int)std::atoi(argv[++i]);
+    else
+    {
+      std::printf("usage: EvoIRRoiBench [--rois n] [--size pixels] [--frames n] [--seed n]\n");
+      return 1;
+    }
+  }
+  if(rois == 0 || frames == 0 || (size != 0 && (size < 8 || size > HEIGHT))) return 1;
+
+  // frames up front, so only the evaluation is timed
+  EvoIRSyntheticParams params;
+  evo_irimager_synthetic_default_params(&params, WIDTH, HEIGHT, 32.f);
+  params.realtime = 0;
+  params.hotspots = 4;
+  unsigned int srcId;
+  if(evo_irimager_synthetic_init(&srcId, &params) != 0) return 1;
+  const size_t pixels = (size_t)WIDTH * HEIGHT;
+  std::vector<unsigned short> data(pixels * frames);
+  for(unsigned int f = 0; f < frames; f++)
+  {
+    int w = WIDTH, h = HEIGHT;
+    EvoIRFrameMetadata metadata;
+    if(evo_irimager_synthetic_get_thermal_image_metadata(srcId, &w, &h, &data[f * pixels], &metadata) != 0) return 1;
+  }
+  evo_irimager_synthetic_terminate(srcId);
+
+  bool passed = true;
+  if(size != 0)
+  {
+    passed = run(data, frames, rois, size, seed);
+  }
+  else
+  {
+    for(size_t i = 0; i < sizeof(SIZES) / sizeof(SIZES[0]); i++)
+      passed = run(data, frames, rois, SIZES[i], seed) && passed;
+  }
+  std::printf("%s\n", passed ? "passed" : "FAILED");
+  return passed ? 0 : 1;
+}
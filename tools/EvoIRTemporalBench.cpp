@@ -0,0 +1,227 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRTemporalBench.cpp
+ * @brief Throughput of the temporal filters, instruction sets against plain C++
+ *
+ * Filters synthetic streams of 640 x 480 at 32 Hz and 72 x 56 at 1000 Hz
+ * (PI 640 and the high speed mode of the PI 400) with every algorithm and
+ * instruction set and reports the time per frame and its share of the frame
+ * period. Beforehand a sequence with shutter flag cycles, starting with a
+ * flag frame, is filtered on every instruction set frame by frame: output
+ * and depth must be bit-identical to plain C++, flag frames have to repeat
+ * the previous estimate, and the first frame after a cycle has to restart
+ * the estimate (EVO_TEMPORAL_FLAG_RESET) or continue it (_SKIP):
+ *
+ *   EvoIRTemporalBench [--frames 2000] [--length 8]
+ *
+ * The median uses the next odd length up to 15. Build e.g. on Linux:
+ *
+ *   g++ -std=c++11 -O2 -pthread -I.. EvoIRTemporalBench.cpp ../EvoIRTemporalFilter.cpp ../EvoIRPalette.cpp ../EvoIRSyntheticSource.cpp
+ */
+
+#include "EvoIRTemporalFilter.h"
+#include "EvoIRPalette.h"
+#include "EvoIRSyntheticSource.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+struct Stream
+{
+  int width;
+  int height;
+  float framerate;
+};
+
+// frame contents repeat after PREPARED_FRAMES while flagStateAt keeps counting, so the check
+// passes three flag cycles with the filter history carried over the wrap
+static const int PREPARED_FRAMES = 64;
+static const int CHECK_FRAMES    = 2 * PREPARED_FRAMES;
+
+static const char* const LEVEL_NAMES[] = { "none", "sse4.1", "avx2" };
+
+// Flag cycle of 8 frames every 40 frames, the sequence starts with a covered sensor
+static EvoIRFlagState flagStateAt(int f)
+{
+  if(f == 0) return irFlagClose;
+  const int phase = f % 40;
+  if(phase < 32) return irFlagOpen;
+  if(phase < 34) return irFlagClosing;
+  if(phase < 38) return irFlagClose;
+  return irFlagOpening;
+}
+
+static bool isFlag(EvoIRFlagState state)
+{
+  return state == irFlagClosing || state == irFlagClose || state == irFlagOpening;
+}
+
+// Filters the check sequence with one filter per instruction set side by side, plain C++ is also checked for flag handling
+static bool check(const Stream& stream, const unsigned short* prepared, const EvoIRFrameMetadata* metadata, int mode, int length, int policy,
+                  int supported)
+{
+  const size_t pixels = (size_t)stream.width * stream.height;
+  unsigned int filterIds[3];
+  std::vector<unsigned short> out[3];
+  int depth[3];
+  for(int level = EVO_SIMD_NONE; level <= supported; level++)
+  {
+    EvoIRTemporalParams filter;
+    evo_irimager_temporal_default_params(&filter, stream.width, stream.height, mode, length);
+    filter.flagPolicy = policy;
+    if(evo_irimager_temporal_create(&filterIds[level], &filter) != 0)
+    {
+      for(int l = EVO_SIMD_NONE; l < level; l++)
+        evo_irimager_temporal_destroy(filterIds[l]);
+      return false;
+    }
+    out[level].resize(pixels);
+  }
+
+  std::vector<unsigned short> previous(pixels);
+  int previousDepth = 0;
+  bool started = false, afterFlag = false;
+  int mismatch = -1, wrongFlag = -1;
+  for(int f = 0; f < CHECK_FRAMES; f++)
+  {
+    const unsigned short* data = prepared + pixels * (f % PREPARED_FRAMES);
+    EvoIRFrameMetadata m = metadata[f % PREPARED_FRAMES];
+    m.flagState = flagStateAt(f);
+    for(int level = EVO_SIMD_NONE; level <= supported; level++)
+    {
+      evo_irimager_set_simd_level(level);
+      evo_irimager_temporal_process(filterIds[level], data, &m, &out[level][0], &depth[level]);
+    }
+    for(int level = EVO_SIMD_NONE + 1; level <= supported && mismatch < 0; level++)
+      if(out[level] != out[EVO_SIMD_NONE] || depth[level] != depth[EVO_SIMD_NONE]) mismatch = level;
+
+    const std::vector<unsigned short>& o = out[EVO_SIMD_NONE];
+    const int d = depth[EVO_SIMD_NONE];
+    bool ok;
+    if(isFlag(m.flagState))
+      ok = started ? (o == previous && d == previousDepth) : (std::equal(o.begin(), o.end(), data) && d == 0);
+    else if(!started || (afterFlag && policy == EVO_TEMPORAL_FLAG_RESET))
+      ok = std::equal(o.begin(), o.end(), data) && d == 1;
+    else if(afterFlag)
+      ok = d >= previousDepth && (previousDepth == 1 || d > 1);
+    else
+      ok = d >= 1;
+    if(!ok && wrongFlag < 0) wrongFlag = f;
+
+    afterFlag = isFlag(m.flagState);
+    if(!afterFlag)
+    {
+      started = true;
+      previous = o;
+      previousDepth = d;
+    }
+  }
+  for(int level = EVO_SIMD_NONE; level <= supported; level++)
+    evo_irimager_temporal_destroy(filterIds[level]);
+  evo_irimager_set_simd_level(supported);
+
+  if(mismatch >= 0) std::printf("  %s differs from plain C++: FAILED\n", LEVEL_NAMES[mismatch]);
+  if(wrongFlag >= 0) std::printf("  %s flag handling wrong at frame %d: FAILED\n", policy == EVO_TEMPORAL_FLAG_RESET ? "reset" : "skip", wrongFlag);
+  return mismatch < 0 && wrongFlag < 0;
+}
+
+static bool run(const Stream& stream, int frames, int length)
+{
+  EvoIRSyntheticParams params;
+  evo_irimager_synthetic_default_params(&params, stream.width, stream.height, stream.framerate);
+  unsigned int srcId;
+  if(evo_irimager_synthetic_init(&srcId, &params) != 0) return false;
+
+  const size_t pixels = (size_t)stream.width * stream.height;
+  std::vector<unsigned short> prepared(pixels * PREPARED_FRAMES);
+  std::vector<EvoIRFrameMetadata> metadata(PREPARED_FRAMES);
+  for(int i = 0; i < PREPARED_FRAMES; i++)
+  {
+    int w = stream.width;
+    int h = stream.height;
+    evo_irimager_synthetic_get_thermal_image_metadata(srcId, &w, &h, &prepared[pixels * i], &metadata[i]);
+  }
+  evo_irimager_synthetic_terminate(srcId);
+  std::vector<unsigned short> out(pixels);
+
+  std::printf("%d x %d at %.0f Hz, frame period %.1f us\n", stream.width, stream.height, stream.framerate, 1e6 / stream.framerate);
+  std::printf("  %-8s %-6s %8s %12s %8s\n", "filter", "simd", "length", "us/frame", "period");
+
+  const int modes[]          = { EVO_TEMPORAL_MEAN, EVO_TEMPORAL_EMA, EVO_TEMPORAL_MEDIAN };
+  const char* const names[]  = { "mean", "ema", "median" };
+  int supported;
+  bool passed = true;
+  evo_irimager_set_simd_level(EVO_SIMD_AVX2);
+  evo_irimager_get_simd_level(&supported);
+
+  for(int m = 0; m < 3; m++)
+  {
+    int n = length;
+    if(modes[m] == EVO_TEMPORAL_MEDIAN)
+    {
+      if(n % 2 == 0) n++;
+      if(n < 3)  n = 3;
+      if(n > 15) n = 15;
+    }
+    const bool reset = check(stream, &prepared[0], &metadata[0], modes[m], n, EVO_TEMPORAL_FLAG_RESET, supported);
+    const bool skip  = check(stream, &prepared[0], &metadata[0], modes[m], n, EVO_TEMPORAL_FLAG_SKIP, supported);
+    passed = passed && reset && skip;
+    for(int level = EVO_SIMD_NONE; level <= supported; level++)
+    {
+      evo_irimager_set_simd_level(level);
+      EvoIRTemporalParams filter;
+      evo_irimager_temporal_default_params(&filter, stream.width, stream.height, modes[m], n);
+      unsigned int filterId;
+      if(evo_irimager_temporal_create(&filterId, &filter) != 0) continue;
+
+      const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+      for(int i = 0; i < frames; i++)
+      {
+        const int k = i % PREPARED_FRAMES;
+        evo_irimager_temporal_process(filterId, &prepared[pixels * k], &metadata[k], &out[0], 0);
+      }
+      const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count() / frames;
+      evo_irimager_temporal_destroy(filterId);
+
+      std::printf("  %-8s %-6s %8d %12.1f %7.1f%%\n", names[m], LEVEL_NAMES[level], n, us, us * stream.framerate * 1e-4);
+    }
+  }
+  evo_irimager_set_simd_level(supported);
+  std::printf("  identical on all instruction sets, flag cycles handled: %s\n", passed ? "yes" : "FAILED");
+  return passed;
+}
+
+int main(int argc, char* argv[])
+{
+  int frames = 2000;
+  int length = 8;
+  for(int i = 1; i < argc; i++)
+  {
+    const bool hasValue = i + 1 < argc;
+    if(!std::strcmp(argv[i], "--frames") && hasValue)      frames = std::atoi(argv[++i]);
+    else if(!std::strcmp(argv[i], "--length") && hasValue) length = std::atoi(argv[++i]);
+    else
+    {
+      std::printf("usage: EvoIRTemporalBench [--frames n] [--length n]\n");
+      return 1;
+    }
+  }
+  if(frames < 1 || length < 1) return 1;
+
+  const Stream streams[] = { { 640, 480, 32.f }, { 72, 56, 1000.f } };
+  bool passed = true;
+  for(int i = 0; i < 2; i++)
+    passed = run(streams[i], frames, length) && passed;
+  std::printf("%s\n", passed ? "passed" : "FAILED");
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,199 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRTileBench.cpp
+ * @brief Write rate, size and query times of the pixel history store
+ *
+ * Records a synthetic 382 x 288 stream at 27 Hz with injected hot events into
+ * a tile store, while keeping the values of a 10 x 10 patch aside. The history
+ * of a pixel, the statistics of the patch and a search for the hot events are
+ * then queried over all frames, checked against the kept values and timed.
+ * Query times grow linearly with the number of frames and are extrapolated to
+ * a day of recording; fails if the patch statistics of a day would take a
+ * second or more:
+ *
+ *   EvoIRTileBench [--hours 0.5] [--tile 16] [--block 128] [--repeat 3] [--file bench.evotile]
+ *
+ * Build e.g. on Linux:
+ *
+ *   g++ -std=c++11 -O2 -pthread -I.. EvoIRTileBench.cpp ../EvoIRTileStore.cpp ../EvoIRRecording.cpp ../EvoIRSyntheticSource.cpp
+ */
+
+#include "EvoIRTileStore.h"
+#include "EvoIRSyntheticSource.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+static const int WIDTH   = 382;
+static const int HEIGHT  = 288;
+static const float FPS   = 27.f;
+static const int PATCH_X = 181;  // crosses tile borders at 16 and 32 pixels
+static const int PATCH_Y = 139;
+static const int PATCH   = 10;
+
+static double seconds(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[])
+{
+  double hours = 0.5;
+  int tileSize = 16;
+  unsigned int blockFrames = 128;
+  int repeat = 3;
+  const char* path = "bench.evotile";
+  for(int i = 1; i < argc; i++)
+  {
+    const bool hasValue = i + 1 < argc;
+    if(!std::strcmp(argv[i], "--hours") && hasValue)       hours       = std::atof(argv[++i]);
+    else if(!std::strcmp(argv[i], "--tile") && hasValue)   tileSize    = std::atoi(argv[++i]);
+    else if(!std::strcmp(argv[i], "--block") && hasValue)  blockFrames = (unsigned int)std::atoi(argv[++i]);
+    else if(!std::strcmp(argv[i], "--repeat") && hasValue) repeat      = std::atoi(argv[++i]);
+    else if(!std::strcmp(argv[i], "--file") && hasValue)   path        = argv[++i];
+    else
+    {
+      std::printf("usage: EvoIRTileBench [--hours h] [--tile pixels] [--block frames] [--repeat n] [--file path]\n");
+      return 1;
+    }
+  }
+  const unsigned long long frames = (unsigned long long)(hours * 3600.0 * FPS);
+  if(frames == 0 || repeat < 1) return 1;
+
+  // recording, the events cover the patch now and then
+  EvoIRSyntheticParams synthetic;
+  evo_irimager_synthetic_default_params(&synthetic, WIDTH, HEIGHT, FPS);
+  synthetic.realtime      = 0;
+  synthetic.eventInterval = 20.f;
+  synthetic.eventDuration = 4.f;
+  unsigned int srcId, tileId;
+  if(evo_irimager_synthetic_init(&srcId, &synthetic) != 0) return 1;
+  if(evo_irimager_tile_recorder_open(&tileId, path, WIDTH, HEIGHT, FPS, tileSize, blockFrames) != 0)
+  {
+    std::printf("cannot create %s\n", path);
+    return 1;
+  }
+
+  std::vector<unsigned short> data((size_t)WIDTH * HEIGHT);
+  std::vector<unsigned short> kept((size_t)PATCH * PATCH * frames);
+  std::vector<long long> keptTimes(frames);
+  double write = 0.0;
+  for(unsigned long long f = 0; f < frames; f++)
+  {
+    int w = WIDTH, h = HEIGHT;
+    EvoIRFrameMetadata metadata;
+    if(evo_irimager_synthetic_get_thermal_image_metadata(srcId, &w, &h, &data[0], &metadata) != 0) return 1;
+    for(int j = 0; j < PATCH; j++)
+      for(int i = 0; i < PATCH; i++)
+        kept[(size_t)(j * PATCH + i) * frames + f] = data[(size_t)(PATCH_Y + j) * WIDTH + PATCH_X + i];
+    keptTimes[f] = metadata.timestamp;
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if(evo_irimager_tile_recorder_write_frame(tileId, &data[0], &metadata) != 0) return 1;
+    write += seconds(start);
+  }
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  if(evo_irimager_tile_recorder_close(tileId) != 0) return 1;
+  write += seconds(start);
+  evo_irimager_synthetic_terminate(srcId);
+
+  unsigned int storeId;
+  if(evo_irimager_tile_store_open(&storeId, path) != 0) return 1;
+  EvoIRTileStoreInfo info;
+  evo_irimager_tile_store_get_info(storeId, &info);
+  FILE* f = fopen(path, "rb");
+  fseek(f, 0, SEEK_END);
+  const double size = (double)ftell(f);
+  fclose(f);
+  std::printf("%llu frames (%.2f h at %.0f Hz) in %u blocks, tile %d, block %u frames\n", info.frames, hours, FPS, info.blocks, tileSize, blockFrames);
+  std::printf("write: %.0f frames/s on the calling thread (%.1f s incl. close), %.2f bytes/pixel, %.1f MB\n", frames / write, write,
+              size / ((double)frames * WIDTH * HEIGHT), size / 1e6);
+
+  // check against the kept values
+  bool passed = info.frames == frames && info.recovered == 0;
+  std::vector<unsigned short> patch((size_t)PATCH * PATCH * frames);
+  std::vector<long long> times(frames);
+  passed = passed && evo_irimager_tile_store_read_patch(storeId, PATCH_X, PATCH_Y, PATCH, PATCH, 0, frames, &patch[0], &times[0]) == 0
+           && patch == kept && times == keptTimes;
+  unsigned long long index = 0;
+  passed = passed && evo_irimager_tile_store_find_time(storeId, keptTimes[frames / 2], &index) == 0 && index == frames / 2;
+
+  std::vector<EvoIRPatchSample> samples(frames);
+  unsigned short hottest = 0;
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  for(int r = 0; r < repeat && passed; r++)
+    passed = evo_irimager_tile_store_patch_history(storeId, PATCH_X, PATCH_Y, PATCH, PATCH, 0, frames, &samples[0]) == 0;
+  const double tPatch = seconds(t0) / repeat;
+  for(unsigned long long k = 0; k < frames && passed; k++)
+  {
+    unsigned short lo = 0xFFFF, hi = 0;
+    unsigned long long sum = 0;
+    for(int p = 0; p < PATCH * PATCH; p++)
+    {
+      const unsigned short v = kept[(size_t)p * frames + k];
+      lo = std::min(lo, v);
+      hi = std::max(hi, v);
+      sum += v;
+    }
+    passed = samples[k].min == lo && samples[k].max == hi && std::fabs(samples[k].mean - sum / (float)(PATCH * PATCH)) < 0.01f
+             && samples[k].timestamp == keptTimes[k];
+    hottest = std::max(hottest, hi);
+  }
+
+  std::vector<unsigned short> pixel(frames);
+  t0 = std::chrono::steady_clock::now();
+  for(int r = 0; r < repeat && passed; r++)
+    passed = evo_irimager_tile_store_read_patch(storeId, PATCH_X, PATCH_Y, 1, 1, 0, frames, &pixel[0], nullptr) == 0;
+  const double tPixel = seconds(t0) / repeat;
+  passed = passed && std::equal(pixel.begin(), pixel.end(), kept.begin());
+
+  // search for the upper half between background and hottest value of the patch
+  const unsigned short rawMin = (unsigned short)((samples[0].max + hottest) / 2);
+  std::vector<EvoIRFrameRun> runs(4096);
+  unsigned int runCount = 0, skipped = 0;
+  t0 = std::chrono::steady_clock::now();
+  for(int r = 0; r < repeat && passed; r++)
+    passed = evo_irimager_tile_store_find_range(storeId, PATCH_X, PATCH_Y, PATCH, PATCH, 0, frames, rawMin, 0xFFFF, &runs[0], (unsigned int)runs.size(),
+                                                &runCount, &skipped) == 0;
+  const double tRange = seconds(t0) / repeat;
+  unsigned int expected = 0;
+  unsigned long long matching = 0, found = 0;
+  bool inRun = false;
+  for(unsigned long long k = 0; k < frames && passed; k++)
+  {
+    const bool match = samples[k].max >= rawMin;
+    if(match && !inRun) expected++;
+    inRun = match;
+    matching += match ? 1 : 0;
+  }
+  for(unsigned int r = 0; r < std::min<unsigned int>(runCount, (unsigned int)runs.size()); r++)
+  {
+    for(unsigned int k = runs[r].first; k < runs[r].first + runs[r].count; k++)
+      passed = passed && samples[k].max >= rawMin;
+    found += runs[r].count;
+  }
+  passed = passed && runCount == expected && found == matching;
+  evo_irimager_tile_store_close(storeId);
+
+  const double day = 86400.0 * FPS / frames;
+  passed = passed && tPatch * day < 1.0;
+  std::printf("  %-28s %10s %14s\n", "query over all frames", "time", "day (extrap.)");
+  std::printf("  %-28s %7.1f ms %11.1f ms\n", "pixel history", tPixel * 1e3, tPixel * day * 1e3);
+  std::printf("  %-28s %7.1f ms %11.1f ms\n", "10 x 10 patch min/max/mean", tPatch * 1e3, tPatch * day * 1e3);
+  std::printf("  %-28s %7.1f ms %11.1f ms   (%u runs, %u of %u blocks skipped)\n", "10 x 10 patch range search", tRange * 1e3, tRange * day * 1e3,
+              runCount, skipped, info.blocks);
+  std::printf("%s\n", passed ? "passed" : "FAILED");
+  std::remove(path);
+  return passed ? 0 : 1;
+}
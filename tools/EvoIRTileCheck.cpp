@@ -0,0 +1,155 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRTileCheck.cpp
+ * @brief Round trip of the pixel history store for odd tile and block sizes
+ *
+ * Writes frames of full range noise, the worst case for the codec, into tile
+ * stores whose tiles do not divide the image and whose last block is partial,
+ * e.g. 640 x 480 with tiles of 5 pixels and blocks of 16 frames. Every frame
+ * has to be read back exactly, and the statistics of a patch covering the
+ * whole image have to match, which also needs sums beyond 32 bits. Geometries
+ * whose blocks could exceed the 32 bit chunk sizes have to be refused:
+ *
+ *   EvoIRTileCheck [--frames 40] [--seed 1] [--file check.evotile]
+ *
+ * Build e.g. on Linux:
+ *
+ *   g++ -std=c++11 -O2 -pthread -I.. EvoIRTileCheck.cpp ../EvoIRTileStore.cpp ../EvoIRRecording.cpp
+ */
+
+#include "EvoIRTileStore.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+struct Geometry
+{
+  int width;
+  int height;
+  int tileSize;
+  unsigned int blockFrames;
+};
+
+static bool check(const Geometry& g, unsigned long long frames, std::mt19937& rng, const char* path)
+{
+  const size_t pixels = (size_t)g.width * g.height;
+  std::vector<unsigned short> written(pixels * frames);
+  std::vector<long long> times(frames);
+  unsigned int tileId;
+  if(evo_irimager_tile_recorder_open(&tileId, path, g.width, g.height, 27.f, g.tileSize, g.blockFrames) != 0)
+  {
+    std::printf("%d x %d, tile %d, block %u: cannot create %s\n", g.width, g.height, g.tileSize, g.blockFrames, path);
+    return false;
+  }
+  bool ok = true;
+  for(unsigned long long f = 0; f < frames && ok; f++)
+  {
+    unsigned short* data = &written[pixels * f];
+    for(size_t i = 0; i < pixels; i++)
+      data[i] = (unsigned short)rng();
+    EvoIRFrameMetadata metadata;
+    std::memset(&metadata, 0, sizeof(metadata));
+    metadata.counter   = (unsigned int)f;
+    metadata.timestamp = (long long)f * 370370;
+    times[f]           = metadata.timestamp;
+    ok = evo_irimager_tile_recorder_write_frame(tileId, data, &metadata) == 0;
+  }
+  ok = evo_irimager_tile_recorder_close(tileId) == 0 && ok;
+
+  unsigned int storeId;
+  EvoIRTileStoreInfo info;
+  ok = ok && evo_irimager_tile_store_open(&storeId, path) == 0;
+  if(!ok)
+  {
+    std::printf("%d x %d, tile %d, block %u: writing FAILED\n", g.width, g.height, g.tileSize, g.blockFrames);
+    std::remove(path);
+    return false;
+  }
+  evo_irimager_tile_store_get_info(storeId, &info);
+  ok = info.frames == frames && info.recovered == 0;
+
+  // whole image, pixel major
+  std::vector<unsigned short> history(pixels * frames);
+  std::vector<long long> readTimes(frames);
+  ok = ok && evo_irimager_tile_store_read_patch(storeId, 0, 0, g.width, g.height, 0, frames, &history[0], &readTimes[0]) == 0 && readTimes == times;
+  for(size_t p = 0; p < pixels && ok; p++)
+    for(unsigned long long f = 0; f < frames && ok; f++)
+      ok = history[p * frames + f] == written[pixels * f + p];
+
+  std::vector<EvoIRPatchSample> samples(frames);
+  ok = ok && evo_irimager_tile_store_patch_history(storeId, 0, 0, g.width, g.height, 0, frames, &samples[0]) == 0;
+  for(unsigned long long f = 0; f < frames && ok; f++)
+  {
+    const unsigned short* data = &written[pixels * f];
+    unsigned long long sum = 0;
+    for(size_t i = 0; i < pixels; i++)
+      sum += data[i];
+    const double mean = (double)sum / pixels;
+    ok = samples[f].min == *std::min_element(data, data + pixels) && samples[f].max == *std::max_element(data, data + pixels)
+         && std::fabs(samples[f].mean - mean) < 1e-3 * mean && samples[f].timestamp == times[f];
+  }
+  evo_irimager_tile_store_close(storeId);
+  std::remove(path);
+
+  std::printf("%d x %d, tile %d, block %u: %llu frames in %u blocks %s\n", g.width, g.height, g.tileSize, g.blockFrames, frames, info.blocks,
+              ok ? "" : "FAILED");
+  return ok;
+}
+
+static bool checkRefused(const char* path)
+{
+  const Geometry geometries[] = { { 8192, 8192, 16, 128 }, { 2048, 2048, 4, 4096 }, { 0x7FFFFFFF, 0x7FFFFFFF, 64, 16 } };
+  bool ok = true;
+  for(size_t i = 0; i < sizeof(geometries) / sizeof(geometries[0]); i++)
+  {
+    const Geometry& g = geometries[i];
+    unsigned int tileId;
+    if(evo_irimager_tile_recorder_open(&tileId, path, g.width, g.height, 27.f, g.tileSize, g.blockFrames) == 0)
+    {
+      std::printf("%d x %d, tile %d, block %u: not refused FAILED\n", g.width, g.height, g.tileSize, g.blockFrames);
+      evo_irimager_tile_recorder_close(tileId);
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+int main(int argc, char* argv[])
+{
+  unsigned long long frames = 40;
+  unsigned int seed = 1;
+  const char* path = "check.evotile";
+  for(int i = 1; i < argc; i++)
+  {
+    const bool hasValue = i + 1 < argc;
+    if(!std::strcmp(argv[i], "--frames") && hasValue)    frames = (unsigned long long)std::atoi(argv[++i]);
+    else if(!std::strcmp(argv[i], "--seed") && hasValue) seed   = (unsigned int)std::atoi(argv[++i]);
+    else if(!std::strcmp(argv[i], "--file") && hasValue) path   = argv[++i];
+    else
+    {
+      std::printf("usage: EvoIRTileCheck [--frames n] [--seed n] [--file path]\n");
+      return 1;
+    }
+  }
+  if(frames == 0) return 1;
+
+  const Geometry geometries[] = { { 640, 480, 5, 16 }, { 382, 288, 7, 17 }, { 382, 288, 4, 16 }, { 160, 120, 63, 23 }, { 80, 80, 64, 16 } };
+  std::mt19937 rng(seed);
+  bool passed = true;
+  for(size_t i = 0; i < sizeof(geometries) / sizeof(geometries[0]); i++)
+    passed = check(geometries[i], frames, rng, path) && passed;
+  passed = checkRefused(path) && passed;
+  std::printf("%s\n", passed ? "passed" : "FAILED");
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,171 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRTransportLoad.cpp
+ * @brief Load generator for the batched frame transport
+ *
+ * Connects 1, 4 and 16 concurrent clients (or the counts given with
+ * --clients) to a running frame server, e.g. tools/EvoIRDaemonStandIn, once
+ * over TCP only and once with shared memory, and reports received frames/s
+ * per client, latency percentiles and lost frames:
+ *
+ *   EvoIRTransportLoad [--host localhost] [--port 1338] [--seconds 5]
+ *                      [--clients 1,4,16] [--mode tcp|shm|both]
+ *
+ * Latency is measured from evo_irimager_server_publish until the frame is
+ * returned by evo_irimager_client_get_thermal_image_metadata, so client and
+ * server have to run on the same host. Build e.g. on Linux:
+ *
+ *   g++ -std=c++11 -O2 -pthread -I.. EvoIRTransportLoad.cpp ../EvoIRFrameClient.cpp -lrt
+ */
+
+#include "EvoIRFrameTransport.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct ClientResult
+{
+  bool connected;
+  bool sharedMemory;
+  unsigned long long frames;
+  unsigned long long dropped;
+  std::vector<long long> latencies;
+};
+
+static void runClient(const char* host, int port, bool sharedMemory, double seconds, ClientResult* result)
+{
+  result->connected = false;
+  unsigned int clientId;
+  if(evo_irimager_client_connect(&clientId, host, port, sharedMemory ? 1 : 0, 64) != 0) return;
+  result->connected = true;
+
+  int w, h;
+  evo_irimager_client_get_thermal_image_size(clientId, &w, &h);
+  std::vector<unsigned short> data((size_t)w * h);
+  EvoIRFrameMetadata metadata;
+  EvoIRTransportFrameInfo info;
+
+  // discard frames queued before the measurement starts
+  while(evo_irimager_client_get_thermal_image_metadata(clientId, 0, &w, &h, &data[0], &metadata, &info) == 0) {}
+  EvoIRClientStats before;
+  evo_irimager_client_get_stats(clientId, &before);
+
+  const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + std::chrono::microseconds((long long)(seconds * 1e6));
+  result->frames = 0;
+  while(std::chrono::steady_clock::now() < end)
+  {
+    const int ret = evo_irimager_client_get_thermal_image_metadata(clientId, 100, &w, &h, &data[0], &metadata, &info);
+    if(ret == -3) continue;
+    if(ret != 0) break;
+    result->frames++;
+    result->latencies.push_back(info.latency);
+  }
+
+  EvoIRClientStats after;
+  evo_irimager_client_get_stats(clientId, &after);
+  result->sharedMemory = after.sharedMemory != 0;
+  result->dropped      = after.framesDropped - before.framesDropped;
+  evo_irimager_client_disconnect(clientId);
+}
+
+static double percentile(const std::vector<long long>& sorted, double p)
+{
+  if(sorted.empty()) return 0.0;
+  const size_t i = std::min(sorted.size() - 1, (size_t)(p * (sorted.size() - 1) + 0.5));
+  return sorted[i] / 10.0; // UNITS to microseconds
+}
+
+int main(int argc, char* argv[])
+{
+  const char* host = "localhost";
+  int port         = 1338;
+  double seconds   = 5.0;
+  std::string mode = "both";
+  std::vector<int> counts;
+
+  for(int i = 1; i < argc; i++)
+  {
+    const bool hasValue = i + 1 < argc;
+    if(!std::strcmp(argv[i], "--host") && hasValue)          host = argv[++i];
+    else if(!std::strcmp(argv[i], "--port") && hasValue)     port = std::atoi(argv[++i]);
+    else if(!std::strcmp(argv[i], "--seconds") && hasValue)  seconds = std::atof(argv[++i]);
+    else if(!std::strcmp(argv[i], "--mode") && hasValue)     mode = argv[++i];
+    else if(!std::strcmp(argv[i], "--clients") && hasValue)
+    {
+      for(const char* p = argv[++i]; *p; p++)
+      {
+        counts.push_back(std::atoi(p));
+        while(*p && *p != ',') p++;
+        if(!*p) break;
+      }
+    }
+    else
+    {
+      std::printf("usage: EvoIRTransportLoad [--host h] [--port n] [--seconds s] [--clients 1,4,16] [--mode tcp|shm|both]\n");
+      return 1;
+    }
+  }
+  if(counts.empty())
+  {
+    counts.push_back(1);
+    counts.push_back(4);
+    counts.push_back(16);
+  }
+
+  std::vector<bool> modes;
+  if(mode != "shm") modes.push_back(false);
+  if(mode != "tcp") modes.push_back(true);
+
+  std::printf("%-5s %7s %12s %12s %10s %10s %10s %9s\n", "mode", "clients", "frames/s", "per client", "p50 [us]", "p99 [us]", "max [us]", "dropped");
+  for(size_t m = 0; m < modes.size(); m++)
+  {
+    for(size_t c = 0; c < counts.size(); c++)
+    {
+      std::vector<ClientResult> results(counts[c]);
+      std::vector<std::thread> threads;
+      for(int i = 0; i < counts[c]; i++)
+        threads.push_back(std::thread(runClient, host, port, modes[m], seconds, &results[i]));
+      for(size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+
+      unsigned long long frames = 0, dropped = 0;
+      int connected = 0, shared = 0;
+      std::vector<long long> latencies;
+      for(size_t i = 0; i < results.size(); i++)
+      {
+        if(!results[i].connected) continue;
+        connected++;
+        if(results[i].sharedMemory) shared++;
+        frames  += results[i].frames;
+        dropped += results[i].dropped;
+        latencies.insert(latencies.end(), results[i].latencies.begin(), results[i].latencies.end());
+      }
+      if(connected == 0)
+      {
+        std::printf("cannot connect to %s:%d\n", host, port);
+        return 1;
+      }
+      if(modes[m] && shared != connected)
+        std::printf("warning: %d of %d clients fell back to TCP\n", connected - shared, connected);
+
+      std::sort(latencies.begin(), latencies.end());
+      std::printf("%-5s %7d %12.1f %12.1f %10.1f %10.1f %10.1f %9llu\n", modes[m] ? "shm" : "tcp", connected,
+                  frames / seconds, frames / seconds / connected,
+                  percentile(latencies, 0.5), percentile(latencies, 0.99), percentile(latencies, 1.0), dropped);
+      std::fflush(stdout);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,236 @@
+/******************************************************************************
+ * Copyright (c) 2012-2020 All Rights Reserved, http://www.evocortex.com      *
+ *  Evocortex GmbH                                                            *
+ *  Emilienstr. 10                                                            *
+ *  90489 Nuremberg                                                           *
+ *  Germany                                                                   *
+ *****************************************************************************/
+
+/*! @file EvoIRUndistortBench.cpp
+ * @brief Accuracy and throughput of the lens distortion correction
+ *
+ * Corrects synthetic streams of 382 x 288 at 80 Hz (PI 400), 640 x 480 and
+ * 764 x 480 at 32 Hz (PI 640 and the transfer of the PI 200 format in
+ * Formats.def) with a barrel distortion model. The accuracy is checked
+ * against bilinear interpolation at the exact source position in double
+ * precision, evaluated with an own implementation of the model; the results
+ * of all instruction sets must be identical. Fails if the table positions
+ * are off by more than half a step of the 1/128 pixel grid, a result is
+ * off by more than rounding from the quantized position or by more than
+ * 1 from the exact one, or the border differs. Then the time per frame is
+ * reported for single thermal images, batches and palette images:
+ *
+ *   EvoIRUndistortBench [--frames 500] [--batch 16] [--k1 -0.3] [--k2 0.1] [--zoom 1]
+ *
+ * Coefficients refer to a focal length of the image width. Build e.g. on Linux:
+ *
+ *   g++ -std=c++11 -O2 -pthread -I.. EvoIRUndistortBench.cpp ../EvoIRUndistort.cpp ../EvoIRRecording.cpp ../EvoIRPalette.cpp ../EvoIRSyntheticSource.cpp
+ */
+
+#include "EvoIRUndistort.h"
+#include "EvoIRPalette.h"
+#include "EvoIRSyntheticSource.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+struct Stream
+{
+  int width;
+  int height;
+  float framerate;
+};
+
+// distinct input frames, also the largest --batch since a batch is taken contiguously from them
+static const int PREPARED_FRAMES = 64;
+
+static const char* const LEVELS[] = { "none", "sse4.1", "avx2" };
+
+static const int PALETTE_ID = 6;
+
+// limits of checkAccuracy, in pixels and raw values
+static const double MAX_SHIFT = 0.5 / 128 + 1e-6;
+static const double MAX_TABLE = 0.5 + 1e-6;
+static const double MAX_EXACT = 1.0;
+
+// source position of output pixel (u, v), false if outside
+static bool referenceSource(const EvoIRUndistortParams& p, int u, int v, double* sx, double* sy)
+{
+  const double x  = (u - p.cx) / (p.fx * p.zoom);
+  const double y  = (v - p.cy) / (p.fy * p.zoom);
+  const double r2 = x * x + y * y;
+  const double r  = 1.0 + p.k1 * r2 + p.k2 * r2 * r2 + p.k3 * r2 * r2 * r2;
+  *sx = p.fx * (x * r + 2.0 * p.p1 * x * y + p.p2 * (r2 + 2.0 * x * x)) + p.cx;
+  *sy = p.fy * (y * r + p.p1 * (r2 + 2.0 * y * y) + 2.0 * p.p2 * x * y) + p.cy;
+  return *sx >= 0.0 && *sx <= p.width - 1 && *sy >= 0.0 && *sy <= p.height - 1;
+}
+
+static double bilinear(const unsigned short* data, int w, int h, double sx, double sy)
+{
+  int x0 = (int)sx;
+  int y0 = (int)sy;
+  if(x0 > w - 2) x0 = w - 2;
+  if(y0 > h - 2) y0 = h - 2;
+  const double ax = sx - x0;
+  const double ay = sy - y0;
+  const unsigned short* p = data + y0 * w + x0;
+  return (1.0 - ay) * ((1.0 - ax) * p[0] + ax * p[1]) + ay * ((1.0 - ax) * p[w] + ax * p[w + 1]);
+}
+
+static bool checkAccuracy(const EvoIRUndistortParams& params, unsigned int undistId, const unsigned short* data, const unsigned short* out)
+{
+  const int w = params.width;
+  const int h = params.height;
+  double maxExact = 0.0, sumExact = 0.0, maxTable = 0.0, maxShift = 0.0;
+  int compared = 0, borderMismatch = 0;
+  for(int v = 0; v < h; v++)
+  {
+    for(int u = 0; u < w; u++)
+    {
+      double sx, sy;
+      const bool inside = referenceSource(params, u, v, &sx, &sy);
+      float tx, ty;
+      const bool tableInside = evo_irimager_undistort_get_source(undistId, u, v, &tx, &ty) == 0;
+      if(inside != tableInside) { borderMismatch++; continue; }
+      if(!inside) continue;
+      const double value = out[v * w + u];
+      // exact position: error of the 1/128 pixel grid, quantized position: rounding of the kernel only
+      const double exact = std::fabs(value - bilinear(data, w, h, sx, sy));
+      const double table = std::fabs(value - bilinear(data, w, h, tx, ty));
+      const double shift = std::max(std::fabs(sx - tx), std::fabs(sy - ty));
+      if(exact > maxExact) maxExact = exact;
+      if(table > maxTable) maxTable = table;
+      if(shift > maxShift) maxShift = shift;
+      sumExact += exact;
+      compared++;
+    }
+  }
+  const bool passed = compared > 0 && maxShift <= MAX_SHIFT && maxTable <= MAX_TABLE && maxExact <= MAX_EXACT && borderMismatch == 0;
+  std::printf("  accuracy: %d pixels, position error %.4f px, |out - exact| max %.2f mean %.3f, |out - quantized| max %.2f, border mismatches %d %s\n",
+              compared, maxShift, maxExact, compared ? sumExact / compared : 0.0, maxTable, borderMismatch, passed ? "" : "FAILED");
+  return passed;
+}
+
+template<typename F>
+static double timePerFrame(int frames, F call)
+{
+  const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  call();
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count() / frames;
+}
+
+static bool run(const Stream& stream, int frames, int batch, double k1, double k2, double zoom)
+{
+  EvoIRSyntheticParams synthetic;
+  evo_irimager_synthetic_default_params(&synthetic, stream.width, stream.height, stream.framerate);
+  unsigned int srcId;
+  if(evo_irimager_synthetic_init(&srcId, &synthetic) != 0) return false;
+
+  const size_t pixels = (size_t)stream.width * stream.height;
+  std::vector<unsigned short> prepared(pixels * PREPARED_FRAMES);
+  for(int i = 0; i < PREPARED_FRAMES; i++)
+  {
+    int w = stream.width;
+    int h = stream.height;
+    EvoIRFrameMetadata metadata;
+    evo_irimager_synthetic_get_thermal_image_metadata(srcId, &w, &h, &prepared[pixels * i], &metadata);
+  }
+  evo_irimager_synthetic_terminate(srcId);
+  std::vector<unsigned char> palette(3 * pixels);
+  if(evo_irimager_palette_render(&prepared[0], stream.width, stream.height, PALETTE_ID, 2, 0.f, 0.f, 1, EVO_PALETTE_INTERLEAVED, &palette[0]) != 0)
+  {
+    std::printf("%d x %d: palette rendering FAILED\n", stream.width, stream.height);
+    return false;
+  }
+
+  EvoIRUndistortParams params;
+  evo_irimager_undistort_default_params(&params, stream.width, stream.height);
+  params.k1   = k1;
+  params.k2   = k2;
+  params.zoom = zoom;
+  unsigned int undistId;
+  const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  if(evo_irimager_undistort_create(&undistId, &params) != 0) return false;
+  const double createMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+
+  std::printf("%d x %d at %.0f Hz, frame period %.1f us, table built in %.1f ms\n", stream.width, stream.height, stream.framerate, 1e6 / stream.framerate, createMs);
+
+  int supported;
+  evo_irimager_set_simd_level(2);
+  evo_irimager_get_simd_level(&supported);
+
+  // results of all instruction sets must match the plain C++ kernels
+  std::vector<unsigned short> reference(pixels);
+  std::vector<unsigned char> referencePalette(3 * pixels);
+  evo_irimager_set_simd_level(0);
+  evo_irimager_undistort_thermal(undistId, &prepared[0], &reference[0]);
+  evo_irimager_undistort_palette(undistId, &palette[0], &referencePalette[0]);
+  bool passed = checkAccuracy(params, undistId, &prepared[0], &reference[0]);
+
+  std::vector<unsigned short> out(pixels * batch);
+  std::vector<unsigned char> outPalette(3 * pixels);
+  std::printf("  %-6s %10s %14s %12s %8s %9s\n", "simd", "us/frame", "us/frame batch", "us/palette", "period", "identical");
+  for(int level = 0; level <= supported; level++)
+  {
+    evo_irimager_set_simd_level(level);
+    evo_irimager_undistort_thermal(undistId, &prepared[0], &out[0]);
+    evo_irimager_undistort_palette(undistId, &palette[0], &outPalette[0]);
+    const bool identical = std::memcmp(&out[0], &reference[0], pixels * sizeof(unsigned short)) == 0
+                           && std::memcmp(&outPalette[0], &referencePalette[0], 3 * pixels) == 0;
+
+    const double single = timePerFrame(frames, [&]() {
+      for(int i = 0; i < frames; i++)
+        evo_irimager_undistort_thermal(undistId, &prepared[pixels * (i % PREPARED_FRAMES)], &out[0]);
+    });
+    const int batches = (frames + batch - 1) / batch;
+    const double batched = timePerFrame(batches * batch, [&]() {
+      for(int i = 0; i < batches; i++)
+        evo_irimager_undistort_thermal_batch(undistId, &prepared[pixels * ((i * batch) % (PREPARED_FRAMES - batch + 1))], batch, &out[0]);
+    });
+    const double colored = timePerFrame(frames, [&]() {
+      for(int i = 0; i < frames; i++)
+        evo_irimager_undistort_palette(undistId, &palette[0], &outPalette[0]);
+    });
+    std::printf("  %-6s %10.1f %14.1f %12.1f %7.1f%% %9s\n", LEVELS[level], single, batched, colored, single * stream.framerate * 1e-4, identical ? "yes" : "NO");
+    passed = passed && identical;
+  }
+  evo_irimager_set_simd_level(supported);
+  evo_irimager_undistort_destroy(undistId);
+  return passed;
+}
+
+int main(int argc, char* argv[])
+{
+  int frames  = 500;
+  int batch   = 16;
+  double k1   = -0.3;
+  double k2   = 0.1;
+  double zoom = 1.0;
+  for(int i = 1; i < argc; i++)
+  {
+    const bool hasValue = i + 1 < argc;
+    if(!std::strcmp(argv[i], "--frames") && hasValue)     frames = std::atoi(argv[++i]);
+    else if(!std::strcmp(argv[i], "--batch") && hasValue) batch  = std::atoi(argv[++i]);
+    else if(!std::strcmp(argv[i], "--k1") && hasValue)    k1     = std::atof(argv[++i]);
+    else if(!std::strcmp(argv[i], "--k2") && hasValue)    k2     = std::atof(argv[++i]);
+    else if(!std::strcmp(argv[i], "--zoom") && hasValue)  zoom   = std::atof(argv[++i]);
+    else
+    {
+      std::printf("usage: EvoIRUndistortBench [--frames n] [--batch n] [--k1 k] [--k2 k] [--zoom z]\n");
+      return 1;
+    }
+  }
+  if(frames < 1 || batch < 1 || batch > PREPARED_FRAMES || !(zoom > 0.0)) return 1;
+
+  const Stream streams[] = { { 382, 288, 80.f }, { 640, 480, 32.f }, { 764, 480, 32.f } };
+  bool passed = true;
+  for(size_t i = 0; i < sizeof(streams) / sizeof(streams[0]); i++)
+    passed = run(streams[i], frames, batch, k1, k2, zoom) && passed;
+  std::printf("%s\n", passed ? "passed" : "FAILED");
+  return passed ? 0 : 1;
+}